@@ -1,5 +1,6 @@
 
 /* File generated by gen_cfile.py. Should not be modified. */
+/* Post-processed by objdict_const.py: constant entries in flash. */
 
 #include "ObjDict.h"
 
@@ -47,6 +48,7 @@ UNS8 Error_Value_Outputs_8_Bit[] =		/* Mapped at index 0x6207, subindex 0x01 - 0
   {
     0x0	/* 0 */
   };
+UNS8 Configuration_Data[1024];		/* Mapped at index 0x2000, subindex 0x00 */
 
 /**************************************************************************/
 /* Declaration of value range types                                       */
@@ -85,15 +87,15 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
 */
 
 /* index 0x1000 :   Device Type. */
-                    UNS32 ObjDict_obj1000 = 0x30191;	/* 197009 */
-                    subindex ObjDict_Index1000[] = 
+                    const UNS32 ObjDict_obj1000 = 0x30191;	/* 197009 */
+                    const subindex ObjDict_Index1000[] = 
                      {
                        { RO, uint32, sizeof (UNS32), (void*)&ObjDict_obj1000 }
                      };
 
 /* index 0x1001 :   Error Register. */
                     UNS8 ObjDict_obj1001 = 0x0;	/* 0 */
-                    subindex ObjDict_Index1001[] = 
+                    const subindex ObjDict_Index1001[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_obj1001 }
                      };
@@ -109,7 +111,7 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                        NULL,
                        NULL,
                      };
-                    subindex ObjDict_Index1003[] = 
+                    const subindex ObjDict_Index1003[] = 
                      {
                        { RW, valueRange_EMC, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj1003 },
                        { RO, uint32, sizeof (UNS32), (void*)&ObjDict_obj1003[0] }
@@ -121,7 +123,7 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                      {
                        NULL,
                      };
-                    subindex ObjDict_Index1005[] = 
+                    const subindex ObjDict_Index1005[] = 
                      {
                        { RW, uint32, sizeof (UNS32), (void*)&ObjDict_obj1005 }
                      };
@@ -130,22 +132,22 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                     UNS32 ObjDict_obj1006 = 0x0;   /* 0 */
 
 /* index 0x1008 :   Manufacturer Device Name. */
-                    INTEGER8 ObjDict_obj1008[10] = "";
-                    subindex ObjDict_Index1008[] = 
+                    const INTEGER8 ObjDict_obj1008[10] = "";
+                    const subindex ObjDict_Index1008[] = 
                      {
                        { RO, visible_string, 10, (void*)&ObjDict_obj1008 }
                      };
 
 /* index 0x1009 :   Manufacturer Hardware Version. */
-                    INTEGER8 ObjDict_obj1009[10] = "";
-                    subindex ObjDict_Index1009[] = 
+                    const INTEGER8 ObjDict_obj1009[10] = "";
+                    const subindex ObjDict_Index1009[] = 
                      {
                        { RO, visible_string, 10, (void*)&ObjDict_obj1009 }
                      };
 
 /* index 0x100A :   Manufacturer Software Version. */
-                    INTEGER8 ObjDict_obj100A[10] = "";
-                    subindex ObjDict_Index100A[] = 
+                    const INTEGER8 ObjDict_obj100A[10] = "";
+                    const subindex ObjDict_Index100A[] = 
                      {
                        { RO, visible_string, 10, (void*)&ObjDict_obj100A }
                      };
@@ -157,12 +159,12 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                     UNS16 ObjDict_obj100D = 0x0;   /* 0 */
 
 /* index 0x1010 :   Store parameters. */
-                    UNS8 ObjDict_highestSubIndex_obj1010 = 4; /* number of subindex - 1*/
+                    const UNS8 ObjDict_highestSubIndex_obj1010 = 4; /* number of subindex - 1*/
                     UNS32 ObjDict_obj1010_Save_All_Parameters = 0x0;	/* 0 */
                     UNS32 ObjDict_obj1010_Save_Communication_Parameters = 0x0;	/* 0 */
                     UNS32 ObjDict_obj1010_Save_Application_Parameters = 0x0;	/* 0 */
                     UNS32 ObjDict_obj1010_Save_Manufacturer_Parameters_1 = 0x0;	/* 0 */
-                    subindex ObjDict_Index1010[] = 
+                    const subindex ObjDict_Index1010[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj1010 },
                        { RW, uint32, sizeof (UNS32), (void*)&ObjDict_obj1010_Save_All_Parameters },
@@ -172,12 +174,12 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                      };
 
 /* index 0x1011 :   Restore Default Parameters. */
-                    UNS8 ObjDict_highestSubIndex_obj1011 = 4; /* number of subindex - 1*/
+                    const UNS8 ObjDict_highestSubIndex_obj1011 = 4; /* number of subindex - 1*/
                     UNS32 ObjDict_obj1011_Restore_All_Default_Parameters = 0x0;	/* 0 */
                     UNS32 ObjDict_obj1011_Restore_Communication_Default_Parameters = 0x0;	/* 0 */
                     UNS32 ObjDict_obj1011_Restore_Application_Default_Parameters = 0x0;	/* 0 */
                     UNS32 ObjDict_obj1011_Restore_Manufacturer_Defined_Default_Parameters_1 = 0x0;	/* 0 */
-                    subindex ObjDict_Index1011[] = 
+                    const subindex ObjDict_Index1011[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj1011 },
                        { RW, uint32, sizeof (UNS32), (void*)&ObjDict_obj1011_Restore_All_Default_Parameters },
@@ -188,7 +190,7 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
 
 /* index 0x1014 :   Emergency COB ID. */
                     UNS32 ObjDict_obj1014 = 0x80;	/* 128 */
-                    subindex ObjDict_Index1014[] = 
+                    const subindex ObjDict_Index1014[] = 
                      {
                        { RW, uint32, sizeof (UNS32), (void*)&ObjDict_obj1014 }
                      };
@@ -199,7 +201,7 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                     {
                       0x0	/* 0 */
                     };
-                    subindex ObjDict_Index1016[] = 
+                    const subindex ObjDict_Index1016[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj1016 },
                        { RW, uint32, sizeof (UNS32), (void*)&ObjDict_obj1016[0] }
@@ -211,18 +213,18 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                      {
                        NULL,
                      };
-                    subindex ObjDict_Index1017[] = 
+                    const subindex ObjDict_Index1017[] = 
                      {
                        { RW, uint16, sizeof (UNS16), (void*)&ObjDict_obj1017 }
                      };
 
 /* index 0x1018 :   Identity. */
-                    UNS8 ObjDict_highestSubIndex_obj1018 = 4; /* number of subindex - 1*/
-                    UNS32 ObjDict_obj1018_Vendor_ID = 0x0;	/* 0 */
-                    UNS32 ObjDict_obj1018_Product_Code = 0x0;	/* 0 */
-                    UNS32 ObjDict_obj1018_Revision_Number = 0x0;	/* 0 */
-                    UNS32 ObjDict_obj1018_Serial_Number = 0x0;	/* 0 */
-                    subindex ObjDict_Index1018[] = 
+                    const UNS8 ObjDict_highestSubIndex_obj1018 = 4; /* number of subindex - 1*/
+                    const UNS32 ObjDict_obj1018_Vendor_ID = 0x0;	/* 0 */
+                    const UNS32 ObjDict_obj1018_Product_Code = 0x0;	/* 0 */
+                    const UNS32 ObjDict_obj1018_Revision_Number = 0x0;	/* 0 */
+                    const UNS32 ObjDict_obj1018_Serial_Number = 0x0;	/* 0 */
+                    const subindex ObjDict_Index1018[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj1018 },
                        { RO, uint32, sizeof (UNS32), (void*)&ObjDict_obj1018_Vendor_ID },
@@ -235,7 +237,7 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                     UNS8 ObjDict_highestSubIndex_obj1200 = 2; /* number of subindex - 1*/
                     UNS32 ObjDict_obj1200_COB_ID_Client_to_Server_Receive_SDO = 0x600;	/* 1536 */
                     UNS32 ObjDict_obj1200_COB_ID_Server_to_Client_Transmit_SDO = 0x580;	/* 1408 */
-                    subindex ObjDict_Index1200[] = 
+                    const subindex ObjDict_Index1200[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj1200 },
                        { RO, uint32, sizeof (UNS32), (void*)&ObjDict_obj1200_COB_ID_Client_to_Server_Receive_SDO },
@@ -249,7 +251,7 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                     UNS16 ObjDict_obj1400_Inhibit_Time = 0x0;	/* 0 */
                     UNS8 ObjDict_obj1400_Compatibility_Entry = 0x0;	/* 0 */
                     UNS16 ObjDict_obj1400_Event_Timer = 0x0;	/* 0 */
-                    subindex ObjDict_Index1400[] = 
+                    const subindex ObjDict_Index1400[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj1400 },
                        { RW, uint32, sizeof (UNS32), (void*)&ObjDict_obj1400_COB_ID_used_by_PDO },
@@ -265,7 +267,7 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                     {
                       0x62000108	/* 1644167432 */
                     };
-                    subindex ObjDict_Index1600[] = 
+                    const subindex ObjDict_Index1600[] = 
                      {
                        { RW, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj1600 },
                        { RW, uint32, sizeof (UNS32), (void*)&ObjDict_obj1600[0] }
@@ -275,7 +277,7 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                     UNS8 ObjDict_highestSubIndex_obj1800 = 5; /* number of subindex - 1*/
                     UNS32 ObjDict_obj1800_COB_ID_used_by_PDO = 0x180;	/* 384 */
                     UNS8 ObjDict_obj1800_Transmission_Type = 0xFF;	/* 255 */
-                    UNS16 ObjDict_obj1800_Inhibit_Time = 0x0;	/* 0 */
+                    UNS16 ObjDict_obj1800_Inhibit_Time = 0x64;	/* 100 */
                     UNS8 ObjDict_obj1800_Compatibility_Entry = 0x0;	/* 0 */
                     UNS16 ObjDict_obj1800_Event_Timer = 0x0;	/* 0 */
                     ODCallback_t ObjDict_Index1800_callbacks[] = 
@@ -287,7 +289,7 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                        NULL,
                        NULL,
                      };
-                    subindex ObjDict_Index1800[] = 
+                    const subindex ObjDict_Index1800[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj1800 },
                        { RW, uint32, sizeof (UNS32), (void*)&ObjDict_obj1800_COB_ID_used_by_PDO },
@@ -303,93 +305,99 @@ $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
                     {
                       0x60000108	/* 1610613000 */
                     };
-                    subindex ObjDict_Index1A00[] = 
+                    const subindex ObjDict_Index1A00[] = 
                      {
                        { RW, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj1A00 },
                        { RW, uint32, sizeof (UNS32), (void*)&ObjDict_obj1A00[0] }
                      };
 
+/* index 0x2000 :   Mapped variable Configuration Data */
+                    const subindex ObjDict_Index2000[] = 
+                     {
+                       { RW, domain, sizeof (Configuration_Data), (void*)&Configuration_Data }
+                     };
+
 /* index 0x6000 :   Mapped variable Read Inputs 8 Bit */
-                    UNS8 ObjDict_highestSubIndex_obj6000 = 1; /* number of subindex - 1*/
-                    subindex ObjDict_Index6000[] = 
+                    const UNS8 ObjDict_highestSubIndex_obj6000 = 1; /* number of subindex - 1*/
+                    const subindex ObjDict_Index6000[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj6000 },
                        { RO, uint8, sizeof (UNS8), (void*)&Read_Inputs_8_Bit[0] }
                      };
 
 /* index 0x6002 :   Mapped variable Polarity Input 8 Bit */
-                    UNS8 ObjDict_highestSubIndex_obj6002 = 1; /* number of subindex - 1*/
-                    subindex ObjDict_Index6002[] = 
+                    const UNS8 ObjDict_highestSubIndex_obj6002 = 1; /* number of subindex - 1*/
+                    const subindex ObjDict_Index6002[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj6002 },
                        { RW, uint8, sizeof (UNS8), (void*)&Polarity_Input_8_Bit[0] }
                      };
 
 /* index 0x6003 :   Mapped variable Filter Constant Input 8 Bit */
-                    UNS8 ObjDict_highestSubIndex_obj6003 = 1; /* number of subindex - 1*/
-                    subindex ObjDict_Index6003[] = 
+                    const UNS8 ObjDict_highestSubIndex_obj6003 = 1; /* number of subindex - 1*/
+                    const subindex ObjDict_Index6003[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj6003 },
                        { RW, uint8, sizeof (UNS8), (void*)&Filter_Constant_Input_8_Bit[0] }
                      };
 
 /* index 0x6005 :   Mapped variable Global Interrupt Enable Digital */
-                    subindex ObjDict_Index6005[] = 
+                    const subindex ObjDict_Index6005[] = 
                      {
                        { RW, boolean, sizeof (UNS8), (void*)&Global_Interrupt_Enable_Digital }
                      };
 
 /* index 0x6006 :   Mapped variable Interrupt Mask Any Change 8 Bit */
-                    UNS8 ObjDict_highestSubIndex_obj6006 = 1; /* number of subindex - 1*/
-                    subindex ObjDict_Index6006[] = 
+                    const UNS8 ObjDict_highestSubIndex_obj6006 = 1; /* number of subindex - 1*/
+                    const subindex ObjDict_Index6006[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj6006 },
                        { RW, uint8, sizeof (UNS8), (void*)&Interrupt_Mask_Any_Change_8_Bit[0] }
                      };
 
 /* index 0x6007 :   Mapped variable Interrupt Mask Low to High 8 Bit */
-                    UNS8 ObjDict_highestSubIndex_obj6007 = 1; /* number of subindex - 1*/
-                    subindex ObjDict_Index6007[] = 
+                    const UNS8 ObjDict_highestSubIndex_obj6007 = 1; /* number of subindex - 1*/
+                    const subindex ObjDict_Index6007[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj6007 },
                        { RW, uint8, sizeof (UNS8), (void*)&Interrupt_Mask_Low_to_High_8_Bit[0] }
                      };
 
 /* index 0x6008 :   Mapped variable Interrupt Mask High to Low 8 Bit */
-                    UNS8 ObjDict_highestSubIndex_obj6008 = 1; /* number of subindex - 1*/
-                    subindex ObjDict_Index6008[] = 
+                    const UNS8 ObjDict_highestSubIndex_obj6008 = 1; /* number of subindex - 1*/
+                    const subindex ObjDict_Index6008[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj6008 },
                        { RW, uint8, sizeof (UNS8), (void*)&Interrupt_Mask_High_to_Low_8_Bit[0] }
                      };
 
 /* index 0x6200 :   Mapped variable Write Outputs 8 Bit */
-                    UNS8 ObjDict_highestSubIndex_obj6200 = 1; /* number of subindex - 1*/
-                    subindex ObjDict_Index6200[] = 
+                    const UNS8 ObjDict_highestSubIndex_obj6200 = 1; /* number of subindex - 1*/
+                    const subindex ObjDict_Index6200[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj6200 },
                        { RW, uint8, sizeof (UNS8), (void*)&Write_Outputs_8_Bit[0] }
                      };
 
 /* index 0x6202 :   Mapped variable Change Polarity Outputs 8 Bit */
-                    UNS8 ObjDict_highestSubIndex_obj6202 = 1; /* number of subindex - 1*/
-                    subindex ObjDict_Index6202[] = 
+                    const UNS8 ObjDict_highestSubIndex_obj6202 = 1; /* number of subindex - 1*/
+                    const subindex ObjDict_Index6202[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj6202 },
                        { RW, uint8, sizeof (UNS8), (void*)&Change_Polarity_Outputs_8_Bit[0] }
                      };
 
 /* index 0x6206 :   Mapped variable Error Mode Outputs 8 Bit */
-                    UNS8 ObjDict_highestSubIndex_obj6206 = 1; /* number of subindex - 1*/
-                    subindex ObjDict_Index6206[] = 
+                    const UNS8 ObjDict_highestSubIndex_obj6206 = 1; /* number of subindex - 1*/
+                    const subindex ObjDict_Index6206[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj6206 },
                        { RW, uint8, sizeof (UNS8), (void*)&Error_Mode_Outputs_8_Bit[0] }
                      };
 
 /* index 0x6207 :   Mapped variable Error Value Outputs 8 Bit */
-                    UNS8 ObjDict_highestSubIndex_obj6207 = 1; /* number of subindex - 1*/
-                    subindex ObjDict_Index6207[] = 
+                    const UNS8 ObjDict_highestSubIndex_obj6207 = 1; /* number of subindex - 1*/
+                    const subindex ObjDict_Index6207[] = 
                      {
                        { RO, uint8, sizeof (UNS8), (void*)&ObjDict_highestSubIndex_obj6207 },
                        { RW, uint8, sizeof (UNS8), (void*)&Error_Value_Outputs_8_Bit[0] }
@@ -419,6 +427,7 @@ const indextable ObjDict_objdict[] =
   { (subindex*)ObjDict_Index1600,sizeof(ObjDict_Index1600)/sizeof(ObjDict_Index1600[0]), 0x1600},
   { (subindex*)ObjDict_Index1800,sizeof(ObjDict_Index1800)/sizeof(ObjDict_Index1800[0]), 0x1800},
   { (subindex*)ObjDict_Index1A00,sizeof(ObjDict_Index1A00)/sizeof(ObjDict_Index1A00[0]), 0x1A00},
+  { (subindex*)ObjDict_Index2000,sizeof(ObjDict_Index2000)/sizeof(ObjDict_Index2000[0]), 0x2000},
   { (subindex*)ObjDict_Index6000,sizeof(ObjDict_Index6000)/sizeof(ObjDict_Index6000[0]), 0x6000},
   { (subindex*)ObjDict_Index6002,sizeof(ObjDict_Index6002)/sizeof(ObjDict_Index6002[0]), 0x6002},
   { (subindex*)ObjDict_Index6003,sizeof(ObjDict_Index6003)/sizeof(ObjDict_Index6003[0]), 0x6003},
@@ -432,46 +441,60 @@ const indextable ObjDict_objdict[] =
   { (subindex*)ObjDict_Index6207,sizeof(ObjDict_Index6207)/sizeof(ObjDict_Index6207[0]), 0x6207},
 };
 
+/* Callbacks of each entry of ObjDict_objdict in the same order */
+static ODCallback_t * const ObjDict_callbacks[] =
+{
+  NULL,
+  NULL,
+  ObjDict_Index1003_callbacks,
+  ObjDict_Index1005_callbacks,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  ObjDict_Index1017_callbacks,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  ObjDict_Index1800_callbacks,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL
+};
+
+/* Binary search of ObjDict_objdict, which is sorted by index */
 const indextable * ObjDict_scanIndexOD (UNS16 wIndex, UNS32 * errorCode, ODCallback_t **callbacks)
 {
+	int low = 0;
+	int high = sizeof(ObjDict_objdict)/sizeof(ObjDict_objdict[0]) - 1;
 	int i;
-	*callbacks = NULL;
-	switch(wIndex){
-		case 0x1000: i = 0;break;
-		case 0x1001: i = 1;break;
-		case 0x1003: i = 2;*callbacks = ObjDict_Index1003_callbacks; break;
-		case 0x1005: i = 3;*callbacks = ObjDict_Index1005_callbacks; break;
-		case 0x1008: i = 4;break;
-		case 0x1009: i = 5;break;
-		case 0x100A: i = 6;break;
-		case 0x1010: i = 7;break;
-		case 0x1011: i = 8;break;
-		case 0x1014: i = 9;break;
-		case 0x1016: i = 10;break;
-		case 0x1017: i = 11;*callbacks = ObjDict_Index1017_callbacks; break;
-		case 0x1018: i = 12;break;
-		case 0x1200: i = 13;break;
-		case 0x1400: i = 14;break;
-		case 0x1600: i = 15;break;
-		case 0x1800: i = 16;*callbacks = ObjDict_Index1800_callbacks; break;
-		case 0x1A00: i = 17;break;
-		case 0x6000: i = 18;break;
-		case 0x6002: i = 19;break;
-		case 0x6003: i = 20;break;
-		case 0x6005: i = 21;break;
-		case 0x6006: i = 22;break;
-		case 0x6007: i = 23;break;
-		case 0x6008: i = 24;break;
-		case 0x6200: i = 25;break;
-		case 0x6202: i = 26;break;
-		case 0x6206: i = 27;break;
-		case 0x6207: i = 28;break;
-		default:
-			*errorCode = OD_NO_SUCH_OBJECT;
-			return NULL;
+	while (low <= high) {
+		i = (low + high) / 2;
+		if (ObjDict_objdict[i].index == wIndex) {
+			*callbacks = ObjDict_callbacks[i];
+			*errorCode = OD_SUCCESSFUL;
+			return &ObjDict_objdict[i];
+		}
+		if (ObjDict_objdict[i].index < wIndex) low = i + 1;
+		else high = i - 1;
 	}
-	*errorCode = OD_SUCCESSFUL;
-	return &ObjDict_objdict[i];
+	*callbacks = NULL;
+	*errorCode = OD_NO_SUCH_OBJECT;
+	return NULL;
 }
 
 /* 
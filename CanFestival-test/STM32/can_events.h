@@ -0,0 +1,48 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+STM32 Port: Ken Sarkies, based on AVR Port: Andreas GLAUSER and Peter CHRISTEN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/* Pending events for an event driven main loop. The ISRs set the events and
+the main loop sleeps until one is set, then runs the stack for those events
+only. Under FreeRTOS the events unblock the tasks that run the stack. */
+
+#ifndef __CAN_EVENTS__
+#define __CAN_EVENTS__
+
+#include "applicfg.h"
+
+// Event bits
+#define CAN_EVENT_TICK                  0x01	// application tick (TIM2)
+#define CAN_EVENT_ALARM                 0x02	// CANopen alarm due (TIM3)
+#define CAN_EVENT_RX                    0x04	// frame in the receive queue
+#define CAN_EVENT_INPUT                 0x08	// digital input edge (EXTI)
+
+void can_event_set(UNS8 events);
+UNS8 can_event_wait(void);
+
+// FreeRTOS build, can_events-freertos.c in place of can_events.c: each event
+// wakes the one task that waits for it
+void can_event_init(void);
+void can_event_take(UNS8 event);
+
+#endif
@@ -0,0 +1,35 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+STM32 Port: Ken Sarkies, based on AVR Port: Andreas GLAUSER and Peter CHRISTEN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __CAN_HOST__
+#define __CAN_HOST__
+
+#include "can.h"
+
+/* Host CAN driver, port/can_host.c. The driver calls of can_stm32.h are the
+same; these stand in for the bus. */
+void can_host_loopback(unsigned char on);
+unsigned char can_host_inject(const Message *m);
+unsigned char can_host_take(Message *m);
+
+#endif
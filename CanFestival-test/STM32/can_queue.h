@@ -0,0 +1,51 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+STM32 Port: Ken Sarkies, based on AVR Port: Andreas GLAUSER and Peter CHRISTEN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Single producer, single consumer queue of CAN messages between an ISR and
+the main program. The producer fills a slot in place and commits it, and the
+consumer takes the oldest slot in place or copies it out, so a frame is never
+passed byte by byte. Neither side needs to mask interrupts. */
+
+#ifndef __CAN_QUEUE__
+#define __CAN_QUEUE__
+
+#include <stddef.h>
+#include "can.h"
+
+typedef struct
+{
+	Message *message;		/* Storage of size entries */
+	UNS8 mask;			/* size - 1, size being a power of two */
+	volatile UNS8 head;		/* Next slot to fill, changed by the producer */
+	volatile UNS8 tail;		/* Oldest slot, changed by the consumer */
+} can_queue;
+
+void can_queue_init(can_queue *q, Message *storage, UNS8 size);
+Message *can_queue_reserve(can_queue *q);
+void can_queue_commit(can_queue *q);
+Message *can_queue_peek(can_queue *q);
+void can_queue_release(can_queue *q);
+unsigned char can_queue_put(can_queue *q, const Message *m);
+unsigned char can_queue_get(can_queue *q, Message *m);
+unsigned char can_queue_empty(can_queue *q);
+#endif
@@ -0,0 +1,50 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+STM32 Port: Ken Sarkies, based on AVR Port: Andreas GLAUSER and Peter CHRISTEN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __CAN_STM32__
+#define __CAN_STM32__
+
+// STM32 bxCAN implementation of the CANopen driver includes
+#include "config.h"
+
+// Canfestivals includes
+#include "can.h"
+#include "data.h"
+
+// Messages held between the ISRs and the stack (powers of two). The transmit
+// queue and the three mailboxes take a whole SDO block with room to spare.
+#define CAN_RX_QUEUE_SIZE               32
+#define CAN_TX_QUEUE_SIZE               32
+
+#if (CAN_TX_QUEUE_SIZE - 1 + 3) < (SDO_BLOCK_SIZE + 4)
+#error CAN_TX_QUEUE_SIZE is too small for an SDO block
+#endif
+
+/************************* To be called by user app ***************************/
+
+unsigned char canInit(unsigned int bitrate);
+unsigned char canSend(CAN_PORT notused, Message *m);
+unsigned char canReceive(Message *m);
+unsigned char canChangeBaudRate_driver( CAN_HANDLE fd, char* baud);
+void canFiltersUpdate(CO_Data *d);
+#endif
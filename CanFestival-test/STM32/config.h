@@ -28,7 +28,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 // Needed defines by Canfestival lib
 #define MAX_CAN_BUS_ID 1
-#define SDO_MAX_LENGTH_TRANSFER 32
+// The SDO line buffer holds a whole transfer, so it is as long as the largest
+// object (Configuration_Data at 0x2000) for block transfers to it
+#define SDO_MAX_LENGTH_TRANSFER 1024
+// Segments in a block, which the CAN drivers must be able to queue at once
 #define SDO_BLOCK_SIZE 16
 #define SDO_MAX_SIMULTANEOUS_TRANSFERS 1
 #define NMT_MAX_NODE_ID 128
@@ -38,7 +41,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 // CANOPEN_BIG_ENDIAN is not defined
 #define CANOPEN_LITTLE_ENDIAN 1
 
-#define US_TO_TIMEVAL_FACTOR 8
+#define US_TO_TIMEVAL_FACTOR 1
 
 #define REPEAT_SDO_MAX_SIMULTANEOUS_TRANSFERS_TIMES(repeat)\
 repeat
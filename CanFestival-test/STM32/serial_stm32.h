@@ -46,10 +46,26 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #define START_TX_MOB                    NB_RX_MOB
 #define TX_INT_MSK			((0x7F << (7 - NB_TX_MOB)) & 0x7F)
 
+// Tunnel frame: SYNC, COB-ID low byte, COB-ID high bits 0-2 | RTR bit 3 |
+// length bits 4-7, data, CRC8 (polynomial 0x07) of all but the SYNC byte
+#define TUNNEL_SYNC                     0xA5
+#define TUNNEL_HEADER                   3
+#define TUNNEL_FRAME_MAX                (TUNNEL_HEADER + 8 + 1)
+
+// Batching: 1 holds frames until canFlush so that several go in one DMA
+// burst, 0 starts the DMA on each canSend
+#define TUNNEL_BATCH                    1
+// Held bytes that start the DMA without waiting for canFlush
+#define TUNNEL_BATCH_BYTES              64
+
 /************************* To be called by user app ***************************/
 
 unsigned char canInit(unsigned int bitrate);
 unsigned char canSend(CAN_PORT notused, Message *m);
 unsigned char canReceive(Message *m);
 unsigned char canChangeBaudRate_driver( CAN_HANDLE fd, char* baud);
+void canFlush(void);
+
+// The tunnel passes all frames, there are no acceptance filters to follow
+#define canFiltersUpdate(d)
 #endif
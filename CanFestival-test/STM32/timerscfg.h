@@ -24,19 +24,22 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #ifndef __TIMERSCFG_H__
 #define __TIMERSCFG_H__
 
-/* TIMEVAL is set to 32 bits but as the timers are 16 bits and the
-maximum count is less than 0xFFFF, it could be set to 16 bits */
+/* TIMEVAL is 32 bits. The 16 bit timer is extended to 32 bits in software by
+counting its overflows. */
 
 #define TIMEVAL UNS32
 
-/* The timer of the STM32 series counts to s preset period then restarts
-if it has been placed in upcounting mode. This allows 0.5 seconds cycle
-time for an 8us clock period. */
+/* The timer counts 1us ticks. TIMEVAL_MAX is kept to half the 32 bit range so
+that times can be compared across the wrap, so the longest alarm is about
+35 minutes. */
 
-#define TIMEVAL_MAX 62500
+#define TIMEVAL_MAX 0x7FFFFFFF
 
-// The timer is incrementing every 8 us.
-#define MS_TO_TIMEVAL(ms) ((ms) * 125)
-#define US_TO_TIMEVAL(us) ((us)>>3)
+// The timer is incrementing every 1 us.
+#define MS_TO_TIMEVAL(ms) ((ms) * 1000)
+#define US_TO_TIMEVAL(us) (us)
+
+// Present time of the timebase in us, for timestamps
+TIMEVAL getTimeStamp(void);
 
 #endif
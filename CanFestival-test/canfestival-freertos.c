@@ -0,0 +1,278 @@
+/*      Test of CANFestival drivers with FreeRTOS as scheduler
+
+This runs the node of main.c as FreeRTOS tasks, so that the CANopen stack can
+share the processor with other work such as MODBUS or logging while the PDO
+latency stays bounded.
+
+The receive ISRs fill the driver's receive queue and wake a high priority
+dispatch task, which passes every queued frame to canDispatch. The TIM3 alarm
+wakes a timer task that calls TimeDispatch, and the ds401 I/O handlers run in
+a periodic task paced by vTaskDelayUntil. The stack is entered by all three,
+so each holds the stack mutex through EnterMutex and LeaveMutex while it is
+inside. The mutex has priority inheritance, so the I/O task cannot hold up
+the dispatch task for longer than one pass of the handlers.
+
+Build with port/can_events-freertos.c in place of port/can_events.c, and with
+the FreeRTOS sources and FreeRTOSConfig.h given here.
+
+14 October 2026
+*/
+
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <STM32/canfestival.h>
+#ifdef CAN_SERIAL_TUNNEL
+#include <STM32/serial_stm32.h>
+#else
+#include <STM32/can_stm32.h>
+#endif
+#include <STM32/timerscfg.h>
+#include <STM32/can_events.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/cm3/nvic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "ObjDict.h"
+#include "ds401.h"
+#include "irq_priority.h"
+
+/* The dispatch task runs ahead of everything so that received frames are
+handled at once, then the CANopen timers, then the I/O. */
+#define TASK_DISPATCH_STACK_SIZE        256
+#define TASK_DISPATCH_PRIORITY          (tskIDLE_PRIORITY + 3)
+#define TASK_TIMER_STACK_SIZE           256
+#define TASK_TIMER_PRIORITY             (tskIDLE_PRIORITY + 2)
+#define TASK_IO_STACK_SIZE              256
+#define TASK_IO_PRIORITY                (tskIDLE_PRIORITY + 1)
+
+/* Period of the I/O sampling */
+#define IO_PERIOD_MS                    1
+
+#ifdef CAN_SERIAL_TUNNEL
+#define tunnel_flush()                  canFlush()
+#else
+#define tunnel_flush()
+#endif
+
+// CAN
+unsigned char nodeID = 0x04;
+unsigned char digital_input[1] = {0};
+unsigned char digital_output[1] = {0};
+
+static xSemaphoreHandle stack_mutex;
+
+void set_outputs(unsigned char data);
+unsigned char get_inputs(void);
+static void sys_init(void);
+static void task_dispatch(void *arg);
+static void task_timer(void *arg);
+static void task_io(void *arg);
+
+int main(void)
+{
+    sys_init();                                 // Initialize hardware
+    can_event_init();                           // Semaphores used by the ISRs
+    stack_mutex = xSemaphoreCreateMutex();
+
+    if (stack_mutex == NULL)
+    {
+    }
+    else if (pdPASS != xTaskCreate(task_dispatch, "CANRX",
+                      TASK_DISPATCH_STACK_SIZE, NULL, TASK_DISPATCH_PRIORITY, NULL))
+    {
+    }
+    else if (pdPASS != xTaskCreate(task_timer, "CANTIMER",
+                      TASK_TIMER_STACK_SIZE, NULL, TASK_TIMER_PRIORITY, NULL))
+    {
+    }
+    else if (pdPASS != xTaskCreate(task_io, "IO",
+                      TASK_IO_STACK_SIZE, NULL, TASK_IO_PRIORITY, NULL))
+    {
+    }
+    else
+    {
+        vTaskStartScheduler();
+    }
+    return 1;
+}
+
+/******************************************************************************
+Take and release the stack mutex around every entry to the CANopen stack.
+******************************************************************************/
+
+void EnterMutex(void)
+{
+	xSemaphoreTake(stack_mutex, portMAX_DELAY);
+}
+
+void LeaveMutex(void)
+{
+	xSemaphoreGive(stack_mutex);
+}
+
+/******************************************************************************
+Dispatch task
+Start the CAN bus and the stack, which is done here so that no ISR posts an
+event before the scheduler runs. Then sleep until the receive ISR has queued
+frames, and pass all of them to the stack.
+******************************************************************************/
+
+static void task_dispatch(void *arg)
+{
+	Message m = Message_Initializer;
+
+	canInit(CAN_BAUDRATE);			// Initialize the CANopen bus
+	initTimer();				// Start timer for the CANopen stack
+	EnterMutex();
+	setNodeId(&ObjDict_Data, nodeID);
+	canFiltersUpdate(&ObjDict_Data);	// Pass only our COB-IDs
+	setState(&ObjDict_Data, Initialisation);
+	tunnel_flush();
+	LeaveMutex();
+
+	for (;;)
+	{
+		can_event_take(CAN_EVENT_RX);
+		while (canReceive(&m))
+		{
+			EnterMutex();
+			canDispatch(&ObjDict_Data, &m);
+			canFiltersUpdate(&ObjDict_Data);	// follow COB-ID changes
+			tunnel_flush();
+			LeaveMutex();
+		}
+	}
+}
+
+/******************************************************************************
+Timer task
+Sleep until the TIM3 alarm is due and run the CANopen timers.
+******************************************************************************/
+
+static void task_timer(void *arg)
+{
+	for (;;)
+	{
+		can_event_take(CAN_EVENT_ALARM);
+		EnterMutex();
+		TimeDispatch();
+		tunnel_flush();
+		LeaveMutex();
+	}
+}
+
+/******************************************************************************
+I/O task
+Sample the inputs and update the outputs every IO_PERIOD_MS, with no drift
+however long the stack takes, as the period is counted from the last wake.
+******************************************************************************/
+
+static void task_io(void *arg)
+{
+	unsigned char error;
+	portTickType last_wake = xTaskGetTickCount();
+
+	for (;;)
+	{
+		vTaskDelayUntil(&last_wake, IO_PERIOD_MS / portTICK_RATE_MS);
+		digital_input[0] = get_inputs();
+		EnterMutex();
+		digital_input_handler(&ObjDict_Data, digital_input,
+				      sizeof(digital_input));
+		error = digital_output_handler(&ObjDict_Data, digital_output,
+					       sizeof(digital_output));
+		if (error == 0) EMCY_setError(&ObjDict_Data,1,1,45);
+		else EMCY_errorRecovered(&ObjDict_Data,1);
+		tunnel_flush();
+		LeaveMutex();
+		set_outputs(digital_output[0]);
+	}
+}
+
+/******************************************************************************
+Initialize the hardware and process ports. The FreeRTOS tick replaces the TIM2
+tick of main.c.
+The ISRs that set events must be at or below the maximum syscall priority.
+INPUT	void
+OUTPUT	void
+******************************************************************************/
+
+static void sys_init(void)
+{
+/* Clock setup to 72MHz */
+	rcc_clock_setup_in_hse_8mhz_out_72mhz();
+/* gpio setup */
+	rcc_peripheral_enable_clock(&RCC_APB2ENR, RCC_APB2ENR_IOPBEN);
+/* GPIO LED Ports */
+	gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_2_MHZ,
+		      GPIO_CNF_OUTPUT_PUSHPULL, GPIO8 | GPIO9 | GPIO10 | GPIO11 |
+              GPIO12 | GPIO13 | GPIO14 | GPIO15);
+/* Interrupt priorities for the CAN, tunnel USART and CANopen timer ISRs,
+which set events for the tasks. The transmit mailbox ISR only refills the
+mailboxes from the queue, so it stays above the syscall ceiling. */
+	IRQ_PRIORITY_SET_RTOS(NVIC_USB_LP_CAN_RX0_IRQ, IRQ_LEVEL_RTOS_COMM);
+	IRQ_PRIORITY_SET_RTOS(NVIC_CAN_RX1_IRQ, IRQ_LEVEL_RTOS_COMM);
+	IRQ_PRIORITY_SET(NVIC_USB_HP_CAN_TX_IRQ, IRQ_LEVEL_COMM);
+	IRQ_PRIORITY_SET_RTOS(NVIC_USART1_IRQ, IRQ_LEVEL_RTOS_COMM);
+#ifdef SOFT_TIMER
+	IRQ_PRIORITY_SET_RTOS(NVIC_TIM4_IRQ, IRQ_LEVEL_RTOS_TIMER);
+#else
+	IRQ_PRIORITY_SET_RTOS(NVIC_TIM3_IRQ, IRQ_LEVEL_RTOS_TIMER);
+#endif
+}
+
+/******************************************************************************
+Write out the data byte to the LED port of the ET-STM32F103
+******************************************************************************/
+
+void set_outputs(unsigned char data)
+{
+/* Shift the data by 8 bits and output to LEDs */
+    gpio_port_write(GPIOB, (uint) data << 8);
+}
+
+/******************************************************************************
+Read in a data byte from the switch port of the ET-STM32F103
+******************************************************************************/
+
+unsigned char get_inputs(void)
+{
+    return 0;
+}
+
+void vApplicationStackOverflowHook(xTaskHandle *pxTask, signed char *pcTaskName)
+{
+	(void) pxTask;
+	(void) pcTaskName;
+	for (;;);
+}
+
+void vApplicationIdleHook(void)
+{
+}
+
+void vApplicationTickHook(void)
+{
+}
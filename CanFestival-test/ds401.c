@@ -25,15 +25,40 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 // Includes for the Canfestival
 #include "ds401.h"
 
+// Inputs waiting to be accepted, and the calls they have been steady for
+static unsigned char input_sample[sizeof(Read_Inputs_8_Bit)];
+static unsigned char input_steady[sizeof(Read_Inputs_8_Bit)];
+
+/* Take a sample of the inputs into Read_Inputs_8_Bit and send the PDO on the
+changes enabled by the interrupt masks. Inputs with their bit set in
+Filter_Constant_Input_8_Bit are only accepted once they have held the same
+value for DS401_FILTER_SAMPLES calls, the others at once. The PDO is sent
+subject to its inhibit time, so a chattering input is limited in rate.
+Returns 1 when the inputs are settled, or 0 when a filtered input is still
+changing and the handler should be called again on the next tick. */
 unsigned char digital_input_handler(CO_Data* d, unsigned char *newInput, unsigned char size)
 {
-  unsigned char loops, i, input, transmission = 0;
+  unsigned char loops, i, input, filter, transmission = 0, settled = 1;
 
   loops = (sizeof(Read_Inputs_8_Bit) <= size) ? sizeof(Read_Inputs_8_Bit) : size;
 
   for (i=0; i < loops; i++)
   {
     input = *newInput ^ Polarity_Input_8_Bit[i];
+    filter = Filter_Constant_Input_8_Bit[i];
+    // restart the filter count whenever a filtered input moves
+    if ((input ^ input_sample[i]) & filter)
+      input_steady[i] = 0;
+    else if (input_steady[i] < DS401_FILTER_SAMPLES)
+      input_steady[i]++;
+    input_sample[i] = input;
+    // hold filtered inputs at their last value until they are steady
+    if (input_steady[i] < DS401_FILTER_SAMPLES)
+    {
+      if ((input ^ Read_Inputs_8_Bit[i]) & filter)
+        settled = 0;
+      input = (input & ~filter) | (Read_Inputs_8_Bit[i] & filter);
+    }
     if (Read_Inputs_8_Bit[i] != input)
     {
       if (Global_Interrupt_Enable_Digital)
@@ -55,7 +80,7 @@ unsigned char digital_input_handler(CO_Data* d, unsigned char *newInput, unsigne
     sendPDOevent(d);
   }
 
-  return 1;
+  return settled;
 }
 
 unsigned char digital_output_handler(CO_Data* d, unsigned char *newOutput, unsigned char size)
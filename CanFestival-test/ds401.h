@@ -30,6 +30,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "timer.h"
 #include "ObjDict.h"
 
+// Samples a filtered input must hold its value for before it is accepted
+#define DS401_FILTER_SAMPLES 5
 
 unsigned char digital_input_handler(CO_Data* d, unsigned char *newInput, unsigned char size);
 
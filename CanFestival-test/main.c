@@ -2,11 +2,23 @@
 
 This is configured for the ET-STM32F103 development board.
 
-This example puts retrieved data to the LEDs on the board. Input commands,
-supposedly from the switches on the board, have not been implemented.
+This example puts retrieved data to the LEDs on the board. Input commands are
+read from PC0-7, where the switches of the board can be wired.
 
-TODO: Implement the communications interface along with serial communications
-to replace the CAN Bus interface.
+The CAN bus is driven by the bxCAN driver port/can_stm32.c at the rate
+CAN_BAUDRATE of config.h.
+
+The main loop sleeps until the TIM2 tick, the TIM3 CANopen alarm, a received
+frame or an input edge sets an event (port/can_events.c), then runs the stack
+for those events only. The inputs on PC0-7 are sampled only from an edge until
+they have settled, with the debounce of ds401.c, and the PDO they trigger is
+limited by its inhibit time. TimeDispatch is called from here rather than the
+timer ISR, so the stack is never entered from two places at once. For a board
+without a CAN transceiver build with port/serial_stm32.c instead and define
+CAN_SERIAL_TUNNEL, which tunnels the frames over USART1 and sends those held
+for batching at the end of each pass.
+Built with SOFT_TIMER the tick and the alarm are both software timers of
+common/soft_timer.c on TIM4, and TIM2 and TIM3 are left free.
 
 Reviewed: K. Sarkies 30/06/2015
 */
@@ -32,21 +44,33 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
 #include <STM32/canfestival.h>
+#ifdef CAN_SERIAL_TUNNEL
 #include <STM32/serial_stm32.h>
+#else
+#include <STM32/can_stm32.h>
+#endif
 #include <STM32/timerscfg.h>
+#include <STM32/can_events.h>
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/exti.h>
 #include <libopencm3/cm3/nvic.h>
 #include <stdint.h>
 #include <stdbool.h>
+#ifdef POWER_STATS
+#include "power_stats.h"
+#endif
+#include "isr_profile.h"
+#ifdef SOFT_TIMER
+#include "soft_timer.h"
+#endif
 #include "ObjDict.h"
 #include "ds401.h"
+#include "irq_priority.h"
 
-#define CAN_BAUDRATE 0
-
-unsigned char timer_interrupt = 0;	   // Set if timer interrupt elapsed
 unsigned char inputs;
+unsigned char input_sampling = 1;	// Set while the inputs are settling
 
 // CAN
 unsigned char nodeID;
@@ -55,27 +79,58 @@ unsigned char digital_output[1] = {0};
 
 static Message m = Message_Initializer;	        // contains a CAN message
 
+/* Digital inputs on PC0-7, each with its EXTI line */
+#define INPUT_PORT      GPIOC
+#define INPUT_PINS      (GPIO0 | GPIO1 | GPIO2 | GPIO3 | \
+                         GPIO4 | GPIO5 | GPIO6 | GPIO7)
+#define INPUT_LINES     (EXTI0 | EXTI1 | EXTI2 | EXTI3 | \
+                         EXTI4 | EXTI5 | EXTI6 | EXTI7)
+
 void set_outputs(unsigned char data);
 unsigned char get_inputs(void);
 void sys_init();
 
+#ifdef SOFT_TIMER
+/* The 1ms tick as a periodic software timer, in place of TIM2 */
+#define TICK_PERIOD     (SOFT_TIMER_TICK_HZ/1000)
+static soft_timer_t tick_timer;
+static void tick(soft_timer_t *timer);
+#endif
+
 int main(void)
 {
     sys_init();                                 // Initialize hardware
+#ifdef POWER_STATS
+    power_stats_init();                         // Time the sleeps
+#endif
+#ifdef ISR_PROFILE
+    isr_profile_init();                         // Time the interrupts
+#endif
     canInit(CAN_BAUDRATE);         		        // Initialize the CANopen bus
     initTimer();                                // Start timer for the CANopen stack
     nodeID = 0x04;				                // Read node ID first
     setNodeId(&ObjDict_Data, nodeID);
+    canFiltersUpdate(&ObjDict_Data);            // Pass only our COB-IDs
     setState(&ObjDict_Data, Initialisation);	// Initialise the state
 
     for(;;)
     {
-        if (timer_interrupt == 1)               // Invoke action on every time slice
+        UNS8 events = can_event_wait();         // Sleep until an ISR has work
+
+        if (events & CAN_EVENT_ALARM)           // a CANopen timer is due
+            TimeDispatch();
+
+        if (events & CAN_EVENT_INPUT)           // an input has changed
+            input_sampling = 1;
+
+        if (events & CAN_EVENT_TICK)            // Invoke action on every time slice
         {
-            timer_interrupt = 0;	            // Reset the cycle timer
-            digital_input[0] = get_inputs();
-            digital_input_handler(&ObjDict_Data, digital_input,
-                                  sizeof(digital_input));
+            if (input_sampling)                 // sample until the inputs settle
+            {
+                digital_input[0] = get_inputs();
+                input_sampling = ! digital_input_handler(&ObjDict_Data,
+                                    digital_input, sizeof(digital_input));
+            }
             unsigned char error;
             error = digital_output_handler(&ObjDict_Data, digital_output,
                     sizeof(digital_output));
@@ -84,15 +139,18 @@ int main(void)
             set_outputs(digital_output[0]);
         }
 
-// a message was received pass it to the CANstack
-        if (canReceive(&m))			            // a message received
-        {
-            canDispatch(&ObjDict_Data, &m);     // process it in the stack
-        }
-        else
+// messages were received pass them to the CANstack
+        if (events & CAN_EVENT_RX)
         {
-// Enter sleep mode
+            while (canReceive(&m))              // a message received
+            {
+                canDispatch(&ObjDict_Data, &m); // process it in the stack
+                canFiltersUpdate(&ObjDict_Data);// follow COB-ID changes
+            }
         }
+#ifdef CAN_SERIAL_TUNNEL
+        canFlush();                             // send the frames batched
+#endif
       }
 }
 
@@ -113,10 +171,43 @@ void sys_init()
 	gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_2_MHZ,
 		      GPIO_CNF_OUTPUT_PUSHPULL, GPIO8 | GPIO9 | GPIO10 | GPIO11 |
               GPIO12 | GPIO13 | GPIO14 | GPIO15);
+/* Digital inputs, with an interrupt on either edge of each */
+	rcc_peripheral_enable_clock(&RCC_APB2ENR, RCC_APB2ENR_IOPCEN |
+				    RCC_APB2ENR_AFIOEN);
+	gpio_set_mode(INPUT_PORT, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT,
+		      INPUT_PINS);
+	exti_select_source(INPUT_LINES, INPUT_PORT);
+	exti_set_trigger(INPUT_LINES, EXTI_TRIGGER_BOTH);
+	exti_reset_request(INPUT_LINES);
+	exti_enable_request(INPUT_LINES);
+/* Interrupt priorities by latency class (see irq_priority.h): the CAN and
+tunnel USART above the timers, above the input edges */
+	IRQ_PRIORITY_SET(NVIC_USB_LP_CAN_RX0_IRQ, IRQ_LEVEL_COMM);
+	IRQ_PRIORITY_SET(NVIC_CAN_RX1_IRQ, IRQ_LEVEL_COMM);
+	IRQ_PRIORITY_SET(NVIC_USB_HP_CAN_TX_IRQ, IRQ_LEVEL_COMM);
+	IRQ_PRIORITY_SET(NVIC_USART1_IRQ, IRQ_LEVEL_COMM);
+	IRQ_PRIORITY_SET(NVIC_TIM3_IRQ, IRQ_LEVEL_TIMER);
+	IRQ_PRIORITY_SET(NVIC_EXTI0_IRQ, IRQ_LEVEL_INPUT);
+	IRQ_PRIORITY_SET(NVIC_EXTI1_IRQ, IRQ_LEVEL_INPUT);
+	IRQ_PRIORITY_SET(NVIC_EXTI2_IRQ, IRQ_LEVEL_INPUT);
+	IRQ_PRIORITY_SET(NVIC_EXTI3_IRQ, IRQ_LEVEL_INPUT);
+	IRQ_PRIORITY_SET(NVIC_EXTI4_IRQ, IRQ_LEVEL_INPUT);
+	IRQ_PRIORITY_SET(NVIC_EXTI9_5_IRQ, IRQ_LEVEL_INPUT);
+	nvic_enable_irq(NVIC_EXTI0_IRQ);
+	nvic_enable_irq(NVIC_EXTI1_IRQ);
+	nvic_enable_irq(NVIC_EXTI2_IRQ);
+	nvic_enable_irq(NVIC_EXTI3_IRQ);
+	nvic_enable_irq(NVIC_EXTI4_IRQ);
+	nvic_enable_irq(NVIC_EXTI9_5_IRQ);
 /* Timer Setup */
+#ifdef SOFT_TIMER
+	soft_timer_init();
+	soft_timer_create(&tick_timer, tick, 0);
+	soft_timer_start(&tick_timer, TICK_PERIOD, TICK_PERIOD);
+#else
  	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM2EN);
+	IRQ_PRIORITY_SET(NVIC_TIM2_IRQ, IRQ_LEVEL_TIMER);
 	nvic_enable_irq(NVIC_TIM2_IRQ);
-	nvic_set_priority(NVIC_TIM2_IRQ, 1);
 	timer_reset(TIM2);
 /* Timer global mode: - Divider 4, Alignment edge, Direction up */
 	timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT,
@@ -130,6 +221,7 @@ void sys_init()
 	timer_enable_irq(TIM2, TIM_DIER_UIE);
 /* Start timer. */
 	timer_enable_counter(TIM2);
+#endif
 }
 
 /******************************************************************************
@@ -148,18 +240,70 @@ Read in a data byte from the switch port of the ET-STM32F103
 
 unsigned char get_inputs(void)
 {
-    return 0;
+    return (unsigned char) (gpio_port_read(INPUT_PORT) & INPUT_PINS);
+}
+
+/******************************************************************************
+An edge on any input starts sampling on the following ticks, until the inputs
+are settled. There is no sampling while the inputs are steady.
+******************************************************************************/
+
+static void input_edge(void)
+{
+	exti_reset_request(EXTI_PR & INPUT_LINES);
+	can_event_set(CAN_EVENT_INPUT);
+}
+
+void exti0_isr(void)
+{
+	input_edge();
+}
+
+void exti1_isr(void)
+{
+	input_edge();
+}
+
+void exti2_isr(void)
+{
+	input_edge();
+}
+
+void exti3_isr(void)
+{
+	input_edge();
+}
+
+void exti4_isr(void)
+{
+	input_edge();
+}
+
+void exti9_5_isr(void)
+{
+	input_edge();
 }
 
 /******************************************************************************
-Set a flag for the main loop to activate a sample of I/O every clock tick.
+Set an event for the main loop to activate a sample of I/O every clock tick.
 ******************************************************************************/
 
+#ifdef SOFT_TIMER
+static void tick(soft_timer_t *timer)
+{
+	(void) timer;
+  	can_event_set(CAN_EVENT_TICK);	/* Tell the main loop of the cycle timer tick */
+}
+
+#else
 void tim2_isr(void)
 {
+	ISR_PROFILE_ENTER(ISR_PROFILE_TIM2);
 	if (timer_get_flag(TIM2, TIM_SR_UIF)) 
         timer_clear_flag(TIM2, TIM_SR_UIF); /* Clear interrrupt flag. */
 /* Reread to force the previous (buffered) write before leaving */
 	timer_get_flag(TIM2, TIM_SR_UIF);
-  	timer_interrupt = 1;	        /* Set flag to indicate cycle timer tick */
+  	can_event_set(CAN_EVENT_TICK);	/* Tell the main loop of the cycle timer tick */
+	ISR_PROFILE_EXIT(ISR_PROFILE_TIM2);
 }
+#endif
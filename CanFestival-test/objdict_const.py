@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Post-process the object dictionary C file written by gen_cfile.py.
+
+Moves the parts of the dictionary that are never written into flash and
+replaces the index lookup switch with a binary search of the sorted index
+table:
+
+* every subindex table is made const, as the stack only reads them,
+* the values of read only entries that the stack does not write itself (the
+  device type, the names and versions, the identity) are made const,
+* ObjDict_scanIndexOD becomes a binary search of ObjDict_objdict, with the
+  callbacks of each entry in a parallel const table.
+
+    objdict_const.py ObjDict.c
+
+Run it each time the dictionary is generated. The file is changed in place and
+running it twice makes no further change.
+
+14 October 2026
+"""
+
+import re
+import sys
+
+MARK = "/* Post-processed by objdict_const.py: constant entries in flash. */"
+
+# Entries the stack writes through its own pointers, or at setNodeId, even
+# where the dictionary gives them as read only.
+STACK_WRITTEN = [
+    (0x1001, 0x1001),   # error register
+    (0x1003, 0x1003),   # pre-defined error field
+    (0x1005, 0x1006),   # SYNC COB-ID and cycle period
+    (0x1014, 0x1017),   # EMCY COB-ID, heartbeat consumers and producer
+    (0x1200, 0x12FF),   # SDO server and client parameters
+    (0x1400, 0x15FF),   # receive PDO parameters
+    (0x1800, 0x19FF),   # transmit PDO parameters
+]
+
+ENTRY = re.compile(r"\{\s*(\w+)\s*,\s*\w+\s*,[^,]+,\s*\(void\*\)\s*&?\s*(\w+)")
+TABLE = re.compile(r"^(\s*)subindex (\w+)_Index([0-9A-F]{4})\[\] =\s*\n\s*\{(.*?)\};",
+                   re.M | re.S)
+CASE = re.compile(r"case 0x([0-9A-F]{4}): i = (\d+);(?:\*callbacks = (\w+);)?")
+
+
+def stack_written(index):
+    return any(low <= index <= high for low, high in STACK_WRITTEN)
+
+
+def make_const(text, prefix):
+    # Access of every value referenced by a subindex table, by variable name
+    access = {}
+    for table in TABLE.finditer(text):
+        index = int(table.group(3), 16)
+        for entry in ENTRY.finditer(table.group(4)):
+            name = entry.group(2)
+            writable = entry.group(1) != "RO" or stack_written(index) or \
+                not name.startswith(prefix + "_")
+            access[name] = access.get(name, False) or writable
+    for name, writable in access.items():
+        if writable:
+            continue
+        text = re.sub(r"^(\s*)(?!const )(\w+ %s\b)" % re.escape(name),
+                      r"\1const \2", text, count=1, flags=re.M)
+    return re.sub(r"^(\s*)subindex (\w+_Index[0-9A-F]{4}\[\] =)",
+                  r"\1const subindex \2", text, flags=re.M)
+
+
+def make_search(text, prefix):
+    start = text.find("const indextable * %s_scanIndexOD" % prefix)
+    end = text.find("\n}\n", start)
+    if start < 0 or end < 0:
+        raise ValueError("no %s_scanIndexOD switch" % prefix)
+    cases = CASE.findall(text[start:end])
+    indexes = [int(index, 16) for index, _, _ in cases]
+    if [int(i) for _, i, _ in cases] != list(range(len(cases))) or \
+            indexes != sorted(indexes):
+        raise ValueError("index table is not in order")
+    callbacks = ",\n".join("  %s" % (cb or "NULL") for _, _, cb in cases)
+    search = """/* Callbacks of each entry of %(p)s_objdict in the same order */
+static ODCallback_t * const %(p)s_callbacks[] =
+{
+%(cb)s
+};
+
+/* Binary search of %(p)s_objdict, which is sorted by index */
+const indextable * %(p)s_scanIndexOD (UNS16 wIndex, UNS32 * errorCode, ODCallback_t **callbacks)
+{
+	int low = 0;
+	int high = sizeof(%(p)s_objdict)/sizeof(%(p)s_objdict[0]) - 1;
+	int i;
+	while (low <= high) {
+		i = (low + high) / 2;
+		if (%(p)s_objdict[i].index == wIndex) {
+			*callbacks = %(p)s_callbacks[i];
+			*errorCode = OD_SUCCESSFUL;
+			return &%(p)s_objdict[i];
+		}
+		if (%(p)s_objdict[i].index < wIndex) low = i + 1;
+		else high = i - 1;
+	}
+	*callbacks = NULL;
+	*errorCode = OD_NO_SUCH_OBJECT;
+	return NULL;""" % {"p": prefix, "cb": callbacks}
+    return text[:start] + search + text[end:]
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    name = sys.argv[1]
+    with open(name) as f:
+        text = f.read()
+    if MARK in text:
+        return 0
+    match = re.search(r"const indextable (\w+)_objdict\[\]", text)
+    if match is None:
+        print("%s: no object dictionary found" % name)
+        return 1
+    prefix = match.group(1)
+    text = make_search(make_const(text, prefix), prefix)
+    text = text.replace("Should not be modified. */\n",
+                        "Should not be modified. */\n" + MARK + "\n", 1)
+    with open(name, "w") as f:
+        f.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
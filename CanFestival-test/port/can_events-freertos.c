@@ -0,0 +1,97 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+STM32F103 Port: Ken Sarkies
+Based on AVR Port: Andreas GLAUSER and Peter CHRISTEN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Pending events for FreeRTOS tasks (see can_events.h).
+
+Build this file in place of can_events.c. Each event has a binary semaphore,
+given by the ISR that sets the event and taken by the task that handles it, so
+the task blocks until there is work for it. An event set again before the
+task has run is only seen once, so the task must take all the work there is,
+such as every frame in the receive queue. The ISRs that set events must have a
+priority numerically at or above configMAX_SYSCALL_INTERRUPT_PRIORITY. */
+
+#include <FreeRTOS.h>
+#include <semphr.h>
+#include "can_events.h"
+
+/* One semaphore for each event bit */
+#define CAN_EVENTS 4
+
+static xSemaphoreHandle event_semaphore[CAN_EVENTS];
+
+/* The IPSR holds the active exception number, zero in thread mode */
+static inline UNS8 in_isr(void)
+{
+	uint32_t ipsr;
+	__asm__ __volatile__ ("mrs %0, ipsr" : "=r" (ipsr));
+	return (ipsr != 0);
+}
+
+/******************************************************************************
+Create the event semaphores. Call before the ISRs are enabled.
+INPUT	void
+OUTPUT	void
+******************************************************************************/
+void can_event_init(void)
+{
+	UNS8 i;
+	for (i = 0; i < CAN_EVENTS; i++)
+		if (event_semaphore[i] == NULL)
+			event_semaphore[i] = xSemaphoreCreateBinary();
+}
+
+/******************************************************************************
+Set events, from an ISR or a task.
+INPUT	events CAN_EVENT bits to set
+OUTPUT	void
+******************************************************************************/
+void can_event_set(UNS8 events)
+{
+	BaseType_t woken = pdFALSE;
+	UNS8 i;
+
+	for (i = 0; i < CAN_EVENTS; i++)
+	{
+		if (((events & (1 << i)) == 0) || (event_semaphore[i] == NULL))
+			continue;
+		if (in_isr()) xSemaphoreGiveFromISR(event_semaphore[i], &woken);
+		else xSemaphoreGive(event_semaphore[i]);
+	}
+	if (in_isr()) portEND_SWITCHING_ISR(woken);
+}
+
+/******************************************************************************
+Block the calling task until an event is set.
+INPUT	event one CAN_EVENT bit
+OUTPUT	void
+******************************************************************************/
+void can_event_take(UNS8 event)
+{
+	UNS8 i;
+
+	for (i = 0; i < CAN_EVENTS; i++)
+		if (event == (1 << i)) break;
+	if (i < CAN_EVENTS)
+		xSemaphoreTake(event_semaphore[i], portMAX_DELAY);
+}
@@ -0,0 +1,75 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+STM32F103 Port: Ken Sarkies
+Based on AVR Port: Andreas GLAUSER and Peter CHRISTEN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Pending events for the main loop (see can_events.h).
+
+The ISRs can be at different priorities, so the events are set with interrupts
+masked. The main loop tests for events with interrupts masked and sleeps with
+wfi, which still wakes on an interrupt that is pending but masked, so an event
+set just before the sleep cannot be missed. Built with POWER_STATS the sleeps
+are recorded by power_stats.c in common while the interrupt is still pending. */
+
+#include <libopencm3/cm3/cortex.h>
+#include "can_events.h"
+#include "power_stats.h"
+
+static volatile UNS8 can_events = 0;
+
+/******************************************************************************
+Set events, from an ISR or the main program.
+INPUT	events CAN_EVENT bits to set
+OUTPUT	void
+******************************************************************************/
+void can_event_set(UNS8 events)
+{
+	bool masked = cm_mask_interrupts(true);
+	can_events |= events;
+	cm_mask_interrupts(masked);
+}
+
+/******************************************************************************
+Sleep until an event is set, then take all of the pending events.
+INPUT	void
+OUTPUT	the CAN_EVENT bits that were set, now cleared
+
+Must not be called from an ISR or with interrupts masked.
+******************************************************************************/
+UNS8 can_event_wait(void)
+{
+	UNS8 events;
+
+	cm_mask_interrupts(true);
+	while (can_events == 0)
+	{
+		POWER_STATS_ENTER(POWER_STATE_SLEEP);
+		__asm__ __volatile__ ("wfi");
+		POWER_STATS_EXIT();
+		cm_mask_interrupts(false);
+		cm_mask_interrupts(true);
+	}
+	events = can_events;
+	can_events = 0;
+	cm_mask_interrupts(false);
+	return events;
+}
@@ -0,0 +1,143 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+STM32F103 Port: Ken Sarkies
+Based on AVR Port: Andreas GLAUSER and Peter CHRISTEN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Host implementation of the CANopen driver, for the host build in host/.
+
+There is no bxCAN to fake usefully, as the driver's work is done through side
+effects of register writes, so this takes its place above the hardware with the
+same queues. canSend puts frames in the transmit queue, from which the test
+takes them as the bus would, and canReceive takes frames from the receive
+queue, which the test fills. With loopback on, frames sent go straight to the
+receive queue, so a node hears itself and a whole exchange runs in one
+process. */
+
+#include <string.h>
+#include "can_stm32.h"
+#include "can_queue.h"
+#include "can_host.h"
+#include "canfestival.h"
+
+/* Globals */
+static Message rx_messages[CAN_RX_QUEUE_SIZE];
+static Message tx_messages[CAN_TX_QUEUE_SIZE];
+static can_queue rx_queue;
+static can_queue tx_queue;
+static UNS8 loopback = 0;
+
+/* Received frames lost because the queue was full */
+volatile UNS32 can_rx_dropped = 0;
+
+/******************************************************************************
+Initialize the queues. Any bitrate is accepted.
+INPUT	bitrate in kbit/s
+OUTPUT	1 if successful
+******************************************************************************/
+unsigned char canInit(unsigned int bitrate)
+{
+	if (bitrate == 0) return 0;
+	can_queue_init(&rx_queue, rx_messages, CAN_RX_QUEUE_SIZE);
+	can_queue_init(&tx_queue, tx_messages, CAN_TX_QUEUE_SIZE);
+	return 1;
+}
+
+/******************************************************************************
+The driver send a CAN message passed from the CANopen stack
+INPUT	CAN_PORT is not used (only 1 avaiable)
+	Message *m pointer to message to send
+OUTPUT	1 if the message was queued
+******************************************************************************/
+unsigned char canSend(CAN_PORT notused, Message *m)
+{
+	if (loopback) return can_host_inject(m);
+	return can_queue_put(&tx_queue, m);
+}
+
+/******************************************************************************
+The driver passes a received CAN message to the stack
+INPUT	Message *m pointer to received CAN message
+OUTPUT	1 if a message received
+******************************************************************************/
+unsigned char canReceive(Message *m)
+{
+	return can_queue_get(&rx_queue, m);
+}
+
+/**************************************************************************
+Change the bitrate. The queues are emptied as when CAN1 is initialized again.
+INPUT	fd not used
+	baud string with the rate
+OUTPUT	1 if successful
+***************************************************************************/
+unsigned char canChangeBaudRate_driver( CAN_HANDLE fd, char* baud)
+{
+	unsigned int rate = 0;
+
+	while ((*baud >= '0') && (*baud <= '9'))
+		rate = rate*10 + (*baud++ - '0');
+	if ((*baud == 'M') || (*baud == 'm')) rate *= 1000;
+	else if ((*baud != 'K') && (*baud != 'k')) return 0;
+	return canInit(rate);
+}
+
+/******************************************************************************
+There are no acceptance filters, every frame is passed to the stack.
+INPUT	d the CANopen node data
+OUTPUT	void
+******************************************************************************/
+void canFiltersUpdate(CO_Data *d)
+{
+	(void) d;
+}
+
+/******************************************************************************
+Send frames back to the receive queue rather than out to the bus
+INPUT	on 1 for loopback
+OUTPUT	void
+******************************************************************************/
+void can_host_loopback(unsigned char on)
+{
+	loopback = on;
+}
+
+/******************************************************************************
+Put a frame from the bus in the receive queue
+INPUT	Message *m pointer to the frame
+OUTPUT	1 if queued, 0 if the queue was full and the frame dropped
+******************************************************************************/
+unsigned char can_host_inject(const Message *m)
+{
+	if (can_queue_put(&rx_queue, m)) return 1;
+	can_rx_dropped++;
+	return 0;
+}
+
+/******************************************************************************
+Take a frame sent by the stack off the bus
+INPUT	Message *m pointer to storage for the frame
+OUTPUT	1 if a frame was taken
+******************************************************************************/
+unsigned char can_host_take(Message *m)
+{
+	return can_queue_get(&tx_queue, m);
+}
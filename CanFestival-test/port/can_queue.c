@@ -0,0 +1,126 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+STM32F103 Port: Ken Sarkies
+Based on AVR Port: Andreas GLAUSER and Peter CHRISTEN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Message queue for the CAN drivers (see can_queue.h).
+
+One slot is always left empty so that a full queue can be told from an empty
+one with no shared count. Only the producer writes head and only the consumer
+writes tail, and on a single Cortex-M3 core a compiler barrier is enough to
+make the message contents visible before the index that publishes them. */
+
+#include "can_queue.h"
+
+/* Keep the compiler from moving message accesses across an index update */
+#define can_queue_barrier()	__asm__ __volatile__("" ::: "memory")
+
+/******************************************************************************
+Initialise a queue.
+INPUT	q the queue
+	storage array of size messages
+	size number of messages, a power of two up to 128
+******************************************************************************/
+void can_queue_init(can_queue *q, Message *storage, UNS8 size)
+{
+	q->message = storage;
+	q->mask = size - 1;
+	q->head = 0;
+	q->tail = 0;
+}
+
+/******************************************************************************
+Producer: return the slot to fill next, or NULL if the queue is full. The slot
+is not seen by the consumer until can_queue_commit is called.
+******************************************************************************/
+Message *can_queue_reserve(can_queue *q)
+{
+	UNS8 head = q->head;
+
+	if (((head + 1) & q->mask) == q->tail) return NULL;
+	return &q->message[head];
+}
+
+/******************************************************************************
+Producer: pass the slot returned by can_queue_reserve to the consumer.
+******************************************************************************/
+void can_queue_commit(can_queue *q)
+{
+	can_queue_barrier();
+	q->head = (q->head + 1) & q->mask;
+}
+
+/******************************************************************************
+Consumer: return the oldest message, or NULL if the queue is empty. The slot
+stays valid until can_queue_release is called.
+******************************************************************************/
+Message *can_queue_peek(can_queue *q)
+{
+	UNS8 tail = q->tail;
+
+	if (tail == q->head) return NULL;
+	can_queue_barrier();
+	return &q->message[tail];
+}
+
+/******************************************************************************
+Consumer: free the slot returned by can_queue_peek.
+******************************************************************************/
+void can_queue_release(can_queue *q)
+{
+	can_queue_barrier();
+	q->tail = (q->tail + 1) & q->mask;
+}
+
+/******************************************************************************
+Copy a message in. Returns 0 if the queue is full.
+******************************************************************************/
+unsigned char can_queue_put(can_queue *q, const Message *m)
+{
+	Message *slot = can_queue_reserve(q);
+
+	if (slot == NULL) return 0;
+	*slot = *m;
+	can_queue_commit(q);
+	return 1;
+}
+
+/******************************************************************************
+Copy the oldest message out. Returns 0 if the queue is empty.
+******************************************************************************/
+unsigned char can_queue_get(can_queue *q, Message *m)
+{
+	Message *slot = can_queue_peek(q);
+
+	if (slot == NULL) return 0;
+	*m = *slot;
+	can_queue_release(q);
+	return 1;
+}
+
+/******************************************************************************
+Return 1 if there is nothing in the queue.
+******************************************************************************/
+unsigned char can_queue_empty(can_queue *q)
+{
+	return q->head == q->tail;
+}
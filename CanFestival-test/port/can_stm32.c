@@ -0,0 +1,409 @@
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+STM32F103 Port: Ken Sarkies
+Based on AVR Port: Andreas GLAUSER and Peter CHRISTEN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* bxCAN driver for CAN1 of the STM32F103.
+
+CAN1 is on PA11 (RX) and PA12 (TX). Received frames are taken from both
+receive FIFOs by the FIFO pending interrupts into a queue of Message structs
+which canReceive empties. Frames to send are written straight to a free
+transmit mailbox, using all three, and are otherwise queued and written from
+the mailbox empty interrupt. Transmit FIFO priority is set so that frames go
+out in the order they were sent by the stack, as needed for SDO segments.
+
+Until canFiltersUpdate is called, filter bank 0 passes SDO and NMT error
+control frames (COB-IDs 0x600-0x7FF) to FIFO 1 and filter bank 1 passes all
+other standard frames to FIFO 0, so that a burst of SDO traffic does not
+overrun the FIFO used by PDOs and SYNC. canFiltersUpdate then replaces these
+with exact lists of the COB-IDs the node consumes, taken from the object
+dictionary, so that other frames on the bus never reach the processor.
+
+The bit timing is computed from the APB1 clock for a sample point near 87.5%.
+*/
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/can.h>
+#include <libopencm3/cm3/nvic.h>
+#include <string.h>
+#include "can_stm32.h"
+#include "can_queue.h"
+#include "can_events.h"
+#include "canfestival.h"
+
+/* Time quanta per bit are chosen from this range, most first. Above 19 the
+first time segment would exceed its 16 quanta at 87.5%. */
+#define CAN_TQ_MIN      8
+#define CAN_TQ_MAX      19
+#define CAN_BRP_MAX     1024
+
+/* The F103 has 14 filter banks, each holding four standard identifiers in
+16 bit list mode. An entry has the identifier in bits 15:5 and RTR in bit 4. */
+#define CAN_FILTER_BANKS    14
+#define CAN_FILTER_IDS      (CAN_FILTER_BANKS*4)
+#define FILTER_ENTRY(cob_id, rtr)   ((UNS16) ((((cob_id) & 0x7FF) << 5) | ((rtr) << 4)))
+#define FILTER_LENGTH(count)        ((((count) < CAN_FILTER_IDS) ? (count) : CAN_FILTER_IDS)*sizeof(UNS16))
+
+/* Globals */
+static Message rx_messages[CAN_RX_QUEUE_SIZE];
+static Message tx_messages[CAN_TX_QUEUE_SIZE];
+static can_queue rx_queue;
+static can_queue tx_queue;
+
+/* Received frames lost because the queue was full */
+volatile UNS32 can_rx_dropped = 0;
+
+/* Identifier lists currently in the filters for FIFO 0 and FIFO 1. A count
+above CAN_FILTER_IDS means the lists did not fit and all frames are passed. */
+static UNS16 filter_ids[2][CAN_FILTER_IDS];
+static UNS8 filter_count[2] = {0, 0};
+
+static void can_write_mailbox(Message *m);
+static void can_read_fifo(uint32_t fifo, volatile uint32_t *rfr,
+                          uint32_t release);
+static void filters_accept_all(void);
+static void filters_program(UNS16 ids[2][CAN_FILTER_IDS], UNS8 count[2]);
+static UNS8 filter_add(UNS16 *list, UNS8 count, UNS16 entry);
+
+/******************************************************************************
+Initialize CAN1 with the filters and interrupts described above.
+INPUT	bitrate		bitrate in kilobit per second
+OUTPUT	1 if successful, 0 if the bitrate cannot be made or CAN1 does not start
+
+The bit timing is searched from the largest number of time quanta that divides
+the APB1 clock exactly, which gives the finest resynchronisation.
+******************************************************************************/
+unsigned char canInit(unsigned int bitrate)
+{
+	uint32_t rate = bitrate*1000;
+	uint32_t brp = 0;
+	uint32_t tq, ts1, ts2;
+
+	if (rate == 0) return 0;
+	for (tq = CAN_TQ_MAX; tq >= CAN_TQ_MIN; tq--)
+	{
+		if ((rcc_apb1_frequency % (rate*tq)) == 0)
+		{
+			brp = rcc_apb1_frequency/(rate*tq);
+			break;
+		}
+	}
+	if ((brp == 0) || (brp > CAN_BRP_MAX)) return 0;
+/* Sample point at 7/8 of the bit. The sync segment is one quantum. */
+	ts1 = (tq*7 + 4)/8 - 1;
+	ts2 = tq - 1 - ts1;
+
+	can_queue_init(&rx_queue, rx_messages, CAN_RX_QUEUE_SIZE);
+	can_queue_init(&tx_queue, tx_messages, CAN_TX_QUEUE_SIZE);
+	filter_count[0] = filter_count[1] = 0;
+/* Enable clocks for GPIO port A (for CAN RX and TX) and CAN1. */
+	rcc_peripheral_enable_clock(&RCC_APB2ENR, RCC_APB2ENR_IOPAEN |
+				    RCC_APB2ENR_AFIOEN);
+	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_CANEN);
+/* Setup GPIO pin GPIO_CAN_TX on GPIO port A for transmit. */
+	gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO_CAN_TX);
+/* Setup GPIO pin GPIO_CAN_RX on GPIO port A for receive. */
+	gpio_set_mode(GPIOA, GPIO_MODE_INPUT,
+		      GPIO_CNF_INPUT_FLOAT, GPIO_CAN_RX);
+	can_reset(CAN1);
+/* Automatic bus-off recovery and transmit FIFO priority, normal mode. */
+	if (can_init(CAN1, false, true, false, false, false, true,
+		     CAN_BTR_SJW_1TQ, (ts1 - 1) << CAN_BTR_TS1_SHIFT,
+		     (ts2 - 1) << CAN_BTR_TS2_SHIFT, brp, false, false))
+		return 0;
+	filters_accept_all();
+/* Enable the receive FIFO pending and transmit mailbox empty interrupts. */
+	nvic_enable_irq(NVIC_USB_LP_CAN_RX0_IRQ);
+	nvic_enable_irq(NVIC_CAN_RX1_IRQ);
+	nvic_enable_irq(NVIC_USB_HP_CAN_TX_IRQ);
+	can_enable_irq(CAN1, CAN_IER_FMPIE0 | CAN_IER_FMPIE1 | CAN_IER_TMEIE);
+
+ 	return 1;
+}
+
+/******************************************************************************
+The driver send a CAN message passed from the CANopen stack
+INPUT	CAN_PORT is not used (only use the defined in the ISR port)
+	Message *m pointer to message to send
+OUTPUT	1 if  hardware -> CAN frame, or queued for it
+
+The message is written to a free mailbox if nothing is queued before it,
+otherwise it is queued for the mailbox empty interrupt.
+******************************************************************************/
+unsigned char canSend(CAN_PORT notused, Message *m)
+{
+	unsigned char sent = 1;
+
+/* Keep the ISR out while the queue and mailboxes are examined */
+	CAN_IER(CAN1) &= ~CAN_IER_TMEIE;
+	if (can_queue_empty(&tx_queue) && (CAN_TSR(CAN1) & (CAN_TSR_TME0 |
+	    CAN_TSR_TME1 | CAN_TSR_TME2)))
+		can_write_mailbox(m);
+	else sent = can_queue_put(&tx_queue, m);
+	CAN_IER(CAN1) |= CAN_IER_TMEIE;
+	return sent;
+}
+
+/******************************************************************************
+The driver passes a received CAN message to the stack
+INPUT	Message *m pointer to received CAN message
+OUTPUT	1 if a message received
+******************************************************************************/
+unsigned char canReceive(Message *m)
+{
+	return can_queue_get(&rx_queue, m);
+}
+
+/**************************************************************************
+Change the bitrate. CanFestival gives the rate as a string such as "125K" or
+"1M". CAN1 is initialized again, dropping any queued frames.
+INPUT	fd not used
+	baud string with the rate
+OUTPUT	1 if successful
+***************************************************************************/
+unsigned char canChangeBaudRate_driver( CAN_HANDLE fd, char* baud)
+{
+	unsigned int rate = 0;
+
+	while ((*baud >= '0') && (*baud <= '9'))
+		rate = rate*10 + (*baud++ - '0');
+	if ((*baud == 'M') || (*baud == 'm')) rate *= 1000;
+	else if ((*baud != 'K') && (*baud != 'k')) return 0;
+	return canInit(rate);
+}
+
+/******************************************************************************
+Set the acceptance filters to the COB-IDs consumed by the node: NMT, SYNC, the
+SDO server, the receive PDOs, the heartbeat consumers and node guarding. SDO
+and error control frames go to FIFO 1 and the others to FIFO 0.
+INPUT	d the CANopen node data
+OUTPUT	void
+
+Call after setNodeId and after each canDispatch. The lists are rebuilt from
+the object dictionary and the filters are only reprogrammed if they differ,
+so a COB-ID changed through SDO (such as an RPDO mapped to another producer)
+takes effect as soon as the write is dispatched. If there are too many
+identifiers for the filter banks all standard frames are passed.
+******************************************************************************/
+void canFiltersUpdate(CO_Data *d)
+{
+	UNS16 ids[2][CAN_FILTER_IDS];
+	UNS8 count[2] = {0, 0};
+	UNS16 offset, last;
+	UNS32 cob_id;
+	UNS8 node = *d->bDeviceNodeId;
+	UNS8 i;
+
+/* NMT and SYNC */
+	count[0] = filter_add(ids[0], count[0], FILTER_ENTRY(0x000, 0));
+	if (d->COB_ID_Sync != NULL)
+		count[0] = filter_add(ids[0], count[0],
+				      FILTER_ENTRY(*d->COB_ID_Sync, 0));
+/* Receive PDOs that are valid (bit 31 clear) */
+	offset = d->firstIndex->PDO_RCV;
+	last = d->lastIndex->PDO_RCV;
+	if (offset) while (offset <= last)
+	{
+		cob_id = *(UNS32 *) d->objdict[offset].pSubindex[1].pObject;
+		if ((cob_id & 0x80000000) == 0)
+			count[0] = filter_add(ids[0], count[0], FILTER_ENTRY(cob_id, 0));
+		offset++;
+	}
+/* SDO server requests from the client */
+	offset = d->firstIndex->SDO_SVR;
+	last = d->lastIndex->SDO_SVR;
+	if (offset) while (offset <= last)
+	{
+		cob_id = *(UNS32 *) d->objdict[offset].pSubindex[1].pObject;
+		if ((cob_id & 0x80000000) == 0)
+			count[1] = filter_add(ids[1], count[1], FILTER_ENTRY(cob_id, 0));
+		offset++;
+	}
+/* Heartbeats of the nodes we consume, with the node ID in bits 23:16 */
+	for (i = 0; i < *d->ConsumerHeartbeatCount; i++)
+	{
+		cob_id = d->ConsumerHeartbeatEntries[i];
+		if (((cob_id >> 16) & 0x7F) && (cob_id & 0xFFFF))
+			count[1] = filter_add(ids[1], count[1],
+					      FILTER_ENTRY(0x700 + ((cob_id >> 16) & 0x7F), 0));
+	}
+/* Node guarding requests are remote frames */
+	if (node)
+		count[1] = filter_add(ids[1], count[1], FILTER_ENTRY(0x700 + node, 1));
+
+	if ((count[0] == filter_count[0]) && (count[1] == filter_count[1]) &&
+	    (memcmp(ids[0], filter_ids[0], FILTER_LENGTH(count[0])) == 0) &&
+	    (memcmp(ids[1], filter_ids[1], FILTER_LENGTH(count[1])) == 0))
+		return;
+	memcpy(filter_ids, ids, sizeof(ids));
+	filter_count[0] = count[0];
+	filter_count[1] = count[1];
+	if (((count[0] + 3)/4 + (count[1] + 3)/4) > CAN_FILTER_BANKS)
+		filters_accept_all();
+	else
+		filters_program(ids, count);
+}
+
+/******************************************************************************
+Add an entry to a filter list unless it is there already. The count returned
+goes past CAN_FILTER_IDS if the list is full.
+******************************************************************************/
+static UNS8 filter_add(UNS16 *list, UNS8 count, UNS16 entry)
+{
+	UNS8 i;
+
+	for (i = 0; (i < count) && (i < CAN_FILTER_IDS); i++)
+		if (list[i] == entry) return count;
+	if (count < CAN_FILTER_IDS) list[count] = entry;
+	if (count <= CAN_FILTER_IDS) count++;
+	return count;
+}
+
+/******************************************************************************
+Program the identifier lists into consecutive filter banks, FIFO 0 first, and
+disable the banks left over. A bank not filled repeats its first entry.
+******************************************************************************/
+static void filters_program(UNS16 ids[2][CAN_FILTER_IDS], UNS8 count[2])
+{
+	UNS8 bank = 0;
+	UNS8 fifo, i, j;
+	UNS16 entry[4];
+
+	for (fifo = 0; fifo < 2; fifo++)
+	{
+		for (i = 0; i < count[fifo]; i += 4)
+		{
+			for (j = 0; j < 4; j++)
+				entry[j] = ids[fifo][(i + j < count[fifo]) ? i + j : i];
+			can_filter_id_list_16bit_init(CAN1, bank++, entry[0], entry[1],
+						      entry[2], entry[3], fifo, true);
+		}
+	}
+	for (; bank < CAN_FILTER_BANKS; bank++)
+		can_filter_init(CAN1, bank, false, false, 0, 0, 0, false);
+}
+
+/******************************************************************************
+Pass all standard frames, SDO and error control to FIFO 1 and the rest to
+FIFO 0. The IDE bit is in the masks so that extended frames are rejected.
+******************************************************************************/
+static void filters_accept_all(void)
+{
+	UNS8 bank;
+
+	can_filter_id_mask_32bit_init(CAN1, 0, 0x600 << CAN_RIxR_STID_SHIFT,
+				      (0x600 << CAN_RIxR_STID_SHIFT) | CAN_RIxR_IDE,
+				      1, true);
+	can_filter_id_mask_32bit_init(CAN1, 1, 0, CAN_RIxR_IDE, 0, true);
+	for (bank = 2; bank < CAN_FILTER_BANKS; bank++)
+		can_filter_init(CAN1, bank, false, false, 0, 0, 0, false);
+}
+
+/******************************************************************************
+Write a message to the next free mailbox and request transmission. The caller
+must have checked that a mailbox is free.
+******************************************************************************/
+static void can_write_mailbox(Message *m)
+{
+	uint32_t mbox;
+	uint32_t data[2] = {0, 0};
+	UNS8 i;
+
+	switch ((CAN_TSR(CAN1) & CAN_TSR_CODE_MASK) >> 24)
+	{
+	case 0: mbox = CAN_MBOX0; break;
+	case 1: mbox = CAN_MBOX1; break;
+	default: mbox = CAN_MBOX2; break;
+	}
+	for (i = 0; (i < m->len) && (i < 8); i++)
+		data[i >> 2] |= (uint32_t) m->data[i] << ((i & 3)*8);
+	CAN_TDTxR(CAN1, mbox) = m->len & CAN_TDTxR_DLC_MASK;
+	CAN_TDLxR(CAN1, mbox) = data[0];
+	CAN_TDHxR(CAN1, mbox) = data[1];
+	CAN_TIxR(CAN1, mbox) = ((uint32_t) m->cob_id << CAN_TIxR_STID_SHIFT) |
+			       (m->rtr ? CAN_TIxR_RTR : 0) | CAN_TIxR_TXRQ;
+}
+
+/******************************************************************************
+Take all pending frames from a receive FIFO into the receive queue and tell
+the main loop. Frames are dropped if the queue is full.
+******************************************************************************/
+static void can_read_fifo(uint32_t fifo, volatile uint32_t *rfr,
+                          uint32_t release)
+{
+	Message *m;
+	uint32_t id, data[2];
+	UNS8 i;
+
+	while (*rfr & 0x3)			/* FMP: frames pending */
+	{
+		m = can_queue_reserve(&rx_queue);
+		if (m == NULL) can_rx_dropped++;
+		else
+		{
+			id = CAN_RIxR(CAN1, fifo);
+			m->cob_id = (UNS16) (id >> CAN_RIxR_STID_SHIFT);
+			m->rtr = (id & CAN_RIxR_RTR) ? 1 : 0;
+			m->len = CAN_RDTxR(CAN1, fifo) & CAN_RDTxR_DLC_MASK;
+			if (m->len > 8) m->len = 8;
+			data[0] = CAN_RDLxR(CAN1, fifo);
+			data[1] = CAN_RDHxR(CAN1, fifo);
+			for (i = 0; i < 8; i++)
+				m->data[i] = (UNS8) (data[i >> 2] >> ((i & 3)*8));
+			can_queue_commit(&rx_queue);
+		}
+		*rfr = release;			/* FULL and FOVR are rc_w1 */
+	}
+	can_event_set(CAN_EVENT_RX);
+}
+
+/******************************************************************************
+CAN Interrupts
+The receive FIFO pending interrupts fill the receive queue, and the transmit
+mailbox empty interrupt refills the mailboxes from the transmit queue.
+******************************************************************************/
+void usb_lp_can_rx0_isr(void)
+{
+	can_read_fifo(CAN_FIFO0, &CAN_RF0R(CAN1), CAN_RF0R_RFOM0);
+}
+
+void can_rx1_isr(void)
+{
+	can_read_fifo(CAN_FIFO1, &CAN_RF1R(CAN1), CAN_RF1R_RFOM1);
+}
+
+void usb_hp_can_tx_isr(void)
+{
+	Message *m;
+
+/* Clear the request completed flags that raised the interrupt */
+	CAN_TSR(CAN1) = CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2;
+	while ((CAN_TSR(CAN1) & (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2)) &&
+	       ((m = can_queue_peek(&tx_queue)) != NULL))
+	{
+		can_write_mailbox(m);
+		can_queue_release(&tx_queue);
+	}
+}
+
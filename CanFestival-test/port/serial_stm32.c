@@ -27,19 +27,51 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/usart.h>
 #include <libopencm3/cm3/nvic.h>
+#include <string.h>
 #include "serial_stm32.h"
 #include "canfestival.h"
-#include <STM32/buffer.h>
+#include "can_queue.h"
+#include "can_events.h"
+#include "buffer.h"
+#include "serial.h"
 
-#define BUFFER_SIZE 128
+/* Send buffer, which holds a whole SDO block of tunnel frames (a power of two) */
+#define BUFFER_SIZE 512
+/* Received messages held for the stack (a power of two) */
+#define RX_QUEUE_SIZE 16
 
 /* Globals */
-UNS8 send_buffer[BUFFER_SIZE+3];
-UNS8 receive_buffer[BUFFER_SIZE+3];
-UNS8 message_temp[12];
+static UNS8 send_data[BUFFER_SIZE];
+static ring_buffer_t send_buffer;
+static Message rx_messages[RX_QUEUE_SIZE];
+static can_queue rx_queue;
 
-volatile UNS8 msg_received = 0;
+/* Received bytes of the frame being checked */
+static UNS8 rx_frame[TUNNEL_FRAME_MAX];
 volatile UNS8 msg_recv_status = 0;
+/* Received frames lost because the queue was full */
+volatile UNS32 can_rx_dropped = 0;
+/* Bad frames thrown away while resynchronising */
+volatile UNS32 can_rx_errors = 0;
+
+/* CRC8 with polynomial 0x07, a nibble at a time */
+static const UNS8 crc8_table[16] = {
+	0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+	0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D
+};
+
+/******************************************************************************
+Add a byte to a CRC8
+INPUT	crc CRC8 so far, starting from zero
+	data next byte
+OUTPUT	CRC8 including the byte
+******************************************************************************/
+static UNS8 crc8_next(UNS8 crc, UNS8 data)
+{
+	crc ^= data;
+	crc = (crc << 4) ^ crc8_table[crc >> 4];
+	return (crc << 4) ^ crc8_table[crc >> 4];
+}
 
 /******************************************************************************
 Initialize the hardware to receive (USART based) CAN messages and start the
@@ -50,7 +82,7 @@ OUTPUT	1 if successful
 unsigned char canInit(unsigned int bitrate)
 {
 	msg_recv_status = 0;
-	msg_received = 0;
+	can_queue_init(&rx_queue, rx_messages, RX_QUEUE_SIZE);
 /* Enable clocks for GPIO port A (for GPIO_USART1_TX) and USART1. */
 	rcc_peripheral_enable_clock(&RCC_APB2ENR, RCC_APB2ENR_IOPAEN |
 				    RCC_APB2ENR_AFIOEN | RCC_APB2ENR_USART1EN);
@@ -75,9 +107,10 @@ unsigned char canInit(unsigned int bitrate)
 /* Finally enable the USART. */
 	usart_enable(USART1);
 
-/* Initialise the send and receive buffers */
-	buffer_init(send_buffer,BUFFER_SIZE);
-	buffer_init(receive_buffer,BUFFER_SIZE);
+/* Initialise the send buffer */
+	ring_init(&send_buffer, send_data, BUFFER_SIZE);
+/* Transmission is by DMA from the send buffer */
+	serial_tx_init_ring(&send_buffer);
 
  	return 1;
 }
@@ -91,21 +124,56 @@ OUTPUT	1 if  hardware -> CAN frame
 Message is a struct defined in can.h
 This echoes the way the can_serial driver works.
 ******************************************************************************/
-UNS8 count = 0;
 unsigned char canSend(CAN_PORT notused, Message *m)
 {
-        unsigned char i;
-
-/* Send the message as raw bytes (note little-endianness of Cortex M3) */
-	buffer_put(send_buffer, (m->cob_id) & 0xFF);
-	buffer_put(send_buffer, (m->cob_id) >> 8);
-	buffer_put(send_buffer, (m->rtr));
-	buffer_put(send_buffer, (m->len));
-	for (i= 0; i < (m->len); i++)
-		buffer_put(send_buffer, m->data[i]);
-/* Start sending by enabling the interrupt */
-	usart_enable_tx_interrupt(USART1);
-        return 1;	// successful
+	UNS8 header[TUNNEL_HEADER];
+	UNS8 check;
+	UNS8 *frame;
+	UNS8 i;
+
+	if (m->len > 8)
+		return 0;
+/* Only send whole frames, although the receiver can resynchronise */
+	if (ring_space(&send_buffer) < TUNNEL_HEADER + m->len + 1)
+		return 0;
+	header[0] = TUNNEL_SYNC;
+	header[1] = (m->cob_id) & 0xFF;
+	header[2] = ((m->cob_id >> 8) & 0x07) | (m->rtr ? 0x08 : 0) |
+		    (m->len << 4);
+	check = crc8_next(crc8_next(0, header[1]), header[2]);
+	for (i = 0; i < m->len; i++)
+		check = crc8_next(check, m->data[i]);
+/* Build the frame in place if it doesn't straddle the end of the buffer */
+	if (ring_reserve_contiguous(&send_buffer, &frame) >=
+	    TUNNEL_HEADER + m->len + 1)
+	{
+		for (i = 0; i < TUNNEL_HEADER; i++) frame[i] = header[i];
+		for (i = 0; i < m->len; i++) frame[TUNNEL_HEADER + i] = m->data[i];
+		frame[TUNNEL_HEADER + m->len] = check;
+		ring_commit(&send_buffer, TUNNEL_HEADER + m->len + 1);
+	}
+	else
+	{
+		ring_put_n(&send_buffer, header, TUNNEL_HEADER);
+		ring_put_n(&send_buffer, m->data, m->len);
+		ring_put(&send_buffer, check);
+	}
+/* Start sending if the DMA is idle, or hold the frame for a batch */
+#if TUNNEL_BATCH
+	if (ring_count(&send_buffer) >= TUNNEL_BATCH_BYTES)
+#endif
+		serial_tx_start();
+	return 1;	// successful
+}
+
+/******************************************************************************
+Send the frames held for batching in one DMA burst
+Called from the main loop after the stack has had its turn, so that the frames
+sent in response to one event go out together.
+******************************************************************************/
+void canFlush(void)
+{
+	serial_tx_start();
 }
 
 /******************************************************************************
@@ -115,23 +183,8 @@ OUTPUT	1 if a message received
 ******************************************************************************/
 unsigned char canReceive(Message *m)
 {
-        unsigned char i;
-
-  	if (msg_received == 0)
-    	return 0;					/* Nothing received yet */
-
-/* In this we are relying on the ISR to build up the message and shove to the
-buffer before notifying us. Therefore we don't check unavailability of data in
-the buffer or any other error conditions. */
-	m->cob_id = buffer_get(receive_buffer) + (buffer_get(receive_buffer) << 8);
-	m->rtr = buffer_get(receive_buffer);
-	m->len = buffer_get(receive_buffer);
-	for (i= 0; i < (m->len); i++)
-		m->data[i] = buffer_get(receive_buffer);
-
-	msg_received--;					/* Let the ISR know we are done */
-
-        return 1;                  		/* message received */
+/* The ISR only queues whole messages, with the length checked. */
+	return can_queue_get(&rx_queue, m);
 }
 
 /**************************************************************************
@@ -143,51 +196,73 @@ unsigned char canChangeBaudRate_driver( CAN_HANDLE fd, char* baud)
 }
 
 /******************************************************************************
-USART Interrupt
-For the receiver, build a message first then put to buffer and tell main program.
+Check the bytes held for a received frame
+Whole frames that pass the CRC are copied to the receive queue and the main
+loop is told, or they are dropped if the queue is full. A false SYNC, a bad
+length or a bad CRC throws away bytes up to the next SYNC byte held, which is
+then checked as the start of a frame, so the receiver is back in step at the
+first good frame after a lost or corrupted byte.
+INPUT	none, the frame bytes are in rx_frame with msg_recv_status held
+OUTPUT	none
 ******************************************************************************/
-/* Find out what interrupted and get or send data as appropriate */
-
-void usart1_isr(void)
+static void tunnel_scan(void)
 {
-	static UNS16 data;
+	Message *m;
+	UNS8 len, check, i;
 
-/* Check if we were called because of RXNE. */
-	if (usart_get_flag(USART1,USART_SR_RXNE))
+	while (msg_recv_status > 0)
 	{
-/* Put to temporary message buffer */
-		data = (UNS8) usart_recv(USART1);
-		message_temp[msg_recv_status] = (UNS8) data;
-		msg_recv_status++;
-/* At this point we should check for integrity of the message, but there is no
-way to recover if the message length sent is wrong. So we'll do what we can and
-hope we can catch up eventually. */
-		if ((msg_recv_status > 3) && (message_temp[3] > 8))
-		{
-/* Bad message length - abort and restart a new message */
-			msg_recv_status = 0;
-		}
-/* Check if we are finished (message length is in element 3) */
-		else if (msg_recv_status == 4 + message_temp[3])
+		if (rx_frame[0] == TUNNEL_SYNC)
 		{
-			msg_recv_status = 0;
-			msg_received++;			/* Signal another message arrived */
-			UNS8 i;
-/* Dump to buffer; if full we'll just have to drop it */
-			for (i=0; i < 4 + message_temp[3]; i++)
-				buffer_put(receive_buffer,message_temp[i]);
+			if (msg_recv_status < TUNNEL_HEADER) return;
+			len = rx_frame[2] >> 4;
+			if (len <= 8)
+			{
+				if (msg_recv_status < TUNNEL_HEADER + len + 1) return;
+				check = 0;
+				for (i = 1; i < TUNNEL_HEADER + len; i++)
+					check = crc8_next(check, rx_frame[i]);
+				if (check == rx_frame[TUNNEL_HEADER + len])
+				{
+					msg_recv_status = 0;
+					m = can_queue_reserve(&rx_queue);
+					if (m == NULL)
+					{
+						can_rx_dropped++;
+						return;
+					}
+					m->cob_id = rx_frame[1] | ((UNS16) (rx_frame[2] & 0x07) << 8);
+					m->rtr = (rx_frame[2] >> 3) & 1;
+					m->len = len;
+					for (i = 0; i < len; i++)
+						m->data[i] = rx_frame[TUNNEL_HEADER + i];
+					can_queue_commit(&rx_queue);
+					can_event_set(CAN_EVENT_RX);
+					return;
+				}
+			}
+			can_rx_errors++;
 		}
+/* Not a frame here: move up to the next SYNC held, if any */
+		for (i = 1; (i < msg_recv_status) && (rx_frame[i] != TUNNEL_SYNC); i++);
+		msg_recv_status -= i;
+		memmove(rx_frame, rx_frame + i, msg_recv_status);
 	}
-/* Check if we were called because of TXE. */
-	else if (usart_get_flag(USART1,USART_SR_TXE))
+}
+
+/******************************************************************************
+USART Interrupt
+For the receiver, hold the bytes of a frame until it is complete and checked.
+The transmitter is driven by DMA in the serial driver.
+******************************************************************************/
+/* Find out what interrupted and get data as appropriate */
+
+void usart1_isr(void)
+{
+/* Check if we were called because of RXNE. */
+	if (usart_get_flag(USART1,USART_SR_RXNE))
 	{
-		data = buffer_get(send_buffer);
-/* If buffer empty, disable the tx interrupt */
-		if ((data & 0xFF00) > 0) usart_disable_tx_interrupt(USART1);
-		else
-        {
-                usart_send(USART1, (data & 0xFF));
-        }
+		rx_frame[msg_recv_status++] = (UNS8) usart_recv(USART1);
+		tunnel_scan();
 	}
 }
-
@@ -0,0 +1,107 @@
+/*      Port of CanFestival to STM32F103 using libopencm3
+
+*/
+
+/*
+This file is part of CanFestival, a library implementing CanOpen Stack.
+
+Copyright (C): Edouard TISSERANT and Francis DUPIN
+STM32F103 Port: Ken Sarkies, November 2012
+Based on AVR Port: Andreas GLAUSER and Peter CHRISTEN
+
+See COPYING file for copyrights details.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Host implementation of the CANopen timer driver, for the host build in host/.
+
+The timebase is the virtual clock of host/fake_periph.c in 1us ticks, and the
+alarm one of its one shot timers. The alarm calls TimeDispatch directly, as
+the fake timers only expire when the test moves the clock on, which is between
+steps of the stack just as the main loop would call it. */
+
+/* Includes for the Canfestival driver */
+#include <canfestival.h>
+#include <timer.h>
+#include "fake_periph.h"
+
+/* Time of the next alarm */
+TIMEVAL timerAlarm = 0;
+
+/************************** Module variables **********************************/
+/* Time of the last alarm, from which the elapsed time is measured */
+static TIMEVAL last_time_set = 0;
+/* Time at which the stack last read the elapsed time. The stack sets the next
+alarm relative to this. */
+static TIMEVAL last_time_read = 0;
+
+/******************************************************************************
+The alarm has gone off. Take the alarm time as the last time an alarm was set
+and run the time handler of the stack.
+******************************************************************************/
+static void alarm_expired(void)
+{
+	last_time_set = timerAlarm;
+	TimeDispatch();
+}
+
+/******************************************************************************
+Initializes the timer with no alarm set
+INPUT	void
+OUTPUT	void
+******************************************************************************/
+void initTimer(void)
+{
+	fake_timer_stop(FAKE_TIMER_CANOPEN);
+  	timerAlarm = 0;
+	last_time_set = (TIMEVAL) fake_clock_us();
+	last_time_read = last_time_set;
+}
+
+/******************************************************************************
+Set the timer for the next alarm, relative to the last reading of the elapsed
+time as for the hardware timer.
+INPUT	value TIMEVAL (unsigned long) 0...TIMEVAL_MAX
+OUTPUT	void
+******************************************************************************/
+void setTimer(TIMEVAL value)
+{
+	if (value > TIMEVAL_MAX) value = TIMEVAL_MAX;
+	timerAlarm = last_time_read + value;
+	INTEGER32 due = (INTEGER32) (timerAlarm - (TIMEVAL) fake_clock_us());
+	fake_timer_start(FAKE_TIMER_CANOPEN, (due > 0) ? due : 0, alarm_expired);
+}
+
+/******************************************************************************
+Return the elapsed time to tell the Stack how much time is spent since last call.
+INPUT	void
+OUTPUT	value TIMEVAL (unsigned long) the elapsed time since the last alarm
+******************************************************************************/
+TIMEVAL getElapsedTime(void)
+{
+	last_time_read = (TIMEVAL) fake_clock_us();
+	return last_time_read - last_time_set;
+}
+
+/******************************************************************************
+Return the present time of the timebase, for timestamping frames such as SYNC.
+INPUT	void
+OUTPUT	value TIMEVAL (unsigned long) the time in 1us ticks, wrapping at 32 bits
+******************************************************************************/
+TIMEVAL getTimeStamp(void)
+{
+	return (TIMEVAL) fake_clock_us();
+}
@@ -26,34 +26,181 @@ License along with this library; if not, write to the Free Software
 Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
-/* STM32 implementation of the CANopen timer driver, uses Timer 3 (16 bit) */
+/* STM32 implementation of the CANopen timer driver, uses Timer 3 (16 bit)
+
+Timer 3 counts 1us ticks over its full 16 bit range and the overflows are
+counted in software, which extends it to a 32 bit timebase. The alarm is kept
+as a 32 bit time. Output compare 1 is only enabled once the alarm falls within
+one counter period, so long SDO timeouts and heartbeat periods make a single
+call to the stack rather than a chain of short alarms. The alarm sets
+CAN_EVENT_ALARM and the main loop calls TimeDispatch, so that the whole stack
+runs from the main loop.
+
+Built with SOFT_TIMER the alarm is instead a software timer of soft_timer.c in
+common, which keeps the same 1us timebase on TIM4 for all its users, and Timer 3
+is left free. */
 
 /* Includes for the Canfestival driver */
 #include <canfestival.h>
 #include <timer.h>
+#include <can_events.h>
 #include <libopencm3/stm32/timer.h>
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/cm3/nvic.h>
+#include "isr_profile.h"
+
+#ifdef SOFT_TIMER
+#include "soft_timer.h"
+
+/* Time of the next alarm */
+TIMEVAL timerAlarm = 0;
+
+/************************** Module variables **********************************/
+static soft_timer_t alarm_timer;
+/* Time of the last alarm, from which the elapsed time is measured */
+static TIMEVAL last_time_set = 0;
+/* Time at which the stack last read the elapsed time. The stack sets the next
+alarm relative to this. */
+static TIMEVAL last_time_read = 0;
+
+/******************************************************************************
+The alarm has gone off, in the timer interrupt. Take the alarm time as the last
+time an alarm was set and have the main loop call TimeDispatch.
+******************************************************************************/
+static void alarm_expired(soft_timer_t *timer)
+{
+	(void) timer;
+	last_time_set = timerAlarm;
+	can_event_set(CAN_EVENT_ALARM);
+}
+
+/******************************************************************************
+Initializes the timer with no alarm set
+INPUT	void
+OUTPUT	void
+******************************************************************************/
+void initTimer(void)
+{
+	soft_timer_init();
+	soft_timer_create(&alarm_timer, alarm_expired, 0);
+  	timerAlarm = 0;
+	last_time_set = soft_timer_now();
+	last_time_read = last_time_set;
+}
+
+/******************************************************************************
+Set the timer for the next alarm, relative to the last reading of the elapsed
+time as for the hardware timer.
+INPUT	value TIMEVAL (unsigned long) 0...TIMEVAL_MAX
+OUTPUT	void
+******************************************************************************/
+void setTimer(TIMEVAL value)
+{
+	if (value > TIMEVAL_MAX) value = TIMEVAL_MAX;
+	timerAlarm = last_time_read + value;
+	soft_timer_start_at(&alarm_timer, timerAlarm);
+}
+
+/******************************************************************************
+Return the elapsed time to tell the Stack how much time is spent since last call.
+INPUT	void
+OUTPUT	value TIMEVAL (unsigned long) the elapsed time since the last alarm
+******************************************************************************/
+TIMEVAL getElapsedTime(void)
+{
+	last_time_read = soft_timer_now();
+	return last_time_read - last_time_set;
+}
 
+/******************************************************************************
+Return the present time of the timebase, for timestamping frames such as SYNC.
+INPUT	void
+OUTPUT	value TIMEVAL (unsigned long) the time in 1us ticks, wrapping at 32 bits
+******************************************************************************/
+TIMEVAL getTimeStamp(void)
+{
+	return soft_timer_now();
+}
+
+#else
+
+/* Rate of the timebase, one TIMEVAL unit */
+#define TIMER_TICK_HZ 1000000
+
+/* Time of the next alarm */
 TIMEVAL timerAlarm = 0;
 
 /************************** Module variables **********************************/
-/* Store the last timer value to calculate the elapsed time */
-static TIMEVAL last_time_set = TIMEVAL_MAX;     
+/* High 16 bits of the timebase */
+static volatile UNS16 timer_overflows = 0;
+/* Set while an alarm is waiting to go off */
+static volatile UNS8 alarm_pending = 0;
+/* Time of the last alarm, from which the elapsed time is measured */
+static TIMEVAL last_time_set = 0;
+/* Time at which the stack last read the elapsed time. The stack sets the next
+alarm relative to this. */
+static TIMEVAL last_time_read = 0;
+
+/******************************************************************************
+Read the 32 bit timebase
+INPUT	void
+OUTPUT	TIMEVAL the time in 1us ticks
+
+An overflow that has happened but not yet been counted, because its interrupt
+is held off (in the timer ISR itself, for example), is allowed for.
+******************************************************************************/
+static TIMEVAL timer_now(void)
+{
+	UNS16 high;
+	TIMEVAL now;
+	do
+	{
+		high = timer_overflows;
+		now = ((TIMEVAL) high << 16) | timer_get_counter(TIM3);
+		if (timer_get_flag(TIM3, TIM_SR_UIF))
+			now = ((TIMEVAL) (high + 1) << 16) | timer_get_counter(TIM3);
+	}
+	while (high != timer_overflows);
+	return now;
+}
+
+/******************************************************************************
+Enable the compare interrupt if the alarm is due within one counter period.
+If it is already due the interrupt is forced, so that an alarm set too close
+to the present time is not missed.
+******************************************************************************/
+static void timer_arm(void)
+{
+	if (! alarm_pending) return;
+	if ((INTEGER32) (timerAlarm - timer_now()) >= 0x10000) return;
+	timer_set_oc_value(TIM3, TIM_OC1, timerAlarm & 0xFFFF);
+	timer_clear_flag(TIM3, TIM_SR_CC1IF);
+	timer_enable_irq(TIM3, TIM_DIER_CC1IE);
+	if ((INTEGER32) (timerAlarm - timer_now()) <= 0)
+		timer_generate_event(TIM3, TIM_EGR_CC1G);
+}
 
 /******************************************************************************
 Initializes the timer, turn on the interrupt and put the interrupt time to zero
 INPUT	void
 OUTPUT	void
 
-The timer is set to roll over at 0.5 second from an 8us clock, and the output
-compare 1 is used to trigger an alarm. This is set progressively by the
-CanFestival stack.
+The timer counts 1us ticks from the APB1 timer clock and rolls over every
+65.536ms, the update interrupt counting the overflows. Output compare 1 is used
+to trigger an alarm. This is set progressively by the CanFestival stack.
 ******************************************************************************/
 void initTimer(void)
 {
+	UNS32 timer_clock = rcc_apb1_frequency;
+/* The timer clock is twice the APB1 clock if APB1 is divided down */
+	if (((RCC_CFGR >> RCC_CFGR_PPRE1_SHIFT) & 0x7) != RCC_CFGR_PPRE1_HCLK_NODIV)
+		timer_clock *= 2;
 /* Set alarm back to zero */
   	timerAlarm = 0;
+	alarm_pending = 0;
+	timer_overflows = 0;
+	last_time_set = 0;
+	last_time_read = 0;
 /* Enable TIM3 clock. */
 	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM3EN);
 /* Enable TIM3 interrupt. */
@@ -61,10 +208,10 @@ void initTimer(void)
 	timer_reset(TIM3);
 	timer_set_mode(TIM3, TIM_CR1_CKD_CK_INT,
 		       TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
-/* Set prescaler to give 8us clock */
-        timer_set_prescaler(TIM3, 576);
-/* Set the period as 0.5 second */
-	timer_set_period(TIM3, TIMEVAL_MAX);
+/* Set prescaler to give 1us clock */
+	timer_set_prescaler(TIM3, timer_clock/TIMER_TICK_HZ - 1);
+/* Use the full 16 bit count */
+	timer_set_period(TIM3, 0xFFFF);
 /* Disable physical pin outputs. */
 	timer_disable_oc_output(TIM3, TIM_OC1 | TIM_OC2 | TIM_OC3 | TIM_OC4);
 /* Configure global mode of output channel 1, disabling the output. */
@@ -72,68 +219,91 @@ void initTimer(void)
 	timer_disable_oc_preload(TIM3, TIM_OC1);
 	timer_set_oc_slow_mode(TIM3, TIM_OC1);
 	timer_set_oc_mode(TIM3, TIM_OC1, TIM_OCM_FROZEN);
-/* Set the initial compare value for OC1. */
-	timer_set_oc_value(TIM3, TIM_OC1, timerAlarm);
 /* Continous counting mode. */
 	timer_continuous_mode(TIM3);
 /* ARR reload disable. */
 	timer_disable_preload(TIM3);
+/* Count overflows. The compare interrupt is enabled when an alarm is near. */
+	timer_clear_flag(TIM3, TIM_SR_UIF | TIM_SR_CC1IF);
+	timer_enable_irq(TIM3, TIM_DIER_UIE);
 /* Counter enable. */
 	timer_enable_counter(TIM3);
-/* Enable compare match interrupt. */
-	timer_enable_irq(TIM3, TIM_DIER_CC1IE);
 }
 
 /******************************************************************************
 Set the timer for the next alarm.
 INPUT	value TIMEVAL (unsigned long) 0...TIMEVAL_MAX
 OUTPUT	void
+
+The stack reads the elapsed time just before it sets the alarm and counts the
+value from then, so the alarm is placed relative to that reading. This keeps
+the stack's account of time exact however long it takes to get here.
 ******************************************************************************/
 void setTimer(TIMEVAL value)
 {
-/* Add the desired time to the timer interrupt time for the next alarm */
-/* NOTE: This is computing (timerAlarm + value) % TIMEVAL_MAX, but so that it can
-handle possible (timerAlarm + value) beyond the integer range of TIMEVAL */
 /* Just make certain that value is in range */
-        if (value > TIMEVAL_MAX) value = TIMEVAL_MAX;
-        if (timerAlarm < TIMEVAL_MAX - value)
-  	        timerAlarm += value;
-        else
-                timerAlarm -= TIMEVAL_MAX - value;
-	timer_set_oc_value(TIM3, TIM_OC1, (unsigned long) timerAlarm);
+	if (value > TIMEVAL_MAX) value = TIMEVAL_MAX;
+	timer_disable_irq(TIM3, TIM_DIER_CC1IE);
+	timerAlarm = last_time_read + value;
+	alarm_pending = 1;
+	timer_arm();
 }
 
 /******************************************************************************
 Return the elapsed time to tell the Stack how much time is spent since last call.
 INPUT	void
-OUTPUT	value TIMEVAL (unsigned long) the elapsed time
+OUTPUT	value TIMEVAL (unsigned long) the elapsed time since the last alarm
 ******************************************************************************/
 TIMEVAL getElapsedTime(void)
 {
-  	TIMEVAL timer = timer_get_counter(TIM3);	/* Read the value of the running timer */
-  	if (timer > last_time_set)                      /* In case the timer value is higher than the last time. */
-    	        return (timer - last_time_set);         /* Calculate the time difference */
-  	else if (timer < last_time_set)                 /* Timer has cycled around */
-    	        return (timer + (TIMEVAL_MAX - last_time_set)); /* Calculate the time difference */
-  	else
-    	        return TIMEVAL_MAX;                     /* timer has gone around a full cycle.*/
+	last_time_read = timer_now();
+	return last_time_read - last_time_set;
+}
+
+/******************************************************************************
+Return the present time of the timebase, for timestamping frames such as SYNC.
+INPUT	void
+OUTPUT	value TIMEVAL (unsigned long) the time in 1us ticks, wrapping at 32 bits
+******************************************************************************/
+TIMEVAL getTimeStamp(void)
+{
+	return timer_now();
 }
 
 /******************************************************************************
-Interruptserviceroutine Timer 3 Compare 1 for the CAN timer
-Pull in the timer counter value to represent the last time an alarm was set.
+Interruptserviceroutine Timer 3 Update and Compare 1 for the CAN timer
+Count the overflows, arming the compare once the alarm comes within range. On
+the alarm, take the alarm time as the last time an alarm was set and have the
+main loop call TimeDispatch. The time it takes to get there is included in the
+elapsed time.
 ******************************************************************************/
 void tim3_isr(void)
 {
+	ISR_PROFILE_ENTER(ISR_PROFILE_TIM3);
+	if (timer_get_flag(TIM3, TIM_SR_UIF))
+	{
+		timer_clear_flag(TIM3, TIM_SR_UIF);
+		timer_overflows++;
+		if (! (TIM_DIER(TIM3) & TIM_DIER_CC1IE)) timer_arm();
+	}
 /* Clear interrrupt flag. */
-	if (timer_get_flag(TIM3, TIM_SR_CC1IF))
-        {
-                timer_clear_flag(TIM3, TIM_SR_CC1IF);
+	if ((TIM_DIER(TIM3) & TIM_DIER_CC1IE) &&
+	    timer_get_flag(TIM3, TIM_SR_CC1IF))
+	{
+		timer_clear_flag(TIM3, TIM_SR_CC1IF);
+/* Only take the alarm once it is due, the match may have been forced */
+		if (alarm_pending && ((INTEGER32) (timerAlarm - timer_now()) <= 0))
+		{
+			timer_disable_irq(TIM3, TIM_DIER_CC1IE);
+			alarm_pending = 0;
+			last_time_set = timerAlarm;
+/* The main loop calls the time handler of the stack */
+			can_event_set(CAN_EVENT_ALARM);
+		}
+	}
 /* Reread to force the previous write before leaving (a side-effect of hardware pipelining)*/
-	        timer_get_flag(TIM3, TIM_SR_CC1IF);
-  	        last_time_set = timer_get_counter(TIM3);
-/* Call the time handler of the stack to adapt the elapsed time */
-  	        TimeDispatch();
-        }
+	timer_get_flag(TIM3, TIM_SR_UIF);
+	ISR_PROFILE_EXIT(ISR_PROFILE_TIM3);
 }
 
+#endif
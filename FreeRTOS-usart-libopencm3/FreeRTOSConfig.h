@@ -71,16 +71,20 @@
 #define configUSE_PREEMPTION            1
 #define configUSE_IDLE_HOOK             0
 #define configUSE_TICK_HOOK             0
+#ifdef STM32F4
+#define configCPU_CLOCK_HZ              ( ( unsigned long ) 168000000 )
+#else
 #define configCPU_CLOCK_HZ              ( ( unsigned long ) 72000000 )    
+#endif
 #define configTICK_RATE_HZ              ( ( portTickType ) 1000 )
 #define configMAX_PRIORITIES            ( 5 )
 #define configMINIMAL_STACK_SIZE        ( ( unsigned short ) 128 )
-#define configTOTAL_HEAP_SIZE           ( ( size_t ) ( 17 * 1024 ) )
+#define configTOTAL_HEAP_SIZE           ( ( size_t ) ( 3 * 1024 ) )
 #define configMAX_TASK_NAME_LEN         ( 16 )
-#define configUSE_TRACE_FACILITY        0
 #define configUSE_16_BIT_TICKS          0
 #define configIDLE_SHOULD_YIELD         1
 #define configUSE_MUTEXES               1
+#define configUSE_TICKLESS_IDLE         1
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES           0
@@ -97,17 +101,23 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelayUntil         1
 #define INCLUDE_vTaskDelay              1
 
-/* This is the raw value as per the Cortex-M3 NVIC.  Values can be 255
-(lowest) to 0 (1?) (highest). */
-#define configKERNEL_INTERRUPT_PRIORITY          254
-#define configMAX_SYSCALL_INTERRUPT_PRIORITY     191 /* equivalent to 0xb0, or priority 11. */
-
+/* Both the STM32F1 and STM32F4 implement the upper 4 bits of each NVIC
+priority, giving 16 levels. */
+#define configPRIO_BITS                 4
 
 /* This is the value being used as per the ST library which permits 16
-priority values, 0 to 15.  This must correspond to the
-configKERNEL_INTERRUPT_PRIORITY setting.  Here 15 corresponds to the lowest
-NVIC value of 255. */
+priority values, 0 to 15.  Here 15 is the lowest priority, used for the kernel
+and for the interrupts of the examples that call the FreeRTOS API. Interrupts
+at 0 to 10, above the syscall priority of 11, must not call the API. */
 #define configLIBRARY_KERNEL_INTERRUPT_PRIORITY    15
+#define configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY    11
+
+/* These are the raw values as per the Cortex-M NVIC, with the priority in
+the implemented upper bits: 0xf0 and 0xb0. */
+#define configKERNEL_INTERRUPT_PRIORITY          \
+    ( configLIBRARY_KERNEL_INTERRUPT_PRIORITY << ( 8 - configPRIO_BITS ) )
+#define configMAX_SYSCALL_INTERRUPT_PRIORITY     \
+    ( configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY << ( 8 - configPRIO_BITS ) )
 
 /* Timers */
 #define configUSE_TIMERS                1
@@ -115,5 +125,27 @@ NVIC value of 255. */
 #define configTIMER_QUEUE_LENGTH        10
 #define configTIMER_TASK_STACK_DEPTH    configMINIMAL_STACK_SIZE
 
+/* Run time statistics, built with RTOS_STATS=1 and rtos_stats.c in common, which
+drives the run time clock from the DWT cycle counter. */
+#ifdef RTOS_STATS
+#define configUSE_TRACE_FACILITY        1
+#define configGENERATE_RUN_TIME_STATS   1
+#define INCLUDE_uxTaskGetStackHighWaterMark 1
+extern void rtos_stats_clock_init(void);
+extern uint32_t rtos_stats_clock(void);
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() rtos_stats_clock_init()
+#define portGET_RUN_TIME_COUNTER_VALUE() rtos_stats_clock()
+#else
+#define configUSE_TRACE_FACILITY        0
+#endif
+
+/* Tickless idle with long idle periods in stop mode, built with
+RTOS_TICKLESS=1 and rtos_tickless.c in common. Otherwise the port's own
+SysTick tickless sleep is used. */
+#ifdef RTOS_TICKLESS
+extern void rtos_tickless_sleep(uint32_t expected_idle);
+#define portSUPPRESS_TICKS_AND_SLEEP( x ) rtos_tickless_sleep( x )
+#endif
+
 #endif /* FREERTOS_CONFIG_H */
 
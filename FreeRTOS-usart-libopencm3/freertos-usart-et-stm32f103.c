@@ -4,6 +4,16 @@ The first LED is blinked regularly. Characters from the source on USART1 are
 echoed. The second LED is toggled with the reception of a character, and the
 third is toggled on the transmission of a character.
 
+Built with RTOS_STATS the echoed lines are also taken as commands:
+T<CR> prints the CPU load of each task since the last report, the fewest
+words of stack each has had free, and the free and lowest free heap.
+P<CR> starts or stops a TELEMETRY_RTOS_STATS record of the same each second.
+
+Built with SUPERVISOR (and format.c) both tasks check in with supervisor.c,
+and the blink task, at the lowest priority, runs its monitor, which feeds the
+independent watchdog. A task that stops checking in is named in a message
+after the reset that follows.
+
 The board used is the ET-STM32F103 with LEDs on port B pins 8-15,
 but the test should work on the majority of STM32 based boards.
 */
@@ -20,17 +30,45 @@ but the test should work on the majority of STM32 based boards.
 #include <libopencm3/cm3/systick.h>
 
 #include "buffer.h"
+#include "serial.h"
+#ifdef RTOS_STATS
+#include "rtos_stats.h"
+#include "telemetry.h"
+#endif
+#ifdef RTOS_TICKLESS
+#include "rtos_tickless.h"
+#endif
+#ifdef SUPERVISOR
+#include "supervisor.h"
+#endif
 
 /* Scheduler includes. */
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
+#include "irq_priority.h"
 
 #define BUFFER_SIZE 64
+/* Send ring, which holds a statistics report (a power of two) */
+#define SEND_SIZE 512
 
 /* Globals */
-uint8_t send_buffer[BUFFER_SIZE+3];
-uint8_t receive_buffer[BUFFER_SIZE+3];
+static uint8_t send_data[SEND_SIZE];
+static ring_buffer_t send_buffer;
+uint8_t receive_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
+
+/* Task to be notified when characters arrive */
+static xTaskHandle usart_task;
+
+#ifdef RTOS_STATS
+/* Command line, and the statistics snapshot and record */
+static char line[32];
+static uint8_t characterPosition;
+static bool stats_telemetry;
+static rtos_stats_t stats;
+static uint8_t stats_record[RTOS_STATS_RECORD_HEADER+
+                            RTOS_STATS_MAX_TASKS*RTOS_STATS_RECORD_TASK];
+#endif
 
 /* for FreeRTOS */
 extern void xPortPendSVHandler(void);
@@ -42,13 +80,48 @@ static void clock_setup(void);
 static void systickSetup();
 static void usart_setup(void);
 static void gpio_setup(void);
+static void usart_rx_notify(void);
+#ifdef RTOS_STATS
+static void parseCommand(char *line);
+static void stats_print(void);
+static void stats_send(void);
+#endif
 
 /* Task priorities. */
 #define mainBLINK_TASK_PRIORITY				( tskIDLE_PRIORITY + 0 )
+#define mainUSART_TASK_PRIORITY				( tskIDLE_PRIORITY + 1 )
+
+/* The USART task formats and frames statistics reports on its stack. */
+#ifdef RTOS_STATS
+#define mainUSART_STACK_SIZE				( configMINIMAL_STACK_SIZE * 2 )
+#else
+#define mainUSART_STACK_SIZE				configMINIMAL_STACK_SIZE
+#endif
+
+/* Task stacks, declared here so that their RAM is fixed at link time. Only
+the task control blocks and the kernel's own tasks and queues take heap. */
+static portSTACK_TYPE blink_stack[configMINIMAL_STACK_SIZE];
+static portSTACK_TYPE usart_stack[mainUSART_STACK_SIZE];
+
+/* The rate at which statistics records are sent. */
+#define mainSTATS_PERIOD					( ( portTickType ) 1000 / portTICK_RATE_MS )
 
 /* The rate at which the blink task toggles the LED. */
 #define mainBLINK_DELAY						( ( portTickType ) 200 / portTICK_RATE_MS )
 
+#ifdef SUPERVISOR
+/* Longest times between the check-ins of the tasks, in ms, and the watchdog
+period, which allows a few of the monitor's polls from the blink task. */
+#define mainBLINK_CHECKIN					1000
+#define mainUSART_CHECKIN					1000
+#define mainWATCHDOG_PERIOD					1000
+/* The USART task waits no longer than this between check-ins */
+#define mainUSART_WAIT						( ( portTickType ) ( mainUSART_CHECKIN / 2 ) / portTICK_RATE_MS )
+
+static uint8_t blink_id;
+static uint8_t usart_id;
+#endif
+
 /* The number of nano seconds between each processor clock. */
 #define mainNS_PER_CLOCK ( ( unsigned portLONG ) ( ( 1.0 / ( double ) configCPU_CLOCK_HZ ) * 1000000000.0 ) )
 
@@ -73,17 +146,27 @@ int main( void )
 	debug();
 #endif
 
+#ifdef SUPERVISOR
+	supervisor_init();
+#endif
 	prvSetupHardware();
 
 	gpio_toggle(GPIOB, GPIO9);	/* LED on/off */
 	/* Start the blink task. */
-	xTaskCreate( prvBlinkTask, ( signed portCHAR * ) "Flash", \
-                 configMINIMAL_STACK_SIZE, NULL, mainBLINK_TASK_PRIORITY, NULL );
+	xTaskGenericCreate( prvBlinkTask, "Flash", configMINIMAL_STACK_SIZE, NULL,
+                        mainBLINK_TASK_PRIORITY, NULL, blink_stack, NULL );
 	gpio_toggle(GPIOB, GPIO10);	/* LED on/off */
 
 	/* Start the usart task. */
-	xTaskCreate( prvUsartTask, ( signed portCHAR * ) "USART", \
-                 configMINIMAL_STACK_SIZE, NULL, mainBLINK_TASK_PRIORITY, NULL );
+	xTaskGenericCreate( prvUsartTask, "USART", mainUSART_STACK_SIZE, NULL,
+                        mainUSART_TASK_PRIORITY, &usart_task, usart_stack, NULL );
+	serial_rx_notify(usart_rx_notify);
+
+#ifdef SUPERVISOR
+	blink_id = supervisor_register("Flash", mainBLINK_CHECKIN);
+	usart_id = supervisor_register("USART", mainUSART_CHECKIN);
+	supervisor_start(mainWATCHDOG_PERIOD);
+#endif
 
 	/* Start the scheduler. */
 	vTaskStartScheduler();
@@ -107,24 +190,123 @@ portTickType xLastExecutionTime;
 		verification. */
 		vTaskDelayUntil( &xLastExecutionTime, mainBLINK_DELAY );
 		gpio_toggle(GPIOB, GPIO8);	/* LED on/off */
+#ifdef SUPERVISOR
+		/* As the lowest priority task this stops if any other hogs the
+		processor, and the watchdog then resets it. */
+		supervisor_checkin(blink_id);
+		supervisor_poll(xTaskGetTickCount() * portTICK_RATE_MS);
+#endif
 	}
 }
 /*-----------------------------------------------------------*/
 
+/* Block until the receive interrupts give notice of new characters, then echo
+everything waiting in the buffer. With statistics the wait is also ended when
+the next record is due. This task is the only writer to the send ring. */
+
 static void prvUsartTask( void *pvParameters )
 {
+	uint16_t data;
+	portTickType xWait = portMAX_DELAY;
+#ifdef RTOS_STATS
+	portTickType xLastReport = xTaskGetTickCount();
+#endif
+#ifdef SUPERVISOR
+	supervisor_fault_t fault;
+	if (supervisor_last_fault(&fault))
+	{
+		if (fault.cause == SUPERVISOR_RESET_MISSED)
+			serial_printf("\r\nreset %u: %s missed its check-in by %u ms\r\n",
+                          fault.resets, fault.name,
+                          fault.overdue_ms - fault.period_ms);
+		else serial_printf("\r\nreset %u: watchdog\r\n", fault.resets);
+		serial_tx_start();
+	}
+#endif
+
     for( ;; )
 	{
-		uint16_t data = buffer_get(receive_buffer);
-		if (data == BUFFER_EMPTY) taskYIELD();
-		else
+#ifdef RTOS_STATS
+		if (stats_telemetry)
+		{
+			portTickType xElapsed = xTaskGetTickCount() - xLastReport;
+			xWait = (xElapsed >= mainSTATS_PERIOD) ? 0 : mainSTATS_PERIOD - xElapsed;
+		}
+		else xWait = portMAX_DELAY;
+#endif
+#ifdef SUPERVISOR
+		if (xWait > mainUSART_WAIT) xWait = mainUSART_WAIT;
+		supervisor_checkin(usart_id);
+#endif
+		ulTaskNotifyTake( pdTRUE, xWait );
+		while ((data = buffer_get(receive_buffer)) != BUFFER_EMPTY)
+		{
+			ring_put(&send_buffer, data);
+#ifdef RTOS_STATS
+			if (data == 0x0D)
+			{
+				line[characterPosition] = 0;
+				characterPosition = 0;
+				parseCommand(line);
+			}
+			else if (characterPosition < sizeof(line) - 1)
+				line[characterPosition++] = data;
+#endif
+		}
+#ifdef RTOS_STATS
+		if (! stats_telemetry) xLastReport = xTaskGetTickCount();
+		else if (xTaskGetTickCount() - xLastReport >= mainSTATS_PERIOD)
 		{
-			buffer_put(send_buffer, data);
-			usart_enable_tx_interrupt(USART1);
+			xLastReport += mainSTATS_PERIOD;
+			stats_send();
 		}
+#endif
+		serial_tx_start();
 	}
 }
 
+#ifdef RTOS_STATS
+/*-----------------------------------------------------------*/
+/* Parse a command line and act */
+
+static void parseCommand(char *line)
+{
+	if (line[0] == 'T') stats_print();
+	else if (line[0] == 'P') stats_telemetry = ! stats_telemetry;
+}
+
+/*-----------------------------------------------------------*/
+/* Print the task table: name, number, priority, CPU %, stack words free */
+
+static void stats_print(void)
+{
+	uint8_t i;
+
+	rtos_stats_update(&stats);
+	serial_printf("\r\nheap %u lowest %u\r\n", stats.heap_free,
+                  stats.heap_min_free);
+	for (i = 0; i < stats.count; i++)
+	{
+		rtos_task_stats_t *task = &stats.task[i];
+		serial_printf("%-8s %2u %u %3u.%u%% %u\r\n", task->name, task->number,
+                      task->priority, task->cpu / 10, task->cpu % 10,
+                      task->stack_free);
+	}
+}
+
+/*-----------------------------------------------------------*/
+/* Send the statistics as a telemetry record. A zero is sent first to end any
+echoed text, so that the decoder finds the frame. */
+
+static void stats_send(void)
+{
+	rtos_stats_update(&stats);
+	ring_put(&send_buffer, 0);
+	telemetry_send(TELEMETRY_RTOS_STATS, stats_record,
+                   rtos_stats_pack(stats_record, &stats));
+}
+#endif
+
 /*-----------------------------------------------------------*/
 
 static void prvSetupHardware( void )
@@ -134,15 +316,30 @@ static void prvSetupHardware( void )
 	gpio_setup();
 	usart_setup();
 /* Setup Rx/Tx buffers for USART */
-	buffer_init(send_buffer,BUFFER_SIZE);
+	ring_init(&send_buffer, send_data, SEND_SIZE);
 	buffer_init(receive_buffer,BUFFER_SIZE);
-
+	serial_tx_init_ring(&send_buffer);
+	serial_rx_init(receive_buffer);
+#ifdef RTOS_STATS
+	telemetry_init_ring(&send_buffer);
+#endif
+#ifdef RTOS_TICKLESS
+/* Stop mode is not allowed, as it halts USART reception, so idle periods are
+slept with the tick suppressed. */
+	rtos_tickless_init();
+	rtos_tickless_allow_stop(false);
+#endif
 }
 
 /*-----------------------------------------------------------*/
 /* USART 1 is configured for 115200 baud, no flow control and interrupt */
 static void usart_setup(void)
 {
+	/* The receive interrupts notify a task, so they must be at or below the
+	FreeRTOS syscall priority. The send DMA interrupt does not. */
+	IRQ_PRIORITY_SET_RTOS(NVIC_USART1_IRQ, IRQ_LEVEL_RTOS_COMM);
+	IRQ_PRIORITY_SET_RTOS(NVIC_DMA1_CHANNEL5_IRQ, IRQ_LEVEL_RTOS_COMM);
+	IRQ_PRIORITY_SET(NVIC_DMA1_CHANNEL4_IRQ, IRQ_LEVEL_COMM);
 	/* Enable the USART1 interrupt. */
 	nvic_enable_irq(NVIC_USART1_IRQ);
 	/* Setup GPIO pin GPIO_USART1_RE_TX on GPIO port A for transmit. */
@@ -218,27 +415,19 @@ static void systickSetup()
 /* USART ISR */
 void usart1_isr(void)
 {
-/* Find out what interrupted and get or send data as appropriate */
-	/* Check if we were called because of RXNE. */
-	if (usart_get_flag(USART1,USART_SR_RXNE))
-	{
-		/* If buffer full we'll just drop it */
-		buffer_put(receive_buffer, (uint8_t) usart_recv(USART1));
-	}
-	/* Check if we were called because of TXE. */
-	if (usart_get_flag(USART1,USART_SR_TXE))
-	{
-		/* If buffer empty, disable the tx interrupt */
-		uint16_t data = buffer_get(send_buffer);
-		if (data == BUFFER_EMPTY)
-		{
-			usart_disable_tx_interrupt(USART1);
-		}
-		else
-		{
-			usart_send(USART1, data);
-		}
-	}
+/* Pass received data to the buffer at the end of a burst. Transmission and
+reception are otherwise handled by DMA in the serial driver. */
+	serial_rx_idle_isr();
+}
+
+/*-----------------------------------------------------------*/
+/* Called by the serial driver receive interrupts when characters arrive */
+static void usart_rx_notify(void)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	vTaskNotifyGiveFromISR( usart_task, &xHigherPriorityTaskWoken );
+	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
 }
 
 /*-----------------------------------------------------------*/
@@ -20,17 +20,22 @@ but the test should work on the majority of STM32 based boards.
 #include <libopencm3/cm3/systick.h>
 
 #include "buffer.h"
+#include "mem_regions.h"
 
 /* Scheduler includes. */
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
+#include "irq_priority.h"
 
 #define BUFFER_SIZE 64
 
 /* Globals */
-uint8_t send_buffer[BUFFER_SIZE+3];
-uint8_t receive_buffer[BUFFER_SIZE+3];
+uint8_t send_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
+uint8_t receive_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
+
+/* Task to be notified when characters arrive */
+static xTaskHandle usart_task;
 
 /* for FreeRTOS */
 extern void xPortPendSVHandler(void);
@@ -46,10 +51,18 @@ static void systick_setup();
 
 /* Task priorities. */
 #define mainBLINK_TASK_PRIORITY				( tskIDLE_PRIORITY + 0 )
+#define mainUSART_TASK_PRIORITY				( tskIDLE_PRIORITY + 1 )
 
 /* The rate at which the blink task toggles the LED. */
 #define mainBLINK_DELAY						( ( portTickType ) 200 / portTICK_RATE_MS )
 
+/* Task stacks, declared here so that their RAM is fixed at link time. Only
+the task control blocks and the kernel's own tasks and queues take heap. They
+are in the core coupled memory, away from the DMA, which a stack may use as it
+needs no clearing at reset. */
+static portSTACK_TYPE blink_stack[configMINIMAL_STACK_SIZE] CCM_DATA;
+static portSTACK_TYPE usart_stack[configMINIMAL_STACK_SIZE] CCM_DATA;
+
 /* The number of nano seconds between each processor clock. */
 #define mainNS_PER_CLOCK ( ( unsigned portLONG ) ( ( 1.0 / ( double ) configCPU_CLOCK_HZ ) * 1000000000.0 ) )
 
@@ -72,12 +85,12 @@ int main( void )
 	prvSetupHardware();
 
 	/* Start the blink task. */
-	xTaskCreate( prvBlinkTask, ( signed portCHAR * ) "Flash",
-        configMINIMAL_STACK_SIZE, NULL, mainBLINK_TASK_PRIORITY, NULL );
+	xTaskGenericCreate( prvBlinkTask, "Flash", configMINIMAL_STACK_SIZE, NULL,
+        mainBLINK_TASK_PRIORITY, NULL, blink_stack, NULL );
 
 	/* Start the usart task. */
-	xTaskCreate( prvUsartTask, ( signed portCHAR * ) "USART",
-        configMINIMAL_STACK_SIZE, NULL, mainBLINK_TASK_PRIORITY, NULL );
+	xTaskGenericCreate( prvUsartTask, "USART", configMINIMAL_STACK_SIZE, NULL,
+        mainUSART_TASK_PRIORITY, &usart_task, usart_stack, NULL );
 
 	/* Start the scheduler. */
 	vTaskStartScheduler();
@@ -119,17 +132,19 @@ portTickType xLastExecutionTime;
 }
 /*-----------------------------------------------------------*/
 
+/* Block until the receive interrupt gives notice of new characters, then echo
+everything waiting in the buffer. */
+
 static void prvUsartTask( void *pvParameters )
 {
+	uint16_t data;
+
     for( ;; )
 	{
-		uint16_t data = buffer_get(receive_buffer);
-		if (data == BUFFER_EMPTY) taskYIELD();
-		else
-		{
+		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+		while ((data = buffer_get(receive_buffer)) != BUFFER_EMPTY)
 			buffer_put(send_buffer, data);
-			usart_enable_tx_interrupt(USART1);
-		}
+		usart_enable_tx_interrupt(USART1);
 	}
 }
 
@@ -167,12 +182,17 @@ void sys_tick_handler(void)
 /* USART ISR */
 void usart1_isr(void)
 {
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
 /* Find out what interrupted and get or send data as appropriate */
 	/* Check if we were called because of RXNE. */
 	if (usart_get_flag(USART1,USART_SR_RXNE))
 	{
 		/* If buffer full we'll just drop it */
 		buffer_put(receive_buffer, (uint8_t) usart_recv(USART1));
+		/* Wake the echo task once it has been created */
+		if (usart_task != NULL)
+			vTaskNotifyGiveFromISR( usart_task, &xHigherPriorityTaskWoken );
 	}
 	/* Check if we were called because of TXE. */
 	if (usart_get_flag(USART1,USART_SR_TXE))
@@ -188,12 +208,16 @@ void usart1_isr(void)
 			usart_send(USART1, data);
 		}
 	}
+	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
 }
 
 /*-----------------------------------------------------------*/
 /* USART 1 is configured for 115200 baud, no flow control and interrupt */
 static void usart_setup(void)
 {
+	/* The interrupt notifies a task, so it must be at or below the FreeRTOS
+	syscall priority. */
+	IRQ_PRIORITY_SET_RTOS(NVIC_USART1_IRQ, IRQ_LEVEL_RTOS_COMM);
 	/* Enable the USART1 interrupt. */
 	nvic_enable_irq(NVIC_USART1_IRQ);
 	/* Setup UART parameters. */
@@ -0,0 +1,518 @@
+/*	Circular Buffer Management
+
+Copyright (C) K. Sarkies <ksarkies@internode.on.net>
+
+19 September 2012
+
+Two forms of buffer are provided, sharing the same implementation.
+
+The byte buffer is 8 bit and is defined externally. It has the first element
+as the buffer size mask, the second as the buffer head and the third as the
+buffer tail. Space allocated must be BUFFER_OVERHEAD more than the buffer
+contents. The buffer size must be a power of two, no greater than 128.
+
+The ring buffer has a separate control structure with 32 bit indices, and a
+data region defined externally which may be word aligned and of any power of
+two size.
+
+In both cases the head and tail are free running counters that are reduced to
+an index by masking, so that no comparison and wrap is needed, and the full
+size of the buffer is usable.
+
+Buffer head counts items put in the buffer. It is written only by the
+producer.
+Buffer tail counts items taken from the buffer. It is written only by the
+consumer.
+
+Data can also be accessed in place for DMA and formatting. The producer asks
+for the largest contiguous free region, fills it and commits it. The consumer
+peeks the largest contiguous filled region, uses it and consumes it.
+
+If BUFFER_STATS is defined for the build, each buffer also records the highest
+fill level seen, the number of bytes dropped because the buffer was full, and
+the number of gets that found it empty. For the byte buffer these are held in
+the header after the tail, which is why BUFFER_OVERHEAD grows. Each count is
+written only by the side that causes it, so the lock-free property is kept.
+
+With a single producer and a single consumer (for example an ISR and the main
+loop) the buffer can be used without disabling interrupts, provided data is
+stored before the head is advanced and taken before the tail is advanced.
+*/
+
+#include <string.h>
+#include "buffer.h"
+
+/* Compiler barrier to keep the data access on the correct side of the index
+update. A single core Cortex M3/M4 does not reorder these as seen by its own
+interrupts. */
+#define buffer_barrier() __asm__ __volatile__ ("" ::: "memory")
+
+/* Access the byte buffer indices through volatile so that the other side of
+the buffer sees every update. */
+#define BUFFER_MASK(b) ((b)[0])
+#define BUFFER_HEAD(b) (*(volatile uint8_t *)&(b)[1])
+#define BUFFER_TAIL(b) (*(volatile uint8_t *)&(b)[2])
+#define BUFFER_DATA(b) (&(b)[BUFFER_OVERHEAD])
+
+#ifdef BUFFER_STATS
+/* Byte buffer statistics in the header: high water mark in one byte, and
+overflow and underrun counts as 16 bit little endian, saturating. */
+#define BUFFER_HIGH(b) ((b)[3])
+#define BUFFER_OVERFLOWS(b) (&(b)[4])
+#define BUFFER_UNDERRUNS(b) (&(b)[6])
+
+static inline uint16_t count_read(const uint8_t *counter)
+{
+	return counter[0] | (counter[1] << 8);
+}
+
+static inline void count_add(uint8_t *counter, uint16_t n)
+{
+	uint32_t total = count_read(counter) + n;
+	if (total > 0xFFFF) total = 0xFFFF;
+	counter[0] = total & 0xFF;
+	counter[1] = total >> 8;
+}
+
+/* Producer side: note the fill level and any bytes dropped */
+static inline void byte_stats_put(uint8_t buffer[], uint16_t dropped)
+{
+	uint8_t level = (uint8_t)(BUFFER_HEAD(buffer) - BUFFER_TAIL(buffer));
+	if (level > BUFFER_HIGH(buffer)) BUFFER_HIGH(buffer) = level;
+	if (dropped > 0) count_add(BUFFER_OVERFLOWS(buffer), dropped);
+}
+
+/* Consumer side: note a get that found nothing */
+static inline void byte_stats_underrun(uint8_t buffer[])
+{
+	count_add(BUFFER_UNDERRUNS(buffer), 1);
+}
+
+static inline void ring_stats_put(ring_buffer_t *ring, uint32_t dropped)
+{
+	uint32_t level = ring->head - ring->tail;
+	if (level > ring->stats.high_water) ring->stats.high_water = level;
+	ring->stats.overflows += dropped;
+}
+
+static inline void ring_stats_underrun(ring_buffer_t *ring)
+{
+	ring->stats.underruns++;
+}
+#else
+static inline void byte_stats_put(uint8_t buffer[], uint16_t dropped)
+	{ (void) buffer; (void) dropped; }
+static inline void byte_stats_underrun(uint8_t buffer[]) { (void) buffer; }
+static inline void ring_stats_put(ring_buffer_t *ring, uint32_t dropped)
+	{ (void) ring; (void) dropped; }
+static inline void ring_stats_underrun(ring_buffer_t *ring) { (void) ring; }
+#endif
+
+/*--------------------------------------------------------------------------*/
+/* Common implementation. The caller works out the count from its own index
+width; these only deal with the data region. */
+
+/* Copy a block into the data region starting at a masked index, wrapping at
+the end of the region. */
+static inline void copy_in(uint8_t *region, uint32_t mask, uint32_t index,
+                           const uint8_t *data, uint32_t length)
+{
+	uint32_t first = mask + 1 - index;
+	if (length <= first) memcpy(region + index, data, length);
+	else
+	{
+		memcpy(region + index, data, first);
+		memcpy(region, data + first, length - first);
+	}
+}
+
+/* Copy a block out of the data region starting at a masked index, wrapping
+at the end of the region. */
+static inline void copy_out(const uint8_t *region, uint32_t mask,
+                            uint32_t index, uint8_t *data, uint32_t length)
+{
+	uint32_t first = mask + 1 - index;
+	if (length <= first) memcpy(data, region + index, length);
+	else
+	{
+		memcpy(data, region + index, first);
+		memcpy(data + first, region, length - first);
+	}
+}
+
+/* Length of the contiguous part of a region of a given length starting at a
+masked index, that is, up to the end of the data region. */
+static inline uint32_t contiguous(uint32_t mask, uint32_t index,
+                                  uint32_t length)
+{
+	uint32_t first = mask + 1 - index;
+	return (length < first) ? length : first;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Byte buffer */
+
+/* Initialize the buffer to empty, defining the size (a power of two) */
+void buffer_init(uint8_t buffer[], uint8_t size)
+{
+	buffer[0] = size - 1;
+	buffer[1] = 0;		/* Head */
+	buffer[2] = 0;		/* Tail */
+	buffer_clear_stats(buffer);
+}
+
+/* Get a byte from the buffer. Returns a byte in the lower 8 bits,
+or BUFFER_EMPTY if the buffer has no data. */
+uint16_t buffer_get(uint8_t buffer[])
+{
+	uint8_t tail = BUFFER_TAIL(buffer);
+	if (BUFFER_HEAD(buffer) == tail)
+	{
+		byte_stats_underrun(buffer);
+		return BUFFER_EMPTY;					/* no data available */
+	}
+	buffer_barrier();
+	uint8_t data = BUFFER_DATA(buffer)[tail & BUFFER_MASK(buffer)];
+	buffer_barrier();
+	BUFFER_TAIL(buffer) = tail + 1;
+	return (uint16_t) data;
+}
+
+/* Put a byte to the buffer. Returns BUFFER_FULL if the buffer has no space. */
+uint16_t buffer_put(uint8_t buffer[], uint8_t data)
+{
+	uint8_t head = BUFFER_HEAD(buffer);
+	if ((uint8_t)(head - BUFFER_TAIL(buffer)) > BUFFER_MASK(buffer))
+	{
+		byte_stats_put(buffer, 1);
+		return BUFFER_FULL;						/* no space available */
+	}
+	BUFFER_DATA(buffer)[head & BUFFER_MASK(buffer)] = data;
+	buffer_barrier();
+	BUFFER_HEAD(buffer) = head + 1;
+	byte_stats_put(buffer, 0);
+	return 0;
+}
+
+/* Put a block of bytes to the buffer. As many bytes as will fit are copied,
+and the head is advanced once at the end. Returns the number of bytes put. */
+uint16_t buffer_put_n(uint8_t buffer[], const uint8_t *data, uint16_t length)
+{
+	uint8_t head = BUFFER_HEAD(buffer);
+	uint16_t space = buffer_space(buffer);
+	uint16_t requested = length;
+	if (length > space) length = space;
+	copy_in(BUFFER_DATA(buffer), BUFFER_MASK(buffer),
+            head & BUFFER_MASK(buffer), data, length);
+	buffer_barrier();
+	BUFFER_HEAD(buffer) = head + length;
+	byte_stats_put(buffer, requested - length);
+	return length;
+}
+
+/* Get a block of bytes from the buffer. As many bytes as are available up to
+the length given are copied, and the tail is advanced once at the end.
+Returns the number of bytes taken. */
+uint16_t buffer_get_n(uint8_t buffer[], uint8_t *data, uint16_t length)
+{
+	uint8_t tail = BUFFER_TAIL(buffer);
+	uint16_t count = buffer_count(buffer);
+	if ((count == 0) && (length > 0)) byte_stats_underrun(buffer);
+	if (length > count) length = count;
+	buffer_barrier();
+	copy_out(BUFFER_DATA(buffer), BUFFER_MASK(buffer),
+             tail & BUFFER_MASK(buffer), data, length);
+	buffer_barrier();
+	BUFFER_TAIL(buffer) = tail + length;
+	return length;
+}
+
+/* Find the largest contiguous free region at the head. Sets data to its start
+and returns its length, which may be zero. Bytes written there are not seen by
+the consumer until buffer_commit is called. */
+uint16_t buffer_reserve_contiguous(uint8_t buffer[], uint8_t **data)
+{
+	uint8_t index = BUFFER_HEAD(buffer) & BUFFER_MASK(buffer);
+	*data = BUFFER_DATA(buffer) + index;
+	return contiguous(BUFFER_MASK(buffer), index, buffer_space(buffer));
+}
+
+/* Hand over bytes written to a reserved region. The length must not exceed
+that returned by buffer_reserve_contiguous. */
+void buffer_commit(uint8_t buffer[], uint16_t length)
+{
+	buffer_barrier();
+	BUFFER_HEAD(buffer) = BUFFER_HEAD(buffer) + length;
+	byte_stats_put(buffer, 0);
+}
+
+/* Advance the head over bytes already written in place by a circular DMA, which
+does not wait for space. If unread data has been overwritten, the tail is moved
+past it so that the buffer holds the latest data, and the loss is counted as an
+overflow. This is the one case where the producer moves the tail, so a get made
+at the same time may return stale data. Returns the number of bytes lost. */
+uint16_t buffer_commit_dma(uint8_t buffer[], uint16_t length)
+{
+	uint16_t space = buffer_space(buffer);
+	uint16_t lost = 0;
+	if (length > space)
+	{
+		lost = length - space;
+		BUFFER_TAIL(buffer) = BUFFER_TAIL(buffer) + lost;
+	}
+	buffer_barrier();
+	BUFFER_HEAD(buffer) = BUFFER_HEAD(buffer) + length;
+	byte_stats_put(buffer, lost);
+	return lost;
+}
+
+/* Find the largest contiguous filled region at the tail. Sets data to its
+start and returns its length, which may be zero. The bytes remain in the
+buffer until buffer_consume is called. */
+uint16_t buffer_peek_contiguous(uint8_t buffer[], uint8_t **data)
+{
+	uint8_t index = BUFFER_TAIL(buffer) & BUFFER_MASK(buffer);
+	uint16_t length = contiguous(BUFFER_MASK(buffer), index,
+                                 buffer_count(buffer));
+	buffer_barrier();
+	*data = BUFFER_DATA(buffer) + index;
+	return length;
+}
+
+/* Release bytes taken from a peeked region. The length must not exceed that
+returned by buffer_peek_contiguous. */
+void buffer_consume(uint8_t buffer[], uint16_t length)
+{
+	buffer_barrier();
+	BUFFER_TAIL(buffer) = BUFFER_TAIL(buffer) + length;
+}
+
+/* Return the number of bytes held in the buffer */
+uint16_t buffer_count(uint8_t buffer[])
+{
+	return (uint8_t)(BUFFER_HEAD(buffer) - BUFFER_TAIL(buffer));
+}
+
+/* Return the number of bytes that can be put to the buffer */
+uint16_t buffer_space(uint8_t buffer[])
+{
+	return BUFFER_MASK(buffer) + 1 - buffer_count(buffer);
+}
+
+/* Return true if the buffer has space available */
+bool buffer_output_free(uint8_t buffer[])
+{
+	return (buffer_count(buffer) <= BUFFER_MASK(buffer));
+}
+
+/* Return true if the buffer has a byte available */
+bool buffer_input_available(uint8_t buffer[])
+{
+	return (BUFFER_HEAD(buffer) != BUFFER_TAIL(buffer));
+}
+
+/* Read the statistics of the buffer. These are all zero unless the library
+is built with BUFFER_STATS defined. */
+void buffer_read_stats(uint8_t buffer[], buffer_stats_t *stats)
+{
+#ifdef BUFFER_STATS
+	stats->high_water = BUFFER_HIGH(buffer);
+	stats->overflows = count_read(BUFFER_OVERFLOWS(buffer));
+	stats->underruns = count_read(BUFFER_UNDERRUNS(buffer));
+#else
+	(void) buffer;
+	stats->high_water = 0;
+	stats->overflows = 0;
+	stats->underruns = 0;
+#endif
+}
+
+/* Clear the statistics of the buffer. A count made by an ISR at the same time
+may be lost. */
+void buffer_clear_stats(uint8_t buffer[])
+{
+#ifdef BUFFER_STATS
+	uint8_t i;
+	for (i = 3; i < BUFFER_OVERHEAD; i++) buffer[i] = 0;
+#else
+	(void) buffer;
+#endif
+}
+
+/*--------------------------------------------------------------------------*/
+/* Ring buffer */
+
+/* Initialize the ring to empty over the data region given, whose size must be
+a power of two. */
+void ring_init(ring_buffer_t *ring, uint8_t *data, uint32_t size)
+{
+	ring->data = data;
+	ring->mask = size - 1;
+	ring->head = 0;
+	ring->tail = 0;
+	ring_clear_stats(ring);
+}
+
+/* Get a byte from the ring. Returns a byte in the lower 8 bits,
+or BUFFER_EMPTY if the ring has no data. */
+uint16_t ring_get(ring_buffer_t *ring)
+{
+	uint32_t tail = ring->tail;
+	if (ring->head == tail)
+	{
+		ring_stats_underrun(ring);
+		return BUFFER_EMPTY;					/* no data available */
+	}
+	buffer_barrier();
+	uint8_t data = ring->data[tail & ring->mask];
+	buffer_barrier();
+	ring->tail = tail + 1;
+	return (uint16_t) data;
+}
+
+/* Put a byte to the ring. Returns BUFFER_FULL if the ring has no space. */
+uint16_t ring_put(ring_buffer_t *ring, uint8_t data)
+{
+	uint32_t head = ring->head;
+	if ((head - ring->tail) > ring->mask)
+	{
+		ring_stats_put(ring, 1);
+		return BUFFER_FULL;
+	}
+	ring->data[head & ring->mask] = data;
+	buffer_barrier();
+	ring->head = head + 1;
+	ring_stats_put(ring, 0);
+	return 0;
+}
+
+/* Put a block of bytes to the ring. Returns the number of bytes put. */
+uint32_t ring_put_n(ring_buffer_t *ring, const uint8_t *data, uint32_t length)
+{
+	uint32_t head = ring->head;
+	uint32_t space = ring_space(ring);
+	uint32_t requested = length;
+	if (length > space) length = space;
+	copy_in(ring->data, ring->mask, head & ring->mask, data, length);
+	buffer_barrier();
+	ring->head = head + length;
+	ring_stats_put(ring, requested - length);
+	return length;
+}
+
+/* Get a block of bytes from the ring. Returns the number of bytes taken. */
+uint32_t ring_get_n(ring_buffer_t *ring, uint8_t *data, uint32_t length)
+{
+	uint32_t tail = ring->tail;
+	uint32_t count = ring_count(ring);
+	if ((count == 0) && (length > 0)) ring_stats_underrun(ring);
+	if (length > count) length = count;
+	buffer_barrier();
+	copy_out(ring->data, ring->mask, tail & ring->mask, data, length);
+	buffer_barrier();
+	ring->tail = tail + length;
+	return length;
+}
+
+/* Find the largest contiguous free region at the head of the ring. Sets data
+to its start and returns its length. */
+uint32_t ring_reserve_contiguous(ring_buffer_t *ring, uint8_t **data)
+{
+	uint32_t index = ring->head & ring->mask;
+	*data = ring->data + index;
+	return contiguous(ring->mask, index, ring_space(ring));
+}
+
+/* Hand over bytes written to a reserved region of the ring. */
+void ring_commit(ring_buffer_t *ring, uint32_t length)
+{
+	buffer_barrier();
+	ring->head += length;
+	ring_stats_put(ring, 0);
+}
+
+/* Advance the head of the ring over bytes written in place by a circular DMA.
+As for buffer_commit_dma, overwritten data is skipped and counted. */
+uint32_t ring_commit_dma(ring_buffer_t *ring, uint32_t length)
+{
+	uint32_t space = ring_space(ring);
+	uint32_t lost = 0;
+	if (length > space)
+	{
+		lost = length - space;
+		ring->tail += lost;
+	}
+	buffer_barrier();
+	ring->head += length;
+	ring_stats_put(ring, lost);
+	return lost;
+}
+
+/* Find the largest contiguous filled region at the tail of the ring. Sets data
+to its start and returns its length. */
+uint32_t ring_peek_contiguous(ring_buffer_t *ring, uint8_t **data)
+{
+	uint32_t index = ring->tail & ring->mask;
+	uint32_t length = contiguous(ring->mask, index, ring_count(ring));
+	buffer_barrier();
+	*data = ring->data + index;
+	return length;
+}
+
+/* Release bytes taken from a peeked region of the ring. */
+void ring_consume(ring_buffer_t *ring, uint32_t length)
+{
+	buffer_barrier();
+	ring->tail += length;
+}
+
+/* Return the number of bytes held in the ring */
+uint32_t ring_count(ring_buffer_t *ring)
+{
+	return ring->head - ring->tail;
+}
+
+/* Return the number of bytes that can be put to the ring */
+uint32_t ring_space(ring_buffer_t *ring)
+{
+	return ring->mask + 1 - ring_count(ring);
+}
+
+/* Return true if the ring has space available */
+bool ring_output_free(ring_buffer_t *ring)
+{
+	return (ring_count(ring) <= ring->mask);
+}
+
+/* Return true if the ring has a byte available */
+bool ring_input_available(ring_buffer_t *ring)
+{
+	return (ring->head != ring->tail);
+}
+
+/* Read the statistics of the ring. These are all zero unless the library is
+built with BUFFER_STATS defined. */
+void ring_read_stats(ring_buffer_t *ring, buffer_stats_t *stats)
+{
+#ifdef BUFFER_STATS
+	*stats = ring->stats;
+#else
+	(void) ring;
+	stats->high_water = 0;
+	stats->overflows = 0;
+	stats->underruns = 0;
+#endif
+}
+
+/* Clear the statistics of the ring. */
+void ring_clear_stats(ring_buffer_t *ring)
+{
+#ifdef BUFFER_STATS
+	ring->stats.high_water = 0;
+	ring->stats.overflows = 0;
+	ring->stats.underruns = 0;
+#else
+	(void) ring;
+#endif
+}
+
@@ -0,0 +1,84 @@
+/*	Circular Buffer Management
+
+Copyright (C) K. Sarkies <ksarkies@internode.on.net>
+
+19 September 2012
+
+Shared by all the examples. Define BUFFER_STATS in the build to record buffer
+usage statistics.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#define BUFFER_EMPTY 0x100
+#define BUFFER_FULL 0x200
+
+/* Space needed in a byte buffer array in addition to its contents */
+#ifdef BUFFER_STATS
+#define BUFFER_OVERHEAD 8
+#else
+#define BUFFER_OVERHEAD 3
+#endif
+
+/* Buffer usage statistics */
+typedef struct
+{
+	uint32_t high_water;		/* Highest number of bytes held */
+	uint32_t overflows;			/* Bytes dropped because the buffer was full */
+	uint32_t underruns;			/* Gets made when the buffer was empty */
+} buffer_stats_t;
+
+/* Large capacity buffer. The control structure is kept apart from the data
+region so that the region can be word aligned and several KB long. */
+typedef struct
+{
+	volatile uint32_t head;		/* Count of bytes put, written by producer */
+	volatile uint32_t tail;		/* Count of bytes taken, written by consumer */
+	uint32_t mask;				/* Size - 1, the size being a power of two */
+	uint8_t *data;				/* Data region */
+#ifdef BUFFER_STATS
+	buffer_stats_t stats;
+#endif
+} ring_buffer_t;
+
+/* Size given to buffer_init must be a power of two, 128 maximum. */
+void buffer_init(uint8_t buffer[], uint8_t size);
+uint16_t buffer_get(uint8_t buffer[]);
+uint16_t buffer_put(uint8_t buffer[], uint8_t data);
+uint16_t buffer_put_n(uint8_t buffer[], const uint8_t *data, uint16_t length);
+uint16_t buffer_get_n(uint8_t buffer[], uint8_t *data, uint16_t length);
+uint16_t buffer_count(uint8_t buffer[]);
+uint16_t buffer_space(uint8_t buffer[]);
+bool buffer_output_free(uint8_t buffer[]);
+bool buffer_input_available(uint8_t buffer[]);
+uint16_t buffer_reserve_contiguous(uint8_t buffer[], uint8_t **data);
+void buffer_commit(uint8_t buffer[], uint16_t length);
+uint16_t buffer_commit_dma(uint8_t buffer[], uint16_t length);
+uint16_t buffer_peek_contiguous(uint8_t buffer[], uint8_t **data);
+void buffer_consume(uint8_t buffer[], uint16_t length);
+void buffer_read_stats(uint8_t buffer[], buffer_stats_t *stats);
+void buffer_clear_stats(uint8_t buffer[]);
+
+/* Size given to ring_init must be a power of two. */
+void ring_init(ring_buffer_t *ring, uint8_t *data, uint32_t size);
+uint16_t ring_get(ring_buffer_t *ring);
+uint16_t ring_put(ring_buffer_t *ring, uint8_t data);
+uint32_t ring_put_n(ring_buffer_t *ring, const uint8_t *data, uint32_t length);
+uint32_t ring_get_n(ring_buffer_t *ring, uint8_t *data, uint32_t length);
+uint32_t ring_count(ring_buffer_t *ring);
+uint32_t ring_space(ring_buffer_t *ring);
+bool ring_output_free(ring_buffer_t *ring);
+bool ring_input_available(ring_buffer_t *ring);
+uint32_t ring_reserve_contiguous(ring_buffer_t *ring, uint8_t **data);
+void ring_commit(ring_buffer_t *ring, uint32_t length);
+uint32_t ring_commit_dma(ring_buffer_t *ring, uint32_t length);
+uint32_t ring_peek_contiguous(ring_buffer_t *ring, uint8_t **data);
+void ring_consume(ring_buffer_t *ring, uint32_t length);
+void ring_read_stats(ring_buffer_t *ring, buffer_stats_t *stats);
+void ring_clear_stats(ring_buffer_t *ring);
+
+#endif 
@@ -0,0 +1,448 @@
+/*	Dual bxCAN Gateway
+
+CAN1 is on PD0 (RX) and PD1 (TX) and CAN2 on PB12 (RX) and PB13 (TX), which
+are clear of the peripherals of the STM32F4-Discovery. Each controller gets
+half of the 28 filter banks, one per rule in 32 bit mask mode, so a frame
+that no rule forwards is dropped by the hardware and never interrupts. A
+controller given no rules receives nothing.
+
+The FIFO 0 pending interrupt of the receiving controller takes each frame as
+its four register words, finds the first rule it matches, renames it and,
+when nothing is queued for that direction and a mailbox of the other
+controller is free, writes it straight to the mailbox from the same
+interrupt, so a frame is forwarded within a few microseconds of its arrival
+and is never copied into a structure of its own. Otherwise it waits in the
+queue of the direction, emptied by the mailbox empty interrupt of the sending
+controller, and a frame finding the queue full is counted and dropped. Both
+controllers send in the order of the requests, so frames keep their order
+through the gateway.
+
+All the CAN interrupts are at the same priority, so none preempts another and
+each queue, written by one receive handler and read by one transmit handler,
+needs no masking. With the mirror enabled each frame received is also put in a
+mirror ring with its direction, and can_gateway_mirror_drain sends these from
+the main loop as TELEMETRY_CAN records of telemetry.c, 13 bytes a frame: the
+identifier little endian with bit 31 set for an extended and bit 30 for a
+remote frame, then the length with bit 7 set for CAN2 to CAN1, then 8 data
+bytes.
+
+The bit timing is computed from the APB1 clock for a sample point near 87.5%,
+as in the CanFestival driver. Both controllers recover from bus off by
+themselves.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/can.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+#include "irq_priority.h"
+#include "telemetry.h"
+#include "can_gateway.h"
+
+/* Time quanta per bit are chosen from this range, most first */
+#define CAN_TQ_MIN          8
+#define CAN_TQ_MAX          19
+#define CAN_BRP_MAX         1024
+
+/* First filter bank of CAN2 in the filter master register */
+#define FMR_CAN2SB_SHIFT    8
+#define FMR_CAN2SB_MASK     (0x3F << FMR_CAN2SB_SHIFT)
+
+#define MAILBOX_FREE        (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2)
+
+/* Bytes of a frame in a mirror record, and frames in a record */
+#define MIRROR_BYTES        13
+#define MIRROR_FRAMES       (TELEMETRY_MAX_PAYLOAD / MIRROR_BYTES)
+
+/* A frame as the words of a mailbox. The identifier word has the same layout
+in the receive and transmit mailboxes, the transmit request bit apart. */
+typedef struct {
+	uint32_t ir;
+	uint32_t dtr;               /* length only */
+	uint32_t dlr;
+	uint32_t dhr;
+} frame_t;
+
+typedef struct {
+	uint32_t in;                /* controller received on */
+	uint32_t out;               /* controller sent on */
+	const can_gateway_rule_t *rules;
+	uint8_t rule_count;
+	frame_t queue[CAN_GATEWAY_QUEUE];
+	volatile uint32_t head;     /* written by the receive handler of in */
+	volatile uint32_t tail;     /* written by the transmit handler of out */
+	can_gateway_stats_t stats;
+} route_t;
+
+static route_t routes[CAN_GATEWAY_DIRECTIONS];
+
+static frame_t mirror_frames[CAN_GATEWAY_MIRROR];
+static uint8_t mirror_dirs[CAN_GATEWAY_MIRROR];
+static volatile uint32_t mirror_head;
+static volatile uint32_t mirror_tail;
+static volatile bool mirror_on;
+
+static bool port_init(uint32_t port, uint32_t bitrate);
+static void filter_rule(uint32_t bank, const can_gateway_port_t *port,
+                        uint8_t rule);
+static uint32_t id_register(uint32_t id, bool extended);
+static void receive(can_gateway_dir_t dir);
+static void send_queued(route_t *route);
+static uint32_t remap(const route_t *route, uint32_t ir);
+static void write_mailbox(uint32_t port, const frame_t *frame);
+static void mirror_put(can_gateway_dir_t dir, const frame_t *frame);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the Gateway
+
+Both controllers are set up with their pins, bit rates, filters and
+interrupts, and forwarding starts at once.
+
+@param[in] can1: bit rate of CAN1 and the rules for the frames it receives.
+@param[in] can2: the same for CAN2.
+@returns false if a bit rate cannot be made, there are too many rules, or a
+controller does not start.
+*/
+
+bool can_gateway_init(const can_gateway_port_t *can1,
+                      const can_gateway_port_t *can2)
+{
+	uint8_t i;
+
+	if ((can1->rule_count > CAN_GATEWAY_RULES) ||
+	    (can2->rule_count > CAN_GATEWAY_RULES)) return false;
+
+	routes[CAN_GATEWAY_1TO2].in = CAN1;
+	routes[CAN_GATEWAY_1TO2].out = CAN2;
+	routes[CAN_GATEWAY_1TO2].rules = can1->rules;
+	routes[CAN_GATEWAY_1TO2].rule_count = can1->rule_count;
+	routes[CAN_GATEWAY_2TO1].in = CAN2;
+	routes[CAN_GATEWAY_2TO1].out = CAN1;
+	routes[CAN_GATEWAY_2TO1].rules = can2->rules;
+	routes[CAN_GATEWAY_2TO1].rule_count = can2->rule_count;
+	for (i = 0; i < CAN_GATEWAY_DIRECTIONS; i++)
+	{
+		routes[i].head = routes[i].tail = 0;
+		routes[i].stats.forwarded = 0;
+		routes[i].stats.dropped = 0;
+		routes[i].stats.mirror_dropped = 0;
+		routes[i].stats.queue_max = 0;
+	}
+	mirror_head = mirror_tail = 0;
+
+/* CAN2 is a slave of CAN1, whose clock must be on for its filters. */
+	rcc_periph_clock_enable(RCC_GPIOB);
+	rcc_periph_clock_enable(RCC_GPIOD);
+	rcc_periph_clock_enable(RCC_CAN1);
+	rcc_periph_clock_enable(RCC_CAN2);
+	gpio_mode_setup(GPIOD, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO0 | GPIO1);
+	gpio_set_af(GPIOD, GPIO_AF9, GPIO0 | GPIO1);
+	gpio_mode_setup(GPIOB, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO12 | GPIO13);
+	gpio_set_af(GPIOB, GPIO_AF9, GPIO12 | GPIO13);
+
+	if (! port_init(CAN1, can1->bitrate)) return false;
+	if (! port_init(CAN2, can2->bitrate)) return false;
+
+/* Split the filter banks, then give each rule its bank */
+	CAN_FMR(CAN1) |= CAN_FMR_FINIT;
+	CAN_FMR(CAN1) = (CAN_FMR(CAN1) & ~FMR_CAN2SB_MASK) |
+	                (CAN_GATEWAY_RULES << FMR_CAN2SB_SHIFT);
+	CAN_FMR(CAN1) &= ~CAN_FMR_FINIT;
+	for (i = 0; i < CAN_GATEWAY_RULES; i++)
+	{
+		filter_rule(i, can1, i);
+		filter_rule(CAN_GATEWAY_RULES + i, can2, i);
+	}
+
+	IRQ_PRIORITY_SET(NVIC_CAN1_RX0_IRQ, IRQ_LEVEL_COMM);
+	IRQ_PRIORITY_SET(NVIC_CAN1_TX_IRQ, IRQ_LEVEL_COMM);
+	IRQ_PRIORITY_SET(NVIC_CAN2_RX0_IRQ, IRQ_LEVEL_COMM);
+	IRQ_PRIORITY_SET(NVIC_CAN2_TX_IRQ, IRQ_LEVEL_COMM);
+	nvic_enable_irq(NVIC_CAN1_RX0_IRQ);
+	nvic_enable_irq(NVIC_CAN1_TX_IRQ);
+	nvic_enable_irq(NVIC_CAN2_RX0_IRQ);
+	nvic_enable_irq(NVIC_CAN2_TX_IRQ);
+	can_enable_irq(CAN1, CAN_IER_FMPIE0 | CAN_IER_TMEIE);
+	can_enable_irq(CAN2, CAN_IER_FMPIE0 | CAN_IER_TMEIE);
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Enable the Mirror
+
+Frames received from now on are kept for can_gateway_mirror_drain. Frames
+already kept are sent whether or not it is enabled.
+
+@param[in] enable: true to mirror the traffic.
+*/
+
+void can_gateway_mirror(bool enable)
+{
+	mirror_on = enable;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send the Mirrored Frames
+
+Called from the main loop. The frames are packed into TELEMETRY_CAN records
+until telemetry.c has no room, and the rest are left for the next call.
+
+@returns frames sent.
+*/
+
+uint32_t can_gateway_mirror_drain(void)
+{
+	uint8_t payload[MIRROR_FRAMES*MIRROR_BYTES];
+	uint32_t count = 0;
+
+	while (mirror_tail != mirror_head)
+	{
+		uint32_t waiting = mirror_head - mirror_tail;
+		if (waiting > MIRROR_FRAMES) waiting = MIRROR_FRAMES;
+		uint32_t i;
+		for (i = 0; i < waiting; i++)
+		{
+			uint32_t slot = (mirror_tail + i) & (CAN_GATEWAY_MIRROR - 1);
+			const frame_t *frame = &mirror_frames[slot];
+			uint8_t *out = payload + i*MIRROR_BYTES;
+			uint32_t id;
+			if (frame->ir & CAN_RIxR_IDE)
+				id = (frame->ir >> CAN_RIxR_EXID_SHIFT) | 0x80000000;
+			else id = frame->ir >> CAN_RIxR_STID_SHIFT;
+			if (frame->ir & CAN_RIxR_RTR) id |= 0x40000000;
+			uint8_t j;
+			for (j = 0; j < 4; j++)
+			{
+				out[j] = id >> (j*8);
+				out[5 + j] = frame->dlr >> (j*8);
+				out[9 + j] = frame->dhr >> (j*8);
+			}
+			out[4] = (frame->dtr & CAN_RDTxR_DLC_MASK) |
+			         ((mirror_dirs[slot] == CAN_GATEWAY_2TO1) ? 0x80 : 0);
+		}
+		if (! telemetry_send(TELEMETRY_CAN, payload, waiting*MIRROR_BYTES))
+			break;
+		mirror_tail += waiting;
+		count += waiting;
+	}
+	return count;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Read the Statistics of a Direction
+
+@param[in] dir: direction.
+@param[out] stats: copy of its counts.
+*/
+
+void can_gateway_read_stats(can_gateway_dir_t dir, can_gateway_stats_t *stats)
+{
+	bool masked = cm_mask_interrupts(true);
+	*stats = routes[dir].stats;
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Set up a controller, searching the bit timing from the largest number of
+time quanta that divides the APB1 clock exactly. Automatic bus off recovery
+and transmit FIFO priority, normal mode. */
+
+static bool port_init(uint32_t port, uint32_t bitrate)
+{
+	uint32_t rate = bitrate*1000;
+	uint32_t brp = 0;
+	uint32_t tq, ts1, ts2;
+
+	if (rate == 0) return false;
+	for (tq = CAN_TQ_MAX; tq >= CAN_TQ_MIN; tq--)
+	{
+		if ((rcc_apb1_frequency % (rate*tq)) == 0)
+		{
+			brp = rcc_apb1_frequency/(rate*tq);
+			break;
+		}
+	}
+	if ((brp == 0) || (brp > CAN_BRP_MAX)) return false;
+/* Sample point at 7/8 of the bit. The sync segment is one quantum. */
+	ts1 = (tq*7 + 4)/8 - 1;
+	ts2 = tq - 1 - ts1;
+
+	can_reset(port);
+	return can_init(port, false, true, false, false, false, true,
+	                CAN_BTR_SJW_1TQ, (ts1 - 1) << CAN_BTR_TS1_SHIFT,
+	                (ts2 - 1) << CAN_BTR_TS2_SHIFT, brp, false, false) == 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Program a filter bank from a rule of a port, to FIFO 0, or disable it if
+the port has no such rule. The IDE bit is always compared, so a rule passes
+only frames of its own format. The filters are all in the registers of CAN1. */
+
+static void filter_rule(uint32_t bank, const can_gateway_port_t *port,
+                        uint8_t rule)
+{
+	if (rule < port->rule_count)
+	{
+		const can_gateway_rule_t *r = &port->rules[rule];
+		can_filter_id_mask_32bit_init(CAN1, bank,
+		                              id_register(r->id, r->extended),
+		                              id_register(r->mask, r->extended) |
+		                              CAN_RIxR_IDE, 0, true);
+	}
+	else can_filter_init(CAN1, bank, false, false, 0, 0, 0, false);
+}
+
+/*--------------------------------------------------------------------------*/
+/* An identifier as the identifier word of a mailbox or filter. */
+
+static uint32_t id_register(uint32_t id, bool extended)
+{
+	if (extended)
+		return ((id & 0x1FFFFFFF) << CAN_RIxR_EXID_SHIFT) | CAN_RIxR_IDE;
+	return (id & 0x7FF) << CAN_RIxR_STID_SHIFT;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Take all the frames pending in FIFO 0 of the receiving controller and
+forward each. */
+
+static void receive(can_gateway_dir_t dir)
+{
+	route_t *route = &routes[dir];
+	uint32_t in = route->in;
+	uint32_t out = route->out;
+
+	while (CAN_RF0R(in) & CAN_RF0R_FMP0_MASK)
+	{
+		frame_t frame;
+		frame.ir = CAN_RIxR(in, CAN_FIFO0);
+		frame.dtr = CAN_RDTxR(in, CAN_FIFO0) & CAN_RDTxR_DLC_MASK;
+		frame.dlr = CAN_RDLxR(in, CAN_FIFO0);
+		frame.dhr = CAN_RDHxR(in, CAN_FIFO0);
+		CAN_RF0R(in) = CAN_RF0R_RFOM0;
+		if (mirror_on) mirror_put(dir, &frame);
+		frame.ir = remap(route, frame.ir);
+
+		uint32_t queued = route->head - route->tail;
+		if ((queued == 0) && (CAN_TSR(out) & MAILBOX_FREE))
+		{
+			write_mailbox(out, &frame);
+			route->stats.forwarded++;
+		}
+		else if (queued < CAN_GATEWAY_QUEUE)
+		{
+			route->queue[route->head & (CAN_GATEWAY_QUEUE - 1)] = frame;
+			route->head++;
+			if (queued + 1 > route->stats.queue_max)
+				route->stats.queue_max = queued + 1;
+		}
+		else route->stats.dropped++;
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/* Refill the free mailboxes of the sending controller from the queue. */
+
+static void send_queued(route_t *route)
+{
+	uint32_t out = route->out;
+
+/* Clear the request completed flags that raised the interrupt */
+	CAN_TSR(out) = CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2;
+	while ((route->tail != route->head) && (CAN_TSR(out) & MAILBOX_FREE))
+	{
+		write_mailbox(out, &route->queue[route->tail & (CAN_GATEWAY_QUEUE - 1)]);
+		route->tail++;
+		route->stats.forwarded++;
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/* Rename a frame by the first rule it matches. The filters have passed only
+frames that match a rule. */
+
+static uint32_t remap(const route_t *route, uint32_t ir)
+{
+	bool extended = (ir & CAN_RIxR_IDE) != 0;
+	uint32_t id = extended ? (ir >> CAN_RIxR_EXID_SHIFT) :
+	                         (ir >> CAN_RIxR_STID_SHIFT);
+	uint8_t i;
+
+	for (i = 0; i < route->rule_count; i++)
+	{
+		const can_gateway_rule_t *rule = &route->rules[i];
+		if ((rule->extended == extended) &&
+		    (((id ^ rule->id) & rule->mask) == 0))
+		{
+			if (rule->remap == CAN_GATEWAY_KEEP) break;
+			id = (rule->remap & rule->mask) | (id & ~rule->mask);
+			return id_register(id, extended) | (ir & CAN_RIxR_RTR);
+		}
+	}
+	return ir & ~CAN_TIxR_TXRQ;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Write a frame to the next free mailbox and request transmission. The caller
+has checked that a mailbox is free. */
+
+static void write_mailbox(uint32_t port, const frame_t *frame)
+{
+	uint32_t mbox;
+
+	switch ((CAN_TSR(port) & CAN_TSR_CODE_MASK) >> 24)
+	{
+	case 0: mbox = CAN_MBOX0; break;
+	case 1: mbox = CAN_MBOX1; break;
+	default: mbox = CAN_MBOX2; break;
+	}
+	CAN_TDTxR(port, mbox) = frame->dtr;
+	CAN_TDLxR(port, mbox) = frame->dlr;
+	CAN_TDHxR(port, mbox) = frame->dhr;
+	CAN_TIxR(port, mbox) = frame->ir | CAN_TIxR_TXRQ;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Keep a received frame for the mirror. Only the receive handlers write the
+ring, and as they do not preempt each other it has one producer. */
+
+static void mirror_put(can_gateway_dir_t dir, const frame_t *frame)
+{
+	uint32_t head = mirror_head;
+	if (head - mirror_tail >= CAN_GATEWAY_MIRROR)
+	{
+		routes[dir].stats.mirror_dropped++;
+		return;
+	}
+	mirror_frames[head & (CAN_GATEWAY_MIRROR - 1)] = *frame;
+	mirror_dirs[head & (CAN_GATEWAY_MIRROR - 1)] = dir;
+	mirror_head = head + 1;
+}
+
+/*--------------------------------------------------------------------------*/
+/* CAN Interrupts */
+
+void can1_rx0_isr(void)
+{
+	receive(CAN_GATEWAY_1TO2);
+}
+
+void can2_rx0_isr(void)
+{
+	receive(CAN_GATEWAY_2TO1);
+}
+
+void can1_tx_isr(void)
+{
+	send_queued(&routes[CAN_GATEWAY_2TO1]);
+}
+
+void can2_tx_isr(void)
+{
+	send_queued(&routes[CAN_GATEWAY_1TO2]);
+}
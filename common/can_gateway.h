@@ -0,0 +1,73 @@
+/*	Dual bxCAN Gateway
+
+Frames are forwarded between CAN1 and CAN2 of the STM32F4 from interrupt to
+interrupt, selected by the hardware filters of each controller and renamed by
+a table of rules, with a transmit queue for each direction and an optional
+mirror of the traffic to telemetry.c.
+
+15 October 2026
+*/
+
+#ifndef CAN_GATEWAY_H
+#define CAN_GATEWAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Rules of each controller, one filter bank each. The 28 banks of the F4 are
+split evenly, CAN2 starting at bank CAN_GATEWAY_RULES. */
+#define CAN_GATEWAY_RULES       14
+
+/* Frames held for each direction while the mailboxes are busy, a power of
+two */
+#ifndef CAN_GATEWAY_QUEUE
+#define CAN_GATEWAY_QUEUE       32
+#endif
+
+/* Frames held for the mirror between drains, a power of two */
+#ifndef CAN_GATEWAY_MIRROR
+#define CAN_GATEWAY_MIRROR      64
+#endif
+
+/* Remap value that sends a frame on with its own identifier */
+#define CAN_GATEWAY_KEEP        0xFFFFFFFF
+
+typedef enum {
+	CAN_GATEWAY_1TO2,
+	CAN_GATEWAY_2TO1,
+	CAN_GATEWAY_DIRECTIONS
+} can_gateway_dir_t;
+
+/* A frame received whose identifier matches id in the bits set in mask is
+forwarded, with the identifier made from remap in those bits and from the
+frame's own identifier in the others, so that a range can be moved as a
+block. Identifiers are 11 bits, or 29 bits for an extended rule, and remote
+frames are forwarded as they are. */
+typedef struct {
+	uint32_t id;
+	uint32_t mask;
+	uint32_t remap;             /* or CAN_GATEWAY_KEEP */
+	bool extended;
+} can_gateway_rule_t;
+
+/* One side of the gateway, the rules being for frames received on it */
+typedef struct {
+	uint32_t bitrate;           /* kilobit per second */
+	const can_gateway_rule_t *rules;
+	uint8_t rule_count;         /* up to CAN_GATEWAY_RULES */
+} can_gateway_port_t;
+
+typedef struct {
+	uint32_t forwarded;
+	uint32_t dropped;           /* the queue was full */
+	uint32_t mirror_dropped;    /* the mirror was full */
+	uint32_t queue_max;         /* most frames queued at once */
+} can_gateway_stats_t;
+
+bool can_gateway_init(const can_gateway_port_t *can1,
+                      const can_gateway_port_t *can2);
+void can_gateway_mirror(bool enable);
+uint32_t can_gateway_mirror_drain(void);
+void can_gateway_read_stats(can_gateway_dir_t dir, can_gateway_stats_t *stats);
+
+#endif
@@ -0,0 +1,321 @@
+/*	Timer Input Capture by DMA
+
+Pulse trains of up to several hundred kHz, from encoders and flow meters, are
+measured with no interrupt per edge. Each capture of TIM2 channel 1 (PA0)
+raises a DMA request, and DMA1 channel 5 moves the captured count into the
+data region of a circular buffer of buffer.c, running circular over it. The
+DMA interrupts come only at each half of the buffer, when the buffer head is
+advanced over the new captures, so the edge rate is limited by the DMA rather
+than by the interrupt overhead. The captures are taken from the buffer a
+contiguous span at a time by capture_process, which accumulates the count,
+sum, least and greatest of the periods for the frequency and its spread.
+
+In CAPTURE_EDGES mode the counter runs freely over 16 bits and the rising edge
+timestamps are captured, the periods being the differences of successive
+timestamps. In CAPTURE_PWM_INPUT mode channel 2 captures the falling edges of
+the same input, and each rising edge resets the counter, so CCR1 holds the
+period and CCR2 the high time. The DMA reads both in a burst through TIM2_DMAR
+on each rising edge. In either mode the prescaler must make every period less
+than 65536 ticks.
+
+Captures the DMA overwrites before they are processed are counted as lost, and
+the periods across them are not measured. DMA1 channel 5 is also the USART1
+receive channel of serial.c, so with serial.c build with SERIAL_USART1_NO_DMA.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+#include "buffer.h"
+#include "capture.h"
+
+/* DMA burst from CCR1 of two registers */
+#define DCR_DBA_CCR1        13
+#define DCR_DBL_2           (1 << 8)
+
+static ring_buffer_t ring;
+static uint32_t ring_size;
+/* Bytes of each capture record, one or two halfwords */
+static uint8_t record;
+static uint8_t capture_mode;
+static uint32_t tick_hz;
+/* Offset in the buffer the DMA had reached when last looked at */
+static uint32_t last_position;
+/* Timestamp of the previous edge, valid while chained is set */
+static uint16_t last_edge;
+static bool chained;
+static uint32_t lost_records;
+
+static void add_period(capture_stats_t *stats, uint16_t period,
+		       uint16_t high);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the Capture
+
+The data region is word aligned and remains owned by the DMA while the capture
+runs.
+
+@param[in] mode: CAPTURE_EDGES or CAPTURE_PWM_INPUT.
+@param[in] data: region for the captures.
+@param[in] size: size of the region in bytes, a power of two.
+@param[in] prescale: timer clocks per tick, from 1 to 65535.
+*/
+
+void capture_init(uint8_t mode, uint8_t *data, uint32_t size,
+		  uint16_t prescale)
+{
+	uint32_t timer_clock = rcc_apb1_frequency;
+/* The timer clock is twice the APB1 clock if APB1 is divided down */
+	if (((RCC_CFGR >> RCC_CFGR_PPRE1_SHIFT) & 0x7) != RCC_CFGR_PPRE1_HCLK_NODIV)
+		timer_clock *= 2;
+	tick_hz = timer_clock/prescale;
+	capture_mode = mode;
+	record = (mode == CAPTURE_PWM_INPUT) ? 4 : 2;
+	ring_init(&ring, data, size);
+	ring_size = size;
+	last_position = 0;
+	chained = false;
+	lost_records = 0;
+
+/* PA0 is TIM2_CH1 as a floating input */
+	rcc_peripheral_enable_clock(&RCC_APB2ENR, RCC_APB2ENR_IOPAEN);
+	gpio_set_mode(GPIOA, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT, GPIO0);
+
+	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM2EN);
+	timer_reset(TIM2);
+	timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT,
+		       TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+	timer_continuous_mode(TIM2);
+	timer_set_prescaler(TIM2, prescale - 1);
+	timer_set_period(TIM2, 0xFFFF);
+	timer_ic_set_input(TIM2, TIM_IC1, TIM_IC_IN_TI1);
+	timer_ic_set_filter(TIM2, TIM_IC1, TIM_IC_OFF);
+	timer_ic_set_prescaler(TIM2, TIM_IC1, TIM_IC_PSC_OFF);
+	timer_ic_set_polarity(TIM2, TIM_IC1, TIM_IC_RISING);
+	timer_ic_enable(TIM2, TIM_IC1);
+	if (mode == CAPTURE_PWM_INPUT)
+	{
+/* Channel 2 takes the falling edge of TI1, and the rising edge resets the
+counter after it is captured. */
+		timer_ic_set_input(TIM2, TIM_IC2, TIM_IC_IN_TI1);
+		timer_ic_set_filter(TIM2, TIM_IC2, TIM_IC_OFF);
+		timer_ic_set_prescaler(TIM2, TIM_IC2, TIM_IC_PSC_OFF);
+		timer_ic_set_polarity(TIM2, TIM_IC2, TIM_IC_FALLING);
+		timer_ic_enable(TIM2, TIM_IC2);
+		timer_slave_set_trigger(TIM2, TIM_SMCR_TS_IT1FP1);
+		timer_slave_set_mode(TIM2, TIM_SMCR_SMS_RM);
+	}
+
+/* The channel 1 capture DMA request is served by DMA1 channel 5 */
+	rcc_peripheral_enable_clock(&RCC_AHBENR, RCC_AHBENR_DMA1EN);
+	dma_channel_reset(DMA1, DMA_CHANNEL5);
+	dma_set_priority(DMA1, DMA_CHANNEL5, DMA_CCR_PL_VERY_HIGH);
+	dma_set_memory_size(DMA1, DMA_CHANNEL5, DMA_CCR_MSIZE_16BIT);
+	dma_set_peripheral_size(DMA1, DMA_CHANNEL5, DMA_CCR_PSIZE_16BIT);
+	dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL5);
+	dma_enable_circular_mode(DMA1, DMA_CHANNEL5);
+	dma_set_read_from_peripheral(DMA1, DMA_CHANNEL5);
+	if (mode == CAPTURE_PWM_INPUT)
+	{
+		dma_set_peripheral_address(DMA1, DMA_CHANNEL5,
+					   (uint32_t) &TIM_DMAR(TIM2));
+		TIM_DCR(TIM2) = DCR_DBL_2 | DCR_DBA_CCR1;
+	}
+	else
+		dma_set_peripheral_address(DMA1, DMA_CHANNEL5,
+					   (uint32_t) &TIM2_CCR1);
+	dma_set_memory_address(DMA1, DMA_CHANNEL5, (uint32_t) data);
+	dma_set_number_of_data(DMA1, DMA_CHANNEL5, size/2);
+	dma_enable_half_transfer_interrupt(DMA1, DMA_CHANNEL5);
+	dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL5);
+	nvic_enable_irq(NVIC_DMA1_CHANNEL5_IRQ);
+	dma_enable_channel(DMA1, DMA_CHANNEL5);
+
+	timer_set_dma_on_compare_event(TIM2);
+	TIM_DIER(TIM2) |= TIM_DIER_CC1DE;
+	timer_enable_counter(TIM2);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Rate of the Capture Timebase
+
+@returns ticks per second of the captured counts.
+*/
+
+uint32_t capture_tick_hz(void)
+{
+	return tick_hz;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Take the New Captures
+
+Advance the buffer head to the DMA position, rounded down to a whole record as
+a burst may be part done. This is called from the DMA interrupt, and before
+processing to take the captures since.
+
+@returns the number of records taken.
+*/
+
+uint32_t capture_update(void)
+{
+	bool masked = cm_mask_interrupts(true);
+	uint32_t position = ring_size - 2*DMA_CNDTR(DMA1, DMA_CHANNEL5);
+	if (position >= ring_size) position = 0;
+	position &= ~((uint32_t) record - 1);
+	uint32_t length = (position - last_position) & (ring_size - 1);
+	last_position = position;
+	if (length > 0)
+	{
+		uint32_t lost = ring_commit_dma(&ring, length);
+		if (lost > 0)
+		{
+			lost_records += lost/record;
+			chained = false;
+		}
+	}
+	cm_mask_interrupts(masked);
+	return length/record;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Captures Waiting
+
+@returns the number of records taken and not yet processed.
+*/
+
+uint32_t capture_count(void)
+{
+	return ring_count(&ring)/record;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Process the Captures
+
+Each contiguous span of the buffer is worked through in place and released.
+If the DMA overran the span meanwhile, the buffer tail has already been moved
+beyond it and is left there.
+
+@param[in] stats: statistics to accumulate into.
+@returns the number of records processed.
+*/
+
+uint32_t capture_process(capture_stats_t *stats)
+{
+	uint8_t *data;
+	uint32_t records = 0;
+	capture_update();
+	while (true)
+	{
+		uint32_t tail = ring.tail;
+		uint32_t length = ring_peek_contiguous(&ring, &data) &
+				  ~((uint32_t) record - 1);
+		if (length == 0) break;
+		const uint16_t *capture = (const uint16_t *) data;
+		uint32_t count = length/record;
+		uint32_t i;
+		if (capture_mode == CAPTURE_PWM_INPUT)
+		{
+/* The counter is reset one tick after the edge it captures */
+			for (i = 0; i < count; i++)
+				add_period(stats, capture[2*i] + 1, capture[2*i + 1] + 1);
+		}
+		else
+		{
+			for (i = 0; i < count; i++)
+			{
+				if (chained) add_period(stats, capture[i] - last_edge, 0);
+				last_edge = capture[i];
+				chained = true;
+			}
+		}
+		bool masked = cm_mask_interrupts(true);
+		if (ring.tail == tail) ring_consume(&ring, length);
+		else chained = false;
+		cm_mask_interrupts(masked);
+		records += count;
+	}
+	bool masked = cm_mask_interrupts(true);
+	stats->lost += lost_records;
+	lost_records = 0;
+	cm_mask_interrupts(masked);
+	return records;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Clear the Statistics
+
+@param[in] stats: statistics to clear.
+*/
+
+void capture_clear_stats(capture_stats_t *stats)
+{
+	stats->periods = 0;
+	stats->period_sum = 0;
+	stats->high_sum = 0;
+	stats->period_min = 0xFFFF;
+	stats->period_max = 0;
+	stats->lost = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Mean Frequency
+
+@param[in] stats: accumulated statistics.
+@returns the mean frequency over the periods in mHz, or 0 if none.
+*/
+
+uint32_t capture_frequency_mhz(const capture_stats_t *stats)
+{
+	if (stats->period_sum == 0) return 0;
+	return ((uint64_t) tick_hz*1000*stats->periods)/stats->period_sum;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Mean Duty Cycle
+
+@param[in] stats: accumulated statistics, from PWM input mode.
+@returns the high time as parts per thousand of the period.
+*/
+
+uint16_t capture_duty_permille(const capture_stats_t *stats)
+{
+	if (stats->period_sum == 0) return 0;
+	return (stats->high_sum*1000)/stats->period_sum;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Add one period to the statistics. */
+
+static void add_period(capture_stats_t *stats, uint16_t period,
+		       uint16_t high)
+{
+	stats->periods++;
+	stats->period_sum += period;
+	stats->high_sum += high;
+	if (period < stats->period_min) stats->period_min = period;
+	if (period > stats->period_max) stats->period_max = period;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief DMA Interrupt
+
+At each half of the buffer take the captures, so that the head never falls a
+whole lap behind the DMA.
+*/
+
+void dma1_channel5_isr(void)
+{
+	if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL5, DMA_HTIF))
+		dma_clear_interrupt_flags(DMA1, DMA_CHANNEL5, DMA_HTIF);
+	if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL5, DMA_TCIF))
+		dma_clear_interrupt_flags(DMA1, DMA_CHANNEL5, DMA_TCIF);
+	capture_update();
+}
@@ -0,0 +1,42 @@
+/*	Timer Input Capture by DMA
+
+Timestamps of the edges on TIM2 channel 1 (PA0), or the period and high time
+of each cycle in PWM input mode, moved by DMA into a circular buffer, with the
+frequency and duty statistics worked out a block at a time.
+
+14 October 2026
+*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Modes given to capture_init */
+#define CAPTURE_EDGES       0   /* 16 bit timestamp of each rising edge */
+#define CAPTURE_PWM_INPUT   1   /* period and high time of each cycle */
+
+/* Statistics of the periods measured, accumulated by capture_process */
+typedef struct
+{
+	uint32_t periods;           /* Periods measured */
+	uint64_t period_sum;        /* Sum of the periods in ticks */
+	uint64_t high_sum;          /* Sum of the high times, PWM input only */
+	uint16_t period_min;
+	uint16_t period_max;
+	uint32_t lost;              /* Captures overwritten before processing */
+} capture_stats_t;
+
+/* Size given to capture_init must be a power of two, in bytes. */
+void capture_init(uint8_t mode, uint8_t *data, uint32_t size,
+		  uint16_t prescale);
+uint32_t capture_tick_hz(void);
+uint32_t capture_update(void);
+uint32_t capture_count(void);
+uint32_t capture_process(capture_stats_t *stats);
+void capture_clear_stats(capture_stats_t *stats);
+uint32_t capture_frequency_mhz(const capture_stats_t *stats);
+uint16_t capture_duty_permille(const capture_stats_t *stats);
+
+#endif
@@ -0,0 +1,466 @@
+/*	Checksum Service
+
+The CRC unit of the STM32F1 and F4 works out the CRC-32 of polynomial
+0x04C11DB7 over 32 bit words written to its data register, starting from
+0xFFFFFFFF, one word in a few clock cycles. It has no register to load a CRC
+into, so to carry on with a CRC it is reset and given the one word that takes
+it from 0xFFFFFFFF to that CRC, found by running the CRC backwards. Each user
+therefore keeps its own CRC, several streams can be worked out in turn, and
+the unit is shared by all. The processor feeds it in runs of up to UNIT_RUN
+words with interrupts masked, so that a task or interrupt can use it at any
+time.
+
+checksum_crc32_dma_start hands a large range to memory to memory DMA, leaving
+the processor free, and checksum_crc32_dma_done is polled until it is done.
+It moves on to the next transfer when a range has more words than one DMA
+transfer takes. While the DMA has the unit others work out the same CRC in
+software from a table of 16 words. The STM32F4 DMA cannot reach the CCM, so
+a range there is done by the processor.
+
+The data is taken as little endian words. The bytes of a part word are held
+in the state until the word is complete, so a stream may be fed in pieces of
+any length, and a part word left at the end is filled with 0xFF, as by
+flash_write_crc.
+
+The CRC-16 is CRC-16/CCITT-FALSE, as telemetry.c, and the CRC-8 has the
+polynomial 0x07 (CRC-8/SMBUS), both from tables of 256 entries.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/crc.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/cm3/cortex.h>
+#include "checksum.h"
+
+#define CRC32_POLYNOMIAL        0x04C11DB7
+
+/* Words fed to the unit at a time with interrupts masked */
+#define UNIT_RUN                64
+
+/* Most words of one DMA transfer */
+#define DMA_MAX_WORDS           65535
+
+static const uint32_t crc32_table[16] =
+{
+	0x00000000, 0x04C11DB7, 0x09823B6E, 0x0D4326D9,
+	0x130476DC, 0x17C56B6B, 0x1A864DB2, 0x1E475005,
+	0x2608EDB8, 0x22C9F00F, 0x2F8AD6D6, 0x2B4BCB61,
+	0x350C9B64, 0x31CD86D3, 0x3C8EA00A, 0x384FBDBD
+};
+
+static const uint16_t crc16_table[256] =
+{
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+	0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+	0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+	0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+	0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+	0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+	0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+	0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+	0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+	0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+	0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+	0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+	0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+	0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+	0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+	0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+	0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+	0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+	0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+	0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+	0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+	0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+	0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+	0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+	0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+	0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+	0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+	0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+	0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+	0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+	0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+static const uint8_t crc8_table[256] =
+{
+	0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+	0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+	0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65,
+	0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+	0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5,
+	0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+	0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85,
+	0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+	0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2,
+	0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+	0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2,
+	0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+	0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32,
+	0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+	0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42,
+	0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+	0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C,
+	0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+	0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC,
+	0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+	0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C,
+	0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+	0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C,
+	0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+	0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B,
+	0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+	0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B,
+	0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+	0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB,
+	0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+	0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB,
+	0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3
+};
+
+/* The range being fed by DMA. dma_job is set while one is taken, and
+dma_busy while the DMA has the unit. */
+static volatile bool dma_job;
+static volatile bool dma_busy;
+static checksum_crc32_t *dma_state;
+static const uint8_t *dma_next;
+static uint32_t dma_words;
+static const uint8_t *dma_tail;
+static uint32_t dma_tail_length;
+
+static uint32_t crc_words(uint32_t crc, const uint8_t *data, uint32_t words);
+static uint32_t software_word(uint32_t crc, uint32_t word);
+static void unit_load(uint32_t crc);
+static bool dma_reachable(const uint8_t *data, uint32_t length);
+static void dma_transfer(void);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start a CRC-32
+
+@param[out] state: CRC to start.
+*/
+
+void checksum_crc32_start(checksum_crc32_t *state)
+{
+	rcc_periph_clock_enable(RCC_CRC);
+	state->crc = CHECKSUM_CRC32_INIT;
+	state->carry = 0;
+	state->carry_length = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Add Data to a CRC-32
+
+@param[in] state: CRC in progress.
+@param[in] data: data to add, of any alignment.
+@param[in] length: number of bytes.
+*/
+
+void checksum_crc32_update(checksum_crc32_t *state, const void *data,
+                           uint32_t length)
+{
+	const uint8_t *byte = data;
+/* Complete a part word first */
+	while ((state->carry_length > 0) && (length > 0))
+	{
+		state->carry |= (uint32_t) *byte++ << (8*state->carry_length);
+		length--;
+		if (++state->carry_length == 4)
+		{
+			state->crc = crc_words(state->crc, (const uint8_t *) &state->carry,
+			                       1);
+			state->carry = 0;
+			state->carry_length = 0;
+		}
+	}
+	uint32_t words = length/4;
+	state->crc = crc_words(state->crc, byte, words);
+	byte += 4*words;
+	length -= 4*words;
+	while (length-- > 0)
+		state->carry |= (uint32_t) *byte++ << (8*state->carry_length++);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Finish a CRC-32
+
+A part word left is filled with 0xFF and added.
+
+@param[in] state: CRC in progress.
+@returns the CRC.
+*/
+
+uint32_t checksum_crc32_finish(checksum_crc32_t *state)
+{
+	if (state->carry_length > 0)
+	{
+		uint32_t word = state->carry | (0xFFFFFFFF << (8*state->carry_length));
+		state->crc = crc_words(state->crc, (const uint8_t *) &word, 1);
+		state->carry = 0;
+		state->carry_length = 0;
+	}
+	return state->crc;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief CRC-32 of a Block
+
+@param[in] data: start of the block, of any alignment.
+@param[in] length: length of the block in bytes.
+@returns the CRC.
+*/
+
+uint32_t checksum_crc32(const void *data, uint32_t length)
+{
+	checksum_crc32_t state;
+	checksum_crc32_start(&state);
+	checksum_crc32_update(&state, data, length);
+	return checksum_crc32_finish(&state);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Add a Large Range to a CRC-32 by DMA
+
+The whole words of the range are fed to the unit by DMA, and the processor
+adds the bytes before and after them. A range the DMA cannot take, being out
+of its reach or not word aligned once a part word of the state is completed,
+is added by the processor before returning. The state must not be used until
+checksum_crc32_dma_done returns true.
+
+@param[in] state: CRC in progress.
+@param[in] data: range to add.
+@param[in] length: number of bytes.
+@returns false if the DMA is already taken, with nothing done.
+*/
+
+bool checksum_crc32_dma_start(checksum_crc32_t *state, const void *data,
+                              uint32_t length)
+{
+	bool masked = cm_mask_interrupts(true);
+	if (dma_job)
+	{
+		cm_mask_interrupts(masked);
+		return false;
+	}
+	dma_job = true;
+	cm_mask_interrupts(masked);
+
+	const uint8_t *byte = data;
+	uint32_t head = (4 - state->carry_length) & 3;
+	if (head > length) head = length;
+	checksum_crc32_update(state, byte, head);
+	byte += head;
+	length -= head;
+	dma_state = state;
+	dma_words = length/4;
+	if ((((uint32_t) byte & 3) != 0) || ! dma_reachable(byte, length))
+		dma_words = 0;
+	dma_next = byte;
+	dma_tail = byte + 4*dma_words;
+	dma_tail_length = length - 4*dma_words;
+	if (dma_words > 0)
+	{
+		masked = cm_mask_interrupts(true);
+		unit_load(state->crc);
+		dma_busy = true;
+		cm_mask_interrupts(masked);
+		dma_transfer();
+	}
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Poll the DMA Feed
+
+Each poll finds whether the transfer has ended, starting the next while the
+range has more words. At the end the bytes after the words are added and the
+state is ready.
+
+@returns true if no range is being fed.
+*/
+
+bool checksum_crc32_dma_done(void)
+{
+	if (! dma_job) return true;
+	if (dma_busy)
+	{
+#ifdef STM32F4
+		if (! dma_get_interrupt_flag(DMA2, CHECKSUM_DMA_STREAM, DMA_TCIF))
+			return false;
+		dma_clear_interrupt_flags(DMA2, CHECKSUM_DMA_STREAM, DMA_TCIF);
+		dma_disable_stream(DMA2, CHECKSUM_DMA_STREAM);
+#else
+		if (! dma_get_interrupt_flag(DMA1, CHECKSUM_DMA_CHANNEL, DMA_TCIF))
+			return false;
+		dma_clear_interrupt_flags(DMA1, CHECKSUM_DMA_CHANNEL, DMA_TCIF);
+		dma_disable_channel(DMA1, CHECKSUM_DMA_CHANNEL);
+#endif
+		if (dma_words > 0)
+		{
+			dma_transfer();
+			return false;
+		}
+		dma_state->crc = CRC_DR;
+		dma_busy = false;
+	}
+	checksum_crc32_update(dma_state, dma_tail, dma_tail_length);
+	dma_job = false;
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief CRC-16/CCITT-FALSE
+
+@param[in] crc: running CRC, CHECKSUM_CRC16_INIT to start.
+@param[in] data: data to add.
+@param[in] length: number of bytes.
+@returns updated CRC.
+*/
+
+uint16_t checksum_crc16(uint16_t crc, const uint8_t *data, uint32_t length)
+{
+	while (length-- > 0)
+		crc = (crc << 8) ^ crc16_table[(crc >> 8) ^ *data++];
+	return crc;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief CRC-8 of Polynomial 0x07
+
+@param[in] crc: running CRC, CHECKSUM_CRC8_INIT to start.
+@param[in] data: data to add.
+@param[in] length: number of bytes.
+@returns updated CRC.
+*/
+
+uint8_t checksum_crc8(uint8_t crc, const uint8_t *data, uint32_t length)
+{
+	while (length-- > 0) crc = crc8_table[crc ^ *data++];
+	return crc;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Add whole words to a CRC, by the unit unless the DMA has it. */
+
+static uint32_t crc_words(uint32_t crc, const uint8_t *data, uint32_t words)
+{
+	uint32_t word;
+	while (words > 0)
+	{
+		uint32_t run = (words > UNIT_RUN) ? UNIT_RUN : words;
+		words -= run;
+		bool masked = cm_mask_interrupts(true);
+		if (dma_busy)
+		{
+			for (; run > 0; run--, data += 4)
+			{
+				memcpy(&word, data, 4);
+				crc = software_word(crc, word);
+			}
+		}
+		else
+		{
+			unit_load(crc);
+			for (; run > 0; run--, data += 4)
+			{
+				memcpy(&word, data, 4);
+				CRC_DR = word;
+			}
+			crc = CRC_DR;
+		}
+		cm_mask_interrupts(masked);
+	}
+	return crc;
+}
+
+/*--------------------------------------------------------------------------*/
+/* One word of the CRC of the unit in software, four bits at a time. */
+
+static uint32_t software_word(uint32_t crc, uint32_t word)
+{
+	uint8_t i;
+	crc ^= word;
+	for (i = 0; i < 8; i++) crc = (crc << 4) ^ crc32_table[crc >> 28];
+	return crc;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Set the unit to a CRC. The CRC is run back through the 32 shifts of a word
+to the value that, exclusive ORed with the reset value, gives it. */
+
+static void unit_load(uint32_t crc)
+{
+	crc_reset();
+	if (crc == CHECKSUM_CRC32_INIT) return;
+	uint8_t i;
+	for (i = 0; i < 32; i++)
+	{
+		if (crc & 1) crc = ((crc ^ CRC32_POLYNOMIAL) >> 1) | 0x80000000;
+		else crc >>= 1;
+	}
+	CRC_DR = crc ^ CHECKSUM_CRC32_INIT;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Check that the DMA can read a range. On the STM32F4 it cannot reach the
+CCM. */
+
+static bool dma_reachable(const uint8_t *data, uint32_t length)
+{
+#ifdef STM32F4
+	uint32_t start = (uint32_t) data;
+	return (start + length <= 0x10000000) || (start >= 0x10010000);
+#else
+	(void) data;
+	(void) length;
+	return true;
+#endif
+}
+
+/*--------------------------------------------------------------------------*/
+/* Start a DMA transfer of the next words of the range to the unit. On the
+STM32F4 the source of a memory to memory transfer is the peripheral port, and
+on the STM32F1 the memory port. */
+
+static void dma_transfer(void)
+{
+	uint32_t words = (dma_words > DMA_MAX_WORDS) ? DMA_MAX_WORDS : dma_words;
+#ifdef STM32F4
+	rcc_periph_clock_enable(RCC_DMA2);
+	dma_stream_reset(DMA2, CHECKSUM_DMA_STREAM);
+	dma_set_transfer_mode(DMA2, CHECKSUM_DMA_STREAM, DMA_SxCR_DIR_MEM_TO_MEM);
+	dma_set_priority(DMA2, CHECKSUM_DMA_STREAM, DMA_SxCR_PL_LOW);
+	dma_set_peripheral_address(DMA2, CHECKSUM_DMA_STREAM, (uint32_t) dma_next);
+	dma_set_peripheral_size(DMA2, CHECKSUM_DMA_STREAM, DMA_SxCR_PSIZE_32BIT);
+	dma_enable_peripheral_increment_mode(DMA2, CHECKSUM_DMA_STREAM);
+	dma_set_memory_address(DMA2, CHECKSUM_DMA_STREAM, (uint32_t) &CRC_DR);
+	dma_set_memory_size(DMA2, CHECKSUM_DMA_STREAM, DMA_SxCR_MSIZE_32BIT);
+/* Memory to memory transfers go through the FIFO */
+	dma_enable_fifo_mode(DMA2, CHECKSUM_DMA_STREAM);
+	dma_set_fifo_threshold(DMA2, CHECKSUM_DMA_STREAM, DMA_SxFCR_FTH_4_4_FULL);
+	dma_set_number_of_data(DMA2, CHECKSUM_DMA_STREAM, words);
+	dma_enable_stream(DMA2, CHECKSUM_DMA_STREAM);
+#else
+	rcc_periph_clock_enable(RCC_DMA1);
+	dma_channel_reset(DMA1, CHECKSUM_DMA_CHANNEL);
+	dma_enable_mem2mem_mode(DMA1, CHECKSUM_DMA_CHANNEL);
+	dma_set_read_from_memory(DMA1, CHECKSUM_DMA_CHANNEL);
+	dma_set_priority(DMA1, CHECKSUM_DMA_CHANNEL, DMA_CCR_PL_LOW);
+	dma_set_memory_address(DMA1, CHECKSUM_DMA_CHANNEL, (uint32_t) dma_next);
+	dma_set_memory_size(DMA1, CHECKSUM_DMA_CHANNEL, DMA_CCR_MSIZE_32BIT);
+	dma_enable_memory_increment_mode(DMA1, CHECKSUM_DMA_CHANNEL);
+	dma_set_peripheral_address(DMA1, CHECKSUM_DMA_CHANNEL, (uint32_t) &CRC_DR);
+	dma_set_peripheral_size(DMA1, CHECKSUM_DMA_CHANNEL, DMA_CCR_PSIZE_32BIT);
+	dma_set_number_of_data(DMA1, CHECKSUM_DMA_CHANNEL, words);
+	dma_enable_channel(DMA1, CHECKSUM_DMA_CHANNEL);
+#endif
+	dma_next += 4*words;
+	dma_words -= words;
+}
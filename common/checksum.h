@@ -0,0 +1,52 @@
+/*	Checksum Service
+
+The CRC-32 of the STM32 CRC unit over blocks and streams, fed by the
+processor or, for large ranges, by memory to memory DMA, with table driven
+CRC-16 and CRC-8 for protocols whose polynomial the unit does not have.
+
+15 October 2026
+*/
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* DMA used to feed the CRC unit, overridden where another driver has it. The
+STM32F4 can only copy memory to memory on DMA2. */
+#ifdef STM32F4
+#ifndef CHECKSUM_DMA_STREAM
+#define CHECKSUM_DMA_STREAM     DMA_STREAM1
+#endif
+#else
+#ifndef CHECKSUM_DMA_CHANNEL
+#define CHECKSUM_DMA_CHANNEL    DMA_CHANNEL1
+#endif
+#endif
+
+/* CRC-32 value before any data, and the initial value of CRC-16 and CRC-8 */
+#define CHECKSUM_CRC32_INIT     0xFFFFFFFF
+#define CHECKSUM_CRC16_INIT     0xFFFF
+#define CHECKSUM_CRC8_INIT      0x00
+
+/* A CRC-32 in progress. The data is taken as little endian words, and a part
+word left at the end is filled with 0xFF. */
+typedef struct {
+	uint32_t crc;               /* over the whole words so far */
+	uint32_t carry;             /* bytes of a part word */
+	uint8_t carry_length;
+} checksum_crc32_t;
+
+void checksum_crc32_start(checksum_crc32_t *state);
+void checksum_crc32_update(checksum_crc32_t *state, const void *data,
+                           uint32_t length);
+uint32_t checksum_crc32_finish(checksum_crc32_t *state);
+uint32_t checksum_crc32(const void *data, uint32_t length);
+bool checksum_crc32_dma_start(checksum_crc32_t *state, const void *data,
+                              uint32_t length);
+bool checksum_crc32_dma_done(void);
+uint16_t checksum_crc16(uint16_t crc, const uint8_t *data, uint32_t length);
+uint8_t checksum_crc8(uint8_t crc, const uint8_t *data, uint32_t length);
+
+#endif
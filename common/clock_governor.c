@@ -0,0 +1,272 @@
+/*	Clock Governor for the STM32L1
+
+The STM32L1 trades its core voltage against its clock: voltage range 1 (1.8V)
+allows 32MHz, range 2 (1.5V) 16MHz and range 3 (1.2V) only 4.2MHz, and the
+current drawn falls with both. Here the system clock is chosen at run time
+from five levels, from the MSI at 65kHz to the PLL at 32MHz, each with the
+lowest voltage range and flash wait states that allow it.
+
+Parts of the program request the levels they need with
+clock_governor_request and give them up with clock_governor_release. The
+requests are counted for each level, and the clock is set to the highest level
+requested, or to the idle level given to clock_governor_init when there are
+none. So a burst of work requests the 32MHz level, finishes quickly and
+releases it, and the processor then idles at the 65kHz MSI.
+
+Going faster, the voltage range is raised and the regulator waited for, then
+the wait states set, and only then the clock switched. Going slower the order
+is reversed. The flash is given 64 bit access with prefetch when a wait state
+is needed. The AHB and APB prescalers are left at one, so all the bus clocks
+equal the system clock. Oscillators no longer used are turned off.
+
+After each change rcc_ahb_frequency and the APB frequencies are set and the
+notifiers are called in turn, to set the USART baud rates and timer prescalers
+again for the new clock. Output in progress on a USART should be finished
+before a change. Requests and releases are made from the main program only,
+not from interrupts. Range 1 needs a supply of at least 2.0V.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/pwr.h>
+#include <libopencm3/stm32/rcc.h>
+#include "clock_governor.h"
+
+typedef enum {
+	SOURCE_MSI,
+	SOURCE_HSI,
+	SOURCE_PLL,
+} source_t;
+
+typedef struct {
+	uint32_t hz;
+	source_t source;
+	uint8_t msi_range;
+	enum pwr_vos_scale voltage;
+	bool wait_state;
+} level_t;
+
+static const level_t levels[CLOCK_LEVELS] = {
+	{   65536, SOURCE_MSI, RCC_ICSCR_MSIRANGE_65KHZ, PWR_SCALE3, false},
+	{ 1048000, SOURCE_MSI, RCC_ICSCR_MSIRANGE_1MHZ,  PWR_SCALE3, false},
+	{ 4194000, SOURCE_MSI, RCC_ICSCR_MSIRANGE_4MHZ,  PWR_SCALE3, true},
+	{16000000, SOURCE_HSI, 0,                        PWR_SCALE2, true},
+	{32000000, SOURCE_PLL, 0,                        PWR_SCALE1, true},
+};
+
+/* Outstanding requests for each level */
+static uint8_t requests[CLOCK_LEVELS];
+
+static clock_level_t idle_level;
+static clock_level_t level;
+static clock_notifier_t *notifiers;
+
+static void update(void);
+static void set_level(clock_level_t next);
+static void set_voltage(enum pwr_vos_scale voltage);
+static void set_wait_state(bool wait_state);
+static void set_source(const level_t *next);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the Governor
+
+The clock is set to the idle level, from whatever clock is in use.
+
+@param[in] idle: level when none is requested.
+*/
+
+void clock_governor_init(clock_level_t idle)
+{
+	uint8_t i;
+	for (i = 0; i < CLOCK_LEVELS; i++) requests[i] = 0;
+	notifiers = 0;
+	idle_level = idle;
+	rcc_periph_clock_enable(RCC_PWR);
+	set_level(idle);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Add a Notifier
+
+The callback is called after each change of clock.
+
+@param[in] notifier: notifier, which must remain in existence.
+@param[in] callback: function given the notifier.
+@param[in] context: for the callback.
+*/
+
+void clock_governor_notify(clock_notifier_t *notifier,
+                           clock_notifier_callback_t callback, void *context)
+{
+	notifier->callback = callback;
+	notifier->context = context;
+	notifier->next = notifiers;
+	notifiers = notifier;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Request a Level
+
+The clock is raised to the level if it is below it, and kept there or above
+until the request is released.
+
+@param[in] wanted: level needed.
+*/
+
+void clock_governor_request(clock_level_t wanted)
+{
+	if (requests[wanted] < 255) requests[wanted]++;
+	update();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Release a Level
+
+The clock falls to the highest level still requested, or to the idle level.
+
+@param[in] wanted: level given in the request.
+*/
+
+void clock_governor_release(clock_level_t wanted)
+{
+	if (requests[wanted] > 0) requests[wanted]--;
+	update();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Present Level
+
+@returns the level the clock is at.
+*/
+
+clock_level_t clock_governor_level(void)
+{
+	return level;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Move to the highest level requested. */
+
+static void update(void)
+{
+	clock_level_t next = idle_level;
+	int8_t i;
+	for (i = CLOCK_LEVELS - 1; i >= 0; i--)
+	{
+		if (requests[i] > 0)
+		{
+			next = (clock_level_t) i;
+			break;
+		}
+	}
+	if (next != level) set_level(next);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Change the clock, voltage and wait states in the safe order, then tell the
+notifiers. The present clock is known from rcc_ahb_frequency. */
+
+static void set_level(clock_level_t next)
+{
+	const level_t *to = &levels[next];
+	bool faster = (to->hz > rcc_ahb_frequency);
+	clock_notifier_t *notifier;
+
+	if (faster)
+	{
+		set_voltage(to->voltage);
+		set_wait_state(to->wait_state);
+	}
+	set_source(to);
+	if (! faster)
+	{
+		set_wait_state(to->wait_state);
+		set_voltage(to->voltage);
+	}
+	rcc_ahb_frequency = to->hz;
+	rcc_apb1_frequency = to->hz;
+	rcc_apb2_frequency = to->hz;
+	level = next;
+	for (notifier = notifiers; notifier != 0; notifier = notifier->next)
+		notifier->callback(notifier);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Set the voltage range, waiting for the regulator to be ready before and
+after. */
+
+static void set_voltage(enum pwr_vos_scale voltage)
+{
+	while (PWR_CSR & PWR_CSR_VOSF);
+	pwr_set_vos_scale(voltage);
+	while (PWR_CSR & PWR_CSR_VOSF);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Set one wait state with 64 bit access and prefetch, or none without. The
+64 bit access must be on before the wait state is set and off only after it
+is cleared. */
+
+static void set_wait_state(bool wait_state)
+{
+	if (wait_state)
+	{
+		flash_64bit_enable();
+		flash_prefetch_enable();
+		flash_set_ws(FLASH_ACR_LATENCY_1WS);
+	}
+	else
+	{
+		flash_set_ws(FLASH_ACR_LATENCY_0WS);
+		flash_prefetch_disable();
+		flash_64bit_disable();
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/* Start the oscillator of a level, switch the system clock to it and stop
+the others. The PLL is only set up while it is stopped. */
+
+static void set_source(const level_t *next)
+{
+	switch (next->source)
+	{
+	case SOURCE_MSI:
+		rcc_osc_on(RCC_MSI);
+		rcc_wait_for_osc_ready(RCC_MSI);
+		rcc_set_msi_range(next->msi_range);
+		rcc_set_sysclk_source(RCC_CFGR_SW_SYSCLKSEL_MSICLK);
+		rcc_wait_for_sysclk_status(RCC_MSI);
+		rcc_osc_off(RCC_PLL);
+		rcc_osc_off(RCC_HSI);
+		break;
+	case SOURCE_HSI:
+		rcc_osc_on(RCC_HSI);
+		rcc_wait_for_osc_ready(RCC_HSI);
+		rcc_set_sysclk_source(RCC_CFGR_SW_SYSCLKSEL_HSICLK);
+		rcc_wait_for_sysclk_status(RCC_HSI);
+		rcc_osc_off(RCC_PLL);
+		rcc_osc_off(RCC_MSI);
+		break;
+	case SOURCE_PLL:
+		rcc_osc_on(RCC_HSI);
+		rcc_wait_for_osc_ready(RCC_HSI);
+/* Off the PLL while it is set up, in case it was already in use */
+		rcc_set_sysclk_source(RCC_CFGR_SW_SYSCLKSEL_HSICLK);
+		rcc_wait_for_sysclk_status(RCC_HSI);
+		rcc_osc_off(RCC_PLL);
+/* 16MHz HSI times 6 divided by 3 */
+		rcc_set_pll_source(RCC_CFGR_PLLSRC_HSI_CLK);
+		rcc_set_pll_multiplier(RCC_CFGR_PLLMUL_MUL6);
+		rcc_set_pll_divider(RCC_CFGR_PLLDIV_DIV3);
+		rcc_osc_on(RCC_PLL);
+		rcc_wait_for_osc_ready(RCC_PLL);
+		rcc_set_sysclk_source(RCC_CFGR_SW_SYSCLKSEL_PLLCLK);
+		rcc_wait_for_sysclk_status(RCC_PLL);
+		rcc_osc_off(RCC_MSI);
+		break;
+	}
+}
@@ -0,0 +1,43 @@
+/*	Clock Governor for the STM32L1
+
+Run time selection of the system clock and core voltage range of the STM32L1
+from the performance levels requested, with callbacks to set up peripherals
+again at each change.
+
+15 October 2026
+*/
+
+#ifndef CLOCK_GOVERNOR_H
+#define CLOCK_GOVERNOR_H
+
+#include <stdint.h>
+
+/* Levels from slowest to fastest. */
+typedef enum {
+	CLOCK_LEVEL_65KHZ,          /* MSI range 0, voltage range 3 */
+	CLOCK_LEVEL_1MHZ,           /* MSI range 4, voltage range 3 */
+	CLOCK_LEVEL_4MHZ,           /* MSI range 6, voltage range 3 */
+	CLOCK_LEVEL_16MHZ,          /* HSI, voltage range 2 */
+	CLOCK_LEVEL_32MHZ,          /* PLL from the HSI, voltage range 1 */
+	CLOCK_LEVELS
+} clock_level_t;
+
+struct clock_notifier;
+typedef void (*clock_notifier_callback_t)(struct clock_notifier *notifier);
+
+/* Called after each change with rcc_ahb_frequency, rcc_apb1_frequency and
+rcc_apb2_frequency set for the new clock. */
+typedef struct clock_notifier {
+	struct clock_notifier *next;
+	clock_notifier_callback_t callback;
+	void *context;                  /* for the callback */
+} clock_notifier_t;
+
+void clock_governor_init(clock_level_t idle);
+void clock_governor_notify(clock_notifier_t *notifier,
+                           clock_notifier_callback_t callback, void *context);
+void clock_governor_request(clock_level_t level);
+void clock_governor_release(clock_level_t level);
+clock_level_t clock_governor_level(void);
+
+#endif
@@ -0,0 +1,159 @@
+/*	Direct Digital Synthesis
+
+Each channel has a 32 bit phase accumulator, stepped once per sample by an
+increment of 2^32 times the frequency over the sample rate, so the frequency
+resolution is the sample rate over 2^32 and needs no table of any particular
+length. The top 8 bits of the phase, with the phase offset added, index a
+sine table of 257 entries, 514 bytes in flash, and the next 16 bits
+interpolate linearly to the following entry. The interpolation error is at
+most (2pi/256)^2/8, about 7.5e-5 of the peak, near a sixth of the least
+significant bit of a 12 bit DAC.
+
+The frequency, phase and amplitude are single words read afresh for each
+sample, so they may be changed at any time from outside the interrupt that
+fills the samples. A change of frequency keeps the accumulator running, so the
+output carries on with no jump in phase.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include "dds.h"
+
+/* One cycle of sine in Q15 with the first entry repeated at the end, so that
+interpolation never wraps */
+static const int16_t sine_table[257] =
+{
+	     0,    804,   1608,   2410,   3212,   4011,   4808,   5602,
+	  6393,   7179,   7962,   8739,   9512,  10278,  11039,  11793,
+	 12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,
+	 18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,
+	 23170,  23731,  24279,  24811,  25329,  25832,  26319,  26790,
+	 27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+	 30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,
+	 32137,  32285,  32412,  32521,  32609,  32678,  32728,  32757,
+	 32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,
+	 32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,
+	 30273,  29956,  29621,  29268,  28898,  28510,  28105,  27683,
+	 27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+	 23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,
+	 18204,  17530,  16846,  16151,  15446,  14732,  14010,  13279,
+	 12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,
+	  6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,
+	     0,   -804,  -1608,  -2410,  -3212,  -4011,  -4808,  -5602,
+	 -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+	-12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530,
+	-18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+	-23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+	-27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+	-30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971,
+	-32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+	-32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285,
+	-32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+	-30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+	-27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+	-23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868,
+	-18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+	-12539, -11793, -11039, -10278,  -9512,  -8739,  -7962,  -7179,
+	 -6393,  -5602,  -4808,  -4011,  -3212,  -2410,  -1608,   -804,
+	     0
+};
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set up a Channel
+
+The channel starts at zero frequency, phase and full amplitude.
+
+@param[in] channel: channel to set up.
+*/
+
+void dds_init(dds_channel_t *channel)
+{
+	memset(channel, 0, sizeof(dds_channel_t));
+	channel->amplitude = DDS_FULL_SCALE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the Frequency
+
+The phase carries on from its current value, so the change is glitch free.
+
+@param[in] channel: channel to change.
+@param[in] frequency: in Hz, up to half the sample rate.
+@param[in] sample_rate: samples per second.
+*/
+
+void dds_set_frequency(dds_channel_t *channel, uint32_t frequency,
+		       uint32_t sample_rate)
+{
+	channel->increment = ((uint64_t) frequency << 32) / sample_rate;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the Phase Offset
+
+@param[in] channel: channel to change.
+@param[in] phase: offset added to the accumulator, 65536 to a cycle.
+*/
+
+void dds_set_phase(dds_channel_t *channel, uint16_t phase)
+{
+	channel->offset = (uint32_t) phase << 16;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the Amplitude
+
+@param[in] channel: channel to change.
+@param[in] amplitude: Q15, up to DDS_FULL_SCALE.
+*/
+
+void dds_set_amplitude(dds_channel_t *channel, uint16_t amplitude)
+{
+	if (amplitude > DDS_FULL_SCALE) amplitude = DDS_FULL_SCALE;
+	channel->amplitude = amplitude;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Next Sample of a Channel
+
+@param[in] channel: channel to step.
+@returns 12 bit sample about mid scale.
+*/
+
+uint16_t dds_next(dds_channel_t *channel)
+{
+	uint32_t phase = channel->phase + channel->offset;
+	uint32_t index = phase >> 24;
+	int32_t fraction = (phase >> 8) & 0xFFFF;
+	int32_t low = sine_table[index];
+	int32_t value = low + (((sine_table[index + 1] - low)*fraction) >> 16);
+	channel->phase += channel->increment;
+/* Q15 by Q15 to 11 bits, rounded, with the top of full scale kept in range */
+	value = (value*channel->amplitude + (1 << 18)) >> 19;
+	if (value > 2047) value = 2047;
+	return (uint16_t) (2048 + value);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Fill a Block of Dual Samples
+
+The words are as the 12 bit right aligned dual DAC register takes them, the
+first channel in bits 0-11 and the second in bits 16-27.
+
+@param[in] channel1: channel for the low half of each word.
+@param[in] channel2: channel for the high half of each word.
+@param[out] samples: count words.
+@param[in] count: number of samples.
+*/
+
+void dds_fill_dual(dds_channel_t *channel1, dds_channel_t *channel2,
+		   uint32_t *samples, uint32_t count)
+{
+	uint32_t n;
+	for (n = 0; n < count; n++)
+	{
+		samples[n] = dds_next(channel1) | ((uint32_t) dds_next(channel2) << 16);
+	}
+}
@@ -0,0 +1,33 @@
+/*	Direct Digital Synthesis
+
+Fixed point sine synthesis from a phase accumulator for each channel, with
+independent frequency, phase and amplitude, giving 12 bit DAC samples.
+
+14 October 2026
+*/
+
+#ifndef DDS_H
+#define DDS_H
+
+#include <stdint.h>
+
+/* Amplitude for a full scale output */
+#define DDS_FULL_SCALE      32768
+
+typedef struct {
+	uint32_t phase;                 /* accumulator, 2^32 to a cycle */
+	uint32_t increment;             /* phase step per sample */
+	uint32_t offset;                /* phase added to the accumulator */
+	uint16_t amplitude;             /* Q15, DDS_FULL_SCALE for full output */
+} dds_channel_t;
+
+void dds_init(dds_channel_t *channel);
+void dds_set_frequency(dds_channel_t *channel, uint32_t frequency,
+		       uint32_t sample_rate);
+void dds_set_phase(dds_channel_t *channel, uint16_t phase);
+void dds_set_amplitude(dds_channel_t *channel, uint16_t amplitude);
+uint16_t dds_next(dds_channel_t *channel);
+void dds_fill_dual(dds_channel_t *channel1, dds_channel_t *channel2,
+		   uint32_t *samples, uint32_t count);
+
+#endif
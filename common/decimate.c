@@ -0,0 +1,152 @@
+/*	Decimating Filter
+
+A fixed point CIC decimator followed by a compensating FIR that halves the rate
+again, for streams of 12 bit ADC samples. The output is one 16 bit sample for
+each 2*ratio inputs, the extra bits coming from the averaging.
+
+The CIC (cascaded integrator comb) filter has DECIMATE_CIC_ORDER integrators
+at the input rate and as many combs at the decimated rate, with no multiplies.
+Its gain is ratio^order, so the integrators hold 12 + 3*6 = 30 bits at the
+largest ratio of 64, and are left to wrap around in 32 bits, which the combs
+undo exactly. With the ratio a power of two the gain is taken out by a shift.
+
+The CIC response droops across the passband as sinc^3, which the FIR corrects.
+It is a 32 tap linear phase filter, designed by windowing the inverse sinc^3
+response cut off at a quarter of the CIC output rate, and it decimates by two.
+Together the passband is flat within 0.15dB up to 0.4 of the output rate, and
+aliases are down by 38dB from 0.6 and by 71dB from 0.7 of the output rate. The
+inverse sinc is the limit for large ratios, but at a ratio of 4 the passband
+is still within 0.1dB.
+
+The FIR works on 16 bit samples offset to be signed, and on the Cortex-M4 takes
+two taps at a time with the SMLAD instruction. Its inputs are held twice over
+in a history of twice the taps, so that the window of the last
+DECIMATE_FIR_TAPS samples is always contiguous, and it is only computed for
+every second CIC output, when the window is word aligned.
+
+The filter runs from RAM, placed by RAMFUNC of mem_regions.h, so that its
+loops do not wait on the flash, and on the STM32F4 the filter state is best
+given CCM_DATA to keep its accesses clear of the DMA.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "decimate.h"
+#include "mem_regions.h"
+
+/* Bits of the ADC samples */
+#define INPUT_BITS 12
+
+/* Compensating FIR in Q15, summing to 32768 for unity gain at DC */
+static const int16_t fir_coefficients[DECIMATE_FIR_TAPS]
+	__attribute__((aligned(4))) =
+{
+	   -9,   -26,    50,    95,  -144,  -239,   325,   508,
+	 -640,  -987,  1174,  1886, -2148, -4058,  4400, 16197,
+	16197,  4400, -4058, -2148,  1886,  1174,  -987,  -640,
+	  508,   325,  -239,  -144,    95,    50,   -26,    -9
+};
+
+static uint16_t fir(const decimate_t *filter) RAMFUNC;
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set up a Filter
+
+@param[in] filter: filter to set up.
+@param[in] ratio: CIC decimation ratio, a power of two from DECIMATE_RATIO_MIN
+to DECIMATE_RATIO_MAX. The output is at the input rate divided by twice this.
+@returns false if the ratio is not allowed.
+*/
+
+bool decimate_init(decimate_t *filter, uint8_t ratio)
+{
+	uint8_t bits = 0;
+	if ((ratio < DECIMATE_RATIO_MIN) || (ratio > DECIMATE_RATIO_MAX) ||
+	    ((ratio & (ratio - 1)) != 0)) return false;
+	while ((1 << bits) < ratio) bits++;
+	memset(filter, 0, sizeof(decimate_t));
+	filter->ratio = ratio;
+	filter->shift = DECIMATE_CIC_ORDER*bits + INPUT_BITS - 16;
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Filter a Block of Samples
+
+The state is kept between calls, so a stream may be passed in blocks of any
+length.
+
+@param[in] filter: filter to use.
+@param[in] input: 12 bit samples.
+@param[in] count: number of input samples.
+@param[out] output: 16 bit filtered samples, room for count/(2*ratio) + 1.
+@returns number of output samples written.
+*/
+
+RAMFUNC uint32_t decimate_process(decimate_t *filter, const uint16_t *input,
+				  uint32_t count, uint16_t *output)
+{
+	uint32_t written = 0;
+	uint32_t i;
+	uint8_t stage;
+	for (i = 0; i < count; i++)
+	{
+		uint32_t value = input[i];
+		for (stage = 0; stage < DECIMATE_CIC_ORDER; stage++)
+		{
+			filter->integrator[stage] += value;
+			value = filter->integrator[stage];
+		}
+		if (++filter->count < filter->ratio) continue;
+		filter->count = 0;
+		for (stage = 0; stage < DECIMATE_CIC_ORDER; stage++)
+		{
+			uint32_t previous = filter->comb[stage];
+			filter->comb[stage] = value;
+			value -= previous;
+		}
+/* Into the FIR history as a signed sample about mid scale */
+		int16_t sample = (int16_t) ((value >> filter->shift) - 32768);
+		filter->position++;
+		if (filter->position >= DECIMATE_FIR_TAPS) filter->position = 0;
+		filter->history[filter->position] = sample;
+		filter->history[filter->position + DECIMATE_FIR_TAPS] = sample;
+		if ((filter->position & 1) != 0) output[written++] = fir(filter);
+	}
+	return written;
+}
+
+/*--------------------------------------------------------------------------*/
+/* FIR over the window of the last DECIMATE_FIR_TAPS samples, which starts just
+after the newest in the history. The coefficients are symmetric so their order
+does not matter. The result is rounded and brought back to unsigned. */
+
+static uint16_t fir(const decimate_t *filter)
+{
+	const int16_t *window = &filter->history[filter->position + 1];
+	int32_t sum = 0;
+	uint8_t tap;
+#if defined(__ARM_FEATURE_DSP)
+	for (tap = 0; tap < DECIMATE_FIR_TAPS; tap += 2)
+	{
+		uint32_t samples;
+		uint32_t coefficients;
+		memcpy(&samples, &window[tap], sizeof(samples));
+		memcpy(&coefficients, &fir_coefficients[tap], sizeof(coefficients));
+		__asm__ ("smlad %0, %1, %2, %0"
+			 : "+r" (sum) : "r" (samples), "r" (coefficients));
+	}
+#else
+	for (tap = 0; tap < DECIMATE_FIR_TAPS; tap++)
+	{
+		sum += (int32_t) window[tap]*fir_coefficients[tap];
+	}
+#endif
+	sum = ((sum + 16384) >> 15) + 32768;
+	if (sum < 0) sum = 0;
+	if (sum > 0xFFFF) sum = 0xFFFF;
+	return (uint16_t) sum;
+}
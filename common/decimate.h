@@ -0,0 +1,38 @@
+/*	Decimating Filter
+
+A fixed point CIC decimator followed by a compensating FIR that halves the rate
+again, for streams of ADC samples.
+
+14 October 2026
+*/
+
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Stages of the CIC filter */
+#define DECIMATE_CIC_ORDER  3
+/* Taps of the compensating FIR, an even number */
+#define DECIMATE_FIR_TAPS   32
+/* Limits of the CIC decimation ratio, a power of two */
+#define DECIMATE_RATIO_MIN  4
+#define DECIMATE_RATIO_MAX  64
+
+typedef struct {
+	uint32_t integrator[DECIMATE_CIC_ORDER];
+	uint32_t comb[DECIMATE_CIC_ORDER];      /* previous comb inputs */
+	uint8_t ratio;
+	uint8_t shift;                  /* CIC output to 16 bits */
+	uint8_t count;                  /* inputs since the last CIC output */
+	uint8_t position;               /* of the newest FIR input */
+/* FIR inputs, held twice over so that the window is always contiguous */
+	int16_t history[2*DECIMATE_FIR_TAPS] __attribute__((aligned(4)));
+} decimate_t;
+
+bool decimate_init(decimate_t *filter, uint8_t ratio);
+uint32_t decimate_process(decimate_t *filter, const uint16_t *input,
+			  uint32_t count, uint16_t *output);
+
+#endif
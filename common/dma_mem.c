@@ -0,0 +1,382 @@
+/*	Memory to Memory DMA Service
+
+dma_memcpy and dma_memset queue a request and return at once. The requests
+are done in the order queued, each by one or more transfers of the channel,
+which can move up to 65535 items at a time, and the callback of each is
+called from the DMA interrupt when it is done. The items are words where the
+addresses and length allow, else halfwords or bytes. A fill repeats a word
+holding the value from a fixed source address.
+
+A request shorter than DMA_MEM_THRESHOLD is done by the processor, as are
+ranges the DMA cannot reach, the CCM of the STM32F4. If nothing is queued
+before it this is done before the call returns, with the callback, otherwise
+in the interrupt when it is reached so that the order is kept.
+
+The channel runs at low priority so that peripheral DMA, which has deadlines,
+wins each arbitration, and the transfer takes the bus only between their
+items. The STM32F1 uses DMA1 channel 7 unless DMA_MEM_CHANNEL is set, and the
+STM32F4 DMA2 stream 2 unless DMA_MEM_STREAM is set, as only DMA2 can copy
+memory to memory. A channel that serial.c or spi_dma.c takes in the same
+build is refused at compile time.
+
+A transfer error, from an address out of reach, ends the request part done,
+and its callback is told.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+#include "irq_priority.h"
+#include "dma_mem.h"
+
+/* Names of the handler and IRQ of a channel or stream, from its number */
+#define MEM_PASTE(a, n, b)      a##n##b
+#define MEM_NAME(a, n, b)       MEM_PASTE(a, n, b)
+
+#ifdef STM32F4
+#define MEM_DMA                 DMA2
+#define MEM_STREAM              DMA_MEM_STREAM
+#define MEM_IRQ                 MEM_NAME(NVIC_DMA2_STREAM, DMA_MEM_STREAM, _IRQ)
+#define MEM_ISR                 MEM_NAME(dma2_stream, DMA_MEM_STREAM, _isr)
+#else
+#define MEM_DMA                 DMA1
+#define MEM_CHANNEL             DMA_MEM_CHANNEL
+#define MEM_IRQ                 MEM_NAME(NVIC_DMA1_CHANNEL, DMA_MEM_CHANNEL, _IRQ)
+#define MEM_ISR                 MEM_NAME(dma1_channel, DMA_MEM_CHANNEL, _isr)
+/* Channels whose handlers serial.c and spi_dma.c define */
+#if (DMA_MEM_CHANNEL == DMA_CHANNEL4) || (DMA_MEM_CHANNEL == DMA_CHANNEL5)
+#error "DMA_MEM_CHANNEL is taken by USART1 in serial.c"
+#endif
+#if defined(SERIAL_USART2) && \
+    ((DMA_MEM_CHANNEL == DMA_CHANNEL6) || (DMA_MEM_CHANNEL == DMA_CHANNEL7))
+#error "DMA_MEM_CHANNEL is taken by USART2 in serial.c"
+#endif
+#if defined(SERIAL_USART3) && \
+    ((DMA_MEM_CHANNEL == DMA_CHANNEL2) || (DMA_MEM_CHANNEL == DMA_CHANNEL3))
+#error "DMA_MEM_CHANNEL is taken by USART3 in serial.c"
+#endif
+#if defined(SPI_BUS1) && (DMA_MEM_CHANNEL == DMA_CHANNEL2)
+#error "DMA_MEM_CHANNEL is taken by SPI1 in spi_dma.c"
+#endif
+#endif
+
+/* Most items of one transfer */
+#define MAX_ITEMS               65535
+
+/* A request. The addresses and length move on as each transfer is started. A
+fill has no source. */
+typedef struct {
+	uint8_t *destination;
+	const uint8_t *source;
+	uint32_t length;
+	uint32_t fill;
+	dma_mem_callback_t callback;
+	void *context;
+} dma_mem_request_t;
+
+static dma_mem_request_t queue[DMA_MEM_QUEUE];
+static volatile uint8_t queue_head;
+static volatile uint8_t queue_tail;
+/* Set while the requests are being worked through */
+static volatile bool running;
+/* Source of the fill in progress */
+static uint32_t fill_word;
+
+/* Sizes of bytes, halfwords and words */
+#ifdef STM32F4
+static const uint32_t peripheral_size[3] =
+	{ DMA_SxCR_PSIZE_8BIT, DMA_SxCR_PSIZE_16BIT, DMA_SxCR_PSIZE_32BIT };
+static const uint32_t memory_size[3] =
+	{ DMA_SxCR_MSIZE_8BIT, DMA_SxCR_MSIZE_16BIT, DMA_SxCR_MSIZE_32BIT };
+#else
+static const uint32_t peripheral_size[3] =
+	{ DMA_CCR_PSIZE_8BIT, DMA_CCR_PSIZE_16BIT, DMA_CCR_PSIZE_32BIT };
+static const uint32_t memory_size[3] =
+	{ DMA_CCR_MSIZE_8BIT, DMA_CCR_MSIZE_16BIT, DMA_CCR_MSIZE_32BIT };
+#endif
+
+static bool queue_request(uint8_t *destination, const uint8_t *source,
+                          uint32_t length, uint32_t fill,
+                          dma_mem_callback_t callback, void *context);
+static void run_queue(void);
+static bool by_processor(const dma_mem_request_t *request);
+static bool dma_reachable(const uint8_t *address, uint32_t length);
+static void finish(bool error);
+static void transfer(dma_mem_request_t *request);
+static void transfer_done(bool error);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set up the Service
+
+The DMA clock is enabled and the interrupt given the DMA level of the
+priority plan.
+*/
+
+void dma_mem_init(void)
+{
+	queue_head = 0;
+	queue_tail = 0;
+	running = false;
+#ifdef STM32F4
+	rcc_periph_clock_enable(RCC_DMA2);
+#else
+	rcc_periph_clock_enable(RCC_DMA1);
+#endif
+	IRQ_PRIORITY_SET(MEM_IRQ, IRQ_LEVEL_DMA);
+	nvic_enable_irq(MEM_IRQ);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Queue a Copy
+
+The ranges must not overlap, and must be left alone until the callback.
+
+@param[in] destination: start of the range copied to.
+@param[in] source: start of the range copied from.
+@param[in] length: number of bytes.
+@param[in] callback: called when the copy is done, or 0.
+@param[in] context: passed to the callback.
+@returns false if the queue is full, with nothing done.
+*/
+
+bool dma_memcpy(void *destination, const void *source, uint32_t length,
+                dma_mem_callback_t callback, void *context)
+{
+	return queue_request(destination, source, length, 0, callback, context);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Queue a Fill
+
+@param[in] destination: start of the range filled.
+@param[in] value: byte written to each place.
+@param[in] length: number of bytes.
+@param[in] callback: called when the fill is done, or 0.
+@param[in] context: passed to the callback.
+@returns false if the queue is full, with nothing done.
+*/
+
+bool dma_memset(void *destination, uint8_t value, uint32_t length,
+                dma_mem_callback_t callback, void *context)
+{
+	return queue_request(destination, 0, length, value*0x01010101UL,
+	                     callback, context);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check for No Requests
+
+@returns true if every request queued is done.
+*/
+
+bool dma_mem_idle(void)
+{
+	return ! running;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Add a request to the queue, and start on it if the queue was idle. */
+
+static bool queue_request(uint8_t *destination, const uint8_t *source,
+                          uint32_t length, uint32_t fill,
+                          dma_mem_callback_t callback, void *context)
+{
+	bool masked = cm_mask_interrupts(true);
+	uint8_t next = (queue_tail + 1) % DMA_MEM_QUEUE;
+	if (next == queue_head)
+	{
+		cm_mask_interrupts(masked);
+		return false;
+	}
+	dma_mem_request_t *request = &queue[queue_tail];
+	request->destination = destination;
+	request->source = source;
+	request->length = length;
+	request->fill = fill;
+	request->callback = callback;
+	request->context = context;
+	queue_tail = next;
+	bool start = ! running;
+	running = true;
+	cm_mask_interrupts(masked);
+	if (start) run_queue();
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Work through the queue from its head, doing the requests for the processor
+until one is started on the DMA. running stays set meanwhile, so that a
+request queued by a callback is taken here rather than started again. */
+
+static void run_queue(void)
+{
+	while (true)
+	{
+		bool masked = cm_mask_interrupts(true);
+		if (queue_head == queue_tail)
+		{
+			running = false;
+			cm_mask_interrupts(masked);
+			return;
+		}
+		cm_mask_interrupts(masked);
+		dma_mem_request_t *request = &queue[queue_head];
+		if (! by_processor(request))
+		{
+			transfer(request);
+			return;
+		}
+		if (request->source != 0)
+			memcpy(request->destination, request->source, request->length);
+		else memset(request->destination, request->fill, request->length);
+		finish(false);
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/* Check whether a request is too short for the DMA or out of its reach. */
+
+static bool by_processor(const dma_mem_request_t *request)
+{
+	if (request->length < DMA_MEM_THRESHOLD) return true;
+	if (! dma_reachable(request->destination, request->length)) return true;
+	return (request->source != 0) &&
+	       ! dma_reachable(request->source, request->length);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Check that the DMA can reach a range. On the STM32F4 it cannot reach the
+CCM. */
+
+static bool dma_reachable(const uint8_t *address, uint32_t length)
+{
+#ifdef STM32F4
+	uint32_t start = (uint32_t) address;
+	return (start + length <= 0x10000000) || (start >= 0x10010000);
+#else
+	(void) address;
+	(void) length;
+	return true;
+#endif
+}
+
+/*--------------------------------------------------------------------------*/
+/* Take the request at the head off the queue and call back. The slot is freed
+first, so that the callback may queue another. */
+
+static void finish(bool error)
+{
+	dma_mem_request_t *request = &queue[queue_head];
+	dma_mem_callback_t callback = request->callback;
+	void *context = request->context;
+	queue_head = (queue_head + 1) % DMA_MEM_QUEUE;
+	if (callback != 0) callback(context, error);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Start a transfer of the next part of a request, in the widest items that
+the addresses and length allow. On the STM32F4 the source of a memory to
+memory transfer is the peripheral port, and on the STM32F1 the memory port. */
+
+static void transfer(dma_mem_request_t *request)
+{
+	uint32_t source;
+	uint32_t alignment = (uint32_t) request->destination | request->length;
+	if (request->source != 0)
+	{
+		source = (uint32_t) request->source;
+		alignment |= source;
+	}
+	else
+	{
+		fill_word = request->fill;
+		source = (uint32_t) &fill_word;
+	}
+	uint8_t shift = (alignment & 1) ? 0 : ((alignment & 2) ? 1 : 2);
+	uint32_t items = request->length >> shift;
+	if (items > MAX_ITEMS) items = MAX_ITEMS;
+#ifdef STM32F4
+	dma_stream_reset(MEM_DMA, MEM_STREAM);
+	dma_set_transfer_mode(MEM_DMA, MEM_STREAM, DMA_SxCR_DIR_MEM_TO_MEM);
+	dma_set_priority(MEM_DMA, MEM_STREAM, DMA_SxCR_PL_LOW);
+	dma_set_peripheral_address(MEM_DMA, MEM_STREAM, source);
+	dma_set_peripheral_size(MEM_DMA, MEM_STREAM, peripheral_size[shift]);
+	if (request->source != 0)
+		dma_enable_peripheral_increment_mode(MEM_DMA, MEM_STREAM);
+	dma_set_memory_address(MEM_DMA, MEM_STREAM,
+	                       (uint32_t) request->destination);
+	dma_set_memory_size(MEM_DMA, MEM_STREAM, memory_size[shift]);
+	dma_enable_memory_increment_mode(MEM_DMA, MEM_STREAM);
+/* Memory to memory transfers go through the FIFO */
+	dma_enable_fifo_mode(MEM_DMA, MEM_STREAM);
+	dma_set_fifo_threshold(MEM_DMA, MEM_STREAM, DMA_SxFCR_FTH_4_4_FULL);
+	dma_set_number_of_data(MEM_DMA, MEM_STREAM, items);
+	dma_enable_transfer_complete_interrupt(MEM_DMA, MEM_STREAM);
+	dma_enable_transfer_error_interrupt(MEM_DMA, MEM_STREAM);
+	dma_enable_stream(MEM_DMA, MEM_STREAM);
+#else
+	dma_channel_reset(MEM_DMA, MEM_CHANNEL);
+	dma_enable_mem2mem_mode(MEM_DMA, MEM_CHANNEL);
+	dma_set_read_from_memory(MEM_DMA, MEM_CHANNEL);
+	dma_set_priority(MEM_DMA, MEM_CHANNEL, DMA_CCR_PL_LOW);
+	dma_set_memory_address(MEM_DMA, MEM_CHANNEL, source);
+	dma_set_memory_size(MEM_DMA, MEM_CHANNEL, memory_size[shift]);
+	if (request->source != 0)
+		dma_enable_memory_increment_mode(MEM_DMA, MEM_CHANNEL);
+	dma_set_peripheral_address(MEM_DMA, MEM_CHANNEL,
+	                           (uint32_t) request->destination);
+	dma_set_peripheral_size(MEM_DMA, MEM_CHANNEL, peripheral_size[shift]);
+	dma_enable_peripheral_increment_mode(MEM_DMA, MEM_CHANNEL);
+	dma_set_number_of_data(MEM_DMA, MEM_CHANNEL, items);
+	dma_enable_transfer_complete_interrupt(MEM_DMA, MEM_CHANNEL);
+	dma_enable_transfer_error_interrupt(MEM_DMA, MEM_CHANNEL);
+	dma_enable_channel(MEM_DMA, MEM_CHANNEL);
+#endif
+	uint32_t bytes = items << shift;
+	request->destination += bytes;
+	if (request->source != 0) request->source += bytes;
+	request->length -= bytes;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief DMA Interrupt
+
+At the end of each transfer the next part of the request is started, or the
+request is finished and the queue worked on. A transfer error ends the request
+as it is.
+*/
+
+void MEM_ISR(void)
+{
+#ifdef STM32F4
+	bool error = dma_get_interrupt_flag(MEM_DMA, MEM_STREAM, DMA_TEIF);
+	dma_clear_interrupt_flags(MEM_DMA, MEM_STREAM, DMA_TCIF | DMA_TEIF);
+	dma_disable_stream(MEM_DMA, MEM_STREAM);
+#else
+	bool error = dma_get_interrupt_flag(MEM_DMA, MEM_CHANNEL, DMA_TEIF);
+	dma_clear_interrupt_flags(MEM_DMA, MEM_CHANNEL, DMA_TCIF | DMA_TEIF);
+	dma_disable_channel(MEM_DMA, MEM_CHANNEL);
+#endif
+	transfer_done(error);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Go on with the request at the head, or finish it and work on the queue. */
+
+static void transfer_done(bool error)
+{
+	dma_mem_request_t *request = &queue[queue_head];
+	if ((request->length > 0) && ! error)
+	{
+		transfer(request);
+		return;
+	}
+	finish(error);
+	run_queue();
+}
@@ -0,0 +1,52 @@
+/*	Memory to Memory DMA Service
+
+Copies and fills of memory queued to a DMA channel kept for them, each calling
+back when done, so that bulk moves go on while the processor works. Small
+requests are done by the processor.
+
+15 October 2026
+*/
+
+#ifndef DMA_MEM_H
+#define DMA_MEM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* DMA kept for the service, overridden where another driver has it. The
+STM32F4 can only copy memory to memory on DMA2, and the STM32F1 uses DMA1. The
+interrupt handler of the channel or stream is defined by dma_mem.c. */
+#ifdef STM32F4
+#ifndef DMA_MEM_STREAM
+#define DMA_MEM_STREAM          DMA_STREAM2
+#endif
+#else
+#ifndef DMA_MEM_CHANNEL
+#define DMA_MEM_CHANNEL         DMA_CHANNEL7
+#endif
+#endif
+
+/* Requests waiting or in progress */
+#ifndef DMA_MEM_QUEUE
+#define DMA_MEM_QUEUE           8
+#endif
+
+/* Requests shorter than this many bytes are done by the processor, about the
+length it copies in the time taken to set up a transfer and take its
+interrupt. */
+#ifndef DMA_MEM_THRESHOLD
+#define DMA_MEM_THRESHOLD       64
+#endif
+
+/* Called when a request is done, from the DMA interrupt or from the call
+that queued it. error is set if a DMA transfer error ended it part done. */
+typedef void (*dma_mem_callback_t)(void *context, bool error);
+
+void dma_mem_init(void);
+bool dma_memcpy(void *destination, const void *source, uint32_t length,
+                dma_mem_callback_t callback, void *context);
+bool dma_memset(void *destination, uint8_t value, uint32_t length,
+                dma_mem_callback_t callback, void *context);
+bool dma_mem_idle(void);
+
+#endif
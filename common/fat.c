@@ -0,0 +1,896 @@
+/*	FAT Filesystem
+
+Files in the root directory of a FAT16 or FAT32 volume on an SD card, through
+sd_spi.c, for data logging. Names are 8.3 and there are no subdirectories,
+seeks or deletion.
+
+The volume is found by fat_mount either at sector 0 or in the first partition
+of a master boot record. FAT12 volumes are not taken.
+
+All access to the FAT and the directory, and to the parts of data sectors that
+a read or write only partly covers, goes through a cache of FAT_CACHE_SECTORS
+word aligned sectors. A sector changed in the cache is written back only when
+it is evicted or at fat_sync, so the FAT sector and directory entry of a
+growing file are written once per sync rather than once per data sector. A FAT
+sector written back is copied to each FAT of the volume. The least recently
+used sector is evicted.
+
+Whole sectors of a read or write go directly between the card and the caller's
+buffer. A run of whole sectors over clusters that follow each other on the card
+is moved with a single multiple block command, CMD18 or CMD25, so a write of a
+whole number of clusters to a contiguous file runs close to the card's raw
+rate. New clusters are taken from the first free cluster after the last one
+taken, so a file written alone is itself mostly contiguous.
+
+fat_expand gives an empty log file a contiguous chain of clusters before it is
+written. Writes then follow the chain without allocating, and the FAT is not
+written at all until something else changes it. The size in the directory
+follows the data written, and the clusters past it remain with the file.
+
+There is no clock, so files carry a fixed date. The FSInfo free cluster count
+of a FAT32 volume is marked unknown at the first allocation.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sd_spi.h"
+#include "fat.h"
+
+#define SECTOR_SIZE     SD_BLOCK_SIZE
+#define DIR_ENTRY_SIZE  32
+#define DIR_ENTRIES     (SECTOR_SIZE/DIR_ENTRY_SIZE)
+
+/* Values returned for FAT entries: free, an error reading the FAT, and the end
+of a chain for both FAT16 and FAT32 */
+#define CLUSTER_FREE    0
+#define CLUSTER_ERROR   1
+#define CLUSTER_END     0x0FFFFFFF
+
+/* Directory entry fields */
+#define DIR_NAME        0
+#define DIR_ATTRIBUTES  11
+#define DIR_CLUSTER_HI  20
+#define DIR_TIME        22
+#define DIR_DATE        24
+#define DIR_CLUSTER_LO  26
+#define DIR_SIZE        28
+#define ATTR_READ_ONLY  0x01
+#define ATTR_VOLUME     0x08
+#define ATTR_DIRECTORY  0x10
+#define ATTR_ARCHIVE    0x20
+#define ENTRY_FREE      0xE5
+#define ENTRY_END       0x00
+
+/* Date and time of new and written files: 14 October 2026, 12:00 */
+#define FILE_DATE       (((2026 - 1980) << 9) | (10 << 5) | 14)
+#define FILE_TIME       (12 << 11)
+
+typedef struct {
+	bool mounted;
+	bool fat32;
+	bool fsinfo_marked;
+	uint8_t sectors_per_cluster;
+	uint8_t fats;
+	uint32_t fat_start;
+	uint32_t fat_sectors;           /* in each FAT */
+	uint32_t root_start;            /* FAT16 root directory */
+	uint32_t root_sectors;
+	uint32_t root_cluster;          /* FAT32 root directory */
+	uint32_t fsinfo_sector;
+	uint32_t data_start;
+	uint32_t clusters;              /* numbered from 2 */
+	uint32_t next_free;             /* where the search for a free one starts */
+} fat_volume_t;
+
+static fat_volume_t volume;
+
+static uint32_t cache_data[FAT_CACHE_SECTORS][SECTOR_SIZE/4];
+static uint32_t cache_sector[FAT_CACHE_SECTORS];
+static uint32_t cache_used[FAT_CACHE_SECTORS];
+static bool cache_valid[FAT_CACHE_SECTORS];
+static bool cache_dirty[FAT_CACHE_SECTORS];
+static uint32_t cache_time;
+
+static uint8_t *cache_get(uint32_t sector, bool fill);
+static void cache_mark(uint32_t sector);
+static bool cache_write(uint8_t i);
+static bool cache_flush(void);
+static bool cache_discard(uint32_t sector, uint32_t count);
+static uint32_t fat_get(uint32_t cluster);
+static bool fat_set(uint32_t cluster, uint32_t value);
+static uint8_t cluster_allocate(uint32_t previous, uint32_t count,
+				uint32_t *first);
+static uint8_t cluster_follow(uint32_t cluster, bool allocate, uint32_t *next);
+static uint8_t file_advance(fat_file_t *file, bool allocate);
+static uint8_t file_run(fat_file_t *file, uint32_t sectors, bool allocate,
+			uint32_t *run);
+static uint32_t cluster_lba(uint32_t cluster);
+static uint32_t dir_lba(uint32_t index, bool extend);
+static bool make_name(const char *name, uint8_t *entry_name);
+static uint16_t load16(const uint8_t *p);
+static uint32_t load32(const uint8_t *p);
+static void store16(uint8_t *p, uint16_t value);
+static void store32(uint8_t *p, uint32_t value);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Mount the Volume
+
+The card must have been initialised with sd_init. Any previous mount is lost
+without writing back its cache.
+
+@returns FAT_OK, or FAT_DISK_ERROR or FAT_NO_FILESYSTEM.
+*/
+
+uint8_t fat_mount(void)
+{
+	uint32_t start = 0;
+	uint32_t total, fat_size, reserved, root_entries;
+	uint8_t *boot;
+	uint8_t i;
+
+	volume.mounted = false;
+	for (i = 0; i < FAT_CACHE_SECTORS; i++) cache_valid[i] = false;
+	boot = cache_get(0, true);
+	if (boot == 0) return FAT_DISK_ERROR;
+	if (load16(boot + 510) != 0xAA55) return FAT_NO_FILESYSTEM;
+/* A boot record starts with a jump, otherwise take the first partition */
+	if ((boot[0] != 0xEB) && (boot[0] != 0xE9))
+	{
+		start = load32(boot + 454);
+		boot = cache_get(start, true);
+		if (boot == 0) return FAT_DISK_ERROR;
+		if (load16(boot + 510) != 0xAA55) return FAT_NO_FILESYSTEM;
+	}
+	if ((load16(boot + 11) != SECTOR_SIZE) || (boot[13] == 0) ||
+		(boot[16] == 0)) return FAT_NO_FILESYSTEM;
+	volume.sectors_per_cluster = boot[13];
+	volume.fats = boot[16];
+	reserved = load16(boot + 14);
+	root_entries = load16(boot + 17);
+	total = load16(boot + 19);
+	if (total == 0) total = load32(boot + 32);
+	fat_size = load16(boot + 22);
+	if (fat_size == 0) fat_size = load32(boot + 36);
+	volume.fat_start = start + reserved;
+	volume.fat_sectors = fat_size;
+	volume.root_start = volume.fat_start + volume.fats * fat_size;
+	volume.root_sectors = (root_entries * DIR_ENTRY_SIZE + SECTOR_SIZE - 1) /
+			      SECTOR_SIZE;
+	volume.data_start = volume.root_start + volume.root_sectors;
+	volume.clusters = (total - (volume.data_start - start)) /
+			  volume.sectors_per_cluster;
+	if (volume.clusters < 4085) return FAT_NO_FILESYSTEM;
+	volume.fat32 = (volume.clusters >= 65525);
+	if (volume.fat32)
+	{
+		volume.root_cluster = load32(boot + 44);
+		volume.fsinfo_sector = start + load16(boot + 48);
+	}
+	volume.fsinfo_marked = ! volume.fat32;
+	volume.next_free = 2;
+	volume.mounted = true;
+	return FAT_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Bytes in a Cluster of the Mounted Volume
+
+Writes of a multiple of this from a cluster boundary go to the card in single
+multiple block commands where the clusters are contiguous.
+
+@returns cluster size, 0 if not mounted.
+*/
+
+uint32_t fat_cluster_size(void)
+{
+	if (! volume.mounted) return 0;
+	return volume.sectors_per_cluster * SECTOR_SIZE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Open a File
+
+@param[out] file: file to open.
+@param[in] name: 8.3 name of a file in the root directory.
+@param[in] mode: FAT_READ and/or FAT_WRITE, with FAT_CREATE to create a missing
+file and FAT_APPEND to start at the end.
+@returns FAT_OK or the error.
+*/
+
+uint8_t fat_open(fat_file_t *file, const char *name, uint8_t mode)
+{
+	uint8_t entry_name[11];
+	uint32_t free_sector = 0;
+	uint8_t free_entry = 0;
+	uint32_t index;
+	uint32_t sector;
+	uint8_t *data;
+	uint8_t *entry = 0;
+	uint8_t i;
+
+	if (! volume.mounted) return FAT_NOT_READY;
+	if (! make_name(name, entry_name)) return FAT_INVALID_NAME;
+	if ((mode & (FAT_READ | FAT_WRITE)) == 0) return FAT_DENIED;
+/* Search the root directory, noting the first free entry */
+	for (index = 0; entry == 0; index++)
+	{
+		sector = dir_lba(index, false);
+		if (sector == 0) break;
+		data = cache_get(sector, true);
+		if (data == 0) return FAT_DISK_ERROR;
+		for (i = 0; i < DIR_ENTRIES; i++)
+		{
+			uint8_t *e = data + i * DIR_ENTRY_SIZE;
+			if ((e[DIR_NAME] == ENTRY_END) || (e[DIR_NAME] == ENTRY_FREE))
+			{
+				if (free_sector == 0)
+				{
+					free_sector = sector;
+					free_entry = i;
+				}
+				if (e[DIR_NAME] == ENTRY_END) break;
+			}
+			else if (((e[DIR_ATTRIBUTES] & (ATTR_VOLUME | ATTR_DIRECTORY)) == 0)
+				&& (memcmp(e + DIR_NAME, entry_name, 11) == 0))
+			{
+				entry = e;
+				file->dir_sector = sector;
+				file->dir_entry = i;
+				break;
+			}
+		}
+		if ((entry == 0) && (i < DIR_ENTRIES)) break;
+	}
+	if (entry != 0)
+	{
+		if ((mode & FAT_WRITE) && (entry[DIR_ATTRIBUTES] & ATTR_READ_ONLY))
+			return FAT_DENIED;
+		file->first_cluster = load16(entry + DIR_CLUSTER_LO);
+		if (volume.fat32)
+			file->first_cluster |= (uint32_t) load16(entry + DIR_CLUSTER_HI) << 16;
+		file->size = load32(entry + DIR_SIZE);
+		file->dirty = false;
+	}
+	else
+	{
+		if ((mode & FAT_CREATE) == 0) return FAT_NOT_FOUND;
+		if ((mode & FAT_WRITE) == 0) return FAT_DENIED;
+/* A full FAT32 root directory is given another cluster */
+		if (free_sector == 0)
+		{
+			free_sector = dir_lba(index, true);
+			free_entry = 0;
+			if (free_sector == 0) return FAT_FULL;
+		}
+		data = cache_get(free_sector, true);
+		if (data == 0) return FAT_DISK_ERROR;
+		entry = data + free_entry * DIR_ENTRY_SIZE;
+		memset(entry, 0, DIR_ENTRY_SIZE);
+		memcpy(entry + DIR_NAME, entry_name, 11);
+		entry[DIR_ATTRIBUTES] = ATTR_ARCHIVE;
+		store16(entry + DIR_TIME, FILE_TIME);
+		store16(entry + DIR_DATE, FILE_DATE);
+		cache_mark(free_sector);
+		file->dir_sector = free_sector;
+		file->dir_entry = free_entry;
+		file->first_cluster = 0;
+		file->size = 0;
+		file->dirty = true;
+	}
+	file->mode = mode;
+	file->position = 0;
+	file->cluster = 0;
+/* Find the cluster holding the last byte */
+	if ((mode & FAT_APPEND) && (file->size > 0))
+	{
+		uint32_t clusters = (file->size - 1) / fat_cluster_size();
+		uint32_t cluster = file->first_cluster;
+		while (clusters-- > 0)
+		{
+			uint8_t result = cluster_follow(cluster, false, &cluster);
+			if (result != FAT_OK) return result;
+			if (cluster == 0) return FAT_NO_FILESYSTEM;
+		}
+		file->cluster = cluster;
+		file->position = file->size;
+	}
+	return FAT_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Read from a File
+
+@param[in] file: file open for reading.
+@param[out] data: buffer for the data.
+@param[in] length: number of bytes wanted.
+@param[out] done: number of bytes read, fewer than wanted at the end of the
+file.
+@returns FAT_OK or the error.
+*/
+
+uint8_t fat_read(fat_file_t *file, void *data, uint32_t length,
+		 uint32_t *done)
+{
+	uint8_t *out = data;
+	uint32_t cluster_size = fat_cluster_size();
+	uint8_t result = FAT_OK;
+
+	*done = 0;
+	if (! volume.mounted) return FAT_NOT_READY;
+	if ((file->mode & FAT_READ) == 0) return FAT_DENIED;
+	if (length > file->size - file->position)
+		length = file->size - file->position;
+	while (length > 0)
+	{
+		uint32_t offset = file->position % SECTOR_SIZE;
+		uint32_t n;
+		if ((file->position % cluster_size) == 0)
+		{
+			result = file_advance(file, false);
+			if (result != FAT_OK) break;
+		}
+		uint32_t sector = cluster_lba(file->cluster) +
+				  (file->position % cluster_size) / SECTOR_SIZE;
+		if ((offset == 0) && (length >= SECTOR_SIZE))
+		{
+			result = file_run(file, length / SECTOR_SIZE, false, &n);
+			if (result != FAT_OK) break;
+/* Sectors changed in the cache are written first so the card is current */
+			if (! cache_discard(sector, n) ||
+				(sd_read(sector, out, n) != SD_OK))
+			{
+				result = FAT_DISK_ERROR;
+				break;
+			}
+			n *= SECTOR_SIZE;
+		}
+		else
+		{
+			uint8_t *cached = cache_get(sector, true);
+			if (cached == 0)
+			{
+				result = FAT_DISK_ERROR;
+				break;
+			}
+			n = SECTOR_SIZE - offset;
+			if (n > length) n = length;
+			memcpy(out, cached + offset, n);
+		}
+		out += n;
+		file->position += n;
+		*done += n;
+		length -= n;
+	}
+	return result;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write to a File
+
+Writing whole clusters from a cluster boundary, in a file extended with
+fat_expand, goes to the card at its full rate. The directory entry and FAT are
+brought up to date on the card by fat_sync or fat_close.
+
+@param[in] file: file open for writing.
+@param[in] data: data to write.
+@param[in] length: number of bytes.
+@param[out] done: number of bytes written, fewer than given if the volume is
+full or on an error.
+@returns FAT_OK or the error.
+*/
+
+uint8_t fat_write(fat_file_t *file, const void *data, uint32_t length,
+		  uint32_t *done)
+{
+	const uint8_t *in = data;
+	uint32_t cluster_size = fat_cluster_size();
+	uint8_t result = FAT_OK;
+
+	*done = 0;
+	if (! volume.mounted) return FAT_NOT_READY;
+	if ((file->mode & FAT_WRITE) == 0) return FAT_DENIED;
+	while (length > 0)
+	{
+		uint32_t offset = file->position % SECTOR_SIZE;
+		uint32_t n;
+		if ((file->position % cluster_size) == 0)
+		{
+			result = file_advance(file, true);
+			if (result != FAT_OK) break;
+		}
+		uint32_t sector = cluster_lba(file->cluster) +
+				  (file->position % cluster_size) / SECTOR_SIZE;
+		if ((offset == 0) && (length >= SECTOR_SIZE))
+		{
+			result = file_run(file, length / SECTOR_SIZE, true, &n);
+			if (result != FAT_OK) break;
+			if (! cache_discard(sector, n) ||
+				(sd_write(sector, in, n) != SD_OK))
+			{
+				result = FAT_DISK_ERROR;
+				break;
+			}
+			n *= SECTOR_SIZE;
+		}
+		else
+		{
+/* A sector starting at or past the end holds nothing to keep */
+			uint8_t *cached = cache_get(sector,
+				(offset != 0) || (file->position < file->size));
+			if (cached == 0)
+			{
+				result = FAT_DISK_ERROR;
+				break;
+			}
+			n = SECTOR_SIZE - offset;
+			if (n > length) n = length;
+			memcpy(cached + offset, in, n);
+			cache_mark(sector);
+		}
+		in += n;
+		file->position += n;
+		*done += n;
+		length -= n;
+		if (file->position > file->size)
+		{
+			file->size = file->position;
+			file->dirty = true;
+		}
+	}
+	return result;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Give an Empty File a Contiguous Chain
+
+Clusters enough for size bytes are allocated at one place on the card, so that
+later writes neither allocate nor break their multiple block transfers at
+cluster boundaries. The size of the file is unchanged.
+
+@param[in] file: empty file open for writing.
+@param[in] size: number of bytes to allow for.
+@returns FAT_OK, FAT_DENIED if the file has clusters already, FAT_FULL if no
+run of free clusters is long enough, or FAT_DISK_ERROR.
+*/
+
+uint8_t fat_expand(fat_file_t *file, uint32_t size)
+{
+	uint32_t cluster_size = fat_cluster_size();
+	uint32_t first;
+	uint8_t result;
+
+	if (! volume.mounted) return FAT_NOT_READY;
+	if (((file->mode & FAT_WRITE) == 0) || (file->first_cluster != 0))
+		return FAT_DENIED;
+	if (size == 0) return FAT_OK;
+	result = cluster_allocate(0, (size + cluster_size - 1) / cluster_size,
+				  &first);
+	if (result != FAT_OK) return result;
+	file->first_cluster = first;
+	file->dirty = true;
+	return FAT_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Bring a File up to Date on the Card
+
+The directory entry is updated and every changed sector in the cache is
+written back.
+
+@param[in] file: open file.
+@returns FAT_OK or FAT_DISK_ERROR.
+*/
+
+uint8_t fat_sync(fat_file_t *file)
+{
+	if (! volume.mounted) return FAT_NOT_READY;
+	if (file->dirty)
+	{
+		uint8_t *data = cache_get(file->dir_sector, true);
+		if (data == 0) return FAT_DISK_ERROR;
+		uint8_t *entry = data + file->dir_entry * DIR_ENTRY_SIZE;
+		store16(entry + DIR_CLUSTER_LO, file->first_cluster);
+		if (volume.fat32)
+			store16(entry + DIR_CLUSTER_HI, file->first_cluster >> 16);
+		store32(entry + DIR_SIZE, file->size);
+		store16(entry + DIR_TIME, FILE_TIME);
+		store16(entry + DIR_DATE, FILE_DATE);
+		entry[DIR_ATTRIBUTES] |= ATTR_ARCHIVE;
+		cache_mark(file->dir_sector);
+		file->dirty = false;
+	}
+	return cache_flush() ? FAT_OK : FAT_DISK_ERROR;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Close a File
+
+@param[in] file: open file.
+@returns FAT_OK or FAT_DISK_ERROR.
+*/
+
+uint8_t fat_close(fat_file_t *file)
+{
+	uint8_t result = FAT_OK;
+	if (file->mode & FAT_WRITE) result = fat_sync(file);
+	file->mode = 0;
+	return result;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Move to the next cluster of the file at a cluster boundary of the
+position, allocating one when writing past the end of the chain. */
+
+static uint8_t file_advance(fat_file_t *file, bool allocate)
+{
+	uint32_t next;
+	uint8_t result;
+
+	if (file->position == 0)
+	{
+		if ((file->first_cluster == 0) && allocate)
+		{
+			result = cluster_allocate(0, 1, &file->first_cluster);
+			if (result != FAT_OK) return result;
+			file->dirty = true;
+		}
+		next = file->first_cluster;
+	}
+	else
+	{
+		result = cluster_follow(file->cluster, allocate, &next);
+		if (result != FAT_OK) return result;
+	}
+	if (next == 0) return allocate ? FAT_FULL : FAT_NO_FILESYSTEM;
+	file->cluster = next;
+	return FAT_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Count the sectors from the position, up to the number given, that are
+contiguous on the card. The run goes on into following clusters while they
+are next to each other, and the file is left at the last cluster of the run.
+Called at a sector boundary with the cluster of the position current. */
+
+static uint8_t file_run(fat_file_t *file, uint32_t sectors, bool allocate,
+			uint32_t *run)
+{
+	uint32_t spc = volume.sectors_per_cluster;
+	uint32_t count = spc - (file->position / SECTOR_SIZE) % spc;
+	uint32_t next;
+	uint8_t result;
+
+	while (count < sectors)
+	{
+		result = cluster_follow(file->cluster, allocate, &next);
+		if (result != FAT_OK) return result;
+		if (next != file->cluster + 1) break;
+		file->cluster = next;
+		count += spc;
+	}
+	if (count > sectors) count = sectors;
+	*run = count;
+	return FAT_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Find the cluster after one in its chain. At the end of the chain, 0 is
+given, or a new cluster is linked on if allocating. */
+
+static uint8_t cluster_follow(uint32_t cluster, bool allocate, uint32_t *next)
+{
+	uint32_t value = fat_get(cluster);
+	if (value == CLUSTER_ERROR) return FAT_DISK_ERROR;
+	if ((value >= 2) && (value < volume.clusters + 2))
+	{
+		*next = value;
+		return FAT_OK;
+	}
+	*next = 0;
+	if (! allocate) return FAT_OK;
+	return cluster_allocate(cluster, 1, next);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Allocate a run of count free clusters next to each other, chained in order
+and ended, and link the run to a previous cluster if one is given. */
+
+static uint8_t cluster_allocate(uint32_t previous, uint32_t count,
+				uint32_t *first)
+{
+	uint32_t cluster = volume.next_free;
+	uint32_t start = 0;
+	uint32_t run = 0;
+	uint32_t n;
+
+	for (n = 0; (n < volume.clusters) && (run < count); n++, cluster++)
+	{
+		if (cluster >= volume.clusters + 2)
+		{
+			cluster = 2;
+			run = 0;
+		}
+		uint32_t value = fat_get(cluster);
+		if (value == CLUSTER_ERROR) return FAT_DISK_ERROR;
+		if (value == CLUSTER_FREE)
+		{
+			if (run == 0) start = cluster;
+			run++;
+		}
+		else run = 0;
+	}
+	if (run < count) return FAT_FULL;
+	for (n = 0; n < count; n++)
+	{
+		if (! fat_set(start + n, (n + 1 < count) ? start + n + 1 : CLUSTER_END))
+			return FAT_DISK_ERROR;
+	}
+	if ((previous != 0) && ! fat_set(previous, start)) return FAT_DISK_ERROR;
+	volume.next_free = start + count;
+/* The FSInfo free count no longer holds */
+	if (! volume.fsinfo_marked)
+	{
+		uint8_t *fsinfo = cache_get(volume.fsinfo_sector, true);
+		if (fsinfo == 0) return FAT_DISK_ERROR;
+		if (load32(fsinfo) == 0x41615252)
+		{
+			store32(fsinfo + 488, 0xFFFFFFFF);
+			cache_mark(volume.fsinfo_sector);
+		}
+		volume.fsinfo_marked = true;
+	}
+	*first = start;
+	return FAT_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Read the FAT entry of a cluster, with the end of chain markers of both FAT
+types given as CLUSTER_END. */
+
+static uint32_t fat_get(uint32_t cluster)
+{
+	uint32_t value;
+	uint8_t *data;
+
+	if (volume.fat32)
+	{
+		data = cache_get(volume.fat_start + cluster / (SECTOR_SIZE/4), true);
+		if (data == 0) return CLUSTER_ERROR;
+		value = load32(data + (cluster % (SECTOR_SIZE/4)) * 4) & 0x0FFFFFFF;
+		if (value >= 0x0FFFFFF8) value = CLUSTER_END;
+	}
+	else
+	{
+		data = cache_get(volume.fat_start + cluster / (SECTOR_SIZE/2), true);
+		if (data == 0) return CLUSTER_ERROR;
+		value = load16(data + (cluster % (SECTOR_SIZE/2)) * 2);
+		if (value >= 0xFFF8) value = CLUSTER_END;
+	}
+	return value;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Set the FAT entry of a cluster in the cache. The reserved top bits of a
+FAT32 entry are kept. */
+
+static bool fat_set(uint32_t cluster, uint32_t value)
+{
+	uint32_t sector;
+	uint8_t *data;
+
+	if (volume.fat32)
+	{
+		sector = volume.fat_start + cluster / (SECTOR_SIZE/4);
+		data = cache_get(sector, true);
+		if (data == 0) return false;
+		data += (cluster % (SECTOR_SIZE/4)) * 4;
+		store32(data, (load32(data) & 0xF0000000) | (value & 0x0FFFFFFF));
+	}
+	else
+	{
+		sector = volume.fat_start + cluster / (SECTOR_SIZE/2);
+		data = cache_get(sector, true);
+		if (data == 0) return false;
+		store16(data + (cluster % (SECTOR_SIZE/2)) * 2, value);
+	}
+	cache_mark(sector);
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* First sector of a cluster. */
+
+static uint32_t cluster_lba(uint32_t cluster)
+{
+	return volume.data_start + (cluster - 2) * volume.sectors_per_cluster;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Sector of the root directory at an index, 0 past its end. A FAT32 root
+directory may be extended by a cleared cluster. */
+
+static uint32_t dir_lba(uint32_t index, bool extend)
+{
+	uint32_t spc = volume.sectors_per_cluster;
+	uint32_t cluster = volume.root_cluster;
+	uint32_t clusters = index / spc;
+	uint32_t next;
+	uint32_t i;
+
+	if (! volume.fat32)
+		return (index < volume.root_sectors) ? volume.root_start + index : 0;
+	while (clusters-- > 0)
+	{
+		if (cluster_follow(cluster, false, &next) != FAT_OK) return 0;
+		if ((next == 0) && extend)
+		{
+			if (cluster_allocate(cluster, 1, &next) != FAT_OK) return 0;
+			for (i = 0; i < spc; i++)
+			{
+				uint8_t *data = cache_get(cluster_lba(next) + i, false);
+				if (data == 0) return 0;
+				memset(data, 0, SECTOR_SIZE);
+				cache_mark(cluster_lba(next) + i);
+			}
+		}
+		if (next == 0) return 0;
+		cluster = next;
+	}
+	return cluster_lba(cluster) + index % spc;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Form the 11 character directory name, upper case and space padded, from an
+8.3 name. */
+
+static bool make_name(const char *name, uint8_t *entry_name)
+{
+	uint8_t i = 0;
+	uint8_t limit = 8;
+
+	memset(entry_name, ' ', 11);
+	if ((*name == 0) || (*name == '.')) return false;
+	for (; *name != 0; name++)
+	{
+		char c = *name;
+		if (c == '.')
+		{
+			if (limit == 11) return false;
+			i = 8;
+			limit = 11;
+			continue;
+		}
+		if ((i >= limit) || (c <= ' ') || (c == '/') || (c == '\\'))
+			return false;
+		if ((c >= 'a') && (c <= 'z')) c -= 'a' - 'A';
+		entry_name[i++] = c;
+	}
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Find a sector in the cache, or take the least recently used slot for it,
+writing back its old sector if changed. The sector is read from the card when
+fill is set, otherwise its contents are left to the caller. */
+
+static uint8_t *cache_get(uint32_t sector, bool fill)
+{
+	uint8_t oldest = 0;
+	uint8_t i;
+
+	for (i = 0; i < FAT_CACHE_SECTORS; i++)
+	{
+		if (cache_valid[i] && (cache_sector[i] == sector))
+		{
+			cache_used[i] = ++cache_time;
+			return (uint8_t *) cache_data[i];
+		}
+		if (! cache_valid[i]) cache_used[i] = 0;
+		if (cache_used[i] < cache_used[oldest]) oldest = i;
+	}
+	if (cache_valid[oldest] && cache_dirty[oldest] && ! cache_write(oldest))
+		return 0;
+	cache_valid[oldest] = false;
+	if (fill && (sd_read(sector, (uint8_t *) cache_data[oldest], 1) != SD_OK))
+		return 0;
+	cache_sector[oldest] = sector;
+	cache_valid[oldest] = true;
+	cache_dirty[oldest] = false;
+	cache_used[oldest] = ++cache_time;
+	return (uint8_t *) cache_data[oldest];
+}
+
+/*--------------------------------------------------------------------------*/
+/* Mark a sector in the cache as changed. */
+
+static void cache_mark(uint32_t sector)
+{
+	uint8_t i;
+	for (i = 0; i < FAT_CACHE_SECTORS; i++)
+		if (cache_valid[i] && (cache_sector[i] == sector)) cache_dirty[i] = true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Write back a changed sector, to every FAT if it is a FAT sector. */
+
+static bool cache_write(uint8_t i)
+{
+	uint32_t sector = cache_sector[i];
+	uint8_t n;
+
+	if (sd_write(sector, (uint8_t *) cache_data[i], 1) != SD_OK) return false;
+	if ((sector >= volume.fat_start) &&
+		(sector < volume.fat_start + volume.fat_sectors))
+	{
+		for (n = 1; n < volume.fats; n++)
+		{
+			sector += volume.fat_sectors;
+			if (sd_write(sector, (uint8_t *) cache_data[i], 1) != SD_OK)
+				return false;
+		}
+	}
+	cache_dirty[i] = false;
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Write back all changed sectors. */
+
+static bool cache_flush(void)
+{
+	uint8_t i;
+	for (i = 0; i < FAT_CACHE_SECTORS; i++)
+		if (cache_valid[i] && cache_dirty[i] && ! cache_write(i)) return false;
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Before a direct transfer of a run of sectors, write back any of them that
+are changed in the cache and drop them, so that the cache and card agree. A
+sector that can not be written back is kept, and false returned. */
+
+static bool cache_discard(uint32_t sector, uint32_t count)
+{
+	uint8_t i;
+	for (i = 0; i < FAT_CACHE_SECTORS; i++)
+	{
+		if (cache_valid[i] && (cache_sector[i] >= sector) &&
+			(cache_sector[i] < sector + count))
+		{
+			if (cache_dirty[i] && ! cache_write(i)) return false;
+			cache_valid[i] = false;
+		}
+	}
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Little endian fields at any alignment */
+
+static uint16_t load16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t load32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | ((uint32_t) p[2] << 16) |
+		((uint32_t) p[3] << 24);
+}
+
+static void store16(uint8_t *p, uint16_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+}
+
+static void store32(uint8_t *p, uint32_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+	p[3] = value >> 24;
+}
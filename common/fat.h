@@ -0,0 +1,59 @@
+/*	FAT Filesystem
+
+FAT16 and FAT32 files in the root directory of an SD card on sd_spi.c, with a
+write-back sector cache and contiguous multiple block transfers.
+
+14 October 2026
+*/
+
+#ifndef FAT_H
+#define FAT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Sectors held in the cache. One each for the FAT, the directory and the
+partial data sectors of a file keeps them from evicting each other. */
+#ifndef FAT_CACHE_SECTORS
+#define FAT_CACHE_SECTORS   3
+#endif
+
+/* Results of the filesystem operations */
+#define FAT_OK              0
+#define FAT_DISK_ERROR      1       /* the card failed a transfer */
+#define FAT_NOT_READY       2       /* not mounted */
+#define FAT_NO_FILESYSTEM   3       /* no FAT16 or FAT32 volume found */
+#define FAT_INVALID_NAME    4
+#define FAT_NOT_FOUND       5
+#define FAT_DENIED          6       /* read only file, or wrong mode */
+#define FAT_FULL            7       /* no free cluster or directory entry */
+
+/* Open modes */
+#define FAT_READ            0x01
+#define FAT_WRITE           0x02
+#define FAT_CREATE          0x04    /* create the file if it does not exist */
+#define FAT_APPEND          0x08    /* start at the end of the file */
+
+typedef struct {
+	uint32_t first_cluster;         /* 0 while the file has no clusters */
+	uint32_t size;
+	uint32_t position;
+	uint32_t cluster;               /* holding the byte before position */
+	uint32_t dir_sector;            /* directory entry of the file */
+	uint8_t dir_entry;
+	uint8_t mode;
+	bool dirty;                     /* entry to be updated */
+} fat_file_t;
+
+uint8_t fat_mount(void);
+uint8_t fat_open(fat_file_t *file, const char *name, uint8_t mode);
+uint8_t fat_read(fat_file_t *file, void *data, uint32_t length,
+		 uint32_t *done);
+uint8_t fat_write(fat_file_t *file, const void *data, uint32_t length,
+		  uint32_t *done);
+uint8_t fat_expand(fat_file_t *file, uint32_t size);
+uint8_t fat_sync(fat_file_t *file);
+uint8_t fat_close(fat_file_t *file);
+uint32_t fat_cluster_size(void);
+
+#endif
@@ -0,0 +1,171 @@
+/*	Bulk Flash Programming
+
+The flash of the STM32F1 is programmed a halfword at a time, each taking about
+50us. Locking the controller, reading the whole status and reading back each
+halfword between them, as a simple loop does, adds to that and fails if the
+lock is taken before the next write. Here the controller is unlocked once and
+PG set once for a block, the halfwords are written back to back polling only
+BSY, and the error flags, which stay set once raised, are read at the end. The
+block is then verified by comparing the CRC of the flash with that of the
+source, worked out by the CRC unit through the checksum service.
+
+While the flash is busy any read of it stalls the processor, so the code and
+interrupts run from flash are held up for each halfword. Build with FLASH_RAM
+to put the programming loop in RAM, so that interrupts with their handlers in
+RAM go on being served while the flash is busy.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/desig.h>
+#include "checksum.h"
+#include "flash_write.h"
+
+/* Functions placed in a .data section are copied to RAM at start up */
+#ifdef FLASH_RAM
+#define RAM_FUNCTION __attribute__((section(".data.ramfunc"), noinline, \
+				    long_call))
+#else
+#define RAM_FUNCTION
+#endif
+
+static uint8_t check_range(uint32_t address, uint32_t length);
+static uint8_t status_result(uint32_t status);
+static uint32_t program_block(uint32_t address, const uint8_t *data,
+			      uint32_t length) RAM_FUNCTION;
+
+/*--------------------------------------------------------------------------*/
+/** @brief Erase Pages
+
+All pages holding any of the block are erased and checked.
+
+@param[in] address: start of the block.
+@param[in] length: length of the block in bytes.
+@returns FLASH_WRITE_OK, FLASH_WRITE_INVALID, FLASH_WRITE_PROTECTED or
+FLASH_WRITE_VERIFY.
+*/
+
+uint8_t flash_write_erase(uint32_t address, uint32_t length)
+{
+	uint8_t result = check_range(address, length);
+	if ((result != FLASH_WRITE_OK) || (length == 0)) return result;
+	uint32_t page = address & ~(FLASH_WRITE_PAGE_SIZE - 1);
+	uint32_t end = address + length;
+	flash_unlock();
+	flash_clear_status_flags();
+	for (; (result == FLASH_WRITE_OK) && (page < end);
+	     page += FLASH_WRITE_PAGE_SIZE)
+	{
+		flash_erase_page(page);
+		result = status_result(FLASH_SR);
+		const uint32_t *word = (const uint32_t *) page;
+		uint32_t i;
+		for (i = 0; (result == FLASH_WRITE_OK) &&
+			    (i < FLASH_WRITE_PAGE_SIZE/4); i++)
+			if (word[i] != 0xFFFFFFFF) result = FLASH_WRITE_VERIFY;
+	}
+	flash_lock();
+	return result;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Program a Block
+
+The block must have been erased. An odd last byte is programmed with 0xFF in
+the upper byte of its halfword.
+
+@param[in] address: start of the block, on a halfword.
+@param[in] data: data to program, which may be in RAM or flash.
+@param[in] length: length of the block in bytes.
+@returns FLASH_WRITE_OK, FLASH_WRITE_INVALID, FLASH_WRITE_PROTECTED,
+FLASH_WRITE_NOT_ERASED or FLASH_WRITE_VERIFY.
+*/
+
+uint8_t flash_write(uint32_t address, const void *data, uint32_t length)
+{
+	uint8_t result = check_range(address, length);
+	if ((result != FLASH_WRITE_OK) || (length == 0)) return result;
+	flash_unlock();
+	flash_clear_status_flags();
+	result = status_result(program_block(address, data, length));
+	flash_lock();
+	if ((result == FLASH_WRITE_OK) &&
+	    (flash_write_crc((const void *) address, length) !=
+	     flash_write_crc(data, length)))
+		result = FLASH_WRITE_VERIFY;
+	return result;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief CRC of a Block
+
+The CRC-32 of the CRC unit over the block taken as little endian words, with
+a part word at the end filled with 0xFF, as checksum_crc32. Any alignment
+of the block is allowed.
+
+@param[in] data: start of the block.
+@param[in] length: length of the block in bytes.
+@returns the CRC.
+*/
+
+uint32_t flash_write_crc(const void *data, uint32_t length)
+{
+	return checksum_crc32(data, length);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Check that a block is on a halfword and within the flash, whose size in K
+is given in the device signature. */
+
+static uint8_t check_range(uint32_t address, uint32_t length)
+{
+	uint32_t size = (uint32_t) DESIG_FLASH_SIZE << 10;
+	if ((address & 1) || (address < FLASH_BASE) ||
+	    (address - FLASH_BASE > size) ||
+	    (length > size - (address - FLASH_BASE)))
+		return FLASH_WRITE_INVALID;
+	return FLASH_WRITE_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Result from the error flags of the status register. */
+
+static uint8_t status_result(uint32_t status)
+{
+	if (status & FLASH_SR_WRPRTERR) return FLASH_WRITE_PROTECTED;
+	if (status & FLASH_SR_PGERR) return FLASH_WRITE_NOT_ERASED;
+	return FLASH_WRITE_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Program the halfwords back to back with PG held set, waiting only on BSY.
+The data is taken a byte at a time as it may not be aligned. The error flags
+are left to the end, and the status is returned. */
+
+static uint32_t program_block(uint32_t address, const uint8_t *data,
+			      uint32_t length)
+{
+	volatile uint16_t *destination = (volatile uint16_t *) address;
+	FLASH_CR |= FLASH_CR_PG;
+	while (length > 0)
+	{
+		uint16_t halfword = data[0];
+		if (length > 1)
+		{
+			halfword |= (uint16_t) data[1] << 8;
+			length -= 2;
+		}
+		else
+		{
+			halfword |= 0xFF00;
+			length = 0;
+		}
+		data += 2;
+		*destination++ = halfword;
+		while (FLASH_SR & FLASH_SR_BSY);
+	}
+	FLASH_CR &= ~FLASH_CR_PG;
+	return FLASH_SR;
+}
@@ -0,0 +1,32 @@
+/*	Bulk Flash Programming
+
+Erase and programming of blocks of the on-chip flash of the STM32F1 with the
+controller unlocked once for each operation and the whole block verified at
+the end by the CRC unit.
+
+14 October 2026
+*/
+
+#ifndef FLASH_WRITE_H
+#define FLASH_WRITE_H
+
+#include <stdint.h>
+
+/* Page size, 1K for the low and medium density devices and 2K for the high
+density and connectivity lines */
+#ifndef FLASH_WRITE_PAGE_SIZE
+#define FLASH_WRITE_PAGE_SIZE   1024
+#endif
+
+/* Results of the flash operations */
+#define FLASH_WRITE_OK          0
+#define FLASH_WRITE_INVALID     1   /* odd address, or outside the flash */
+#define FLASH_WRITE_PROTECTED   2   /* page write protected */
+#define FLASH_WRITE_NOT_ERASED  3   /* programming over data not erased */
+#define FLASH_WRITE_VERIFY      4   /* data read back differs */
+
+uint8_t flash_write_erase(uint32_t address, uint32_t length);
+uint8_t flash_write(uint32_t address, const void *data, uint32_t length);
+uint32_t flash_write_crc(const void *data, uint32_t length);
+
+#endif
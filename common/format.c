@@ -0,0 +1,306 @@
+/*	Formatted Output
+
+A small printf subset that writes directly into the circular buffers.
+
+The conversions supported are %d, %u, %x, %X, %c and %s, with an optional
+field width and the flags '0' (pad numbers with zero) and '-' (left justify).
+%% gives a percent sign.
+
+Output goes straight into the free space of a byte or ring buffer through the
+reserve/commit span functions, so there is no intermediate copy and nothing is
+allocated. The data is committed at the end of the message, or also at the end
+of the buffer data region where the message wraps around. Anything that does
+not fit is dropped. Kicking off transmission is left to the caller, so that it
+is done once per message.
+
+Numbers are converted without division, as the quotient by ten is found by
+multiplying by a reciprocal and shifting, which is exact for all 32 bit
+values.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include "format.h"
+
+/* Output destination: one of buffer, ring or string is set */
+typedef struct
+{
+	uint8_t *buffer;
+	ring_buffer_t *ring;
+	char *string;
+	uint8_t *span;			/* Next free byte */
+	uint32_t room;			/* Bytes left in the span */
+	uint32_t used;			/* Bytes written to the span not yet committed */
+	uint32_t total;			/* Bytes written altogether */
+} sink_t;
+
+static uint32_t format_core(sink_t *sink, const char *format, va_list args);
+
+/*--------------------------------------------------------------------------*/
+/* Quotient by ten. 0xCCCCCCCD is 2^35/10 rounded up. */
+
+static inline uint32_t divide_by_ten(uint32_t value)
+{
+	return (uint32_t)(((uint64_t) value * 0xCCCCCCCDU) >> 35);
+}
+
+/* Write the decimal digits of a value in reverse order. Returns the count. */
+static uint8_t decimal_reversed(char *digits, uint32_t value)
+{
+	uint8_t n = 0;
+	do
+	{
+		uint32_t quotient = divide_by_ten(value);
+		digits[n++] = '0' + (char)(value - quotient * 10);
+		value = quotient;
+	}
+	while (value > 0);
+	return n;
+}
+
+/* Write the hex digits of a value in reverse order, at least one and no more
+than eight. Returns the count. */
+static uint8_t hex_reversed(char *digits, uint32_t value, bool upper)
+{
+	const char *symbols = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	uint8_t n = 0;
+	do
+	{
+		digits[n++] = symbols[value & 0xF];
+		value >>= 4;
+	}
+	while (value > 0);
+	return n;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Convert an Unsigned Integer to ASCII Decimal
+
+@param[out] out: at least FORMAT_UINT_DIGITS characters. Not terminated.
+@param[in] value: value to convert.
+@returns number of characters written.
+*/
+
+uint8_t format_uint(char *out, uint32_t value)
+{
+	char digits[FORMAT_UINT_DIGITS];
+	uint8_t n = decimal_reversed(digits, value);
+	uint8_t i;
+	for (i = 0; i < n; i++) out[i] = digits[n - 1 - i];
+	return n;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Convert an Unsigned Integer to ASCII Hex
+
+Upper case hex digits are written, with leading zeros, for a fixed number of
+digits.
+
+@param[out] out: at least the number of digits. Not terminated.
+@param[in] value: value to convert.
+@param[in] digits: number of digits, 1 to 8.
+@returns number of characters written.
+*/
+
+uint8_t format_hex(char *out, uint32_t value, uint8_t digits)
+{
+	uint8_t i;
+	for (i = digits; i > 0; i--)
+	{
+		out[i - 1] = "0123456789ABCDEF"[value & 0xF];
+		value >>= 4;
+	}
+	return digits;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Formatted Output to a Byte Buffer
+
+@param[in] buffer: byte buffer to write to.
+@param[in] format: format string.
+@returns number of characters written.
+*/
+
+uint16_t format_buffer(uint8_t buffer[], const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	uint16_t n = vformat_buffer(buffer, format, args);
+	va_end(args);
+	return n;
+}
+
+uint16_t vformat_buffer(uint8_t buffer[], const char *format, va_list args)
+{
+	sink_t sink = {buffer, 0, 0, 0, 0, 0, 0};
+	return format_core(&sink, format, args);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Formatted Output to a Ring Buffer
+
+@param[in] ring: ring buffer to write to.
+@param[in] format: format string.
+@returns number of characters written.
+*/
+
+uint32_t format_ring(ring_buffer_t *ring, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	uint32_t n = vformat_ring(ring, format, args);
+	va_end(args);
+	return n;
+}
+
+uint32_t vformat_ring(ring_buffer_t *ring, const char *format, va_list args)
+{
+	sink_t sink = {0, ring, 0, 0, 0, 0, 0};
+	return format_core(&sink, format, args);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Formatted Output to a String
+
+@param[out] out: character array, always terminated.
+@param[in] size: size of the array.
+@param[in] format: format string.
+@returns number of characters written, not including the terminator.
+*/
+
+uint32_t format_string(char *out, uint32_t size, const char *format, ...)
+{
+	va_list args;
+	if (size == 0) return 0;
+	sink_t sink = {0, 0, out, (uint8_t *) out, size - 1, 0, 0};
+	va_start(args, format);
+	uint32_t n = format_core(&sink, format, args);
+	va_end(args);
+	out[n] = 0;
+	return n;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Sink handling. What has been written to the current span is committed, and
+the next span reserved, when the span runs out. A string sink has the one span
+only. */
+
+static void sink_commit(sink_t *sink)
+{
+	if ((sink->string != 0) || (sink->used == 0)) return;
+	if (sink->ring != 0) ring_commit(sink->ring, sink->used);
+	else buffer_commit(sink->buffer, sink->used);
+	sink->used = 0;
+}
+
+static void sink_reserve(sink_t *sink)
+{
+	if (sink->string != 0) return;
+	if (sink->ring != 0)
+		sink->room = ring_reserve_contiguous(sink->ring, &sink->span);
+	else sink->room = buffer_reserve_contiguous(sink->buffer, &sink->span);
+}
+
+static inline void sink_put(sink_t *sink, char c)
+{
+	if (sink->room == 0)
+	{
+		sink_commit(sink);
+		sink_reserve(sink);
+		if (sink->room == 0) return;
+	}
+	*sink->span++ = (uint8_t) c;
+	sink->room--;
+	sink->used++;
+	sink->total++;
+}
+
+static void sink_pad(sink_t *sink, char c, uint32_t count)
+{
+	while (count-- > 0) sink_put(sink, c);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Formatter. Numbers are converted in reverse into a small array on the stack
+and then put out in order with padding around them. */
+
+static uint32_t format_core(sink_t *sink, const char *format, va_list args)
+{
+	char digits[FORMAT_UINT_DIGITS];
+	sink_reserve(sink);
+	while (*format != 0)
+	{
+		char c = *format++;
+		if (c != '%')
+		{
+			sink_put(sink, c);
+			continue;
+		}
+		bool left = false;
+		bool zero = false;
+		uint32_t width = 0;
+		for (;; format++)
+		{
+			if (*format == '-') left = true;
+			else if (*format == '0') zero = true;
+			else break;
+		}
+		while ((*format >= '0') && (*format <= '9'))
+			width = width * 10 + (*format++ - '0');
+		c = *format++;
+		if (c == 0) break;
+/* Text is either a string to go forwards or digits to go in reverse */
+		const char *text = 0;
+		uint32_t length = 0;
+		bool negative = false;
+		switch (c)
+		{
+		case 'd':
+			{
+				int32_t value = va_arg(args, int32_t);
+				negative = (value < 0);
+				length = decimal_reversed(digits,
+                        negative ? -(uint32_t) value : (uint32_t) value);
+				break;
+			}
+		case 'u':
+			length = decimal_reversed(digits, va_arg(args, uint32_t));
+			break;
+		case 'x':
+		case 'X':
+			length = hex_reversed(digits, va_arg(args, uint32_t), (c == 'X'));
+			break;
+		case 'c':
+			digits[0] = (char) va_arg(args, int);
+			length = 1;
+			zero = false;
+			break;
+		case 's':
+			text = va_arg(args, const char *);
+			if (text == 0) text = "";
+			while (text[length] != 0) length++;
+			zero = false;
+			break;
+		default:
+			digits[0] = c;
+			length = 1;
+			zero = false;
+			break;
+		}
+		uint32_t size = length + (negative ? 1 : 0);
+		uint32_t fill = (width > size) ? width - size : 0;
+		if (! left && ! zero) sink_pad(sink, ' ', fill);
+		if (negative) sink_put(sink, '-');
+		if (! left && zero) sink_pad(sink, '0', fill);
+		uint32_t i;
+		if (text != 0) for (i = 0; i < length; i++) sink_put(sink, text[i]);
+		else for (i = length; i > 0; i--) sink_put(sink, digits[i - 1]);
+		if (left) sink_pad(sink, ' ', fill);
+	}
+	sink_commit(sink);
+	return sink->total;
+}
+
@@ -0,0 +1,26 @@
+/*	Formatted Output
+
+A small printf subset that writes directly into the circular buffers.
+
+14 October 2026
+*/
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdint.h>
+#include <stdarg.h>
+#include "buffer.h"
+
+/* Longest number produced by format_uint, not including a terminator */
+#define FORMAT_UINT_DIGITS 10
+
+uint8_t format_uint(char *out, uint32_t value);
+uint8_t format_hex(char *out, uint32_t value, uint8_t digits);
+uint16_t format_buffer(uint8_t buffer[], const char *format, ...);
+uint16_t vformat_buffer(uint8_t buffer[], const char *format, va_list args);
+uint32_t format_ring(ring_buffer_t *ring, const char *format, ...);
+uint32_t vformat_ring(ring_buffer_t *ring, const char *format, va_list args);
+uint32_t format_string(char *out, uint32_t size, const char *format, ...);
+
+#endif
@@ -0,0 +1,257 @@
+/*	In Application Programming
+
+An update is received by a transport such as iap_link.c into the download
+slot while the application goes on running. iap_begin gives the length of the
+image and invalidates any earlier download, and iap_write then programs each
+chunk as it arrives, erasing each page only when the data first reaches it.
+With the reception done by DMA the next chunk streams in while a page is
+erased or programmed, so the update runs at the speed of the link as long as
+the receive buffer holds the data arriving during a page erase, 20 to 40ms.
+iap_end checks the CRC of the whole image with the CRC unit and only then
+programs the descriptor of the image, its length and CRC, into the last page
+of the slot.
+
+At reset the bootloader finds the descriptor with iap_pending and iap_install
+copies the image into the application slot, verifies it, programs the
+descriptor of the application slot and lastly erases the download descriptor.
+If power fails during the copy, the download is still pending and the copy is
+done again at the next reset. An image that fails its CRC is never installed,
+and the application is always started from a verified copy, the bootloader
+staying in control when iap_install returns an error.
+
+The CRC is that of flash_write_crc, the CRC-32 of the CRC unit over the image
+as little endian words, a part word at the end filled with 0xFF.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/cm3/scb.h>
+#include "flash_write.h"
+#include "iap.h"
+
+#define IAP_MAGIC           0x50414955
+
+typedef struct {
+	uint32_t magic;
+	uint32_t length;
+	uint32_t crc;
+} iap_descriptor_t;
+
+#define DESCRIPTOR(base)    ((const iap_descriptor_t *) ((base) + IAP_IMAGE_MAX))
+
+/* Download in progress */
+static bool started;
+static uint32_t image_length;
+static uint32_t written;
+/* End of the pages erased so far */
+static uint32_t erased;
+
+static bool image_valid(uint32_t base);
+static uint8_t write_descriptor(uint32_t base, uint32_t length, uint32_t crc);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Begin a Download
+
+Any image waiting in the download slot is invalidated.
+
+@param[in] length: length of the image in bytes.
+@returns IAP_OK, IAP_INVALID or IAP_FLASH_ERROR.
+*/
+
+uint8_t iap_begin(uint32_t length)
+{
+	started = false;
+	if ((length == 0) || (length > IAP_IMAGE_MAX)) return IAP_INVALID;
+	if (flash_write_erase(IAP_DOWNLOAD_BASE + IAP_IMAGE_MAX,
+			      FLASH_WRITE_PAGE_SIZE) != FLASH_WRITE_OK)
+		return IAP_FLASH_ERROR;
+	image_length = length;
+	written = 0;
+	erased = IAP_DOWNLOAD_BASE;
+	started = true;
+	return IAP_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Program a Chunk of the Image
+
+Chunks must follow on in order and all but the last be of even length. A
+chunk already programmed is accepted again and ignored, so that a transport
+may resend after a lost acknowledgement.
+
+@param[in] offset: position of the chunk in the image.
+@param[in] data: the chunk.
+@param[in] length: length of the chunk in bytes.
+@returns IAP_OK, IAP_NOT_STARTED, IAP_INVALID or IAP_FLASH_ERROR.
+*/
+
+uint8_t iap_write(uint32_t offset, const void *data, uint32_t length)
+{
+	if (! started) return IAP_NOT_STARTED;
+	if ((offset + length > image_length) || (offset > written))
+		return IAP_INVALID;
+	if (offset < written)
+		return (offset + length <= written) ? IAP_OK : IAP_INVALID;
+	if (written & 1) return IAP_INVALID;
+	uint32_t address = IAP_DOWNLOAD_BASE + offset;
+	while (erased < address + length)
+	{
+		if (flash_write_erase(erased, FLASH_WRITE_PAGE_SIZE)
+		    != FLASH_WRITE_OK)
+			return IAP_FLASH_ERROR;
+		erased += FLASH_WRITE_PAGE_SIZE;
+	}
+	if (flash_write(address, data, length) != FLASH_WRITE_OK)
+		return IAP_FLASH_ERROR;
+	written += length;
+	return IAP_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Length of the Image Programmed
+
+@returns the offset of the next chunk expected.
+*/
+
+uint32_t iap_written(void)
+{
+	return written;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief End a Download
+
+The whole image must have been written. Its CRC is checked and the image is
+then marked as waiting to be installed.
+
+@param[in] crc: CRC of the image given by the sender.
+@returns IAP_OK, IAP_NOT_STARTED, IAP_INVALID, IAP_CRC_ERROR or
+IAP_FLASH_ERROR.
+*/
+
+uint8_t iap_end(uint32_t crc)
+{
+	if (! started) return IAP_NOT_STARTED;
+	if (written != image_length) return IAP_INVALID;
+	started = false;
+	if (flash_write_crc((const void *) IAP_DOWNLOAD_BASE, image_length) != crc)
+		return IAP_CRC_ERROR;
+	return write_descriptor(IAP_DOWNLOAD_BASE, image_length, crc);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check for an Image to Install
+
+@returns true if the download slot holds a complete image that checks.
+*/
+
+bool iap_pending(void)
+{
+	return image_valid(IAP_DOWNLOAD_BASE);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Install the Downloaded Image
+
+Called by the bootloader before the application is started. The image is
+copied into the application slot and verified, and the download is then
+cleared.
+
+@returns IAP_OK, IAP_NO_IMAGE, IAP_CRC_ERROR or IAP_FLASH_ERROR.
+*/
+
+uint8_t iap_install(void)
+{
+	if (! iap_pending()) return IAP_NO_IMAGE;
+	uint32_t length = DESCRIPTOR(IAP_DOWNLOAD_BASE)->length;
+	uint32_t crc = DESCRIPTOR(IAP_DOWNLOAD_BASE)->crc;
+	uint32_t offset;
+	if ((flash_write_erase(IAP_APP_BASE + IAP_IMAGE_MAX,
+			       FLASH_WRITE_PAGE_SIZE) != FLASH_WRITE_OK) ||
+	    (flash_write_erase(IAP_APP_BASE, length) != FLASH_WRITE_OK))
+		return IAP_FLASH_ERROR;
+	for (offset = 0; offset < length; offset += FLASH_WRITE_PAGE_SIZE)
+	{
+		uint32_t size = length - offset;
+		if (size > FLASH_WRITE_PAGE_SIZE) size = FLASH_WRITE_PAGE_SIZE;
+		if (flash_write(IAP_APP_BASE + offset,
+				(const void *) (IAP_DOWNLOAD_BASE + offset), size)
+		    != FLASH_WRITE_OK)
+			return IAP_FLASH_ERROR;
+	}
+	if (flash_write_crc((const void *) IAP_APP_BASE, length) != crc)
+		return IAP_CRC_ERROR;
+	uint8_t result = write_descriptor(IAP_APP_BASE, length, crc);
+	if (result != IAP_OK) return result;
+	if (flash_write_erase(IAP_DOWNLOAD_BASE + IAP_IMAGE_MAX,
+			      FLASH_WRITE_PAGE_SIZE) != FLASH_WRITE_OK)
+		return IAP_FLASH_ERROR;
+	return IAP_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check the Application
+
+An application with a descriptor must match its CRC. One loaded through the
+debug port has none, and is taken as valid if its stack pointer is in RAM and
+its reset vector in the slot.
+
+@returns true if the application may be started.
+*/
+
+bool iap_application_valid(void)
+{
+	const uint32_t *vectors = (const uint32_t *) IAP_APP_BASE;
+	if (DESCRIPTOR(IAP_APP_BASE)->magic != 0xFFFFFFFF)
+		return image_valid(IAP_APP_BASE);
+	return ((vectors[0] & 0x2FFE0000) == 0x20000000) &&
+	       (vectors[1] > IAP_APP_BASE) &&
+	       (vectors[1] < IAP_APP_BASE + IAP_IMAGE_MAX);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the Application
+
+The vector table is moved to the application, and its stack pointer and reset
+vector are loaded. This must be called before the bootloader has enabled any
+interrupt or peripheral, as the application expects them as from reset.
+Otherwise reset the processor to start the application.
+*/
+
+void iap_start_application(void)
+{
+	const uint32_t *vectors = (const uint32_t *) IAP_APP_BASE;
+	SCB_VTOR = IAP_APP_BASE;
+	__asm__ __volatile__ ("msr msp, %0\n\tbx %1"
+			      : : "r" (vectors[0]), "r" (vectors[1]));
+	while (1);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Check that a slot has a descriptor and that the image matches its CRC. */
+
+static bool image_valid(uint32_t base)
+{
+	const iap_descriptor_t *descriptor = DESCRIPTOR(base);
+	return (descriptor->magic == IAP_MAGIC) &&
+	       (descriptor->length > 0) &&
+	       (descriptor->length <= IAP_IMAGE_MAX) &&
+	       (flash_write_crc((const void *) base, descriptor->length) ==
+		descriptor->crc);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Program the descriptor of a slot, the magic number last so that a torn
+descriptor is never taken as valid. */
+
+static uint8_t write_descriptor(uint32_t base, uint32_t length, uint32_t crc)
+{
+	iap_descriptor_t descriptor = {IAP_MAGIC, length, crc};
+	uint32_t address = base + IAP_IMAGE_MAX;
+	if ((flash_write(address + 4, &descriptor.length, 8) != FLASH_WRITE_OK) ||
+	    (flash_write(address, &descriptor.magic, 4) != FLASH_WRITE_OK))
+		return IAP_FLASH_ERROR;
+	return IAP_OK;
+}
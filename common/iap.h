@@ -0,0 +1,50 @@
+/*	In Application Programming
+
+Firmware update of the STM32F1 through a download slot in flash. The image is
+programmed into the download slot as it is received, verified by CRC, and then
+copied into the application slot by the bootloader at the next reset.
+
+14 October 2026
+*/
+
+#ifndef IAP_H
+#define IAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_write.h"
+
+/* Flash taken by the bootloader, and the application and download slots. The
+defaults suit a 512K high density device with 2K pages, which needs
+FLASH_WRITE_PAGE_SIZE set to 2048. The last page of each slot holds the
+descriptor of the image in it, so an image may be up to IAP_IMAGE_MAX bytes.
+The application is linked at IAP_APP_BASE. */
+#ifndef IAP_APP_BASE
+#define IAP_APP_BASE        0x08004000
+#endif
+#ifndef IAP_SLOT_SIZE
+#define IAP_SLOT_SIZE       0x3C000
+#endif
+#ifndef IAP_DOWNLOAD_BASE
+#define IAP_DOWNLOAD_BASE   (IAP_APP_BASE + IAP_SLOT_SIZE)
+#endif
+#define IAP_IMAGE_MAX       (IAP_SLOT_SIZE - FLASH_WRITE_PAGE_SIZE)
+
+/* Results of the update operations */
+#define IAP_OK              0
+#define IAP_INVALID         1   /* too long, or data out of order */
+#define IAP_NOT_STARTED     2
+#define IAP_FLASH_ERROR     3
+#define IAP_CRC_ERROR       4   /* image does not match its CRC */
+#define IAP_NO_IMAGE        5
+
+uint8_t iap_begin(uint32_t length);
+uint8_t iap_write(uint32_t offset, const void *data, uint32_t length);
+uint32_t iap_written(void);
+uint8_t iap_end(uint32_t crc);
+bool iap_pending(void);
+uint8_t iap_install(void);
+bool iap_application_valid(void);
+void iap_start_application(void);
+
+#endif
@@ -0,0 +1,166 @@
+/*	Firmware Update Link
+
+The host sends the image to iap.c in frames laid out as the records of
+telemetry.c,
+
+    type, sequence, payload, CRC low, CRC high
+
+COBS encoded and ended with a zero, and each frame that checks is answered by
+a TELEMETRY_IAP record of
+
+    frame type, frame sequence, result, next offset (4 bytes)
+
+where the result is that of iap.c and the next offset is the length of the
+image programmed so far. A BEGIN frame carries the image length, DATA frames
+the offset of the chunk and up to IAP_CHUNK_MAX bytes of it, and the END frame
+the CRC of the image, all little endian.
+
+The host may send several data frames ahead of the acknowledgements, so that
+the link is kept busy while each chunk is programmed. A frame lost or
+corrupted is dropped here, the following chunks are then out of order and
+answered with IAP_INVALID and the offset expected, and the host goes back and
+sends from that offset. The receive ring must hold the frames in flight and the
+data arriving during a page erase, so 2K suits 115200 baud and a window of
+four frames.
+
+The bytes are taken from the receive ring with the peek and consume span calls.
+The acknowledgements go out through telemetry_send, which must have been given
+the send buffer, and the caller starts the transmission.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "buffer.h"
+#include "telemetry.h"
+#include "iap.h"
+#include "iap_link.h"
+
+/* Largest frame, encoded, without the delimiter */
+#define FRAME_MAX           (IAP_CHUNK_MAX + 12)
+
+static ring_buffer_t *receive_ring;
+static uint8_t frame[FRAME_MAX];
+static uint16_t frame_length;
+/* Set when a frame overflows, so that the rest is dropped */
+static bool discard;
+
+static bool frame_process(void);
+static uint16_t cobs_decode(uint8_t *data, uint16_t length);
+static uint32_t get_u32(const uint8_t *data);
+static void reply(uint8_t type, uint8_t sequence, uint8_t result);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise the Update Link
+
+@param[in] receive: ring buffer receiving from the host.
+*/
+
+void iap_link_init(ring_buffer_t *receive)
+{
+	receive_ring = receive;
+	frame_length = 0;
+	discard = false;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Process Received Frames
+
+Call this from the main loop as data arrives. All the frames received are
+processed and answered.
+
+@returns true once an image has been received and verified. Reset the
+processor to have the bootloader install it.
+*/
+
+bool iap_link_poll(void)
+{
+	uint8_t *data;
+	uint32_t length;
+	bool done = false;
+	while ((length = ring_peek_contiguous(receive_ring, &data)) > 0)
+	{
+		uint32_t i;
+		for (i = 0; i < length; i++)
+		{
+			if (data[i] != 0)
+			{
+				if (frame_length < FRAME_MAX) frame[frame_length++] = data[i];
+				else discard = true;
+				continue;
+			}
+			if (! discard && (frame_length > 0) && frame_process())
+				done = true;
+			frame_length = 0;
+			discard = false;
+		}
+		ring_consume(receive_ring, length);
+	}
+	return done;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Check a frame and pass it to iap.c. A frame that fails its CRC is dropped
+without an answer. */
+
+static bool frame_process(void)
+{
+	uint16_t length = cobs_decode(frame, frame_length);
+	if (length < 4) return false;
+	uint16_t crc = telemetry_crc(0xFFFF, frame, length - 2);
+	if (crc != (frame[length - 2] | ((uint16_t) frame[length - 1] << 8)))
+		return false;
+	uint8_t type = frame[0];
+	uint8_t sequence = frame[1];
+	uint8_t *payload = frame + 2;
+	uint16_t payload_length = length - 4;
+	uint8_t result = IAP_INVALID;
+	if (payload_length >= 4)
+	{
+		if (type == IAP_FRAME_BEGIN) result = iap_begin(get_u32(payload));
+		else if (type == IAP_FRAME_DATA)
+			result = iap_write(get_u32(payload), payload + 4,
+					   payload_length - 4);
+		else if (type == IAP_FRAME_END) result = iap_end(get_u32(payload));
+	}
+	reply(type, sequence, result);
+	return (type == IAP_FRAME_END) && (result == IAP_OK);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Decode a COBS frame in place, returning the decoded length or 0 if it is
+invalid. The output never overtakes the input. */
+
+static uint16_t cobs_decode(uint8_t *data, uint16_t length)
+{
+	uint16_t in = 0;
+	uint16_t out = 0;
+	while (in < length)
+	{
+		uint8_t code = data[in++];
+		if (in + code - 1 > length) return 0;
+		uint8_t i;
+		for (i = 1; i < code; i++) data[out++] = data[in++];
+		if ((code < 0xFF) && (in < length)) data[out++] = 0;
+	}
+	return out;
+}
+
+static uint32_t get_u32(const uint8_t *data)
+{
+	return data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) |
+	       ((uint32_t) data[3] << 24);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Answer a frame with its result and the offset expected next. */
+
+static void reply(uint8_t type, uint8_t sequence, uint8_t result)
+{
+	uint32_t next = iap_written();
+	uint8_t payload[7] = {type, sequence, result, (uint8_t) next,
+			      (uint8_t) (next >> 8), (uint8_t) (next >> 16),
+			      (uint8_t) (next >> 24)};
+	telemetry_send(TELEMETRY_IAP, payload, sizeof(payload));
+}
@@ -0,0 +1,28 @@
+/*	Firmware Update Link
+
+Serial transport for iap.c. The image is sent in framed chunks of the same
+COBS format as telemetry.c and each frame is acknowledged by a telemetry
+record.
+
+14 October 2026
+*/
+
+#ifndef IAP_LINK_H
+#define IAP_LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "buffer.h"
+
+/* Frame types sent by the host */
+#define IAP_FRAME_BEGIN     0x01    /* length of the image */
+#define IAP_FRAME_DATA      0x02    /* offset in the image, then the chunk */
+#define IAP_FRAME_END       0x03    /* CRC of the image */
+
+/* Longest chunk in a data frame */
+#define IAP_CHUNK_MAX       240
+
+void iap_link_init(ring_buffer_t *receive);
+bool iap_link_poll(void);
+
+#endif
@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""Firmware update sender for iap_link.c.
+
+Sends a binary image, linked at IAP_APP_BASE, to the download slot of iap.c
+in framed chunks and reports the time taken. Up to WINDOW data frames are
+kept in flight so that the link stays busy while the target programs each
+chunk. After a lost frame the target answers the following ones with the
+offset it expects, and sending goes back to that offset. Once the image has
+been verified the target resets so that the bootloader installs it.
+
+    iap_send.py /dev/ttyUSB0 image.bin [baudrate]
+
+Needs pyserial, and telemetry_decode.py in the same directory.
+
+14 October 2026
+"""
+
+import sys
+import time
+
+import telemetry_decode
+
+IAP_FRAME_BEGIN = 0x01
+IAP_FRAME_DATA = 0x02
+IAP_FRAME_END = 0x03
+TELEMETRY_IAP = 0x05
+IAP_CHUNK_MAX = 240
+WINDOW = 4
+TIMEOUT = 1.0
+
+RESULTS = ["ok", "invalid", "not started", "flash error", "CRC error",
+           "no image"]
+
+
+def cobs_encode(record):
+    """COBS encode a record and add the zero delimiter."""
+    out = bytearray([0])
+    code = 0
+    run = 1
+    for c in record:
+        if c == 0:
+            out[code] = run
+            code = len(out)
+            out.append(0)
+            run = 1
+        else:
+            out.append(c)
+            run += 1
+    out[code] = run
+    out.append(0)
+    return bytes(out)
+
+
+def crc32_stm32(data):
+    """CRC-32 of the STM32 CRC unit over little endian words, a part word at
+    the end filled with 0xFF, as flash_write_crc."""
+    data = bytes(data) + b"\xFF" * (-len(data) % 4)
+    crc = 0xFFFFFFFF
+    for i in range(0, len(data), 4):
+        crc ^= int.from_bytes(data[i:i + 4], "little")
+        for _ in range(32):
+            crc = ((crc << 1) ^ 0x04C11DB7) if crc & 0x80000000 else (crc << 1)
+            crc &= 0xFFFFFFFF
+    return crc
+
+
+class Link:
+    """Sends frames and collects the answers."""
+
+    def __init__(self, port):
+        self.port = port
+        self.sequence = 0
+        self.decoder = telemetry_decode.Decoder()
+
+    def send(self, kind, payload):
+        """Send a frame, returning its sequence number."""
+        sequence = self.sequence
+        record = bytes([kind, sequence]) + payload
+        crc = telemetry_decode.crc16(record)
+        self.port.write(cobs_encode(record + bytes([crc & 0xFF, crc >> 8])))
+        self.sequence = (self.sequence + 1) & 0xFF
+        return sequence
+
+    def answers(self):
+        """Answers received, as (type, sequence, result, next offset)."""
+        found = []
+        for kind, _, payload in self.decoder.feed(self.port.read(256)):
+            if kind == TELEMETRY_IAP and len(payload) == 7:
+                found.append((payload[0], payload[1], payload[2],
+                              int.from_bytes(payload[3:7], "little")))
+        return found
+
+    def command(self, kind, payload, timeout=5.0):
+        """Send a frame and wait for its answer, resending on a timeout."""
+        for _ in range(3):
+            sequence = self.send(kind, payload)
+            end = time.time() + timeout
+            while time.time() < end:
+                for answer in self.answers():
+                    if answer[0] == kind and answer[1] == sequence:
+                        return answer[2]
+        raise IOError("no answer from the target")
+
+
+def update(link, image):
+    length = len(image)
+    result = link.command(IAP_FRAME_BEGIN, length.to_bytes(4, "little"))
+    if result != 0:
+        raise IOError("begin refused: " + RESULTS[result])
+    sent = 0
+    acked = 0
+    flight = {}
+    last = time.time()
+    resent = 0
+    while acked < length:
+        while sent < length and len(flight) < WINDOW:
+            chunk = image[sent:sent + IAP_CHUNK_MAX]
+            sequence = link.send(IAP_FRAME_DATA,
+                                 sent.to_bytes(4, "little") + chunk)
+            flight[sequence] = sent
+            sent += len(chunk)
+        for kind, sequence, result, offset in link.answers():
+            if kind != IAP_FRAME_DATA or sequence not in flight:
+                continue
+            last = time.time()
+            del flight[sequence]
+            if result == 0:
+                acked = max(acked, offset)
+            elif result == 1:
+                # Out of order after a lost frame. Go back to the offset
+                # expected and forget the frames in flight.
+                acked = offset
+                sent = offset
+                flight.clear()
+                resent += 1
+            else:
+                raise IOError("write failed at %d: %s"
+                              % (offset, RESULTS[result]))
+        if flight and time.time() - last > TIMEOUT:
+            sent = acked
+            flight.clear()
+            resent += 1
+            last = time.time()
+        print("\r%d of %d bytes" % (acked, length), end="", flush=True)
+    print()
+    result = link.command(IAP_FRAME_END,
+                          crc32_stm32(image).to_bytes(4, "little"))
+    if result != 0:
+        raise IOError("image refused: " + RESULTS[result])
+    return resent
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(__doc__)
+        return 1
+    import serial
+    baudrate = int(sys.argv[3]) if len(sys.argv) > 3 else 115200
+    port = serial.Serial(sys.argv[1], baudrate, timeout=0.01)
+    with open(sys.argv[2], "rb") as source:
+        image = source.read()
+    start = time.time()
+    try:
+        resent = update(Link(port), image)
+    except IOError as error:
+        print(error)
+        return 1
+    elapsed = time.time() - start
+    print("%d bytes in %.1fs, %.0f bytes/s, %d resends"
+          % (len(image), elapsed, len(image) / elapsed, resent))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
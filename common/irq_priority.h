@@ -0,0 +1,114 @@
+/*	Interrupt Priority Plan
+
+Priorities of all the interrupts of the examples, by how long their handlers
+can be kept waiting, so that when several stacks are combined in one program
+the handlers with the tightest deadlines still preempt the others. Programs
+set each priority here with IRQ_PRIORITY_SET, or IRQ_PRIORITY_SET_RTOS for a
+handler that calls the FreeRTOS API, rather than with a number of their own.
+
+The STM32 implements the upper 4 bits of each priority, giving 16 levels with
+0 the highest, all of them preempting as libopencm3 leaves the priority
+grouping at reset. Levels above the FreeRTOS syscall ceiling are never masked
+by the kernel, so their latency is set by the handlers above them alone:
+
+	1   IRQ_LEVEL_DMA       DMA transfer complete of ADC, DAC and capture
+	2   IRQ_LEVEL_ADC       ADC conversions taken by interrupt
+	4   IRQ_LEVEL_COMM      USART, CAN and SPI
+	6   IRQ_LEVEL_TIMER     periodic and protocol timers
+	8   IRQ_LEVEL_INPUT     digital input edges
+
+Handlers that call FreeRTOS must be at or below the ceiling, and are kept in
+the same order beneath it:
+
+	11  IRQ_LEVEL_RTOS_DMA
+	12  IRQ_LEVEL_RTOS_COMM
+	13  IRQ_LEVEL_RTOS_TIMER
+	14  IRQ_LEVEL_RTOS_WAKE     RTC alarm of the tickless idle
+	15  IRQ_LEVEL_KERNEL        PendSV and SysTick
+
+Level 0 is left for a handler that must preempt all of these. The order of
+the plan is checked at compile time, as is each level given to
+IRQ_PRIORITY_SET and IRQ_PRIORITY_SET_RTOS, and included after FreeRTOS.h the
+ceiling and kernel levels are checked against FreeRTOSConfig.h.
+
+15 October 2026
+*/
+
+#ifndef IRQ_PRIORITY_H
+#define IRQ_PRIORITY_H
+
+#include <libopencm3/cm3/nvic.h>
+
+/* Priority bits implemented by the NVIC */
+#define IRQ_PRIO_BITS           4
+#define IRQ_PRIO_MASK           ((0xFF << (8 - IRQ_PRIO_BITS)) & 0xFF)
+
+/* Levels not masked by FreeRTOS, whose handlers must not call it */
+#define IRQ_LEVEL_DMA           1
+#define IRQ_LEVEL_ADC           2
+#define IRQ_LEVEL_COMM          4
+#define IRQ_LEVEL_TIMER         6
+#define IRQ_LEVEL_INPUT         8
+
+/* The FreeRTOS syscall ceiling, configMAX_SYSCALL_INTERRUPT_PRIORITY */
+#define IRQ_LEVEL_SYSCALL       11
+
+/* Levels whose handlers may call the FreeRTOS ...FromISR functions */
+#define IRQ_LEVEL_RTOS_DMA      11
+#define IRQ_LEVEL_RTOS_COMM     12
+#define IRQ_LEVEL_RTOS_TIMER    13
+#define IRQ_LEVEL_RTOS_WAKE     14
+#define IRQ_LEVEL_KERNEL        15
+
+/* NVIC priority of a level */
+#define IRQ_PRIORITY(level)     ((level) << (8 - IRQ_PRIO_BITS))
+
+#if (IRQ_LEVEL_DMA > IRQ_LEVEL_ADC) || (IRQ_LEVEL_ADC >= IRQ_LEVEL_COMM) || \
+    (IRQ_LEVEL_COMM >= IRQ_LEVEL_TIMER) || \
+    (IRQ_LEVEL_TIMER >= IRQ_LEVEL_INPUT) || \
+    (IRQ_LEVEL_INPUT >= IRQ_LEVEL_SYSCALL)
+#error "Interrupt levels above the syscall ceiling are out of order"
+#endif
+
+#if (IRQ_LEVEL_RTOS_DMA < IRQ_LEVEL_SYSCALL) || \
+    (IRQ_LEVEL_RTOS_DMA >= IRQ_LEVEL_RTOS_COMM) || \
+    (IRQ_LEVEL_RTOS_COMM >= IRQ_LEVEL_RTOS_TIMER) || \
+    (IRQ_LEVEL_RTOS_TIMER >= IRQ_LEVEL_RTOS_WAKE) || \
+    (IRQ_LEVEL_RTOS_WAKE >= IRQ_LEVEL_KERNEL) || \
+    (IRQ_LEVEL_KERNEL >= (1 << IRQ_PRIO_BITS))
+#error "Interrupt levels below the syscall ceiling are out of order"
+#endif
+
+/* The kernel compares only the implemented bits of its settings */
+#ifdef configMAX_SYSCALL_INTERRUPT_PRIORITY
+#if (configMAX_SYSCALL_INTERRUPT_PRIORITY & IRQ_PRIO_MASK) != \
+    IRQ_PRIORITY(IRQ_LEVEL_SYSCALL)
+#error "configMAX_SYSCALL_INTERRUPT_PRIORITY is not IRQ_LEVEL_SYSCALL"
+#endif
+#if (configKERNEL_INTERRUPT_PRIORITY & IRQ_PRIO_MASK) != \
+    IRQ_PRIORITY(IRQ_LEVEL_KERNEL)
+#error "configKERNEL_INTERRUPT_PRIORITY is not IRQ_LEVEL_KERNEL"
+#endif
+#endif
+
+/* Set the priority of a handler that does not call FreeRTOS. A level at or
+below the ceiling is refused, as the handler would then wait on the kernel's
+critical sections for no reason. */
+#define IRQ_PRIORITY_SET(irq, level) \
+	do { \
+		_Static_assert((level) < IRQ_LEVEL_SYSCALL, \
+		               "use IRQ_PRIORITY_SET_RTOS at this level"); \
+		nvic_set_priority(irq, IRQ_PRIORITY(level)); \
+	} while (0)
+
+/* Set the priority of a handler that calls FreeRTOS. A level above the
+ceiling is refused, as the handler could then run inside a critical section
+of the kernel. */
+#define IRQ_PRIORITY_SET_RTOS(irq, level) \
+	do { \
+		_Static_assert((level) >= IRQ_LEVEL_SYSCALL, \
+		               "a FreeRTOS handler is above the syscall ceiling"); \
+		nvic_set_priority(irq, IRQ_PRIORITY(level)); \
+	} while (0)
+
+#endif
@@ -0,0 +1,210 @@
+/*	Interrupt Profiler
+
+Each handler profiled begins with ISR_PROFILE_ENTER and ends with
+ISR_PROFILE_EXIT, given the slot of its vector. The entry stores the DWT cycle
+count, and the exit records the cycles from entry to exit as the duration and
+those from the previous entry to this one as the interval, so the timing
+jitter of a periodic interrupt shows in the spread of its interval. For each
+are kept the count, minimum, maximum and total for the mean, and a histogram
+in powers of two of cycles.
+
+The cost of the two counter reads is measured at the start and taken from
+each duration. What remains includes the call to record it, some tens of
+cycles, and the time of any interrupt of higher priority that came between
+entry and exit, which shows as an outlier in the histogram of the handler
+interrupted. A handler is not entered again until it has exited, so each slot
+is written only by its own handler, and readers take a copy with interrupts
+masked.
+
+Without ISR_PROFILE the hooks compile to nothing, and this file is not built.
+The cycle counter wraps after 59 seconds at 72MHz, so an interval longer than
+that is recorded short.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+#include "isr_profile.h"
+#include "format.h"
+
+volatile uint32_t isr_profile_entry[ISR_PROFILE_SLOTS];
+
+static isr_profile_t profiles[ISR_PROFILE_SLOTS];
+
+/* Last entry of each slot, valid once its duration count is not zero */
+static uint32_t last_entry[ISR_PROFILE_SLOTS];
+
+/* Cycles taken by the counter reads themselves */
+static uint32_t overhead;
+
+static void record(isr_profile_hist_t *hist, uint32_t cycles);
+static void clear_hist(isr_profile_hist_t *hist);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start Profiling
+
+The DWT cycle counter is enabled, the cost of reading it measured and the
+profiles cleared.
+*/
+
+void isr_profile_init(void)
+{
+	dwt_enable_cycle_counter();
+	bool masked = cm_mask_interrupts(true);
+	isr_profile_entry[0] = DWT_CYCCNT;
+	uint32_t now = DWT_CYCCNT;
+	overhead = now - isr_profile_entry[0];
+	cm_mask_interrupts(masked);
+	isr_profile_clear();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Clear the Profiles
+
+*/
+
+void isr_profile_clear(void)
+{
+	bool masked = cm_mask_interrupts(true);
+	uint8_t i;
+	for (i = 0; i < ISR_PROFILE_SLOTS; i++)
+	{
+		clear_hist(&profiles[i].duration);
+		clear_hist(&profiles[i].interval);
+	}
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Record an Exit
+
+Called through ISR_PROFILE_EXIT at the end of the handler.
+
+@param[in] slot: vector of the handler.
+@param[in] now: cycle count at the exit.
+*/
+
+void isr_profile_exit(isr_profile_slot_t slot, uint32_t now)
+{
+	isr_profile_t *profile = &profiles[slot];
+	uint32_t entry = isr_profile_entry[slot];
+	uint32_t cycles = now - entry;
+	record(&profile->duration, (cycles > overhead) ? cycles - overhead : 0);
+	if (profile->duration.count > 1)
+		record(&profile->interval, entry - last_entry[slot]);
+	last_entry[slot] = entry;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Read a Profile
+
+@param[in] slot: vector.
+@param[out] profile: copy of its profile.
+*/
+
+void isr_profile_read(isr_profile_slot_t slot, isr_profile_t *profile)
+{
+	bool masked = cm_mask_interrupts(true);
+	*profile = profiles[slot];
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Name of a Slot
+
+@param[in] slot: vector.
+@returns short name for printing.
+*/
+
+const char *isr_profile_name(isr_profile_slot_t slot)
+{
+	static const char *names[ISR_PROFILE_SLOTS] = {
+		"usart1", "ser_tx", "ser_rx", "tim2", "tim3", "adc", "adc_dma",
+		"dac_dma"
+	};
+	return names[slot];
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write a Summary of a Slot
+
+One line of the count and the minimum, mean and maximum in cycles, of the
+duration and then of the interval. Nothing is written for a slot not yet
+entered.
+
+@param[out] text: string for the summary.
+@param[in] size: size of the string including its terminator.
+@param[in] slot: vector.
+@returns characters written.
+*/
+
+uint32_t isr_profile_format(char *text, uint32_t size, isr_profile_slot_t slot)
+{
+	isr_profile_t profile;
+	isr_profile_read(slot, &profile);
+	isr_profile_hist_t *run = &profile.duration;
+	isr_profile_hist_t *gap = &profile.interval;
+	if (run->count == 0) return 0;
+	if (gap->count == 0) gap->min = 0;
+	return format_string(text, size,
+	                     "%-7s %u run %u/%u/%u int %u/%u/%u\r\n",
+	                     isr_profile_name(slot), run->count, run->min,
+	                     (uint32_t) (run->total / run->count), run->max,
+	                     gap->min,
+	                     (gap->count > 0) ?
+	                         (uint32_t) (gap->total / gap->count) : 0,
+	                     gap->max);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write a Histogram
+
+The bins counted, each as the bin number (cycles below 2^n) and its count.
+Bins that do not fit are left off so that the line is always ended.
+
+@param[out] text: string for the histogram.
+@param[in] size: size of the string including its terminator.
+@param[in] hist: histogram from a profile read.
+@returns characters written.
+*/
+
+uint32_t isr_profile_format_bins(char *text, uint32_t size,
+                                 const isr_profile_hist_t *hist)
+{
+	uint32_t n = 0;
+	uint8_t i;
+	for (i = 0; (i < ISR_PROFILE_BINS) && (size - n > 12); i++)
+		if (hist->bins[i] > 0)
+			n += format_string(text + n, size - n, " %u:%u", i, hist->bins[i]);
+	n += format_string(text + n, size - n, "\r\n");
+	return n;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Add a time to a histogram. The bin is the number of significant bits. */
+
+static void record(isr_profile_hist_t *hist, uint32_t cycles)
+{
+	uint8_t bin = (cycles == 0) ? 0 : 32 - __builtin_clz(cycles);
+	if (bin >= ISR_PROFILE_BINS) bin = ISR_PROFILE_BINS - 1;
+	if (hist->bins[bin] < 0xFFFF) hist->bins[bin]++;
+	if (cycles < hist->min) hist->min = cycles;
+	if (cycles > hist->max) hist->max = cycles;
+	hist->total += cycles;
+	hist->count++;
+}
+
+/*--------------------------------------------------------------------------*/
+
+static void clear_hist(isr_profile_hist_t *hist)
+{
+	uint8_t i;
+	hist->count = 0;
+	hist->min = 0xFFFFFFFF;
+	hist->max = 0;
+	hist->total = 0;
+	for (i = 0; i < ISR_PROFILE_BINS; i++) hist->bins[i] = 0;
+}
@@ -0,0 +1,70 @@
+/*	Interrupt Profiler
+
+Execution time and entry to entry interval of the interrupt handlers, from the
+DWT cycle counter, with the count, minimum, maximum, mean and a log2
+histogram of each for every vector profiled.
+
+15 October 2026
+*/
+
+#ifndef ISR_PROFILE_H
+#define ISR_PROFILE_H
+
+#include <stdint.h>
+
+/* Vectors profiled. A handler is given one of these, and a handler shared by
+several vectors may be given one for each. */
+typedef enum {
+	ISR_PROFILE_USART1,         /* usart1_isr */
+	ISR_PROFILE_SERIAL_TX,      /* USART1 send DMA, dma1_channel4_isr */
+	ISR_PROFILE_SERIAL_RX,      /* USART1 receive DMA, dma1_channel5_isr */
+	ISR_PROFILE_TIM2,           /* tim2_isr */
+	ISR_PROFILE_TIM3,           /* tim3_isr */
+	ISR_PROFILE_ADC,            /* adc1_2_isr or adc_isr */
+	ISR_PROFILE_ADC_DMA,        /* dma1_channel1_isr or dma2_stream0_isr */
+	ISR_PROFILE_DAC_DMA,        /* dma2_channel3_isr or dma1_stream5_isr */
+	ISR_PROFILE_SLOTS
+} isr_profile_slot_t;
+
+/* Histogram bins. Bin 0 counts 0 cycles and bin n from 2^(n-1) to 2^n - 1
+cycles, with the last bin taking all that are longer, from 2^22 cycles (58ms
+at 72MHz). */
+#define ISR_PROFILE_BINS    24
+
+typedef struct {
+	uint32_t count;
+	uint32_t min;               /* cycles */
+	uint32_t max;
+	uint64_t total;
+	uint16_t bins[ISR_PROFILE_BINS];    /* stop at 65535 */
+} isr_profile_hist_t;
+
+typedef struct {
+	isr_profile_hist_t duration;        /* entry to exit */
+	isr_profile_hist_t interval;        /* entry to the next entry */
+} isr_profile_t;
+
+void isr_profile_init(void);
+void isr_profile_clear(void);
+void isr_profile_exit(isr_profile_slot_t slot, uint32_t now);
+void isr_profile_read(isr_profile_slot_t slot, isr_profile_t *profile);
+const char *isr_profile_name(isr_profile_slot_t slot);
+uint32_t isr_profile_format(char *text, uint32_t size, isr_profile_slot_t slot);
+uint32_t isr_profile_format_bins(char *text, uint32_t size,
+                                 const isr_profile_hist_t *hist);
+
+/* Placed first and last in each handler profiled. Without ISR_PROFILE they
+compile to nothing; build with ISR_PROFILE=1. The entry is a single store of
+the cycle count, and the exit reads the count before calling out to record
+it. */
+#ifdef ISR_PROFILE
+#include <libopencm3/cm3/dwt.h>
+extern volatile uint32_t isr_profile_entry[ISR_PROFILE_SLOTS];
+#define ISR_PROFILE_ENTER(slot) (isr_profile_entry[slot] = DWT_CYCCNT)
+#define ISR_PROFILE_EXIT(slot)  isr_profile_exit(slot, DWT_CYCCNT)
+#else
+#define ISR_PROFILE_ENTER(slot) ((void) 0)
+#define ISR_PROFILE_EXIT(slot)  ((void) 0)
+#endif
+
+#endif
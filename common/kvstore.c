@@ -0,0 +1,473 @@
+/*	Key Value Store in Flash
+
+Erasing a page of the STM32F1 flash takes 20 to 40ms and wears the page, so
+rewriting a page for each parameter saved is slow and soon wears it out. Here
+a page is kept as a log. A value is saved by appending a record of its key,
+length and data, which programs a few halfwords, and the latest record of each
+key is the one that counts. A RAM index of the latest record of each key,
+sorted by key, is built at start up by reading the log in order, and gives the
+value by a binary search.
+
+A record is the key, the length, the data padded to a halfword and a check,
+written last, so a record torn by a reset is ignored and the previous value
+stands. A zero length record deletes its key.
+
+When the page fills, the current records are copied to the start of an erased
+page, which then takes over the log, and the old page is left to be erased.
+The pages are taken in turn so the wear is spread over all KV_PAGES of them.
+Each page has a header of a sequence number, to find the newest, and a magic
+number written only once the copy is complete, so a reset during the copy
+leaves the old page in use. kv_service, called from the idle loop, erases a
+used page, one a call, and does the copy ahead of time once the log is nearly
+full, so that a write normally finds the room or an erased page ready. Each
+page is erased once for every page of records written, and the current data is
+limited to one page.
+
+The flash is read directly, so the value of kv_find is valid until the next
+write or service call.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <libopencm3/stm32/flash.h>
+#include "kvstore.h"
+
+/* Page header of the sequence then the magic number */
+#define PAGE_MAGIC          0x4750564B
+#define HEADER_SIZE         8
+#define CAPACITY            (KV_PAGE_SIZE - HEADER_SIZE)
+/* Record of key, length, data padded to a halfword and check */
+#define RECORD_SIZE(length) (6 + (((length) + 1) & ~1))
+#define RECORD_MAX          RECORD_SIZE(KV_VALUE_MAX)
+#define ERASED_KEY          0xFFFF
+
+/* States of the pages */
+#define PAGE_ERASED         0
+#define PAGE_LOG            1       /* holding the log */
+#define PAGE_STALE          2       /* to be erased */
+#define NO_PAGE             0xFF
+
+typedef struct {
+	uint16_t key;
+	uint16_t length;
+	uint32_t address;               /* of the latest record */
+} kv_entry_t;
+
+static kv_entry_t kv_index[KV_MAX_KEYS];
+static uint16_t keys;
+/* Sum of the sizes of the current records */
+static uint32_t live;
+static uint8_t state[KV_PAGES];
+static uint8_t head;
+static uint32_t head_sequence;
+/* Offset in the head page of the next record */
+static uint32_t head_offset;
+
+static uint32_t page_address(uint8_t page);
+static uint16_t read_halfword(uint32_t address);
+static uint16_t record_check(uint16_t key, uint16_t length,
+			     const uint8_t *data);
+static uint32_t scan_page(uint8_t page);
+static bool find(uint16_t key, uint16_t *position);
+static void index_set(uint16_t key, uint16_t length, uint32_t address);
+static uint8_t store(uint16_t key, const uint8_t *data, uint16_t length);
+static uint8_t next_page(uint8_t wanted);
+static uint8_t compact(void);
+static bool erase(uint8_t page);
+static bool program(uint32_t address, uint16_t data);
+static bool write_record(uint32_t address, uint16_t key, const uint8_t *data,
+			 uint16_t length);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Open the Store
+
+The page with the complete header of the highest sequence holds the log, and
+its records are read to build the index. Any other page not erased is left to
+be erased.
+
+@returns KV_OK
+*/
+
+uint8_t kv_init(void)
+{
+	uint8_t page;
+	keys = 0;
+	live = 0;
+	head = NO_PAGE;
+	head_sequence = 0;
+	head_offset = KV_PAGE_SIZE;
+	for (page = 0; page < KV_PAGES; page++)
+	{
+		uint32_t address = page_address(page);
+		uint32_t offset = 0;
+		while ((offset < KV_PAGE_SIZE) &&
+		       (*(const uint32_t *) (address + offset) == 0xFFFFFFFF))
+			offset += 4;
+		state[page] = (offset < KV_PAGE_SIZE) ? PAGE_STALE : PAGE_ERASED;
+		uint32_t sequence = *(const uint32_t *) address;
+		if ((*(const uint32_t *) (address + 4) == PAGE_MAGIC) &&
+		    ((head == NO_PAGE) || ((int32_t) (sequence - head_sequence) > 0)))
+		{
+			head = page;
+			head_sequence = sequence;
+		}
+	}
+	if (head != NO_PAGE)
+	{
+		state[head] = PAGE_LOG;
+		head_offset = scan_page(head);
+	}
+	uint16_t i;
+	for (i = 0; i < keys; i++) live += RECORD_SIZE(kv_index[i].length);
+	return KV_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Find a Value
+
+@param[in] key: key of the value.
+@param[out] length: length of the value in bytes.
+@returns the value in flash, or 0 if the key is not stored.
+*/
+
+const void *kv_find(uint16_t key, uint16_t *length)
+{
+	uint16_t position;
+	if (! find(key, &position)) return 0;
+	*length = kv_index[position].length;
+	return (const void *) (kv_index[position].address + 4);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Read a Value
+
+@param[in] key: key of the value.
+@param[out] data: buffer for the value.
+@param[in] size: size of the buffer. A longer value is cut short.
+@param[out] length: length of the value stored.
+@returns KV_OK or KV_NOT_FOUND.
+*/
+
+uint8_t kv_read(uint16_t key, void *data, uint16_t size, uint16_t *length)
+{
+	const void *value = kv_find(key, length);
+	if (value == 0) return KV_NOT_FOUND;
+	memcpy(data, value, (*length < size) ? *length : size);
+	return KV_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write a Value
+
+The record is appended to the log, replacing any value of the same key.
+
+@param[in] key: key of the value, any except 0xFFFF.
+@param[in] data: the value.
+@param[in] length: length of the value, from 1 to KV_VALUE_MAX bytes.
+@returns KV_OK, KV_INVALID, KV_FULL or KV_FLASH_ERROR.
+*/
+
+uint8_t kv_write(uint16_t key, const void *data, uint16_t length)
+{
+	if ((length == 0) || (length > KV_VALUE_MAX)) return KV_INVALID;
+	return store(key, (const uint8_t *) data, length);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Delete a Value
+
+@param[in] key: key of the value.
+@returns KV_OK, KV_NOT_FOUND or KV_FLASH_ERROR.
+*/
+
+uint8_t kv_delete(uint16_t key)
+{
+	return store(key, 0, 0);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Service the Store
+
+Call this from the idle loop. Each call erases one used page, or once there is
+less room left in the log than for the largest record, copies the current
+records to an erased page.
+
+@returns true if there is more to do.
+*/
+
+bool kv_service(void)
+{
+	uint8_t page = next_page(PAGE_STALE);
+	flash_unlock();
+	if (page != NO_PAGE) erase(page);
+	else if ((head_offset + RECORD_MAX > KV_PAGE_SIZE) &&
+		 (next_page(PAGE_ERASED) != NO_PAGE))
+		compact();
+	flash_lock();
+	return (next_page(PAGE_STALE) != NO_PAGE);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Number of Keys Stored
+
+@returns the number of keys with a value.
+*/
+
+uint16_t kv_count(void)
+{
+	return keys;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Address of a page in flash. */
+
+static uint32_t page_address(uint8_t page)
+{
+	return KV_BASE + (uint32_t) page*KV_PAGE_SIZE;
+}
+
+static uint16_t read_halfword(uint32_t address)
+{
+	return *(const volatile uint16_t *) address;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Fletcher check of a record. 0xFFFF is left for an unwritten check. */
+
+static uint16_t record_check(uint16_t key, uint16_t length,
+			     const uint8_t *data)
+{
+	uint8_t a = key + (key >> 8) + length + (length >> 8);
+	uint8_t b = a;
+	uint16_t i;
+	for (i = 0; i < length; i++)
+	{
+		a += data[i];
+		b += a;
+	}
+	uint16_t check = ((uint16_t) b << 8) | a;
+	return (check == 0xFFFF) ? 0xFFFE : check;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Read the records of a page into the index, returning the offset of the free
+space after them. A record whose check fails is skipped. If a length is out
+of range the rest of the page cannot be trusted, and the page is taken as
+full. */
+
+static uint32_t scan_page(uint8_t page)
+{
+	uint32_t address = page_address(page);
+	uint32_t offset = HEADER_SIZE;
+	while (offset + RECORD_SIZE(0) <= KV_PAGE_SIZE)
+	{
+		uint16_t key = read_halfword(address + offset);
+		uint16_t length = read_halfword(address + offset + 2);
+		if ((key == ERASED_KEY) && (length == 0xFFFF)) break;
+/* A record cut short before its length was written is skipped, and the log
+goes on after it */
+		if (length == 0xFFFF)
+		{
+			offset += 4;
+			continue;
+		}
+		uint32_t size = RECORD_SIZE(length);
+		if ((length > KV_VALUE_MAX) || (offset + size > KV_PAGE_SIZE))
+			return KV_PAGE_SIZE;
+		const uint8_t *data = (const uint8_t *) (address + offset + 4);
+		if (read_halfword(address + offset + size - 2) ==
+		    record_check(key, length, data))
+			index_set(key, length, address + offset);
+		offset += size;
+	}
+	return offset;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Binary search of the index. The position of the key, or where it would go,
+is returned. */
+
+static bool find(uint16_t key, uint16_t *position)
+{
+	uint16_t low = 0;
+	uint16_t high = keys;
+	while (low < high)
+	{
+		uint16_t middle = (low + high)/2;
+		if (kv_index[middle].key < key) low = middle + 1;
+		else high = middle;
+	}
+	*position = low;
+	return (low < keys) && (kv_index[low].key == key);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Point the index at the latest record of a key, removing the key for a zero
+length. A new key is dropped if the index is full. */
+
+static void index_set(uint16_t key, uint16_t length, uint32_t address)
+{
+	uint16_t position;
+	bool found = find(key, &position);
+	if (length == 0)
+	{
+		if (! found) return;
+		keys--;
+		memmove(&kv_index[position], &kv_index[position + 1],
+			(keys - position)*sizeof(kv_entry_t));
+		return;
+	}
+	if (! found)
+	{
+		if (keys >= KV_MAX_KEYS) return;
+		memmove(&kv_index[position + 1], &kv_index[position],
+			(keys - position)*sizeof(kv_entry_t));
+		keys++;
+		kv_index[position].key = key;
+	}
+	kv_index[position].length = length;
+	kv_index[position].address = address;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Append a record and index it, first moving the log to a new page if there
+is no room. With the old value counted the current data must fit in a page,
+so that it is still there if the new record is torn, leaving room for a
+delete. */
+
+static uint8_t store(uint16_t key, const uint8_t *data, uint16_t length)
+{
+	uint16_t position;
+	if (key == ERASED_KEY) return KV_INVALID;
+	bool found = find(key, &position);
+	uint32_t old = found ? RECORD_SIZE(kv_index[position].length) : 0;
+	uint32_t size = RECORD_SIZE(length);
+	if (length == 0)
+	{
+		if (! found) return KV_NOT_FOUND;
+	}
+	else
+	{
+		if ((! found) && (keys >= KV_MAX_KEYS)) return KV_FULL;
+		if (live + size + RECORD_SIZE(0) > CAPACITY) return KV_FULL;
+	}
+	uint8_t result = KV_OK;
+	flash_unlock();
+	if (head_offset + size > KV_PAGE_SIZE) result = compact();
+	if (result == KV_OK)
+	{
+		uint32_t address = page_address(head) + head_offset;
+		head_offset += size;
+		if (write_record(address, key, data, length))
+		{
+			index_set(key, length, address);
+			live = live - old + ((length > 0) ? size : 0);
+		}
+		else result = KV_FLASH_ERROR;
+	}
+	flash_lock();
+	return result;
+}
+
+/*--------------------------------------------------------------------------*/
+/* The first page after the head in the given state, or NO_PAGE. */
+
+static uint8_t next_page(uint8_t wanted)
+{
+	uint8_t i;
+	for (i = 1; i <= KV_PAGES; i++)
+	{
+		uint8_t page = (head == NO_PAGE) ? i - 1 : (head + i) % KV_PAGES;
+		if (state[page] == wanted) return page;
+	}
+	return NO_PAGE;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Copy the current records to the next erased page, erasing one first if none
+is ready, and make it the head. The index is moved over once the magic number
+is written. A failed page is left to be erased and the head is unchanged. */
+
+static uint8_t compact(void)
+{
+	uint32_t moved[KV_MAX_KEYS];
+	uint8_t page = next_page(PAGE_ERASED);
+	uint16_t i;
+	if (page == NO_PAGE)
+	{
+		page = next_page(PAGE_STALE);
+		if ((page == NO_PAGE) || ! erase(page)) return KV_FLASH_ERROR;
+	}
+	uint32_t address = page_address(page);
+	uint32_t sequence = head_sequence + 1;
+	uint32_t offset = HEADER_SIZE;
+	state[page] = PAGE_STALE;
+	bool ok = program(address, sequence & 0xFFFF) &&
+		  program(address + 2, sequence >> 16);
+	for (i = 0; ok && (i < keys); i++)
+	{
+		moved[i] = address + offset;
+		ok = write_record(moved[i], kv_index[i].key,
+				  (const uint8_t *) (kv_index[i].address + 4),
+				  kv_index[i].length);
+		offset += RECORD_SIZE(kv_index[i].length);
+	}
+	ok = ok && program(address + 4, PAGE_MAGIC & 0xFFFF) &&
+		   program(address + 6, PAGE_MAGIC >> 16);
+	if (! ok) return KV_FLASH_ERROR;
+	for (i = 0; i < keys; i++) kv_index[i].address = moved[i];
+	if (head != NO_PAGE) state[head] = PAGE_STALE;
+	state[page] = PAGE_LOG;
+	head = page;
+	head_sequence = sequence;
+	head_offset = offset;
+	return KV_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Erase a page and verify it. */
+
+static bool erase(uint8_t page)
+{
+	uint32_t address = page_address(page);
+	uint32_t offset;
+	flash_clear_status_flags();
+	flash_erase_page(address);
+	if (flash_get_status_flags() != FLASH_SR_EOP) return false;
+	for (offset = 0; offset < KV_PAGE_SIZE; offset += 4)
+		if (*(const uint32_t *) (address + offset) != 0xFFFFFFFF) return false;
+	state[page] = PAGE_ERASED;
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Program a halfword and verify it. */
+
+static bool program(uint32_t address, uint16_t data)
+{
+	flash_clear_status_flags();
+	flash_program_half_word(address, data);
+	if (flash_get_status_flags() != FLASH_SR_EOP) return false;
+	return (read_halfword(address) == data);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Write a record, the check last. */
+
+static bool write_record(uint32_t address, uint16_t key, const uint8_t *data,
+			 uint16_t length)
+{
+	uint32_t size = RECORD_SIZE(length);
+	uint16_t i;
+	bool ok = program(address, key) && program(address + 2, length);
+	for (i = 0; ok && (i < length); i += 2)
+	{
+		uint16_t halfword = data[i];
+		halfword |= (i + 1 < length) ? ((uint16_t) data[i + 1] << 8) : 0xFF00;
+		ok = program(address + 4 + i, halfword);
+	}
+	return ok && program(address + size - 2, record_check(key, length, data));
+}
@@ -0,0 +1,49 @@
+/*	Key Value Store in Flash
+
+Parameters kept as a log of records in KV_PAGES pages of the on-chip flash of
+the STM32F1, with an index in RAM, so that a value is saved by appending a
+record rather than by erasing a page.
+
+14 October 2026
+*/
+
+#ifndef KVSTORE_H
+#define KVSTORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Flash pages used, by default the top two of a 128K medium density device.
+High density devices have 2K pages. */
+#ifndef KV_PAGE_SIZE
+#define KV_PAGE_SIZE        1024
+#endif
+#ifndef KV_PAGES
+#define KV_PAGES            2
+#endif
+#ifndef KV_BASE
+#define KV_BASE             (0x08020000 - KV_PAGES*KV_PAGE_SIZE)
+#endif
+
+/* Keys held in the RAM index, and the longest value */
+#ifndef KV_MAX_KEYS
+#define KV_MAX_KEYS         32
+#endif
+#define KV_VALUE_MAX        128
+
+/* Results of the store operations */
+#define KV_OK               0
+#define KV_NOT_FOUND        1
+#define KV_FULL             2       /* too many keys, or too much data */
+#define KV_INVALID          3       /* key 0xFFFF, or length out of range */
+#define KV_FLASH_ERROR      4       /* a program or erase failed */
+
+uint8_t kv_init(void);
+const void *kv_find(uint16_t key, uint16_t *length);
+uint8_t kv_read(uint16_t key, void *data, uint16_t size, uint16_t *length);
+uint8_t kv_write(uint16_t key, const void *data, uint16_t length);
+uint8_t kv_delete(uint16_t key);
+bool kv_service(void);
+uint16_t kv_count(void);
+
+#endif
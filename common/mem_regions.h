@@ -0,0 +1,40 @@
+/*	Memory Region Placement
+
+Attributes placing variables in the core coupled memory and functions in RAM,
+for the sections of stm32-hf407.ld, and variables in RAM that is kept over a
+reset.
+
+CCM_DATA puts a variable in the 64K CCM of the STM32F4, which the core reads
+with no wait states and no contention with the DMA. The DMA cannot reach it,
+so buffers of the DMA stay in ordinary RAM, and it is neither loaded nor
+cleared at reset, so a variable placed there has no initialiser and is set up
+by the program. On the STM32F1, which has no CCM, it places nothing.
+
+RAMFUNC puts a function in RAM, copied from flash at reset with the
+initialised data, for handlers and inner loops that should not wait on the
+flash. The long call lets it be called from flash code anywhere. On the
+STM32F1 it goes to .data, which all the linker scripts of the examples copy.
+
+NOINIT puts a variable in RAM that the reset handler neither loads nor clears,
+so it keeps its value over any reset but a power on, for a record of why the
+last reset happened. On the STM32F4 it is in the CCM, and on the STM32F1 in a
+.noinit section after .bss, which the linker script must provide.
+
+15 October 2026
+*/
+
+#ifndef MEM_REGIONS_H
+#define MEM_REGIONS_H
+
+#ifdef STM32F4
+#define CCM_DATA    __attribute__((section(".ccm")))
+#define RAMFUNC     __attribute__((section(".ramfunc"), noinline, long_call))
+#define NOINIT      __attribute__((section(".ccm.noinit")))
+#else
+#define CCM_DATA
+#define RAMFUNC     __attribute__((section(".data.ramfunc"), noinline, \
+                                   long_call))
+#define NOINIT      __attribute__((section(".noinit")))
+#endif
+
+#endif
@@ -0,0 +1,111 @@
+/*	Fixed Block Memory Pools
+
+A pool hands out blocks of one size from an array declared with POOL_MEMORY,
+so the memory used for message buffers is fixed at link time and allocation
+cannot fragment or fail other than by the pool running out. The free blocks
+are kept in a singly linked list through their first word, so allocation and
+release take constant time and no memory beyond the blocks themselves. The
+list is updated with interrupts masked, so blocks may be taken in an ISR and
+released by a task, or the other way round.
+
+The fewest blocks ever free is recorded, so the pool can be sized from a run
+of the application.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/cm3/cortex.h>
+#include "pool.h"
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise a Pool
+
+@param[in] pool: pool to initialise.
+@param[in] memory: array declared with POOL_MEMORY for the same size and count.
+@param[in] block_size: bytes in each block, rounded up to whole words.
+@param[in] count: number of blocks.
+*/
+
+void pool_init(pool_t *pool, void *memory, uint16_t block_size, uint16_t count)
+{
+	uint32_t *block = memory;
+	uint16_t words = (block_size + 3) / 4;
+	uint16_t i;
+
+	if (words == 0) words = 1;
+	pool->block_size = words * 4;
+	pool->count = count;
+	pool->available = count;
+	pool->low_water = count;
+	pool->free = (count > 0) ? memory : 0;
+	for (i = 1; i < count; i++)
+	{
+		*(uint32_t **) block = block + words;
+		block += words;
+	}
+	if (count > 0) *(uint32_t **) block = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Take a Block from a Pool
+
+@param[in] pool: pool to take from.
+@returns the block, or 0 if none is free.
+*/
+
+void *pool_alloc(pool_t *pool)
+{
+	bool masked = cm_mask_interrupts(true);
+	void *block = pool->free;
+	if (block != 0)
+	{
+		pool->free = *(void **) block;
+		pool->available--;
+		if (pool->available < pool->low_water) pool->low_water = pool->available;
+	}
+	cm_mask_interrupts(masked);
+	return block;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Return a Block to its Pool
+
+@param[in] pool: pool the block was taken from.
+@param[in] block: block to return. A null pointer is ignored.
+*/
+
+void pool_free(pool_t *pool, void *block)
+{
+	if (block == 0) return;
+	bool masked = cm_mask_interrupts(true);
+	*(void **) block = pool->free;
+	pool->free = block;
+	pool->available++;
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Free Blocks in a Pool
+
+@param[in] pool: pool to check.
+@returns number of blocks free.
+*/
+
+uint16_t pool_available(pool_t *pool)
+{
+	return pool->available;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Fewest Free Blocks
+
+@param[in] pool: pool to check.
+@returns the fewest blocks that have been free since initialisation.
+*/
+
+uint16_t pool_low_water(pool_t *pool)
+{
+	return pool->low_water;
+}
@@ -0,0 +1,33 @@
+/*	Fixed Block Memory Pools
+
+Allocation of equal sized blocks from a statically declared array, in constant
+time and safe from interrupts.
+
+14 October 2026
+*/
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+
+typedef struct {
+	void *free;                 /* first free block, or 0 */
+	uint16_t block_size;
+	uint16_t count;
+	uint16_t available;
+	uint16_t low_water;         /* fewest blocks ever free */
+} pool_t;
+
+/* Memory for a pool of count blocks of size bytes, word aligned and rounded up
+to whole words. */
+#define POOL_MEMORY(name, size, count) \
+	uint32_t name[(count)*(((size)+3)/4)]
+
+void pool_init(pool_t *pool, void *memory, uint16_t block_size, uint16_t count);
+void *pool_alloc(pool_t *pool);
+void pool_free(pool_t *pool, void *block);
+uint16_t pool_available(pool_t *pool);
+uint16_t pool_low_water(pool_t *pool);
+
+#endif
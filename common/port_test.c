@@ -0,0 +1,482 @@
+/*	GPIO Port Integrity Test
+
+An automated check of the soldering of the GPIO pins of an LQFP64 part on the
+STAMP boards, for the STM32F1, STM32F4 and STM32L1. Each pattern is set with
+one BSRR write per port and read back with one IDR read per port, and the
+steps are timed by the DWT cycle counter rather than a loop of nops, so a
+whole board is checked in about a millisecond.
+
+All pins under test are first made inputs pulled down, and any reading high is
+stuck high, then all are pulled up and any reading low is stuck low. In the
+walking one test each pin in turn drives high while the others stay pulled
+down, and any other pin that reads high is joined to it, while the pin itself
+must read back high. The walking zero test does the same with a low drive
+against pull ups, catching joins that a weak pull masks. The checkerboard
+test then drives all pins at once, alternate pins in package order high and
+low and then the inverse, so that adjacent pins on the package fight and a
+bridge shows as a pin that reads back wrong. The drive lasts only the settling
+time of a few microseconds.
+
+A pin standing alone cannot be seen to be open. With a test fixture joining
+pairs of pins, given as links in the configuration, a link that is not seen
+in the walking tests is reported as open, and the joins it makes are not
+counted as shorts. The checkerboard test is left out when there are links,
+as it would drive the linked pins against each other.
+
+Shorts are given as pairs of pins with their package pin numbers, so that
+bridges between adjacent pins can be told from faults on the board.
+
+The benchmark times toggling a pin by BSRR writes, by read-modify-write of
+the ODR, by gpio_toggle and by bit-band writes to the ODR bit.
+
+Pins exercised must have no other driver attached. PA13 and PA14 carry the
+SWD debug link.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
+#include "port_test.h"
+#include "format.h"
+
+/* Bit-band alias of a bit in a peripheral register */
+#define PERIPH_BITBAND(address, bit) \
+	((volatile uint32_t *) (0x42000000 + \
+	 ((uint32_t) (address) - 0x40000000) * 32 + (bit) * 4))
+
+static const uint32_t ports[PORT_TEST_PORTS] = {GPIOA, GPIOB, GPIOC, GPIOD};
+
+/* LQFP64 package pin of each GPIO pin, zero where it has none. */
+static const uint8_t package_pin[PORT_TEST_PORTS*16] = {
+	14, 15, 16, 17, 20, 21, 22, 23, 41, 42, 43, 44, 45, 46, 49, 50,
+	26, 27, 28, 55, 56, 57, 58, 59, 61, 62, 29, 30, 33, 34, 35, 36,
+	 8,  9, 10, 11, 24, 25, 37, 38, 39, 40, 51, 52, 53,  2,  3,  4,
+	 5,  6, 54,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+static uint32_t settle_cycles;
+
+static void make_inputs(uint32_t port, uint16_t pins, bool pull_up);
+static void make_outputs(uint32_t port, uint16_t pins);
+static void settle(void);
+static void read_ports(uint16_t idr[]);
+static void walk(const port_test_config_t *config, port_test_result_t *result,
+                 bool high, bool linked[]);
+static void checkerboard(const port_test_config_t *config,
+                         port_test_result_t *result);
+static int link_index(const port_test_config_t *config, uint8_t a, uint8_t b);
+static void record_short(port_test_result_t *result, uint8_t a, uint8_t b);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Run the Port Test
+
+The GPIO clocks of the ports under test must be enabled. The pins are left as
+inputs pulled down.
+
+@param[in] config: pins to exercise and any fixture links.
+@param[out] result: map of the faults found.
+*/
+
+void port_test_run(const port_test_config_t *config,
+                   port_test_result_t *result)
+{
+	bool linked[256];
+	uint16_t idr[PORT_TEST_PORTS];
+	uint8_t i;
+
+	dwt_enable_cycle_counter();
+	settle_cycles = rcc_ahb_frequency / 1000000 * PORT_TEST_SETTLE_US;
+	for (i = 0; i < PORT_TEST_PORTS; i++)
+	{
+		result->stuck_high[i] = 0;
+		result->stuck_low[i] = 0;
+		result->no_drive[i] = 0;
+		result->checker[i] = 0;
+		result->open[i] = 0;
+	}
+	result->short_count = 0;
+	for (i = 0; i < config->link_count; i++) linked[i] = false;
+
+/* Pins that do not follow their pulls */
+	for (i = 0; i < PORT_TEST_PORTS; i++)
+		make_inputs(ports[i], config->pins[i], false);
+	settle();
+	read_ports(idr);
+	for (i = 0; i < PORT_TEST_PORTS; i++)
+		result->stuck_high[i] = idr[i] & config->pins[i];
+	for (i = 0; i < PORT_TEST_PORTS; i++)
+		make_inputs(ports[i], config->pins[i], true);
+	settle();
+	read_ports(idr);
+	for (i = 0; i < PORT_TEST_PORTS; i++)
+		result->stuck_low[i] = ~idr[i] & config->pins[i];
+
+	walk(config, result, false, linked);
+	for (i = 0; i < PORT_TEST_PORTS; i++)
+		make_inputs(ports[i], config->pins[i], false);
+	walk(config, result, true, linked);
+	if (config->link_count == 0) checkerboard(config, result);
+
+	for (i = 0; i < config->link_count; i++)
+	{
+		if (linked[i]) continue;
+		uint8_t a = config->links[i][0];
+		uint8_t b = config->links[i][1];
+		result->open[a >> 4] |= 1 << (a & 15);
+		result->open[b >> 4] |= 1 << (b & 15);
+	}
+	result->pass = (result->short_count == 0);
+	for (i = 0; i < PORT_TEST_PORTS; i++)
+	{
+		if (result->stuck_high[i] | result->stuck_low[i] |
+		    result->no_drive[i] | result->checker[i] | result->open[i])
+			result->pass = false;
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Time the Ways of Toggling a Pin
+
+The pin is made a push-pull output and toggled PORT_TEST_TOGGLES times by
+each method with interrupts masked. Each loop makes two toggles a pass so
+that the loop itself costs the same in all.
+
+@param[in] pin: pin as PORT_TEST_PIN(port, bit).
+@param[out] rate: cycles taken by each method.
+*/
+
+void port_test_benchmark(uint8_t pin, port_test_rate_t *rate)
+{
+	uint32_t port = ports[pin >> 4];
+	uint16_t bit = 1 << (pin & 15);
+	volatile uint32_t *band = PERIPH_BITBAND(&GPIO_ODR(port), pin & 15);
+	uint32_t start;
+	uint32_t i;
+
+	dwt_enable_cycle_counter();
+	GPIO_BSRR(port) = (uint32_t) bit << 16;
+	make_outputs(port, bit);
+	bool masked = cm_mask_interrupts(true);
+
+	start = DWT_CYCCNT;
+	for (i = 0; i < PORT_TEST_TOGGLES/2; i++)
+	{
+		GPIO_BSRR(port) = bit;
+		GPIO_BSRR(port) = (uint32_t) bit << 16;
+	}
+	rate->bsrr = DWT_CYCCNT - start;
+
+	start = DWT_CYCCNT;
+	for (i = 0; i < PORT_TEST_TOGGLES/2; i++)
+	{
+		GPIO_ODR(port) ^= bit;
+		GPIO_ODR(port) ^= bit;
+	}
+	rate->odr = DWT_CYCCNT - start;
+
+	start = DWT_CYCCNT;
+	for (i = 0; i < PORT_TEST_TOGGLES/2; i++)
+	{
+		gpio_toggle(port, bit);
+		gpio_toggle(port, bit);
+	}
+	rate->toggle = DWT_CYCCNT - start;
+
+	start = DWT_CYCCNT;
+	for (i = 0; i < PORT_TEST_TOGGLES/2; i++)
+	{
+		*band = 1;
+		*band = 0;
+	}
+	rate->bitband = DWT_CYCCNT - start;
+
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief LQFP64 Package Pin
+
+@param[in] pin: pin as PORT_TEST_PIN(port, bit).
+@returns package pin number, or zero if it is not brought out.
+*/
+
+uint8_t port_test_package_pin(uint8_t pin)
+{
+	if (pin >= PORT_TEST_PORTS*16) return 0;
+	return package_pin[pin];
+}
+
+/*--------------------------------------------------------------------------*/
+/* Write a pin as its name and package pin, as PA0(14). */
+
+static uint32_t format_pin(char *out, uint32_t size, uint8_t pin)
+{
+	return format_string(out, size, " P%c%u(%u)", 'A' + (pin >> 4),
+	                     pin & 15, package_pin[pin]);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Write a line of the pins set in a map, or nothing if there are none. */
+
+static uint32_t format_map(char *out, uint32_t size, const char *label,
+                           const uint16_t map[])
+{
+	uint32_t n = 0;
+	uint8_t pin;
+	for (pin = 0; pin < PORT_TEST_PORTS*16; pin++)
+	{
+		if ((map[pin >> 4] & (1 << (pin & 15))) == 0) continue;
+		if (n == 0) n += format_string(out, size, "%s:", label);
+		n += format_pin(out + n, size - n, pin);
+	}
+	if (n > 0) n += format_string(out + n, size - n, "\r\n");
+	return n;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write the Fault Map
+
+A line is given for each kind of fault found, then each short with those
+between adjacent package pins marked.
+
+@param[out] out: string for the map.
+@param[in] size: size of the string including its terminator.
+@param[in] result: map from port_test_run.
+@returns characters written.
+*/
+
+uint32_t port_test_format(char *out, uint32_t size,
+                          const port_test_result_t *result)
+{
+	uint32_t n;
+	uint8_t i;
+
+	n = format_string(out, size, "Port test %s\r\n",
+	                  result->pass ? "pass" : "FAIL");
+	n += format_map(out + n, size - n, "stuck high", result->stuck_high);
+	n += format_map(out + n, size - n, "stuck low", result->stuck_low);
+	n += format_map(out + n, size - n, "no drive", result->no_drive);
+	n += format_map(out + n, size - n, "checkerboard", result->checker);
+	n += format_map(out + n, size - n, "open", result->open);
+	for (i = 0; i < result->short_count && i < PORT_TEST_MAX_SHORTS; i++)
+	{
+		uint8_t a = package_pin[result->shorts[i][0]];
+		uint8_t b = package_pin[result->shorts[i][1]];
+		bool adjacent = (a != 0) && (b != 0) && ((a == b + 1) || (b == a + 1));
+		n += format_string(out + n, size - n, "short");
+		n += format_pin(out + n, size - n, result->shorts[i][0]);
+		n += format_pin(out + n, size - n, result->shorts[i][1]);
+		n += format_string(out + n, size - n, "%s\r\n",
+		                   adjacent ? " adjacent" : "");
+	}
+	if (result->short_count > PORT_TEST_MAX_SHORTS)
+		n += format_string(out + n, size - n, "%u shorts\r\n",
+		                   result->short_count);
+	return n;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write the Benchmark Results
+
+Each method is given in cycles per toggle to two places and as a toggle rate.
+
+@param[out] out: string for the results.
+@param[in] size: size of the string including its terminator.
+@param[in] rate: cycles from port_test_benchmark.
+@returns characters written.
+*/
+
+uint32_t port_test_format_rate(char *out, uint32_t size,
+                               const port_test_rate_t *rate)
+{
+	static const char *names[4] = {"BSRR", "ODR", "gpio_toggle", "bit-band"};
+	uint32_t cycles[4] = {rate->bsrr, rate->odr, rate->toggle, rate->bitband};
+	uint32_t n = 0;
+	uint8_t i;
+
+	for (i = 0; i < 4; i++)
+	{
+		uint32_t hundredths = cycles[i] * 100 / PORT_TEST_TOGGLES;
+		uint32_t khz = 0;
+		if (cycles[i] > 0)
+			khz = (uint32_t) ((uint64_t) rcc_ahb_frequency *
+			                  PORT_TEST_TOGGLES / cycles[i] / 1000);
+		n += format_string(out + n, size - n,
+		                   "%-12s %4u.%02u cycles %6ukHz\r\n", names[i],
+		                   hundredths / 100, hundredths % 100, khz);
+	}
+	return n;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Make pins inputs pulled up or down. On the STM32F1 the pull is chosen by
+the output data register. */
+
+static void make_inputs(uint32_t port, uint16_t pins, bool pull_up)
+{
+	if (pins == 0) return;
+#if defined(STM32F1)
+	gpio_set_mode(port, GPIO_MODE_INPUT, GPIO_CNF_INPUT_PULL_UPDOWN, pins);
+	GPIO_BSRR(port) = pull_up ? pins : (uint32_t) pins << 16;
+#else
+	gpio_mode_setup(port, GPIO_MODE_INPUT,
+	                pull_up ? GPIO_PUPD_PULLUP : GPIO_PUPD_PULLDOWN, pins);
+#endif
+}
+
+/*--------------------------------------------------------------------------*/
+/* Make pins push-pull outputs at the levels already in the output data
+register. */
+
+static void make_outputs(uint32_t port, uint16_t pins)
+{
+	if (pins == 0) return;
+#if defined(STM32F1)
+	gpio_set_mode(port, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_PUSHPULL,
+	              pins);
+#else
+	gpio_mode_setup(port, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE, pins);
+#endif
+}
+
+/*--------------------------------------------------------------------------*/
+/* Wait for the pins to settle after a change. */
+
+static void settle(void)
+{
+	uint32_t start = DWT_CYCCNT;
+	while ((DWT_CYCCNT - start) < settle_cycles);
+}
+
+static void read_ports(uint16_t idr[])
+{
+	uint8_t i;
+	for (i = 0; i < PORT_TEST_PORTS; i++) idr[i] = (uint16_t) GPIO_IDR(ports[i]);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Drive each pin in turn against the pulls of the rest, which are pulled the
+other way already, and note the pins that follow it. Stuck pins are passed
+over, as they would show as joined to every other. */
+
+static void walk(const port_test_config_t *config, port_test_result_t *result,
+                 bool high, bool linked[])
+{
+	uint16_t idr[PORT_TEST_PORTS];
+	uint16_t usable[PORT_TEST_PORTS];
+	uint8_t i, j;
+	uint8_t pin;
+
+	for (i = 0; i < PORT_TEST_PORTS; i++)
+		usable[i] = config->pins[i] & ~(result->stuck_high[i] |
+		                                result->stuck_low[i]);
+	for (pin = 0; pin < PORT_TEST_PORTS*16; pin++)
+	{
+		uint32_t port = ports[pin >> 4];
+		uint16_t bit = 1 << (pin & 15);
+		if ((usable[pin >> 4] & bit) == 0) continue;
+		GPIO_BSRR(port) = high ? bit : (uint32_t) bit << 16;
+		make_outputs(port, bit);
+		settle();
+		read_ports(idr);
+		make_inputs(port, bit, ! high);
+/* Pins at the driven level */
+		if (! high)
+			for (i = 0; i < PORT_TEST_PORTS; i++) idr[i] = ~idr[i];
+		if ((idr[pin >> 4] & bit) == 0) result->no_drive[pin >> 4] |= bit;
+		idr[pin >> 4] &= ~bit;
+		for (i = 0; i < PORT_TEST_PORTS; i++)
+		{
+			uint16_t joined = idr[i] & usable[i];
+			for (j = 0; joined != 0; j++, joined >>= 1)
+			{
+				if ((joined & 1) == 0) continue;
+				int link = link_index(config, pin, PORT_TEST_PIN(i, j));
+				if (link >= 0) linked[link] = true;
+				else record_short(result, pin, PORT_TEST_PIN(i, j));
+			}
+		}
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/* Drive alternate package pins high and low, then the inverse, and note the
+pins that read back wrong. */
+
+static void checkerboard(const port_test_config_t *config,
+                         port_test_result_t *result)
+{
+	uint16_t pattern[PORT_TEST_PORTS] = {0};
+	uint16_t idr[PORT_TEST_PORTS];
+	uint8_t i;
+	uint8_t pin;
+	uint8_t pass;
+
+	for (pin = 0; pin < PORT_TEST_PORTS*16; pin++)
+	{
+		uint8_t number = package_pin[pin] ? package_pin[pin] : pin;
+		if (number & 1) pattern[pin >> 4] |= 1 << (pin & 15);
+	}
+	for (pass = 0; pass < 2; pass++)
+	{
+		for (i = 0; i < PORT_TEST_PORTS; i++)
+		{
+			uint16_t pins = config->pins[i];
+			GPIO_BSRR(ports[i]) = (pattern[i] & pins) |
+			                      ((uint32_t) (~pattern[i] & pins) << 16);
+			make_outputs(ports[i], pins);
+		}
+		settle();
+		read_ports(idr);
+		for (i = 0; i < PORT_TEST_PORTS; i++)
+		{
+			result->checker[i] |= (idr[i] ^ pattern[i]) & config->pins[i];
+			pattern[i] = ~pattern[i];
+		}
+	}
+	for (i = 0; i < PORT_TEST_PORTS; i++)
+		make_inputs(ports[i], config->pins[i], false);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Find the fixture link joining two pins. */
+
+static int link_index(const port_test_config_t *config, uint8_t a, uint8_t b)
+{
+	uint8_t i;
+	for (i = 0; i < config->link_count; i++)
+	{
+		if (((config->links[i][0] == a) && (config->links[i][1] == b)) ||
+		    ((config->links[i][0] == b) && (config->links[i][1] == a)))
+			return i;
+	}
+	return -1;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Add a short to the map unless it has been seen from the other pin or in
+the other walk. Beyond those the map holds, shorts are only counted. */
+
+static void record_short(port_test_result_t *result, uint8_t a, uint8_t b)
+{
+	uint8_t i;
+	if (a > b)
+	{
+		uint8_t t = a;
+		a = b;
+		b = t;
+	}
+	for (i = 0; i < result->short_count && i < PORT_TEST_MAX_SHORTS; i++)
+		if ((result->shorts[i][0] == a) && (result->shorts[i][1] == b)) return;
+	if (result->short_count < PORT_TEST_MAX_SHORTS)
+	{
+		result->shorts[result->short_count][0] = a;
+		result->shorts[result->short_count][1] = b;
+	}
+	if (result->short_count < 255) result->short_count++;
+}
@@ -0,0 +1,68 @@
+/*	GPIO Port Integrity Test
+
+Walking one, walking zero and checkerboard tests of the GPIO pins of an
+LQFP64 part, with whole port reads, giving a map of stuck pins, shorts and
+missing fixture links, and a benchmark of the ways of toggling a pin.
+
+15 October 2026
+*/
+
+#ifndef PORT_TEST_H
+#define PORT_TEST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Ports A to D */
+#define PORT_TEST_PORTS         4
+
+/* Pins are numbered port*16 + bit, so PA0 is 0 and PD2 is 50 */
+#define PORT_TEST_PIN(port, bit)    ((uint8_t) ((port)*16 + (bit)))
+
+/* Shorts recorded in the map */
+#ifndef PORT_TEST_MAX_SHORTS
+#define PORT_TEST_MAX_SHORTS    16
+#endif
+
+/* Time for a pin to follow its pull up or down after a change */
+#ifndef PORT_TEST_SETTLE_US
+#define PORT_TEST_SETTLE_US     5
+#endif
+
+/* Toggles timed for each method of the benchmark */
+#define PORT_TEST_TOGGLES       1000
+
+typedef struct {
+	uint16_t pins[PORT_TEST_PORTS];     /* pins of each port to exercise */
+	const uint8_t (*links)[2];          /* pairs joined by a test fixture */
+	uint8_t link_count;
+} port_test_config_t;
+
+typedef struct {
+	uint16_t stuck_high[PORT_TEST_PORTS];   /* high with all pulled down */
+	uint16_t stuck_low[PORT_TEST_PORTS];    /* low with all pulled up */
+	uint16_t no_drive[PORT_TEST_PORTS];     /* did not follow its own output */
+	uint16_t checker[PORT_TEST_PORTS];      /* wrong in a checkerboard */
+	uint16_t open[PORT_TEST_PORTS];         /* fixture link not seen */
+	uint8_t short_count;                    /* may exceed those recorded */
+	uint8_t shorts[PORT_TEST_MAX_SHORTS][2];
+	bool pass;
+} port_test_result_t;
+
+typedef struct {
+	uint32_t bsrr;              /* cycles for PORT_TEST_TOGGLES of each */
+	uint32_t odr;
+	uint32_t toggle;
+	uint32_t bitband;
+} port_test_rate_t;
+
+void port_test_run(const port_test_config_t *config,
+                   port_test_result_t *result);
+void port_test_benchmark(uint8_t pin, port_test_rate_t *rate);
+uint8_t port_test_package_pin(uint8_t pin);
+uint32_t port_test_format(char *out, uint32_t size,
+                          const port_test_result_t *result);
+uint32_t port_test_format_rate(char *out, uint32_t size,
+                               const port_test_rate_t *rate);
+
+#endif
@@ -0,0 +1,186 @@
+/*	Low Power Modes
+
+Entry to stop mode on the STM32F1 with the serial output drained first and the
+clock tree restored on wakeup.
+
+Before stopping, the send buffer of serial.c is drained by sleeping until the
+DMA has finished and the USART transmission complete flag is set. Stop mode is
+then entered as soon as the last bit has left the pin, rather than after a
+fixed delay that is either too long or too short.
+
+In stop mode all clocks other than the LSI and LSE are halted and the system
+wakes on the HSI. The HSE, PLL and system clock selection in use on entry are
+restored from the saved RCC registers before returning. The PLL configuration,
+prescalers and flash wait states are kept through stop mode so they need not
+be set again. Peripherals clocked from the LSE, such as the RTC, are left to
+the application.
+
+Restarting the HSE and locking the PLL takes a millisecond or more of each
+wakeup, at full power. power_stop_deferred returns at once on the HSI at 8MHz,
+so that urgent work is done within microseconds of the wakeup, and only sets
+the HSE starting. power_clock_resume then finishes the switch back when the
+full clock is wanted, by which time the HSE has usually settled, and a wakeup
+that needs no more than the HSI goes back into stop without it. While on the
+HSI the bus clocks are a ninth of their usual rate, so the serial.c output and
+anything else timed from them must wait for power_clock_resume.
+
+Built with POWER_STATS each stop is recorded by power_stats.c, the wfi being
+made with interrupts masked so that the wakeup source is seen before its
+interrupt is taken.
+
+serial.c must be linked in and serial_tx_init called before use.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/scb.h>
+#include <libopencm3/stm32/exti.h>
+#include <libopencm3/stm32/pwr.h>
+#include <libopencm3/stm32/rcc.h>
+#include "power.h"
+#include "power_stats.h"
+#include "serial.h"
+
+/* System clock switch and switch status fields of RCC_CFGR */
+#define RCC_CFGR_SW_BITS	(3 << RCC_CFGR_SW_SHIFT)
+#define RCC_CFGR_SWS_BITS	(3 << RCC_CFGR_SWS_SHIFT)
+
+/* All EXTI lines of the STM32F1 */
+#define EXTI_ALL_LINES		0xFFFFF
+
+/* Clock configuration to resume after power_stop_deferred */
+static uint32_t saved_cr;
+static uint32_t saved_cfgr;
+static bool deferred = false;
+
+static void stop(void);
+static void clock_restore(uint32_t cr, uint32_t cfgr);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Enter Stop Mode
+
+Wait for the serial output to finish, then stop with the voltage regulator in
+low power mode until an EXTI line (including the RTC alarm on EXTI 17) wakes
+the processor. The clocks are restored before returning.
+*/
+
+void power_stop(void)
+{
+	serial_tx_flush();
+	power_stop_enter();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Enter Stop Mode at Once
+
+As power_stop but without waiting for the serial output, for callers that have
+checked it has finished. This may be called with interrupts masked, as in an
+RTOS idle hook, and the wakeup interrupt is then taken once they are unmasked.
+*/
+
+void power_stop_enter(void)
+{
+	uint32_t cr;
+	uint32_t cfgr;
+
+	cr = RCC_CR;
+	cfgr = RCC_CFGR;
+	stop();
+	clock_restore(cr, cfgr);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Enter Stop Mode and Wake on the HSI
+
+As power_stop, but return running on the HSI with the HSE started if it was in
+use. The clock configuration of the first entry is kept through further stops
+until power_clock_resume restores it. This may be called with interrupts
+masked once the serial output has been flushed, so that a wakeup source seen
+just before is not lost, and the wakeup interrupt is then taken once they are
+unmasked.
+*/
+
+void power_stop_deferred(void)
+{
+	serial_tx_flush();
+	if (! deferred)
+	{
+		saved_cr = RCC_CR;
+		saved_cfgr = RCC_CFGR;
+	}
+	stop();
+	deferred = true;
+	if (saved_cr & RCC_CR_HSEON) RCC_CR |= RCC_CR_HSEON;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Restore the Full Clock
+
+Complete the switch back to the clock in use before power_stop_deferred.
+Nothing is done if the clock has already been restored.
+*/
+
+void power_clock_resume(void)
+{
+	if (! deferred) return;
+	clock_restore(saved_cr, saved_cfgr);
+	deferred = false;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check for a Deferred Clock
+
+@returns true while running on the HSI after power_stop_deferred.
+*/
+
+bool power_clock_deferred(void)
+{
+	return deferred;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Stop with the regulator in low power until an EXTI line wakes the
+processor, which then runs on the HSI. */
+
+static void stop(void)
+{
+	pwr_voltage_regulator_low_power_in_stop();
+/* Don't set complete power down (else it goes to standby) */
+	pwr_set_stop_mode();
+/* Clear any pending EXTI requests, which would prevent stop being entered */
+	exti_reset_request(EXTI_ALL_LINES);
+/* A pending interrupt still wakes the processor while masked */
+	bool masked = cm_mask_interrupts(true);
+	POWER_STATS_ENTER(POWER_STATE_STOP);
+	SCB_SCR |= SCB_SCR_SLEEPDEEP;
+	__asm__ __volatile__ ("wfi");
+/* Clear deep sleep so that other wfi use gives ordinary sleep */
+	SCB_SCR &= ~SCB_SCR_SLEEPDEEP;
+	POWER_STATS_EXIT();
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Restart the HSE and PLL if they were running and switch the system clock
+back to the source it had before stop. */
+
+static void clock_restore(uint32_t cr, uint32_t cfgr)
+{
+	if (cr & RCC_CR_HSEON)
+	{
+		RCC_CR |= RCC_CR_HSEON;
+		while ((RCC_CR & RCC_CR_HSERDY) == 0);
+	}
+	if (cr & RCC_CR_PLLON)
+	{
+		RCC_CR |= RCC_CR_PLLON;
+		while ((RCC_CR & RCC_CR_PLLRDY) == 0);
+	}
+	RCC_CFGR = (RCC_CFGR & ~RCC_CFGR_SW_BITS) | (cfgr & RCC_CFGR_SW_BITS);
+	while (((RCC_CFGR & RCC_CFGR_SWS_BITS) >> RCC_CFGR_SWS_SHIFT)
+			!= ((cfgr & RCC_CFGR_SW_BITS) >> RCC_CFGR_SW_SHIFT));
+	POWER_STATS_CLOCK(rcc_ahb_frequency);
+}
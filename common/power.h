@@ -0,0 +1,20 @@
+/*	Low Power Modes
+
+Entry to stop mode on the STM32F1 with the serial output drained first and the
+clock tree restored on wakeup, at once or when wanted.
+
+14 October 2026
+*/
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdbool.h>
+
+void power_stop(void);
+void power_stop_enter(void);
+void power_stop_deferred(void);
+void power_clock_resume(void);
+bool power_clock_deferred(void);
+
+#endif
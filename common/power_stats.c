@@ -0,0 +1,261 @@
+/*	Power State Accounting
+
+Residency in the run, sleep and stop states and the number of wakeups from
+each source, to measure what a power saving change achieves on the board.
+
+The sleep and stop paths call power_stats_enter just before their wfi and
+power_stats_exit just after it, with interrupts masked so that the interrupt
+which woke the processor is still pending when the exit is recorded. Its
+source is found from the EXTI pending register and the NVIC pending bits.
+power.c does this for stop mode when built with POWER_STATS, through the
+hooks in power_stats.h, and a main loop sleeping with its own wfi adds them
+around it.
+
+Time running and sleeping is measured with the DWT cycle counter, which runs
+in sleep but halts with the clocks in stop. Time stopped is taken from the RTC
+counter and its prescaler divider, a resolution of one LSE cycle, so the RTC
+must be running at POWER_STATS_RTC_HZ. After stop its registers are read
+only once they have been resynchronised with the bus, which takes up to two
+LSE cycles that are counted as stopped.
+
+The cycles are converted to microseconds at the clock they were counted at.
+The processor wakes from stop on the HSI, and power.c reports the switch back
+to the full clock with power_stats_clock, as must anything else that changes
+the system clock. The counter wraps after 59 seconds at 72MHz, so the state
+must change or power_stats_read be called at least that often.
+
+power_stats_format writes a summary to a string for the serial output or a
+telemetry text record.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/exti.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/rtc.h>
+#include "power_stats.h"
+#include "format.h"
+
+/* The processor wakes from stop on the HSI */
+#define HSI_MHZ             8
+
+/* EXTI lines taken as external pins rather than internal events */
+#define EXTI_PIN_LINES      0xFFFF
+
+static power_stats_t totals;
+
+/* Cycles of each state not yet a whole microsecond */
+static uint32_t carry[POWER_STATES];
+
+static power_state_t state;
+static uint32_t mhz;
+static uint32_t mark_cycles;
+static uint32_t mark_rtc;
+
+static void account(power_state_t counted);
+static uint32_t rtc_ticks(void);
+static power_wake_t wake_source(void);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start Accounting
+
+The DWT cycle counter is enabled and the totals cleared, counting from now as
+running at the present system clock. The RTC must already be running.
+*/
+
+void power_stats_init(void)
+{
+	dwt_enable_cycle_counter();
+	mhz = rcc_ahb_frequency / 1000000;
+	state = POWER_STATE_RUN;
+	power_stats_clear();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Clear the Totals
+
+Accounting restarts from now, in the run state.
+*/
+
+void power_stats_clear(void)
+{
+	bool masked = cm_mask_interrupts(true);
+	uint8_t i;
+	for (i = 0; i < POWER_STATES; i++)
+	{
+		totals.us[i] = 0;
+		totals.entries[i] = 0;
+		carry[i] = 0;
+	}
+	for (i = 0; i < POWER_WAKE_SOURCES; i++) totals.wakes[i] = 0;
+	mark_cycles = DWT_CYCCNT;
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Record Entry to Sleep or Stop
+
+Called with interrupts masked just before the wfi. The time running since the
+last change is added to the run total.
+
+@param[in] next: POWER_STATE_SLEEP or POWER_STATE_STOP.
+*/
+
+void power_stats_enter(power_state_t next)
+{
+	account(POWER_STATE_RUN);
+	if (next == POWER_STATE_STOP) mark_rtc = rtc_ticks();
+	totals.entries[next]++;
+	state = next;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Record the Wakeup
+
+Called with interrupts still masked just after the wfi. The time asleep is
+added to its state and the wakeup counted against the interrupt pending.
+*/
+
+void power_stats_exit(void)
+{
+	if (state == POWER_STATE_STOP)
+	{
+		RTC_CRL &= ~RTC_CRL_RSF;
+		while ((RTC_CRL & RTC_CRL_RSF) == 0);
+		uint32_t ticks = rtc_ticks() - mark_rtc;
+		totals.us[POWER_STATE_STOP] +=
+			(uint64_t) ticks * 1000000 / POWER_STATS_RTC_HZ;
+		mhz = HSI_MHZ;
+		mark_cycles = DWT_CYCCNT;
+	}
+	else if (state == POWER_STATE_SLEEP) account(POWER_STATE_SLEEP);
+	totals.wakes[wake_source()]++;
+	state = POWER_STATE_RUN;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Record a Change of System Clock
+
+The time since the last change is counted at the old clock.
+
+@param[in] hz: new AHB clock frequency.
+*/
+
+void power_stats_clock(uint32_t hz)
+{
+	bool masked = cm_mask_interrupts(true);
+	account(state);
+	mhz = hz / 1000000;
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Read the Totals
+
+The run total includes the time up to the call.
+
+@param[out] stats: copy of the totals.
+*/
+
+void power_stats_read(power_stats_t *stats)
+{
+	bool masked = cm_mask_interrupts(true);
+	account(state);
+	*stats = totals;
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write a Summary
+
+Each state is given with its entries, its total time in milliseconds and its
+share of the whole in tenths of a percent, followed by the wakeup counts.
+
+@param[out] out: string for the summary.
+@param[in] size: size of the string including its terminator.
+@returns characters written.
+*/
+
+uint32_t power_stats_format(char *out, uint32_t size)
+{
+	static const char *state_names[POWER_STATES] = {"run", "sleep", "stop"};
+	power_stats_t stats;
+	uint64_t whole = 0;
+	uint32_t n = 0;
+	uint8_t i;
+
+	power_stats_read(&stats);
+	for (i = 0; i < POWER_STATES; i++) whole += stats.us[i];
+	if (whole == 0) whole = 1;
+	for (i = 0; i < POWER_STATES; i++)
+	{
+		uint32_t share = (uint32_t) (stats.us[i] * 1000 / whole);
+		n += format_string(out + n, size - n, "%-5s %6u %10ums %3u.%u%%\r\n",
+				   state_names[i], stats.entries[i],
+				   (uint32_t) (stats.us[i] / 1000),
+				   share / 10, share % 10);
+	}
+	n += format_string(out + n, size - n,
+			   "wakes EXTI0 %u EXTI %u RTC %u USART %u other %u\r\n",
+			   stats.wakes[POWER_WAKE_EXTI0], stats.wakes[POWER_WAKE_EXTI],
+			   stats.wakes[POWER_WAKE_RTC_ALARM],
+			   stats.wakes[POWER_WAKE_USART], stats.wakes[POWER_WAKE_OTHER]);
+	return n;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Add the cycles since the last mark to a state at the present clock, keeping
+the fraction of a microsecond for next time. */
+
+static void account(power_state_t counted)
+{
+	uint32_t now = DWT_CYCCNT;
+	uint64_t cycles = (uint64_t) (now - mark_cycles) + carry[counted];
+	mark_cycles = now;
+	totals.us[counted] += (uint32_t) (cycles / mhz);
+	carry[counted] = (uint32_t) (cycles % mhz);
+}
+
+/*--------------------------------------------------------------------------*/
+/* RTC time in LSE cycles from the counter and the divider, which counts down
+through each second. The counter is read again after the divider so that a
+reload between them is not missed. The result wraps, which differences
+allow for. */
+
+static uint32_t rtc_ticks(void)
+{
+	uint16_t high;
+	uint16_t low;
+	uint16_t divider;
+	do
+	{
+		high = RTC_CNTH;
+		low = RTC_CNTL;
+		divider = RTC_DIVL;
+	}
+	while ((low != RTC_CNTL) || (high != RTC_CNTH));
+	uint32_t seconds = ((uint32_t) high << 16) | low;
+	return seconds * POWER_STATS_RTC_HZ + (POWER_STATS_RTC_HZ - 1 - divider);
+}
+
+/*--------------------------------------------------------------------------*/
+/* The interrupt that ended the wfi, still pending as interrupts are masked.
+In stop mode only an EXTI line can have woken the processor. */
+
+static power_wake_t wake_source(void)
+{
+	uint32_t pending = EXTI_PR;
+	if (pending & EXTI17) return POWER_WAKE_RTC_ALARM;
+	if (pending & EXTI0) return POWER_WAKE_EXTI0;
+	if (pending & EXTI_PIN_LINES) return POWER_WAKE_EXTI;
+	if (nvic_get_pending_irq(NVIC_USART1_IRQ) ||
+	    nvic_get_pending_irq(NVIC_DMA1_CHANNEL4_IRQ) ||
+	    nvic_get_pending_irq(NVIC_DMA1_CHANNEL5_IRQ))
+		return POWER_WAKE_USART;
+	return POWER_WAKE_OTHER;
+}
@@ -0,0 +1,62 @@
+/*	Power State Accounting
+
+Time spent running, sleeping and stopped, and the wakeups counted by source,
+from the DWT cycle counter and the RTC.
+
+15 October 2026
+*/
+
+#ifndef POWER_STATS_H
+#define POWER_STATS_H
+
+#include <stdint.h>
+
+/* RTC count rate, set by the prescaler of whichever module owns the RTC:
+32768Hz for rtc_alarm.c. Build with 1024 for rtos_tickless.c. */
+#ifndef POWER_STATS_RTC_HZ
+#define POWER_STATS_RTC_HZ      32768
+#endif
+
+typedef enum {
+	POWER_STATE_RUN,
+	POWER_STATE_SLEEP,
+	POWER_STATE_STOP,
+	POWER_STATES
+} power_state_t;
+
+typedef enum {
+	POWER_WAKE_EXTI0,
+	POWER_WAKE_EXTI,            /* EXTI lines 1 to 15 */
+	POWER_WAKE_RTC_ALARM,
+	POWER_WAKE_USART,           /* USART1 or its DMA channels */
+	POWER_WAKE_OTHER,
+	POWER_WAKE_SOURCES
+} power_wake_t;
+
+typedef struct {
+	uint64_t us[POWER_STATES];          /* residency in microseconds */
+	uint32_t entries[POWER_STATES];
+	uint32_t wakes[POWER_WAKE_SOURCES];
+} power_stats_t;
+
+void power_stats_init(void);
+void power_stats_clear(void);
+void power_stats_enter(power_state_t state);
+void power_stats_exit(void);
+void power_stats_clock(uint32_t hz);
+void power_stats_read(power_stats_t *stats);
+uint32_t power_stats_format(char *out, uint32_t size);
+
+/* Hooks in the sleep and stop paths, which vanish unless built with
+POWER_STATS=1. */
+#ifdef POWER_STATS
+#define POWER_STATS_ENTER(state)    power_stats_enter(state)
+#define POWER_STATS_EXIT()          power_stats_exit()
+#define POWER_STATS_CLOCK(hz)       power_stats_clock(hz)
+#else
+#define POWER_STATS_ENTER(state)    ((void) 0)
+#define POWER_STATS_EXIT()          ((void) 0)
+#define POWER_STATS_CLOCK(hz)       ((void) 0)
+#endif
+
+#endif
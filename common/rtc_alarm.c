@@ -0,0 +1,225 @@
+/*	RTC Alarm Scheduler
+
+The RTC of the STM32F1 has one alarm, on EXTI 17, which is the only timer
+able to wake the processor from stop mode. Here any number of alarms share it.
+The RTC counts seconds from the LSE and runs free, so it is never reset and an
+alarm is held as the count it goes off at. The alarms are kept in a list
+sorted by that count, and the RTC alarm is set for the first of them, so the
+processor only wakes when an alarm is due.
+
+The alarm interrupt only clears its EXTI line, which wakes the processor. The
+main loop calls rtc_alarm_dispatch on each wakeup and before each stop, and
+this calls the callbacks of the alarms due and sets the RTC alarm for the next.
+The callbacks thus run in the main loop, and may start and stop alarms. They
+may run before the full clock has been restored by power.c, and should then
+leave out anything needing it. A periodic alarm is restarted from its expiry
+so it does not drift. The alarms must not be started or stopped from an
+interrupt.
+
+After stop mode the RTC registers are read only once they have been
+resynchronised with the bus, which takes up to two LSE cycles.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/exti.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/rtc.h>
+#include "rtc_alarm.h"
+
+/* Sorted by expiry */
+static rtc_alarm_t *alarms;
+
+static bool due(uint32_t expiry, uint32_t now);
+static void insert(rtc_alarm_t *alarm);
+static void unlink(rtc_alarm_t *alarm);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the RTC
+
+The RTC is started on the LSE counting seconds, unless it is already running
+from before a reset, and its alarm is set to interrupt on EXTI 17 for wakeup.
+*/
+
+void rtc_alarm_init(void)
+{
+	alarms = 0;
+	rtc_auto_awake(RCC_LSE, 0x7FFF);
+	nvic_enable_irq(NVIC_RTC_ALARM_IRQ);
+	EXTI_IMR |= EXTI17;
+	exti_set_trigger(EXTI17, EXTI_TRIGGER_RISING);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Present Time
+
+The counter halves are read until they agree so that a carry between them is
+not missed.
+
+@returns the RTC count in seconds.
+*/
+
+uint32_t rtc_alarm_now(void)
+{
+	uint16_t high;
+	uint16_t low;
+	RTC_CRL &= ~RTC_CRL_RSF;
+	while ((RTC_CRL & RTC_CRL_RSF) == 0);
+	do
+	{
+		high = RTC_CNTH;
+		low = RTC_CNTL;
+	}
+	while (high != RTC_CNTH);
+	return ((uint32_t) high << 16) | low;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Create an Alarm
+
+@param[in] alarm: alarm to set up.
+@param[in] callback: function called when it goes off.
+@param[in] context: anything the callback needs.
+*/
+
+void rtc_alarm_create(rtc_alarm_t *alarm, rtc_alarm_callback_t callback,
+		      void *context)
+{
+	alarm->next = 0;
+	alarm->callback = callback;
+	alarm->context = context;
+	alarm->active = false;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start an Alarm
+
+An alarm already running is restarted. The alarm is set in the RTC on the next
+rtc_alarm_dispatch.
+
+@param[in] alarm: alarm to start.
+@param[in] delay: seconds from now until it goes off.
+@param[in] period: seconds between later expiries, or 0 for one shot.
+*/
+
+void rtc_alarm_start(rtc_alarm_t *alarm, uint32_t delay, uint32_t period)
+{
+	if (alarm->active) unlink(alarm);
+	alarm->expiry = rtc_alarm_now() + delay;
+	alarm->period = period;
+	insert(alarm);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Stop an Alarm
+
+@param[in] alarm: alarm to stop. Nothing is done if it is not running.
+*/
+
+void rtc_alarm_stop(rtc_alarm_t *alarm)
+{
+	if (alarm->active) unlink(alarm);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check an Alarm
+
+@param[in] alarm: alarm to check.
+@returns true if the alarm is running.
+*/
+
+bool rtc_alarm_active(const rtc_alarm_t *alarm)
+{
+	return alarm->active;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Dispatch the Alarms Due
+
+Call this from the main loop after each wakeup and before each stop. The
+callbacks of the alarms due are called in order of expiry and the RTC alarm is
+then set for the next. If that is reached while it is being set, its alarms
+are dispatched too.
+
+@returns the number of callbacks called.
+*/
+
+uint32_t rtc_alarm_dispatch(void)
+{
+	uint32_t count = 0;
+	rtc_clear_flag(RTC_ALR);
+	while (1)
+	{
+		uint32_t now = rtc_alarm_now();
+		while ((alarms != 0) && due(alarms->expiry, now))
+		{
+			rtc_alarm_t *alarm = alarms;
+			unlink(alarm);
+			if (alarm->period > 0)
+			{
+				alarm->expiry += alarm->period;
+				insert(alarm);
+			}
+			alarm->callback(alarm);
+			count++;
+		}
+/* With no alarm left, set the RTC alarm as far off as it goes */
+		if (alarms == 0)
+		{
+			rtc_set_alarm_time(now - 1);
+			break;
+		}
+		rtc_set_alarm_time(alarms->expiry);
+		if (! due(alarms->expiry, rtc_alarm_now())) break;
+	}
+	return count;
+}
+
+/*--------------------------------------------------------------------------*/
+/* An alarm is due once the count has reached its expiry, allowing for the
+count passing through zero. */
+
+static bool due(uint32_t expiry, uint32_t now)
+{
+	return (int32_t) (now - expiry) >= 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Put an alarm into the list after any of the same expiry. */
+
+static void insert(rtc_alarm_t *alarm)
+{
+	rtc_alarm_t **link = &alarms;
+	while ((*link != 0) && due((*link)->expiry, alarm->expiry))
+		link = &(*link)->next;
+	alarm->next = *link;
+	*link = alarm;
+	alarm->active = true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Take an alarm out of the list. */
+
+static void unlink(rtc_alarm_t *alarm)
+{
+	rtc_alarm_t **link = &alarms;
+	while ((*link != 0) && (*link != alarm)) link = &(*link)->next;
+	if (*link != 0) *link = alarm->next;
+	alarm->next = 0;
+	alarm->active = false;
+}
+
+/*--------------------------------------------------------------------------*/
+/* RTC Alarm ISR
+
+The alarm appears on EXTI 17, which is cleared here to end the wakeup. The
+alarm flag is cleared by rtc_alarm_dispatch.
+*/
+
+void rtc_alarm_isr(void)
+{
+	exti_reset_request(EXTI17);
+}
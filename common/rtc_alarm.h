@@ -0,0 +1,36 @@
+/*	RTC Alarm Scheduler
+
+Any number of one shot and periodic alarms of one second resolution on the
+single alarm of the STM32F1 RTC, which wakes the processor from stop mode.
+
+14 October 2026
+*/
+
+#ifndef RTC_ALARM_H
+#define RTC_ALARM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct rtc_alarm;
+typedef void (*rtc_alarm_callback_t)(struct rtc_alarm *alarm);
+
+typedef struct rtc_alarm {
+	struct rtc_alarm *next;
+	uint32_t expiry;                /* RTC count it goes off at */
+	uint32_t period;                /* reload, 0 for a one shot alarm */
+	rtc_alarm_callback_t callback;  /* called from rtc_alarm_dispatch */
+	void *context;                  /* for the callback */
+	bool active;
+} rtc_alarm_t;
+
+void rtc_alarm_init(void);
+uint32_t rtc_alarm_now(void);
+void rtc_alarm_create(rtc_alarm_t *alarm, rtc_alarm_callback_t callback,
+		      void *context);
+void rtc_alarm_start(rtc_alarm_t *alarm, uint32_t delay, uint32_t period);
+void rtc_alarm_stop(rtc_alarm_t *alarm);
+bool rtc_alarm_active(const rtc_alarm_t *alarm);
+uint32_t rtc_alarm_dispatch(void);
+
+#endif
@@ -0,0 +1,191 @@
+/*	FreeRTOS Run Time Statistics
+
+The FreeRTOS run time clock is taken from the DWT cycle counter of the
+Cortex-M3, so no timer is used. The 32 bit cycle count is extended in software
+each time the kernel reads it and divided down, so that the run time counters
+of the kernel wrap after about an hour rather than a minute. The kernel reads
+the clock at each context switch, which must happen at least once in each
+wrap of the cycle counter (59 seconds at 72MHz): any task that wakes
+periodically is enough.
+
+rtos_stats_update takes a snapshot of all tasks with the CPU load of each since
+the previous update, the fewest words of stack ever left free, and the present
+and lowest ever free heap. It uses static working space so it must only be
+called from one task. rtos_stats_pack lays the snapshot out as the payload of
+a TELEMETRY_RTOS_STATS record, little endian:
+
+    heap free (4), heap lowest free (4), task count (1),
+    then per task: number, priority, state, CPU in 0.1% (2),
+                   stack words free (2), name (8, zero padded)
+
+FreeRTOSConfig.h must define configUSE_TRACE_FACILITY,
+configGENERATE_RUN_TIME_STATS and INCLUDE_uxTaskGetStackHighWaterMark, and
+map portCONFIGURE_TIMER_FOR_RUN_TIME_STATS and portGET_RUN_TIME_COUNTER_VALUE
+to rtos_stats_clock_init and rtos_stats_clock. The lowest ever free heap needs
+heap_4.c.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/cm3/cortex.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "rtos_stats.h"
+#include "telemetry.h"
+
+#if RTOS_STATS_RECORD_HEADER + RTOS_STATS_MAX_TASKS*RTOS_STATS_RECORD_TASK > \
+    TELEMETRY_MAX_PAYLOAD
+#error "RTOS_STATS_MAX_TASKS is too large for a telemetry record"
+#endif
+
+/* Cycle count extended to 64 bits, and the counter value last read */
+static uint64_t clock_cycles;
+static uint32_t clock_last;
+
+/* Working space for the kernel's task snapshot */
+static TaskStatus_t status[RTOS_STATS_MAX_TASKS];
+
+/* Run time counters of each task at the previous update */
+static struct {
+	TaskHandle_t handle;
+	uint32_t counter;
+} previous[RTOS_STATS_MAX_TASKS];
+static uint8_t previous_count;
+static uint32_t previous_total;
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the Run Time Clock
+
+Enables the DWT cycle counter. Called by the kernel when the scheduler starts.
+*/
+
+void rtos_stats_clock_init(void)
+{
+	dwt_enable_cycle_counter();
+	clock_cycles = 0;
+	clock_last = DWT_CYCCNT;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Read the Run Time Clock
+
+@returns the cycles counted since the clock was started, divided by
+2^RTOS_STATS_CLOCK_SHIFT.
+*/
+
+uint32_t rtos_stats_clock(void)
+{
+	bool masked = cm_mask_interrupts(true);
+	uint32_t now = DWT_CYCCNT;
+	clock_cycles += now - clock_last;
+	clock_last = now;
+	uint32_t clock = (uint32_t) (clock_cycles >> RTOS_STATS_CLOCK_SHIFT);
+	cm_mask_interrupts(masked);
+	return clock;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Take a Snapshot of the Task and Heap Statistics
+
+Tasks beyond RTOS_STATS_MAX_TASKS are not reported. A task created since the
+previous update has its CPU load counted from its creation.
+
+@param[out] stats: snapshot.
+*/
+
+void rtos_stats_update(rtos_stats_t *stats)
+{
+	uint32_t total;
+	uint8_t count = uxTaskGetSystemState(status, RTOS_STATS_MAX_TASKS, &total);
+	uint32_t elapsed = total - previous_total;
+	uint8_t i, j, k;
+
+	for (i = 0; i < count; i++)
+	{
+		rtos_task_stats_t *task = &stats->task[i];
+		uint32_t run = status[i].ulRunTimeCounter;
+		for (j = 0; j < previous_count; j++)
+		{
+			if (previous[j].handle == status[i].xHandle)
+			{
+				run -= previous[j].counter;
+				break;
+			}
+		}
+		for (k = 0; k < RTOS_STATS_NAME_LEN && status[i].pcTaskName[k] != 0; k++)
+			task->name[k] = status[i].pcTaskName[k];
+		for (; k <= RTOS_STATS_NAME_LEN; k++) task->name[k] = 0;
+		task->number = (uint8_t) status[i].xTaskNumber;
+		task->priority = (uint8_t) status[i].uxCurrentPriority;
+		task->state = (uint8_t) status[i].eCurrentState;
+/* Scale down to keep the product within 32 bits */
+		if (elapsed >= 0x400000)
+			task->cpu = (uint16_t) ((run >> 10) * 1000 / (elapsed >> 10));
+		else if (elapsed > 0) task->cpu = (uint16_t) (run * 1000 / elapsed);
+		else task->cpu = 0;
+		task->stack_free = (uint16_t) status[i].usStackHighWaterMark;
+	}
+/* If the kernel has more tasks than the snapshot can hold, count is zero */
+	for (i = 0; i < count; i++)
+	{
+		previous[i].handle = status[i].xHandle;
+		previous[i].counter = status[i].ulRunTimeCounter;
+	}
+	previous_count = count;
+	previous_total = total;
+	stats->count = count;
+	stats->heap_free = xPortGetFreeHeapSize();
+	stats->heap_min_free = xPortGetMinimumEverFreeHeapSize();
+}
+
+/*--------------------------------------------------------------------------*/
+/* Put values little endian, returning the bytes used */
+
+static uint8_t put_16(uint8_t *out, uint16_t value)
+{
+	out[0] = (uint8_t) value;
+	out[1] = (uint8_t) (value >> 8);
+	return 2;
+}
+
+static uint8_t put_32(uint8_t *out, uint32_t value)
+{
+	put_16(out, (uint16_t) value);
+	put_16(out + 2, (uint16_t) (value >> 16));
+	return 4;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Lay out a Snapshot as a Telemetry Record
+
+@param[out] payload: record payload, of at least RTOS_STATS_RECORD_HEADER +
+RTOS_STATS_MAX_TASKS*RTOS_STATS_RECORD_TASK bytes.
+@param[in] stats: snapshot.
+@returns payload length.
+*/
+
+uint8_t rtos_stats_pack(uint8_t *payload, const rtos_stats_t *stats)
+{
+	uint8_t length = 0;
+	uint8_t i, k;
+
+	length += put_32(payload + length, stats->heap_free);
+	length += put_32(payload + length, stats->heap_min_free);
+	payload[length++] = stats->count;
+	for (i = 0; i < stats->count; i++)
+	{
+		const rtos_task_stats_t *task = &stats->task[i];
+		payload[length++] = task->number;
+		payload[length++] = task->priority;
+		payload[length++] = task->state;
+		length += put_16(payload + length, task->cpu);
+		length += put_16(payload + length, task->stack_free);
+		for (k = 0; k < RTOS_STATS_NAME_LEN; k++)
+			payload[length++] = (uint8_t) task->name[k];
+	}
+	return length;
+}
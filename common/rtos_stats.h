@@ -0,0 +1,51 @@
+/*	FreeRTOS Run Time Statistics
+
+Run time clock from the DWT cycle counter, and per task CPU load and stack use
+with the heap use, for printing or sending as a telemetry record.
+
+14 October 2026
+*/
+
+#ifndef RTOS_STATS_H
+#define RTOS_STATS_H
+
+#include <stdint.h>
+
+/* Most tasks reported */
+#ifndef RTOS_STATS_MAX_TASKS
+#define RTOS_STATS_MAX_TASKS    8
+#endif
+
+/* Characters of the task name kept */
+#define RTOS_STATS_NAME_LEN     8
+
+/* The run time clock is the cycle count divided by 2^RTOS_STATS_CLOCK_SHIFT,
+1.125MHz at 72MHz. */
+#define RTOS_STATS_CLOCK_SHIFT  6
+
+/* Bytes of the telemetry record header and of each task */
+#define RTOS_STATS_RECORD_HEADER 9
+#define RTOS_STATS_RECORD_TASK  (7+RTOS_STATS_NAME_LEN)
+
+typedef struct {
+	char name[RTOS_STATS_NAME_LEN+1];
+	uint8_t number;
+	uint8_t priority;
+	uint8_t state;
+	uint16_t cpu;               /* tenths of a percent since the last update */
+	uint16_t stack_free;        /* fewest words of stack ever free */
+} rtos_task_stats_t;
+
+typedef struct {
+	uint32_t heap_free;
+	uint32_t heap_min_free;
+	uint8_t count;
+	rtos_task_stats_t task[RTOS_STATS_MAX_TASKS];
+} rtos_stats_t;
+
+void rtos_stats_clock_init(void);
+uint32_t rtos_stats_clock(void);
+void rtos_stats_update(rtos_stats_t *stats);
+uint8_t rtos_stats_pack(uint8_t *payload, const rtos_stats_t *stats);
+
+#endif
@@ -0,0 +1,158 @@
+/*	FreeRTOS Tickless Idle
+
+FreeRTOSConfig.h maps portSUPPRESS_TICKS_AND_SLEEP to rtos_tickless_sleep,
+which the idle task calls when no task is due for at least
+configEXPECTED_IDLE_TIME_BEFORE_SLEEP ticks.
+
+Short idle periods are passed to the tickless sleep of the FreeRTOS Cortex-M3
+port, which reprograms the SysTick for the whole period and sleeps with wfi,
+so the processor wakes only when a task is due or an interrupt arrives. This
+needs configUSE_TICKLESS_IDLE 1, and is the only mode used until stop mode has
+been allowed.
+
+Once rtos_tickless_init has set up the RTC and the application has allowed
+stop mode, idle periods of RTOS_TICKLESS_STOP_TICKS or more are spent in stop
+mode. The SysTick halts in stop, so the RTC, counting the LSE at 1024Hz, is
+given an alarm on EXTI 17 for the end of the period, less a margin for the
+HSE and PLL to restart. On wakeup, by the alarm or any other EXTI line, the
+tick count is stepped on by the time the RTC has counted, with the fraction of
+a tick carried to the next stop. Stop is only entered when the serial.c output
+has finished, and the application must only allow it while no other
+peripheral that stop mode halts, such as a USART receiving, is needed.
+
+The RTC is taken over with a prescaler for 1024Hz, so it cannot also be used
+for a 1Hz calendar. power.c and serial.c must be linked in.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/systick.h>
+#include <libopencm3/stm32/exti.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/rtc.h>
+#include <libopencm3/stm32/usart.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "rtos_tickless.h"
+#include "irq_priority.h"
+#include "power.h"
+#include "serial.h"
+
+/* RTC count rate from the 32768Hz LSE */
+#define RTC_HZ				1024
+#define RTC_PRESCALE		(32768/RTC_HZ - 1)
+
+/* Ticks taken from each stop for the clocks to restart */
+#define STOP_MARGIN_TICKS	2
+
+/* The sleep of the FreeRTOS port, which is used for short periods */
+extern void vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime);
+
+static bool rtc_ready;
+static bool stop_allowed;
+
+/* RTC counts times the tick rate not yet taken into the tick count */
+static uint32_t rtc_remainder;
+
+static void stop_sleep(TickType_t idle);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set up the RTC for Stop Mode
+
+The RTC is woken and set to count the LSE, which must be fitted, at 1024Hz, and
+its alarm is routed to EXTI 17 to wake the processor from stop.
+*/
+
+void rtos_tickless_init(void)
+{
+	rtc_auto_awake(RCC_LSE, RTC_PRESCALE);
+	IRQ_PRIORITY_SET_RTOS(NVIC_RTC_ALARM_IRQ, IRQ_LEVEL_RTOS_WAKE);
+	nvic_enable_irq(NVIC_RTC_ALARM_IRQ);
+	EXTI_IMR |= EXTI17;
+	exti_set_trigger(EXTI17, EXTI_TRIGGER_RISING);
+	rtc_remainder = 0;
+	rtc_ready = true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Allow or Prevent Stop Mode
+
+Stop mode is never used before rtos_tickless_init has been called.
+
+@param[in] allow: true if long idle periods may be spent in stop mode.
+*/
+
+void rtos_tickless_allow_stop(bool allow)
+{
+	stop_allowed = allow && rtc_ready;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Sleep for an Idle Period
+
+Called by the idle task with the scheduler suspended.
+
+@param[in] expected_idle: ticks until the next task is due.
+*/
+
+void rtos_tickless_sleep(uint32_t expected_idle)
+{
+	if (! stop_allowed || (expected_idle < RTOS_TICKLESS_STOP_TICKS) ||
+		serial_tx_busy() || ((USART_SR(USART1) & USART_SR_TC) == 0))
+	{
+		vPortSuppressTicksAndSleep(expected_idle);
+		return;
+	}
+	if (expected_idle > RTOS_TICKLESS_STOP_MAX)
+		expected_idle = RTOS_TICKLESS_STOP_MAX;
+	__asm__ __volatile__ ("cpsid i" ::: "memory");
+/* A task may have been readied by an interrupt since the idle task decided to
+sleep. */
+	if (eTaskConfirmSleepModeStatus() != eAbortSleep) stop_sleep(expected_idle);
+	__asm__ __volatile__ ("cpsie i" ::: "memory");
+}
+
+/*--------------------------------------------------------------------------*/
+/* Stop until the RTC alarm or another EXTI line, with interrupts masked, and
+step the tick count on by the time stopped. */
+
+static void stop_sleep(TickType_t idle)
+{
+	uint32_t start;
+	uint32_t elapsed;
+	TickType_t ticks;
+
+	systick_counter_disable();
+	start = rtc_get_counter_val();
+	rtc_clear_flag(RTC_ALR);
+	rtc_set_alarm_time(start +
+			   (idle - STOP_MARGIN_TICKS) * RTC_HZ / configTICK_RATE_HZ);
+	power_stop_enter();
+/* The RTC registers read stale values until they have resynchronised after
+stop. */
+	RTC_CRL &= ~RTC_CRL_RSF;
+	while ((RTC_CRL & RTC_CRL_RSF) == 0);
+	elapsed = rtc_get_counter_val() - start;
+	rtc_remainder += elapsed * configTICK_RATE_HZ;
+	ticks = rtc_remainder / RTC_HZ;
+	rtc_remainder %= RTC_HZ;
+	if (ticks > idle) ticks = idle;
+	vTaskStepTick(ticks);
+/* Restart the SysTick for a whole tick period */
+	STK_CVR = 0;
+	systick_counter_enable();
+}
+
+/*--------------------------------------------------------------------------*/
+/* RTC alarm ISR on EXTI 17, which has woken the processor. The EXTI request
+and alarm flag are cleared. */
+
+void rtc_alarm_isr(void)
+{
+	exti_reset_request(EXTI17);
+	rtc_clear_flag(RTC_ALR);
+}
@@ -0,0 +1,30 @@
+/*	FreeRTOS Tickless Idle
+
+Suppression of the FreeRTOS tick while idle, with long idle periods spent in
+stop mode and timed by the RTC on the STM32F1.
+
+14 October 2026
+*/
+
+#ifndef RTOS_TICKLESS_H
+#define RTOS_TICKLESS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Shortest idle time in ticks spent in stop mode rather than sleep */
+#ifndef RTOS_TICKLESS_STOP_TICKS
+#define RTOS_TICKLESS_STOP_TICKS    20
+#endif
+
+/* Longest single stop in ticks, after which the tick count is brought up to
+date and stop is entered again. */
+#ifndef RTOS_TICKLESS_STOP_MAX
+#define RTOS_TICKLESS_STOP_MAX      600000
+#endif
+
+void rtos_tickless_init(void);
+void rtos_tickless_allow_stop(bool allow);
+void rtos_tickless_sleep(uint32_t expected_idle);
+
+#endif
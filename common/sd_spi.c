@@ -0,0 +1,417 @@
+/*	SD Card SPI Driver
+
+Initialisation and block transfers of an SD card in SPI mode on a bus of
+spi_dma.c, normally SPI1 (PA5 SCK, PA6 MISO, PA7 MOSI) with the chip select
+on PA4.
+
+The card is reset and identified at a clock below 400kHz: CMD0 puts it into
+SPI mode, CMD8 separates version 2 cards from version 1, ACMD41 is repeated
+until initialisation is complete, and CMD58 reads the capacity bit that
+selects block rather than byte addressing. The clock is then raised to a
+quarter of the bus clock, 18MHz on SPI1.
+
+The short command and response exchanges are made a byte at a time without
+DMA. The 512 byte data blocks go by DMA: a read is a receive only
+transaction, with the dummy frames clocked out by the TX channel, and a write
+is a transmit only transaction. Several blocks are moved with one command,
+CMD18 or CMD25, with ACMD23 telling the card how many blocks to pre-erase
+before a multiple block write.
+
+After each block written, and after CMD12, the card holds its output low while
+it is busy, which can take hundreds of milliseconds. Rather than the CPU
+reading byte after byte, a receive only DMA transaction of SD_BUSY_FRAMES is
+run, and its callback submits it again from the interrupt until the last frame
+read is all ones. The waiting program sleeps meanwhile, and other interrupts
+are served.
+
+The card is selected for the whole of each operation, and the bus must not be
+used by another device meanwhile.
+
+14 October 2026
+*/
+
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/spi.h>
+#include "spi_dma.h"
+#include "sd_spi.h"
+
+/* Commands, with 0x80 marking application commands sent after CMD55 */
+#define CMD0            0       /* GO_IDLE_STATE */
+#define CMD8            8       /* SEND_IF_COND */
+#define CMD12           12      /* STOP_TRANSMISSION */
+#define CMD16           16      /* SET_BLOCKLEN */
+#define CMD17           17      /* READ_SINGLE_BLOCK */
+#define CMD18           18      /* READ_MULTIPLE_BLOCK */
+#define CMD24           24      /* WRITE_BLOCK */
+#define CMD25           25      /* WRITE_MULTIPLE_BLOCK */
+#define CMD55           55      /* APP_CMD */
+#define CMD58           58      /* READ_OCR */
+#define ACMD23          (0x80 | 23)     /* SET_WR_BLK_ERASE_COUNT */
+#define ACMD41          (0x80 | 41)     /* SD_SEND_OP_COND */
+
+/* R1 response bits */
+#define R1_IDLE         0x01
+#define R1_ILLEGAL      0x04
+
+/* Data tokens */
+#define TOKEN_START     0xFE    /* single block, and each block read */
+#define TOKEN_MULTIPLE  0xFC    /* each block of a multiple block write */
+#define TOKEN_STOP      0xFD    /* end of a multiple block write */
+#define DATA_ACCEPTED   0x05
+
+/* Tries of each wait, counted in bytes or commands. Those at the fast clock
+are roughly 100ms, the initialisation loop about one second. */
+#define SD_INIT_TRIES   2000
+#define SD_READY_TRIES  100000
+#define SD_TOKEN_TRIES  100000
+#define SD_BUSY_FRAMES  32
+#define SD_BUSY_CHUNKS  40000
+
+static spi_bus_t *sd_bus;
+static uint32_t sd_cs_port;
+static uint16_t sd_cs_pin;
+static uint8_t card_type;
+
+static spi_transaction_t data_transaction;
+static spi_transaction_t busy_transaction;
+static uint8_t busy_frames[SD_BUSY_FRAMES];
+static volatile uint16_t busy_chunks;
+static volatile bool busy_ready;
+
+static void card_select(void);
+static void card_deselect(void);
+static bool wait_ready(void);
+static bool wait_not_busy(void);
+static void busy_check(spi_transaction_t *transaction);
+static uint8_t command(uint8_t cmd, uint32_t argument);
+static void dma_transfer(const void *tx, void *rx, uint16_t length);
+static bool receive_block(uint8_t *data);
+static bool send_block(const uint8_t *data, uint8_t token);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise the Card
+
+The bus should have been set up with spi_bus_setup for SPI mode 0 (clock low
+when idle, data valid on the first edge). The chip select pin is set up here.
+The card type is found and the card made ready for block transfers.
+
+@param[in] bus: bus the card is on.
+@param[in] cs_port: GPIO port of the chip select.
+@param[in] cs_pin: GPIO pin of the chip select.
+@returns SD_OK, or the reason the card cannot be used.
+*/
+
+uint8_t sd_init(spi_bus_t *bus, uint32_t cs_port, uint16_t cs_pin)
+{
+	uint8_t ocr[4];
+	uint8_t response;
+	uint8_t result = SD_OK;
+	uint32_t tries;
+	uint8_t i;
+
+	sd_bus = bus;
+	sd_cs_port = cs_port;
+	sd_cs_pin = cs_pin;
+	card_type = SD_TYPE_NONE;
+	spi_cs_setup(cs_port, cs_pin);
+	spi_bus_set_baudrate(bus, (bus->spi == SPI1) ?
+			     SPI_CR1_BAUDRATE_FPCLK_DIV_256 :
+			     SPI_CR1_BAUDRATE_FPCLK_DIV_128);
+/* At least 74 clocks with the card deselected before the reset */
+	for (i = 0; i < 10; i++) spi_bus_exchange(bus, 0xFF);
+
+	card_select();
+	if (command(CMD0, 0) != R1_IDLE) result = SD_NO_CARD;
+	else if ((response = command(CMD8, 0x1AA)) == R1_IDLE)
+	{
+/* Version 2: the card must accept 2.7-3.6V and echo the check pattern */
+		for (i = 0; i < 4; i++) ocr[i] = spi_bus_exchange(bus, 0xFF);
+		if (((ocr[2] & 0x0F) != 0x01) || (ocr[3] != 0xAA))
+			result = SD_UNUSABLE;
+		else
+		{
+			tries = SD_INIT_TRIES;
+			while ((command(ACMD41, 1UL << 30) != 0) && (--tries > 0));
+			if (tries == 0) result = SD_TIMEOUT;
+			else if (command(CMD58, 0) != 0) result = SD_ERROR;
+			else
+			{
+				for (i = 0; i < 4; i++) ocr[i] = spi_bus_exchange(bus, 0xFF);
+				card_type = (ocr[0] & 0x40) ? SD_TYPE_SDHC : SD_TYPE_SD2;
+			}
+		}
+	}
+	else if (response & R1_ILLEGAL)
+	{
+/* Version 1 rejects CMD8 as illegal */
+		tries = SD_INIT_TRIES;
+		while ((command(ACMD41, 0) != 0) && (--tries > 0));
+		if (tries == 0) result = SD_TIMEOUT;
+		else card_type = SD_TYPE_SD1;
+	}
+	else result = SD_UNUSABLE;
+/* Byte addressed cards are fixed at 512 byte blocks */
+	if ((card_type == SD_TYPE_SD1) || (card_type == SD_TYPE_SD2))
+	{
+		if (command(CMD16, SD_BLOCK_SIZE) != 0)
+		{
+			card_type = SD_TYPE_NONE;
+			result = SD_ERROR;
+		}
+	}
+	card_deselect();
+	if (card_type != SD_TYPE_NONE)
+		spi_bus_set_baudrate(bus, SPI_CR1_BAUDRATE_FPCLK_DIV_4);
+	return result;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Type of the Card
+
+@returns SD_TYPE_ of the card found by sd_init, SD_TYPE_NONE if none.
+*/
+
+uint8_t sd_type(void)
+{
+	return card_type;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Read Blocks
+
+The program sleeps during the DMA of each block.
+
+@param[in] block: number of the first block.
+@param[out] data: buffer for count blocks of SD_BLOCK_SIZE bytes.
+@param[in] count: number of blocks.
+@returns SD_OK or the error.
+*/
+
+uint8_t sd_read(uint32_t block, uint8_t *data, uint32_t count)
+{
+	uint8_t result = SD_OK;
+
+	if (card_type == SD_TYPE_NONE) return SD_NOT_READY;
+	if (count == 0) return SD_OK;
+	if (card_type != SD_TYPE_SDHC) block *= SD_BLOCK_SIZE;
+	card_select();
+	if (count == 1)
+	{
+		if ((command(CMD17, block) != 0) || ! receive_block(data))
+			result = SD_ERROR;
+	}
+	else if (command(CMD18, block) != 0) result = SD_ERROR;
+	else
+	{
+		while (count-- > 0)
+		{
+			if (! receive_block(data))
+			{
+				result = SD_ERROR;
+				break;
+			}
+			data += SD_BLOCK_SIZE;
+		}
+		command(CMD12, 0);
+		if (! wait_not_busy() && (result == SD_OK)) result = SD_TIMEOUT;
+	}
+	card_deselect();
+	return result;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write Blocks
+
+The program sleeps during the DMA of each block and while the card is busy
+programming it.
+
+@param[in] block: number of the first block.
+@param[in] data: count blocks of SD_BLOCK_SIZE bytes.
+@param[in] count: number of blocks.
+@returns SD_OK or the error.
+*/
+
+uint8_t sd_write(uint32_t block, const uint8_t *data, uint32_t count)
+{
+	uint8_t result = SD_OK;
+
+	if (card_type == SD_TYPE_NONE) return SD_NOT_READY;
+	if (count == 0) return SD_OK;
+	if (card_type != SD_TYPE_SDHC) block *= SD_BLOCK_SIZE;
+	card_select();
+	if (count == 1)
+	{
+		if (command(CMD24, block) != 0) result = SD_ERROR;
+		else
+		{
+			spi_bus_exchange(sd_bus, 0xFF);
+			if (! send_block(data, TOKEN_START)) result = SD_ERROR;
+		}
+	}
+	else
+	{
+		command(ACMD23, count);
+		if (command(CMD25, block) != 0) result = SD_ERROR;
+		else
+		{
+			spi_bus_exchange(sd_bus, 0xFF);
+			while (count-- > 0)
+			{
+				if (! send_block(data, TOKEN_MULTIPLE))
+				{
+					result = SD_ERROR;
+					break;
+				}
+				data += SD_BLOCK_SIZE;
+			}
+			spi_bus_exchange(sd_bus, TOKEN_STOP);
+			spi_bus_exchange(sd_bus, 0xFF);
+			if (! wait_not_busy() && (result == SD_OK)) result = SD_TIMEOUT;
+		}
+	}
+	card_deselect();
+	return result;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Select the card. */
+
+static void card_select(void)
+{
+	gpio_clear(sd_cs_port, sd_cs_pin);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Deselect the card, with one more byte clocked so that it releases its
+output. */
+
+static void card_deselect(void)
+{
+	gpio_set(sd_cs_port, sd_cs_pin);
+	spi_bus_exchange(sd_bus, 0xFF);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Wait for the card to be ready for a command, reading bytes. Used where the
+card is not expected to be busy for long. */
+
+static bool wait_ready(void)
+{
+	uint32_t tries = SD_READY_TRIES;
+	while ((spi_bus_exchange(sd_bus, 0xFF) != 0xFF) && (--tries > 0));
+	return (tries > 0);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Wait for the card to finish programming. If it is still busy a receive
+only DMA transaction is repeated by its callback until the card is ready or
+the tries run out, with the program asleep. */
+
+static bool wait_not_busy(void)
+{
+	if (spi_bus_exchange(sd_bus, 0xFF) == 0xFF) return true;
+	busy_ready = false;
+	busy_chunks = SD_BUSY_CHUNKS;
+	busy_transaction.tx = 0;
+	busy_transaction.rx = busy_frames;
+	busy_transaction.length = SD_BUSY_FRAMES;
+	busy_transaction.flags = 0;
+	busy_transaction.cs_port = 0;
+	busy_transaction.callback = busy_check;
+	spi_bus_submit(sd_bus, &busy_transaction);
+	spi_transaction_wait(&busy_transaction);
+	return busy_ready;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Callback of the busy transaction, in the RX DMA interrupt. The card has
+released its output if the last frame is all ones. */
+
+static void busy_check(spi_transaction_t *transaction)
+{
+	if (busy_frames[SD_BUSY_FRAMES-1] == 0xFF) busy_ready = true;
+	else if (--busy_chunks > 0) spi_bus_submit(sd_bus, transaction);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Send a command and return its R1 response, 0xFF if there is none. An
+application command is preceded by CMD55. */
+
+static uint8_t command(uint8_t cmd, uint32_t argument)
+{
+	uint8_t response;
+	uint8_t crc = 0x01;
+	uint8_t i;
+
+	if (cmd & 0x80)
+	{
+		response = command(CMD55, 0);
+		if (response > R1_IDLE) return response;
+		cmd &= 0x7F;
+	}
+/* CMD12 interrupts a multiple block read while the card is sending */
+	if ((cmd != CMD0) && (cmd != CMD12) && ! wait_ready()) return 0xFF;
+/* Only CMD0 and CMD8 are checked in SPI mode */
+	if (cmd == CMD0) crc = 0x95;
+	if (cmd == CMD8) crc = 0x87;
+	spi_bus_exchange(sd_bus, 0x40 | cmd);
+	spi_bus_exchange(sd_bus, argument >> 24);
+	spi_bus_exchange(sd_bus, argument >> 16);
+	spi_bus_exchange(sd_bus, argument >> 8);
+	spi_bus_exchange(sd_bus, argument);
+	spi_bus_exchange(sd_bus, crc);
+/* CMD12 is followed by a stuff byte */
+	if (cmd == CMD12) spi_bus_exchange(sd_bus, 0xFF);
+	for (i = 0; i < 10; i++)
+	{
+		response = spi_bus_exchange(sd_bus, 0xFF);
+		if ((response & 0x80) == 0) break;
+	}
+	return response;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Run one DMA transaction on the bus and sleep until it is done. */
+
+static void dma_transfer(const void *tx, void *rx, uint16_t length)
+{
+	data_transaction.tx = tx;
+	data_transaction.rx = rx;
+	data_transaction.length = length;
+	data_transaction.flags = 0;
+	data_transaction.cs_port = 0;
+	data_transaction.callback = 0;
+	spi_bus_submit(sd_bus, &data_transaction);
+	spi_transaction_wait(&data_transaction);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Wait for the start token of a data block and read the block by DMA. The
+CRC is not checked. */
+
+static bool receive_block(uint8_t *data)
+{
+	uint32_t tries = SD_TOKEN_TRIES;
+	uint8_t token;
+
+	while (((token = spi_bus_exchange(sd_bus, 0xFF)) == 0xFF) && (--tries > 0));
+	if (token != TOKEN_START) return false;
+	dma_transfer(0, data, SD_BLOCK_SIZE);
+	spi_bus_exchange(sd_bus, 0xFF);
+	spi_bus_exchange(sd_bus, 0xFF);
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Send a data block by DMA after its token, with a dummy CRC, and wait for
+the card to accept and program it. */
+
+static bool send_block(const uint8_t *data, uint8_t token)
+{
+	spi_bus_exchange(sd_bus, token);
+	dma_transfer(data, 0, SD_BLOCK_SIZE);
+	spi_bus_exchange(sd_bus, 0xFF);
+	spi_bus_exchange(sd_bus, 0xFF);
+	if ((spi_bus_exchange(sd_bus, 0xFF) & 0x1F) != DATA_ACCEPTED) return false;
+	return wait_not_busy();
+}
@@ -0,0 +1,37 @@
+/*	SD Card SPI Driver
+
+Initialisation and block transfers of an SD card in SPI mode, on a bus of
+spi_dma.c.
+
+14 October 2026
+*/
+
+#ifndef SD_SPI_H
+#define SD_SPI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "spi_dma.h"
+
+#define SD_BLOCK_SIZE   512
+
+/* Results of the card operations */
+#define SD_OK           0
+#define SD_NO_CARD      1       /* no response to the reset */
+#define SD_UNUSABLE     2       /* voltage or version not supported */
+#define SD_TIMEOUT      3
+#define SD_ERROR        4       /* command or data error from the card */
+#define SD_NOT_READY    5       /* not initialised */
+
+/* Card types */
+#define SD_TYPE_NONE    0
+#define SD_TYPE_SD1     1       /* version 1, byte addressed */
+#define SD_TYPE_SD2     2       /* version 2 standard capacity */
+#define SD_TYPE_SDHC    3       /* high or extended capacity, block addressed */
+
+uint8_t sd_init(spi_bus_t *bus, uint32_t cs_port, uint16_t cs_pin);
+uint8_t sd_type(void);
+uint8_t sd_read(uint32_t block, uint8_t *data, uint32_t count);
+uint8_t sd_write(uint32_t block, const uint8_t *data, uint32_t count);
+
+#endif
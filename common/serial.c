@@ -0,0 +1,664 @@
+/*	USART DMA Serial Driver
+
+Transmission and reception of circular buffers on USART1, USART2 and USART3 by
+DMA or by interrupt for the STM32F1.
+
+Each USART is described by a port, serial_usart1 to serial_usart3, holding its
+peripheral, pins, interrupt and DMA channels, and the buffers and state of the
+transfers. All the functions take a port, so the same code serves every USART
+and several protocols can run on one board at once. The serial_tx_ and
+serial_rx_ functions without a port are the original USART1 interface and act
+on serial_usart1. USART2 and USART3 are only built when SERIAL_USART2 and
+SERIAL_USART3 are defined, as their DMA channels are shared with other
+peripherals. USART1 is by DMA unless SERIAL_USART1_NO_DMA is defined, which
+leaves DMA1 channels 4 and 5 to SPI2 of spi_dma.c or to capture.c, and sends
+and receives on USART1 by interrupt.
+
+    USART   pins       TX DMA       RX DMA
+    1       PA9 PA10   channel 4    channel 5
+    2       PA2 PA3    channel 7    channel 6
+    3       PB10 PB11  channel 2    channel 3
+
+In DMA transmission the largest contiguous block of data waiting in the send
+buffer is handed to the TX channel, which feeds the USART data register. When
+the block has gone the transfer complete interrupt releases it from the buffer
+and starts the next block, so that one interrupt is taken per block rather
+than per byte. Without SERIAL_TX_DMA the TXE interrupt sends a byte at a time.
+
+The producer puts data to the send buffer and then calls serial_port_tx_start,
+in place of enabling the USART TXE interrupt. If a transfer is already running
+the new data is picked up when it completes. serial_port_printf formats
+straight into the send buffer and starts transmission once.
+
+In DMA reception the RX channel runs continuously in circular mode over the
+data region of the receive buffer. The buffer head is advanced to the DMA
+position on the DMA half transfer and transfer complete interrupts and on the
+USART IDLE interrupt, which marks the end of a burst. Without SERIAL_RX_DMA
+the RXNE interrupt puts each byte to the buffer. The buffer is read with the
+usual buffer functions. If it is not read in time the oldest data is lost and
+counted as an overflow in the buffer statistics.
+
+The USART interrupts of all ports are handled by serial_port_isr. usart2_isr
+and usart3_isr are given here, but the application's usart1_isr must call
+serial_rx_idle_isr (or serial_port_isr on serial_usart1), as existing programs
+define it themselves.
+
+The USART is set up with serial_port_setup, or by the application, before the
+transfers are initialised.
+
+14 October 2026
+*/
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/usart.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+#include "serial.h"
+#include "format.h"
+#include "isr_profile.h"
+
+/* DMA memory barrier, so that data written to the buffer is in memory before
+the channel is enabled. */
+#define dma_barrier() __asm__ __volatile__ ("dmb" ::: "memory")
+
+/* Largest single transfer allowed by the DMA count register */
+#define DMA_MAX_TRANSFER 0xFFFF
+
+/* USART1 by DMA, with the interrupt handlers of its channels defined here */
+#ifndef SERIAL_USART1_NO_DMA
+#define SERIAL_USART1_DMA
+#define SERIAL_USART1_MODE  (SERIAL_TX_DMA | SERIAL_RX_DMA)
+#else
+#define SERIAL_USART1_MODE  0
+#endif
+
+#if defined(SERIAL_USART1_DMA) && defined(SPI_BUS2)
+#error "DMA1 channel 4 of USART1 is taken by SPI2: define SERIAL_USART1_NO_DMA"
+#endif
+#if defined(SERIAL_USART3) && defined(SPI_BUS1)
+#error "DMA1 channels 2 and 3 of USART3 are taken by SPI1 in spi_dma.c"
+#endif
+
+/* Ports, with both directions by DMA unless changed by serial_port_setup */
+serial_port_t serial_usart1 =
+{
+	.usart = USART1,
+	.usart_clock = RCC_USART1,
+	.gpio = GPIOA,
+	.gpio_clock = RCC_GPIOA,
+	.tx_pin = GPIO_USART1_TX,
+	.rx_pin = GPIO_USART1_RX,
+	.irq = NVIC_USART1_IRQ,
+	.tx_channel = DMA_CHANNEL4,
+	.rx_channel = DMA_CHANNEL5,
+	.tx_irq = NVIC_DMA1_CHANNEL4_IRQ,
+	.rx_irq = NVIC_DMA1_CHANNEL5_IRQ,
+	.mode = SERIAL_USART1_MODE,
+};
+
+#ifdef SERIAL_USART2
+serial_port_t serial_usart2 =
+{
+	.usart = USART2,
+	.usart_clock = RCC_USART2,
+	.gpio = GPIOA,
+	.gpio_clock = RCC_GPIOA,
+	.tx_pin = GPIO_USART2_TX,
+	.rx_pin = GPIO_USART2_RX,
+	.irq = NVIC_USART2_IRQ,
+	.tx_channel = DMA_CHANNEL7,
+	.rx_channel = DMA_CHANNEL6,
+	.tx_irq = NVIC_DMA1_CHANNEL7_IRQ,
+	.rx_irq = NVIC_DMA1_CHANNEL6_IRQ,
+	.mode = SERIAL_TX_DMA | SERIAL_RX_DMA,
+};
+#endif
+
+#ifdef SERIAL_USART3
+serial_port_t serial_usart3 =
+{
+	.usart = USART3,
+	.usart_clock = RCC_USART3,
+	.gpio = GPIOB,
+	.gpio_clock = RCC_GPIOB,
+	.tx_pin = GPIO_USART3_TX,
+	.rx_pin = GPIO_USART3_RX,
+	.irq = NVIC_USART3_IRQ,
+	.tx_channel = DMA_CHANNEL2,
+	.rx_channel = DMA_CHANNEL3,
+	.tx_irq = NVIC_DMA1_CHANNEL2_IRQ,
+	.rx_irq = NVIC_DMA1_CHANNEL3_IRQ,
+	.mode = SERIAL_TX_DMA | SERIAL_RX_DMA,
+};
+#endif
+
+static void tx_setup(serial_port_t *port);
+static void tx_next(serial_port_t *port);
+static void rx_setup(serial_port_t *port);
+static uint32_t rx_take(serial_port_t *port);
+/* Unused if no port is by DMA */
+static void tx_dma_isr(serial_port_t *port) __attribute__((unused));
+static void rx_dma_isr(serial_port_t *port) __attribute__((unused));
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set up a USART
+
+The clocks and pins are enabled and the USART set to 8 data bits, one stop bit,
+no parity and no flow control at the rate given, and then enabled.
+
+@param[in] port: port to set up.
+@param[in] baudrate: bit rate.
+@param[in] mode: SERIAL_TX_DMA and SERIAL_RX_DMA for DMA transfers in each
+direction, otherwise interrupts are used. USART1 built with
+SERIAL_USART1_NO_DMA is always by interrupt.
+*/
+
+void serial_port_setup(serial_port_t *port, uint32_t baudrate, uint8_t mode)
+{
+	port->baudrate = baudrate;
+#ifndef SERIAL_USART1_DMA
+	if (port == &serial_usart1) mode = SERIAL_USART1_MODE;
+#endif
+	port->mode = mode;
+	rcc_periph_clock_enable(port->gpio_clock);
+	rcc_periph_clock_enable(port->usart_clock);
+	gpio_set_mode(port->gpio, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, port->tx_pin);
+	gpio_set_mode(port->gpio, GPIO_MODE_INPUT,
+		      GPIO_CNF_INPUT_FLOAT, port->rx_pin);
+	usart_set_baudrate(port->usart, baudrate);
+	usart_set_databits(port->usart, 8);
+	usart_set_stopbits(port->usart, USART_STOPBITS_1);
+	usart_set_parity(port->usart, USART_PARITY_NONE);
+	usart_set_flow_control(port->usart, USART_FLOWCONTROL_NONE);
+	usart_set_mode(port->usart, USART_MODE_TX_RX);
+	usart_enable(port->usart);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise Transmission from a Byte Buffer
+
+@param[in] port: port to send on.
+@param[in] buffer: byte buffer holding data to send.
+*/
+
+void serial_port_tx_init(serial_port_t *port, uint8_t buffer[])
+{
+	port->tx_buffer = buffer;
+	port->tx_ring = 0;
+	tx_setup(port);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise Transmission from a Ring Buffer
+
+@param[in] port: port to send on.
+@param[in] ring: ring buffer holding data to send.
+*/
+
+void serial_port_tx_init_ring(serial_port_t *port, ring_buffer_t *ring)
+{
+	port->tx_ring = ring;
+	port->tx_buffer = 0;
+	tx_setup(port);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start Transmission
+
+Start sending any data waiting in the send buffer if the port is idle. This
+may be called from the main program or from an ISR.
+
+@param[in] port: port to send on.
+*/
+
+void serial_port_tx_start(serial_port_t *port)
+{
+	bool masked = cm_mask_interrupts(true);
+	if ((port->mode & SERIAL_TX_DMA) == 0)
+	{
+		port->tx_length = 1;
+		usart_enable_tx_interrupt(port->usart);
+	}
+	else if (port->tx_length == 0) tx_next(port);
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Formatted Output
+
+Format a message into the send buffer (see format.c) and start transmission.
+Output that does not fit in the buffer is dropped.
+
+@param[in] port: port to send on.
+@param[in] format: format string.
+@returns number of characters written.
+*/
+
+uint32_t serial_port_printf(serial_port_t *port, const char *format, ...)
+{
+	va_list args;
+	uint32_t n;
+	va_start(args, format);
+	if (port->tx_ring != 0) n = vformat_ring(port->tx_ring, format, args);
+	else n = vformat_buffer(port->tx_buffer, format, args);
+	va_end(args);
+	serial_port_tx_start(port);
+	return n;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check if Transmission is in Progress
+
+Note that the last byte may still be in the USART when this returns false.
+
+@param[in] port: port to check.
+*/
+
+bool serial_port_tx_busy(serial_port_t *port)
+{
+	return (port->tx_length != 0);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Wait for Transmission to Finish
+
+Start any waiting data and sleep until the whole send buffer has gone, then
+wait for the USART transmission complete flag, which is set when the last
+stop bit has left the pin. The wait is at most one character time. This must
+not be called from an ISR. If called with interrupts masked they are unmasked
+only while output is waiting to go, and are left masked on return.
+
+@param[in] port: port to wait for.
+*/
+
+void serial_port_tx_flush(serial_port_t *port)
+{
+	serial_port_tx_start(port);
+/* Interrupts are masked around the test so that an interrupt arriving just
+before the wfi cannot be missed. The wfi still wakes on the pending interrupt,
+which is then taken when unmasked. */
+	bool masked = cm_mask_interrupts(true);
+	while (port->tx_length != 0)
+	{
+		__asm__ __volatile__ ("wfi");
+		cm_mask_interrupts(false);
+		cm_mask_interrupts(true);
+	}
+	cm_mask_interrupts(masked);
+	while ((USART_SR(port->usart) & USART_SR_TC) == 0);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Setup the TX DMA channel for memory to USART transfers with the transfer
+complete interrupt, or leave the sending to the TXE interrupt. */
+
+static void tx_setup(serial_port_t *port)
+{
+	port->tx_length = 0;
+	usart_disable_tx_interrupt(port->usart);
+	if ((port->mode & SERIAL_TX_DMA) == 0)
+	{
+		nvic_enable_irq(port->irq);
+		return;
+	}
+	rcc_peripheral_enable_clock(&RCC_AHBENR, RCC_AHBENR_DMA1EN);
+	dma_channel_reset(DMA1, port->tx_channel);
+	dma_set_peripheral_address(DMA1, port->tx_channel,
+				   (uint32_t) &USART_DR(port->usart));
+	dma_set_read_from_memory(DMA1, port->tx_channel);
+	dma_enable_memory_increment_mode(DMA1, port->tx_channel);
+	dma_set_peripheral_size(DMA1, port->tx_channel, DMA_CCR_PSIZE_8BIT);
+	dma_set_memory_size(DMA1, port->tx_channel, DMA_CCR_MSIZE_8BIT);
+	dma_set_priority(DMA1, port->tx_channel, DMA_CCR_PL_MEDIUM);
+	dma_enable_transfer_complete_interrupt(DMA1, port->tx_channel);
+	nvic_enable_irq(port->tx_irq);
+	usart_enable_tx_dma(port->usart);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Hand the next contiguous block in the send buffer to the DMA. Called with
+the DMA channel idle and disabled. */
+
+static void tx_next(serial_port_t *port)
+{
+	uint8_t *data;
+	uint32_t length;
+	if (port->tx_ring != 0) length = ring_peek_contiguous(port->tx_ring, &data);
+	else length = buffer_peek_contiguous(port->tx_buffer, &data);
+	if (length > DMA_MAX_TRANSFER) length = DMA_MAX_TRANSFER;
+	port->tx_length = length;
+	if (length == 0) return;
+	dma_set_memory_address(DMA1, port->tx_channel, (uint32_t) data);
+	dma_set_number_of_data(DMA1, port->tx_channel, length);
+/* The TC flag is cleared by writing zero, as DMA writes to the data register
+without the status read that would otherwise clear it. */
+	USART_SR(port->usart) &= ~USART_SR_TC;
+	dma_barrier();
+	dma_enable_channel(DMA1, port->tx_channel);
+}
+
+/*--------------------------------------------------------------------------*/
+/* TX DMA channel ISR body. Release the block just sent and chain the next. */
+
+static void tx_dma_isr(serial_port_t *port)
+{
+	if (dma_get_interrupt_flag(DMA1, port->tx_channel, DMA_TCIF))
+	{
+		dma_clear_interrupt_flags(DMA1, port->tx_channel, DMA_TCIF);
+		dma_disable_channel(DMA1, port->tx_channel);
+		if (port->tx_ring != 0) ring_consume(port->tx_ring, port->tx_length);
+		else buffer_consume(port->tx_buffer, port->tx_length);
+		tx_next(port);
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise Reception to a Byte Buffer
+
+In DMA reception the DMA takes over the whole data region of the buffer, which
+must have been initialised and not yet used.
+
+@param[in] port: port to receive on.
+@param[in] buffer: byte buffer to receive data.
+*/
+
+void serial_port_rx_init(serial_port_t *port, uint8_t buffer[])
+{
+	port->rx_buffer = buffer;
+	port->rx_ring = 0;
+	if (port->mode & SERIAL_RX_DMA)
+		port->rx_size = buffer_reserve_contiguous(buffer, &port->rx_data);
+	rx_setup(port);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise Reception to a Ring Buffer
+
+In DMA reception the DMA takes over the whole data region of the ring, which
+must have been initialised and not yet used.
+
+@param[in] port: port to receive on.
+@param[in] ring: ring buffer to receive data.
+*/
+
+void serial_port_rx_init_ring(serial_port_t *port, ring_buffer_t *ring)
+{
+	port->rx_ring = ring;
+	port->rx_buffer = 0;
+	if (port->mode & SERIAL_RX_DMA)
+		port->rx_size = ring_reserve_contiguous(ring, &port->rx_data);
+	rx_setup(port);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Update the Receive Buffer
+
+Advance the receive buffer head to the current DMA position. This is done by
+the interrupts, but may also be called to pick up data in the middle of a
+burst.
+
+@param[in] port: port to update.
+*/
+
+void serial_port_rx_update(serial_port_t *port)
+{
+	if (port->mode & SERIAL_RX_DMA) rx_take(port);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the Receive Notification
+
+The function given is called from the receive interrupts each time they pass
+new data to the receive buffer, so that a task can block until data arrives
+rather than polling the buffer. It runs in interrupt context and must only use
+interrupt safe calls.
+
+@param[in] port: port to notify for.
+@param[in] notify: function to call, or 0 for none.
+*/
+
+void serial_port_rx_notify(serial_port_t *port, void (*notify)(void))
+{
+	port->rx_notify = notify;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Advance the receive buffer head to the DMA position and return the number
+of bytes passed to it. */
+
+static uint32_t rx_take(serial_port_t *port)
+{
+	bool masked = cm_mask_interrupts(true);
+	uint32_t position = port->rx_size - DMA_CNDTR(DMA1, port->rx_channel);
+	if (position >= port->rx_size) position = 0;
+	uint32_t length = (position - port->rx_last) & (port->rx_size - 1);
+	port->rx_last = position;
+	if (length > 0)
+	{
+		if (port->rx_ring != 0) ring_commit_dma(port->rx_ring, length);
+		else buffer_commit_dma(port->rx_buffer, length);
+	}
+	cm_mask_interrupts(masked);
+	return length;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief USART Interrupt Service
+
+The shared body of the USART ISRs. In DMA reception, when the line has gone
+idle after a burst, the data received is passed to the buffer. Otherwise a
+received byte is put to the buffer, and in interrupt transmission the next
+byte is sent.
+
+@param[in] port: port interrupting.
+*/
+
+void serial_port_isr(serial_port_t *port)
+{
+	uint32_t usart = port->usart;
+	bool received = false;
+
+	if (port->mode & SERIAL_RX_DMA)
+	{
+		if (usart_get_flag(usart, USART_SR_IDLE))
+		{
+/* The IDLE flag is cleared by reading SR then DR */
+			(void) USART_DR(usart);
+			received = (rx_take(port) > 0);
+		}
+	}
+	else if (usart_get_flag(usart, USART_SR_RXNE))
+	{
+		uint8_t data = (uint8_t) usart_recv(usart);
+		if (port->rx_ring != 0) ring_put(port->rx_ring, data);
+		else if (port->rx_buffer != 0) buffer_put(port->rx_buffer, data);
+		received = true;
+	}
+	if (((port->mode & SERIAL_TX_DMA) == 0) &&
+		(USART_CR1(usart) & USART_CR1_TXEIE) &&
+		usart_get_flag(usart, USART_SR_TXE))
+	{
+		uint16_t data;
+		if (port->tx_ring != 0) data = ring_get(port->tx_ring);
+		else data = buffer_get(port->tx_buffer);
+		if (data == BUFFER_EMPTY)
+		{
+			usart_disable_tx_interrupt(usart);
+			port->tx_length = 0;
+		}
+		else usart_send(usart, data);
+	}
+	if (received && port->rx_notify != 0) port->rx_notify();
+}
+
+/*--------------------------------------------------------------------------*/
+/* Setup the RX DMA channel for circular USART to memory transfers with the
+half and full transfer interrupts, and the USART IDLE interrupt. Otherwise
+enable the RXNE interrupt. */
+
+static void rx_setup(serial_port_t *port)
+{
+	port->rx_last = 0;
+	if ((port->mode & SERIAL_RX_DMA) == 0)
+	{
+		usart_enable_rx_interrupt(port->usart);
+		nvic_enable_irq(port->irq);
+		return;
+	}
+	rcc_peripheral_enable_clock(&RCC_AHBENR, RCC_AHBENR_DMA1EN);
+	dma_channel_reset(DMA1, port->rx_channel);
+	dma_set_peripheral_address(DMA1, port->rx_channel,
+				   (uint32_t) &USART_DR(port->usart));
+	dma_set_memory_address(DMA1, port->rx_channel, (uint32_t) port->rx_data);
+	dma_set_number_of_data(DMA1, port->rx_channel, port->rx_size);
+	dma_set_read_from_peripheral(DMA1, port->rx_channel);
+	dma_enable_memory_increment_mode(DMA1, port->rx_channel);
+	dma_set_peripheral_size(DMA1, port->rx_channel, DMA_CCR_PSIZE_8BIT);
+	dma_set_memory_size(DMA1, port->rx_channel, DMA_CCR_MSIZE_8BIT);
+	dma_set_priority(DMA1, port->rx_channel, DMA_CCR_PL_HIGH);
+	dma_enable_circular_mode(DMA1, port->rx_channel);
+	dma_enable_half_transfer_interrupt(DMA1, port->rx_channel);
+	dma_enable_transfer_complete_interrupt(DMA1, port->rx_channel);
+	nvic_enable_irq(port->rx_irq);
+	dma_enable_channel(DMA1, port->rx_channel);
+	usart_disable_rx_interrupt(port->usart);
+	USART_CR1(port->usart) |= USART_CR1_IDLEIE;
+	nvic_enable_irq(port->irq);
+	usart_enable_rx_dma(port->usart);
+}
+
+/*--------------------------------------------------------------------------*/
+/* RX DMA channel ISR body. Half or all of the receive region has been
+filled. */
+
+static void rx_dma_isr(serial_port_t *port)
+{
+	if (dma_get_interrupt_flag(DMA1, port->rx_channel, DMA_HTIF | DMA_TCIF))
+	{
+		dma_clear_interrupt_flags(DMA1, port->rx_channel, DMA_HTIF | DMA_TCIF);
+		if (rx_take(port) > 0 && port->rx_notify != 0) port->rx_notify();
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/* DMA and USART ISRs of each port */
+
+#ifdef SERIAL_USART1_DMA
+void dma1_channel4_isr(void)
+{
+	ISR_PROFILE_ENTER(ISR_PROFILE_SERIAL_TX);
+	tx_dma_isr(&serial_usart1);
+	ISR_PROFILE_EXIT(ISR_PROFILE_SERIAL_TX);
+}
+
+void dma1_channel5_isr(void)
+{
+	ISR_PROFILE_ENTER(ISR_PROFILE_SERIAL_RX);
+	rx_dma_isr(&serial_usart1);
+	ISR_PROFILE_EXIT(ISR_PROFILE_SERIAL_RX);
+}
+#endif
+
+#ifdef SERIAL_USART2
+void dma1_channel7_isr(void)
+{
+	tx_dma_isr(&serial_usart2);
+}
+
+void dma1_channel6_isr(void)
+{
+	rx_dma_isr(&serial_usart2);
+}
+
+void usart2_isr(void)
+{
+	serial_port_isr(&serial_usart2);
+}
+#endif
+
+#ifdef SERIAL_USART3
+void dma1_channel2_isr(void)
+{
+	tx_dma_isr(&serial_usart3);
+}
+
+void dma1_channel3_isr(void)
+{
+	rx_dma_isr(&serial_usart3);
+}
+
+void usart3_isr(void)
+{
+	serial_port_isr(&serial_usart3);
+}
+#endif
+
+/*--------------------------------------------------------------------------*/
+/* The original USART1 interface */
+
+void serial_tx_init(uint8_t buffer[])
+{
+	serial_port_tx_init(&serial_usart1, buffer);
+}
+
+void serial_tx_init_ring(ring_buffer_t *ring)
+{
+	serial_port_tx_init_ring(&serial_usart1, ring);
+}
+
+void serial_tx_start(void)
+{
+	serial_port_tx_start(&serial_usart1);
+}
+
+bool serial_tx_busy(void)
+{
+	return serial_port_tx_busy(&serial_usart1);
+}
+
+void serial_tx_flush(void)
+{
+	serial_port_tx_flush(&serial_usart1);
+}
+
+uint32_t serial_printf(const char *format, ...)
+{
+	va_list args;
+	uint32_t n;
+	va_start(args, format);
+	if (serial_usart1.tx_ring != 0)
+		n = vformat_ring(serial_usart1.tx_ring, format, args);
+	else n = vformat_buffer(serial_usart1.tx_buffer, format, args);
+	va_end(args);
+	serial_tx_start();
+	return n;
+}
+
+void serial_rx_init(uint8_t buffer[])
+{
+	serial_port_rx_init(&serial_usart1, buffer);
+}
+
+void serial_rx_init_ring(ring_buffer_t *ring)
+{
+	serial_port_rx_init_ring(&serial_usart1, ring);
+}
+
+void serial_rx_update(void)
+{
+	serial_port_rx_update(&serial_usart1);
+}
+
+void serial_rx_notify(void (*notify)(void))
+{
+	serial_port_rx_notify(&serial_usart1, notify);
+}
+
+/* Call from usart1_isr */
+void serial_rx_idle_isr(void)
+{
+	serial_port_isr(&serial_usart1);
+}
@@ -0,0 +1,87 @@
+/*	USART DMA Serial Driver
+
+Transmission and reception of circular buffers on USART1, USART2 and USART3 by
+DMA or by interrupt for the STM32F1.
+
+14 October 2026
+*/
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "buffer.h"
+
+/* Transfer modes given to serial_port_setup. Each direction not by DMA is by
+interrupt. */
+#define SERIAL_TX_DMA   0x01
+#define SERIAL_RX_DMA   0x02
+
+typedef struct {
+/* Hardware of the port */
+	uint32_t usart;
+	uint32_t usart_clock;           /* enum rcc_periph_clken */
+	uint32_t gpio;
+	uint32_t gpio_clock;
+	uint16_t tx_pin;
+	uint16_t rx_pin;
+	uint8_t irq;
+	uint8_t tx_channel;             /* DMA1 channels */
+	uint8_t rx_channel;
+	uint8_t tx_irq;
+	uint8_t rx_irq;
+/* Configuration */
+	uint8_t mode;
+	uint32_t baudrate;
+/* Send buffer (one of these is set) and the length of the block in flight,
+zero when idle */
+	uint8_t *tx_buffer;
+	ring_buffer_t *tx_ring;
+	volatile uint32_t tx_length;
+/* Receive buffer (one of these is set), its DMA region and the DMA position
+last taken */
+	uint8_t *rx_buffer;
+	ring_buffer_t *rx_ring;
+	uint8_t *rx_data;
+	uint32_t rx_size;
+	uint32_t rx_last;
+/* Called from the receive interrupts when new data is in the buffer */
+	void (*rx_notify)(void);
+} serial_port_t;
+
+extern serial_port_t serial_usart1;
+#ifdef SERIAL_USART2
+extern serial_port_t serial_usart2;
+#endif
+#ifdef SERIAL_USART3
+extern serial_port_t serial_usart3;
+#endif
+
+void serial_port_setup(serial_port_t *port, uint32_t baudrate, uint8_t mode);
+void serial_port_tx_init(serial_port_t *port, uint8_t buffer[]);
+void serial_port_tx_init_ring(serial_port_t *port, ring_buffer_t *ring);
+void serial_port_tx_start(serial_port_t *port);
+bool serial_port_tx_busy(serial_port_t *port);
+void serial_port_tx_flush(serial_port_t *port);
+uint32_t serial_port_printf(serial_port_t *port, const char *format, ...);
+void serial_port_rx_init(serial_port_t *port, uint8_t buffer[]);
+void serial_port_rx_init_ring(serial_port_t *port, ring_buffer_t *ring);
+void serial_port_rx_update(serial_port_t *port);
+void serial_port_rx_notify(serial_port_t *port, void (*notify)(void));
+void serial_port_isr(serial_port_t *port);
+
+/* USART1 */
+void serial_tx_init(uint8_t buffer[]);
+void serial_tx_init_ring(ring_buffer_t *ring);
+void serial_tx_start(void);
+bool serial_tx_busy(void);
+void serial_tx_flush(void);
+uint32_t serial_printf(const char *format, ...);
+void serial_rx_init(uint8_t buffer[]);
+void serial_rx_init_ring(ring_buffer_t *ring);
+void serial_rx_update(void);
+void serial_rx_idle_isr(void);
+void serial_rx_notify(void (*notify)(void));
+
+#endif
@@ -0,0 +1,536 @@
+/*	Command Shell
+
+A command line on the serial.c receive and send buffers, for the test
+programs. shell_poll is called from the main loop and never waits: it takes
+the characters received, edits the line and runs a command once the line is
+entered.
+
+The line is edited with backspace, and Ctrl-C abandons it. The last
+SHELL_HISTORY lines entered are recalled with the up and down arrow keys (or
+Ctrl-P and Ctrl-N), which redraw the line in place. A line longer than
+SHELL_LINE_LEN rings the bell rather than overrunning.
+
+The line is split at spaces into words, and the first is looked up in the
+table of commands given to shell_init, then among the built in commands: help
+and history, buffers for the high water, overflows and underruns of the two
+serial buffers when built with BUFFER_STATS, tasks for the CPU load and
+stack of each FreeRTOS task when built with RTOS_STATS, and isr for the time
+taken by each interrupt handler when built with ISR_PROFILE. The handler is
+given the words and returns SHELL_DONE when it has finished. A command that
+takes longer returns SHELL_BUSY and is called again on each later poll, with
+the step counted and a state word of its own, so that it does a little work or
+sends a line at a time and the main loop goes on meanwhile. Ctrl-C while a
+command runs calls it once more with cancel set to clean up, and other input
+is discarded until it is done.
+
+Output is by serial_printf. A command sending much should send only while
+shell_output_room says that the send buffer has space, and otherwise return
+SHELL_BUSY to send the rest later.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "buffer.h"
+#include "serial.h"
+#include "shell.h"
+#ifdef RTOS_STATS
+#include "rtos_stats.h"
+#endif
+#ifdef ISR_PROFILE
+#include "isr_profile.h"
+#endif
+
+#define CTRL_C              0x03
+#define CTRL_N              0x0E
+#define CTRL_P              0x10
+#define BACKSPACE           0x08
+#define DELETE              0x7F
+#define ESCAPE              0x1B
+
+static uint8_t *rx_buffer;
+static uint8_t *tx_buffer;
+static const shell_command_t *commands;
+static uint8_t command_count;
+static const char *prompt;
+
+/* Line being edited, and the copy split into words for the command */
+static char line[SHELL_LINE_LEN];
+static uint8_t length;
+static bool entered;
+static char words[SHELL_LINE_LEN];
+
+/* Lines entered, newest at history_newest, and the one recalled counting
+back from 1, or 0 for a new line */
+static char history[SHELL_HISTORY][SHELL_LINE_LEN];
+static uint8_t history_count;
+static uint8_t history_newest;
+static uint8_t recall;
+
+/* Escape sequence state: 1 after ESC, 2 after ESC [, 3 in a number after it */
+static uint8_t escape;
+
+static const shell_command_t *running;
+static shell_call_t call;
+
+static shell_status_t help(shell_call_t *call);
+static shell_status_t list_history(shell_call_t *call);
+#ifdef BUFFER_STATS
+static shell_status_t buffers(shell_call_t *call);
+#endif
+#ifdef RTOS_STATS
+static shell_status_t tasks(shell_call_t *call);
+static rtos_stats_t task_stats;
+#endif
+#ifdef ISR_PROFILE
+static shell_status_t isr(shell_call_t *call);
+#endif
+
+static const shell_command_t builtins[] = {
+	{"help",    "",     "list the commands",        help},
+	{"history", "",     "list the lines entered",   list_history},
+#ifdef BUFFER_STATS
+	{"buffers", "",     "serial buffer statistics", buffers},
+#endif
+#ifdef RTOS_STATS
+	{"tasks",   "",     "task load and stack",      tasks},
+#endif
+#ifdef ISR_PROFILE
+	{"isr",     "[clear]", "interrupt cycles min/mean/max", isr},
+#endif
+};
+#define BUILTIN_COUNT   (sizeof(builtins)/sizeof(builtins[0]))
+
+static void edit(char character);
+static void show(const char *text);
+static void recall_line(int8_t direction);
+static void remember(void);
+static void execute(void);
+static void run(void);
+static const shell_command_t *command(uint8_t index);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the Shell
+
+The prompt is sent at once.
+
+@param[in] receive_buffer: serial.c receive buffer.
+@param[in] send_buffer: serial.c send buffer.
+@param[in] table: commands, which must remain in existence.
+@param[in] count: number of commands.
+@param[in] text: prompt.
+*/
+
+void shell_init(uint8_t receive_buffer[], uint8_t send_buffer[],
+                const shell_command_t *table, uint8_t count,
+                const char *text)
+{
+	rx_buffer = receive_buffer;
+	tx_buffer = send_buffer;
+	commands = table;
+	command_count = count;
+	prompt = text;
+	length = 0;
+	entered = false;
+	history_count = 0;
+	history_newest = 0;
+	recall = 0;
+	escape = 0;
+	running = 0;
+	serial_printf("%s", prompt);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Poll the Shell
+
+Called from the main loop. Takes the characters received and runs a step of
+the command in progress.
+*/
+
+void shell_poll(void)
+{
+	if (running != 0)
+	{
+		while (buffer_input_available(rx_buffer))
+			if ((buffer_get(rx_buffer) & 0xFF) == CTRL_C) call.cancel = true;
+		run();
+		return;
+	}
+	while (! entered && buffer_input_available(rx_buffer))
+		edit((char) buffer_get(rx_buffer));
+	if (entered)
+	{
+		entered = false;
+		execute();
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check for a Command Running
+
+@returns true while a command has returned SHELL_BUSY.
+*/
+
+bool shell_busy(void)
+{
+	return (running != 0);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check for Room to Send
+
+@param[in] count: characters to be sent.
+@returns true if the send buffer has space for them.
+*/
+
+bool shell_output_room(uint16_t count)
+{
+	return (buffer_space(tx_buffer) >= count);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Number in an Argument
+
+@param[in] text: decimal number, or hex following 0x.
+@returns the value, up to the first character that is not a digit.
+*/
+
+uint32_t shell_number(const char *text)
+{
+	uint32_t number = 0;
+	if ((text[0] == '0') && ((text[1] == 'x') || (text[1] == 'X')))
+	{
+		for (text += 2;; text++)
+		{
+			char c = *text;
+			if ((c >= '0') && (c <= '9')) number = number*16 + (c - '0');
+			else if ((c >= 'a') && (c <= 'f')) number = number*16 + (c - 'a' + 10);
+			else if ((c >= 'A') && (c <= 'F')) number = number*16 + (c - 'A' + 10);
+			else break;
+		}
+	}
+	else
+		while ((*text >= '0') && (*text <= '9'))
+			number = number*10 + (*text++ - '0');
+	return number;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Edit the line with a character received, echoing it. */
+
+static void edit(char character)
+{
+	if (escape == 1)
+	{
+		escape = (character == '[') ? 2 : 0;
+		return;
+	}
+	if (escape == 2)
+	{
+		escape = 0;
+		if (character == 'A') recall_line(1);
+		else if (character == 'B') recall_line(-1);
+/* A numbered key such as Delete, ESC [ 3 ~, ends at its final character */
+		else if ((character >= '0') && (character <= '9')) escape = 3;
+		return;
+	}
+	if (escape == 3)
+	{
+		if ((character < '0') || (character > '9')) escape = 0;
+		return;
+	}
+	switch (character)
+	{
+	case ESCAPE:
+		escape = 1;
+		break;
+	case '\r':
+		line[length] = 0;
+		entered = true;
+		serial_printf("\r\n");
+		break;
+	case '\n':
+		break;
+	case BACKSPACE:
+	case DELETE:
+		if (length > 0)
+		{
+			length--;
+			serial_printf("\b \b");
+		}
+		break;
+	case CTRL_C:
+		length = 0;
+		recall = 0;
+		serial_printf("^C\r\n%s", prompt);
+		break;
+	case CTRL_P:
+		recall_line(1);
+		break;
+	case CTRL_N:
+		recall_line(-1);
+		break;
+	default:
+		if ((character < ' ') || (character > '~')) break;
+		if (length < SHELL_LINE_LEN - 1)
+		{
+			line[length++] = character;
+			serial_printf("%c", character);
+		}
+		else serial_printf("\a");
+		break;
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/* Replace the line with a text and redraw it, clearing to the end. */
+
+static void show(const char *text)
+{
+	for (length = 0; text[length] != 0; length++) line[length] = text[length];
+	line[length] = 0;
+	serial_printf("\r%s%s\x1b[K", prompt, line);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Step through the history, 1 to older lines and -1 to newer. Stepping past
+the newest gives an empty line. */
+
+static void recall_line(int8_t direction)
+{
+	if (direction > 0)
+	{
+		if (recall >= history_count) return;
+		recall++;
+	}
+	else
+	{
+		if (recall == 0) return;
+		recall--;
+	}
+	if (recall == 0) show("");
+	else show(history[(history_newest + SHELL_HISTORY - (recall - 1)) %
+	                  SHELL_HISTORY]);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Keep the line entered unless it is empty or repeats the last. */
+
+static void remember(void)
+{
+	uint8_t i;
+	if (length == 0) return;
+	if (history_count > 0)
+	{
+		const char *last = history[history_newest];
+		for (i = 0; (i <= length) && (last[i] == line[i]); i++);
+		if (i > length) return;
+	}
+	if (history_count > 0) history_newest = (history_newest + 1) % SHELL_HISTORY;
+	for (i = 0; i <= length; i++) history[history_newest][i] = line[i];
+	if (history_count < SHELL_HISTORY) history_count++;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Split the line into words, find the command and start it. */
+
+static void execute(void)
+{
+	uint8_t i;
+	bool in_word = false;
+
+	remember();
+	recall = 0;
+	call.argc = 0;
+	for (i = 0; i <= length; i++)
+	{
+		char c = (i < length) ? line[i] : 0;
+		if ((c == ' ') || (c == 0))
+		{
+			words[i] = 0;
+			in_word = false;
+		}
+		else
+		{
+			words[i] = c;
+			if (! in_word)
+			{
+				if (call.argc == SHELL_MAX_ARGS)
+				{
+					serial_printf("Too many arguments\r\n%s", prompt);
+					length = 0;
+					return;
+				}
+				call.argv[call.argc++] = &words[i];
+				in_word = true;
+			}
+		}
+	}
+	length = 0;
+	if (call.argc == 0)
+	{
+		serial_printf("%s", prompt);
+		return;
+	}
+	for (i = 0; i < command_count + BUILTIN_COUNT; i++)
+	{
+		const shell_command_t *candidate = command(i);
+		const char *name = candidate->name;
+		const char *word = call.argv[0];
+		while ((*name != 0) && (*name == *word))
+		{
+			name++;
+			word++;
+		}
+		if ((*name == 0) && (*word == 0)) break;
+	}
+	if (i == command_count + BUILTIN_COUNT)
+	{
+		serial_printf("Unknown command %s, help for a list\r\n%s",
+		              call.argv[0], prompt);
+		return;
+	}
+	running = command(i);
+	call.step = 0;
+	call.state = 0;
+	call.cancel = false;
+	run();
+}
+
+/*--------------------------------------------------------------------------*/
+/* Run a step of the command, ending it when it is done or cancelled. */
+
+static void run(void)
+{
+	shell_status_t status = running->handler(&call);
+	call.step++;
+	if ((status == SHELL_DONE) || call.cancel)
+	{
+		running = 0;
+		serial_printf("%s", prompt);
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/* Command by index, the table then the built in commands. */
+
+static const shell_command_t *command(uint8_t index)
+{
+	if (index < command_count) return &commands[index];
+	return &builtins[index - command_count];
+}
+
+/*--------------------------------------------------------------------------*/
+/* Built in help, a line at a time as the send buffer allows. */
+
+static shell_status_t help(shell_call_t *call)
+{
+	if (call->cancel) return SHELL_DONE;
+	while (call->state < (uint32_t) (command_count + BUILTIN_COUNT))
+	{
+		if (! shell_output_room(SHELL_LINE_LEN)) return SHELL_BUSY;
+		const shell_command_t *entry = command((uint8_t) call->state++);
+		serial_printf("%-8s %-8s %s\r\n", entry->name, entry->args,
+		              entry->help);
+	}
+	return SHELL_DONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Built in history, oldest first. */
+
+static shell_status_t list_history(shell_call_t *call)
+{
+	if (call->cancel) return SHELL_DONE;
+	while (call->state < history_count)
+	{
+		if (! shell_output_room(SHELL_LINE_LEN + 4)) return SHELL_BUSY;
+		uint8_t back = history_count - 1 - (uint8_t) call->state++;
+		serial_printf("%u %s\r\n", history_count - back,
+		              history[(history_newest + SHELL_HISTORY - back) %
+		                      SHELL_HISTORY]);
+	}
+	return SHELL_DONE;
+}
+
+#ifdef BUFFER_STATS
+/*--------------------------------------------------------------------------*/
+/* Built in buffer statistics: high water, overflows and underruns. */
+
+static shell_status_t buffers(shell_call_t *call)
+{
+	buffer_stats_t rx, tx;
+	(void) call;
+	buffer_read_stats(rx_buffer, &rx);
+	buffer_read_stats(tx_buffer, &tx);
+	serial_printf("RX %u %u %u TX %u %u %u\r\n",
+	              rx.high_water, rx.overflows, rx.underruns,
+	              tx.high_water, tx.overflows, tx.underruns);
+	return SHELL_DONE;
+}
+#endif
+
+#ifdef RTOS_STATS
+/*--------------------------------------------------------------------------*/
+/* Built in task statistics, taken on the first call and sent a task at a
+time. The load is in tenths of a percent since the last update. */
+
+static shell_status_t tasks(shell_call_t *call)
+{
+	if (call->cancel) return SHELL_DONE;
+	if (call->step == 0)
+	{
+		rtos_stats_update(&task_stats);
+		if (! shell_output_room(SHELL_LINE_LEN)) return SHELL_BUSY;
+		serial_printf("Heap %u min %u\r\n", task_stats.heap_free,
+		              task_stats.heap_min_free);
+	}
+	while (call->state < task_stats.count)
+	{
+		if (! shell_output_room(SHELL_LINE_LEN)) return SHELL_BUSY;
+		const rtos_task_stats_t *task = &task_stats.task[call->state++];
+		serial_printf("%-8s %2u %u %4u.%u%% %u\r\n", task->name,
+		              task->number, task->priority, task->cpu/10,
+		              task->cpu%10, task->stack_free);
+	}
+	return SHELL_DONE;
+}
+#endif
+
+#ifdef ISR_PROFILE
+/*--------------------------------------------------------------------------*/
+/* Built in interrupt profile, a line for each vector entered and a line of
+the histogram of its duration, each sent when there is room. With the
+argument clear the profiles are cleared instead. */
+
+static shell_status_t isr(shell_call_t *call)
+{
+	char text[SHELL_LINE_LEN];
+	if (call->cancel) return SHELL_DONE;
+	if ((call->argc > 1) && (call->argv[1][0] == 'c'))
+	{
+		isr_profile_clear();
+		return SHELL_DONE;
+	}
+	while (call->state < 2*ISR_PROFILE_SLOTS)
+	{
+		if (! shell_output_room(SHELL_LINE_LEN + 8)) return SHELL_BUSY;
+		isr_profile_slot_t slot = (isr_profile_slot_t) (call->state / 2);
+		if ((call->state++ & 1) == 0)
+		{
+			if (isr_profile_format(text, sizeof(text), slot) > 0)
+				serial_printf("%s", text);
+			else call->state++;
+		}
+		else
+		{
+			isr_profile_t profile;
+			isr_profile_read(slot, &profile);
+			isr_profile_format_bins(text, sizeof(text), &profile.duration);
+			serial_printf("       %s", text);
+		}
+	}
+	return SHELL_DONE;
+}
+#endif
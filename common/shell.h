@@ -0,0 +1,61 @@
+/*	Command Shell
+
+Line editing with history, a table of commands with tokenised arguments and
+help, and commands that run a step at a time from the main loop, over the
+serial.c buffers.
+
+15 October 2026
+*/
+
+#ifndef SHELL_H
+#define SHELL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Longest line, including its terminator */
+#ifndef SHELL_LINE_LEN
+#define SHELL_LINE_LEN      80
+#endif
+
+/* Most words in a line, the command name included */
+#define SHELL_MAX_ARGS      8
+
+/* Lines kept for recall */
+#ifndef SHELL_HISTORY
+#define SHELL_HISTORY       4
+#endif
+
+/* Returned by a handler: finished, or to be called again */
+typedef enum {
+	SHELL_DONE,
+	SHELL_BUSY
+} shell_status_t;
+
+/* A command being run. The arguments stay in place until it is done. */
+typedef struct {
+	uint8_t argc;
+	char *argv[SHELL_MAX_ARGS];
+	uint32_t step;          /* 0 on the first call, then counted */
+	uint32_t state;         /* for the handler's own use, starts at 0 */
+	bool cancel;            /* last call after Ctrl-C, to clean up */
+} shell_call_t;
+
+typedef shell_status_t (*shell_handler_t)(shell_call_t *call);
+
+typedef struct {
+	const char *name;
+	const char *args;       /* argument synopsis for the help */
+	const char *help;
+	shell_handler_t handler;
+} shell_command_t;
+
+void shell_init(uint8_t receive_buffer[], uint8_t send_buffer[],
+                const shell_command_t *commands, uint8_t count,
+                const char *prompt);
+void shell_poll(void);
+bool shell_busy(void);
+bool shell_output_room(uint16_t length);
+uint32_t shell_number(const char *text);
+
+#endif
@@ -0,0 +1,369 @@
+/*	Software Timers
+
+Timers for several protocol stacks and the application share one hardware
+timer, TIM4, which counts 1us ticks over its full 16 bit range. Its overflows
+are counted in software to give a 32 bit timebase, and output compare 1 is set
+for the next time the timers need attention, so there is one interrupt for all
+of them and none while they are idle other than the overflow every 65ms.
+
+The timers are kept in a hierarchical timing wheel of SOFT_TIMER_LEVELS levels
+of 32 slots. Level 0 has a slot for each tick, level 1 for each 32 ticks and so
+on, covering 2^25 ticks (33s), and a timer goes in the lowest level at which
+its expiry and the time of the wheel differ. A timer further away waits in a
+far list until the top level comes round again. Each slot is a doubly linked
+list, so a timer is started and stopped in constant time whatever the number
+running, and a bitmap of the occupied slots of each level gives the next slot
+due with a count of trailing zeros. As the time reaches a slot of a higher
+level, its timers are put back in the wheel at the levels below, so each is
+moved at most once a level. The timers of a level 0 slot have expired, and
+their callbacks are called from the interrupt. A periodic timer is restarted
+from its expiry rather than from the time of the interrupt, so it does not
+drift.
+
+The timers are started and stopped with interrupts masked, so this may be done
+from any interrupt or from a callback.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+#include "soft_timer.h"
+
+#define SOFT_TIMER_LEVELS   5
+#define SLOT_BITS           5
+#define SLOTS               (1 << SLOT_BITS)
+#define WHEEL_BITS          (SOFT_TIMER_LEVELS*SLOT_BITS)
+/* Lists after the wheel slots: expired timers, and those beyond the wheel */
+#define LIST_DUE            (SOFT_TIMER_LEVELS*SLOTS)
+#define LIST_FAR            (LIST_DUE + 1)
+
+static soft_timer_t *lists[LIST_FAR + 1];
+static uint32_t occupied[SOFT_TIMER_LEVELS];
+/* Time up to which the wheel has been moved on */
+static uint32_t wheel_time;
+/* High 16 bits of the timebase */
+static volatile uint16_t overflows;
+static bool started = false;
+
+static void insert(soft_timer_t *timer);
+static void unlink(soft_timer_t *timer);
+static bool next_event(uint32_t *time);
+static void service(void);
+static void arm(void);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the Timebase
+
+TIM4 is set to count 1us ticks from the APB1 timer clock. Each user of the
+timers may call this, and only the first call has an effect.
+*/
+
+void soft_timer_init(void)
+{
+	uint32_t timer_clock = rcc_apb1_frequency;
+	bool masked = cm_mask_interrupts(true);
+	if (started)
+	{
+		cm_mask_interrupts(masked);
+		return;
+	}
+	started = true;
+/* The timer clock is twice the APB1 clock if APB1 is divided down */
+	if (((RCC_CFGR >> RCC_CFGR_PPRE1_SHIFT) & 0x7) != RCC_CFGR_PPRE1_HCLK_NODIV)
+		timer_clock *= 2;
+	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM4EN);
+	nvic_enable_irq(NVIC_TIM4_IRQ);
+	timer_reset(TIM4);
+	timer_set_mode(TIM4, TIM_CR1_CKD_CK_INT,
+		       TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+	timer_set_prescaler(TIM4, timer_clock/SOFT_TIMER_TICK_HZ - 1);
+	timer_set_period(TIM4, 0xFFFF);
+	timer_disable_oc_output(TIM4, TIM_OC1 | TIM_OC2 | TIM_OC3 | TIM_OC4);
+	timer_set_oc_mode(TIM4, TIM_OC1, TIM_OCM_FROZEN);
+	timer_continuous_mode(TIM4);
+	overflows = 0;
+	wheel_time = 0;
+	timer_clear_flag(TIM4, TIM_SR_UIF | TIM_SR_CC1IF);
+	timer_enable_irq(TIM4, TIM_DIER_UIE);
+	timer_enable_counter(TIM4);
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Read the Timebase
+
+An overflow that has happened but not yet been counted, because its interrupt
+is held off, is allowed for.
+
+@returns the time in ticks, wrapping at 32 bits.
+*/
+
+uint32_t soft_timer_now(void)
+{
+	uint16_t high;
+	uint32_t now;
+	do
+	{
+		high = overflows;
+		now = ((uint32_t) high << 16) | timer_get_counter(TIM4);
+		if (timer_get_flag(TIM4, TIM_SR_UIF))
+			now = ((uint32_t) (high + 1) << 16) | timer_get_counter(TIM4);
+	}
+	while (high != overflows);
+	return now;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set up a Timer
+
+@param[in] timer: timer to set up, stopped.
+@param[in] callback: called from the timer interrupt when the timer expires.
+@param[in] context: for the callback, as timer->context.
+*/
+
+void soft_timer_create(soft_timer_t *timer, soft_timer_callback_t callback,
+		       void *context)
+{
+	timer->next = 0;
+	timer->link = 0;
+	timer->period = 0;
+	timer->callback = callback;
+	timer->context = context;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start a Timer
+
+A running timer is restarted.
+
+@param[in] timer: timer to start.
+@param[in] delay: ticks from now to the first expiry, up to 2^31.
+@param[in] period: ticks between later expiries, or 0 for a one shot timer.
+*/
+
+void soft_timer_start(soft_timer_t *timer, uint32_t delay, uint32_t period)
+{
+	bool masked = cm_mask_interrupts(true);
+	if (timer->link != 0) unlink(timer);
+	timer->expiry = soft_timer_now() + delay;
+	timer->period = period;
+	insert(timer);
+	arm();
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start a One Shot Timer at a Given Time
+
+A time already past expires at once.
+
+@param[in] timer: timer to start. A running timer is restarted.
+@param[in] expiry: time in ticks, within 2^31 of now.
+*/
+
+void soft_timer_start_at(soft_timer_t *timer, uint32_t expiry)
+{
+	bool masked = cm_mask_interrupts(true);
+	if (timer->link != 0) unlink(timer);
+	timer->expiry = expiry;
+	timer->period = 0;
+	insert(timer);
+	arm();
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Stop a Timer
+
+@param[in] timer: timer to stop. A stopped timer is left alone.
+*/
+
+void soft_timer_stop(soft_timer_t *timer)
+{
+	bool masked = cm_mask_interrupts(true);
+	if (timer->link != 0) unlink(timer);
+	timer->period = 0;
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Test if a Timer is Running
+
+@param[in] timer: timer to test.
+@returns true if the timer is waiting to expire.
+*/
+
+bool soft_timer_active(const soft_timer_t *timer)
+{
+	return (timer->link != 0);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Put a timer in the list for its expiry. The level is that of the highest
+slot bits in which the expiry differs from the wheel time, so the slot is
+always ahead of the wheel at that level. */
+
+static void insert(soft_timer_t *timer)
+{
+	uint32_t differ = timer->expiry ^ wheel_time;
+	uint8_t list;
+	if ((int32_t) (timer->expiry - wheel_time) <= 0) list = LIST_DUE;
+	else if ((differ >> WHEEL_BITS) != 0) list = LIST_FAR;
+	else
+	{
+		uint8_t level = (31 - __builtin_clz(differ)) / SLOT_BITS;
+		uint8_t slot = (timer->expiry >> (level*SLOT_BITS)) & (SLOTS - 1);
+		occupied[level] |= 1UL << slot;
+		list = level*SLOTS + slot;
+	}
+	timer->list = list;
+	timer->next = lists[list];
+	if (timer->next != 0) timer->next->link = &timer->next;
+	timer->link = &lists[list];
+	lists[list] = timer;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Take a timer out of its list, marking the slot empty if it was the last. */
+
+static void unlink(soft_timer_t *timer)
+{
+	*timer->link = timer->next;
+	if (timer->next != 0) timer->next->link = timer->link;
+	timer->link = 0;
+	if ((timer->list < LIST_DUE) && (lists[timer->list] == 0))
+		occupied[timer->list / SLOTS] &= ~(1UL << (timer->list % SLOTS));
+}
+
+/*--------------------------------------------------------------------------*/
+/* Find the next time the wheel needs attention: now if any timers have
+expired, otherwise the start of the next occupied slot. This is at the lowest
+level with a slot ahead of the wheel time, as a level is all within the
+current slot of the level above. Failing that, the far timers are looked at
+again when the top level comes round. */
+
+static bool next_event(uint32_t *time)
+{
+	uint8_t level;
+	if (lists[LIST_DUE] != 0)
+	{
+		*time = wheel_time;
+		return true;
+	}
+	for (level = 0; level < SOFT_TIMER_LEVELS; level++)
+	{
+		uint8_t shift = level*SLOT_BITS;
+		uint8_t current = (wheel_time >> shift) & (SLOTS - 1);
+		uint32_t ahead = occupied[level] & (0xFFFFFFFE << current);
+		if (ahead != 0)
+		{
+			uint32_t span = 1UL << (shift + SLOT_BITS);
+			*time = (wheel_time & ~(span - 1)) |
+				((uint32_t) __builtin_ctz(ahead) << shift);
+			return true;
+		}
+	}
+	if (lists[LIST_FAR] != 0)
+	{
+		*time = (wheel_time | ((1UL << WHEEL_BITS) - 1)) + 1;
+		return true;
+	}
+	return false;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Move the wheel on to the present time, calling back expired timers. At each
+slot start on the way, the timers of the slots reached at the higher levels are
+put back in the wheel below, and those of the level 0 slot have expired. */
+
+static void service(void)
+{
+	uint32_t now = soft_timer_now();
+	uint32_t time;
+	soft_timer_t *timer;
+	while (true)
+	{
+		while ((timer = lists[LIST_DUE]) != 0)
+		{
+			unlink(timer);
+			if (timer->period != 0)
+			{
+				timer->expiry += timer->period;
+				insert(timer);
+			}
+			timer->callback(timer);
+		}
+		if (! next_event(&time) || ((int32_t) (time - now) > 0)) break;
+		wheel_time = time;
+/* The far list is taken whole, as timers still beyond the wheel go back in it */
+		if ((time & ((1UL << WHEEL_BITS) - 1)) == 0)
+		{
+			soft_timer_t *far = lists[LIST_FAR];
+			lists[LIST_FAR] = 0;
+			while ((timer = far) != 0)
+			{
+				far = timer->next;
+				timer->link = 0;
+				insert(timer);
+			}
+		}
+		int8_t level;
+		for (level = SOFT_TIMER_LEVELS - 1; level >= 0; level--)
+		{
+			uint8_t shift = level*SLOT_BITS;
+			if ((time & ((1UL << shift) - 1)) != 0) continue;
+			uint8_t list = level*SLOTS + ((time >> shift) & (SLOTS - 1));
+			while ((timer = lists[list]) != 0)
+			{
+				unlink(timer);
+				insert(timer);
+			}
+		}
+	}
+	wheel_time = now;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Set the compare for the next event if it falls within one counter period,
+otherwise leave it to the overflow interrupt. An event already due forces the
+compare interrupt, so that it is not missed. */
+
+static void arm(void)
+{
+	uint32_t time;
+	timer_disable_irq(TIM4, TIM_DIER_CC1IE);
+	if (! next_event(&time)) return;
+	if ((int32_t) (time - soft_timer_now()) >= 0x10000) return;
+	timer_set_oc_value(TIM4, TIM_OC1, time & 0xFFFF);
+	timer_clear_flag(TIM4, TIM_SR_CC1IF);
+	timer_enable_irq(TIM4, TIM_DIER_CC1IE);
+	if ((int32_t) (time - soft_timer_now()) <= 0)
+		timer_generate_event(TIM4, TIM_EGR_CC1G);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Timer Interrupt
+
+Count the overflows and move the wheel on at each, so that its time never
+falls far behind, and at each compare. Then set the compare for the next
+event.
+*/
+
+void tim4_isr(void)
+{
+	if (timer_get_flag(TIM4, TIM_SR_UIF))
+	{
+		timer_clear_flag(TIM4, TIM_SR_UIF);
+		overflows++;
+	}
+	timer_clear_flag(TIM4, TIM_SR_CC1IF);
+	service();
+	arm();
+/* Reread to force the previous write before leaving */
+	timer_get_flag(TIM4, TIM_SR_UIF);
+}
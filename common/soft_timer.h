@@ -0,0 +1,40 @@
+/*	Software Timers
+
+Any number of one shot and periodic timers of 1us resolution on one free
+running hardware timer, TIM4, kept in a hierarchical timing wheel.
+
+14 October 2026
+*/
+
+#ifndef SOFT_TIMER_H
+#define SOFT_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Rate of the timebase */
+#define SOFT_TIMER_TICK_HZ  1000000
+
+struct soft_timer;
+typedef void (*soft_timer_callback_t)(struct soft_timer *timer);
+
+typedef struct soft_timer {
+	struct soft_timer *next;
+	struct soft_timer **link;       /* pointer to this timer, 0 if stopped */
+	uint32_t expiry;                /* time it goes off, in ticks */
+	uint32_t period;                /* reload, 0 for a one shot timer */
+	soft_timer_callback_t callback; /* called from the timer interrupt */
+	void *context;                  /* for the callback */
+	uint8_t list;                   /* wheel slot holding the timer */
+} soft_timer_t;
+
+void soft_timer_init(void);
+uint32_t soft_timer_now(void);
+void soft_timer_create(soft_timer_t *timer, soft_timer_callback_t callback,
+		       void *context);
+void soft_timer_start(soft_timer_t *timer, uint32_t delay, uint32_t period);
+void soft_timer_start_at(soft_timer_t *timer, uint32_t expiry);
+void soft_timer_stop(soft_timer_t *timer);
+bool soft_timer_active(const soft_timer_t *timer);
+
+#endif
@@ -0,0 +1,411 @@
+/*	SPI DMA Transaction Queue
+
+DMA transfers on SPI1 and SPI2 for the STM32F1, queued so that several devices
+on one bus can be served back to back without the CPU.
+
+Each bus is described by spi_bus1 or spi_bus2, holding its peripheral, pins
+and DMA channels and the queue of transactions. SPI1 and SPI2 are only built
+when SPI_BUS1 and SPI_BUS2 are defined, as their DMA channels are shared with
+USART3 and USART1 in serial.c.
+
+    SPI     SCK MISO MOSI      TX DMA       RX DMA
+    1       PA5 PA6 PA7        channel 3    channel 2
+    2       PB13 PB14 PB15     channel 5    channel 4
+
+A transaction gives the frames to send and the buffer for the frames received,
+their number and size, a GPIO pin used as an active low chip select, and a
+callback. spi_bus_submit appends it to the queue of the bus and starts it at
+once if the bus is idle. The two DMA channels are set up once by spi_bus_setup
+and stay configured, so a transaction only loads the memory addresses and
+count and enables the channels. The RX channel finishes last, when the final
+frame has been clocked in, and its transfer complete interrupt ends the
+transaction: the chip select is released, the next transaction in the queue is
+started, and then the callback of the finished one is called. The callback
+runs in interrupt context and may submit further transactions. The caller
+keeps each transaction and its buffers until done is set.
+
+The SPI only clocks when a frame is written to it, so a receive only
+transaction, without a transmit buffer, has the TX channel send a single
+constant dummy frame of all ones over and over with the memory increment
+off, as an SD card expects while it is read. No transmit buffer of dummy
+frames is needed. A transmit only transaction, without a receive buffer, has
+the RX channel read every frame into one discarded frame in the same way, so
+that the SPI does not overrun and the transfer complete interrupt still marks
+the end of the transaction.
+
+Each transaction is of 8 or 16 bit frames. The SPI frame format can only be
+changed with the SPI disabled, so when it differs from that of the previous
+transaction the SPI is disabled briefly between them, and the DMA sizes are
+changed to match. A run of transactions with the same frame size leaves both
+alone.
+
+Between two queued transactions the chip select is high for only a few
+cycles, which is enough for SD cards and most ADCs, but a device needing a
+longer deselect time should be given it by the callback.
+
+The bus is set up with spi_bus_setup before any transaction is submitted. The
+priority of the RX DMA interrupt is left to the application.
+
+14 October 2026
+*/
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/spi.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+#include "spi_dma.h"
+
+/* DMA memory barrier, so that data written to the buffer is in memory before
+the channel is enabled. */
+#define dma_barrier() __asm__ __volatile__ ("dmb" ::: "memory")
+
+#ifdef SPI_BUS1
+spi_bus_t spi_bus1 =
+{
+	.spi = SPI1,
+	.spi_clock = RCC_SPI1,
+	.gpio = GPIOA,
+	.gpio_clock = RCC_GPIOA,
+	.out_pins = GPIO_SPI1_SCK | GPIO_SPI1_MOSI,
+	.in_pin = GPIO_SPI1_MISO,
+	.tx_channel = DMA_CHANNEL3,
+	.rx_channel = DMA_CHANNEL2,
+	.rx_irq = NVIC_DMA1_CHANNEL2_IRQ,
+};
+#endif
+
+#ifdef SPI_BUS2
+spi_bus_t spi_bus2 =
+{
+	.spi = SPI2,
+	.spi_clock = RCC_SPI2,
+	.gpio = GPIOB,
+	.gpio_clock = RCC_GPIOB,
+	.out_pins = GPIO_SPI2_SCK | GPIO_SPI2_MOSI,
+	.in_pin = GPIO_SPI2_MISO,
+	.tx_channel = DMA_CHANNEL5,
+	.rx_channel = DMA_CHANNEL4,
+	.rx_irq = NVIC_DMA1_CHANNEL4_IRQ,
+};
+#endif
+
+/* Frame sent by receive only transactions, and frame receiving the data of
+transmit only transactions */
+static const uint16_t dummy_frame = 0xFFFF;
+static uint16_t discard_frame;
+
+static void dma_setup(spi_bus_t *bus);
+static void frame_setup(spi_bus_t *bus, bool frame_16bit);
+static void start(spi_bus_t *bus, spi_transaction_t *transaction);
+static void rx_dma_isr(spi_bus_t *bus);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set up a Bus
+
+The clocks and pins are enabled, the SPI set up as master with software slave
+management, MSB first and 8 bit frames, and both DMA channels configured.
+
+@param[in] bus: bus to set up.
+@param[in] baudrate: SPI_CR1_BAUDRATE_FPCLK_DIV_ divider of the bus clock.
+@param[in] cpol: SPI_CR1_CPOL_ clock polarity.
+@param[in] cpha: SPI_CR1_CPHA_ clock phase.
+*/
+
+void spi_bus_setup(spi_bus_t *bus, uint32_t baudrate, uint32_t cpol,
+		   uint32_t cpha)
+{
+	bus->head = 0;
+	bus->tail = 0;
+	rcc_periph_clock_enable(bus->gpio_clock);
+	rcc_periph_clock_enable(bus->spi_clock);
+	gpio_set_mode(bus->gpio, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, bus->out_pins);
+	gpio_set_mode(bus->gpio, GPIO_MODE_INPUT,
+		      GPIO_CNF_INPUT_FLOAT, bus->in_pin);
+	spi_reset(bus->spi);
+	spi_init_master(bus->spi, baudrate, cpol, cpha, SPI_CR1_DFF_8BIT,
+			SPI_CR1_MSBFIRST);
+	bus->frame_16bit = false;
+/* NSS must be held high internally even though the chip selects are driven
+as GPIOs, otherwise the SPI drops out of master mode. */
+	spi_enable_software_slave_management(bus->spi);
+	spi_set_nss_high(bus->spi);
+	dma_setup(bus);
+	spi_enable(bus->spi);
+	(void) SPI_DR(bus->spi);
+/* The DMA requests are left enabled. The channels only act on them while
+enabled for a transaction. */
+	spi_enable_rx_dma(bus->spi);
+	spi_enable_tx_dma(bus->spi);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set up a Chip Select
+
+The pin is set as a push-pull output and deselected (high). The clock of the
+GPIO port must already be enabled.
+
+@param[in] cs_port: GPIO port.
+@param[in] cs_pin: GPIO pin.
+*/
+
+void spi_cs_setup(uint32_t cs_port, uint16_t cs_pin)
+{
+	gpio_set(cs_port, cs_pin);
+	gpio_set_mode(cs_port, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_PUSHPULL, cs_pin);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Submit a Transaction
+
+The transaction is added to the end of the queue of the bus, and started if
+the bus is idle. This may be called from the main program or from an ISR,
+including a transaction callback.
+
+@param[in] bus: bus to use.
+@param[in] transaction: transaction to queue, not already in a queue.
+@returns false if the transaction has no frames, true if queued.
+*/
+
+bool spi_bus_submit(spi_bus_t *bus, spi_transaction_t *transaction)
+{
+	if (transaction->length == 0) return false;
+	transaction->next = 0;
+	transaction->done = false;
+	bool masked = cm_mask_interrupts(true);
+	if (bus->tail != 0) bus->tail->next = transaction;
+	else
+	{
+		bus->head = transaction;
+		start(bus, transaction);
+	}
+	bus->tail = transaction;
+	cm_mask_interrupts(masked);
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check if the Bus has Transactions in Progress
+
+@param[in] bus: bus to check.
+*/
+
+bool spi_bus_busy(spi_bus_t *bus)
+{
+	return (bus->head != 0);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Wait for a Transaction to Finish
+
+Sleep until the transaction is done. This must not be called from an ISR or
+with interrupts masked.
+
+@param[in] transaction: transaction submitted.
+*/
+
+void spi_transaction_wait(spi_transaction_t *transaction)
+{
+/* Interrupts are masked around the test so that an interrupt arriving just
+before the wfi cannot be missed. */
+	cm_mask_interrupts(true);
+	while (! transaction->done)
+	{
+		__asm__ __volatile__ ("wfi");
+		cm_mask_interrupts(false);
+		cm_mask_interrupts(true);
+	}
+	cm_mask_interrupts(false);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Change the Clock Rate of a Bus
+
+The bus must be idle, with no transaction queued.
+
+@param[in] bus: bus to change.
+@param[in] baudrate: SPI_CR1_BAUDRATE_FPCLK_DIV_ divider of the bus clock.
+*/
+
+void spi_bus_set_baudrate(spi_bus_t *bus, uint32_t baudrate)
+{
+	spi_disable(bus->spi);
+/* The divider of 256 has all the baud rate bits set */
+	SPI_CR1(bus->spi) = (SPI_CR1(bus->spi) &
+			     ~SPI_CR1_BAUDRATE_FPCLK_DIV_256) | baudrate;
+	spi_enable(bus->spi);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Change the Frame Size of a Bus
+
+For transfers made by the application directly on the SPI registers, without
+DMA. Transactions set their own frame size. The bus must be idle, with no
+transaction queued.
+
+@param[in] bus: bus to change.
+@param[in] frame_16bit: true for halfword frames, false for bytes.
+*/
+
+void spi_bus_set_frame(spi_bus_t *bus, bool frame_16bit)
+{
+	if (frame_16bit != bus->frame_16bit) frame_setup(bus, frame_16bit);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Exchange a Byte without DMA
+
+Send a byte and wait for the byte received with it, for the short command and
+response exchanges of a device between its DMA transfers. The frame size is
+set to 8 bits if it was not. The bus must be idle, with no transaction queued.
+
+@param[in] bus: bus to use.
+@param[in] data: byte to send.
+@returns byte received.
+*/
+
+uint8_t spi_bus_exchange(spi_bus_t *bus, uint8_t data)
+{
+	if (bus->frame_16bit) frame_setup(bus, false);
+	while ((SPI_SR(bus->spi) & SPI_SR_TXE) == 0);
+	SPI_DR(bus->spi) = data;
+	while ((SPI_SR(bus->spi) & SPI_SR_RXNE) == 0);
+	return SPI_DR(bus->spi);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Setup the RX channel for SPI to memory and the TX channel for memory to SPI
+transfers of bytes, and the RX transfer complete interrupt. The RX channel has
+the higher priority so that it cannot overrun. */
+
+static void dma_setup(spi_bus_t *bus)
+{
+	rcc_peripheral_enable_clock(&RCC_AHBENR, RCC_AHBENR_DMA1EN);
+	dma_channel_reset(DMA1, bus->rx_channel);
+	dma_set_peripheral_address(DMA1, bus->rx_channel,
+				   (uint32_t) &SPI_DR(bus->spi));
+	dma_set_read_from_peripheral(DMA1, bus->rx_channel);
+	dma_enable_memory_increment_mode(DMA1, bus->rx_channel);
+	dma_set_peripheral_size(DMA1, bus->rx_channel, DMA_CCR_PSIZE_8BIT);
+	dma_set_memory_size(DMA1, bus->rx_channel, DMA_CCR_MSIZE_8BIT);
+	dma_set_priority(DMA1, bus->rx_channel, DMA_CCR_PL_VERY_HIGH);
+	dma_enable_transfer_complete_interrupt(DMA1, bus->rx_channel);
+	nvic_enable_irq(bus->rx_irq);
+
+	dma_channel_reset(DMA1, bus->tx_channel);
+	dma_set_peripheral_address(DMA1, bus->tx_channel,
+				   (uint32_t) &SPI_DR(bus->spi));
+	dma_set_read_from_memory(DMA1, bus->tx_channel);
+	dma_enable_memory_increment_mode(DMA1, bus->tx_channel);
+	dma_set_peripheral_size(DMA1, bus->tx_channel, DMA_CCR_PSIZE_8BIT);
+	dma_set_memory_size(DMA1, bus->tx_channel, DMA_CCR_MSIZE_8BIT);
+	dma_set_priority(DMA1, bus->tx_channel, DMA_CCR_PL_HIGH);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Change the frame size of the SPI and both DMA channels. Called with the bus
+idle and both channels disabled. */
+
+static void frame_setup(spi_bus_t *bus, bool frame_16bit)
+{
+	spi_disable(bus->spi);
+	if (frame_16bit) spi_set_dff_16bit(bus->spi);
+	else spi_set_dff_8bit(bus->spi);
+	spi_enable(bus->spi);
+	dma_set_peripheral_size(DMA1, bus->rx_channel,
+		frame_16bit ? DMA_CCR_PSIZE_16BIT : DMA_CCR_PSIZE_8BIT);
+	dma_set_memory_size(DMA1, bus->rx_channel,
+		frame_16bit ? DMA_CCR_MSIZE_16BIT : DMA_CCR_MSIZE_8BIT);
+	dma_set_peripheral_size(DMA1, bus->tx_channel,
+		frame_16bit ? DMA_CCR_PSIZE_16BIT : DMA_CCR_PSIZE_8BIT);
+	dma_set_memory_size(DMA1, bus->tx_channel,
+		frame_16bit ? DMA_CCR_MSIZE_16BIT : DMA_CCR_MSIZE_8BIT);
+	bus->frame_16bit = frame_16bit;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Select the device and start the DMA of a transaction. Called with both
+channels disabled. A missing buffer is replaced by the dummy or discard frame
+with the memory increment off. The RX channel is enabled first so that it is
+ready for the first frame. */
+
+static void start(spi_bus_t *bus, spi_transaction_t *transaction)
+{
+	bool frame_16bit = ((transaction->flags & SPI_FRAME_16BIT) != 0);
+	if (frame_16bit != bus->frame_16bit) frame_setup(bus, frame_16bit);
+	if (transaction->cs_port != 0)
+		gpio_clear(transaction->cs_port, transaction->cs_pin);
+	if (transaction->rx != 0)
+	{
+		dma_set_memory_address(DMA1, bus->rx_channel,
+				       (uint32_t) transaction->rx);
+		dma_enable_memory_increment_mode(DMA1, bus->rx_channel);
+	}
+	else
+	{
+		dma_set_memory_address(DMA1, bus->rx_channel,
+				       (uint32_t) &discard_frame);
+		dma_disable_memory_increment_mode(DMA1, bus->rx_channel);
+	}
+	dma_set_number_of_data(DMA1, bus->rx_channel, transaction->length);
+	if (transaction->tx != 0)
+	{
+		dma_set_memory_address(DMA1, bus->tx_channel,
+				       (uint32_t) transaction->tx);
+		dma_enable_memory_increment_mode(DMA1, bus->tx_channel);
+	}
+	else
+	{
+		dma_set_memory_address(DMA1, bus->tx_channel,
+				       (uint32_t) &dummy_frame);
+		dma_disable_memory_increment_mode(DMA1, bus->tx_channel);
+	}
+	dma_set_number_of_data(DMA1, bus->tx_channel, transaction->length);
+	dma_barrier();
+	dma_enable_channel(DMA1, bus->rx_channel);
+	dma_enable_channel(DMA1, bus->tx_channel);
+}
+
+/*--------------------------------------------------------------------------*/
+/* RX DMA channel ISR body. The head transaction has finished on the bus.
+Release it, start the next and then call back, so that the bus is not idle
+during the callback. */
+
+static void rx_dma_isr(spi_bus_t *bus)
+{
+	if (dma_get_interrupt_flag(DMA1, bus->rx_channel, DMA_TCIF))
+	{
+		dma_clear_interrupt_flags(DMA1, bus->rx_channel, DMA_TCIF);
+		dma_disable_channel(DMA1, bus->rx_channel);
+		dma_disable_channel(DMA1, bus->tx_channel);
+		spi_transaction_t *transaction = bus->head;
+		if (transaction == 0) return;
+		if (transaction->cs_port != 0)
+			gpio_set(transaction->cs_port, transaction->cs_pin);
+		bus->head = transaction->next;
+		if (bus->head != 0) start(bus, bus->head);
+		else bus->tail = 0;
+		transaction->done = true;
+		if (transaction->callback != 0) transaction->callback(transaction);
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/* RX DMA ISRs of each bus */
+
+#ifdef SPI_BUS1
+void dma1_channel2_isr(void)
+{
+	rx_dma_isr(&spi_bus1);
+}
+#endif
+
+#ifdef SPI_BUS2
+void dma1_channel4_isr(void)
+{
+	rx_dma_isr(&spi_bus2);
+}
+#endif
@@ -0,0 +1,71 @@
+/*	SPI DMA Transaction Queue
+
+Queued DMA transfers on SPI1 and SPI2 for the STM32F1, with a chip select,
+frame size and completion callback for each transaction.
+
+14 October 2026
+*/
+
+#ifndef SPI_DMA_H
+#define SPI_DMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct spi_transaction spi_transaction_t;
+
+/* Transaction flags */
+#define SPI_FRAME_16BIT 0x01            /* halfword frames, otherwise bytes */
+
+/* A transaction is owned by the driver from spi_bus_submit until done is set.
+Without tx a dummy frame of all ones is sent for each frame received, and
+without rx the frames received are discarded. */
+struct spi_transaction {
+	const void *tx;                 /* frames to send, or 0 */
+	void *rx;                       /* frames received, or 0 */
+	uint16_t length;                /* number of frames */
+	uint8_t flags;
+	uint32_t cs_port;               /* chip select, active low, 0 for none */
+	uint16_t cs_pin;
+	void (*callback)(spi_transaction_t *transaction);  /* or 0 */
+	void *context;                  /* for the callback */
+	volatile bool done;
+	spi_transaction_t *next;        /* queue link */
+};
+
+typedef struct {
+/* Hardware of the bus */
+	uint32_t spi;
+	uint32_t spi_clock;             /* enum rcc_periph_clken */
+	uint32_t gpio;
+	uint32_t gpio_clock;
+	uint16_t out_pins;              /* SCK and MOSI */
+	uint16_t in_pin;                /* MISO */
+	uint8_t tx_channel;             /* DMA1 channels */
+	uint8_t rx_channel;
+	uint8_t rx_irq;
+/* Frame size set in the SPI and DMA */
+	bool frame_16bit;
+/* Queue, with the head transaction in progress */
+	spi_transaction_t * volatile head;
+	spi_transaction_t *tail;
+} spi_bus_t;
+
+#ifdef SPI_BUS1
+extern spi_bus_t spi_bus1;
+#endif
+#ifdef SPI_BUS2
+extern spi_bus_t spi_bus2;
+#endif
+
+void spi_bus_setup(spi_bus_t *bus, uint32_t baudrate, uint32_t cpol,
+		   uint32_t cpha);
+void spi_cs_setup(uint32_t cs_port, uint16_t cs_pin);
+bool spi_bus_submit(spi_bus_t *bus, spi_transaction_t *transaction);
+bool spi_bus_busy(spi_bus_t *bus);
+void spi_transaction_wait(spi_transaction_t *transaction);
+void spi_bus_set_baudrate(spi_bus_t *bus, uint32_t baudrate);
+void spi_bus_set_frame(spi_bus_t *bus, bool frame_16bit);
+uint8_t spi_bus_exchange(spi_bus_t *bus, uint8_t data);
+
+#endif
@@ -0,0 +1,234 @@
+/*	Task Health Supervisor
+
+Each task registers with supervisor_register, giving the longest time it may
+go between check-ins, and is given a bit of a check-in word. A check-in is a
+single store of 1 to the bit-band alias of its bit, so it is atomic with no
+masking of interrupts or exclusive access loop, and may be made from a task
+or an interrupt. The word must therefore be in the SRAM bit-band region, not
+the CCM of the STM32F4.
+
+supervisor_poll is the monitor. It is called every few tens of milliseconds
+with a millisecond time, from the lowest priority task of an RTOS so that it
+stops if the tasks above starve it, or from the main loop. It takes the bits
+set since the last poll, clearing each through its alias so that the bits of
+other tasks set meanwhile are kept, and restarts the deadline of each task
+that checked in. The independent watchdog is fed only if no deadline has
+passed. A task that has missed its deadline is written with its name and how
+long it was overdue to a record in RAM that is not cleared at reset, and the
+processor is reset at once rather than on the watchdog timeout. If the monitor
+itself stops, the watchdog resets the processor with no task to blame.
+
+supervisor_init is called first thing after reset. It reads the reset flags,
+clears the record at power on, and keeps the cause of the last reset for
+supervisor_last_fault to report. The watchdog period should allow a few polls
+and is started by supervisor_start. Once started the IWDG cannot be stopped.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/iwdg.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/scb.h>
+#include "mem_regions.h"
+#include "supervisor.h"
+
+/* Bit-band alias of a bit in SRAM */
+#define SRAM_BITBAND(address, bit) \
+	((volatile uint32_t *) (0x22000000 + \
+	 ((uint32_t) (address) - 0x20000000) * 32 + (bit) * 4))
+
+/* Marks a record written since the last power on */
+#define SUPERVISOR_MAGIC        0x53555056
+
+typedef struct {
+	const char *name;
+	uint32_t period_ms;
+	uint32_t remaining_ms;      /* time left to the deadline */
+} supervisor_task_t;
+
+/* Kept over a reset. pending is set by a miss, for the next start up. */
+typedef struct {
+	uint32_t magic;
+	bool pending;
+	supervisor_fault_t fault;
+} supervisor_record_t;
+
+static volatile uint32_t checkins;
+static supervisor_task_t tasks[SUPERVISOR_MAX_TASKS];
+static uint8_t task_count;
+static bool started;
+static bool polled;
+static uint32_t last_poll;
+static supervisor_record_t record NOINIT;
+
+static void missed(uint8_t task, uint32_t overdue, uint32_t now);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the Supervisor after a Reset
+
+The cause of the reset is found from the reset flags and the record, which
+is cleared at power on, and the flags are cleared for the next reset. No
+tasks are registered and the watchdog is not started.
+*/
+
+void supervisor_init(void)
+{
+	uint32_t flags = RCC_CSR;
+	RCC_CSR |= RCC_CSR_RMVF;
+	if ((flags & RCC_CSR_PORRSTF) || (record.magic != SUPERVISOR_MAGIC))
+	{
+		memset(&record, 0, sizeof(record));
+		record.magic = SUPERVISOR_MAGIC;
+	}
+	if (record.pending)
+	{
+		record.pending = false;
+		record.fault.cause = SUPERVISOR_RESET_MISSED;
+		record.fault.resets++;
+	}
+	else if (flags & RCC_CSR_IWDGRSTF)
+	{
+		record.fault.cause = SUPERVISOR_RESET_WATCHDOG;
+		record.fault.resets++;
+		record.fault.task = SUPERVISOR_NONE;
+		record.fault.name[0] = 0;
+		record.fault.period_ms = 0;
+		record.fault.overdue_ms = 0;
+		record.fault.time_ms = 0;
+	}
+	else record.fault.cause = SUPERVISOR_RESET_NONE;
+	checkins = 0;
+	task_count = 0;
+	started = false;
+	polled = false;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Register a Task
+
+The first deadline is a period from the next poll. A task may register
+after the supervisor has started.
+
+@param[in] name: name for the fault record, kept by reference.
+@param[in] period_ms: longest time between check-ins, many polls long.
+@returns the task id for supervisor_checkin, or -1 if all are taken.
+*/
+
+int8_t supervisor_register(const char *name, uint32_t period_ms)
+{
+	bool masked = cm_mask_interrupts(true);
+	if (task_count >= SUPERVISOR_MAX_TASKS)
+	{
+		cm_mask_interrupts(masked);
+		return -1;
+	}
+	uint8_t task = task_count;
+	tasks[task].name = name;
+	tasks[task].period_ms = period_ms;
+	tasks[task].remaining_ms = period_ms;
+	task_count++;
+	cm_mask_interrupts(masked);
+	return task;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check In
+
+Safe from any task or interrupt.
+
+@param[in] task: id given by supervisor_register.
+*/
+
+void supervisor_checkin(uint8_t task)
+{
+	*SRAM_BITBAND(&checkins, task) = 1;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the Watchdog
+
+From here supervisor_poll must be called well within the watchdog period.
+
+@param[in] watchdog_ms: watchdog period, up to 26 seconds.
+*/
+
+void supervisor_start(uint32_t watchdog_ms)
+{
+	iwdg_set_period_ms(watchdog_ms);
+	iwdg_start();
+	started = true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Monitor the Tasks
+
+The deadline of each task that has checked in since the last poll is
+restarted, and the watchdog fed if no task has missed its deadline. A task
+whose deadline has passed is recorded and the processor reset. A task is
+therefore caught between its deadline and a poll later.
+
+@param[in] now_ms: a free running millisecond time.
+*/
+
+void supervisor_poll(uint32_t now_ms)
+{
+	if (! polled)
+	{
+		polled = true;
+		last_poll = now_ms;
+	}
+	uint32_t elapsed = now_ms - last_poll;
+	last_poll = now_ms;
+	uint32_t seen = checkins;
+	uint8_t count = task_count;
+	uint8_t task;
+	for (task = 0; task < count; task++)
+	{
+		supervisor_task_t *entry = &tasks[task];
+		if (seen & (1UL << task))
+		{
+			*SRAM_BITBAND(&checkins, task) = 0;
+			entry->remaining_ms = entry->period_ms;
+		}
+		else if (elapsed >= entry->remaining_ms)
+		{
+			missed(task, entry->period_ms - entry->remaining_ms + elapsed,
+			       now_ms);
+		}
+		else entry->remaining_ms -= elapsed;
+	}
+	if (started) iwdg_reset();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Cause of the Last Reset
+
+@param[out] fault: copy of the fault record, with its cause.
+@returns true if the last reset was by the supervisor or the watchdog.
+*/
+
+bool supervisor_last_fault(supervisor_fault_t *fault)
+{
+	*fault = record.fault;
+	return record.fault.cause != SUPERVISOR_RESET_NONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Record the task that missed its deadline, and reset. */
+
+static void missed(uint8_t task, uint32_t overdue, uint32_t now)
+{
+	cm_mask_interrupts(true);
+	record.fault.task = task;
+	strncpy(record.fault.name, tasks[task].name, SUPERVISOR_NAME_LENGTH - 1);
+	record.fault.name[SUPERVISOR_NAME_LENGTH - 1] = 0;
+	record.fault.period_ms = tasks[task].period_ms;
+	record.fault.overdue_ms = overdue;
+	record.fault.time_ms = now;
+	record.pending = true;
+	scb_reset_system();
+}
@@ -0,0 +1,49 @@
+/*	Task Health Supervisor
+
+Tasks register with an expected check-in period and check in as they run. A
+monitor called periodically feeds the independent watchdog only while every
+task has checked in within its period, and records the task that missed its
+deadline in RAM kept over the reset.
+
+15 October 2026
+*/
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Tasks supervised, one bit each of the check-in word */
+#define SUPERVISOR_MAX_TASKS    32
+
+/* Characters of a task name kept in the fault record, with its terminator */
+#define SUPERVISOR_NAME_LENGTH  12
+
+/* Task of a fault record when none is known */
+#define SUPERVISOR_NONE         0xFF
+
+typedef enum {
+	SUPERVISOR_RESET_NONE,      /* not reset by the supervisor */
+	SUPERVISOR_RESET_MISSED,    /* a task missed its check-in deadline */
+	SUPERVISOR_RESET_WATCHDOG,  /* the monitor itself stopped */
+} supervisor_reset_t;
+
+typedef struct {
+	supervisor_reset_t cause;
+	uint32_t resets;            /* faults since power on */
+	uint8_t task;               /* id of the task, or SUPERVISOR_NONE */
+	char name[SUPERVISOR_NAME_LENGTH];
+	uint32_t period_ms;         /* check-in period of the task */
+	uint32_t overdue_ms;        /* time since its last check-in */
+	uint32_t time_ms;           /* monitor time of the miss */
+} supervisor_fault_t;
+
+void supervisor_init(void);
+int8_t supervisor_register(const char *name, uint32_t period_ms);
+void supervisor_checkin(uint8_t task);
+void supervisor_start(uint32_t watchdog_ms);
+void supervisor_poll(uint32_t now_ms);
+bool supervisor_last_fault(supervisor_fault_t *fault);
+
+#endif
@@ -0,0 +1,215 @@
+/*	Binary Telemetry Frames
+
+COBS framed binary records with a sequence number and CRC, written to a byte or
+ring buffer for serial transmission.
+
+Each record is laid out as
+
+    type, sequence, payload (0 to 250 bytes), CRC low, CRC high
+
+and is then COBS encoded (Consistent Overhead Byte Stuffing) so that it holds
+no zero bytes, and ended with a zero. A receiver can therefore always find the
+start of the next frame after a lost or corrupted byte by waiting for a zero.
+With at most 254 bytes before encoding only one byte of COBS overhead is
+added. The sequence number counts frames sent so that the receiver can tell
+how many were lost.
+
+The CRC is CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF) over
+the type, sequence and payload, computed four bits at a time from a 16 entry
+table.
+
+A frame is either written whole or, if the buffer has no room for it, dropped
+and counted as not sent. Kicking off transmission is left to the caller, as for
+format.c. The host decoder is telemetry_decode.py.
+
+14 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "telemetry.h"
+
+/* Largest record before encoding */
+#define RECORD_MAX (TELEMETRY_MAX_PAYLOAD+4)
+
+/* Destination: one of these is set */
+static uint8_t *telemetry_buffer;
+static ring_buffer_t *telemetry_ring;
+
+static uint8_t sequence;
+
+static const uint16_t crc_table[16] =
+{
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send Telemetry to a Byte Buffer
+
+Byte buffers hold at most 128 bytes so only short frames can be sent.
+
+@param[in] buffer: byte buffer to write frames to.
+*/
+
+void telemetry_init(uint8_t buffer[])
+{
+	telemetry_buffer = buffer;
+	telemetry_ring = 0;
+	sequence = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send Telemetry to a Ring Buffer
+
+@param[in] ring: ring buffer to write frames to.
+*/
+
+void telemetry_init_ring(ring_buffer_t *ring)
+{
+	telemetry_buffer = 0;
+	telemetry_ring = ring;
+	sequence = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send a Telemetry Record
+
+The record is framed and encoded on the stack and put to the buffer in one
+block.
+
+@param[in] type: record type.
+@param[in] payload: record data.
+@param[in] length: payload length, up to TELEMETRY_MAX_PAYLOAD.
+@returns true if the frame was put to the buffer, false if it was dropped.
+*/
+
+bool telemetry_send(uint8_t type, const uint8_t *payload, uint8_t length)
+{
+	uint8_t frame[RECORD_MAX+2];
+
+	if (length > TELEMETRY_MAX_PAYLOAD) return false;
+	uint16_t frame_length = length + TELEMETRY_OVERHEAD;
+	if (telemetry_ring != 0)
+	{
+		if (ring_space(telemetry_ring) < frame_length) return false;
+	}
+	else if (buffer_space(telemetry_buffer) < frame_length) return false;
+
+	telemetry_frame(frame, type, sequence, payload, length);
+	if (telemetry_ring != 0) ring_put_n(telemetry_ring, frame, frame_length);
+	else buffer_put_n(telemetry_buffer, frame, frame_length);
+	sequence++;
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Encode a Telemetry Frame
+
+The record is laid out with its CRC and COBS encoded, ready to send, for a
+module that keeps its own destination and sequence count.
+
+@param[out] frame: encoded frame, length + TELEMETRY_OVERHEAD bytes.
+@param[in] type: record type.
+@param[in] sequence: sequence number of the frame.
+@param[in] payload: record data.
+@param[in] length: payload length, up to TELEMETRY_MAX_PAYLOAD.
+@returns length of the frame including its delimiter.
+*/
+
+uint16_t telemetry_frame(uint8_t *frame, uint8_t type, uint8_t sequence,
+                         const uint8_t *payload, uint8_t length)
+{
+	uint8_t *code;
+	uint8_t *out;
+	uint8_t run;
+	uint16_t crc;
+	uint16_t i;
+
+	uint8_t header[2] = {type, sequence};
+	crc = telemetry_crc(0xFFFF, header, 2);
+	crc = telemetry_crc(crc, payload, length);
+	uint8_t trailer[2] = {(uint8_t) crc, (uint8_t)(crc >> 8)};
+
+/* COBS encode. Each zero is replaced by the distance to the next zero, and
+the code byte ahead of the record holds the distance to the first. The end of
+the record counts as a zero. */
+	code = frame;
+	out = frame + 1;
+	run = 1;
+	for (i = 0; i < length + 4; i++)
+	{
+		uint8_t c;
+		if (i < 2) c = header[i];
+		else if (i < length + 2) c = payload[i - 2];
+		else c = trailer[i - length - 2];
+		if (c == 0)
+		{
+			*code = run;
+			code = out++;
+			run = 1;
+		}
+		else
+		{
+			*out++ = c;
+			run++;
+		}
+	}
+	*code = run;
+	*out = 0;
+	return length + TELEMETRY_OVERHEAD;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Pack 12 Bit Samples
+
+Pairs of 12 bit samples are packed little endian into three bytes, the first
+sample in the low twelve bits and the second in the high twelve bits. An odd
+last sample takes two bytes.
+
+@param[out] out: packed data, (3*count+1)/2 bytes.
+@param[in] samples: samples, of which only the low 12 bits are used.
+@param[in] count: number of samples.
+@returns number of bytes written.
+*/
+
+uint8_t telemetry_pack_12bit(uint8_t *out, const uint16_t *samples,
+                             uint8_t count)
+{
+	uint8_t n = 0;
+	uint8_t i;
+	for (i = 0; i + 1 < count; i += 2)
+	{
+		uint16_t a = samples[i] & 0xFFF;
+		uint16_t b = samples[i + 1] & 0xFFF;
+		out[n++] = (uint8_t) a;
+		out[n++] = (uint8_t)((a >> 8) | (b << 4));
+		out[n++] = (uint8_t)(b >> 4);
+	}
+	if (i < count)
+	{
+		out[n++] = (uint8_t) samples[i];
+		out[n++] = (uint8_t)((samples[i] >> 8) & 0x0F);
+	}
+	return n;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief CRC-16/CCITT-FALSE
+
+@param[in] crc: running CRC, 0xFFFF to start.
+@param[in] data: data to add.
+@param[in] length: number of bytes.
+@returns updated CRC.
+*/
+
+uint16_t telemetry_crc(uint16_t crc, const uint8_t *data, uint32_t length)
+{
+	while (length-- > 0)
+	{
+		uint8_t c = *data++;
+		crc = (crc << 4) ^ crc_table[((crc >> 12) ^ (c >> 4)) & 0x0F];
+		crc = (crc << 4) ^ crc_table[((crc >> 12) ^ c) & 0x0F];
+	}
+	return crc;
+}
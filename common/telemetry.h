@@ -0,0 +1,43 @@
+/*	Binary Telemetry Frames
+
+COBS framed binary records with a sequence number and CRC, written to a byte or
+ring buffer for serial transmission.
+
+14 October 2026
+*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "buffer.h"
+
+/* Largest payload, chosen so that an encoded frame needs only one COBS code
+byte and fits in 255 bytes with its delimiter. */
+#define TELEMETRY_MAX_PAYLOAD 250
+
+/* Bytes added to the payload: type, sequence, CRC, COBS code and delimiter */
+#define TELEMETRY_OVERHEAD 6
+
+/* Record types. Applications may add their own from TELEMETRY_USER. */
+#define TELEMETRY_TEXT          0x01
+#define TELEMETRY_ADC_12BIT     0x02
+#define TELEMETRY_RTOS_STATS    0x03
+#define TELEMETRY_SAMPLES_16BIT 0x04    /* little endian, as from decimate.c */
+#define TELEMETRY_IAP           0x05    /* answers of iap_link.c */
+#define TELEMETRY_TRACE         0x06    /* event records of trace.c */
+#define TELEMETRY_CAN           0x07    /* frames of can_gateway.c */
+#define TELEMETRY_LOOPBACK      0x08    /* figures of the analogue benchmark */
+#define TELEMETRY_USER          0x80
+
+void telemetry_init(uint8_t buffer[]);
+void telemetry_init_ring(ring_buffer_t *ring);
+bool telemetry_send(uint8_t type, const uint8_t *payload, uint8_t length);
+uint16_t telemetry_frame(uint8_t *frame, uint8_t type, uint8_t sequence,
+                         const uint8_t *payload, uint8_t length);
+uint8_t telemetry_pack_12bit(uint8_t *out, const uint16_t *samples,
+                             uint8_t count);
+uint16_t telemetry_crc(uint16_t crc, const uint8_t *data, uint32_t length);
+
+#endif
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+"""Decoder for the binary telemetry frames of telemetry.c.
+
+Reads COBS framed records from a serial port or a capture file, checks the
+CRC and sequence number, and prints each record. Records of type
+TELEMETRY_ADC_12BIT and TELEMETRY_SAMPLES_16BIT are unpacked into samples,
+TELEMETRY_RTOS_STATS records of rtos_stats.c are shown as a task table,
+TELEMETRY_CAN records of can_gateway.c as one line a frame,
+TELEMETRY_LOOPBACK records of the analogue benchmark with the SNR and THD in
+dB, and other types are shown in hex, or as text for TELEMETRY_TEXT.
+
+    telemetry_decode.py /dev/ttyUSB0 [baudrate]
+    telemetry_decode.py capture.bin
+
+A serial port needs pyserial. A summary of frames and errors is printed at
+the end (Ctrl-C).
+
+14 October 2026
+"""
+
+import math
+import struct
+import sys
+
+TELEMETRY_TEXT = 0x01
+TELEMETRY_ADC_12BIT = 0x02
+TELEMETRY_RTOS_STATS = 0x03
+TELEMETRY_SAMPLES_16BIT = 0x04
+TELEMETRY_TRACE = 0x06
+TELEMETRY_CAN = 0x07
+TELEMETRY_LOOPBACK = 0x08
+
+# Task states of FreeRTOS eTaskState
+TASK_STATES = "XRBSD"
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE."""
+    for c in data:
+        crc ^= c << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(frame):
+    """Decode one COBS frame without its zero delimiter. None if invalid."""
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame) + 1:
+            return None
+        out += frame[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+def unpack_12bit(data):
+    """Unpack pairs of 12 bit samples from three bytes each."""
+    samples = []
+    i = 0
+    while i + 3 <= len(data):
+        samples.append(data[i] | ((data[i + 1] & 0x0F) << 8))
+        samples.append((data[i + 1] >> 4) | (data[i + 2] << 4))
+        i += 3
+    if i + 2 == len(data):
+        samples.append(data[i] | ((data[i + 1] & 0x0F) << 8))
+    return samples
+
+
+def unpack_16bit(data):
+    """Unpack little endian 16 bit samples."""
+    return [int.from_bytes(data[i:i + 2], "little")
+            for i in range(0, len(data) - 1, 2)]
+
+
+def rtos_stats(data):
+    """Format a run time statistics record as a task table."""
+    if len(data) < 9:
+        return data.hex()
+    heap_free = int.from_bytes(data[0:4], "little")
+    heap_min = int.from_bytes(data[4:8], "little")
+    lines = ["heap free %d lowest %d, %d tasks" % (heap_free, heap_min, data[8])]
+    for i in range(9, len(data) - 14, 15):
+        task = data[i:i + 15]
+        state = TASK_STATES[task[2]] if task[2] < len(TASK_STATES) else "?"
+        lines.append("    %-8s %2d  pri %d  %c  cpu %5.1f%%  stack free %d"
+                     % (task[7:].rstrip(b"\0").decode("ascii", "replace"),
+                        task[0], task[1], state,
+                        int.from_bytes(task[3:5], "little") / 10.0,
+                        int.from_bytes(task[5:7], "little")))
+    return "\n".join(lines)
+
+
+def can_frames(data):
+    """Format the mirrored frames of a gateway record, 13 bytes each."""
+    lines = []
+    for i in range(0, len(data) - 12, 13):
+        ident = int.from_bytes(data[i:i + 4], "little")
+        length = min(data[i + 4] & 0x0F, 8)
+        lines.append("    %s %s  [%d] %s%s"
+                     % ("2>1" if data[i + 4] & 0x80 else "1>2",
+                        "%08X" % (ident & 0x1FFFFFFF) if ident & 0x80000000
+                        else "     %03X" % (ident & 0x7FF),
+                        length, data[i + 5:i + 5 + length].hex(" "),
+                        " RTR" if ident & 0x40000000 else ""))
+    return "%d frames\n" % len(lines) + "\n".join(lines)
+
+
+def decibels(ratio):
+    return 10*math.log10(ratio) if ratio > 0 else float("-inf")
+
+
+def loopback(data):
+    """Format the figures of a run of adc-loopback-stm32f4discovery.c."""
+    (run, rate, latency, low, high,
+     signal, harmonics, noise) = struct.unpack("<IIIHHfff", data[:32])
+    return ("run %d  rate %.3f Hz  latency %d ticks  step %d to %d  "
+            "SNR %.1f dB  THD %.1f dB  SINAD %.1f dB"
+            % (run, rate/1000, latency, low, high,
+               decibels(signal/noise) if noise > 0 else float("inf"),
+               decibels(harmonics/signal) if signal > 0 else 0.0,
+               decibels(signal/(noise + harmonics))
+               if noise + harmonics > 0 else float("inf")))
+
+
+class Decoder:
+    """Collects bytes into frames and checks them."""
+
+    def __init__(self):
+        self.pending = bytearray()
+        self.sequence = None
+        self.frames = 0
+        self.bad = 0
+        self.lost = 0
+
+    def feed(self, data):
+        """Add received bytes, returning a list of (type, sequence, payload)."""
+        records = []
+        for c in data:
+            if c != 0:
+                self.pending.append(c)
+                continue
+            frame = bytes(self.pending)
+            self.pending.clear()
+            if not frame:
+                continue
+            record = self.check(frame)
+            if record is not None:
+                records.append(record)
+        return records
+
+    def check(self, frame):
+        record = cobs_decode(frame)
+        if record is None or len(record) < 4 or \
+                crc16(record[:-2]) != (record[-2] | (record[-1] << 8)):
+            self.bad += 1
+            return None
+        kind, sequence = record[0], record[1]
+        if self.sequence is not None:
+            self.lost += (sequence - self.sequence - 1) & 0xFF
+        self.sequence = sequence
+        self.frames += 1
+        return kind, sequence, record[2:-2]
+
+
+def show(kind, sequence, payload):
+    if kind == TELEMETRY_ADC_12BIT:
+        text = " ".join(str(s) for s in unpack_12bit(payload))
+    elif kind == TELEMETRY_SAMPLES_16BIT:
+        text = " ".join(str(s) for s in unpack_16bit(payload))
+    elif kind == TELEMETRY_RTOS_STATS:
+        text = rtos_stats(payload)
+    elif kind == TELEMETRY_CAN:
+        text = can_frames(payload)
+    elif kind == TELEMETRY_LOOPBACK and len(payload) >= 32:
+        text = loopback(payload)
+    elif kind == TELEMETRY_TEXT:
+        text = payload.decode("ascii", "replace")
+    else:
+        text = payload.hex()
+    print("%02X %3d  %s" % (kind, sequence, text))
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    name = sys.argv[1]
+    if name.startswith("/dev/") or name.upper().startswith("COM"):
+        import serial
+        baudrate = int(sys.argv[2]) if len(sys.argv) > 2 else 115200
+        source = serial.Serial(name, baudrate, timeout=0.1)
+    else:
+        source = open(name, "rb")
+    decoder = Decoder()
+    try:
+        while True:
+            data = source.read(256)
+            if not data:
+                if not name.startswith("/dev/"):
+                    break
+                continue
+            for record in decoder.feed(data):
+                show(*record)
+    except KeyboardInterrupt:
+        pass
+    print("%d frames, %d bad, %d lost" %
+          (decoder.frames, decoder.bad, decoder.lost))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
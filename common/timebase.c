@@ -0,0 +1,206 @@
+/*	Microsecond Timebase
+
+The time is kept as the microseconds at a reference cycle count, and read by
+adding the cycles since then, scaled by the clock. The reference is moved on
+in whole milliseconds of cycles, so no rounding accumulates, and the cycles
+past it are always fewer than a millisecond's worth when scaled, which keeps
+the arithmetic in 32 bits. Any read moves the reference on, so the time stays
+correct however late the tick is, as long as it comes once in each wrap of
+the cycle counter, 59 seconds at 72MHz and 25 seconds at 168MHz.
+
+The tick comes from SysTick at 1kHz, set up by time_init, or in a FreeRTOS
+program from the kernel's own tick through vApplicationTickHook. SysTick is
+left to the program, which calls time_tick from its sys_tick_handler, so that
+this is not tied to any one program's use of it. delay_until sleeps on wfi
+while more than a tick remains, woken by the tick or any other interrupt, and
+waits out the last millisecond on the counter. Until the first tick has come
+it does not sleep, as nothing may be there to wake it.
+
+The cycle counter runs in sleep mode but not in stop mode, so the time stops
+through a stop. When the clock changes time_clock_changed is called, from a
+notifier of clock_governor.c for instance, to take the time at the old rate
+and set the new; the cycles from the change to the call are scaled at the old
+rate. At a clock that is not a whole number of kHz, such as the 4.194MHz MSI,
+the time runs fast by the part of a cycle per millisecond lost.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/cm3/systick.h>
+#include "irq_priority.h"
+#include "timebase.h"
+
+/* Microseconds at the reference cycle count */
+static uint64_t reference_us;
+static uint32_t reference_cycles;
+static uint32_t cycles_per_ms;
+static bool systick_owned;
+static volatile bool ticking;
+
+static uint64_t now_us(uint32_t cycles);
+static void systick_setup(void);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the Timebase
+
+The DWT cycle counter is enabled and the time starts from zero.
+
+@param[in] systick: true to run SysTick at 1kHz for the tick, with the
+program's sys_tick_handler calling time_tick; false if the program calls
+time_tick from a tick of its own.
+*/
+
+void time_init(bool systick)
+{
+	dwt_enable_cycle_counter();
+	bool masked = cm_mask_interrupts(true);
+	cycles_per_ms = rcc_ahb_frequency / 1000;
+	reference_cycles = DWT_CYCCNT;
+	reference_us = 0;
+	ticking = false;
+	systick_owned = systick;
+	if (systick_owned) systick_setup();
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Timebase Tick
+
+Called at least once in each wrap of the cycle counter, from sys_tick_handler
+or the FreeRTOS tick hook.
+*/
+
+void time_tick(void)
+{
+	bool masked = cm_mask_interrupts(true);
+	now_us(DWT_CYCCNT);
+	cm_mask_interrupts(masked);
+	ticking = true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Take up a New Clock
+
+The time is brought up to date at the old clock, and SysTick set again for
+the new one if it is run here.
+*/
+
+void time_clock_changed(void)
+{
+	bool masked = cm_mask_interrupts(true);
+	uint32_t cycles = DWT_CYCCNT;
+	reference_us = now_us(cycles);
+	reference_cycles = cycles;
+	cycles_per_ms = rcc_ahb_frequency / 1000;
+	if (systick_owned) systick_setup();
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Time Now
+
+@returns microseconds since time_init.
+*/
+
+uint64_t time_now_us(void)
+{
+	bool masked = cm_mask_interrupts(true);
+	uint64_t time = now_us(DWT_CYCCNT);
+	cm_mask_interrupts(masked);
+	return time;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Deadline from Now
+
+@param[in] us: microseconds from now.
+@returns time of the deadline, for time_expired or delay_until.
+*/
+
+uint64_t time_deadline(uint32_t us)
+{
+	return time_now_us() + us;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check a Deadline
+
+For a polling loop with a timeout, set up by time_deadline.
+
+@param[in] deadline: time of the deadline.
+@returns true once the deadline has passed.
+*/
+
+bool time_expired(uint64_t deadline)
+{
+	return time_now_us() >= deadline;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Delay to a Deadline
+
+Successive deadlines a fixed step apart give a period with no drift, however
+long the work between them takes.
+
+@param[in] deadline: time to return at.
+*/
+
+void delay_until(uint64_t deadline)
+{
+	while (true)
+	{
+		uint64_t now = time_now_us();
+		if (now >= deadline) return;
+		if (ticking && (deadline - now > 1000)) __asm__ __volatile__ ("wfi");
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+
+void delay_us(uint32_t us)
+{
+	delay_until(time_deadline(us));
+}
+
+/*--------------------------------------------------------------------------*/
+
+void delay_ms(uint32_t ms)
+{
+	delay_until(time_now_us() + (uint64_t) ms * 1000);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Move the reference on by the whole milliseconds passed and return the time,
+with interrupts masked. */
+
+static uint64_t now_us(uint32_t cycles)
+{
+	uint32_t elapsed = cycles - reference_cycles;
+	if (elapsed >= cycles_per_ms)
+	{
+		uint32_t ms = elapsed / cycles_per_ms;
+		reference_cycles += ms * cycles_per_ms;
+		reference_us += (uint64_t) ms * 1000;
+		elapsed -= ms * cycles_per_ms;
+	}
+	return reference_us + elapsed * 1000 / cycles_per_ms;
+}
+
+/*--------------------------------------------------------------------------*/
+/* SysTick interrupts every millisecond of the core clock. */
+
+static void systick_setup(void)
+{
+	systick_counter_disable();
+	systick_set_clocksource(STK_CSR_CLKSOURCE_AHB);
+	systick_set_reload(cycles_per_ms - 1);
+	systick_clear();
+	IRQ_PRIORITY_SET(NVIC_SYSTICK_IRQ, IRQ_LEVEL_TIMER);
+	systick_interrupt_enable();
+	systick_counter_enable();
+}
@@ -0,0 +1,26 @@
+/*	Microsecond Timebase
+
+A monotonic 64 bit count of microseconds from the DWT cycle counter, carried
+over its wrap by a periodic tick, with deadline based delays that sleep and
+timeouts for polling loops, all independent of the clock frequency.
+
+15 October 2026
+*/
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+void time_init(bool systick);
+void time_tick(void);
+void time_clock_changed(void);
+uint64_t time_now_us(void);
+uint64_t time_deadline(uint32_t us);
+bool time_expired(uint64_t deadline);
+void delay_until(uint64_t deadline);
+void delay_us(uint32_t us);
+void delay_ms(uint32_t ms);
+
+#endif
@@ -0,0 +1,210 @@
+/*	Event Trace
+
+TRACE_EVENT writes a record of the cycle count, an id and an argument to the
+ring with interrupts masked for the few stores it takes, so it can be placed
+in a handler without disturbing the timing it is there to show, where a
+formatted print would take hundreds of microseconds. The ring is emptied from
+the background by trace_drain, called from the main loop or a low priority
+task, and a record that finds the ring full is counted and reported in a
+TRACE_LOST record once there is room.
+
+With a debugger attached and the ITM enabled on both stimulus ports, each
+record is written to the ports as two words, the time and then the id and
+argument, and goes out on SWO at no cost to the USARTs. A full stimulus FIFO
+is waited on for a bounded time before the rest is left for the next drain.
+Otherwise the records are packed into TELEMETRY_TRACE frames in the ring given
+to trace_init, which the caller sends on a spare port with serial_port_tx_start
+as for telemetry.c. trace_decode.py reads either.
+
+The frames have their own sequence count, so the trace does not disturb that
+of telemetry.c when both are used. Without TRACE this file is not built. The
+cycle counter wraps after 59 seconds at 72MHz, so the decoder takes events
+more than that apart as closer than they were.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/cm3/itm.h>
+#include <libopencm3/cm3/scs.h>
+#include "buffer.h"
+#include "telemetry.h"
+#include "trace.h"
+
+/* Records in a telemetry frame */
+#define FRAME_RECORDS       (TELEMETRY_MAX_PAYLOAD / sizeof(trace_record_t))
+
+/* Polls of a full stimulus port before the drain gives up */
+#define ITM_WAIT            1000
+
+trace_record_t trace_ring[TRACE_RECORDS];
+volatile uint32_t trace_head;
+volatile uint32_t trace_tail;
+volatile uint32_t trace_dropped;
+
+static ring_buffer_t *trace_out;
+static uint8_t sequence;
+
+/* Drops already reported */
+static uint32_t dropped_sent;
+
+static uint32_t drain_itm(void);
+static uint32_t drain_ring(void);
+static bool lost_record(trace_record_t *record);
+static bool itm_record(const trace_record_t *record);
+static bool itm_put(uint8_t port, uint32_t value);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the Trace
+
+The DWT cycle counter is enabled and the ring emptied.
+
+@param[in] ring: buffer for the frames when no debugger is attached, or 0 to
+send over the ITM only.
+*/
+
+void trace_init(ring_buffer_t *ring)
+{
+	dwt_enable_cycle_counter();
+	bool masked = cm_mask_interrupts(true);
+	trace_head = 0;
+	trace_tail = 0;
+	trace_dropped = 0;
+	cm_mask_interrupts(masked);
+	dropped_sent = 0;
+	trace_out = ring;
+	sequence = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Drain the Trace
+
+Called from the background only. The records go to the ITM if it is enabled,
+otherwise to the frame ring if one was given, and stay in the trace ring if
+neither will take them.
+
+@returns records sent.
+*/
+
+uint32_t trace_drain(void)
+{
+	if (trace_itm_enabled()) return drain_itm();
+	if (trace_out != 0) return drain_ring();
+	return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check for the ITM
+
+The debugger enables tracing in the DEMCR, the ITM and its stimulus ports
+when it sets up SWO, and none of these is set from reset otherwise.
+
+@returns true if both trace ports are enabled.
+*/
+
+bool trace_itm_enabled(void)
+{
+	uint32_t ports = 3 << TRACE_ITM_PORT;
+	return ((SCS_DEMCR & SCS_DEMCR_TRCENA) != 0) &&
+	       ((ITM_TCR & ITM_TCR_ITMENA) != 0) &&
+	       ((ITM_TER[0] & ports) == ports);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Write the records to the stimulus ports. A record is taken from the ring
+only once both its words are written. */
+
+static uint32_t drain_itm(void)
+{
+	trace_record_t lost;
+	uint32_t count = 0;
+
+	if (lost_record(&lost))
+	{
+		if (! itm_record(&lost)) return 0;
+		dropped_sent += lost.arg;
+	}
+	while (trace_tail != trace_head)
+	{
+		trace_record_t *record = &trace_ring[trace_tail & (TRACE_RECORDS - 1)];
+		if (! itm_record(record)) break;
+		trace_tail++;
+		count++;
+	}
+	return count;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Pack the records into frames while the frame ring has room. */
+
+static uint32_t drain_ring(void)
+{
+	uint8_t payload[FRAME_RECORDS*sizeof(trace_record_t)];
+	uint8_t frame[sizeof(payload) + TELEMETRY_OVERHEAD];
+	uint32_t count = 0;
+
+	while (true)
+	{
+		uint32_t n = 0;
+		trace_record_t lost;
+		if (lost_record(&lost))
+			memcpy(payload + sizeof(trace_record_t)*n++, &lost, sizeof(lost));
+		uint32_t waiting = trace_head - trace_tail;
+		if (waiting > FRAME_RECORDS - n) waiting = FRAME_RECORDS - n;
+		uint32_t length = (n + waiting)*sizeof(trace_record_t);
+		if ((length == 0) ||
+		    (ring_space(trace_out) < length + TELEMETRY_OVERHEAD)) break;
+		uint32_t i;
+		for (i = 0; i < waiting; i++)
+			memcpy(payload + sizeof(trace_record_t)*n++,
+			       &trace_ring[(trace_tail + i) & (TRACE_RECORDS - 1)],
+			       sizeof(trace_record_t));
+		uint16_t frame_length = telemetry_frame(frame, TELEMETRY_TRACE,
+		                                        sequence++, payload, length);
+		ring_put_n(trace_out, frame, frame_length);
+		trace_tail += waiting;
+		if (n > waiting) dropped_sent += lost.arg;
+		count += waiting;
+	}
+	return count;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Make a record of the drops not yet reported, of at most 65535. */
+
+static bool lost_record(trace_record_t *record)
+{
+	uint32_t dropped = trace_dropped - dropped_sent;
+	if (dropped == 0) return false;
+	record->time = DWT_CYCCNT;
+	record->id = TRACE_LOST;
+	record->arg = (dropped > 0xFFFF) ? 0xFFFF : dropped;
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Write a record to the two stimulus ports. */
+
+static bool itm_record(const trace_record_t *record)
+{
+	if (! itm_put(TRACE_ITM_PORT, record->time)) return false;
+	return itm_put(TRACE_ITM_PORT + 1,
+	               record->id | ((uint32_t) record->arg << 16));
+}
+
+/*--------------------------------------------------------------------------*/
+/* Write a word to a stimulus port, which reads as not ready while its FIFO is
+full. */
+
+static bool itm_put(uint8_t port, uint32_t value)
+{
+	uint32_t wait = ITM_WAIT;
+	while ((ITM_STIM32(port) & ITM_STIM_FIFOREADY) == 0)
+		if (--wait == 0) return false;
+	ITM_STIM32(port) = value;
+	return true;
+}
@@ -0,0 +1,75 @@
+/*	Event Trace
+
+Timestamped event records kept in a RAM ring by a few stores from any
+context, and drained from the background over the ITM stimulus ports to SWO
+when a debugger has enabled them, or otherwise as telemetry frames to a spare
+USART.
+
+15 October 2026
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "buffer.h"
+
+/* Records held, a power of two */
+#ifndef TRACE_RECORDS
+#define TRACE_RECORDS       256
+#endif
+
+/* ITM stimulus port of the time word. The id and argument word goes to the
+next port, so that the decoder pairs them again after an overflow. */
+#define TRACE_ITM_PORT      1
+
+/* Event ids. Those below TRACE_USER are kept for this module. */
+#define TRACE_LOST          0x0001  /* arg: records dropped, ring full */
+#define TRACE_USER          0x0100
+
+/* A record: the DWT cycle count at the event, its id and an argument. It is
+sent as 8 bytes little endian. */
+typedef struct {
+	uint32_t time;
+	uint16_t id;
+	uint16_t arg;
+} trace_record_t;
+
+void trace_init(ring_buffer_t *ring);
+uint32_t trace_drain(void);
+bool trace_itm_enabled(void);
+
+/* Record an event. Without TRACE it compiles to nothing; build with TRACE=1.
+The record is written with interrupts masked for the three stores, and when
+the ring is full it is counted as dropped instead. */
+#ifdef TRACE
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+extern trace_record_t trace_ring[TRACE_RECORDS];
+extern volatile uint32_t trace_head;
+extern volatile uint32_t trace_tail;
+extern volatile uint32_t trace_dropped;
+
+static inline void trace_event(uint16_t id, uint16_t arg)
+{
+	bool masked = cm_mask_interrupts(true);
+	uint32_t head = trace_head;
+	if (head - trace_tail < TRACE_RECORDS)
+	{
+		trace_record_t *record = &trace_ring[head & (TRACE_RECORDS - 1)];
+		record->time = DWT_CYCCNT;
+		record->id = id;
+		record->arg = arg;
+		trace_head = head + 1;
+	}
+	else trace_dropped++;
+	cm_mask_interrupts(masked);
+}
+
+#define TRACE_EVENT(id, arg)    trace_event(id, arg)
+#else
+#define TRACE_EVENT(id, arg)    ((void) 0)
+#endif
+
+#endif
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""Decoder for the event trace of trace.c.
+
+Reads the records either from SWO, as ITM packets captured by the debug probe
+or by a serial adapter on the SWO pin in NRZ mode, or from the
+TELEMETRY_TRACE frames sent on a spare USART, and prints each event with its
+time from the first event and from the one before, in microseconds.
+
+    trace_decode.py swo capture.bin
+    trace_decode.py swo /dev/ttyUSB1 [baudrate]
+    trace_decode.py uart /dev/ttyUSB1 [baudrate]
+
+    --clock HZ      core clock of the cycle counter, default 72000000
+    --names FILE    names of the event ids, a line of "id name" each, with
+                    the id in decimal or 0x hex
+
+A serial port needs pyserial. A summary of events and losses is printed at
+the end (Ctrl-C).
+
+15 October 2026
+"""
+
+import argparse
+import struct
+import sys
+
+from telemetry_decode import Decoder, TELEMETRY_TRACE
+
+# Stimulus port of the time word, TRACE_ITM_PORT, and of the id word after it
+TRACE_ITM_PORT = 1
+
+TRACE_LOST = 0x0001
+
+
+class ItmParser:
+    """Splits an ITM packet stream into (port, value) of the stimulus ports.
+
+    Synchronisation, overflow, timestamp and hardware source packets are
+    passed over, and an overflow is counted."""
+
+    def __init__(self):
+        self.header = None
+        self.size = 0
+        self.payload = bytearray()
+        self.continuation = False
+        self.overflows = 0
+
+    def feed(self, data):
+        words = []
+        for c in data:
+            if self.continuation:
+                self.continuation = (c & 0x80) != 0
+            elif self.header is not None:
+                self.payload.append(c)
+                if len(self.payload) == self.size:
+                    if (self.header & 0x04) == 0:
+                        value = int.from_bytes(self.payload, "little")
+                        words.append((self.header >> 3, value))
+                    self.header = None
+            elif c == 0x00 or c == 0x80:
+                pass
+            elif c == 0x70:
+                self.overflows += 1
+            elif c & 0x03:
+                self.header = c
+                self.size = (1, 2, 4)[(c & 0x03) - 1]
+                self.payload = bytearray()
+            else:
+                self.continuation = (c & 0x80) != 0
+        return words
+
+
+class Trace:
+    """Pairs the words into records and puts the cycle counts on one
+    unwrapped timeline."""
+
+    def __init__(self, clock, names):
+        self.clock = clock
+        self.names = names
+        self.time = None
+        self.raw = 0
+        self.last = None
+        self.events = 0
+        self.lost = 0
+
+    def itm_word(self, port, value):
+        if port == TRACE_ITM_PORT:
+            self.time = value
+        elif port == TRACE_ITM_PORT + 1 and self.time is not None:
+            self.record(self.time, value & 0xFFFF, value >> 16)
+            self.time = None
+
+    def frame(self, payload):
+        for i in range(0, len(payload) - 7, 8):
+            self.record(*struct.unpack_from("<IHH", payload, i))
+
+    def record(self, time, event, arg):
+        if self.last is None:
+            cycles = delta = 0
+        else:
+            delta = (time - self.raw) & 0xFFFFFFFF
+            cycles = self.last + delta
+        self.raw = time
+        self.last = cycles
+        self.events += 1
+        if event == TRACE_LOST:
+            self.lost += arg
+        name = self.names.get(event, "0x%04X" % event)
+        print("%12.3f %+10.3f  %-16s %5d" %
+              (cycles * 1e6 / self.clock, delta * 1e6 / self.clock,
+               name, arg))
+
+
+def read_names(path):
+    names = {TRACE_LOST: "lost"}
+    if path is None:
+        return names
+    with open(path) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) >= 2 and not fields[0].startswith("#"):
+                names[int(fields[0], 0)] = fields[1]
+    return names
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Decode the event trace of trace.c.")
+    parser.add_argument("mode", choices=("swo", "uart"))
+    parser.add_argument("source")
+    parser.add_argument("baudrate", nargs="?", type=int, default=115200)
+    parser.add_argument("--clock", type=int, default=72000000)
+    parser.add_argument("--names")
+    args = parser.parse_args()
+
+    name = args.source
+    live = name.startswith("/dev/") or name.upper().startswith("COM")
+    if live:
+        import serial
+        source = serial.Serial(name, args.baudrate, timeout=0.1)
+    else:
+        source = open(name, "rb")
+    trace = Trace(args.clock, read_names(args.names))
+    itm = ItmParser()
+    decoder = Decoder()
+    try:
+        while True:
+            data = source.read(256)
+            if not data:
+                if not live:
+                    break
+                continue
+            if args.mode == "swo":
+                for word in itm.feed(data):
+                    trace.itm_word(*word)
+            else:
+                for kind, sequence, payload in decoder.feed(data):
+                    if kind == TELEMETRY_TRACE:
+                        trace.frame(payload)
+    except KeyboardInterrupt:
+        pass
+    if args.mode == "swo":
+        print("%d events, %d dropped, %d ITM overflows" %
+              (trace.events, trace.lost, itm.overflows))
+    else:
+        print("%d events, %d dropped, %d frames bad, %d frames lost" %
+              (trace.events, trace.lost, decoder.bad, decoder.lost))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
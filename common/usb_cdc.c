@@ -0,0 +1,419 @@
+/*	USB CDC Virtual COM Port
+
+The device is a CDC-ACM class function of the libopencm3 USB stack on the OTG
+FS core, PA11 (DM) and PA12 (DP) of the STM32F4-Discovery, with VBUS sensed on
+PA9, which therefore cannot carry USART1 TX at the same time. The USB clock is
+the 48MHz PLL Q output given by rcc_clock_setup_hse_3v3 at 168MHz. The stack
+runs from the OTG FS interrupt, so nothing need be polled.
+
+Sending takes the send ring as spans with ring_peek_contiguous, a packet of up
+to 64 bytes at a time, and the transfer complete callback of the bulk IN
+endpoint loads the next packet at once, so the endpoint stays busy for as long
+as the ring holds data. The OTG core has no double buffered endpoints, and the
+stack takes one packet an endpoint at a time, so the FIFO of the IN endpoint
+is the second buffer: the host takes one packet while the next is written. A
+packet is copied out of the ring into a word aligned buffer first, as the core
+FIFO is written a word at a time. When the ring runs dry after a full packet a
+zero length packet ends the host's transfer, so the last data is not held
+back. Producers put to the ring and call usb_cdc_kick, which starts the
+endpoint if it is idle, as they would enable a USART TXE interrupt.
+
+Received packets are put to the receive ring. When the ring has no room for
+another packet the OUT endpoint is set to NAK, holding the host back, until
+the consumer has taken data and called usb_cdc_rx_taken.
+
+Nothing is sent until the host has configured the device and opened the port,
+asserting DTR, so a program writing to the ring with no terminal open fills it
+and its producers drop data in their own way. The line coding is accepted and
+kept but has no effect.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/usb/usbd.h>
+#include <libopencm3/usb/cdc.h>
+#include "irq_priority.h"
+#include "buffer.h"
+#include "usb_cdc.h"
+
+/* Endpoints: data OUT, data IN and the notification IN of the comm interface */
+#define EP_DATA_OUT         0x01
+#define EP_DATA_IN          0x82
+#define EP_NOTIFY           0x83
+
+/* ST's virtual COM port ids, for which hosts load the standard driver */
+#define USB_VENDOR_ID       0x0483
+#define USB_PRODUCT_ID      0x5740
+
+/* DTR bit of SET_CONTROL_LINE_STATE */
+#define CDC_DTR             0x01
+
+static const struct usb_device_descriptor device_descriptor = {
+	.bLength = USB_DT_DEVICE_SIZE,
+	.bDescriptorType = USB_DT_DEVICE,
+	.bcdUSB = 0x0200,
+	.bDeviceClass = USB_CLASS_CDC,
+	.bDeviceSubClass = 0,
+	.bDeviceProtocol = 0,
+	.bMaxPacketSize0 = 64,
+	.idVendor = USB_VENDOR_ID,
+	.idProduct = USB_PRODUCT_ID,
+	.bcdDevice = 0x0200,
+	.iManufacturer = 1,
+	.iProduct = 2,
+	.iSerialNumber = 3,
+	.bNumConfigurations = 1,
+};
+
+static const struct usb_endpoint_descriptor notify_endpoint[] = {{
+	.bLength = USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType = USB_DT_ENDPOINT,
+	.bEndpointAddress = EP_NOTIFY,
+	.bmAttributes = USB_ENDPOINT_ATTR_INTERRUPT,
+	.wMaxPacketSize = 16,
+	.bInterval = 255,
+}};
+
+static const struct usb_endpoint_descriptor data_endpoints[] = {{
+	.bLength = USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType = USB_DT_ENDPOINT,
+	.bEndpointAddress = EP_DATA_OUT,
+	.bmAttributes = USB_ENDPOINT_ATTR_BULK,
+	.wMaxPacketSize = USB_CDC_PACKET,
+	.bInterval = 1,
+}, {
+	.bLength = USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType = USB_DT_ENDPOINT,
+	.bEndpointAddress = EP_DATA_IN,
+	.bmAttributes = USB_ENDPOINT_ATTR_BULK,
+	.wMaxPacketSize = USB_CDC_PACKET,
+	.bInterval = 1,
+}};
+
+static const struct {
+	struct usb_cdc_header_descriptor header;
+	struct usb_cdc_call_management_descriptor call_mgmt;
+	struct usb_cdc_acm_descriptor acm;
+	struct usb_cdc_union_descriptor cdc_union;
+} __attribute__((packed)) cdcacm_functional_descriptors = {
+	.header = {
+		.bFunctionLength = sizeof(struct usb_cdc_header_descriptor),
+		.bDescriptorType = CS_INTERFACE,
+		.bDescriptorSubtype = USB_CDC_TYPE_HEADER,
+		.bcdCDC = 0x0110,
+	},
+	.call_mgmt = {
+		.bFunctionLength =
+			sizeof(struct usb_cdc_call_management_descriptor),
+		.bDescriptorType = CS_INTERFACE,
+		.bDescriptorSubtype = USB_CDC_TYPE_CALL_MANAGEMENT,
+		.bmCapabilities = 0,
+		.bDataInterface = 1,
+	},
+	.acm = {
+		.bFunctionLength = sizeof(struct usb_cdc_acm_descriptor),
+		.bDescriptorType = CS_INTERFACE,
+		.bDescriptorSubtype = USB_CDC_TYPE_ACM,
+		.bmCapabilities = 0,
+	},
+	.cdc_union = {
+		.bFunctionLength = sizeof(struct usb_cdc_union_descriptor),
+		.bDescriptorType = CS_INTERFACE,
+		.bDescriptorSubtype = USB_CDC_TYPE_UNION,
+		.bControlInterface = 0,
+		.bSubordinateInterface0 = 1,
+	 },
+};
+
+static const struct usb_interface_descriptor comm_interface[] = {{
+	.bLength = USB_DT_INTERFACE_SIZE,
+	.bDescriptorType = USB_DT_INTERFACE,
+	.bInterfaceNumber = 0,
+	.bAlternateSetting = 0,
+	.bNumEndpoints = 1,
+	.bInterfaceClass = USB_CLASS_CDC,
+	.bInterfaceSubClass = USB_CDC_SUBCLASS_ACM,
+	.bInterfaceProtocol = USB_CDC_PROTOCOL_AT,
+	.iInterface = 0,
+	.endpoint = notify_endpoint,
+	.extra = &cdcacm_functional_descriptors,
+	.extralen = sizeof(cdcacm_functional_descriptors),
+}};
+
+static const struct usb_interface_descriptor data_interface[] = {{
+	.bLength = USB_DT_INTERFACE_SIZE,
+	.bDescriptorType = USB_DT_INTERFACE,
+	.bInterfaceNumber = 1,
+	.bAlternateSetting = 0,
+	.bNumEndpoints = 2,
+	.bInterfaceClass = USB_CLASS_DATA,
+	.bInterfaceSubClass = 0,
+	.bInterfaceProtocol = 0,
+	.iInterface = 0,
+	.endpoint = data_endpoints,
+}};
+
+static const struct usb_interface interfaces[] = {{
+	.num_altsetting = 1,
+	.altsetting = comm_interface,
+}, {
+	.num_altsetting = 1,
+	.altsetting = data_interface,
+}};
+
+static const struct usb_config_descriptor config_descriptor = {
+	.bLength = USB_DT_CONFIGURATION_SIZE,
+	.bDescriptorType = USB_DT_CONFIGURATION,
+	.wTotalLength = 0,
+	.bNumInterfaces = 2,
+	.bConfigurationValue = 1,
+	.iConfiguration = 0,
+	.bmAttributes = 0x80,
+	.bMaxPower = 0x32,
+	.interface = interfaces,
+};
+
+static const char *usb_strings[] = {
+	"ARM-Ports",
+	"CDC-ACM Virtual COM Port",
+	"0001",
+};
+
+static usbd_device *usb_device;
+static uint8_t control_buffer[128];
+static ring_buffer_t *send_ring;
+static ring_buffer_t *receive_ring;
+static uint32_t packet[USB_CDC_PACKET/4];
+static struct usb_cdc_line_coding line_coding = {
+	.dwDTERate = 115200,
+	.bCharFormat = USB_CDC_1_STOP_BITS,
+	.bParityType = USB_CDC_NO_PARITY,
+	.bDataBits = 8,
+};
+static volatile bool configured;
+static volatile bool port_open;
+/* A packet is in the IN endpoint */
+static volatile bool in_busy;
+/* The last packet sent was full, so the transfer is not yet ended */
+static bool in_full;
+static volatile bool out_nak;
+static usb_cdc_stats_t stats;
+
+static void set_config(usbd_device *device, uint16_t value);
+static enum usbd_request_return_codes control_request(usbd_device *device,
+	struct usb_setup_data *req, uint8_t **buf, uint16_t *len,
+	void (**complete)(usbd_device *device, struct usb_setup_data *req));
+static void data_in(usbd_device *device, uint8_t ep);
+static void data_out(usbd_device *device, uint8_t ep);
+static void send_next(void);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the USB Device
+
+The OTG FS pins and clock are set up and the device connects to the bus. The
+system clock must already give 48MHz to the USB.
+
+@param[in] send: ring of bytes for the host, or 0 for none.
+@param[in] receive: ring for bytes from the host, or 0 to discard them.
+*/
+
+void usb_cdc_init(ring_buffer_t *send, ring_buffer_t *receive)
+{
+	send_ring = send;
+	receive_ring = receive;
+	configured = false;
+	port_open = false;
+	in_busy = false;
+	in_full = false;
+	out_nak = false;
+	memset(&stats, 0, sizeof(stats));
+
+	rcc_periph_clock_enable(RCC_GPIOA);
+	rcc_periph_clock_enable(RCC_OTGFS);
+	gpio_mode_setup(GPIOA, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO11 | GPIO12);
+	gpio_set_af(GPIOA, GPIO_AF10, GPIO11 | GPIO12);
+
+	usb_device = usbd_init(&otgfs_usb_driver, &device_descriptor,
+	                       &config_descriptor, usb_strings, 3,
+	                       control_buffer, sizeof(control_buffer));
+	usbd_register_set_config_callback(usb_device, set_config);
+
+	IRQ_PRIORITY_SET(NVIC_OTG_FS_IRQ, IRQ_LEVEL_COMM);
+	nvic_enable_irq(NVIC_OTG_FS_IRQ);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start Sending
+
+Called after data is put to the send ring. The IN endpoint is loaded if it is
+idle, and otherwise takes the data when the packet in it has gone.
+*/
+
+void usb_cdc_kick(void)
+{
+	bool masked = cm_mask_interrupts(true);
+	if (! in_busy) send_next();
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Data Taken from the Receive Ring
+
+Called by the consumer after taking data, so that the host may send again
+once there is room for a packet.
+*/
+
+void usb_cdc_rx_taken(void)
+{
+	bool masked = cm_mask_interrupts(true);
+	if (out_nak && (receive_ring != 0) &&
+	    (ring_space(receive_ring) >= USB_CDC_PACKET))
+	{
+		out_nak = false;
+		usbd_ep_nak_set(usb_device, EP_DATA_OUT, 0);
+	}
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check the Host has the Port Open
+
+@returns true if the device is configured and the host has asserted DTR.
+*/
+
+bool usb_cdc_connected(void)
+{
+	return configured && port_open;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Read the Statistics
+
+@param[out] copy: packet and drop counts since usb_cdc_init.
+*/
+
+void usb_cdc_read_stats(usb_cdc_stats_t *copy)
+{
+	bool masked = cm_mask_interrupts(true);
+	*copy = stats;
+	cm_mask_interrupts(masked);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Set up the endpoints when the host selects the configuration. */
+
+static void set_config(usbd_device *device, uint16_t value)
+{
+	(void) value;
+	usbd_ep_setup(device, EP_DATA_OUT, USB_ENDPOINT_ATTR_BULK,
+	              USB_CDC_PACKET, data_out);
+	usbd_ep_setup(device, EP_DATA_IN, USB_ENDPOINT_ATTR_BULK,
+	              USB_CDC_PACKET, data_in);
+	usbd_ep_setup(device, EP_NOTIFY, USB_ENDPOINT_ATTR_INTERRUPT, 16, 0);
+	usbd_register_control_callback(device,
+	                               USB_REQ_TYPE_CLASS | USB_REQ_TYPE_INTERFACE,
+	                               USB_REQ_TYPE_TYPE | USB_REQ_TYPE_RECIPIENT,
+	                               control_request);
+	in_busy = false;
+	in_full = false;
+	out_nak = false;
+	configured = true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Requests of the ACM class. DTR opens and closes the port, and the line
+coding is kept for the host to read back. */
+
+static enum usbd_request_return_codes control_request(usbd_device *device,
+	struct usb_setup_data *req, uint8_t **buf, uint16_t *len,
+	void (**complete)(usbd_device *device, struct usb_setup_data *req))
+{
+	(void) device;
+	(void) complete;
+	switch (req->bRequest)
+	{
+	case USB_CDC_REQ_SET_CONTROL_LINE_STATE:
+		port_open = (req->wValue & CDC_DTR) != 0;
+		if (port_open) usb_cdc_kick();
+		return USBD_REQ_HANDLED;
+	case USB_CDC_REQ_SET_LINE_CODING:
+		if (*len < sizeof(struct usb_cdc_line_coding)) return USBD_REQ_NOTSUPP;
+		memcpy(&line_coding, *buf, sizeof(struct usb_cdc_line_coding));
+		return USBD_REQ_HANDLED;
+	case 0x21:                  /* GET_LINE_CODING */
+		*buf = (uint8_t *) &line_coding;
+		*len = sizeof(struct usb_cdc_line_coding);
+		return USBD_REQ_HANDLED;
+	}
+	return USBD_REQ_NOTSUPP;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Load the IN endpoint with the next packet from the send ring, or with a
+zero length packet to end a transfer of full packets. Called with the OTG
+interrupt excluded. */
+
+static void send_next(void)
+{
+	in_busy = false;
+	if (! configured || ! port_open || (send_ring == 0)) return;
+	uint8_t *span;
+	uint32_t length = ring_peek_contiguous(send_ring, &span);
+	if (length == 0)
+	{
+		if (! in_full) return;
+		in_full = false;
+		in_busy = (usbd_ep_write_packet(usb_device, EP_DATA_IN, packet, 0) == 0);
+		return;
+	}
+	if (length > USB_CDC_PACKET) length = USB_CDC_PACKET;
+	memcpy(packet, span, length);
+	if (usbd_ep_write_packet(usb_device, EP_DATA_IN, packet, length) == 0)
+		return;
+	ring_consume(send_ring, length);
+	in_full = (length == USB_CDC_PACKET);
+	in_busy = true;
+	stats.packets_in++;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Transfer complete of the IN endpoint: the host has the packet. */
+
+static void data_in(usbd_device *device, uint8_t ep)
+{
+	(void) device;
+	(void) ep;
+	send_next();
+}
+
+/*--------------------------------------------------------------------------*/
+/* A packet from the host, put to the receive ring. */
+
+static void data_out(usbd_device *device, uint8_t ep)
+{
+	uint16_t length = usbd_ep_read_packet(device, ep, packet, USB_CDC_PACKET);
+	stats.packets_out++;
+	if (receive_ring == 0) return;
+	uint32_t put = ring_put_n(receive_ring, (uint8_t *) packet, length);
+	stats.rx_dropped += length - put;
+	if (ring_space(receive_ring) < USB_CDC_PACKET)
+	{
+		out_nak = true;
+		usbd_ep_nak_set(device, ep, 1);
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/* OTG FS Interrupt */
+
+void otg_fs_isr(void)
+{
+	usbd_poll(usb_device);
+}
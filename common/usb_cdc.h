@@ -0,0 +1,33 @@
+/*	USB CDC Virtual COM Port
+
+A CDC-ACM device on the USB OTG FS port of the STM32F4, carrying the bytes of
+a send ring to the host and those from the host to a receive ring, so that
+telemetry.c, trace.c or any other producer of a ring can go to a PC at USB
+speed in place of a USART.
+
+15 October 2026
+*/
+
+#ifndef USB_CDC_H
+#define USB_CDC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "buffer.h"
+
+/* Largest packet of the bulk endpoints at full speed */
+#define USB_CDC_PACKET      64
+
+typedef struct {
+	uint32_t packets_in;        /* packets sent to the host */
+	uint32_t packets_out;       /* packets received from the host */
+	uint32_t rx_dropped;        /* bytes received with the ring full */
+} usb_cdc_stats_t;
+
+void usb_cdc_init(ring_buffer_t *send, ring_buffer_t *receive);
+void usb_cdc_kick(void);
+void usb_cdc_rx_taken(void);
+bool usb_cdc_connected(void);
+void usb_cdc_read_stats(usb_cdc_stats_t *stats);
+
+#endif
@@ -0,0 +1,366 @@
+/*	Waveform Tables
+
+Constant tables of one cycle of a waveform, kept in flash for DMA to the DAC.
+Generated by wavetable.py, do not edit. Choose the shape with WAVEFORM, one
+of the WAVEFORM_ values, the default being WAVEFORM_FUNKY.
+
+14 October 2026
+*/
+
+#ifndef WAVETABLE_H
+#define WAVETABLE_H
+
+#include <stdint.h>
+
+#define WAVETABLE_SIZE      256
+
+#define WAVEFORM_FUNKY          0
+#define WAVEFORM_SINE           1
+#define WAVEFORM_TRIANGLE       2
+#define WAVEFORM_SAWTOOTH       3
+
+#ifndef WAVEFORM
+#define WAVEFORM            WAVEFORM_FUNKY
+#endif
+
+#if WAVEFORM == WAVEFORM_FUNKY
+
+/* 8 bit samples */
+static const uint8_t wavetable_8bit[WAVETABLE_SIZE]
+	__attribute__((unused)) =
+{
+	 10,  10,  10,  10,  10,  10,  10,  10,  10,  10,  10,  10,  11,  11,  11,  11,
+	 12,  12,  12,  12,  13,  13,  13,  14,  14,  14,  15,  15,  16,  16,  17,  17,
+	 18,  18,  19,  19,  20,  20,  21,  21,  22,  23,  23,  24,  25,  25,  26,  27,
+	 28,  28,  29,  30,  31,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,  41,
+	 42,  43,  44,  45,  46,  47,  48,  49,  50,  51,  52,  53,  55,  56,  57,  58,
+	 60,  61,  62,  63,  65,  66,  67,  69,  70,  71,  73,  74,  76,  77,  79,  80,
+	 82,  83,  85,  86,  88,  89,  91,  92,  94,  96,  97,  99, 101, 102, 104, 106,
+	108, 109, 111, 113, 115, 116, 118, 120, 122, 128, 128, 128, 128, 128, 128, 128,
+	128, 127, 126, 125, 124, 123, 122, 121, 120, 119, 118, 117, 116, 115, 114, 113,
+	112, 111, 110, 109, 108, 107, 106, 105, 104, 103, 102, 101, 100,  99,  98,  97,
+	 96,  95,  94,  93,  92,  91,  90,  89,  88,  87,  86,  85,  84,  83,  82,  81,
+	 80,  79,  78,  77,  76,  75,  74,  73,  72,  71,  70,  69,  68,  67,  66,  65,
+	 64,  63,  62,  61,  60,  59,  58,  57,  56,  55,  54,  53,  52,  51,  50,  49,
+	 48,  47,  46,  45,  44,  43,  42,  41,  40,  39,  38,  37,  36,  35,  34,  33,
+	 32,  31,  30,  29,  28,  27,  26,  25,  24,  23,  22,  21,  20,  19,  18,  17,
+	 16,  15,  14,  13,  12,  11,  10,  10,  10,  10,  10,  10,  10,  10,  10,  10
+};
+
+/* 12 bit samples */
+static const uint16_t wavetable_12bit[WAVETABLE_SIZE]
+	__attribute__((unused)) =
+{
+	 160,  160,  160,  160,  160,  160,  160,  160,  160,  160,  160,  160,
+	 176,  176,  176,  176,  192,  192,  192,  192,  208,  208,  208,  224,
+	 224,  224,  240,  240,  256,  256,  272,  272,  288,  288,  304,  304,
+	 320,  320,  336,  336,  352,  368,  368,  384,  400,  400,  416,  432,
+	 448,  448,  464,  480,  496,  496,  512,  528,  544,  560,  576,  592,
+	 608,  624,  640,  656,  672,  688,  704,  720,  736,  752,  768,  784,
+	 800,  816,  832,  848,  880,  896,  912,  928,  960,  976,  992, 1008,
+	1040, 1056, 1072, 1104, 1120, 1136, 1168, 1184, 1216, 1232, 1264, 1280,
+	1312, 1328, 1360, 1376, 1408, 1424, 1456, 1472, 1504, 1536, 1552, 1584,
+	1616, 1632, 1664, 1696, 1728, 1744, 1776, 1808, 1840, 1856, 1888, 1920,
+	1952, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2032, 2016, 2000,
+	1984, 1968, 1952, 1936, 1920, 1904, 1888, 1872, 1856, 1840, 1824, 1808,
+	1792, 1776, 1760, 1744, 1728, 1712, 1696, 1680, 1664, 1648, 1632, 1616,
+	1600, 1584, 1568, 1552, 1536, 1520, 1504, 1488, 1472, 1456, 1440, 1424,
+	1408, 1392, 1376, 1360, 1344, 1328, 1312, 1296, 1280, 1264, 1248, 1232,
+	1216, 1200, 1184, 1168, 1152, 1136, 1120, 1104, 1088, 1072, 1056, 1040,
+	1024, 1008,  992,  976,  960,  944,  928,  912,  896,  880,  864,  848,
+	 832,  816,  800,  784,  768,  752,  736,  720,  704,  688,  672,  656,
+	 640,  624,  608,  592,  576,  560,  544,  528,  512,  496,  480,  464,
+	 448,  432,  416,  400,  384,  368,  352,  336,  320,  304,  288,  272,
+	 256,  240,  224,  208,  192,  176,  160,  160,  160,  160,  160,  160,
+	 160,  160,  160,  160
+};
+
+/* Dual 8 bit samples with a sawtooth in the high byte */
+static const uint16_t wavetable_dual_8bit[WAVETABLE_SIZE]
+	__attribute__((unused)) =
+{
+	0x000A, 0x010A, 0x020A, 0x030A, 0x040A, 0x050A, 0x060A, 0x070A, 0x080A, 0x090A,
+	0x0A0A, 0x0B0A, 0x0C0B, 0x0D0B, 0x0E0B, 0x0F0B, 0x100C, 0x110C, 0x120C, 0x130C,
+	0x140D, 0x150D, 0x160D, 0x170E, 0x180E, 0x190E, 0x1A0F, 0x1B0F, 0x1C10, 0x1D10,
+	0x1E11, 0x1F11, 0x2012, 0x2112, 0x2213, 0x2313, 0x2414, 0x2514, 0x2615, 0x2715,
+	0x2816, 0x2917, 0x2A17, 0x2B18, 0x2C19, 0x2D19, 0x2E1A, 0x2F1B, 0x301C, 0x311C,
+	0x321D, 0x331E, 0x341F, 0x351F, 0x3620, 0x3721, 0x3822, 0x3923, 0x3A24, 0x3B25,
+	0x3C26, 0x3D27, 0x3E28, 0x3F29, 0x402A, 0x412B, 0x422C, 0x432D, 0x442E, 0x452F,
+	0x4630, 0x4731, 0x4832, 0x4933, 0x4A34, 0x4B35, 0x4C37, 0x4D38, 0x4E39, 0x4F3A,
+	0x503C, 0x513D, 0x523E, 0x533F, 0x5441, 0x5542, 0x5643, 0x5745, 0x5846, 0x5947,
+	0x5A49, 0x5B4A, 0x5C4C, 0x5D4D, 0x5E4F, 0x5F50, 0x6052, 0x6153, 0x6255, 0x6356,
+	0x6458, 0x6559, 0x665B, 0x675C, 0x685E, 0x6960, 0x6A61, 0x6B63, 0x6C65, 0x6D66,
+	0x6E68, 0x6F6A, 0x706C, 0x716D, 0x726F, 0x7371, 0x7473, 0x7574, 0x7676, 0x7778,
+	0x787A, 0x7980, 0x7A80, 0x7B80, 0x7C80, 0x7D80, 0x7E80, 0x7F80, 0x8080, 0x817F,
+	0x827E, 0x837D, 0x847C, 0x857B, 0x867A, 0x8779, 0x8878, 0x8977, 0x8A76, 0x8B75,
+	0x8C74, 0x8D73, 0x8E72, 0x8F71, 0x9070, 0x916F, 0x926E, 0x936D, 0x946C, 0x956B,
+	0x966A, 0x9769, 0x9868, 0x9967, 0x9A66, 0x9B65, 0x9C64, 0x9D63, 0x9E62, 0x9F61,
+	0xA060, 0xA15F, 0xA25E, 0xA35D, 0xA45C, 0xA55B, 0xA65A, 0xA759, 0xA858, 0xA957,
+	0xAA56, 0xAB55, 0xAC54, 0xAD53, 0xAE52, 0xAF51, 0xB050, 0xB14F, 0xB24E, 0xB34D,
+	0xB44C, 0xB54B, 0xB64A, 0xB749, 0xB848, 0xB947, 0xBA46, 0xBB45, 0xBC44, 0xBD43,
+	0xBE42, 0xBF41, 0xC040, 0xC13F, 0xC23E, 0xC33D, 0xC43C, 0xC53B, 0xC63A, 0xC739,
+	0xC838, 0xC937, 0xCA36, 0xCB35, 0xCC34, 0xCD33, 0xCE32, 0xCF31, 0xD030, 0xD12F,
+	0xD22E, 0xD32D, 0xD42C, 0xD52B, 0xD62A, 0xD729, 0xD828, 0xD927, 0xDA26, 0xDB25,
+	0xDC24, 0xDD23, 0xDE22, 0xDF21, 0xE020, 0xE11F, 0xE21E, 0xE31D, 0xE41C, 0xE51B,
+	0xE61A, 0xE719, 0xE818, 0xE917, 0xEA16, 0xEB15, 0xEC14, 0xED13, 0xEE12, 0xEF11,
+	0xF010, 0xF10F, 0xF20E, 0xF30D, 0xF40C, 0xF50B, 0xF60A, 0xF70A, 0xF80A, 0xF90A,
+	0xFA0A, 0xFB0A, 0xFC0A, 0xFD0A, 0xFE0A, 0xFF0A
+};
+
+#elif WAVEFORM == WAVEFORM_SINE
+
+/* 8 bit samples */
+static const uint8_t wavetable_8bit[WAVETABLE_SIZE]
+	__attribute__((unused)) =
+{
+	128, 131, 134, 137, 140, 143, 146, 149, 152, 155, 158, 162, 165, 167, 170, 173,
+	176, 179, 182, 185, 188, 190, 193, 196, 198, 201, 203, 206, 208, 211, 213, 215,
+	218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 238, 240, 241, 243, 244,
+	245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255,
+	255, 255, 255, 255, 254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
+	245, 244, 243, 241, 240, 238, 237, 235, 234, 232, 230, 228, 226, 224, 222, 220,
+	218, 215, 213, 211, 208, 206, 203, 201, 198, 196, 193, 190, 188, 185, 182, 179,
+	176, 173, 170, 167, 165, 162, 158, 155, 152, 149, 146, 143, 140, 137, 134, 131,
+	128, 124, 121, 118, 115, 112, 109, 106, 103, 100,  97,  93,  90,  88,  85,  82,
+	 79,  76,  73,  70,  67,  65,  62,  59,  57,  54,  52,  49,  47,  44,  42,  40,
+	 37,  35,  33,  31,  29,  27,  25,  23,  21,  20,  18,  17,  15,  14,  12,  11,
+	 10,   9,   7,   6,   5,   5,   4,   3,   2,   2,   1,   1,   1,   0,   0,   0,
+	  0,   0,   0,   0,   1,   1,   1,   2,   2,   3,   4,   5,   5,   6,   7,   9,
+	 10,  11,  12,  14,  15,  17,  18,  20,  21,  23,  25,  27,  29,  31,  33,  35,
+	 37,  40,  42,  44,  47,  49,  52,  54,  57,  59,  62,  65,  67,  70,  73,  76,
+	 79,  82,  85,  88,  90,  93,  97, 100, 103, 106, 109, 112, 115, 118, 121, 124
+};
+
+/* 12 bit samples */
+static const uint16_t wavetable_12bit[WAVETABLE_SIZE]
+	__attribute__((unused)) =
+{
+	2048, 2098, 2148, 2198, 2248, 2298, 2348, 2398, 2447, 2496, 2545, 2594,
+	2642, 2690, 2737, 2784, 2831, 2877, 2923, 2968, 3013, 3057, 3100, 3143,
+	3185, 3226, 3267, 3307, 3346, 3385, 3423, 3459, 3495, 3530, 3565, 3598,
+	3630, 3662, 3692, 3722, 3750, 3777, 3804, 3829, 3853, 3876, 3898, 3919,
+	3939, 3958, 3975, 3992, 4007, 4021, 4034, 4045, 4056, 4065, 4073, 4080,
+	4085, 4089, 4093, 4094, 4095, 4094, 4093, 4089, 4085, 4080, 4073, 4065,
+	4056, 4045, 4034, 4021, 4007, 3992, 3975, 3958, 3939, 3919, 3898, 3876,
+	3853, 3829, 3804, 3777, 3750, 3722, 3692, 3662, 3630, 3598, 3565, 3530,
+	3495, 3459, 3423, 3385, 3346, 3307, 3267, 3226, 3185, 3143, 3100, 3057,
+	3013, 2968, 2923, 2877, 2831, 2784, 2737, 2690, 2642, 2594, 2545, 2496,
+	2447, 2398, 2348, 2298, 2248, 2198, 2148, 2098, 2048, 1997, 1947, 1897,
+	1847, 1797, 1747, 1697, 1648, 1599, 1550, 1501, 1453, 1405, 1358, 1311,
+	1264, 1218, 1172, 1127, 1082, 1038,  995,  952,  910,  869,  828,  788,
+	 749,  710,  672,  636,  600,  565,  530,  497,  465,  433,  403,  373,
+	 345,  318,  291,  266,  242,  219,  197,  176,  156,  137,  120,  103,
+	  88,   74,   61,   50,   39,   30,   22,   15,   10,    6,    2,    1,
+	   0,    1,    2,    6,   10,   15,   22,   30,   39,   50,   61,   74,
+	  88,  103,  120,  137,  156,  176,  197,  219,  242,  266,  291,  318,
+	 345,  373,  403,  433,  465,  497,  530,  565,  600,  636,  672,  710,
+	 749,  788,  828,  869,  910,  952,  995, 1038, 1082, 1127, 1172, 1218,
+	1264, 1311, 1358, 1405, 1453, 1501, 1550, 1599, 1648, 1697, 1747, 1797,
+	1847, 1897, 1947, 1997
+};
+
+/* Dual 8 bit samples with a sawtooth in the high byte */
+static const uint16_t wavetable_dual_8bit[WAVETABLE_SIZE]
+	__attribute__((unused)) =
+{
+	0x0080, 0x0183, 0x0286, 0x0389, 0x048C, 0x058F, 0x0692, 0x0795, 0x0898, 0x099B,
+	0x0A9E, 0x0BA2, 0x0CA5, 0x0DA7, 0x0EAA, 0x0FAD, 0x10B0, 0x11B3, 0x12B6, 0x13B9,
+	0x14BC, 0x15BE, 0x16C1, 0x17C4, 0x18C6, 0x19C9, 0x1ACB, 0x1BCE, 0x1CD0, 0x1DD3,
+	0x1ED5, 0x1FD7, 0x20DA, 0x21DC, 0x22DE, 0x23E0, 0x24E2, 0x25E4, 0x26E6, 0x27E8,
+	0x28EA, 0x29EB, 0x2AED, 0x2BEE, 0x2CF0, 0x2DF1, 0x2EF3, 0x2FF4, 0x30F5, 0x31F6,
+	0x32F8, 0x33F9, 0x34FA, 0x35FA, 0x36FB, 0x37FC, 0x38FD, 0x39FD, 0x3AFE, 0x3BFE,
+	0x3CFE, 0x3DFF, 0x3EFF, 0x3FFF, 0x40FF, 0x41FF, 0x42FF, 0x43FF, 0x44FE, 0x45FE,
+	0x46FE, 0x47FD, 0x48FD, 0x49FC, 0x4AFB, 0x4BFA, 0x4CFA, 0x4DF9, 0x4EF8, 0x4FF6,
+	0x50F5, 0x51F4, 0x52F3, 0x53F1, 0x54F0, 0x55EE, 0x56ED, 0x57EB, 0x58EA, 0x59E8,
+	0x5AE6, 0x5BE4, 0x5CE2, 0x5DE0, 0x5EDE, 0x5FDC, 0x60DA, 0x61D7, 0x62D5, 0x63D3,
+	0x64D0, 0x65CE, 0x66CB, 0x67C9, 0x68C6, 0x69C4, 0x6AC1, 0x6BBE, 0x6CBC, 0x6DB9,
+	0x6EB6, 0x6FB3, 0x70B0, 0x71AD, 0x72AA, 0x73A7, 0x74A5, 0x75A2, 0x769E, 0x779B,
+	0x7898, 0x7995, 0x7A92, 0x7B8F, 0x7C8C, 0x7D89, 0x7E86, 0x7F83, 0x8080, 0x817C,
+	0x8279, 0x8376, 0x8473, 0x8570, 0x866D, 0x876A, 0x8867, 0x8964, 0x8A61, 0x8B5D,
+	0x8C5A, 0x8D58, 0x8E55, 0x8F52, 0x904F, 0x914C, 0x9249, 0x9346, 0x9443, 0x9541,
+	0x963E, 0x973B, 0x9839, 0x9936, 0x9A34, 0x9B31, 0x9C2F, 0x9D2C, 0x9E2A, 0x9F28,
+	0xA025, 0xA123, 0xA221, 0xA31F, 0xA41D, 0xA51B, 0xA619, 0xA717, 0xA815, 0xA914,
+	0xAA12, 0xAB11, 0xAC0F, 0xAD0E, 0xAE0C, 0xAF0B, 0xB00A, 0xB109, 0xB207, 0xB306,
+	0xB405, 0xB505, 0xB604, 0xB703, 0xB802, 0xB902, 0xBA01, 0xBB01, 0xBC01, 0xBD00,
+	0xBE00, 0xBF00, 0xC000, 0xC100, 0xC200, 0xC300, 0xC401, 0xC501, 0xC601, 0xC702,
+	0xC802, 0xC903, 0xCA04, 0xCB05, 0xCC05, 0xCD06, 0xCE07, 0xCF09, 0xD00A, 0xD10B,
+	0xD20C, 0xD30E, 0xD40F, 0xD511, 0xD612, 0xD714, 0xD815, 0xD917, 0xDA19, 0xDB1B,
+	0xDC1D, 0xDD1F, 0xDE21, 0xDF23, 0xE025, 0xE128, 0xE22A, 0xE32C, 0xE42F, 0xE531,
+	0xE634, 0xE736, 0xE839, 0xE93B, 0xEA3E, 0xEB41, 0xEC43, 0xED46, 0xEE49, 0xEF4C,
+	0xF04F, 0xF152, 0xF255, 0xF358, 0xF45A, 0xF55D, 0xF661, 0xF764, 0xF867, 0xF96A,
+	0xFA6D, 0xFB70, 0xFC73, 0xFD76, 0xFE79, 0xFF7C
+};
+
+#elif WAVEFORM == WAVEFORM_TRIANGLE
+
+/* 8 bit samples */
+static const uint8_t wavetable_8bit[WAVETABLE_SIZE]
+	__attribute__((unused)) =
+{
+	  0,   2,   4,   6,   8,  10,  12,  14,  16,  18,  20,  22,  24,  26,  28,  30,
+	 32,  34,  36,  38,  40,  42,  44,  46,  48,  50,  52,  54,  56,  58,  60,  62,
+	 64,  66,  68,  70,  72,  74,  76,  78,  80,  82,  84,  86,  88,  90,  92,  94,
+	 96,  98, 100, 102, 104, 106, 108, 110, 112, 114, 116, 118, 120, 122, 124, 126,
+	128, 129, 131, 133, 135, 137, 139, 141, 143, 145, 147, 149, 151, 153, 155, 157,
+	159, 161, 163, 165, 167, 169, 171, 173, 175, 177, 179, 181, 183, 185, 187, 189,
+	191, 193, 195, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+	223, 225, 227, 229, 231, 233, 235, 237, 239, 241, 243, 245, 247, 249, 251, 253,
+	255, 253, 251, 249, 247, 245, 243, 241, 239, 237, 235, 233, 231, 229, 227, 225,
+	223, 221, 219, 217, 215, 213, 211, 209, 207, 205, 203, 201, 199, 197, 195, 193,
+	191, 189, 187, 185, 183, 181, 179, 177, 175, 173, 171, 169, 167, 165, 163, 161,
+	159, 157, 155, 153, 151, 149, 147, 145, 143, 141, 139, 137, 135, 133, 131, 129,
+	128, 126, 124, 122, 120, 118, 116, 114, 112, 110, 108, 106, 104, 102, 100,  98,
+	 96,  94,  92,  90,  88,  86,  84,  82,  80,  78,  76,  74,  72,  70,  68,  66,
+	 64,  62,  60,  58,  56,  54,  52,  50,  48,  46,  44,  42,  40,  38,  36,  34,
+	 32,  30,  28,  26,  24,  22,  20,  18,  16,  14,  12,  10,   8,   6,   4,   2
+};
+
+/* 12 bit samples */
+static const uint16_t wavetable_12bit[WAVETABLE_SIZE]
+	__attribute__((unused)) =
+{
+	   0,   32,   64,   96,  128,  160,  192,  224,  256,  288,  320,  352,
+	 384,  416,  448,  480,  512,  544,  576,  608,  640,  672,  704,  736,
+	 768,  800,  832,  864,  896,  928,  960,  992, 1024, 1056, 1088, 1120,
+	1152, 1184, 1216, 1248, 1280, 1312, 1344, 1376, 1408, 1440, 1472, 1504,
+	1536, 1568, 1600, 1632, 1664, 1696, 1728, 1760, 1792, 1824, 1856, 1888,
+	1920, 1952, 1984, 2016, 2048, 2079, 2111, 2143, 2175, 2207, 2239, 2271,
+	2303, 2335, 2367, 2399, 2431, 2463, 2495, 2527, 2559, 2591, 2623, 2655,
+	2687, 2719, 2751, 2783, 2815, 2847, 2879, 2911, 2943, 2975, 3007, 3039,
+	3071, 3103, 3135, 3167, 3199, 3231, 3263, 3295, 3327, 3359, 3391, 3423,
+	3455, 3487, 3519, 3551, 3583, 3615, 3647, 3679, 3711, 3743, 3775, 3807,
+	3839, 3871, 3903, 3935, 3967, 3999, 4031, 4063, 4095, 4063, 4031, 3999,
+	3967, 3935, 3903, 3871, 3839, 3807, 3775, 3743, 3711, 3679, 3647, 3615,
+	3583, 3551, 3519, 3487, 3455, 3423, 3391, 3359, 3327, 3295, 3263, 3231,
+	3199, 3167, 3135, 3103, 3071, 3039, 3007, 2975, 2943, 2911, 2879, 2847,
+	2815, 2783, 2751, 2719, 2687, 2655, 2623, 2591, 2559, 2527, 2495, 2463,
+	2431, 2399, 2367, 2335, 2303, 2271, 2239, 2207, 2175, 2143, 2111, 2079,
+	2048, 2016, 1984, 1952, 1920, 1888, 1856, 1824, 1792, 1760, 1728, 1696,
+	1664, 1632, 1600, 1568, 1536, 1504, 1472, 1440, 1408, 1376, 1344, 1312,
+	1280, 1248, 1216, 1184, 1152, 1120, 1088, 1056, 1024,  992,  960,  928,
+	 896,  864,  832,  800,  768,  736,  704,  672,  640,  608,  576,  544,
+	 512,  480,  448,  416,  384,  352,  320,  288,  256,  224,  192,  160,
+	 128,   96,   64,   32
+};
+
+/* Dual 8 bit samples with a sawtooth in the high byte */
+static const uint16_t wavetable_dual_8bit[WAVETABLE_SIZE]
+	__attribute__((unused)) =
+{
+	0x0000, 0x0102, 0x0204, 0x0306, 0x0408, 0x050A, 0x060C, 0x070E, 0x0810, 0x0912,
+	0x0A14, 0x0B16, 0x0C18, 0x0D1A, 0x0E1C, 0x0F1E, 0x1020, 0x1122, 0x1224, 0x1326,
+	0x1428, 0x152A, 0x162C, 0x172E, 0x1830, 0x1932, 0x1A34, 0x1B36, 0x1C38, 0x1D3A,
+	0x1E3C, 0x1F3E, 0x2040, 0x2142, 0x2244, 0x2346, 0x2448, 0x254A, 0x264C, 0x274E,
+	0x2850, 0x2952, 0x2A54, 0x2B56, 0x2C58, 0x2D5A, 0x2E5C, 0x2F5E, 0x3060, 0x3162,
+	0x3264, 0x3366, 0x3468, 0x356A, 0x366C, 0x376E, 0x3870, 0x3972, 0x3A74, 0x3B76,
+	0x3C78, 0x3D7A, 0x3E7C, 0x3F7E, 0x4080, 0x4181, 0x4283, 0x4385, 0x4487, 0x4589,
+	0x468B, 0x478D, 0x488F, 0x4991, 0x4A93, 0x4B95, 0x4C97, 0x4D99, 0x4E9B, 0x4F9D,
+	0x509F, 0x51A1, 0x52A3, 0x53A5, 0x54A7, 0x55A9, 0x56AB, 0x57AD, 0x58AF, 0x59B1,
+	0x5AB3, 0x5BB5, 0x5CB7, 0x5DB9, 0x5EBB, 0x5FBD, 0x60BF, 0x61C1, 0x62C3, 0x63C5,
+	0x64C7, 0x65C9, 0x66CB, 0x67CD, 0x68CF, 0x69D1, 0x6AD3, 0x6BD5, 0x6CD7, 0x6DD9,
+	0x6EDB, 0x6FDD, 0x70DF, 0x71E1, 0x72E3, 0x73E5, 0x74E7, 0x75E9, 0x76EB, 0x77ED,
+	0x78EF, 0x79F1, 0x7AF3, 0x7BF5, 0x7CF7, 0x7DF9, 0x7EFB, 0x7FFD, 0x80FF, 0x81FD,
+	0x82FB, 0x83F9, 0x84F7, 0x85F5, 0x86F3, 0x87F1, 0x88EF, 0x89ED, 0x8AEB, 0x8BE9,
+	0x8CE7, 0x8DE5, 0x8EE3, 0x8FE1, 0x90DF, 0x91DD, 0x92DB, 0x93D9, 0x94D7, 0x95D5,
+	0x96D3, 0x97D1, 0x98CF, 0x99CD, 0x9ACB, 0x9BC9, 0x9CC7, 0x9DC5, 0x9EC3, 0x9FC1,
+	0xA0BF, 0xA1BD, 0xA2BB, 0xA3B9, 0xA4B7, 0xA5B5, 0xA6B3, 0xA7B1, 0xA8AF, 0xA9AD,
+	0xAAAB, 0xABA9, 0xACA7, 0xADA5, 0xAEA3, 0xAFA1, 0xB09F, 0xB19D, 0xB29B, 0xB399,
+	0xB497, 0xB595, 0xB693, 0xB791, 0xB88F, 0xB98D, 0xBA8B, 0xBB89, 0xBC87, 0xBD85,
+	0xBE83, 0xBF81, 0xC080, 0xC17E, 0xC27C, 0xC37A, 0xC478, 0xC576, 0xC674, 0xC772,
+	0xC870, 0xC96E, 0xCA6C, 0xCB6A, 0xCC68, 0xCD66, 0xCE64, 0xCF62, 0xD060, 0xD15E,
+	0xD25C, 0xD35A, 0xD458, 0xD556, 0xD654, 0xD752, 0xD850, 0xD94E, 0xDA4C, 0xDB4A,
+	0xDC48, 0xDD46, 0xDE44, 0xDF42, 0xE040, 0xE13E, 0xE23C, 0xE33A, 0xE438, 0xE536,
+	0xE634, 0xE732, 0xE830, 0xE92E, 0xEA2C, 0xEB2A, 0xEC28, 0xED26, 0xEE24, 0xEF22,
+	0xF020, 0xF11E, 0xF21C, 0xF31A, 0xF418, 0xF516, 0xF614, 0xF712, 0xF810, 0xF90E,
+	0xFA0C, 0xFB0A, 0xFC08, 0xFD06, 0xFE04, 0xFF02
+};
+
+#elif WAVEFORM == WAVEFORM_SAWTOOTH
+
+/* 8 bit samples */
+static const uint8_t wavetable_8bit[WAVETABLE_SIZE]
+	__attribute__((unused)) =
+{
+	  0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,  15,
+	 16,  17,  18,  19,  20,  21,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31,
+	 32,  33,  34,  35,  36,  37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47,
+	 48,  49,  50,  51,  52,  53,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,
+	 64,  65,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,  77,  78,  79,
+	 80,  81,  82,  83,  84,  85,  86,  87,  88,  89,  90,  91,  92,  93,  94,  95,
+	 96,  97,  98,  99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111,
+	112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127,
+	128, 128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141, 142,
+	143, 144, 145, 146, 147, 148, 149, 150, 151, 152, 153, 154, 155, 156, 157, 158,
+	159, 160, 161, 162, 163, 164, 165, 166, 167, 168, 169, 170, 171, 172, 173, 174,
+	175, 176, 177, 178, 179, 180, 181, 182, 183, 184, 185, 186, 187, 188, 189, 190,
+	191, 192, 193, 194, 195, 196, 197, 198, 199, 200, 201, 202, 203, 204, 205, 206,
+	207, 208, 209, 210, 211, 212, 213, 214, 215, 216, 217, 218, 219, 220, 221, 222,
+	223, 224, 225, 226, 227, 228, 229, 230, 231, 232, 233, 234, 235, 236, 237, 238,
+	239, 240, 241, 242, 243, 244, 245, 246, 247, 248, 249, 250, 251, 252, 253, 254
+};
+
+/* 12 bit samples */
+static const uint16_t wavetable_12bit[WAVETABLE_SIZE]
+	__attribute__((unused)) =
+{
+	   0,   16,   32,   48,   64,   80,   96,  112,  128,  144,  160,  176,
+	 192,  208,  224,  240,  256,  272,  288,  304,  320,  336,  352,  368,
+	 384,  400,  416,  432,  448,  464,  480,  496,  512,  528,  544,  560,
+	 576,  592,  608,  624,  640,  656,  672,  688,  704,  720,  736,  752,
+	 768,  784,  800,  816,  832,  848,  864,  880,  896,  912,  928,  944,
+	 960,  976,  992, 1008, 1024, 1040, 1056, 1072, 1088, 1104, 1120, 1136,
+	1152, 1168, 1184, 1200, 1216, 1232, 1248, 1264, 1280, 1296, 1312, 1328,
+	1344, 1360, 1376, 1392, 1408, 1424, 1440, 1456, 1472, 1488, 1504, 1520,
+	1536, 1552, 1568, 1584, 1600, 1616, 1632, 1648, 1664, 1680, 1696, 1712,
+	1728, 1744, 1760, 1776, 1792, 1808, 1824, 1840, 1856, 1872, 1888, 1904,
+	1920, 1936, 1952, 1968, 1984, 2000, 2016, 2032, 2048, 2063, 2079, 2095,
+	2111, 2127, 2143, 2159, 2175, 2191, 2207, 2223, 2239, 2255, 2271, 2287,
+	2303, 2319, 2335, 2351, 2367, 2383, 2399, 2415, 2431, 2447, 2463, 2479,
+	2495, 2511, 2527, 2543, 2559, 2575, 2591, 2607, 2623, 2639, 2655, 2671,
+	2687, 2703, 2719, 2735, 2751, 2767, 2783, 2799, 2815, 2831, 2847, 2863,
+	2879, 2895, 2911, 2927, 2943, 2959, 2975, 2991, 3007, 3023, 3039, 3055,
+	3071, 3087, 3103, 3119, 3135, 3151, 3167, 3183, 3199, 3215, 3231, 3247,
+	3263, 3279, 3295, 3311, 3327, 3343, 3359, 3375, 3391, 3407, 3423, 3439,
+	3455, 3471, 3487, 3503, 3519, 3535, 3551, 3567, 3583, 3599, 3615, 3631,
+	3647, 3663, 3679, 3695, 3711, 3727, 3743, 3759, 3775, 3791, 3807, 3823,
+	3839, 3855, 3871, 3887, 3903, 3919, 3935, 3951, 3967, 3983, 3999, 4015,
+	4031, 4047, 4063, 4079
+};
+
+/* Dual 8 bit samples with a sawtooth in the high byte */
+static const uint16_t wavetable_dual_8bit[WAVETABLE_SIZE]
+	__attribute__((unused)) =
+{
+	0x0000, 0x0101, 0x0202, 0x0303, 0x0404, 0x0505, 0x0606, 0x0707, 0x0808, 0x0909,
+	0x0A0A, 0x0B0B, 0x0C0C, 0x0D0D, 0x0E0E, 0x0F0F, 0x1010, 0x1111, 0x1212, 0x1313,
+	0x1414, 0x1515, 0x1616, 0x1717, 0x1818, 0x1919, 0x1A1A, 0x1B1B, 0x1C1C, 0x1D1D,
+	0x1E1E, 0x1F1F, 0x2020, 0x2121, 0x2222, 0x2323, 0x2424, 0x2525, 0x2626, 0x2727,
+	0x2828, 0x2929, 0x2A2A, 0x2B2B, 0x2C2C, 0x2D2D, 0x2E2E, 0x2F2F, 0x3030, 0x3131,
+	0x3232, 0x3333, 0x3434, 0x3535, 0x3636, 0x3737, 0x3838, 0x3939, 0x3A3A, 0x3B3B,
+	0x3C3C, 0x3D3D, 0x3E3E, 0x3F3F, 0x4040, 0x4141, 0x4242, 0x4343, 0x4444, 0x4545,
+	0x4646, 0x4747, 0x4848, 0x4949, 0x4A4A, 0x4B4B, 0x4C4C, 0x4D4D, 0x4E4E, 0x4F4F,
+	0x5050, 0x5151, 0x5252, 0x5353, 0x5454, 0x5555, 0x5656, 0x5757, 0x5858, 0x5959,
+	0x5A5A, 0x5B5B, 0x5C5C, 0x5D5D, 0x5E5E, 0x5F5F, 0x6060, 0x6161, 0x6262, 0x6363,
+	0x6464, 0x6565, 0x6666, 0x6767, 0x6868, 0x6969, 0x6A6A, 0x6B6B, 0x6C6C, 0x6D6D,
+	0x6E6E, 0x6F6F, 0x7070, 0x7171, 0x7272, 0x7373, 0x7474, 0x7575, 0x7676, 0x7777,
+	0x7878, 0x7979, 0x7A7A, 0x7B7B, 0x7C7C, 0x7D7D, 0x7E7E, 0x7F7F, 0x8080, 0x8180,
+	0x8281, 0x8382, 0x8483, 0x8584, 0x8685, 0x8786, 0x8887, 0x8988, 0x8A89, 0x8B8A,
+	0x8C8B, 0x8D8C, 0x8E8D, 0x8F8E, 0x908F, 0x9190, 0x9291, 0x9392, 0x9493, 0x9594,
+	0x9695, 0x9796, 0x9897, 0x9998, 0x9A99, 0x9B9A, 0x9C9B, 0x9D9C, 0x9E9D, 0x9F9E,
+	0xA09F, 0xA1A0, 0xA2A1, 0xA3A2, 0xA4A3, 0xA5A4, 0xA6A5, 0xA7A6, 0xA8A7, 0xA9A8,
+	0xAAA9, 0xABAA, 0xACAB, 0xADAC, 0xAEAD, 0xAFAE, 0xB0AF, 0xB1B0, 0xB2B1, 0xB3B2,
+	0xB4B3, 0xB5B4, 0xB6B5, 0xB7B6, 0xB8B7, 0xB9B8, 0xBAB9, 0xBBBA, 0xBCBB, 0xBDBC,
+	0xBEBD, 0xBFBE, 0xC0BF, 0xC1C0, 0xC2C1, 0xC3C2, 0xC4C3, 0xC5C4, 0xC6C5, 0xC7C6,
+	0xC8C7, 0xC9C8, 0xCAC9, 0xCBCA, 0xCCCB, 0xCDCC, 0xCECD, 0xCFCE, 0xD0CF, 0xD1D0,
+	0xD2D1, 0xD3D2, 0xD4D3, 0xD5D4, 0xD6D5, 0xD7D6, 0xD8D7, 0xD9D8, 0xDAD9, 0xDBDA,
+	0xDCDB, 0xDDDC, 0xDEDD, 0xDFDE, 0xE0DF, 0xE1E0, 0xE2E1, 0xE3E2, 0xE4E3, 0xE5E4,
+	0xE6E5, 0xE7E6, 0xE8E7, 0xE9E8, 0xEAE9, 0xEBEA, 0xECEB, 0xEDEC, 0xEEED, 0xEFEE,
+	0xF0EF, 0xF1F0, 0xF2F1, 0xF3F2, 0xF4F3, 0xF5F4, 0xF6F5, 0xF7F6, 0xF8F7, 0xF9F8,
+	0xFAF9, 0xFBFA, 0xFCFB, 0xFDFC, 0xFEFD, 0xFFFE
+};
+
+#else
+#error "Unknown WAVEFORM"
+#endif
+
+#endif
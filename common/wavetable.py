@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Generator of the constant waveform tables of wavetable.h.
+
+Writes a header with a table of WAVETABLE_SIZE samples for each shape, in 8
+bits, in 12 bits, and as dual 8 bit words with a sawtooth on the second
+channel. The tables are const, so they stay in flash for DMA to read directly,
+and those not used by a program are left out of it.
+The shape compiled in is chosen by WAVEFORM, set in the build with for example
+WAVEFORM=SINE.
+
+    wavetable.py > wavetable.h
+
+Run again after changing a shape or the size.
+
+14 October 2026
+"""
+
+import math
+
+WAVETABLE_SIZE = 256
+SHAPES = ("FUNKY", "SINE", "TRIANGLE", "SAWTOOTH")
+
+
+def funky(i):
+    """The parabolic then linear waveform of the original DAC tests."""
+    if i < 10:
+        return 10
+    if i < 121:
+        return 10 + ((i * i) >> 7)
+    if i < 128:
+        return 128
+    if i < 246:
+        return 256 - i
+    return 10
+
+
+def shape(name, i, bits):
+    """Sample i of a shape, scaled to the given bits."""
+    top = (1 << bits) - 1
+    phase = i / WAVETABLE_SIZE
+    if name == "FUNKY":
+        return funky(i) << (bits - 8)
+    if name == "SINE":
+        return round(top / 2 + (top / 2) * math.sin(2 * math.pi * phase))
+    if name == "TRIANGLE":
+        return round(top * (1 - abs(2 * phase - 1)))
+    return round(top * phase)
+
+
+def table(kind, name, values, per_line):
+    lines = ["static const %s %s[WAVETABLE_SIZE]" % (kind, name),
+             "\t__attribute__((unused)) =", "{"]
+    width = max(len(str(v)) for v in values)
+    for start in range(0, len(values), per_line):
+        row = ", ".join(str(v).rjust(width)
+                        for v in values[start:start + per_line])
+        end = "," if start + per_line < len(values) else ""
+        lines.append("\t" + row + end)
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def main():
+    print("/*\tWaveform Tables\n")
+    print("Constant tables of one cycle of a waveform, kept in flash for DMA "
+          "to the DAC.\nGenerated by wavetable.py, do not edit. Choose the "
+          "shape with WAVEFORM, one\nof the WAVEFORM_ values, the default "
+          "being WAVEFORM_FUNKY.\n")
+    print("14 October 2026\n*/\n")
+    print("#ifndef WAVETABLE_H\n#define WAVETABLE_H\n")
+    print("#include <stdint.h>\n")
+    print("#define WAVETABLE_SIZE      %d\n" % WAVETABLE_SIZE)
+    for n, name in enumerate(SHAPES):
+        print("#define WAVEFORM_%-14s %d" % (name, n))
+    print("\n#ifndef WAVEFORM\n#define WAVEFORM            WAVEFORM_FUNKY"
+          "\n#endif")
+    for n, name in enumerate(SHAPES):
+        print("\n#%s WAVEFORM == WAVEFORM_%s\n" % ("if" if n == 0 else "elif",
+                                                 name))
+        bits8 = [shape(name, i, 8) for i in range(WAVETABLE_SIZE)]
+        bits12 = [shape(name, i, 12) for i in range(WAVETABLE_SIZE)]
+        dual = [bits8[i] | (i << 8) for i in range(WAVETABLE_SIZE)]
+        print("/* 8 bit samples */")
+        print(table("uint8_t", "wavetable_8bit", bits8, 16))
+        print("\n/* 12 bit samples */")
+        print(table("uint16_t", "wavetable_12bit", bits12, 12))
+        print("\n/* Dual 8 bit samples with a sawtooth in the high byte */")
+        print(table("uint16_t", "wavetable_dual_8bit",
+                    ["0x%04X" % v for v in dual], 10))
+    print("\n#else\n#error \"Unknown WAVEFORM\"\n#endif\n\n#endif")
+
+
+if __name__ == "__main__":
+    main()
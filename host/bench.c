@@ -0,0 +1,155 @@
+/*	Host Benchmarks
+
+The shared buffers and formatting of common, and through bench_modbus.c and
+bench_canopen.c the protocol stacks, are run on the host over the fake
+peripherals and timed with the host clock. Each benchmark is repeated with four
+times the count until it takes long enough to time, and the rate and the time
+per operation are printed. Every benchmark also checks its results, so a run
+is a test of the logic as well, and the exit status is the number that failed.
+Built with BENCH_CORE only the buffers and formatting are run, without the
+protocol stacks.
+
+The rates are of the host, not of the processor, and are for comparing one
+change with another.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "buffer.h"
+#include "format.h"
+#include "fake_periph.h"
+#include "bench.h"
+
+/* Shortest run that is timed */
+#define BENCH_MIN_NS        200000000
+
+#define BYTE_BUFFER_SIZE    128
+#define RING_SIZE           4096
+#define RING_BLOCK          256
+
+static uint8_t byte_buffer[BYTE_BUFFER_SIZE + BUFFER_OVERHEAD];
+static uint8_t ring_data[RING_SIZE];
+static ring_buffer_t ring;
+static uint32_t failures = 0;
+
+static uint32_t bench_buffer(uint32_t count);
+static uint32_t bench_ring(uint32_t count);
+static uint32_t bench_format(uint32_t count);
+
+/*--------------------------------------------------------------------------*/
+
+int main(void)
+{
+	printf("%-24s %14s %10s\n", "benchmark", "rate", "per op");
+	bench_run("buffer put/get", "byte", bench_buffer);
+	bench_run("ring put_n/get_n", "byte", bench_ring);
+	bench_run("format_string", "call", bench_format);
+#ifndef BENCH_CORE
+	bench_modbus();
+	bench_canopen();
+#endif
+	if (failures > 0) printf("%u failed\n", failures);
+	return failures;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Time a Benchmark
+
+@param[in] name: printed name.
+@param[in] unit: printed unit of the operations counted.
+@param[in] fn: benchmark.
+*/
+
+void bench_run(const char *name, const char *unit, bench_fn_t fn)
+{
+	uint32_t count = 1000;
+	uint32_t done;
+	uint64_t ns;
+	for (;;)
+	{
+		uint64_t start = fake_host_ns();
+		done = fn(count);
+		ns = fake_host_ns() - start;
+		if (done == 0)
+		{
+			bench_fail(name);
+			return;
+		}
+		if ((ns >= BENCH_MIN_NS) || (count > 0x3FFFFFFF / 4)) break;
+		count *= 4;
+	}
+	printf("%-24s %9.3fM %s/s %7.1fns\n", name, done*1e3/ns, unit,
+	       (double) ns/done);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Report a Benchmark that could not Run or gave a Wrong Result
+
+*/
+
+void bench_fail(const char *name)
+{
+	printf("%-24s FAILED\n", name);
+	failures++;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Byte buffer of serial.c, filled half way and emptied. */
+
+static uint32_t bench_buffer(uint32_t count)
+{
+	uint32_t i;
+	uint8_t j;
+	buffer_init(byte_buffer, BYTE_BUFFER_SIZE);
+	for (i = 0; i < count; i++)
+	{
+		for (j = 0; j < BYTE_BUFFER_SIZE/2; j++) buffer_put(byte_buffer, j);
+		for (j = 0; j < BYTE_BUFFER_SIZE/2; j++)
+			if (buffer_get(byte_buffer) != j) return 0;
+	}
+	return count*(BYTE_BUFFER_SIZE/2);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Large ring buffer, in blocks that wrap around the end. A third of a block
+is left in it so that the blocks are not aligned with the end. The bytes put
+in count up, so those taken out are checked to follow on in order with none
+lost or repeated. */
+
+static uint32_t bench_ring(uint32_t count)
+{
+	uint8_t in[RING_BLOCK];
+	uint8_t out[RING_BLOCK];
+	uint8_t next_in = 0;
+	uint8_t next_out = 0;
+	uint32_t i, j;
+	ring_init(&ring, ring_data, RING_SIZE);
+	for (j = 0; j < RING_BLOCK/3; j++) in[j] = next_in++;
+	ring_put_n(&ring, in, RING_BLOCK/3);
+	for (i = 0; i < count; i++)
+	{
+		for (j = 0; j < RING_BLOCK; j++) in[j] = next_in++;
+		if (ring_put_n(&ring, in, RING_BLOCK) != RING_BLOCK) return 0;
+		if (ring_get_n(&ring, out, RING_BLOCK) != RING_BLOCK) return 0;
+		for (j = 0; j < RING_BLOCK; j++)
+			if (out[j] != next_out++) return 0;
+	}
+	return count*RING_BLOCK;
+}
+
+/*--------------------------------------------------------------------------*/
+/* A line typical of the examples' reports. */
+
+static uint32_t bench_format(uint32_t count)
+{
+	char text[64];
+	uint32_t i;
+	for (i = 0; i < count; i++)
+		if (format_string(text, sizeof(text), "%-7s %u %04X %d %c\r\n",
+		                  "adc", i, i & 0xFFFF, -(int32_t) (i & 0xFF), 'x') < 20)
+			return 0;
+	return count;
+}
@@ -0,0 +1,20 @@
+/*	Host Benchmarks
+
+15 October 2026
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+/* A benchmark does count operations and returns the number done, in its own
+unit, or 0 if a result was wrong. */
+typedef uint32_t (*bench_fn_t)(uint32_t count);
+
+void bench_run(const char *name, const char *unit, bench_fn_t fn);
+void bench_fail(const char *name);
+void bench_modbus(void);
+void bench_canopen(void);
+
+#endif
@@ -0,0 +1,147 @@
+/*	Host Benchmarks of CanFestival
+
+The message queue of the CAN driver and the host driver in loopback are timed,
+then the node of CanFestival-test with its object dictionary: the DS401
+digital input handler, and expedited SDO uploads of the device type dispatched
+through the stack and answered into the transmit queue.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "canfestival.h"
+#include "can_stm32.h"
+#include "can_queue.h"
+#include "can_host.h"
+#include "ds401.h"
+#include "ObjDict.h"
+#include "bench.h"
+
+#define NODE_ID             0x04
+#define BURST               16
+
+static Message queue_storage[BURST];
+static can_queue queue;
+
+static uint32_t bench_can_queue(uint32_t count);
+static uint32_t bench_loopback(uint32_t count);
+static uint32_t bench_ds401(uint32_t count);
+static uint32_t bench_sdo_upload(uint32_t count);
+static void drain(void);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Run the CANopen Benchmarks
+
+*/
+
+void bench_canopen(void)
+{
+	bench_run("can_queue put/get", "frame", bench_can_queue);
+	if (! canInit(125))
+	{
+		bench_fail("can loopback");
+		return;
+	}
+	bench_run("can loopback", "frame", bench_loopback);
+
+/* The node goes to pre-operational and sends its boot-up message */
+	initTimer();
+	setNodeId(&ObjDict_Data, NODE_ID);
+	setState(&ObjDict_Data, Initialisation);
+	drain();
+	bench_run("ds401 digital input", "call", bench_ds401);
+	bench_run("sdo expedited upload", "frame", bench_sdo_upload);
+	setState(&ObjDict_Data, Stopped);
+}
+
+/*--------------------------------------------------------------------------*/
+/* A burst of frames through the queue of the driver. */
+
+static uint32_t bench_can_queue(uint32_t count)
+{
+	Message m = {0x181, 0, 8, {0, 1, 2, 3, 4, 5, 6, 7}};
+	uint32_t i;
+	uint8_t j;
+	can_queue_init(&queue, queue_storage, BURST);
+	for (i = 0; i < count; i++)
+	{
+/* One slot is kept empty */
+		for (j = 0; j < BURST - 1; j++)
+		{
+			m.data[0] = j;
+			if (! can_queue_put(&queue, &m)) return 0;
+		}
+		for (j = 0; j < BURST - 1; j++)
+			if (! can_queue_get(&queue, &m) || (m.data[0] != j)) return 0;
+	}
+	return count*(BURST - 1);
+}
+
+/*--------------------------------------------------------------------------*/
+/* A burst of frames sent and received back by the driver. */
+
+static uint32_t bench_loopback(uint32_t count)
+{
+	Message m = {0x181, 0, 8, {0, 1, 2, 3, 4, 5, 6, 7}};
+	uint32_t i;
+	uint8_t j;
+	can_host_loopback(1);
+	for (i = 0; i < count; i++)
+	{
+		for (j = 0; j < BURST; j++)
+		{
+			m.data[0] = j;
+			if (! canSend(0, &m)) break;
+		}
+		for (j = 0; j < BURST; j++)
+			if (! canReceive(&m) || (m.data[0] != j)) break;
+		if (j < BURST) break;
+	}
+	can_host_loopback(0);
+	return (i < count) ? 0 : count*BURST;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Inputs sampled, changing every few samples so that the filter and the
+change of the mapped object are both exercised. */
+
+static uint32_t bench_ds401(uint32_t count)
+{
+	unsigned char input[1];
+	uint32_t i;
+	for (i = 0; i < count; i++)
+	{
+		input[0] = (i >> 3) & 0xFF;
+		digital_input_handler(&ObjDict_Data, input, sizeof(input));
+	}
+	drain();
+	return count;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Upload of the device type, 0x1000, answered in a single frame. */
+
+static uint32_t bench_sdo_upload(uint32_t count)
+{
+	Message request = {0x600 + NODE_ID, 0, 8, {0x40, 0x00, 0x10, 0x00}};
+	Message reply;
+	uint32_t i;
+	for (i = 0; i < count; i++)
+	{
+		canDispatch(&ObjDict_Data, &request);
+		if (! can_host_take(&reply)) return 0;
+		if ((reply.cob_id != 0x580 + NODE_ID) || (reply.data[0] != 0x43) ||
+		    (reply.data[1] != 0x00) || (reply.data[2] != 0x10)) return 0;
+	}
+	return count;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Take any frames the node has sent. */
+
+static void drain(void)
+{
+	Message m;
+	while (can_host_take(&m));
+}
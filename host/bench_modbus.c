@@ -0,0 +1,132 @@
+/*	Host Benchmarks of FreeModbus
+
+The register callbacks of mbregmap.c are timed on a map of many ranges, and a
+whole RTU transaction through the protocol stack over the fake USART and
+timer: a read holding registers request is put on the line, the t3.5 gap is
+waited out, eMBPoll runs the frame and the reply is taken from the line and
+checked.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "port.h"
+#include "mb.h"
+#include "mbcrc.h"
+#include "mbregmap.h"
+#include "fake_periph.h"
+#include "bench.h"
+
+/* Holding register ranges, each of RANGE_REGS registers at intervals of
+RANGE_STRIDE addresses from address 1 */
+#define RANGES              64
+#define RANGE_REGS          8
+#define RANGE_STRIDE        16
+
+#define SLAVE_ADDRESS       1
+/* Address, function, byte count, registers and CRC */
+#define REPLY_LENGTH        (5 + 2*RANGE_REGS)
+
+static USHORT holding[RANGES][RANGE_REGS];
+static xMBRegRange holding_ranges[RANGES];
+static const xMBRegMap reg_map = {
+	NULL, 0,
+	holding_ranges, RANGES,
+	NULL, 0,
+	NULL, 0
+};
+static UCHAR request[8];
+
+static uint32_t bench_regmap(uint32_t count);
+static uint32_t bench_rtu(uint32_t count);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Run the Modbus Benchmarks
+
+*/
+
+void bench_modbus(void)
+{
+	uint16_t i, j;
+	for (i = 0; i < RANGES; i++)
+	{
+		holding_ranges[i].usStart = 1 + i*RANGE_STRIDE;
+		holding_ranges[i].usCount = RANGE_REGS;
+		holding_ranges[i].pvData = holding[i];
+		holding_ranges[i].pxBank = NULL;
+		for (j = 0; j < RANGE_REGS; j++) holding[i][j] = (i << 8) | j;
+	}
+	vMBRegMapSet(&reg_map);
+	bench_run("modbus holding read", "call", bench_regmap);
+
+/* Read the registers of the last range, the protocol address being one less
+than that of the callback */
+	USHORT address = holding_ranges[RANGES - 1].usStart - 1;
+	request[0] = SLAVE_ADDRESS;
+	request[1] = MB_FUNC_READ_HOLDING_REGISTER;
+	request[2] = address >> 8;
+	request[3] = address & 0xFF;
+	request[4] = 0;
+	request[5] = RANGE_REGS;
+	USHORT crc = usMBCRC16(request, 6);
+	request[6] = crc & 0xFF;
+	request[7] = crc >> 8;
+
+/* The receiver starts once the line has been idle for t3.5 */
+	if ((eMBInit(MB_RTU, SLAVE_ADDRESS, 0, 19200, MB_PAR_EVEN) != MB_ENOERR) ||
+	    (eMBEnable() != MB_ENOERR))
+	{
+		bench_fail("modbus rtu transaction");
+		return;
+	}
+	fake_clock_expire_next();
+	eMBPoll();
+	bench_run("modbus rtu transaction", "frame", bench_rtu);
+	eMBDisable();
+	eMBClose();
+}
+
+/*--------------------------------------------------------------------------*/
+/* Reads of a whole range, spread over the map. */
+
+static uint32_t bench_regmap(uint32_t count)
+{
+	UCHAR frame[2*RANGE_REGS];
+	uint32_t i;
+	for (i = 0; i < count; i++)
+	{
+		uint16_t range = (i*37) % RANGES;
+		if (eMBRegHoldingCB(frame, holding_ranges[range].usStart, RANGE_REGS,
+		                    MB_REG_READ) != MB_ENOERR) return 0;
+		if ((frame[0] != range) || (frame[2*RANGE_REGS - 1] != RANGE_REGS - 1))
+			return 0;
+	}
+	return count;
+}
+
+/*--------------------------------------------------------------------------*/
+/* A request received, executed and replied to. */
+
+static uint32_t bench_rtu(uint32_t count)
+{
+	UCHAR reply[REPLY_LENGTH + 1];
+	uint32_t i;
+	for (i = 0; i < count; i++)
+	{
+		fake_usart_inject(request, sizeof(request));
+		fake_usart_service();
+		if (! fake_clock_expire_next()) return 0;
+/* Frame received, then executed */
+		eMBPoll();
+		eMBPoll();
+/* Send the reply, then the frame sent event */
+		fake_usart_service();
+		eMBPoll();
+		if (fake_usart_take(reply, sizeof(reply)) != REPLY_LENGTH) return 0;
+		if ((reply[2] != 2*RANGE_REGS) || (reply[3] != RANGES - 1) ||
+		    (usMBCRC16(reply, REPLY_LENGTH) != 0)) return 0;
+	}
+	return count;
+}
@@ -0,0 +1,288 @@
+/*	Fake Peripherals for the Host Build
+
+The USART holds the bytes injected by the far end until the receive handler
+takes them, and the bytes sent until the far end takes them. The handlers are
+called from fake_usart_service, which stands in for the interrupts and is
+called by the test after each step, so the protocol stack sees the same
+sequence of calls as on the processor: a receive call per byte and transmit
+calls while the transmitter is enabled.
+
+The timers are one shot and run on the virtual clock. fake_clock_advance
+moves the clock on, calling the handler of each timer as its time comes, and
+fake_clock_expire_next moves it straight to the next timer due, which is how
+a test waits out the inter frame gap without passing the time.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "fake_periph.h"
+
+typedef struct {
+	uint8_t data[FAKE_USART_PIPE];
+	uint32_t head;
+	uint32_t tail;
+} pipe_t;
+
+typedef struct {
+	bool running;
+	uint64_t due;
+	fake_isr_t isr;
+} one_shot_t;
+
+static pipe_t rx_pipe;
+static pipe_t tx_pipe;
+static fake_isr_t usart_rx_isr;
+static fake_isr_t usart_tx_isr;
+static bool rx_enabled;
+static bool tx_enabled;
+
+static one_shot_t timers[FAKE_TIMERS];
+static uint64_t now_us;
+
+static bool pipe_put(pipe_t *pipe, uint8_t byte);
+static bool pipe_get(pipe_t *pipe, uint8_t *byte);
+static int8_t next_timer(void);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Attach the USART Interrupt Handlers
+
+@param[in] rx_isr: called for each byte received.
+@param[in] tx_isr: called while the transmitter is enabled.
+*/
+
+void fake_usart_attach(fake_isr_t rx_isr, fake_isr_t tx_isr)
+{
+	usart_rx_isr = rx_isr;
+	usart_tx_isr = tx_isr;
+	rx_enabled = false;
+	tx_enabled = false;
+	fake_usart_flush();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Enable the Receive and Transmit Interrupts
+
+*/
+
+void fake_usart_enable(bool rx, bool tx)
+{
+	rx_enabled = rx;
+	tx_enabled = tx;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Take a Received Byte, as from the data register
+
+@returns false if none is waiting.
+*/
+
+bool fake_usart_recv(uint8_t *byte)
+{
+	return pipe_get(&rx_pipe, byte);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send a Byte, as to the data register
+
+A byte sent when the far end has not taken the pipe's worth is lost, as an
+overrun would be at the other end of the line.
+*/
+
+void fake_usart_send(uint8_t byte)
+{
+	pipe_put(&tx_pipe, byte);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Run the USART Interrupts
+
+The receive handler is called once for each byte waiting and the transmit
+handler until it disables the transmitter, as long as they make progress.
+*/
+
+void fake_usart_service(void)
+{
+	bool busy = true;
+	while (busy)
+	{
+		busy = false;
+		uint32_t waiting = rx_pipe.head - rx_pipe.tail;
+		while (rx_enabled && (usart_rx_isr != 0) && (waiting-- > 0))
+		{
+			usart_rx_isr();
+			busy = true;
+		}
+		uint32_t limit = FAKE_USART_PIPE;
+		while (tx_enabled && (usart_tx_isr != 0) && (limit-- > 0))
+		{
+			usart_tx_isr();
+			busy = true;
+		}
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Put Bytes on the Line to the Device
+
+@returns bytes taken, fewer if the pipe filled.
+*/
+
+uint32_t fake_usart_inject(const uint8_t *data, uint32_t length)
+{
+	uint32_t i;
+	for (i = 0; i < length; i++)
+		if (! pipe_put(&rx_pipe, data[i])) break;
+	return i;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Take Bytes Sent by the Device
+
+@returns bytes taken.
+*/
+
+uint32_t fake_usart_take(uint8_t *data, uint32_t length)
+{
+	uint32_t i;
+	for (i = 0; i < length; i++)
+		if (! pipe_get(&tx_pipe, &data[i])) break;
+	return i;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Empty Both Pipes
+
+*/
+
+void fake_usart_flush(void)
+{
+	rx_pipe.head = rx_pipe.tail = 0;
+	tx_pipe.head = tx_pipe.tail = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start a One Shot Timer
+
+A timer already running is started again.
+
+@param[in] timer: 0 to FAKE_TIMERS - 1.
+@param[in] us: time to expiry from now.
+@param[in] isr: called at expiry.
+*/
+
+void fake_timer_start(uint8_t timer, uint32_t us, fake_isr_t isr)
+{
+	timers[timer].due = now_us + us;
+	timers[timer].isr = isr;
+	timers[timer].running = true;
+}
+
+/*--------------------------------------------------------------------------*/
+
+void fake_timer_stop(uint8_t timer)
+{
+	timers[timer].running = false;
+}
+
+/*--------------------------------------------------------------------------*/
+
+bool fake_timer_running(uint8_t timer)
+{
+	return timers[timer].running;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Move the Clock On
+
+The timers falling due are expired in order, each at its own time.
+
+@param[in] us: time to pass.
+*/
+
+void fake_clock_advance(uint32_t us)
+{
+	uint64_t target = now_us + us;
+	int8_t timer;
+	while (((timer = next_timer()) >= 0) && (timers[timer].due <= target))
+	{
+		now_us = timers[timer].due;
+		timers[timer].running = false;
+		timers[timer].isr();
+	}
+	now_us = target;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Move the Clock to the Next Timer and Expire it
+
+@returns false if no timer is running.
+*/
+
+bool fake_clock_expire_next(void)
+{
+	int8_t timer = next_timer();
+	if (timer < 0) return false;
+	if (timers[timer].due > now_us) now_us = timers[timer].due;
+	timers[timer].running = false;
+	timers[timer].isr();
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Virtual Time
+
+@returns microseconds since the start.
+*/
+
+uint64_t fake_clock_us(void)
+{
+	return now_us;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Host Monotonic Time
+
+@returns nanoseconds from an arbitrary start.
+*/
+
+uint64_t fake_host_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*--------------------------------------------------------------------------*/
+
+static bool pipe_put(pipe_t *pipe, uint8_t byte)
+{
+	if (pipe->head - pipe->tail >= FAKE_USART_PIPE) return false;
+	pipe->data[pipe->head++ & (FAKE_USART_PIPE - 1)] = byte;
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+
+static bool pipe_get(pipe_t *pipe, uint8_t *byte)
+{
+	if (pipe->head == pipe->tail) return false;
+	*byte = pipe->data[pipe->tail++ & (FAKE_USART_PIPE - 1)];
+	return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Running timer due first, or -1. */
+
+static int8_t next_timer(void)
+{
+	int8_t first = -1;
+	uint8_t i;
+	for (i = 0; i < FAKE_TIMERS; i++)
+		if (timers[i].running &&
+		    ((first < 0) || (timers[i].due < timers[first].due)))
+			first = i;
+	return first;
+}
@@ -0,0 +1,51 @@
+/*	Fake Peripherals for the Host Build
+
+A USART as a pair of byte pipes, one shot timers and a clock, in place of the
+STM32 peripherals, so that the port layers of the protocol stacks can run on
+the host. Time is virtual, in microseconds, and only moves when it is
+advanced, so a run is repeatable and as fast as the host allows.
+
+15 October 2026
+*/
+
+#ifndef FAKE_PERIPH_H
+#define FAKE_PERIPH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Bytes held in each direction of the USART, a power of two */
+#define FAKE_USART_PIPE     1024
+
+/* One shot timers, and those used by the host ports */
+#define FAKE_TIMERS         4
+#define FAKE_TIMER_MODBUS   0
+#define FAKE_TIMER_CANOPEN  1
+
+/* Interrupt handlers of the USART. The receive handler is called for each
+byte waiting while the receiver is enabled, and the transmit handler while the
+transmitter is enabled, as the RXNE and TXE interrupts would be. */
+typedef void (*fake_isr_t)(void);
+
+void fake_usart_attach(fake_isr_t rx_isr, fake_isr_t tx_isr);
+void fake_usart_enable(bool rx, bool tx);
+bool fake_usart_recv(uint8_t *byte);
+void fake_usart_send(uint8_t byte);
+void fake_usart_service(void);
+
+/* The far end of the USART, the master or host tool */
+uint32_t fake_usart_inject(const uint8_t *data, uint32_t length);
+uint32_t fake_usart_take(uint8_t *data, uint32_t length);
+void fake_usart_flush(void);
+
+void fake_timer_start(uint8_t timer, uint32_t us, fake_isr_t isr);
+void fake_timer_stop(uint8_t timer);
+bool fake_timer_running(uint8_t timer);
+void fake_clock_advance(uint32_t us);
+bool fake_clock_expire_next(void);
+uint64_t fake_clock_us(void);
+
+/* Host time for the benchmarks */
+uint64_t fake_host_ns(void);
+
+#endif
@@ -69,19 +69,19 @@
  * See http://www.freertos.org/a00110.html.
  *----------------------------------------------------------*/
 
-#define configUSE_PREEMPTION		0
+#define configUSE_PREEMPTION		1
 #define configUSE_IDLE_HOOK			0
 #define configUSE_TICK_HOOK			0
 #define configCPU_CLOCK_HZ			( ( unsigned long ) 72000000 )	
 #define configTICK_RATE_HZ			( ( portTickType ) 1000 )
 #define configMAX_PRIORITIES		( ( unsigned portBASE_TYPE ) 5 )
 #define configMINIMAL_STACK_SIZE	( ( unsigned short ) 128 )
-#define configTOTAL_HEAP_SIZE		( ( size_t ) ( 17 * 1024 ) )
+#define configTOTAL_HEAP_SIZE		( ( size_t ) ( 3 * 1024 ) )
 #define configMAX_TASK_NAME_LEN		( 16 )
-#define configUSE_TRACE_FACILITY	0
 #define configUSE_16_BIT_TICKS		0
 #define configIDLE_SHOULD_YIELD		1
 #define configUSE_MUTEXES			1
+#define configUSE_TICKLESS_IDLE		1
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES 		0
@@ -110,5 +110,27 @@ configKERNEL_INTERRUPT_PRIORITY setting.  Here 15 corresponds to the lowest
 NVIC value of 255. */
 #define configLIBRARY_KERNEL_INTERRUPT_PRIORITY	15
 
+/* Run time statistics, built with RTOS_STATS=1 and rtos_stats.c in common, which
+drives the run time clock from the DWT cycle counter. */
+#ifdef RTOS_STATS
+#define configUSE_TRACE_FACILITY		1
+#define configGENERATE_RUN_TIME_STATS	1
+#define INCLUDE_uxTaskGetStackHighWaterMark	1
+extern void rtos_stats_clock_init(void);
+extern uint32_t rtos_stats_clock(void);
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() rtos_stats_clock_init()
+#define portGET_RUN_TIME_COUNTER_VALUE() rtos_stats_clock()
+#else
+#define configUSE_TRACE_FACILITY		0
+#endif
+
+/* Tickless idle with long idle periods in stop mode, built with
+RTOS_TICKLESS=1 and rtos_tickless.c in common. Otherwise the port's own
+SysTick tickless sleep is used. */
+#ifdef RTOS_TICKLESS
+extern void rtos_tickless_sleep(uint32_t expected_idle);
+#define portSUPPRESS_TICKS_AND_SLEEP( x ) rtos_tickless_sleep( x )
+#endif
+
 #endif /* FREERTOS_CONFIG_H */
 
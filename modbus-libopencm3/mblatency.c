@@ -0,0 +1,270 @@
+/*
+ * FreeModbus Libary: Response latency statistics for the STM32 ports
+ * Copyright (C) 2026 Ken Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: mblatency.c,v 1.0 2026/10/14 Exp $
+ */
+
+/* Response latency statistics.
+
+With MB_PORT_LATENCY set in port.h the port layer and the register callbacks
+timestamp each frame with the DWT cycle counter: the first byte handed to the
+protocol stack, the t3.5 expiry that ends the frame, entry to and exit from
+the register callbacks, the first byte of the reply and the transmission
+complete interrupt after its last byte. With DMA reception the first byte is
+handed on at the end of the burst, so the receive time is then short.
+
+When the reply has gone the times are added to the statistics of the request
+function code. The marks of a frame are made in turn from the interrupts and
+the poll loop, each only in the expected state, so they need no locking. A
+frame with no reply (such as one for another slave) is dropped when the next
+frame starts. Only RTU frames are timed.
+
+The application calls vMBLatencyUpdate( ) from its poll loop to convert the
+statistics into input registers in the layout given in mblatency.h. */
+
+#include <string.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mblatency.h"
+
+/* ----------------------- libopencm3 includes ------------------------------*/
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/stm32/rcc.h>
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct
+{
+    ULONG           ulMin;
+    ULONG           ulMax;
+    uint64_t        ullSum;
+} xMBLatencyStat;
+
+typedef struct
+{
+    UCHAR           ucFunction;
+    ULONG           ulCount;
+    xMBLatencyStat  xReceive;
+    xMBLatencyStat  xReply;
+    xMBLatencyStat  xCallback;
+    xMBLatencyStat  xTurnaround;
+    ULONG           ulHistogram[MB_LATENCY_BUCKETS];
+} xMBLatencySlot;
+
+typedef enum
+{
+    STATE_IDLE,                 /* Waiting for a frame */
+    STATE_RECEIVING,            /* Bytes being handed to the stack */
+    STATE_PROCESSING,           /* Frame ended, no reply yet */
+    STATE_SENDING               /* Reply being transmitted */
+} eMBLatencyState;
+
+/* ----------------------- Static variables ---------------------------------*/
+static xMBLatencySlot xSlots[MB_LATENCY_SLOTS];
+static ULONG    ulFrames;
+static ULONG    ulUnclassified;
+static ULONG    ulCyclesPerUs;
+
+/* The frame being timed */
+static volatile eMBLatencyState eState;
+static USHORT   usRxBytes;
+static UCHAR    ucFunction;
+static ULONG    ulRxStart;
+static ULONG    ulFrameEnd;
+static ULONG    ulCBStart;
+static ULONG    ulCBCycles;
+static ULONG    ulTxStart;
+
+/* ----------------------- Static functions ---------------------------------*/
+static void
+vMBLatencyStatAdd( xMBLatencyStat * pxStat, ULONG ulCycles, ULONG ulCount )
+{
+    if( ( ulCount == 0 ) || ( ulCycles < pxStat->ulMin ) ) pxStat->ulMin = ulCycles;
+    if( ulCycles > pxStat->ulMax ) pxStat->ulMax = ulCycles;
+    pxStat->ullSum += ulCycles;
+}
+
+static USHORT
+usMBLatencySaturate( uint64_t ullValue )
+{
+    return ( ullValue > 0xFFFF ) ? 0xFFFF : ( USHORT )ullValue;
+}
+
+/* Write the minimum, mean and maximum, in units of ulDivisor cycles */
+static void
+vMBLatencyStatWrite( USHORT * pusRegs, const xMBLatencyStat * pxStat,
+                     ULONG ulCount, ULONG ulDivisor )
+{
+    if( ulCount == 0 ) return;
+    pusRegs[0] = usMBLatencySaturate( pxStat->ulMin / ulDivisor );
+    pusRegs[1] = usMBLatencySaturate( pxStat->ullSum / ulCount / ulDivisor );
+    pusRegs[2] = usMBLatencySaturate( pxStat->ulMax / ulDivisor );
+}
+
+/* Add the times of the frame just replied to */
+static void
+vMBLatencyRecord( ULONG ulTxDone )
+{
+    xMBLatencySlot *pxSlot;
+    ULONG           ulReply, ulMicros;
+    UCHAR           ucBucket;
+    USHORT          usSlot;
+
+    ulFrames++;
+    for( usSlot = 0; usSlot < MB_LATENCY_SLOTS; usSlot++ )
+    {
+        pxSlot = &xSlots[usSlot];
+        if( pxSlot->ucFunction == ucFunction ) break;
+        if( pxSlot->ucFunction == 0 )
+        {
+            pxSlot->ucFunction = ucFunction;
+            break;
+        }
+    }
+    if( usSlot == MB_LATENCY_SLOTS )
+    {
+        ulUnclassified++;
+        return;
+    }
+    ulReply = ulTxStart - ulFrameEnd;
+    vMBLatencyStatAdd( &pxSlot->xReceive, ulFrameEnd - ulRxStart, pxSlot->ulCount );
+    vMBLatencyStatAdd( &pxSlot->xReply, ulReply, pxSlot->ulCount );
+    vMBLatencyStatAdd( &pxSlot->xCallback, ulCBCycles, pxSlot->ulCount );
+    vMBLatencyStatAdd( &pxSlot->xTurnaround, ulTxDone - ulFrameEnd, pxSlot->ulCount );
+    ulMicros = ( ulReply / ulCyclesPerUs ) >> 2;
+    for( ucBucket = 0; ( ulMicros != 0 ) && ( ucBucket < MB_LATENCY_BUCKETS - 1 ); ucBucket++ )
+    {
+        ulMicros >>= 1;
+    }
+    pxSlot->ulHistogram[ucBucket]++;
+    pxSlot->ulCount++;
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+/* Start the cycle counter. Call after the clocks are set up. */
+void
+vMBLatencyInit( void )
+{
+    dwt_enable_cycle_counter(  );
+    ulCyclesPerUs = rcc_ahb_frequency / 1000000;
+    if( ulCyclesPerUs == 0 ) ulCyclesPerUs = 1;
+    vMBLatencyReset(  );
+}
+
+void
+vMBLatencyReset( void )
+{
+    ENTER_CRITICAL_SECTION(  );
+    memset( xSlots, 0, sizeof( xSlots ) );
+    ulFrames = 0;
+    ulUnclassified = 0;
+    eState = STATE_IDLE;
+    EXIT_CRITICAL_SECTION(  );
+}
+
+/* Convert the statistics to the register layout of mblatency.h. A slot is
+ * copied with interrupts masked so that it is not changed part way. */
+void
+vMBLatencyUpdate( USHORT * pusRegs )
+{
+    xMBLatencySlot  xSlot;
+    USHORT         *pusSlot;
+    USHORT          usSlot, usBucket;
+
+    pusRegs[MB_LATENCY_FRAMES] = usMBLatencySaturate( ulFrames );
+    pusRegs[MB_LATENCY_UNCLASSIFIED] = usMBLatencySaturate( ulUnclassified );
+    for( usSlot = 0; usSlot < MB_LATENCY_SLOTS; usSlot++ )
+    {
+        ENTER_CRITICAL_SECTION(  );
+        xSlot = xSlots[usSlot];
+        EXIT_CRITICAL_SECTION(  );
+        pusSlot = pusRegs + MB_LATENCY_SLOT( usSlot );
+        pusSlot[MB_LATENCY_FUNCTION] = xSlot.ucFunction;
+        pusSlot[MB_LATENCY_COUNT] = usMBLatencySaturate( xSlot.ulCount );
+        vMBLatencyStatWrite( pusSlot + MB_LATENCY_RECEIVE, &xSlot.xReceive, xSlot.ulCount, ulCyclesPerUs );
+        vMBLatencyStatWrite( pusSlot + MB_LATENCY_REPLY, &xSlot.xReply, xSlot.ulCount, ulCyclesPerUs );
+        vMBLatencyStatWrite( pusSlot + MB_LATENCY_CALLBACK, &xSlot.xCallback, xSlot.ulCount, 1 );
+        vMBLatencyStatWrite( pusSlot + MB_LATENCY_TURNAROUND, &xSlot.xTurnaround, xSlot.ulCount, ulCyclesPerUs );
+        for( usBucket = 0; usBucket < MB_LATENCY_BUCKETS; usBucket++ )
+        {
+            pusSlot[MB_LATENCY_HISTOGRAM + usBucket] = usMBLatencySaturate( xSlot.ulHistogram[usBucket] );
+        }
+    }
+}
+
+/* ----------------------- Port marks ---------------------------------------*/
+/* Each byte handed to the protocol stack. The first starts a new frame. */
+void
+vMBLatencyRxByte( UCHAR ucByte )
+{
+    if( eState != STATE_RECEIVING )
+    {
+        ulRxStart = DWT_CYCCNT;
+        usRxBytes = 0;
+        ulCBCycles = 0;
+        eState = STATE_RECEIVING;
+    }
+    if( usRxBytes == 1 ) ucFunction = ucByte;
+    usRxBytes++;
+}
+
+/* t3.5 expiry */
+void
+vMBLatencyFrameEnd( void )
+{
+    if( ( eState == STATE_RECEIVING ) && ( usRxBytes >= 2 ) )
+    {
+        ulFrameEnd = DWT_CYCCNT;
+        eState = STATE_PROCESSING;
+    }
+}
+
+void
+vMBLatencyCBEnter( void )
+{
+    ulCBStart = DWT_CYCCNT;
+}
+
+void
+vMBLatencyCBExit( void )
+{
+    if( eState == STATE_PROCESSING ) ulCBCycles += DWT_CYCCNT - ulCBStart;
+}
+
+/* Each byte of the reply. The first is timestamped. */
+void
+vMBLatencyTxByte( void )
+{
+    if( eState == STATE_PROCESSING )
+    {
+        ulTxStart = DWT_CYCCNT;
+        eState = STATE_SENDING;
+    }
+}
+
+/* Transmission complete */
+void
+vMBLatencyTxDone( void )
+{
+    if( eState == STATE_SENDING )
+    {
+        vMBLatencyRecord( DWT_CYCCNT );
+        eState = STATE_IDLE;
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ * FreeModbus Libary: Response latency statistics for the STM32 ports
+ * Copyright (C) 2026 Ken Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: mblatency.h,v 1.0 2026/10/14 Exp $
+ */
+
+#ifndef _MB_LATENCY_H
+#define _MB_LATENCY_H
+
+#include "port.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+/* Statistics are kept for up to MB_LATENCY_SLOTS function codes, in the order
+ * first seen. */
+#define MB_LATENCY_SLOTS                4
+/* Histogram of the reply time, doubling from under 4us to 256us and over */
+#define MB_LATENCY_BUCKETS              8
+
+/* Register layout written by vMBLatencyUpdate( ). Times are in microseconds
+ * except the callback, which is in processor cycles, and all values saturate
+ * at 65535.
+ *   0        frames timed
+ *   1        frames of a function code with no free slot
+ *   2 +      MB_LATENCY_SLOT_REGS for each slot, starting with
+ *            MB_LATENCY_FUNCTION, 0 if the slot is unused */
+#define MB_LATENCY_FRAMES               0
+#define MB_LATENCY_UNCLASSIFIED         1
+#define MB_LATENCY_SLOT( n )            ( 2 + ( n ) * MB_LATENCY_SLOT_REGS )
+/* Offsets within a slot. Each time has a minimum, mean and maximum. */
+#define MB_LATENCY_FUNCTION             0
+#define MB_LATENCY_COUNT                1
+#define MB_LATENCY_RECEIVE              2   /* first byte to t3.5 expiry */
+#define MB_LATENCY_REPLY                5   /* t3.5 expiry to first reply byte */
+#define MB_LATENCY_CALLBACK             8   /* time in register callbacks */
+#define MB_LATENCY_TURNAROUND           11  /* t3.5 expiry to end of reply */
+#define MB_LATENCY_HISTOGRAM            14
+#define MB_LATENCY_SLOT_REGS            ( MB_LATENCY_HISTOGRAM + MB_LATENCY_BUCKETS )
+#define MB_LATENCY_NREGS                MB_LATENCY_SLOT( MB_LATENCY_SLOTS )
+
+/* ----------------------- Prototypes ---------------------------------------*/
+void            vMBLatencyInit( void );
+void            vMBLatencyReset( void );
+void            vMBLatencyUpdate( USHORT * pusRegs );
+
+#endif
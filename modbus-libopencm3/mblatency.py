@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Load generator and reader for the latency statistics of mblatency.c.
+
+Resets the statistics of the modbus.c slave, sends a mix of read input,
+read holding, read coils and write register requests as fast as the replies
+come back, then reads the statistics input registers and prints them per
+function code. The slave must be built with MB_PORT_LATENCY set to 1.
+
+    mblatency.py /dev/ttyUSB0 [requests] [baudrate]
+
+Needs pyserial. The defaults match modbus.c: slave 0x0A, 38400 baud, even
+parity, 1000 requests.
+
+14 October 2026
+"""
+
+import struct
+import sys
+import time
+
+SLAVE = 0x0A
+# Wire addresses are one less than the register addresses of modbus.c
+INPUT_ADDRESS = 999
+LATENCY_ADDRESS = 1999
+LATENCY_RESET_ADDRESS = 1
+# Layout of mblatency.h
+SLOTS = 4
+BUCKETS = 8
+SLOT_REGS = 14 + BUCKETS
+NREGS = 2 + SLOTS * SLOT_REGS
+
+LOAD = [
+    (0x04, struct.pack('>HH', INPUT_ADDRESS, 4)),
+    (0x03, struct.pack('>HH', 2, 8)),
+    (0x01, struct.pack('>HH', 0, 16)),
+    (0x06, struct.pack('>HH', 5, 0x1234)),
+]
+
+
+def crc16(data):
+    """Modbus CRC-16, sent low byte first."""
+    crc = 0xFFFF
+    for c in data:
+        crc ^= c
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def request(port, function, data):
+    """Send one request and return the reply PDU data, or None on error."""
+    frame = bytes([SLAVE, function]) + data
+    frame += struct.pack('<H', crc16(frame))
+    port.reset_input_buffer()
+    port.write(frame)
+    reply = port.read(3)
+    if len(reply) < 3:
+        return None
+    if reply[1] & 0x80:
+        length = 5
+    elif function in (0x05, 0x06, 0x0F, 0x10):
+        length = 8
+    else:
+        length = 5 + reply[2]
+    reply += port.read(length - 3)
+    if len(reply) != length or crc16(reply) != 0 or reply[1] & 0x80:
+        return None
+    return reply[2:-2]
+
+
+def read_registers(port, address, count):
+    values = []
+    while count > 0:
+        n = min(count, 125)
+        reply = request(port, 0x04, struct.pack('>HH', address, n))
+        if reply is None:
+            raise IOError('no reply reading registers %d' % address)
+        values += struct.unpack('>%dH' % n, reply[1:])
+        address += n
+        count -= n
+    return values
+
+
+def main():
+    import serial
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    requests = int(sys.argv[2]) if len(sys.argv) > 2 else 1000
+    baudrate = int(sys.argv[3]) if len(sys.argv) > 3 else 38400
+    port = serial.Serial(sys.argv[1], baudrate, parity=serial.PARITY_EVEN,
+                         timeout=0.5)
+    request(port, 0x06, struct.pack('>HH', LATENCY_RESET_ADDRESS, 1))
+    # The slave resets then converts the statistics in its poll loop
+    time.sleep(0.05)
+    failed = 0
+    start = time.time()
+    for i in range(requests):
+        function, data = LOAD[i % len(LOAD)]
+        if request(port, function, data) is None:
+            failed += 1
+    elapsed = time.time() - start
+    time.sleep(0.05)
+    regs = read_registers(port, LATENCY_ADDRESS, NREGS)
+    print('%d requests in %.2fs, %d failed' % (requests, elapsed, failed))
+    print('%d frames timed, %d not classified' % (regs[0], regs[1]))
+    print('fn  count   reply us min/avg/max  callback cycles  '
+          'turnaround us   reply histogram <4,8..256,more us')
+    for slot in range(SLOTS):
+        r = regs[2 + slot * SLOT_REGS:2 + (slot + 1) * SLOT_REGS]
+        if r[0] == 0:
+            continue
+        print('%02x %6d  %5d %5d %5d  %5d %5d %5d  %5d %5d %5d  %s' % (
+            r[0], r[1], r[5], r[6], r[7], r[8], r[9], r[10],
+            r[11], r[12], r[13], ' '.join('%d' % h for h in r[14:])))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,395 @@
+/*
+ * FreeModbus Libary: Master for the STM32F103 port
+ * Copyright (C) 2026 Ken Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: mbmaster.c,v 1.0 2026/10/14 Exp $
+ */
+
+/* Modbus RTU master.
+
+FreeModbus 1.5 is slave only. This is a master built on the same port layer,
+which takes over the frame callbacks of the port in place of the slave stack,
+so the two are not used together.
+
+The application gives a schedule of transactions, each a read or write of one
+slave, which is worked through in turn for as long as the master is running.
+Each request is sent as soon as the t3.5 silent interval after the previous
+response has passed, so the bus is never idle longer than the protocol
+requires. A request that is not answered within its timeout, or is answered
+with a bad CRC, is tried again up to its retry count before the next one is
+started. A slave that returns an exception is not retried.
+
+Everything is driven from the USART and timer interrupts, with no task or
+polling. The results of each transaction are written into its data array and
+result fields from the timer interrupt, bracketed by a sequence count, and
+eMBMasterResult( ) takes a coherent copy.
+
+Write transactions read their data array when the request is sent. */
+
+#include <string.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mbcrc.h"
+#include "mbregmap.h"
+#include "mbmaster.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_MASTER_FRAME_SIZE            ( 256 )
+
+/* Time allowed for slaves to act on a broadcast write */
+#define MB_MASTER_TURNAROUND_MS         ( 100 )
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef enum
+{
+    STATE_STOPPED,              /* Not running */
+    STATE_IDLE,                 /* Waiting for t3.5 before the next request */
+    STATE_SENDING,              /* Request being sent */
+    STATE_WAITING,              /* Waiting for the first byte of a response */
+    STATE_RECEIVING,            /* Response being received */
+    STATE_TURNAROUND            /* Waiting after a broadcast */
+} eMBMasterState;
+
+/* ----------------------- Static variables ---------------------------------*/
+static xMBMasterTransaction *pxTransactions;
+static USHORT   usNTransactions;
+static USHORT   usCurrent;
+static UCHAR    ucAttempt;
+static ULONG    ulCycles;
+
+static volatile eMBMasterState eState;
+static UCHAR    ucFrame[MB_MASTER_FRAME_SIZE];
+static USHORT   usFrameLength;
+static USHORT   usFramePosition;
+
+/* ----------------------- Static functions ---------------------------------*/
+static BOOL     xMBMasterByteReceived( void );
+static BOOL     xMBMasterTransmitterEmpty( void );
+static BOOL     xMBMasterTimerExpired( void );
+static void     vMBMasterSend( void );
+static void     vMBMasterComplete( eMBMasterStatus eStatus, UCHAR ucException );
+static BOOL     xMBMasterIsBits( UCHAR ucFunction );
+
+/* Memory barrier so that result and sequence count are seen in order */
+static inline void
+vMBMasterBarrier( void )
+{
+#if defined( __ARM_ARCH_7M__ ) || defined( __ARM_ARCH_7EM__ )
+    __asm__ __volatile__( "dmb" ::: "memory" );
+#else
+    __sync_synchronize(  );
+#endif
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+/* Set up the port and the schedule. The master is left stopped. */
+BOOL
+xMBMasterInit( ULONG ulBaudRate, eMBParity eParity,
+               xMBMasterTransaction * pxSchedule, USHORT usLength )
+{
+    USHORT usTimerT35_50us;
+    USHORT i;
+
+    /* As for the slave, t3.5 is fixed at 1750us above 19200 baud */
+    if( ulBaudRate > 19200 ) usTimerT35_50us = 35;
+    else usTimerT35_50us = ( 7UL * 220000UL ) / ( 2UL * ulBaudRate );
+
+    eState = STATE_STOPPED;
+    pxTransactions = pxSchedule;
+    usNTransactions = usLength;
+    for( i = 0; i < usLength; i++ )
+    {
+        if( !xMBMasterIsBits( pxSchedule[i].ucFunction ) &&
+            ( pxSchedule[i].usCount > MB_MASTER_MAX_REGS ) ) return FALSE;
+        pxSchedule[i].eStatus = MB_MASTER_PENDING;
+        pxSchedule[i].ulSeq = 0;
+        pxSchedule[i].ulGood = 0;
+        pxSchedule[i].ulFailed = 0;
+    }
+
+    pxMBFrameCBByteReceived = xMBMasterByteReceived;
+    pxMBFrameCBTransmitterEmpty = xMBMasterTransmitterEmpty;
+    pxMBPortCBTimerExpired = xMBMasterTimerExpired;
+
+    if( !xMBPortSerialInit( 1, ulBaudRate, 8, eParity ) ) return FALSE;
+    return xMBPortTimersInit( usTimerT35_50us );
+}
+
+/* Start polling from the first transaction, after one t3.5 interval */
+void
+vMBMasterStart( void )
+{
+    if( usNTransactions == 0 ) return;
+    usCurrent = 0;
+    ucAttempt = 0;
+    eState = STATE_IDLE;
+    vMBPortSerialEnable( TRUE, FALSE );
+    vMBPortTimersEnable(  );
+}
+
+/* Stop polling. A transaction in progress is abandoned. */
+void
+vMBMasterStop( void )
+{
+    ENTER_CRITICAL_SECTION(  );
+    eState = STATE_STOPPED;
+    vMBPortTimersDisable(  );
+    vMBPortSerialEnable( FALSE, FALSE );
+    EXIT_CRITICAL_SECTION(  );
+}
+
+/* Number of times the whole schedule has been worked through */
+ULONG
+ulMBMasterCycles( void )
+{
+    return ulCycles;
+}
+
+/* Copy the data of a transaction, up to usBytes, and return its status, all
+ * from the same completion. */
+eMBMasterStatus
+eMBMasterResult( xMBMasterTransaction * pxTransaction, void *pvOut, USHORT usBytes )
+{
+    ULONG ulSeq;
+    eMBMasterStatus eStatus;
+
+    do
+    {
+        while( ( ulSeq = pxTransaction->ulSeq ) & 1 );
+        vMBMasterBarrier(  );
+        eStatus = pxTransaction->eStatus;
+        if( pvOut != NULL ) memcpy( pvOut, pxTransaction->pvData, usBytes );
+        vMBMasterBarrier(  );
+    }
+    while( ulSeq != pxTransaction->ulSeq );
+    return eStatus;
+}
+
+/* ----------------------- Request -----------------------------*/
+/* Build the request for the current transaction and start sending it */
+static void
+vMBMasterSend( void )
+{
+    xMBMasterTransaction *pxT = &pxTransactions[usCurrent];
+    USHORT usCRC;
+
+    ucFrame[0] = pxT->ucSlave;
+    ucFrame[1] = pxT->ucFunction;
+    ucFrame[2] = ( UCHAR )( pxT->usAddress >> 8 );
+    ucFrame[3] = ( UCHAR )( pxT->usAddress & 0xFF );
+    switch ( pxT->ucFunction )
+    {
+    case MB_MASTER_WRITE_REGISTER:
+        vMBRegCopyToFrame( &ucFrame[4], pxT->pvData, 1 );
+        usFrameLength = 6;
+        break;
+    case MB_MASTER_WRITE_REGISTERS:
+        ucFrame[4] = ( UCHAR )( pxT->usCount >> 8 );
+        ucFrame[5] = ( UCHAR )( pxT->usCount & 0xFF );
+        ucFrame[6] = ( UCHAR )( pxT->usCount * 2 );
+        vMBRegCopyToFrame( &ucFrame[7], pxT->pvData, pxT->usCount );
+        usFrameLength = 7 + pxT->usCount * 2;
+        break;
+    default:
+        ucFrame[4] = ( UCHAR )( pxT->usCount >> 8 );
+        ucFrame[5] = ( UCHAR )( pxT->usCount & 0xFF );
+        usFrameLength = 6;
+        break;
+    }
+    usCRC = usMBCRC16( ucFrame, usFrameLength );
+    ucFrame[usFrameLength++] = ( UCHAR )( usCRC & 0xFF );
+    ucFrame[usFrameLength++] = ( UCHAR )( usCRC >> 8 );
+
+    usFramePosition = 0;
+    eState = STATE_SENDING;
+    vMBPortSerialEnable( FALSE, TRUE );
+}
+
+/* ----------------------- Completion -----------------------------*/
+/* Record the outcome of the current transaction and move to the next. The
+ * caller starts the t3.5 wait before the next request. */
+static void
+vMBMasterComplete( eMBMasterStatus eStatus, UCHAR ucException )
+{
+    xMBMasterTransaction *pxT = &pxTransactions[usCurrent];
+
+    if( ( eStatus == MB_MASTER_TIMEOUT ) && ( ucAttempt < pxT->ucRetries ) )
+    {
+        ucAttempt++;
+        return;
+    }
+    pxT->ulSeq++;
+    vMBMasterBarrier(  );
+    if( eStatus == MB_MASTER_OK )
+    {
+        /* Read data is put in place only now that the frame is known good */
+        if( ( usFrameLength > 0 ) && ( ucFrame[1] <= MB_MASTER_READ_INPUT ) )
+        {
+            if( xMBMasterIsBits( pxT->ucFunction ) )
+            {
+                memcpy( pxT->pvData, &ucFrame[3], ucFrame[2] );
+            }
+            else
+            {
+                vMBRegCopyFromFrame( pxT->pvData, &ucFrame[3], pxT->usCount );
+            }
+        }
+        pxT->ulGood++;
+    }
+    else
+    {
+        pxT->ulFailed++;
+    }
+    pxT->eStatus = eStatus;
+    pxT->ucException = ucException;
+    vMBMasterBarrier(  );
+    pxT->ulSeq++;
+
+    ucAttempt = 0;
+    if( ++usCurrent >= usNTransactions )
+    {
+        usCurrent = 0;
+        ulCycles++;
+    }
+}
+
+static BOOL
+xMBMasterIsBits( UCHAR ucFunction )
+{
+    return ( ucFunction == MB_MASTER_READ_COILS ) || ( ucFunction == MB_MASTER_READ_DISCRETE );
+}
+
+/* Check a received response against the request */
+static void
+vMBMasterCheckResponse( void )
+{
+    xMBMasterTransaction *pxT = &pxTransactions[usCurrent];
+    USHORT usExpected;
+
+    if( ( usFramePosition < 5 ) || ( usMBCRC16( ucFrame, usFramePosition ) != 0 ) ||
+        ( ucFrame[0] != pxT->ucSlave ) )
+    {
+        usFrameLength = 0;
+        vMBMasterComplete( MB_MASTER_TIMEOUT, 0 );
+        return;
+    }
+    if( ucFrame[1] == ( pxT->ucFunction | 0x80 ) )
+    {
+        usFrameLength = 0;
+        vMBMasterComplete( MB_MASTER_EXCEPTION, ucFrame[2] );
+        return;
+    }
+    if( ucFrame[1] <= MB_MASTER_READ_INPUT )
+    {
+        if( xMBMasterIsBits( pxT->ucFunction ) ) usExpected = ( pxT->usCount + 7 ) / 8;
+        else usExpected = pxT->usCount * 2;
+        if( ( ucFrame[1] != pxT->ucFunction ) || ( ucFrame[2] != usExpected ) ||
+            ( usFramePosition != usExpected + 5 ) )
+        {
+            usFrameLength = 0;
+            vMBMasterComplete( MB_MASTER_TIMEOUT, 0 );
+            return;
+        }
+    }
+    else if( ( ucFrame[1] != pxT->ucFunction ) || ( usFramePosition != 8 ) )
+    {
+        usFrameLength = 0;
+        vMBMasterComplete( MB_MASTER_TIMEOUT, 0 );
+        return;
+    }
+    usFrameLength = usFramePosition;
+    vMBMasterComplete( MB_MASTER_OK, 0 );
+}
+
+/* ----------------------- Port callbacks -----------------------------*/
+/* Called from the USART transmit interrupt for each byte of the request */
+static BOOL
+xMBMasterTransmitterEmpty( void )
+{
+    xMBMasterTransaction *pxT;
+
+    if( eState != STATE_SENDING ) return FALSE;
+    if( usFramePosition < usFrameLength )
+    {
+        xMBPortSerialPutByte( ( CHAR )ucFrame[usFramePosition++] );
+        return FALSE;
+    }
+    /* All sent. Wait for the response, or for the turnaround after a
+     * broadcast. */
+    pxT = &pxTransactions[usCurrent];
+    vMBPortSerialEnable( TRUE, FALSE );
+    usFramePosition = 0;
+    if( pxT->ucSlave == 0 )
+    {
+        eState = STATE_TURNAROUND;
+        vMBPortTimersSet( MB_MASTER_TURNAROUND_MS * 20 );
+    }
+    else
+    {
+        eState = STATE_WAITING;
+        vMBPortTimersSet( pxT->usTimeoutMs * 20 );
+    }
+    return FALSE;
+}
+
+/* Called for each byte received, from the USART or the DMA drain */
+static BOOL
+xMBMasterByteReceived( void )
+{
+    CHAR cByte;
+
+    ( void )xMBPortSerialGetByte( &cByte );
+    if( ( eState != STATE_WAITING ) && ( eState != STATE_RECEIVING ) ) return FALSE;
+    eState = STATE_RECEIVING;
+    if( usFramePosition < MB_MASTER_FRAME_SIZE ) ucFrame[usFramePosition++] = ( UCHAR )cByte;
+    /* The response ends when the line has been silent for t3.5 */
+    vMBPortTimersEnable(  );
+    return FALSE;
+}
+
+/* Called from the timer interrupt at the end of t3.5 or a timeout */
+static BOOL
+xMBMasterTimerExpired( void )
+{
+    vMBPortTimersDisable(  );
+    switch ( eState )
+    {
+    case STATE_RECEIVING:
+        vMBMasterCheckResponse(  );
+        break;
+    case STATE_WAITING:
+        usFrameLength = 0;
+        vMBMasterComplete( MB_MASTER_TIMEOUT, 0 );
+        break;
+    case STATE_TURNAROUND:
+        usFrameLength = 0;
+        vMBMasterComplete( MB_MASTER_OK, 0 );
+        break;
+    case STATE_IDLE:
+        /* t3.5 has passed since the last response, so send at once */
+        vMBMasterSend(  );
+        return FALSE;
+    default:
+        return FALSE;
+    }
+    /* The line has been silent for t3.5 after the response, or longer after
+     * a timeout, so the next request can go straight away. */
+    vMBMasterSend(  );
+    return FALSE;
+}
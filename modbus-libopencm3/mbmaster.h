@@ -0,0 +1,78 @@
+/*
+ * FreeModbus Libary: Master for the STM32F103 port
+ * Copyright (C) 2026 Ken Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: mbmaster.h,v 1.0 2026/10/14 Exp $
+ */
+
+#ifndef _MB_MASTER_H
+#define _MB_MASTER_H
+
+#include "port.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+/* Function codes handled by the master */
+#define MB_MASTER_READ_COILS            ( 0x01 )
+#define MB_MASTER_READ_DISCRETE         ( 0x02 )
+#define MB_MASTER_READ_HOLDING          ( 0x03 )
+#define MB_MASTER_READ_INPUT            ( 0x04 )
+#define MB_MASTER_WRITE_REGISTER        ( 0x06 )
+#define MB_MASTER_WRITE_REGISTERS       ( 0x10 )
+
+/* Largest count of registers read or written in one transaction */
+#define MB_MASTER_MAX_REGS              ( 123 )
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef enum
+{
+    MB_MASTER_PENDING,          /* Not yet completed */
+    MB_MASTER_OK,               /* Last attempt succeeded */
+    MB_MASTER_TIMEOUT,          /* No valid response after all retries */
+    MB_MASTER_EXCEPTION         /* Slave returned an exception */
+} eMBMasterStatus;
+
+/* One scheduled transaction. The first fields are set by the application.
+ * The data array holds the registers read, or those to write, in native byte
+ * order, or the coils and discrete inputs packed eight to a byte. The other
+ * fields are the result cache, updated at each completion. */
+typedef struct
+{
+    UCHAR           ucSlave;        /* Slave address, 0 for broadcast writes */
+    UCHAR           ucFunction;     /* One of the MB_MASTER function codes */
+    USHORT          usAddress;      /* First register or bit */
+    USHORT          usCount;        /* Number of registers or bits */
+    void           *pvData;
+    USHORT          usTimeoutMs;    /* Response timeout */
+    UCHAR           ucRetries;      /* Further attempts after a failure */
+
+    volatile ULONG  ulSeq;          /* Odd while the result is updated */
+    eMBMasterStatus eStatus;
+    UCHAR           ucException;
+    ULONG           ulGood;         /* Completions */
+    ULONG           ulFailed;       /* Completions that timed out or failed */
+} xMBMasterTransaction;
+
+/* ----------------------- Prototypes ---------------------------------------*/
+BOOL            xMBMasterInit( ULONG ulBaudRate, eMBParity eParity,
+                               xMBMasterTransaction * pxSchedule, USHORT usLength );
+void            vMBMasterStart( void );
+void            vMBMasterStop( void );
+ULONG           ulMBMasterCycles( void );
+eMBMasterStatus eMBMasterResult( xMBMasterTransaction * pxTransaction,
+                                 void *pvOut, USHORT usBytes );
+
+#endif
@@ -0,0 +1,398 @@
+/*
+ * FreeModbus Libary: Register map for the STM32F103 port
+ * Copyright (C) 2026 Ken Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: mbregmap.c,v 1.0 2026/10/14 Exp $
+ */
+
+/* Table driven register callbacks.
+
+The application describes its input registers, holding registers, coils and
+discrete inputs as tables of address ranges mapped to arrays, and passes them
+to vMBRegMapSet( ). This file then provides the four register callbacks of the
+protocol stack. The range holding a request is found by binary search, so a
+slave may have many ranges and thousands of points. The same accesses are
+provided on a map given with each call, eMBRegMapInput( ) and the others, for
+the slaves of mbslave.c, which may each have a map or share one.
+
+Registers are held in native byte order and sent big endian. They are copied
+two at a time with a 32 bit load, a REV16 byte swap and a 32 bit store, which
+the Cortex-M3 allows at any alignment. Coils and discrete inputs are held
+packed eight to a byte, in the same order as in the Modbus frame, so they are
+copied a byte at a time with shifts for the bit offset.
+
+A request must lie entirely within one range.
+
+A register range shared between tasks can be given a bank of two buffers. The
+writer fills the buffer not in use and then publishes it by incrementing the
+sequence count, whose low bit selects the current buffer. A reader copies from
+the current buffer and checks that the count has not changed meanwhile,
+repeating the copy if it has. The reader never waits for a writer part way
+through an update, so a high priority reader cannot be held up by a preempted
+writer, and no mutex or interrupt masking is needed. The copy is only repeated
+if a whole update was published during it.
+
+With MB_PORT_LATENCY set each callback is timed for the latency statistics of
+mblatency.c. */
+
+#include <string.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mbregmap.h"
+
+/* ----------------------- Static variables ---------------------------------*/
+static const xMBRegMap *pxRegMap;
+
+/* ----------------------- Static functions ---------------------------------*/
+/* Swap the bytes of each halfword */
+static inline uint32_t
+ulRev16( uint32_t ulValue )
+{
+#if defined( __ARM_ARCH_7M__ ) || defined( __ARM_ARCH_7EM__ )
+    __asm__( "rev16 %0, %1" : "=r" ( ulValue ) : "r" ( ulValue ) );
+    return ulValue;
+#else
+    return ( ( ulValue & 0xFF00FF00 ) >> 8 ) | ( ( ulValue & 0x00FF00FF ) << 8 );
+#endif
+}
+
+/* Memory barrier so that data and sequence count are seen in order */
+static inline void
+vMBRegBarrier( void )
+{
+#if defined( __ARM_ARCH_7M__ ) || defined( __ARM_ARCH_7EM__ )
+    __asm__ __volatile__( "dmb" ::: "memory" );
+#else
+    __sync_synchronize(  );
+#endif
+}
+
+/* Find the range holding all addresses usAddress to usAddress + usN - 1.
+ * Returns NULL if there is none. */
+static const xMBRegRange *
+pxMBRegFind( const xMBRegRange * pxRanges, USHORT usNRanges, USHORT usAddress, USHORT usN )
+{
+    USHORT usLow = 0;
+    USHORT usHigh = usNRanges;
+
+    /* Find the last range starting at or below the address */
+    while( usLow < usHigh )
+    {
+        USHORT usMid = ( usLow + usHigh ) / 2;
+        if( pxRanges[usMid].usStart <= usAddress ) usLow = usMid + 1;
+        else usHigh = usMid;
+    }
+    if( usLow == 0 ) return NULL;
+    const xMBRegRange *pxRange = &pxRanges[usLow - 1];
+    if( ( ULONG )usAddress + usN > ( ULONG )pxRange->usStart + pxRange->usCount ) return NULL;
+    return pxRange;
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+void
+vMBRegMapSet( const xMBRegMap * pxMap )
+{
+    pxRegMap = pxMap;
+}
+
+/* ----------------------- Register copies -----------------------------*/
+/* Copy registers to a frame in big endian order */
+void
+vMBRegCopyToFrame( UCHAR * pucFrame, const USHORT * pusRegs, USHORT usNRegs )
+{
+    uint32_t ulPair;
+    while( usNRegs >= 2 )
+    {
+        memcpy( &ulPair, pusRegs, 4 );
+        ulPair = ulRev16( ulPair );
+        memcpy( pucFrame, &ulPair, 4 );
+        pusRegs += 2;
+        pucFrame += 4;
+        usNRegs -= 2;
+    }
+    if( usNRegs > 0 )
+    {
+        pucFrame[0] = ( UCHAR )( *pusRegs >> 8 );
+        pucFrame[1] = ( UCHAR )( *pusRegs & 0xFF );
+    }
+}
+
+/* Copy registers from a frame in big endian order */
+void
+vMBRegCopyFromFrame( USHORT * pusRegs, const UCHAR * pucFrame, USHORT usNRegs )
+{
+    uint32_t ulPair;
+    while( usNRegs >= 2 )
+    {
+        memcpy( &ulPair, pucFrame, 4 );
+        ulPair = ulRev16( ulPair );
+        memcpy( pusRegs, &ulPair, 4 );
+        pusRegs += 2;
+        pucFrame += 4;
+        usNRegs -= 2;
+    }
+    if( usNRegs > 0 )
+    {
+        *pusRegs = ( USHORT )( ( pucFrame[0] << 8 ) | pucFrame[1] );
+    }
+}
+
+/* ----------------------- Bit copies -----------------------------*/
+/* Read usNBits bits starting at bit usFirst of a packed array into bytes
+ * starting at bit 0 of pucOut. Unused high bits of the last byte are zero. */
+void
+vMBRegBitsRead( UCHAR * pucOut, const UCHAR * pucBits, USHORT usFirst, USHORT usNBits )
+{
+    const UCHAR *pucIn = pucBits + ( usFirst >> 3 );
+    UCHAR ucShift = usFirst & 7;
+    USHORT usNBytes = ( usNBits + 7 ) >> 3;
+    USHORT i;
+
+    for( i = 0; i < usNBytes; i++ )
+    {
+        UCHAR ucByte = pucIn[i] >> ucShift;
+        /* Take the high bits from the next byte only if they are wanted, so
+         * that nothing is read past the end of the array */
+        if( ( ucShift != 0 ) && ( ( ULONG )i * 8 + 8 - ucShift < usNBits ) )
+        {
+            ucByte |= pucIn[i + 1] << ( 8 - ucShift );
+        }
+        pucOut[i] = ucByte;
+    }
+    if( ( usNBits & 7 ) != 0 )
+    {
+        pucOut[usNBytes - 1] &= ( UCHAR )( ( 1 << ( usNBits & 7 ) ) - 1 );
+    }
+}
+
+/* Write usNBits bits from bytes starting at bit 0 of pucIn into a packed
+ * array starting at bit usFirst, leaving the other bits unchanged. */
+void
+vMBRegBitsWrite( UCHAR * pucBits, const UCHAR * pucIn, USHORT usFirst, USHORT usNBits )
+{
+    UCHAR *pucOut = pucBits + ( usFirst >> 3 );
+    UCHAR ucShift = usFirst & 7;
+
+    while( usNBits > 0 )
+    {
+        UCHAR ucCount = ( usNBits < 8 ) ? usNBits : 8;
+        USHORT usMask = ( USHORT )( ( ( 1 << ucCount ) - 1 ) << ucShift );
+        USHORT usValue = ( USHORT )( *pucIn++ << ucShift );
+        pucOut[0] = ( UCHAR )( ( pucOut[0] & ~usMask ) | ( usValue & usMask ) );
+        if( ucShift + ucCount > 8 )
+        {
+            pucOut[1] = ( UCHAR )( ( pucOut[1] & ~( usMask >> 8 ) ) | ( ( usValue & usMask ) >> 8 ) );
+        }
+        pucOut++;
+        usNBits -= ucCount;
+    }
+}
+
+/* ----------------------- Register banks -----------------------------*/
+/* Start an update of a bank. The current values are copied to the other
+ * buffer, which is returned to be changed as needed and then published. */
+USHORT *
+pusMBRegBankBegin( xMBRegBank * pxBank, USHORT usCount )
+{
+    ULONG ulSeq = pxBank->ulSeq;
+    USHORT *pusNext = pxBank->pusBuf[( ulSeq + 1 ) & 1];
+    memcpy( pusNext, pxBank->pusBuf[ulSeq & 1], usCount * sizeof( USHORT ) );
+    return pusNext;
+}
+
+/* Make the buffer returned by pusMBRegBankBegin( ) current */
+void
+vMBRegBankPublish( xMBRegBank * pxBank )
+{
+    vMBRegBarrier(  );
+    pxBank->ulSeq++;
+    vMBRegBarrier(  );
+}
+
+/* Copy a coherent set of registers from a bank, starting at register usFirst,
+ * in native byte order. */
+void
+vMBRegBankRead( xMBRegBank * pxBank, USHORT * pusOut, USHORT usFirst, USHORT usNRegs )
+{
+    ULONG ulSeq;
+    do
+    {
+        ulSeq = pxBank->ulSeq;
+        vMBRegBarrier(  );
+        memcpy( pusOut, pxBank->pusBuf[ulSeq & 1] + usFirst, usNRegs * sizeof( USHORT ) );
+        vMBRegBarrier(  );
+    }
+    while( ulSeq != pxBank->ulSeq );
+}
+
+/* Copy registers of a range to a frame, through the bank if it has one */
+static void
+vMBRegRangeToFrame( UCHAR * pucFrame, const xMBRegRange * pxRange, USHORT usFirst, USHORT usNRegs )
+{
+    xMBRegBank *pxBank = pxRange->pxBank;
+    ULONG ulSeq;
+
+    if( pxBank == NULL )
+    {
+        vMBRegCopyToFrame( pucFrame, ( USHORT * )pxRange->pvData + usFirst, usNRegs );
+        return;
+    }
+    do
+    {
+        ulSeq = pxBank->ulSeq;
+        vMBRegBarrier(  );
+        vMBRegCopyToFrame( pucFrame, pxBank->pusBuf[ulSeq & 1] + usFirst, usNRegs );
+        vMBRegBarrier(  );
+    }
+    while( ulSeq != pxBank->ulSeq );
+}
+
+/* ----------------------- Register map access -----------------------------*/
+/* The four accesses of a given map, for the callbacks below or for a protocol
+ * engine with a map of its own, such as each slave of mbslave.c. */
+eMBErrorCode
+eMBRegMapInput( const xMBRegMap * pxMap, UCHAR * pucRegBuffer, USHORT usAddress,
+                USHORT usNRegs )
+{
+    const xMBRegRange *pxRange;
+
+    if( ( pxMap == NULL ) ||
+        ( ( pxRange = pxMBRegFind( pxMap->pxInput, pxMap->usNInput, usAddress, usNRegs ) ) == NULL ) )
+    {
+        return MB_ENOREG;
+    }
+    vMBRegRangeToFrame( pucRegBuffer, pxRange, usAddress - pxRange->usStart, usNRegs );
+    return MB_ENOERR;
+}
+
+eMBErrorCode
+eMBRegMapHolding( const xMBRegMap * pxMap, UCHAR * pucRegBuffer, USHORT usAddress,
+                  USHORT usNRegs, eMBRegisterMode eMode )
+{
+    const xMBRegRange *pxRange;
+    USHORT usFirst;
+
+    if( ( pxMap == NULL ) ||
+        ( ( pxRange = pxMBRegFind( pxMap->pxHolding, pxMap->usNHolding, usAddress, usNRegs ) ) == NULL ) )
+    {
+        return MB_ENOREG;
+    }
+    usFirst = usAddress - pxRange->usStart;
+    if( eMode == MB_REG_READ )
+    {
+        vMBRegRangeToFrame( pucRegBuffer, pxRange, usFirst, usNRegs );
+    }
+    else if( pxRange->pxBank == NULL )
+    {
+        vMBRegCopyFromFrame( ( USHORT * )pxRange->pvData + usFirst, pucRegBuffer, usNRegs );
+    }
+    else
+    {
+        /* The Modbus task is then the writer of this bank */
+        USHORT *pusRegs = pusMBRegBankBegin( pxRange->pxBank, pxRange->usCount );
+        vMBRegCopyFromFrame( pusRegs + usFirst, pucRegBuffer, usNRegs );
+        vMBRegBankPublish( pxRange->pxBank );
+    }
+    return MB_ENOERR;
+}
+
+eMBErrorCode
+eMBRegMapCoils( const xMBRegMap * pxMap, UCHAR * pucRegBuffer, USHORT usAddress,
+                USHORT usNCoils, eMBRegisterMode eMode )
+{
+    const xMBRegRange *pxRange;
+
+    if( ( pxMap == NULL ) ||
+        ( ( pxRange = pxMBRegFind( pxMap->pxCoils, pxMap->usNCoils, usAddress, usNCoils ) ) == NULL ) )
+    {
+        return MB_ENOREG;
+    }
+    if( eMode == MB_REG_READ )
+    {
+        vMBRegBitsRead( pucRegBuffer, pxRange->pvData, usAddress - pxRange->usStart, usNCoils );
+    }
+    else
+    {
+        vMBRegBitsWrite( pxRange->pvData, pucRegBuffer, usAddress - pxRange->usStart, usNCoils );
+    }
+    return MB_ENOERR;
+}
+
+eMBErrorCode
+eMBRegMapDiscrete( const xMBRegMap * pxMap, UCHAR * pucRegBuffer, USHORT usAddress,
+                   USHORT usNDiscrete )
+{
+    const xMBRegRange *pxRange;
+
+    if( ( pxMap == NULL ) ||
+        ( ( pxRange = pxMBRegFind( pxMap->pxDiscrete, pxMap->usNDiscrete, usAddress, usNDiscrete ) ) == NULL ) )
+    {
+        return MB_ENOREG;
+    }
+    vMBRegBitsRead( pucRegBuffer, pxRange->pvData, usAddress - pxRange->usStart, usNDiscrete );
+    return MB_ENOERR;
+}
+
+/* ----------------------- Register callbacks -----------------------------*/
+/* The callbacks of the FreeModbus stack, on the map given to vMBRegMapSet( ) */
+eMBErrorCode
+eMBRegInputCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs )
+{
+    eMBErrorCode eStatus;
+
+    MB_LATENCY_CB_ENTER(  );
+    eStatus = eMBRegMapInput( pxRegMap, pucRegBuffer, usAddress, usNRegs );
+    MB_LATENCY_CB_EXIT(  );
+    return eStatus;
+}
+
+eMBErrorCode
+eMBRegHoldingCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs,
+                 eMBRegisterMode eMode )
+{
+    eMBErrorCode eStatus;
+
+    MB_LATENCY_CB_ENTER(  );
+    eStatus = eMBRegMapHolding( pxRegMap, pucRegBuffer, usAddress, usNRegs, eMode );
+    MB_LATENCY_CB_EXIT(  );
+    return eStatus;
+}
+
+eMBErrorCode
+eMBRegCoilsCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNCoils,
+               eMBRegisterMode eMode )
+{
+    eMBErrorCode eStatus;
+
+    MB_LATENCY_CB_ENTER(  );
+    eStatus = eMBRegMapCoils( pxRegMap, pucRegBuffer, usAddress, usNCoils, eMode );
+    MB_LATENCY_CB_EXIT(  );
+    return eStatus;
+}
+
+eMBErrorCode
+eMBRegDiscreteCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNDiscrete )
+{
+    eMBErrorCode eStatus;
+
+    MB_LATENCY_CB_ENTER(  );
+    eStatus = eMBRegMapDiscrete( pxRegMap, pucRegBuffer, usAddress, usNDiscrete );
+    MB_LATENCY_CB_EXIT(  );
+    return eStatus;
+}
@@ -0,0 +1,88 @@
+/*
+ * FreeModbus Libary: Register map for the STM32F103 port
+ * Copyright (C) 2026 Ken Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: mbregmap.h,v 1.0 2026/10/14 Exp $
+ */
+
+#ifndef _MB_REGMAP_H
+#define _MB_REGMAP_H
+
+#include "port.h"
+#include "mb.h"
+
+/* ----------------------- Type definitions ---------------------------------*/
+/* Double buffered register bank, so that a block of registers can be updated
+ * by one task and read coherently by another without locking. The low bit of
+ * ulSeq selects the buffer holding the current values, and ulSeq is
+ * incremented each time the other buffer is published. Each of the two
+ * buffers holds the usCount registers of the range. There must be only one
+ * writer of a bank. */
+typedef struct
+{
+    USHORT         *pusBuf[2];
+    volatile ULONG  ulSeq;
+} xMBRegBank;
+
+/* A range of consecutive addresses backed by an array. For input and holding
+ * registers pvData is a USHORT array of usCount entries, and for coils and
+ * discrete inputs it is a UCHAR array of ( usCount + 7 ) / 8 bytes with the
+ * first address in the least significant bit of the first byte. A register
+ * range may have a bank instead, in which case pvData is not used. */
+typedef struct
+{
+    USHORT          usStart;
+    USHORT          usCount;
+    void           *pvData;
+    xMBRegBank     *pxBank;
+} xMBRegRange;
+
+/* The ranges of each table must be sorted by start address and not overlap.
+ * A table not used may be left NULL with no ranges. */
+typedef struct
+{
+    const xMBRegRange *pxInput;
+    USHORT          usNInput;
+    const xMBRegRange *pxHolding;
+    USHORT          usNHolding;
+    const xMBRegRange *pxCoils;
+    USHORT          usNCoils;
+    const xMBRegRange *pxDiscrete;
+    USHORT          usNDiscrete;
+} xMBRegMap;
+
+#define MB_REG_RANGES( x )              ( x ), ( sizeof( x ) / sizeof( ( x )[0] ) )
+
+/* ----------------------- Prototypes ---------------------------------------*/
+void            vMBRegMapSet( const xMBRegMap * pxMap );
+void            vMBRegCopyToFrame( UCHAR * pucFrame, const USHORT * pusRegs, USHORT usNRegs );
+void            vMBRegCopyFromFrame( USHORT * pusRegs, const UCHAR * pucFrame, USHORT usNRegs );
+void            vMBRegBitsRead( UCHAR * pucOut, const UCHAR * pucBits, USHORT usFirst, USHORT usNBits );
+void            vMBRegBitsWrite( UCHAR * pucBits, const UCHAR * pucIn, USHORT usFirst, USHORT usNBits );
+USHORT         *pusMBRegBankBegin( xMBRegBank * pxBank, USHORT usCount );
+void            vMBRegBankPublish( xMBRegBank * pxBank );
+void            vMBRegBankRead( xMBRegBank * pxBank, USHORT * pusOut, USHORT usFirst, USHORT usNRegs );
+eMBErrorCode    eMBRegMapInput( const xMBRegMap * pxMap, UCHAR * pucRegBuffer,
+                                USHORT usAddress, USHORT usNRegs );
+eMBErrorCode    eMBRegMapHolding( const xMBRegMap * pxMap, UCHAR * pucRegBuffer,
+                                  USHORT usAddress, USHORT usNRegs, eMBRegisterMode eMode );
+eMBErrorCode    eMBRegMapCoils( const xMBRegMap * pxMap, UCHAR * pucRegBuffer,
+                                USHORT usAddress, USHORT usNCoils, eMBRegisterMode eMode );
+eMBErrorCode    eMBRegMapDiscrete( const xMBRegMap * pxMap, UCHAR * pucRegBuffer,
+                                   USHORT usAddress, USHORT usNDiscrete );
+
+#endif
@@ -0,0 +1,496 @@
+/*
+ * FreeModbus Libary: Multiple RTU slaves for the STM32F103 port
+ * Copyright (C) 2026 Ken Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: mbslave.c,v 1.0 2026/10/15 Exp $
+ */
+
+/* Modbus RTU slaves on several USARTs at once.
+
+The FreeModbus stack keeps its state in globals and its port in fixed
+peripherals, so it serves one bus. This is an RTU slave whose state is all in
+a context of the application's, so there may be one on each of USART1, USART2
+and USART3, each with its own address, baud rate, RS-485 driver enable and
+register map, or with a map shared between them. As with mbmaster.c it takes
+the place of the FreeModbus stack and of port/portserial.c and porttimer.c,
+so the two are not used together. The register maps are those of mbregmap.c,
+with addresses one up from those in the frame as FreeModbus gives them, so a
+map written for the stack serves here unchanged.
+
+Each slave receives by DMA into a circular buffer and sends its response by
+DMA from its frame buffer, so a frame costs an IDLE interrupt, a timer
+callback and a transmission complete interrupt whatever its length. The IDLE
+interrupt starts a one shot timer of common/soft_timer.c for the rest of
+t3.5, so all the slaves share TIM4 with any other users of it. When the timer
+expires with nothing more received the frame is copied out of the DMA buffer
+and left for xMBSlavePoll( ), called from the main loop or a task, which
+checks it, runs the request on the register map and starts the response.
+Anything received meanwhile, such as the RS-485 echo of the response, is
+skipped. The transmission complete interrupt releases the driver enable and
+starts the next frame.
+
+Read and write coils, discrete inputs, holding and input registers are
+handled (functions 1 to 6, 15 and 16), with broadcast writes. Other functions
+are answered with an illegal function exception.
+
+DMA1 channels 5 and 4 serve USART1, 6 and 7 USART2, and 3 and 2 USART3, with
+USART1 on PA9/PA10, USART2 on PA2/PA3 and USART3 on PB10/PB11. The GPIO port
+of a driver enable pin must have its clock enabled by the application. */
+
+#include <string.h>
+
+/* ----------------------- libopencm3 STM32F includes -------------------------------*/
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/usart.h>
+#include <libopencm3/stm32/dma.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbcrc.h"
+#include "mbregmap.h"
+#include "mbslave.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_SLAVE_READ_COILS             ( 0x01 )
+#define MB_SLAVE_READ_DISCRETE          ( 0x02 )
+#define MB_SLAVE_READ_HOLDING           ( 0x03 )
+#define MB_SLAVE_READ_INPUT             ( 0x04 )
+#define MB_SLAVE_WRITE_COIL             ( 0x05 )
+#define MB_SLAVE_WRITE_REGISTER         ( 0x06 )
+#define MB_SLAVE_WRITE_COILS            ( 0x0F )
+#define MB_SLAVE_WRITE_REGISTERS        ( 0x10 )
+
+/* Largest counts of one request, which fill the frame */
+#define MB_SLAVE_READ_BITS_MAX          ( 2000 )
+#define MB_SLAVE_READ_REGS_MAX          ( 125 )
+#define MB_SLAVE_WRITE_BITS_MAX         ( 1968 )
+#define MB_SLAVE_WRITE_REGS_MAX         ( 123 )
+
+/* Bit times of one character with start, parity and stop bits */
+#define MB_SLAVE_CHAR_BITS              ( 11 )
+
+/* ----------------------- Type definitions ---------------------------------*/
+/* Peripherals of each USART */
+typedef struct
+{
+    ULONG           ulUsart;
+    enum rcc_periph_clken eClock;
+    enum rcc_periph_clken eGpioClock;
+    UCHAR           ucIrq;
+    UCHAR           ucRxChannel;
+    UCHAR           ucTxChannel;
+    ULONG           ulGpio;
+    USHORT          usTxPin;
+    USHORT          usRxPin;
+} xMBSlavePort;
+
+/* ----------------------- Static variables ---------------------------------*/
+static const xMBSlavePort xPorts[MB_SLAVE_PORTS] = {
+    { USART1, RCC_USART1, RCC_GPIOA, NVIC_USART1_IRQ, DMA_CHANNEL5, DMA_CHANNEL4,
+      GPIO_BANK_USART1_TX, GPIO_USART1_TX, GPIO_USART1_RX },
+    { USART2, RCC_USART2, RCC_GPIOA, NVIC_USART2_IRQ, DMA_CHANNEL6, DMA_CHANNEL7,
+      GPIO_BANK_USART2_TX, GPIO_USART2_TX, GPIO_USART2_RX },
+    { USART3, RCC_USART3, RCC_GPIOB, NVIC_USART3_IRQ, DMA_CHANNEL3, DMA_CHANNEL2,
+      GPIO_BANK_USART3_TX, GPIO_USART3_TX, GPIO_USART3_RX }
+};
+
+/* Slave on each USART, for its interrupt */
+static xMBSlave *pxSlaves[MB_SLAVE_PORTS];
+
+/* ----------------------- Static functions ---------------------------------*/
+static void     vMBSlaveTimerExpired( soft_timer_t * pxTimer );
+static void     vMBSlaveReceive( xMBSlave * pxSlave );
+static void     vMBSlaveSend( xMBSlave * pxSlave, USHORT usLength );
+static USHORT   usMBSlaveExecute( xMBSlave * pxSlave, UCHAR * pucPDU, USHORT usLength );
+static void     vMBSlaveUsartISR( xMBSlave * pxSlave );
+
+/* Position that the DMA will write next */
+static inline USHORT
+usMBSlaveRxPosition( const xMBSlave * pxSlave )
+{
+    UCHAR ucChannel = xPorts[pxSlave->ucPort - 1].ucRxChannel;
+    return ( USHORT )( MB_SLAVE_RX_SIZE - DMA_CNDTR( DMA1, ucChannel ) ) & ( MB_SLAVE_RX_SIZE - 1 );
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+/* Set up the USART, DMA and timer of a slave from the fields set by the
+ * application, and start receiving. Returns FALSE if the port, address or
+ * parity is not valid. */
+BOOL
+xMBSlaveInit( xMBSlave * pxSlave )
+{
+    const xMBSlavePort *pxPort;
+    ULONG ulUsart;
+    ULONG ulCharUs;
+    ULONG ulT35Us;
+
+    if( ( pxSlave->ucPort < 1 ) || ( pxSlave->ucPort > MB_SLAVE_PORTS ) ||
+        ( pxSlave->ucAddress < 1 ) || ( pxSlave->ucAddress > 247 ) ||
+        ( pxSlave->ulBaudRate == 0 ) ) return FALSE;
+    pxPort = &xPorts[pxSlave->ucPort - 1];
+    ulUsart = pxPort->ulUsart;
+
+    /* As in FreeModbus, t3.5 is fixed at 1750us above 19200 baud. The IDLE
+     * interrupt comes one character after the last byte, so the timer waits
+     * the rest. */
+    ulCharUs = ( MB_SLAVE_CHAR_BITS * 1000000UL ) / pxSlave->ulBaudRate;
+    if( pxSlave->ulBaudRate > 19200 ) ulT35Us = 1750;
+    else ulT35Us = ( 7UL * ulCharUs ) / 2;
+    pxSlave->ulFrameEndUs = ( ulT35Us > ulCharUs ) ? ulT35Us - ulCharUs : 1;
+    pxSlave->ulFrames = 0;
+    pxSlave->ulBadFrames = 0;
+    pxSlave->ulExceptions = 0;
+    pxSlave->eState = MB_SLAVE_SENDING;
+    pxSlaves[pxSlave->ucPort - 1] = pxSlave;
+
+    soft_timer_init(  );
+    soft_timer_create( &pxSlave->xTimer, vMBSlaveTimerExpired, pxSlave );
+
+    rcc_periph_clock_enable( pxPort->eGpioClock );
+    rcc_periph_clock_enable( RCC_AFIO );
+    rcc_periph_clock_enable( pxPort->eClock );
+    rcc_periph_clock_enable( RCC_DMA1 );
+    gpio_set_mode( pxPort->ulGpio, GPIO_MODE_OUTPUT_50_MHZ,
+                   GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, pxPort->usTxPin );
+    gpio_set_mode( pxPort->ulGpio, GPIO_MODE_INPUT,
+                   GPIO_CNF_INPUT_FLOAT, pxPort->usRxPin );
+    if( pxSlave->ulDEPort != 0 )
+    {
+        gpio_clear( pxSlave->ulDEPort, pxSlave->usDEPin );
+        gpio_set_mode( pxSlave->ulDEPort, GPIO_MODE_OUTPUT_50_MHZ,
+                       GPIO_CNF_OUTPUT_PUSHPULL, pxSlave->usDEPin );
+    }
+
+    /* Oddity of STM32F series: word length includes parity */
+    usart_set_baudrate( ulUsart, pxSlave->ulBaudRate );
+    usart_set_stopbits( ulUsart, USART_STOPBITS_1 );
+    usart_set_flow_control( ulUsart, USART_FLOWCONTROL_NONE );
+    usart_set_mode( ulUsart, USART_MODE_TX_RX );
+    switch ( pxSlave->eParity )
+    {
+    case MB_PAR_NONE:
+        usart_set_parity( ulUsart, USART_PARITY_NONE );
+        usart_set_databits( ulUsart, 8 );
+        break;
+    case MB_PAR_ODD:
+        usart_set_parity( ulUsart, USART_PARITY_ODD );
+        usart_set_databits( ulUsart, 9 );
+        break;
+    case MB_PAR_EVEN:
+        usart_set_parity( ulUsart, USART_PARITY_EVEN );
+        usart_set_databits( ulUsart, 9 );
+        break;
+    default:
+        return FALSE;
+    }
+
+    /* Receive runs all the time in circular mode. Transmit is set up here and
+     * started for each response. */
+    dma_channel_reset( DMA1, pxPort->ucRxChannel );
+    dma_set_peripheral_address( DMA1, pxPort->ucRxChannel, ( uint32_t )&USART_DR( ulUsart ) );
+    dma_set_memory_address( DMA1, pxPort->ucRxChannel, ( uint32_t )pxSlave->ucRxBuf );
+    dma_set_number_of_data( DMA1, pxPort->ucRxChannel, MB_SLAVE_RX_SIZE );
+    dma_set_read_from_peripheral( DMA1, pxPort->ucRxChannel );
+    dma_enable_memory_increment_mode( DMA1, pxPort->ucRxChannel );
+    dma_enable_circular_mode( DMA1, pxPort->ucRxChannel );
+    dma_set_peripheral_size( DMA1, pxPort->ucRxChannel, DMA_CCR_PSIZE_8BIT );
+    dma_set_memory_size( DMA1, pxPort->ucRxChannel, DMA_CCR_MSIZE_8BIT );
+    dma_set_priority( DMA1, pxPort->ucRxChannel, DMA_CCR_PL_HIGH );
+
+    dma_channel_reset( DMA1, pxPort->ucTxChannel );
+    dma_set_peripheral_address( DMA1, pxPort->ucTxChannel, ( uint32_t )&USART_DR( ulUsart ) );
+    dma_set_read_from_memory( DMA1, pxPort->ucTxChannel );
+    dma_enable_memory_increment_mode( DMA1, pxPort->ucTxChannel );
+    dma_set_peripheral_size( DMA1, pxPort->ucTxChannel, DMA_CCR_PSIZE_8BIT );
+    dma_set_memory_size( DMA1, pxPort->ucTxChannel, DMA_CCR_MSIZE_8BIT );
+    dma_set_priority( DMA1, pxPort->ucTxChannel, DMA_CCR_PL_MEDIUM );
+
+    usart_enable_rx_dma( ulUsart );
+    usart_enable_tx_dma( ulUsart );
+    dma_enable_channel( DMA1, pxPort->ucRxChannel );
+    usart_enable( ulUsart );
+
+    vMBSlaveReceive( pxSlave );
+    USART_CR1( ulUsart ) |= USART_CR1_IDLEIE;
+    nvic_enable_irq( pxPort->ucIrq );
+    return TRUE;
+}
+
+/* Act on a received frame, if there is one, and start the response. Returns
+ * TRUE if a request for this slave was acted on. */
+BOOL
+xMBSlavePoll( xMBSlave * pxSlave )
+{
+    UCHAR *pucFrame = pxSlave->ucFrame;
+    USHORT usLength;
+    USHORT usCRC;
+
+    if( pxSlave->eState != MB_SLAVE_FRAME ) return FALSE;
+    usLength = pxSlave->usFrameLength;
+    if( ( usLength < 4 ) || ( usMBCRC16( pucFrame, usLength ) != 0 ) )
+    {
+        pxSlave->ulBadFrames++;
+        vMBSlaveReceive( pxSlave );
+        return FALSE;
+    }
+    if( ( pucFrame[0] != pxSlave->ucAddress ) && ( pucFrame[0] != 0 ) )
+    {
+        vMBSlaveReceive( pxSlave );
+        return FALSE;
+    }
+    usLength = usMBSlaveExecute( pxSlave, &pucFrame[1], usLength - 3 );
+    pxSlave->ulFrames++;
+    /* Broadcasts are not answered */
+    if( pucFrame[0] == 0 )
+    {
+        vMBSlaveReceive( pxSlave );
+        return TRUE;
+    }
+    usLength++;
+    usCRC = usMBCRC16( pucFrame, usLength );
+    pucFrame[usLength++] = ( UCHAR )( usCRC & 0xFF );
+    pucFrame[usLength++] = ( UCHAR )( usCRC >> 8 );
+    vMBSlaveSend( pxSlave, usLength );
+    return TRUE;
+}
+
+/* Stop a slave. A response in progress is cut short. */
+void
+vMBSlaveClose( xMBSlave * pxSlave )
+{
+    const xMBSlavePort *pxPort = &xPorts[pxSlave->ucPort - 1];
+
+    nvic_disable_irq( pxPort->ucIrq );
+    soft_timer_stop( &pxSlave->xTimer );
+    usart_disable_rx_dma( pxPort->ulUsart );
+    usart_disable_tx_dma( pxPort->ulUsart );
+    dma_disable_channel( DMA1, pxPort->ucRxChannel );
+    dma_disable_channel( DMA1, pxPort->ucTxChannel );
+    usart_disable( pxPort->ulUsart );
+    if( pxSlave->ulDEPort != 0 ) gpio_clear( pxSlave->ulDEPort, pxSlave->usDEPin );
+    pxSlaves[pxSlave->ucPort - 1] = NULL;
+}
+
+/* ----------------------- Frames -----------------------------*/
+/* Start a new frame from the next byte received */
+static void
+vMBSlaveReceive( xMBSlave * pxSlave )
+{
+    pxSlave->usRxTaken = usMBSlaveRxPosition( pxSlave );
+    pxSlave->usRxSeen = pxSlave->usRxTaken;
+    pxSlave->eState = MB_SLAVE_RECEIVING;
+}
+
+/* Send the response in the frame buffer by DMA, taking the bus first */
+static void
+vMBSlaveSend( xMBSlave * pxSlave, USHORT usLength )
+{
+    const xMBSlavePort *pxPort = &xPorts[pxSlave->ucPort - 1];
+
+    pxSlave->eState = MB_SLAVE_SENDING;
+    if( pxSlave->ulDEPort != 0 ) gpio_set( pxSlave->ulDEPort, pxSlave->usDEPin );
+    dma_disable_channel( DMA1, pxPort->ucTxChannel );
+    dma_set_memory_address( DMA1, pxPort->ucTxChannel, ( uint32_t )pxSlave->ucFrame );
+    dma_set_number_of_data( DMA1, pxPort->ucTxChannel, usLength );
+    USART_SR( pxPort->ulUsart ) = ~USART_SR_TC;
+    dma_enable_channel( DMA1, pxPort->ucTxChannel );
+    USART_CR1( pxPort->ulUsart ) |= USART_CR1_TCIE;
+}
+
+/* Called from the soft timer interrupt t3.5 after the end of a burst. If
+ * more has been received since, the IDLE interrupt at its end starts the timer
+ * again. Otherwise the frame is taken. */
+static void
+vMBSlaveTimerExpired( soft_timer_t * pxTimer )
+{
+    xMBSlave *pxSlave = pxTimer->context;
+    USHORT usPosition;
+    USHORT usLength;
+    USHORT usFirst;
+
+    if( pxSlave->eState != MB_SLAVE_RECEIVING ) return;
+    usPosition = usMBSlaveRxPosition( pxSlave );
+    if( usPosition != pxSlave->usRxSeen ) return;
+    usLength = ( usPosition - pxSlave->usRxTaken ) & ( MB_SLAVE_RX_SIZE - 1 );
+    if( usLength == 0 ) return;
+    if( usLength > MB_SLAVE_FRAME_SIZE )
+    {
+        pxSlave->ulBadFrames++;
+        pxSlave->usRxTaken = usPosition;
+        return;
+    }
+    /* Copy out in up to two pieces, as the frame may wrap */
+    usFirst = MB_SLAVE_RX_SIZE - pxSlave->usRxTaken;
+    if( usFirst > usLength ) usFirst = usLength;
+    memcpy( pxSlave->ucFrame, &pxSlave->ucRxBuf[pxSlave->usRxTaken], usFirst );
+    memcpy( &pxSlave->ucFrame[usFirst], pxSlave->ucRxBuf, usLength - usFirst );
+    pxSlave->usFrameLength = usLength;
+    pxSlave->usRxTaken = usPosition;
+    pxSlave->eState = MB_SLAVE_FRAME;
+}
+
+/* ----------------------- Requests -----------------------------*/
+/* Run the request in a PDU on the register map and put the response PDU in
+ * its place. Returns the length of the response. */
+static USHORT
+usMBSlaveExecute( xMBSlave * pxSlave, UCHAR * pucPDU, USHORT usLength )
+{
+    const xMBRegMap *pxMap = pxSlave->pxRegMap;
+    eMBErrorCode eStatus = MB_ENOERR;
+    eMBException eException = MB_EX_NONE;
+    USHORT usAddress;
+    USHORT usCount;
+    USHORT usResponse = 5;
+
+    /* Addresses are one up, as the FreeModbus stack gives them */
+    usAddress = ( USHORT )( ( ( pucPDU[1] << 8 ) | pucPDU[2] ) + 1 );
+    usCount = ( USHORT )( ( pucPDU[3] << 8 ) | pucPDU[4] );
+    /* Every request handled has an address and a count or value */
+    if( usLength < 5 ) eException = MB_EX_ILLEGAL_DATA_VALUE;
+    else switch ( pucPDU[0] )
+    {
+    case MB_SLAVE_READ_COILS:
+    case MB_SLAVE_READ_DISCRETE:
+        if( ( usLength != 5 ) || ( usCount < 1 ) || ( usCount > MB_SLAVE_READ_BITS_MAX ) )
+        {
+            eException = MB_EX_ILLEGAL_DATA_VALUE;
+            break;
+        }
+        pucPDU[1] = ( UCHAR )( ( usCount + 7 ) / 8 );
+        if( pucPDU[0] == MB_SLAVE_READ_COILS )
+            eStatus = eMBRegMapCoils( pxMap, &pucPDU[2], usAddress, usCount, MB_REG_READ );
+        else
+            eStatus = eMBRegMapDiscrete( pxMap, &pucPDU[2], usAddress, usCount );
+        usResponse = 2 + pucPDU[1];
+        break;
+    case MB_SLAVE_READ_HOLDING:
+    case MB_SLAVE_READ_INPUT:
+        if( ( usLength != 5 ) || ( usCount < 1 ) || ( usCount > MB_SLAVE_READ_REGS_MAX ) )
+        {
+            eException = MB_EX_ILLEGAL_DATA_VALUE;
+            break;
+        }
+        pucPDU[1] = ( UCHAR )( usCount * 2 );
+        if( pucPDU[0] == MB_SLAVE_READ_HOLDING )
+            eStatus = eMBRegMapHolding( pxMap, &pucPDU[2], usAddress, usCount, MB_REG_READ );
+        else
+            eStatus = eMBRegMapInput( pxMap, &pucPDU[2], usAddress, usCount );
+        usResponse = 2 + pucPDU[1];
+        break;
+    case MB_SLAVE_WRITE_COIL:
+        /* The value is 0xFF00 for on and 0x0000 for off */
+        if( ( usLength != 5 ) || ( pucPDU[4] != 0 ) ||
+            ( ( pucPDU[3] != 0xFF ) && ( pucPDU[3] != 0x00 ) ) )
+        {
+            eException = MB_EX_ILLEGAL_DATA_VALUE;
+            break;
+        }
+        {
+            UCHAR ucBit = ( pucPDU[3] == 0xFF ) ? 1 : 0;
+            eStatus = eMBRegMapCoils( pxMap, &ucBit, usAddress, 1, MB_REG_WRITE );
+        }
+        break;
+    case MB_SLAVE_WRITE_REGISTER:
+        if( usLength != 5 )
+        {
+            eException = MB_EX_ILLEGAL_DATA_VALUE;
+            break;
+        }
+        eStatus = eMBRegMapHolding( pxMap, &pucPDU[3], usAddress, 1, MB_REG_WRITE );
+        break;
+    case MB_SLAVE_WRITE_COILS:
+        if( ( usLength < 7 ) || ( usCount < 1 ) || ( usCount > MB_SLAVE_WRITE_BITS_MAX ) ||
+            ( pucPDU[5] != ( usCount + 7 ) / 8 ) || ( usLength != 6 + pucPDU[5] ) )
+        {
+            eException = MB_EX_ILLEGAL_DATA_VALUE;
+            break;
+        }
+        eStatus = eMBRegMapCoils( pxMap, &pucPDU[6], usAddress, usCount, MB_REG_WRITE );
+        break;
+    case MB_SLAVE_WRITE_REGISTERS:
+        if( ( usLength < 8 ) || ( usCount < 1 ) || ( usCount > MB_SLAVE_WRITE_REGS_MAX ) ||
+            ( pucPDU[5] != usCount * 2 ) || ( usLength != 6 + pucPDU[5] ) )
+        {
+            eException = MB_EX_ILLEGAL_DATA_VALUE;
+            break;
+        }
+        eStatus = eMBRegMapHolding( pxMap, &pucPDU[6], usAddress, usCount, MB_REG_WRITE );
+        break;
+    default:
+        eException = MB_EX_ILLEGAL_FUNCTION;
+        break;
+    }
+    if( eException == MB_EX_NONE )
+    {
+        if( eStatus == MB_ENOERR ) return usResponse;
+        eException = ( eStatus == MB_ENOREG ) ? MB_EX_ILLEGAL_DATA_ADDRESS :
+                                                MB_EX_SLAVE_DEVICE_FAILURE;
+    }
+    pxSlave->ulExceptions++;
+    pucPDU[0] |= 0x80;
+    pucPDU[1] = ( UCHAR )eException;
+    return 2;
+}
+
+/* ----------------------- USART ISRs ----------------------------------*/
+/* The IDLE interrupt starts the t3.5 timer at the end of each burst, and the
+ * transmission complete interrupt ends a response. */
+static void
+vMBSlaveUsartISR( xMBSlave * pxSlave )
+{
+    ULONG ulUsart = xPorts[pxSlave->ucPort - 1].ulUsart;
+
+    /* The IDLE flag is cleared by reading the status then the data register,
+     * which the DMA has already emptied. */
+    if( ( USART_CR1( ulUsart ) & USART_CR1_IDLEIE ) &&
+        ( USART_SR( ulUsart ) & USART_SR_IDLE ) )
+    {
+        ( void )USART_DR( ulUsart );
+        if( pxSlave->eState == MB_SLAVE_RECEIVING )
+        {
+            pxSlave->usRxSeen = usMBSlaveRxPosition( pxSlave );
+            soft_timer_start( &pxSlave->xTimer, pxSlave->ulFrameEndUs, 0 );
+        }
+    }
+    if( ( USART_CR1( ulUsart ) & USART_CR1_TCIE ) &&
+        ( USART_SR( ulUsart ) & USART_SR_TC ) )
+    {
+        USART_CR1( ulUsart ) &= ~USART_CR1_TCIE;
+        if( pxSlave->ulDEPort != 0 ) gpio_clear( pxSlave->ulDEPort, pxSlave->usDEPin );
+        vMBSlaveReceive( pxSlave );
+    }
+}
+
+void
+usart1_isr( void )
+{
+    if( pxSlaves[0] != NULL ) vMBSlaveUsartISR( pxSlaves[0] );
+}
+
+void
+usart2_isr( void )
+{
+    if( pxSlaves[1] != NULL ) vMBSlaveUsartISR( pxSlaves[1] );
+}
+
+void
+usart3_isr( void )
+{
+    if( pxSlaves[2] != NULL ) vMBSlaveUsartISR( pxSlaves[2] );
+}
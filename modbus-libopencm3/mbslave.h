@@ -0,0 +1,80 @@
+/*
+ * FreeModbus Libary: Multiple RTU slaves for the STM32F103 port
+ * Copyright (C) 2026 Ken Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: mbslave.h,v 1.0 2026/10/15 Exp $
+ */
+
+#ifndef _MB_SLAVE_H
+#define _MB_SLAVE_H
+
+#include "port.h"
+#include "mb.h"
+#include "mbregmap.h"
+#include "soft_timer.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+/* USART1 to USART3 may each carry a slave */
+#define MB_SLAVE_PORTS                  ( 3 )
+
+/* Largest RTU frame */
+#define MB_SLAVE_FRAME_SIZE             ( 256 )
+
+/* DMA receive buffer of each slave, holding two frames. Size must be a power
+ * of two. */
+#define MB_SLAVE_RX_SIZE                ( 512 )
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef enum
+{
+    MB_SLAVE_RECEIVING,         /* Waiting for the end of a frame */
+    MB_SLAVE_FRAME,             /* Frame waiting for xMBSlavePoll( ) */
+    MB_SLAVE_SENDING            /* Response going out by DMA */
+} eMBSlaveState;
+
+/* One slave context. The first fields are set by the application, and the
+ * statistics may be read at any time. The rest are kept by the slave. */
+typedef struct
+{
+    UCHAR           ucPort;         /* 1 to 3 for USART1 to USART3 */
+    UCHAR           ucAddress;      /* Slave address, 1 to 247 */
+    ULONG           ulBaudRate;
+    eMBParity       eParity;
+    const xMBRegMap *pxRegMap;      /* Own map, or one shared with others */
+    ULONG           ulDEPort;       /* RS-485 driver enable, 0 for none */
+    USHORT          usDEPin;
+
+    ULONG           ulFrames;       /* Requests acted on */
+    ULONG           ulBadFrames;    /* Frames with a bad CRC or length */
+    ULONG           ulExceptions;   /* Exception responses sent */
+
+    volatile eMBSlaveState eState;
+    UCHAR           ucRxBuf[MB_SLAVE_RX_SIZE];
+    UCHAR           ucFrame[MB_SLAVE_FRAME_SIZE];
+    USHORT          usFrameLength;
+    USHORT          usRxTaken;      /* Start of the frame being received */
+    USHORT          usRxSeen;       /* DMA position at the last IDLE */
+    ULONG           ulFrameEndUs;   /* Wait from IDLE to the end of t3.5 */
+    soft_timer_t    xTimer;
+} xMBSlave;
+
+/* ----------------------- Prototypes ---------------------------------------*/
+BOOL            xMBSlaveInit( xMBSlave * pxSlave );
+BOOL            xMBSlavePoll( xMBSlave * pxSlave );
+void            vMBSlaveClose( xMBSlave * pxSlave );
+
+#endif
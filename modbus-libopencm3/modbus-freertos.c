@@ -45,6 +45,8 @@
 /* ----------------------- Modbus includes ----------------------------------*/
 #include "mb.h"
 #include "mbport.h"
+#include "mbregmap.h"
+#include "irq_priority.h"
 
 /* ----------------------- Defines ------------------------------------------*/
 #define REG_INPUT_START                 ( 1000 )
@@ -53,8 +55,16 @@
 #define REG_HOLDING_START               ( 1 )
 #define REG_HOLDING_NREGS               ( 32 )
 
+#define REG_COILS_START                 ( 1 )
+#define REG_COILS_NCOILS                ( 64 )
+
+#define REG_DISCRETE_START              ( 1 )
+#define REG_DISCRETE_NDISCRETE          ( 16 )
+
 #define TASK_MODBUS_STACK_SIZE          ( 256 )
-#define TASK_MODBUS_PRIORITY            ( tskIDLE_PRIORITY + 1 )
+/* The MODBUS task sleeps until an event arrives, and then runs ahead of the
+application so that the response time does not depend on other tasks. */
+#define TASK_MODBUS_PRIORITY            ( tskIDLE_PRIORITY + 2 )
 
 #define TASK_APPL_STACK_SIZE            ( 256 )
 #define TASK_APPL_PRIORITY              ( tskIDLE_PRIORITY + 1 )
@@ -65,24 +75,55 @@ static void     vTaskApplication( void *pvArg );
 static void     vTaskMODBUS( void *pvArg );
 
 /* ----------------------- Static variables ---------------------------------*/
-static USHORT   usRegInputStart = REG_INPUT_START;
-static USHORT   usRegInputBuf[REG_INPUT_NREGS];
-static USHORT   usRegHoldingStart = REG_HOLDING_START;
+/* Task stacks, declared here so that their RAM is fixed at link time. Only
+the task control blocks and the kernel's idle task and queue take heap. */
+static StackType_t xStackMODBUS[TASK_MODBUS_STACK_SIZE];
+static StackType_t xStackAppl[TASK_APPL_STACK_SIZE];
+
+/* Buffers to hold the register values */
+/* The input registers are updated by the application task, so are double
+buffered to be read whole by the MODBUS task. */
+static USHORT   usRegInputBuf[2][REG_INPUT_NREGS];
+static xMBRegBank xRegInputBank = { { usRegInputBuf[0], usRegInputBuf[1] }, 0 };
 static USHORT   usRegHoldingBuf[REG_HOLDING_NREGS];
+static UCHAR    ucRegCoilsBuf[( REG_COILS_NCOILS + 7 ) / 8];
+static UCHAR    ucRegDiscreteBuf[( REG_DISCRETE_NDISCRETE + 7 ) / 8];
+
+/* Register map used by the register callbacks (see mbregmap.c) */
+static const xMBRegRange xInputRanges[] = {
+    { REG_INPUT_START, REG_INPUT_NREGS, NULL, &xRegInputBank }
+};
+static const xMBRegRange xHoldingRanges[] = {
+    { REG_HOLDING_START, REG_HOLDING_NREGS, usRegHoldingBuf, NULL }
+};
+static const xMBRegRange xCoilsRanges[] = {
+    { REG_COILS_START, REG_COILS_NCOILS, ucRegCoilsBuf, NULL }
+};
+static const xMBRegRange xDiscreteRanges[] = {
+    { REG_DISCRETE_START, REG_DISCRETE_NDISCRETE, ucRegDiscreteBuf, NULL }
+};
+static const xMBRegMap xRegMap = {
+    MB_REG_RANGES( xInputRanges ),
+    MB_REG_RANGES( xHoldingRanges ),
+    MB_REG_RANGES( xCoilsRanges ),
+    MB_REG_RANGES( xDiscreteRanges )
+};
 
 /* ----------------------- Start implementation -----------------------------*/
 int
 main( void )
 {
     SetupHardware(  );
+    vMBRegMapSet( &xRegMap );
 
 /* Attempt to create xTaskMODBUS task followed by xTaskApplication task, then start scheduler */
-    if( pdPASS != xTaskCreate( vTaskMODBUS, "MODBUS", TASK_MODBUS_STACK_SIZE,
-                               NULL, TASK_MODBUS_PRIORITY, NULL ) )
+    if( pdPASS != xTaskGenericCreate( vTaskMODBUS, "MODBUS", TASK_MODBUS_STACK_SIZE,
+                               NULL, TASK_MODBUS_PRIORITY, NULL, xStackMODBUS, NULL ) )
     {
     }
-    else if( pdPASS != xTaskCreate( vTaskApplication, "APPL",
-                        TASK_APPL_STACK_SIZE, NULL, TASK_APPL_PRIORITY, NULL ) )
+    else if( pdPASS != xTaskGenericCreate( vTaskApplication, "APPL",
+                        TASK_APPL_STACK_SIZE, NULL, TASK_APPL_PRIORITY, NULL,
+                        xStackAppl, NULL ) )
     {
     }
     else
@@ -93,12 +134,19 @@ main( void )
 }
 
 /* ----------------------- Application task -----------------------------*/
-/* This just loops forever */
+/* This publishes the tick count as a 32 bit value in the first two input
+registers once a second, and a count of updates in the third. */
 static void
 vTaskApplication( void *pvArg )
 {
     for( ;; )
     {
+        portTickType xTicks = xTaskGetTickCount(  );
+        USHORT *pusRegs = pusMBRegBankBegin( &xRegInputBank, REG_INPUT_NREGS );
+        pusRegs[0] = ( USHORT )( xTicks >> 16 );
+        pusRegs[1] = ( USHORT )( xTicks & 0xFFFF );
+        pusRegs[2]++;
+        vMBRegBankPublish( &xRegInputBank );
         vTaskDelay( 1000 );
     }
 }
@@ -135,11 +183,9 @@ additional field */
                 usRegHoldingBuf[0] = 1;
                 do
                 {
-/* Calls xMBPortEventGet in (portevent.h). Loops as long as usRegHoldingBuf[0] > 0 */
+/* Calls xMBPortEventGet in (portevent-freertos.c), which blocks until an event
+arrives. Loops as long as usRegHoldingBuf[0] > 0 */
                     ( void )eMBPoll(  );
-
-                    /* Here we simply count the number of poll cycles. */
-                    usRegInputBuf[0]++;
                 }
                 while( usRegHoldingBuf[0] );
             }
@@ -154,13 +200,15 @@ additional field */
 static void
 SetupHardware( void )
 {
-    WDT_Disable(  );
-
-    uint32_t        i = 0;
-    for( i = 0; i < 35; i++ )
-    {
-        NVIC_SetPriority( ( IRQn_Type ) i, 0xF << 4 );
-    }
+/* The USART and timer ISRs post events to FreeRTOS so must be at or below the
+maximum syscall priority (see irq_priority.h). The t3.5 timer is TIM4 when it
+is a software timer. */
+    IRQ_PRIORITY_SET_RTOS( NVIC_USART1_IRQ, IRQ_LEVEL_RTOS_COMM );
+#ifdef SOFT_TIMER
+    IRQ_PRIORITY_SET_RTOS( NVIC_TIM4_IRQ, IRQ_LEVEL_RTOS_TIMER );
+#else
+    IRQ_PRIORITY_SET_RTOS( NVIC_TIM2_IRQ, IRQ_LEVEL_RTOS_TIMER );
+#endif
 }
 
 void
@@ -180,80 +228,3 @@ void
 vApplicationTickHook( void )
 {
 }
-
-
-eMBErrorCode
-eMBRegInputCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs )
-{
-    eMBErrorCode    eStatus = MB_ENOERR;
-    int             iRegIndex;
-
-    if( ( usAddress >= REG_INPUT_START ) && ( usAddress + usNRegs <= REG_INPUT_START + REG_INPUT_NREGS ) )
-    {
-        iRegIndex = ( int )( usAddress - usRegInputStart );
-        while( usNRegs > 0 )
-        {
-            *pucRegBuffer++ = ( unsigned char )( usRegInputBuf[iRegIndex] >> 8 );
-            *pucRegBuffer++ = ( unsigned char )( usRegInputBuf[iRegIndex] & 0xFF );
-            iRegIndex++;
-            usNRegs--;
-        }
-    }
-    else
-    {
-        eStatus = MB_ENOREG;
-    }
-
-    return eStatus;
-}
-
-eMBErrorCode
-eMBRegHoldingCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs, eMBRegisterMode eMode )
-{
-    eMBErrorCode    eStatus = MB_ENOERR;
-    int             iRegIndex;
-
-    if( ( usAddress >= REG_HOLDING_START ) && ( usAddress + usNRegs <= REG_HOLDING_START + REG_HOLDING_NREGS ) )
-    {
-        iRegIndex = ( int )( usAddress - usRegHoldingStart );
-        switch ( eMode )
-        {
-        case MB_REG_READ:
-            while( usNRegs > 0 )
-            {
-                *pucRegBuffer++ = ( unsigned char )( usRegHoldingBuf[iRegIndex] >> 8 );
-                *pucRegBuffer++ = ( unsigned char )( usRegHoldingBuf[iRegIndex] & 0xFF );
-                iRegIndex++;
-                usNRegs--;
-            }
-            break;
-
-        case MB_REG_WRITE:
-            while( usNRegs > 0 )
-            {
-                usRegHoldingBuf[iRegIndex] = *pucRegBuffer++ << 8;
-                usRegHoldingBuf[iRegIndex] |= *pucRegBuffer++;
-                iRegIndex++;
-                usNRegs--;
-            }
-        }
-    }
-    else
-    {
-        eStatus = MB_ENOREG;
-    }
-    return eStatus;
-}
-
-
-eMBErrorCode
-eMBRegCoilsCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNCoils, eMBRegisterMode eMode )
-{
-    return MB_ENOREG;
-}
-
-eMBErrorCode
-eMBRegDiscreteCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNDiscrete )
-{
-    return MB_ENOREG;
-}
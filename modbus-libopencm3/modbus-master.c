@@ -0,0 +1,106 @@
+/*      A test program for the Modbus RTU master on libopencm3
+
+Polls four slaves at addresses 10 to 13 at 38400 baud, even parity, reading
+their four input registers from 1000 and writing back the first of them as
+the setpoint in holding register 1. The transactions are worked through from
+interrupts by mbmaster.c, and the main loop only takes coherent copies of the
+results with eMBMasterResult.
+
+*/
+
+/*
+ * FreeModbus Libary: Modbus RTU master example for the STM32F103
+ * Copyright (C) 2026 Ken Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: modbus-master.c,v 1.0 2026/10/14 Exp $
+ */
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include <mb.h>
+#include <mbport.h>
+#include "mbmaster.h"
+#include "stm32f1.h"
+
+/* Prototypes */
+void setupHardware( void );
+
+/* ----------------------- Defines ------------------------------------------*/
+#define NSLAVES                         4
+#define SLAVE_FIRST                     10
+#define REG_INPUT_START                 1000
+#define REG_INPUT_NREGS                 4
+#define REG_HOLDING_START               1
+#define TIMEOUT_MS                      20
+#define RETRIES                         1
+
+/* ----------------------- Static variables ---------------------------------*/
+static USHORT   usInput[NSLAVES][REG_INPUT_NREGS];
+static USHORT   usSetpoint[NSLAVES];
+static xMBMasterTransaction xSchedule[2*NSLAVES];
+
+/* ----------------------- Start implementation -----------------------------*/
+/* Read the input registers of each slave and write a setpoint to its first
+holding register, continuously. */
+int
+main( void )
+{
+    USHORT i;
+    USHORT usValues[REG_INPUT_NREGS];
+
+    setupHardware();
+
+    for( i = 0; i < NSLAVES; i++ )
+    {
+        xMBMasterTransaction *pxRead = &xSchedule[2*i];
+        xMBMasterTransaction *pxWrite = &xSchedule[2*i+1];
+        pxRead->ucSlave = SLAVE_FIRST + i;
+        pxRead->ucFunction = MB_MASTER_READ_INPUT;
+        pxRead->usAddress = REG_INPUT_START;
+        pxRead->usCount = REG_INPUT_NREGS;
+        pxRead->pvData = usInput[i];
+        pxRead->usTimeoutMs = TIMEOUT_MS;
+        pxRead->ucRetries = RETRIES;
+        pxWrite->ucSlave = SLAVE_FIRST + i;
+        pxWrite->ucFunction = MB_MASTER_WRITE_REGISTER;
+        pxWrite->usAddress = REG_HOLDING_START;
+        pxWrite->usCount = 1;
+        pxWrite->pvData = &usSetpoint[i];
+        pxWrite->usTimeoutMs = TIMEOUT_MS;
+        pxWrite->ucRetries = RETRIES;
+    }
+
+    if( !xMBMasterInit( 38400, MB_PAR_EVEN, xSchedule, 2*NSLAVES ) )
+    {
+        /* Can not initialize. Add error handling code here. */
+        for( ;; );
+    }
+    vMBMasterStart(  );
+
+    for( ;; )
+    {
+        /* The master runs from interrupts. Here the setpoint of each slave
+        follows the first input register read from it. */
+        for( i = 0; i < NSLAVES; i++ )
+        {
+            if( eMBMasterResult( &xSchedule[2*i], usValues, sizeof( usValues ) ) == MB_MASTER_OK )
+            {
+                usSetpoint[i] = usValues[0];
+            }
+        }
+        __asm__ __volatile__( "wfi" );
+    }
+}
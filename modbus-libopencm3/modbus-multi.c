@@ -0,0 +1,111 @@
+/*      A test program for two Modbus RTU slaves on libopencm3
+
+*/
+
+/*
+ * FreeModbus Libary: STM32F103 over FREERTOS
+ * Copyright (C) 2026 Ken Sarkies <ksarkies@internode.on.net>
+ * Copyright (C) 2006 Christian Walter <wolti@sil.at>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: modbus-multi.c,v 1.0 2026/10/15 Exp $
+ */
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include <mb.h>
+#include "mbregmap.h"
+#include "mbslave.h"
+#include "stm32f1.h"
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
+
+/* ----------------------- Defines ------------------------------------------*/
+#define REG_INPUT_START                 1000
+#define REG_INPUT_NREGS                 4
+#define REG_HOLDING_START               1
+#define REG_HOLDING_NREGS               32
+#define REG_COILS_START                 1
+#define REG_COILS_NCOILS                64
+/* The HMI sees only the first holding registers, as setpoints */
+#define REG_HMI_HOLDING_NREGS           8
+
+/* ----------------------- Static variables ---------------------------------*/
+static USHORT   usRegInputBuf[REG_INPUT_NREGS];
+static USHORT   usRegHoldingBuf[REG_HOLDING_NREGS];
+static UCHAR    ucRegCoilsBuf[( REG_COILS_NCOILS + 7 ) / 8];
+
+/* The SCADA master has the whole map */
+static const xMBRegRange xInputRanges[] = {
+    { REG_INPUT_START, REG_INPUT_NREGS, usRegInputBuf, NULL }
+};
+static const xMBRegRange xHoldingRanges[] = {
+    { REG_HOLDING_START, REG_HOLDING_NREGS, usRegHoldingBuf, NULL }
+};
+static const xMBRegRange xCoilsRanges[] = {
+    { REG_COILS_START, REG_COILS_NCOILS, ucRegCoilsBuf, NULL }
+};
+static const xMBRegMap xScadaMap = {
+    MB_REG_RANGES( xInputRanges ),
+    MB_REG_RANGES( xHoldingRanges ),
+    MB_REG_RANGES( xCoilsRanges ),
+    NULL, 0
+};
+
+/* The HMI has the same input registers and part of the same holding registers */
+static const xMBRegRange xHmiHoldingRanges[] = {
+    { REG_HOLDING_START, REG_HMI_HOLDING_NREGS, usRegHoldingBuf, NULL }
+};
+static const xMBRegMap xHmiMap = {
+    MB_REG_RANGES( xInputRanges ),
+    MB_REG_RANGES( xHmiHoldingRanges ),
+    NULL, 0,
+    NULL, 0
+};
+
+/* SCADA on USART1 over RS-485 with the driver enable on PA8, and the HMI on
+ * USART2 */
+static xMBSlave xScada = {
+    .ucPort = 1, .ucAddress = 0x0A, .ulBaudRate = 38400, .eParity = MB_PAR_EVEN,
+    .pxRegMap = &xScadaMap, .ulDEPort = GPIOA, .usDEPin = GPIO8
+};
+static xMBSlave xHmi = {
+    .ucPort = 2, .ucAddress = 0x01, .ulBaudRate = 19200, .eParity = MB_PAR_EVEN,
+    .pxRegMap = &xHmiMap, .ulDEPort = 0
+};
+
+/* ----------------------- Start implementation -----------------------------*/
+/* Both buses are served from one loop. Input register 1000 counts the
+requests of the SCADA master and 1001 those of the HMI. */
+int
+main( void )
+{
+    setupHardware();
+    rcc_periph_clock_enable( RCC_GPIOA );
+
+    if( !xMBSlaveInit( &xScada ) || !xMBSlaveInit( &xHmi ) )
+    {
+        /* Can not initialize. Add error handling code here. */
+        for( ;; );
+    }
+    for( ;; )
+    {
+        if( xMBSlavePoll( &xScada ) ) usRegInputBuf[0]++;
+        if( xMBSlavePoll( &xHmi ) ) usRegInputBuf[1]++;
+        usRegInputBuf[2] = ( USHORT )( xScada.ulBadFrames + xHmi.ulBadFrames );
+        usRegInputBuf[3] = ( USHORT )( xScada.ulExceptions + xHmi.ulExceptions );
+    }
+	return -1;
+}
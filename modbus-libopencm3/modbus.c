@@ -27,6 +27,10 @@
 /* ----------------------- Modbus includes ----------------------------------*/
 #include <mb.h>
 #include <mbport.h>
+#include "mbregmap.h"
+#if MB_PORT_LATENCY
+#include "mblatency.h"
+#endif
 #include "stm32f1.h"
 #include <libopencm3/stm32/gpio.h>
 
@@ -40,19 +44,56 @@ void setupHardware( void );
 #define REG_INPUT_NREGS 				4
 #define REG_HOLDING_START               1
 #define REG_HOLDING_NREGS               32
+#define REG_COILS_START                 1
+#define REG_COILS_NCOILS                64
+#define REG_DISCRETE_START              1
+#define REG_DISCRETE_NDISCRETE          16
+/* Latency statistics, and the holding register that resets them */
+#define REG_LATENCY_START               2000
+#define REG_HOLDING_LATENCY_RESET       1
 
 /* ----------------------- Static variables ---------------------------------*/
-static USHORT   usRegInputStart = REG_INPUT_START;
-/* Buffer to hold the register values */
+/* Buffers to hold the register values */
 static USHORT   usRegInputBuf[REG_INPUT_NREGS];
-static USHORT   usRegHoldingStart = REG_HOLDING_START;
 static USHORT   usRegHoldingBuf[REG_HOLDING_NREGS];
+static UCHAR    ucRegCoilsBuf[( REG_COILS_NCOILS + 7 ) / 8];
+static UCHAR    ucRegDiscreteBuf[( REG_DISCRETE_NDISCRETE + 7 ) / 8];
+#if MB_PORT_LATENCY
+static USHORT   usRegLatencyBuf[MB_LATENCY_NREGS];
+#endif
+
+/* Register map used by the register callbacks (see mbregmap.c) */
+static const xMBRegRange xInputRanges[] = {
+    { REG_INPUT_START, REG_INPUT_NREGS, usRegInputBuf, NULL },
+#if MB_PORT_LATENCY
+    { REG_LATENCY_START, MB_LATENCY_NREGS, usRegLatencyBuf, NULL }
+#endif
+};
+static const xMBRegRange xHoldingRanges[] = {
+    { REG_HOLDING_START, REG_HOLDING_NREGS, usRegHoldingBuf, NULL }
+};
+static const xMBRegRange xCoilsRanges[] = {
+    { REG_COILS_START, REG_COILS_NCOILS, ucRegCoilsBuf, NULL }
+};
+static const xMBRegRange xDiscreteRanges[] = {
+    { REG_DISCRETE_START, REG_DISCRETE_NDISCRETE, ucRegDiscreteBuf, NULL }
+};
+static const xMBRegMap xRegMap = {
+    MB_REG_RANGES( xInputRanges ),
+    MB_REG_RANGES( xHoldingRanges ),
+    MB_REG_RANGES( xCoilsRanges ),
+    MB_REG_RANGES( xDiscreteRanges )
+};
 
 /* ----------------------- Start implementation -----------------------------*/
 int
 main( void )
 {
     setupHardware();
+    vMBRegMapSet( &xRegMap );
+#if MB_PORT_LATENCY
+    vMBLatencyInit(  );
+#endif
 
     const UCHAR     ucSlaveID[] = { 0xAA, 0xBB, 0xCC };
     eMBErrorCode    eStatus;
@@ -81,6 +122,14 @@ main( void )
                     eMBPoll(  );
                     /* Here we simply count the number of poll cycles. */
                     usRegInputBuf[0]++;
+#if MB_PORT_LATENCY
+                    if( usRegHoldingBuf[REG_HOLDING_LATENCY_RESET] )
+                    {
+                        vMBLatencyReset(  );
+                        usRegHoldingBuf[REG_HOLDING_LATENCY_RESET] = 0;
+                    }
+                    vMBLatencyUpdate( usRegLatencyBuf );
+#endif
                 }
                 while( usRegHoldingBuf[0] );
                 eMBDisable(  );
@@ -90,113 +139,3 @@ main( void )
     }
 	return -1;
 }
-
-/* ----------------------- Get values of registers -----------------------------*/
-
-/* Callback function used if the value of a Input Register is required by the
-protocol stack.
-The starting register address is given by usAddress and the last register is given by
-usAddress + usNRegs - 1. */
-
-eMBErrorCode
-eMBRegInputCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs )
-{
-    eMBErrorCode    eStatus = MB_ENOERR;
-    int             iRegIndex;
-
-    if( ( usAddress >= REG_INPUT_START )
-        && ( usAddress + usNRegs <= REG_INPUT_START + REG_INPUT_NREGS ) )
-    {
-		gpio_toggle(GPIOB, GPIO8);
-        iRegIndex = ( int )( usAddress - usRegInputStart );
-        while( usNRegs > 0 )
-        {
-            *pucRegBuffer++ =
-                ( unsigned char )( usRegInputBuf[iRegIndex] >> 8 );
-            *pucRegBuffer++ =
-                ( unsigned char )( usRegInputBuf[iRegIndex] & 0xFF );
-            iRegIndex++;
-            usNRegs--;
-        }
-    }
-    else
-    {
-		gpio_toggle(GPIOB, GPIO9);
-        eStatus = MB_ENOREG;
-    }
-
-    return eStatus;
-}
-
-/* ----------------------- Get from holding registers -----------------------------*/
-
-/* Callback function used if an output Holding Register value is read or written by the
-protocol stack.
-The starting register address is given by usAddress and the last register is given by
-usAddress + usNRegs - 1.  */
-
-eMBErrorCode
-eMBRegHoldingCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs,
-                 eMBRegisterMode eMode )
-{
-    eMBErrorCode    eStatus = MB_ENOERR;
-    int             iRegIndex;
-
-    if( ( usAddress >= REG_HOLDING_START ) && ( usAddress + usNRegs <= REG_HOLDING_START + REG_HOLDING_NREGS ) )
-    {
-        iRegIndex = ( int )( usAddress - usRegHoldingStart );
-        switch ( eMode )
-        {
-        case MB_REG_READ:
-            while( usNRegs > 0 )
-            {
-                *pucRegBuffer++ = ( unsigned char )( usRegHoldingBuf[iRegIndex] >> 8 );
-                *pucRegBuffer++ = ( unsigned char )( usRegHoldingBuf[iRegIndex] & 0xFF );
-                iRegIndex++;
-                usNRegs--;
-            }
-            break;
-
-        case MB_REG_WRITE:
-            while( usNRegs > 0 )
-            {
-                usRegHoldingBuf[iRegIndex] = *pucRegBuffer++ << 8;
-                usRegHoldingBuf[iRegIndex] |= *pucRegBuffer++;
-                iRegIndex++;
-                usNRegs--;
-            }
-        }
-    }
-    else
-    {
-        eStatus = MB_ENOREG;
-    }
-    return eStatus;
-}
-
-/* ----------------------- Get/Put from Coil Register bits-----------------------------*/
-
-/* Callback function used if a Coil Register value is read or written by the
-protocol stack.
-The starting register address is given by usAddress and the last register is given by
-usAddress + usNRegs - 1.  */
-
-eMBErrorCode
-eMBRegCoilsCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNCoils,
-               eMBRegisterMode eMode )
-{
-    return MB_ENOREG;
-}
-
-/* ----------------------- Get from Input Discrete Register bits-----------------------------*/
-
-/* Callback function used if an Input Discrete Register value is read by the
-protocol stack.
-The starting register address is given by usAddress and the last register is given by
-usAddress + usNRegs - 1.  */
-
-eMBErrorCode
-eMBRegDiscreteCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNDiscrete )
-{
-    return MB_ENOREG;
-}
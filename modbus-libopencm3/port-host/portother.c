@@ -0,0 +1,53 @@
+/*
+ * FreeModbus Libary: Host Port
+ * Copyright (C) 2006 Christian Walter <wolti@sil.at>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: portother.c,v 1.0 2026/10/15 Exp $
+ */
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+
+/* ----------------------- Critical Section handler -------------------------*/
+/* The fake interrupt handlers are only called between steps of the test, never
+ * in the middle of the protocol stack, so there is nothing to mask. The
+ * nesting is still counted so that an unbalanced exit is caught. */
+static ULONG    ulNesting;
+
+void
+vMBPortEnterCritical( void )
+{
+    ulNesting++;
+}
+
+void
+vMBPortExitCritical( void )
+{
+    assert( ulNesting > 0 );
+    ulNesting--;
+}
+
+/* ----------------------- Close Ports --------------------------------------*/
+void
+vMBPortClose( void )
+{
+    extern void vMBPortSerialClose( void );
+    extern void vMBPortTimersDisable( void );
+    vMBPortSerialClose(  );
+    vMBPortTimersDisable(  );
+}
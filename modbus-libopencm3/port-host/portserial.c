@@ -0,0 +1,101 @@
+/*
+ * FreeModbus Libary: Host Port
+ * Copyright (C) 2006 Christian Walter <wolti@sil.at>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: portserial.c,v 1.0 2026/10/15 Exp $
+ */
+
+/* The USART is the fake of host/fake_periph.c. Its receive and transmit
+ * handlers stand in for the RXNE and TXE interrupts, one byte per call, and
+ * run when the test calls fake_usart_service( ). The latency instrumentation
+ * needs the DWT cycle counter and is not available here. */
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+#include "fake_periph.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+
+/* ----------------------- static functions ---------------------------------*/
+static void     prvvUARTTxReadyISR( void );
+static void     prvvUARTRxISR( void );
+
+/* ----------------------- Start implementation -----------------------------*/
+void
+vMBPortSerialEnable( BOOL xRxEnable, BOOL xTxEnable )
+{
+    fake_usart_enable( xRxEnable, xTxEnable );
+}
+
+BOOL
+xMBPortSerialInit( UCHAR ucPORT, ULONG ulBaudRate, UCHAR ucDataBits, eMBParity eParity )
+{
+    ( void )ucPORT;
+    ( void )ulBaudRate;
+    ( void )eParity;
+    if( ( ucDataBits != 7 ) && ( ucDataBits != 8 ) )
+    {
+        return FALSE;
+    }
+    fake_usart_attach( prvvUARTRxISR, prvvUARTTxReadyISR );
+    return TRUE;
+}
+
+/* Bytes are passed on as they arrive, so there are none held back. */
+BOOL
+xMBPortSerialRxDrain( void )
+{
+    return FALSE;
+}
+
+BOOL
+xMBPortSerialPutByte( CHAR ucByte )
+{
+    fake_usart_send( ( UCHAR )ucByte );
+    return TRUE;
+}
+
+BOOL
+xMBPortSerialGetByte( CHAR * pucByte )
+{
+    UCHAR           ucByte = 0;
+
+    ( void )fake_usart_recv( &ucByte );
+    *pucByte = ( CHAR )ucByte;
+    return TRUE;
+}
+
+void
+vMBPortSerialClose( void )
+{
+    fake_usart_enable( FALSE, FALSE );
+}
+
+/* ----------------------- Interrupt handlers -------------------------------*/
+static void
+prvvUARTTxReadyISR( void )
+{
+    pxMBFrameCBTransmitterEmpty(  );
+}
+
+static void
+prvvUARTRxISR( void )
+{
+    pxMBFrameCBByteReceived(  );
+}
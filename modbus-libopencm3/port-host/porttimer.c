@@ -0,0 +1,79 @@
+/*
+ * FreeModbus Libary: Host Port
+ * Copyright (C) 2006 Christian Walter <wolti@sil.at>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: porttimer.c,v 1.0 2026/10/15 Exp $
+ */
+
+/* The timeouts are one shot timers of host/fake_periph.c on the virtual
+ * clock, which the test moves on with fake_clock_advance( ) or straight to the
+ * end of the t3.5 gap with fake_clock_expire_next( ). */
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+#include "fake_periph.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+
+/* ----------------------- static variables ---------------------------------*/
+static USHORT   usTimeout;
+
+/* ----------------------- static functions ---------------------------------*/
+static void     prvvTimerExpired( void );
+
+/* ----------------------- Start implementation -----------------------------*/
+BOOL
+xMBPortTimersInit( USHORT usTim1Timerout50us )
+{
+    usTimeout = usTim1Timerout50us;
+    return TRUE;
+}
+
+void
+vMBPortTimersEnable( void )
+{
+    fake_timer_start( FAKE_TIMER_MODBUS, ( ULONG )usTimeout * 50, prvvTimerExpired );
+}
+
+/* Start the timer for a given time, as for the RTU response timeout of the
+ * master. */
+void
+vMBPortTimersSet( USHORT usTimeout50us )
+{
+    fake_timer_start( FAKE_TIMER_MODBUS, ( ULONG )usTimeout50us * 50, prvvTimerExpired );
+}
+
+void
+vMBPortTimersDisable( void )
+{
+    fake_timer_stop( FAKE_TIMER_MODBUS );
+}
+
+void
+vMBPortTimersDelay( USHORT usTimeOutMS )
+{
+    fake_clock_advance( ( ULONG )usTimeOutMS * 1000 );
+}
+
+/* ----------------------- Timer expiry -------------------------------------*/
+static void
+prvvTimerExpired( void )
+{
+    ( void )pxMBPortCBTimerExpired(  );
+}
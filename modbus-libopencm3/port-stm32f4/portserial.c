@@ -0,0 +1,387 @@
+/*
+ * FreeModbus Libary: STM32F4 Port
+ * Copyright (C) 2006 Christian Walter <wolti@sil.at>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: portserial.c,v 1.0 2026/10/14 Exp $
+ */
+
+/* ----------------------- Platform includes --------------------------------*/
+#include <stdlib.h>
+#include "port.h"
+
+/* ----------------------- libopencm3 STM32F4 includes -------------------------------*/
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/usart.h>
+#include <libopencm3/stm32/dma.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+
+/* ----------------------- DMA stream assignment ------------------------------*/
+/* USART1 RX is DMA2 stream 5 and TX is DMA2 stream 7, both on channel 4. */
+#define RX_DMA_STREAM   DMA_STREAM5
+#define TX_DMA_STREAM   DMA_STREAM7
+#define USART1_DMA_CHAN DMA_SxCR_CHSEL_4
+
+/* ----------------------- DMA receive buffer -------------------------------*/
+#if MB_PORT_RX_DMA
+/* The stream runs in circular mode. The buffer holds two maximum length RTU
+ * frames so that a frame can be taken while the next one arrives. Size must be
+ * a power of two. */
+#define RX_DMA_SIZE     512
+static volatile UCHAR ucRxDMABuf[RX_DMA_SIZE];
+/* Index of the next byte to hand to the protocol stack */
+static USHORT usRxTaken;
+
+static void vMBPortSerialRxDMASetup( void );
+
+/* Position that the DMA will write next */
+static inline USHORT
+usRxDMAPosition( void )
+{
+    return ( USHORT )( RX_DMA_SIZE - DMA_SNDTR( DMA2, RX_DMA_STREAM ) ) & ( RX_DMA_SIZE - 1 );
+}
+#endif
+
+/* ----------------------- DMA transmit buffer ------------------------------*/
+/* When transmission is enabled the whole frame is taken from the protocol
+ * stack at once, by calling pxMBFrameCBTransmitterEmpty( ) until the stack
+ * turns the transmitter off again, and is then sent by DMA with no further
+ * interrupts. The buffer takes the longest ASCII frame. */
+#define TX_DMA_SIZE     516
+static UCHAR ucTxDMABuf[TX_DMA_SIZE];
+static USHORT usTxCount;
+static volatile BOOL xTxCollecting;
+
+static void vMBPortSerialTxDMAStart( void );
+
+/* ----------------------- Enable USART interrupts -----------------------------*/
+void
+vMBPortSerialEnable( BOOL xRxEnable, BOOL xTxEnable )
+{
+    USHORT usCalls;
+
+    /* If xRXEnable enable serial receive interrupts. If xTxENable take the
+     * frame from the protocol stack and send it.
+     */
+#if MB_PORT_RX_DMA
+    /* The DMA runs all the time. Anything received while the receiver is
+     * disabled (such as an RS-485 echo of our own transmission) is skipped,
+     * and the IDLE interrupt marks the end of each burst. */
+    if( xRxEnable )
+    {
+        usRxTaken = usRxDMAPosition(  );
+		USART_CR1(USART1) |= USART_CR1_IDLEIE;
+    }
+    else
+    {
+		USART_CR1(USART1) &= ~USART_CR1_IDLEIE;
+    }
+#else
+    if( xRxEnable )
+    {
+		usart_enable_rx_interrupt(USART1);
+    }
+    else
+    {
+		usart_disable_rx_interrupt(USART1);
+    }
+#endif
+
+    if( xTxEnable )
+    {
+        /* A previous frame may still be going out of the buffer. */
+		while (DMA_SCR(DMA2, TX_DMA_STREAM) & DMA_SxCR_EN);
+#if MB_PORT_RS485
+        /* Take the bus before the first byte goes */
+		USART_CR1(USART1) &= ~USART_CR1_TCIE;
+		gpio_set(MB_PORT_RS485_DE_PORT, MB_PORT_RS485_DE_PIN);
+#endif
+        /* The protocol stack ends the frame by calling back here with the
+         * transmitter disabled, which starts the DMA. */
+        usTxCount = 0;
+        xTxCollecting = TRUE;
+        for( usCalls = 0; xTxCollecting && ( usCalls <= TX_DMA_SIZE ); usCalls++ )
+        {
+            pxMBFrameCBTransmitterEmpty(  );
+        }
+        /* Send what there is if the stack did not end the frame */
+        if( xTxCollecting )
+        {
+            xTxCollecting = FALSE;
+            vMBPortSerialTxDMAStart(  );
+        }
+    }
+    else if( xTxCollecting )
+    {
+        xTxCollecting = FALSE;
+        vMBPortSerialTxDMAStart(  );
+    }
+}
+
+/* ----------------------- Initialize USART ----------------------------------*/
+/* Called with databits = 8 for RTU. The baud rate is derived from the APB2
+ * clock (84MHz at a 168MHz system clock), which gives rates up to 921600 baud.
+ * The divider of 91 sixteenths at 921600 is 0.16% fast, well inside the
+ * tolerance of the receiver. */
+
+BOOL
+xMBPortSerialInit( UCHAR ucPORT, ULONG ulBaudRate, UCHAR ucDataBits, eMBParity eParity )
+{
+BOOL bStatus;
+	/* Enable clocks for GPIO port A (for USART1 TX and RX), USART1 and DMA2. */
+	rcc_periph_clock_enable(RCC_GPIOA);
+	rcc_periph_clock_enable(RCC_USART1);
+	rcc_peripheral_enable_clock(&RCC_AHB1ENR, RCC_AHB1ENR_DMA2EN);
+	/* Setup PA9 (TX) and PA10 (RX) as alternate function 7 for USART1. */
+	gpio_mode_setup(GPIOA, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO9 | GPIO10);
+	gpio_set_output_options(GPIOA, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO9);
+	gpio_set_af(GPIOA, GPIO_AF7, GPIO9 | GPIO10);
+#if MB_PORT_RS485
+	/* Setup the RS-485 driver enable pin, in receive. */
+	rcc_periph_clock_enable(MB_PORT_RS485_DE_RCC);
+	gpio_clear(MB_PORT_RS485_DE_PORT, MB_PORT_RS485_DE_PIN);
+	gpio_mode_setup(MB_PORT_RS485_DE_PORT, GPIO_MODE_OUTPUT,
+			GPIO_PUPD_NONE, MB_PORT_RS485_DE_PIN);
+	gpio_set_output_options(MB_PORT_RS485_DE_PORT, GPIO_OTYPE_PP,
+				GPIO_OSPEED_50MHZ, MB_PORT_RS485_DE_PIN);
+#endif
+	/* Enable the USART1 interrupt. */
+	nvic_enable_irq(NVIC_USART1_IRQ);
+	/* Setup UART parameters. */
+	usart_set_baudrate(USART1, ulBaudRate);
+	usart_set_stopbits(USART1, USART_STOPBITS_1);
+	usart_set_flow_control(USART1, USART_FLOWCONTROL_NONE);
+	usart_set_mode(USART1, USART_MODE_TX_RX);
+    bStatus = TRUE;
+    switch ( eParity )
+    {
+    case MB_PAR_NONE:
+        usart_set_parity(USART1, USART_PARITY_NONE);
+        break;
+    case MB_PAR_ODD:
+        usart_set_parity(USART1, USART_PARITY_ODD);
+        break;
+    case MB_PAR_EVEN:
+        usart_set_parity(USART1, USART_PARITY_EVEN);
+        break;
+    default:
+        bStatus = FALSE;
+        break;
+    }
+
+/* Oddity of STM32F series: word length includes parity. 7 bits no parity
+   not possible */
+CHAR wordLength;
+    switch ( ucDataBits )
+    {
+    case 8:
+		if (eParity == MB_PAR_NONE)
+			wordLength = 8;
+		else
+			wordLength = 9;
+        usart_set_databits(USART1,wordLength);
+        break;
+    case 7:
+		if (eParity == MB_PAR_NONE)
+			bStatus = FALSE;
+		else
+        	usart_set_databits(USART1,8);
+        break;
+    default:
+        bStatus = FALSE;
+    }
+
+    if( bStatus == TRUE )
+    {
+		/* Finally enable the USART. */
+		usart_disable_rx_interrupt(USART1);
+		usart_disable_tx_interrupt(USART1);
+		usart_enable(USART1);
+		/* Setup DMA transmit. The stream is started for each frame. */
+		dma_stream_reset(DMA2, TX_DMA_STREAM);
+		dma_channel_select(DMA2, TX_DMA_STREAM, USART1_DMA_CHAN);
+		dma_set_transfer_mode(DMA2, TX_DMA_STREAM, DMA_SxCR_DIR_MEM_TO_PERIPHERAL);
+		dma_set_peripheral_address(DMA2, TX_DMA_STREAM, (uint32_t) &USART1_DR);
+		dma_enable_memory_increment_mode(DMA2, TX_DMA_STREAM);
+		dma_set_peripheral_size(DMA2, TX_DMA_STREAM, DMA_SxCR_PSIZE_8BIT);
+		dma_set_memory_size(DMA2, TX_DMA_STREAM, DMA_SxCR_MSIZE_8BIT);
+		dma_set_priority(DMA2, TX_DMA_STREAM, DMA_SxCR_PL_MEDIUM);
+		usart_enable_tx_dma(USART1);
+		xTxCollecting = FALSE;
+#if MB_PORT_RX_DMA
+		vMBPortSerialRxDMASetup(  );
+#endif
+    }
+    return bStatus;
+}
+
+/* ----------------------- Start DMA transmit ---------------------------------*/
+static void
+vMBPortSerialTxDMAStart( void )
+{
+	if (usTxCount == 0)
+	{
+#if MB_PORT_RS485
+		gpio_clear(MB_PORT_RS485_DE_PORT, MB_PORT_RS485_DE_PIN);
+#endif
+		return;
+	}
+	dma_clear_interrupt_flags(DMA2, TX_DMA_STREAM, DMA_TCIF | DMA_HTIF |
+				  DMA_TEIF | DMA_DMEIF | DMA_FEIF);
+	dma_set_memory_address(DMA2, TX_DMA_STREAM, (uint32_t) ucTxDMABuf);
+	dma_set_number_of_data(DMA2, TX_DMA_STREAM, usTxCount);
+#if MB_PORT_RS485 || MB_PORT_LATENCY
+	/* TC is only set again when the last byte has gone, since the DMA fills
+	 * the data register before the shift register empties. Release the bus
+	 * from that interrupt. */
+	USART_SR(USART1) &= ~USART_SR_TC;
+	USART_CR1(USART1) |= USART_CR1_TCIE;
+#endif
+	dma_enable_stream(DMA2, TX_DMA_STREAM);
+}
+
+#if MB_PORT_RX_DMA
+/* ----------------------- Setup DMA receive ----------------------------------*/
+static void
+vMBPortSerialRxDMASetup( void )
+{
+	dma_stream_reset(DMA2, RX_DMA_STREAM);
+	dma_channel_select(DMA2, RX_DMA_STREAM, USART1_DMA_CHAN);
+	dma_set_transfer_mode(DMA2, RX_DMA_STREAM, DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+	dma_set_peripheral_address(DMA2, RX_DMA_STREAM, (uint32_t) &USART1_DR);
+	dma_set_memory_address(DMA2, RX_DMA_STREAM, (uint32_t) ucRxDMABuf);
+	dma_set_number_of_data(DMA2, RX_DMA_STREAM, RX_DMA_SIZE);
+	dma_enable_memory_increment_mode(DMA2, RX_DMA_STREAM);
+	dma_enable_circular_mode(DMA2, RX_DMA_STREAM);
+	dma_set_peripheral_size(DMA2, RX_DMA_STREAM, DMA_SxCR_PSIZE_8BIT);
+	dma_set_memory_size(DMA2, RX_DMA_STREAM, DMA_SxCR_MSIZE_8BIT);
+	dma_set_priority(DMA2, RX_DMA_STREAM, DMA_SxCR_PL_HIGH);
+	usRxTaken = 0;
+	usart_enable_rx_dma(USART1);
+	dma_enable_stream(DMA2, RX_DMA_STREAM);
+}
+
+/* ----------------------- Pass received bytes on ----------------------------*/
+/* Hand every byte the DMA has received to the protocol stack, as in the F1
+ * port. Called from the USART IDLE interrupt and from the timer ISR. Nothing
+ * is passed on while the receiver is disabled. Returns TRUE if there were any
+ * bytes.
+ */
+BOOL
+xMBPortSerialRxDrain( void )
+{
+    BOOL xReceived = FALSE;
+    if( ( USART_CR1(USART1) & USART_CR1_IDLEIE ) == 0 ) return FALSE;
+    while( usRxTaken != usRxDMAPosition(  ) )
+    {
+        pxMBFrameCBByteReceived(  );
+        xReceived = TRUE;
+    }
+    return xReceived;
+}
+#else
+BOOL
+xMBPortSerialRxDrain( void )
+{
+    return FALSE;
+}
+#endif
+
+/* -----------------------Send character  ----------------------------------*/
+BOOL
+xMBPortSerialPutByte( CHAR ucByte )
+{
+    /* Put a byte in the transmit buffer. This function is called by the
+     * protocol stack if pxMBFrameCBTransmitterEmpty( ) has been called. */
+    if( usTxCount >= TX_DMA_SIZE ) return FALSE;
+	ucTxDMABuf[usTxCount++] = (UCHAR) ucByte;
+    MB_LATENCY_TX_BYTE(  );
+    return TRUE;
+}
+
+/* ----------------------- Get character ----------------------------------*/
+BOOL
+xMBPortSerialGetByte( CHAR * pucByte )
+{
+    /* Return the byte in the UARTs receive buffer. This function is called
+     * by the protocol stack after pxMBFrameCBByteReceived( ) has been called.
+     */
+#if MB_PORT_RX_DMA
+	*pucByte = (CHAR) ucRxDMABuf[usRxTaken];
+    usRxTaken = ( usRxTaken + 1 ) & ( RX_DMA_SIZE - 1 );
+#else
+	*pucByte = (CHAR) usart_recv(USART1);
+#endif
+    MB_LATENCY_RX_BYTE( ( UCHAR )*pucByte );
+    return TRUE;
+}
+
+/* ----------------------- Close Serial Port ----------------------------------*/
+void
+vMBPortSerialClose( void )
+{
+	nvic_disable_irq(NVIC_USART1_IRQ);
+#if MB_PORT_RX_DMA
+	usart_disable_rx_dma(USART1);
+	dma_disable_stream(DMA2, RX_DMA_STREAM);
+#endif
+	usart_disable_tx_dma(USART1);
+	dma_disable_stream(DMA2, TX_DMA_STREAM);
+	usart_disable(USART1);
+}
+
+/* ----------------------- USART ISR ----------------------------------*/
+/* Transmission is by DMA, so the USART interrupt is only needed for the end
+ * of a received burst (or each received byte without DMA) and to release the
+ * RS-485 bus.
+ */
+void usart1_isr(void)
+{
+#if MB_PORT_RX_DMA
+	/* Check if we were called because of IDLE. The flag is cleared by reading
+	 * the status then the data register, which the DMA has already emptied. */
+	if ((USART_CR1(USART1) & USART_CR1_IDLEIE) &&
+		(USART_SR(USART1) & USART_SR_IDLE))
+	{
+		(void) USART_DR(USART1);
+		xMBPortSerialRxDrain(  );
+	}
+#else
+	/* Check if we were called because of RXNE. */
+	if (usart_get_interrupt_source(USART1,USART_SR_RXNE))
+	{
+	    pxMBFrameCBByteReceived(  );
+	}
+#endif
+#if MB_PORT_RS485 || MB_PORT_LATENCY
+	/* Check if we were called because of TC, and release the bus. */
+	if ((USART_CR1(USART1) & USART_CR1_TCIE) &&
+		(USART_SR(USART1) & USART_SR_TC))
+	{
+		USART_CR1(USART1) &= ~USART_CR1_TCIE;
+#if MB_PORT_RS485
+		gpio_clear(MB_PORT_RS485_DE_PORT, MB_PORT_RS485_DE_PIN);
+#endif
+		MB_LATENCY_TX_DONE(  );
+	}
+#endif
+}
+
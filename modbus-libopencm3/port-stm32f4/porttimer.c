@@ -0,0 +1,114 @@
+/*
+ * FreeModbus Libary: STM32F4 Port
+ * Copyright (C) 2006 Christian Walter <wolti@sil.at>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: porttimer.c,v 1.0 2026/10/14 Exp $
+ */
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+
+/* ----------------------- libopencm3 STM32F4 includes -------------------------------*/
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+
+/* ----------------------- Timebase -----------------------------------------*/
+/* TIM2 runs freely with a 50 microsecond tick and is never stopped, as in the
+ * F1 port. On the F4 TIM2 is a 32 bit timer, so the compare value simply
+ * wraps with the counter. The timer clock is twice the APB1 clock when APB1 is
+ * divided down, which gives 84MHz at a 168MHz system clock.
+ */
+#define MB_TIMER_TICK_HZ    20000
+
+static USHORT usTimeout;
+
+/* ----------------------- Initialize Timer -----------------------------*/
+BOOL
+xMBPortTimersInit( USHORT usTim1Timerout50us )
+{
+    ULONG ulTimerClock = rcc_apb1_frequency;
+    if( ( ( RCC_CFGR >> RCC_CFGR_PPRE1_SHIFT ) & RCC_CFGR_PPRE1_MASK ) != RCC_CFGR_PPRE_DIV_NONE )
+    {
+        ulTimerClock *= 2;
+    }
+    usTimeout = usTim1Timerout50us;
+	/* Enable TIM2 clock. */
+	rcc_periph_clock_enable(RCC_TIM2);
+ 	nvic_enable_irq(NVIC_TIM2_IRQ);
+	timer_reset(TIM2);
+/* Timer global mode: - No divider, Alignment edge, Direction up */
+	timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT,
+		       TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+	timer_continuous_mode(TIM2);
+	timer_set_prescaler(TIM2, ulTimerClock / MB_TIMER_TICK_HZ - 1);
+	timer_set_period(TIM2, 0xFFFFFFFF);
+	timer_disable_oc_output(TIM2, TIM_OC1);
+	timer_set_oc_mode(TIM2, TIM_OC1, TIM_OCM_FROZEN);
+	timer_enable_counter(TIM2);
+    return TRUE;
+}
+
+/* ----------------------- Enable Timer -----------------------------*/
+void
+vMBPortTimersEnable(  )
+{
+    /* Set the timeout from now with the period value set in xMBPortTimersInit( ) */
+	TIM2_CCR1 = TIM2_CNT + usTimeout;
+	TIM2_SR = ~TIM_SR_CC1IF;
+	TIM2_DIER |= TIM_DIER_CC1IE;
+}
+
+/* ----------------------- Enable Timer with another timeout -----------------*/
+/* Used by the master for response timeouts. The timeout set in
+ * xMBPortTimersInit( ) is used again by the next vMBPortTimersEnable( ). */
+void
+vMBPortTimersSet( USHORT usTimeout50us )
+{
+	TIM2_CCR1 = TIM2_CNT + usTimeout50us;
+	TIM2_SR = ~TIM_SR_CC1IF;
+	TIM2_DIER |= TIM_DIER_CC1IE;
+}
+
+/* ----------------------- Disable timer -----------------------------*/
+void
+vMBPortTimersDisable(  )
+{
+	TIM2_DIER &= ~TIM_DIER_CC1IE;
+}
+
+/* ----------------------- Timer ISR -----------------------------*/
+/* Create an ISR which is called whenever the timer has expired. This function
+ * must then call pxMBPortCBTimerExpired( ) to notify the protocol stack that
+ * the timer has expired.
+ */
+void tim2_isr(void)
+{
+	if (! timer_get_flag(TIM2, TIM_SR_CC1IF)) return;
+	TIM2_SR = ~TIM_SR_CC1IF;	/* Clear interrupt flag. */
+	timer_get_flag(TIM2, TIM_SR_CC1IF);	/* Reread to force the previous (buffered) write before leaving */
+    /* With DMA reception, bytes may have arrived since the last IDLE interrupt.
+     * Passing them on restarts the timer, so the frame has not yet ended. */
+    if( xMBPortSerialRxDrain(  ) ) return;
+    vMBPortTimersDisable(  );
+    MB_LATENCY_FRAME_END(  );
+    pxMBPortCBTimerExpired();
+}
@@ -54,8 +54,63 @@ typedef int32_t LONG;
 #define MB_PORT_HAS_CLOSE	                    1
 #define MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS    2
 
+/* Receive by DMA into a circular buffer, with the received bytes passed to the
+ * protocol stack on the USART IDLE interrupt rather than one RXNE interrupt per
+ * byte. Set to 0 to use the RXNE interrupt. */
+#ifndef MB_PORT_RX_DMA
+#define MB_PORT_RX_DMA                          1
+#endif
+
+/* RS-485 half duplex transceiver control. The driver enable pin (DE, usually
+ * tied to /RE) is set when transmission is enabled and cleared from the USART
+ * transmission complete interrupt as soon as the last stop bit has gone. Set
+ * MB_PORT_RS485 to 1 and give the pin below. */
+#ifndef MB_PORT_RS485
+#define MB_PORT_RS485                           0
+#endif
+#define MB_PORT_RS485_DE_PORT                   GPIOA
+#define MB_PORT_RS485_DE_PIN                    GPIO8
+#if defined( STM32F4 )
+#define MB_PORT_RS485_DE_RCC                    RCC_GPIOA
+#else
+#define MB_PORT_RS485_DE_RCC                    RCC_APB2ENR_IOPAEN
+#endif
+
+/* Response latency instrumentation (see mblatency.c). The port and the
+ * register callbacks timestamp each frame with the DWT cycle counter and the
+ * application reads the statistics back as input registers. Set to 1 and
+ * build with mblatency.c. */
+#ifndef MB_PORT_LATENCY
+#define MB_PORT_LATENCY                         0
+#endif
+#if MB_PORT_LATENCY
+#define MB_LATENCY_RX_BYTE( ucByte )            vMBLatencyRxByte( ucByte )
+#define MB_LATENCY_FRAME_END( )                 vMBLatencyFrameEnd( )
+#define MB_LATENCY_CB_ENTER( )                  vMBLatencyCBEnter( )
+#define MB_LATENCY_CB_EXIT( )                   vMBLatencyCBExit( )
+#define MB_LATENCY_TX_BYTE( )                   vMBLatencyTxByte( )
+#define MB_LATENCY_TX_DONE( )                   vMBLatencyTxDone( )
+#else
+#define MB_LATENCY_RX_BYTE( ucByte )
+#define MB_LATENCY_FRAME_END( )
+#define MB_LATENCY_CB_ENTER( )
+#define MB_LATENCY_CB_EXIT( )
+#define MB_LATENCY_TX_BYTE( )
+#define MB_LATENCY_TX_DONE( )
+#endif
+
 /* ----------------------- Prototypes ---------------------------------------*/
 void vMBPortEnterCritical( void );
 void vMBPortExitCritical( void );
+BOOL xMBPortSerialRxDrain( void );
+void vMBPortTimersSet( USHORT usTimeout50us );
+#if MB_PORT_LATENCY
+void vMBLatencyRxByte( UCHAR ucByte );
+void vMBLatencyFrameEnd( void );
+void vMBLatencyCBEnter( void );
+void vMBLatencyCBExit( void );
+void vMBLatencyTxByte( void );
+void vMBLatencyTxDone( void );
+#endif
 
 #endif
@@ -0,0 +1,97 @@
+/*
+ * FreeModbus Libary: BARE Port
+ * Copyright (C) 2006 Christian Walter <wolti@sil.at>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * File: $Id: portevent-freertos.c,v 1.0 2026/10/14 Exp $
+ */
+
+/* Event queue for FreeRTOS.
+
+The protocol stack posts events from the USART and timer ISRs and from the
+Modbus task itself. These are passed through a FreeRTOS queue, and
+xMBPortEventGet( ) blocks the Modbus task on the queue until an event arrives,
+so that eMBPoll( ) sleeps rather than spins and other tasks get the processor.
+
+Build this file in place of portevent.c. The USART and timer interrupts must
+have a priority numerically at or above configMAX_SYSCALL_INTERRUPT_PRIORITY.
+*/
+
+/* ----------------------- FreeRTOS includes --------------------------------*/
+#include <FreeRTOS.h>
+#include <queue.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+/* Events are taken as soon as they are posted, but a frame received event may
+ * be followed by a post from the task before it next waits. */
+#define MB_EVENT_QUEUE_LENGTH           ( 4 )
+
+/* ----------------------- Variables ----------------------------------------*/
+static xQueueHandle xEventQueue;
+
+/* ----------------------- Static functions ---------------------------------*/
+/* The IPSR holds the active exception number, zero in thread mode */
+static inline BOOL
+xMBPortInISR( void )
+{
+    uint32_t ipsr;
+    __asm__ __volatile__ ( "mrs %0, ipsr" : "=r" ( ipsr ) );
+    return ( ipsr != 0 );
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+BOOL
+xMBPortEventInit( void )
+{
+    if( xEventQueue == NULL )
+    {
+        xEventQueue = xQueueCreate( MB_EVENT_QUEUE_LENGTH, sizeof( eMBEventType ) );
+    }
+    else
+    {
+        xQueueReset( xEventQueue );
+    }
+    return ( xEventQueue != NULL );
+}
+
+BOOL
+xMBPortEventPost( eMBEventType eEvent )
+{
+    BaseType_t xWoken = pdFALSE;
+    BaseType_t xPosted;
+
+    if( xMBPortInISR(  ) )
+    {
+        xPosted = xQueueSendFromISR( xEventQueue, &eEvent, &xWoken );
+        portEND_SWITCHING_ISR( xWoken );
+    }
+    else
+    {
+        xPosted = xQueueSend( xEventQueue, &eEvent, 0 );
+    }
+    return ( xPosted == pdPASS );
+}
+
+/* Called by eMBPoll( ). Waits for as long as it takes for an event. */
+BOOL
+xMBPortEventGet( eMBEventType * eEvent )
+{
+    return ( xQueueReceive( xEventQueue, eEvent, portMAX_DELAY ) == pdPASS );
+}
@@ -28,11 +28,32 @@
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/usart.h>
+#include <libopencm3/stm32/dma.h>
 
 /* ----------------------- Modbus includes ----------------------------------*/
 #include "mb.h"
 #include "mbport.h"
 
+/* ----------------------- DMA receive buffer -------------------------------*/
+#if MB_PORT_RX_DMA
+/* USART1 RX is DMA1 channel 5, running in circular mode. The buffer holds two
+ * maximum length RTU frames so that a frame can be taken while the next one
+ * arrives. Size must be a power of two. */
+#define RX_DMA_SIZE     512
+static volatile UCHAR ucRxDMABuf[RX_DMA_SIZE];
+/* Index of the next byte to hand to the protocol stack */
+static USHORT usRxTaken;
+
+static void vMBPortSerialRxDMASetup( void );
+
+/* Position that the DMA will write next */
+static inline USHORT
+usRxDMAPosition( void )
+{
+    return ( USHORT )( RX_DMA_SIZE - DMA_CNDTR( DMA1, DMA_CHANNEL5 ) ) & ( RX_DMA_SIZE - 1 );
+}
+#endif
+
 /* ----------------------- Enable USART interrupts -----------------------------*/
 void
 vMBPortSerialEnable( BOOL xRxEnable, BOOL xTxEnable )
@@ -40,6 +61,20 @@ vMBPortSerialEnable( BOOL xRxEnable, BOOL xTxEnable )
     /* If xRXEnable enable serial receive interrupts. If xTxENable enable
      * transmitter empty interrupts.
      */
+#if MB_PORT_RX_DMA
+    /* The DMA runs all the time. Anything received while the receiver is
+     * disabled (such as an RS-485 echo of our own transmission) is skipped,
+     * and the IDLE interrupt marks the end of each burst. */
+    if( xRxEnable )
+    {
+        usRxTaken = usRxDMAPosition(  );
+		USART_CR1(USART1) |= USART_CR1_IDLEIE;
+    }
+    else
+    {
+		USART_CR1(USART1) &= ~USART_CR1_IDLEIE;
+    }
+#else
     if( xRxEnable )
     {
 		usart_enable_rx_interrupt(USART1);
@@ -48,14 +83,31 @@ vMBPortSerialEnable( BOOL xRxEnable, BOOL xTxEnable )
     {
 		usart_disable_rx_interrupt(USART1);
     }
+#endif
 
     if( xTxEnable )
     {
+#if MB_PORT_RS485
+        /* Take the bus before the first byte goes */
+		USART_CR1(USART1) &= ~USART_CR1_TCIE;
+		gpio_set(MB_PORT_RS485_DE_PORT, MB_PORT_RS485_DE_PIN);
+#endif
 		usart_enable_tx_interrupt(USART1);
     }
     else
     {
 		usart_disable_tx_interrupt(USART1);
+#if MB_PORT_RS485
+        /* The last byte may still be in the USART. Release the bus when it has
+         * gone, which is at once if nothing was sent. */
+		if (gpio_get(MB_PORT_RS485_DE_PORT, MB_PORT_RS485_DE_PIN))
+		{
+			USART_CR1(USART1) |= USART_CR1_TCIE;
+		}
+#elif MB_PORT_LATENCY
+        /* Timestamp the end of the last byte */
+		USART_CR1(USART1) |= USART_CR1_TCIE;
+#endif
     }
 }
 
@@ -75,6 +127,13 @@ BOOL bStatus;
 	/* Setup GPIO pin GPIO_USART1_RE_RX on GPIO port A for receive. */
 	gpio_set_mode(GPIOA, GPIO_MODE_INPUT,
 		      GPIO_CNF_INPUT_FLOAT, GPIO_USART1_RX);
+#if MB_PORT_RS485
+	/* Setup the RS-485 driver enable pin, in receive. */
+	rcc_peripheral_enable_clock(&RCC_APB2ENR, MB_PORT_RS485_DE_RCC);
+	gpio_clear(MB_PORT_RS485_DE_PORT, MB_PORT_RS485_DE_PIN);
+	gpio_set_mode(MB_PORT_RS485_DE_PORT, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_PUSHPULL, MB_PORT_RS485_DE_PIN);
+#endif
 	/* Enable the USART1 interrupt. */
 	nvic_enable_irq(NVIC_USART1_IRQ);
 	/* Setup UART parameters. */
@@ -127,10 +186,62 @@ CHAR wordLength;
 		usart_disable_rx_interrupt(USART1);
 		usart_disable_tx_interrupt(USART1);
 		usart_enable(USART1);
+#if MB_PORT_RX_DMA
+		vMBPortSerialRxDMASetup(  );
+#endif
     }
     return bStatus;
 }
 
+#if MB_PORT_RX_DMA
+/* ----------------------- Setup DMA receive ----------------------------------*/
+static void
+vMBPortSerialRxDMASetup( void )
+{
+	rcc_peripheral_enable_clock(&RCC_AHBENR, RCC_AHBENR_DMA1EN);
+	dma_channel_reset(DMA1, DMA_CHANNEL5);
+	dma_set_peripheral_address(DMA1, DMA_CHANNEL5, (uint32_t) &USART1_DR);
+	dma_set_memory_address(DMA1, DMA_CHANNEL5, (uint32_t) ucRxDMABuf);
+	dma_set_number_of_data(DMA1, DMA_CHANNEL5, RX_DMA_SIZE);
+	dma_set_read_from_peripheral(DMA1, DMA_CHANNEL5);
+	dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL5);
+	dma_enable_circular_mode(DMA1, DMA_CHANNEL5);
+	dma_set_peripheral_size(DMA1, DMA_CHANNEL5, DMA_CCR_PSIZE_8BIT);
+	dma_set_memory_size(DMA1, DMA_CHANNEL5, DMA_CCR_MSIZE_8BIT);
+	dma_set_priority(DMA1, DMA_CHANNEL5, DMA_CCR_PL_HIGH);
+	usRxTaken = 0;
+	usart_enable_rx_dma(USART1);
+	dma_enable_channel(DMA1, DMA_CHANNEL5);
+}
+
+/* ----------------------- Pass received bytes on ----------------------------*/
+/* Hand every byte the DMA has received to the protocol stack, which takes each
+ * one with xMBPortSerialGetByte( ) and restarts the t3.5 timer. This is called
+ * from the USART IDLE interrupt at the end of a burst, and from the timer ISR
+ * so that bytes arriving after the IDLE interrupt are not left behind when the
+ * frame times out. Nothing is passed on while the receiver is disabled.
+ * Returns TRUE if there were any bytes.
+ */
+BOOL
+xMBPortSerialRxDrain( void )
+{
+    BOOL xReceived = FALSE;
+    if( ( USART_CR1(USART1) & USART_CR1_IDLEIE ) == 0 ) return FALSE;
+    while( usRxTaken != usRxDMAPosition(  ) )
+    {
+        pxMBFrameCBByteReceived(  );
+        xReceived = TRUE;
+    }
+    return xReceived;
+}
+#else
+BOOL
+xMBPortSerialRxDrain( void )
+{
+    return FALSE;
+}
+#endif
+
 /* -----------------------Send character  ----------------------------------*/
 BOOL
 xMBPortSerialPutByte( CHAR ucByte )
@@ -139,6 +250,7 @@ xMBPortSerialPutByte( CHAR ucByte )
      * by the protocol stack if pxMBFrameCBTransmitterEmpty( ) has been
      * called. */
 	usart_send(USART1, ucByte);
+    MB_LATENCY_TX_BYTE(  );
     return TRUE;
 }
 
@@ -149,7 +261,13 @@ xMBPortSerialGetByte( CHAR * pucByte )
     /* Return the byte in the UARTs receive buffer. This function is called
      * by the protocol stack after pxMBFrameCBByteReceived( ) has been called.
      */
+#if MB_PORT_RX_DMA
+	*pucByte = (CHAR) ucRxDMABuf[usRxTaken];
+    usRxTaken = ( usRxTaken + 1 ) & ( RX_DMA_SIZE - 1 );
+#else
 	*pucByte = (CHAR) usart_recv(USART1);
+#endif
+    MB_LATENCY_RX_BYTE( ( UCHAR )*pucByte );
     return TRUE;
 }
 
@@ -158,6 +276,10 @@ void
 vMBPortSerialClose( void )
 {
 	nvic_disable_irq(NVIC_USART1_IRQ);
+#if MB_PORT_RX_DMA
+	usart_disable_rx_dma(USART1);
+	dma_disable_channel(DMA1, DMA_CHANNEL5);
+#endif
 	usart_disable(USART1);
 }
 
@@ -171,15 +293,38 @@ vMBPortSerialClose( void )
 /* Find out what interrupted and get or send data as appropriate */
 void usart1_isr(void)
 {
+#if MB_PORT_RX_DMA
+	/* Check if we were called because of IDLE. The flag is cleared by reading
+	 * the status then the data register, which the DMA has already emptied. */
+	if ((USART_CR1(USART1) & USART_CR1_IDLEIE) &&
+		(USART_SR(USART1) & USART_SR_IDLE))
+	{
+		(void) USART_DR(USART1);
+		xMBPortSerialRxDrain(  );
+	}
+#else
 	/* Check if we were called because of RXNE. */
 	if (usart_get_interrupt_source(USART1,USART_SR_RXNE))
 	{
 	    pxMBFrameCBByteReceived(  );
 	}
+#endif
 	/* Check if we were called because of TXE. */
 	if (usart_get_interrupt_source(USART1,USART_SR_TXE))
 	{
 	    pxMBFrameCBTransmitterEmpty(  );
 	}
+#if MB_PORT_RS485 || MB_PORT_LATENCY
+	/* Check if we were called because of TC, and release the bus. */
+	if ((USART_CR1(USART1) & USART_CR1_TCIE) &&
+		(USART_SR(USART1) & USART_SR_TC))
+	{
+		USART_CR1(USART1) &= ~USART_CR1_TCIE;
+#if MB_PORT_RS485
+		gpio_clear(MB_PORT_RS485_DE_PORT, MB_PORT_RS485_DE_PIN);
+#endif
+		MB_LATENCY_TX_DONE(  );
+	}
+#endif
 }
 
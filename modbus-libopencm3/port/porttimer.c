@@ -32,39 +32,123 @@
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/timer.h>
 
+#ifdef SOFT_TIMER
+#include "soft_timer.h"
+#endif
+
+/* ----------------------- Timebase -----------------------------------------*/
+#ifdef SOFT_TIMER
+/* The timeouts are a one shot software timer of soft_timer.c, sharing its
+ * hardware timer with any other users, so TIM2 is left free. The 50 microsecond
+ * units are converted to its 1 microsecond ticks.
+ */
+#define MB_TIMER_TICKS_50US ( SOFT_TIMER_TICK_HZ / 20000 )
+
+static USHORT usTimeout;
+static soft_timer_t xTimer;
+
+static void
+prvvTimerExpired( soft_timer_t *pxTimer )
+{
+    ( void )pxTimer;
+    /* With DMA reception, bytes may have arrived since the last IDLE interrupt.
+     * Passing them on restarts the timer, so the frame has not yet ended. */
+    if( xMBPortSerialRxDrain(  ) ) return;
+    MB_LATENCY_FRAME_END(  );
+    pxMBPortCBTimerExpired();
+}
+
+BOOL
+xMBPortTimersInit( USHORT usTim1Timerout50us )
+{
+    usTimeout = usTim1Timerout50us;
+    soft_timer_init(  );
+    soft_timer_create( &xTimer, prvvTimerExpired, 0 );
+    return TRUE;
+}
+
+void
+vMBPortTimersEnable(  )
+{
+    soft_timer_start( &xTimer, ( uint32_t )usTimeout * MB_TIMER_TICKS_50US, 0 );
+}
+
+void
+vMBPortTimersSet( USHORT usTimeout50us )
+{
+    soft_timer_start( &xTimer, ( uint32_t )usTimeout50us * MB_TIMER_TICKS_50US, 0 );
+}
+
+void
+vMBPortTimersDisable(  )
+{
+    soft_timer_stop( &xTimer );
+}
+
+#else
+/* TIM2 runs freely with a 50 microsecond tick and is never stopped. A timeout
+ * is set by loading the channel 1 compare register with the count at which it
+ * expires, relative to the time it was armed, so that rearming on each
+ * character is a register write with no counter reset. The 16 bit count covers
+ * timeouts of up to 3.2 seconds.
+ */
+#define MB_TIMER_TICK_HZ    20000
+
+static USHORT usTimeout;
+
 /* ----------------------- Initialize Timer -----------------------------*/
 BOOL
 xMBPortTimersInit( USHORT usTim1Timerout50us )
 {
+    ULONG ulTimerClock = rcc_apb1_frequency;
+    /* The timer clock is twice the APB1 clock if APB1 is divided down */
+    if( ( ( RCC_CFGR >> RCC_CFGR_PPRE1_SHIFT ) & 0x7 ) != RCC_CFGR_PPRE1_HCLK_NODIV )
+    {
+        ulTimerClock *= 2;
+    }
+    usTimeout = usTim1Timerout50us;
 	/* Enable TIM2 clock. */
 	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM2EN);
  	nvic_enable_irq(NVIC_TIM2_IRQ);
 	timer_reset(TIM2);
-/* Timer global mode: - Divider 4, Alignment edge, Direction up */
+/* Timer global mode: - No divider, Alignment edge, Direction up */
 	timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT,
 		       TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
 	timer_continuous_mode(TIM2);
-	timer_set_prescaler(TIM2, 3600); /* 72MHz to 50 microseconds period */
-	timer_set_period(TIM2, usTim1Timerout50us);
+	timer_set_prescaler(TIM2, ulTimerClock / MB_TIMER_TICK_HZ - 1);
+	timer_set_period(TIM2, 0xFFFF);
+	timer_disable_oc_output(TIM2, TIM_OC1);
+	timer_set_oc_mode(TIM2, TIM_OC1, TIM_OCM_FROZEN);
+	timer_enable_counter(TIM2);
     return TRUE;
 }
 
 /* ----------------------- Enable Timer -----------------------------*/
-inline void
+void
 vMBPortTimersEnable(  )
 {
-    /* Restart the timer with the period value set in xMBPortTimersInit( ) */
-	TIM2_CNT = 0;
-	timer_enable_irq(TIM2, TIM_DIER_UIE);
-	timer_enable_counter(TIM2);
+    /* Set the timeout from now with the period value set in xMBPortTimersInit( ) */
+	TIM2_CCR1 = ( USHORT )( TIM2_CNT + usTimeout );
+	TIM2_SR = ~TIM_SR_CC1IF;
+	TIM2_DIER |= TIM_DIER_CC1IE;
+}
+
+/* ----------------------- Enable Timer with another timeout -----------------*/
+/* Used by the master for response timeouts. The timeout set in
+ * xMBPortTimersInit( ) is used again by the next vMBPortTimersEnable( ). */
+void
+vMBPortTimersSet( USHORT usTimeout50us )
+{
+	TIM2_CCR1 = ( USHORT )( TIM2_CNT + usTimeout50us );
+	TIM2_SR = ~TIM_SR_CC1IF;
+	TIM2_DIER |= TIM_DIER_CC1IE;
 }
 
 /* ----------------------- Disable timer -----------------------------*/
-inline void
+void
 vMBPortTimersDisable(  )
 {
-	timer_disable_irq(TIM2, TIM_DIER_UIE);
-	timer_disable_counter(TIM2);
+	TIM2_DIER &= ~TIM_DIER_CC1IE;
 }
 
 /* ----------------------- Timer ISR -----------------------------*/
@@ -72,12 +156,17 @@ vMBPortTimersDisable(  )
  * must then call pxMBPortCBTimerExpired( ) to notify the protocol stack that
  * the timer has expired.
  */
-static CHAR count;
 void tim2_isr(void)
 {
-count++;
-	if (timer_interrupt_source(TIM2, TIM_SR_UIF)) timer_clear_flag(TIM2, TIM_SR_UIF); /* Clear interrrupt flag. */
-	timer_get_flag(TIM2, TIM_SR_UIF);	/* Reread to force the previous (buffered) write before leaving */
+	if (! timer_get_flag(TIM2, TIM_SR_CC1IF)) return;
+	TIM2_SR = ~TIM_SR_CC1IF;	/* Clear interrupt flag. */
+	timer_get_flag(TIM2, TIM_SR_CC1IF);	/* Reread to force the previous (buffered) write before leaving */
+    /* With DMA reception, bytes may have arrived since the last IDLE interrupt.
+     * Passing them on restarts the timer, so the frame has not yet ended. */
+    if( xMBPortSerialRxDrain(  ) ) return;
+    vMBPortTimersDisable(  );
+    MB_LATENCY_FRAME_END(  );
     pxMBPortCBTimerExpired();
 }
 
+#endif
@@ -11,9 +11,20 @@ running. The RTC, whose low frequency clock LSE is running, has an alarm
 interrupt which is directed to EXTI 17. Thus it is the only timing source
 available in stop mode.
 
-This program sets up the RTC alarm to interrupt regularly to wake the processor
-for other activities, while dealing with asynchronous interrupts on other EXTI
-lines.
+This program runs alarms from the scheduler of rtc_alarm.c in common on the RTC
+alarm to wake the processor for other activities, while dealing with
+asynchronous interrupts on other EXTI lines. A heartbeat alarm every
+HEARTBEAT_PERIOD seconds only counts, and a report alarm every REPORT_PERIOD
+seconds sends the counts.
+
+The stop is entered through power_stop_deferred, which returns on the HSI as
+soon as the processor wakes, so that the urgent work, here the counts and the
+alarm dispatch, is done at once. The HSE and PLL are only restored by
+power_clock_resume when there is output to send, so a heartbeat goes back into
+stop without waiting for them.
+
+Built with POWER_STATS=1 each report is followed by the time spent running and
+stopped, from power_stats.c, and the wakeups by the RTC alarm and EXTI0.
 
 Interrupt enabled sleep is needed to allow response to interrupts at all times
 whether or not the processor is in sleep mode.
@@ -35,7 +46,9 @@ whether or not the processor is in sleep mode.
  */
 
 #include <unistd.h>
+#include <string.h>
 #include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/cm3/scb.h>
 #include <libopencm3/stm32/exti.h>
 #include <libopencm3/stm32/gpio.h>
@@ -43,21 +56,47 @@ whether or not the processor is in sleep mode.
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/rtc.h>
 #include <libopencm3/stm32/usart.h>
+#include "buffer.h"
+#include "serial.h"
+#include "power.h"
+#include "rtc_alarm.h"
+#include "power_stats.h"
 
 /*--------------------------------------------------------------------------*/
 /* Global Variables */
 
-/* interrupt counter */
-static uint32_t exti_counter;
+/* interrupt counter, and the count last reported */
+static volatile uint32_t exti_counter;
+static uint32_t exti_reported;
+
+/* Alarm periods in seconds */
+#define HEARTBEAT_PERIOD 2
+#define REPORT_PERIOD 10
+static rtc_alarm_t heartbeat;
+static rtc_alarm_t report;
+static uint32_t wakes;
+static uint32_t heartbeats;
+static bool report_due;
+
+#ifdef POWER_STATS
+/* Power state summary sent with each report */
+static char power_summary[256];
+#endif
+
+/* Output buffer sent by DMA */
+#define BUFFER_SIZE 128
+static uint8_t send_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
 
 /*--------------------------------------------------------------------------*/
 /* Local Prototypes */
 
 static void usart1_setup(void);
-static void rtc_setup(void);
 static void exti_setup(void);
-static void usart_print_int(int value);
-static void usart_print_string(char *ch);
+static void heartbeat_alarm(rtc_alarm_t *alarm);
+static void report_alarm(rtc_alarm_t *alarm);
+#ifdef POWER_STATS
+static void send_lines(char *text);
+#endif
 
 /*--------------------------------------------------------------------------*/
 int main(void)
@@ -66,102 +105,72 @@ int main(void)
 
 	rcc_clock_setup_in_hse_8mhz_out_72mhz();
 	usart1_setup();
-	usart_print_string("RTC Alarm Test\n\r");
-	rtc_setup();
-	rtc_set_alarm_time(10);
+	buffer_init(send_buffer, BUFFER_SIZE);
+	serial_tx_init(send_buffer);
+	serial_printf("RTC Alarm Test\n\r");
+	rtc_alarm_init();
+	rtc_alarm_create(&heartbeat, heartbeat_alarm, 0);
+	rtc_alarm_create(&report, report_alarm, 0);
+	rtc_alarm_start(&heartbeat, HEARTBEAT_PERIOD, HEARTBEAT_PERIOD);
+	rtc_alarm_start(&report, REPORT_PERIOD, REPORT_PERIOD);
+	rtc_alarm_dispatch();
+#ifdef POWER_STATS
+	power_stats_init();
+#endif
 	exti_setup();
-	usart_print_string("RTC Setup Complete\n\r");
+	serial_printf("RTC Setup Complete\n\r");
 
-	/* Set to stop mode and wait for RTC interrupt. */
+	/* Set to stop mode and wait for an RTC or EXTI interrupt. */
 	while (1) {
 
-		/* Put in a delay to allow USART to finish. */
-		uint32_t delay;
-		for (delay = 0; delay < 40000; delay++) {
-			asm("nop");
+		/* The alarms are dispatched again with interrupts masked just
+		before the stop, as one falling due while the output was sent
+		would otherwise be lost when the stop clears the EXTI requests.
+		One falling due after this leaves its interrupt pending, which
+		ends the stop at once. Stop only if the dispatch left nothing
+		to do. The processor wakes on the HSI and the full clock is
+		only restored when wanted. serial_tx_flush sleeps until the
+		DMA transfer is complete and then waits on the USART TC flag,
+		so stop follows the last bit sent with no fixed delay. */
+		serial_tx_flush();
+		cm_mask_interrupts(true);
+		rtc_alarm_dispatch();
+		if (! report_due && (exti_counter == exti_reported)) {
+			power_stop_deferred();
+			wakes++;
 		}
-
-		/* Set sleep mode and stop */
-		pwr_voltage_regulator_low_power_in_stop();
-		/* Don't set complete power down (else it goes to standby) */
-		pwr_set_stop_mode();
-		/* Just clear the whole bloody lot of exti pending requests */
-		exti_reset_request(0xFFFFF);
-		/* Set deep sleep mode bit in SCB to go to stop mode */
-		SCB_SCR |= SCB_SCR_SLEEPDEEP;
-		asm volatile("wfi");
-
-		/* Repeat setup as clocks seem to have been reset. */
-		rcc_clock_setup_in_hse_8mhz_out_72mhz();
-		/* Wake up the RTC from the stop condition */
-		rtc_auto_awake(RCC_LSE, 0x7FFF);
-		/* Check if the wakeup source was the alarm. If so reset the
-		RTC counter and set the next alarm. */
-		if (rtc_check_flag(RTC_ALR)) {
-			rtc_clear_flag(RTC_ALR);
-			rtc_set_counter_val(0);
-			rtc_set_alarm_time(10);
-			/* At this point a whole bunch of other tasks would be
-			done, according to the application. */
-			usart_print_string("Woken\r\n");
-			/* ....... */
+		cm_mask_interrupts(false);
+
+		/* Urgent work runs at once on the HSI. The alarms due are
+		called and the RTC alarm set for the next. */
+		rtc_alarm_dispatch();
+
+		/* The serial output needs the full clock. */
+		if (report_due) {
+			report_due = false;
+			power_clock_resume();
+			serial_printf("Woken %u heartbeats %u\r\n", wakes,
+				      heartbeats);
+#ifdef POWER_STATS
+			power_stats_format(power_summary, sizeof(power_summary));
+			send_lines(power_summary);
+#endif
 		}
-		/* Otherwise continue looping. This block just for testing. */
-		else {
-			usart_print_string("Interrupted ");
-			usart_print_int(exti_counter);
-			usart_print_string("\r\n");
+		/* This block just for testing. */
+		if (exti_counter != exti_reported) {
+			exti_reported = exti_counter;
+			power_clock_resume();
+			serial_printf("Interrupted %u\r\n", exti_reported);
 		}
 	}
 
 	return 0;
 }
-/*--------------------------------------------------------------------------*/
-/* @brief Print a String.
-*/
-
-void usart_print_string(char *ch)
-{
-	while (*ch) {
-		usart_send_blocking(USART1, (*(ch++) & 0xFF));
-	}
-}
-
-/*--------------------------------------------------------------------------*/
-/* @brief Print out an integer value in ASCII decimal form
-
-(ack Thomas Otto).
-
-@param[in] value: 16 bit signed integer.
-*/
-
-void usart_print_int(int value)
-{
-	uint8_t i;
-	uint8_t nr_digits = 0;
-	char buffer[25];
-
-	if (value < 0) {
-		usart_send_blocking(USART1, '-');
-		value = value * -1;
-	}
-	if (value == 0) {
-		buffer[nr_digits++] = '0';
-	} else {
-		while (value > 0) {
-			buffer[nr_digits++] = "0123456789"[value % 10];
-			value /= 10;
-		}
-	}
-	for (i = nr_digits; i > 0; i--) {
-		usart_send_blocking(USART1, buffer[i-1]);
-	}
-}
-
 /*--------------------------------------------------------------------------*/
 /* @brief Initialise USART 1.
 
-USART 1 is configured for 38400 baud, no flow control and interrupt.
+USART 1 is configured for 38400 baud, no flow control, with transmission by
+DMA (see serial.c).
 */
 
 void usart1_setup(void)
@@ -170,8 +179,6 @@ void usart1_setup(void)
 	rcc_periph_clock_enable(RCC_GPIOA);
 	rcc_periph_clock_enable(RCC_AFIO);
 	rcc_periph_clock_enable(RCC_USART1);
-	/* Enable the USART1 interrupt. */
-	nvic_enable_irq(NVIC_USART1_IRQ);
 	/* Setup GPIO pin GPIO_USART1_TX on GPIO port A for transmit only. */
 	gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ,
 			  GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO_USART1_TX);
@@ -186,28 +193,30 @@ void usart1_setup(void)
 	usart_enable(USART1);
 }
 
+#ifdef POWER_STATS
 /*--------------------------------------------------------------------------*/
-/* @brief RTC Setup.
+/* @brief Send Text a Line at a Time
 
-The RTC is woken up, cleared, set to use the external low frequency LSE clock
-(which must be provided on the board used) and set to prescale at 1Hz out.
-The LSE clock appears to be already running.
+The power summary is longer than the send buffer, and format.c drops what
+does not fit, so each line waits for the output before it to go.
 */
 
-void rtc_setup(void)
+static void send_lines(char *text)
 {
-	/* Wake up and clear RTC registers using the LSE as clock. */
-	/* Set prescaler, using value for 1Hz out. */
-	rtc_auto_awake(RCC_LSE, 0x7FFF);
-
-	/* Clear RTC counter - some counts will occur before prescale set. */
-	rtc_set_counter_val(0);
-
-	/* Set the Alarm to trigger in interrupt mode on EXTI17 for wakeup */
-	nvic_enable_irq(NVIC_RTC_ALARM_IRQ);
-	EXTI_IMR |= EXTI17;
-	exti_set_trigger(EXTI17, EXTI_TRIGGER_RISING);
+	char *line = text;
+	while (*line != 0) {
+		char *end = strchr(line, '\n');
+		if (end == 0) end = line + strlen(line);
+		else end++;
+		char saved = *end;
+		*end = 0;
+		serial_tx_flush();
+		serial_printf("%s", line);
+		*end = saved;
+		line = end;
+	}
 }
+#endif
 
 /*--------------------------------------------------------------------------*/
 /* @brief EXTI Setup.
@@ -230,30 +239,35 @@ void exti_setup(void)
 }
 
 /*--------------------------------------------------------------------------*/
-/* Interrupt Service Routines */
-/*--------------------------------------------------------------------------*/
-/* EXT0
+/* Alarm Callbacks
 
-Bit 0 of each port used as a pin interrupt.
+These are called by rtc_alarm_dispatch, possibly on the HSI. The heartbeat
+only counts, and the report is left to the main loop once the clock is
+restored.
 */
 
-void exti0_isr(void)
+static void heartbeat_alarm(rtc_alarm_t *alarm)
 {
-	exti_counter++;
-	exti_reset_request(EXTI0);
+	(void) alarm;
+	heartbeats++;
+}
+
+static void report_alarm(rtc_alarm_t *alarm)
+{
+	(void) alarm;
+	report_due = true;
 }
 
 /*--------------------------------------------------------------------------*/
-/* EXT17/RTC Alarm ISR
+/* Interrupt Service Routines */
+/*--------------------------------------------------------------------------*/
+/* EXT0
 
-The RTC alarm appears as EXTI 17 which must be reset independently of the RTC
-alarm flag. Do not reset the latter here as it is needed to guide the main
-program to activate regular tasks.
+Bit 0 of each port used as a pin interrupt.
 */
 
-void rtc_alarm_isr(void)
+void exti0_isr(void)
 {
-	exti_reset_request(EXTI17);
+	exti_counter++;
+	exti_reset_request(EXTI0);
 }
-
-
@@ -3,7 +3,10 @@
 This provides a basic CLI for running tests using the serial port to return
 data and receive commands. Sort of a poor man's JTAG.
 
-Terminal with baud rate 38400.
+Terminal with baud rate 38400. Commands are run from the table by shell.c,
+which edits the line, recalls earlier lines with the arrow keys and lists the
+commands with help. A long command such as count runs a step at a time from
+the main loop and is stopped with Ctrl-C.
 
 Adapt the GPIO initialization to suit.
 
@@ -41,26 +44,33 @@ Copyright K. Sarkies <ksarkies@internode.on.net>
 #include <stdint.h>
 #include <stdbool.h>
 #include "buffer.h"
+#include "serial.h"
+#include "shell.h"
+#include "isr_profile.h"
 
 /* Prototypes */
 
-static void usart_print_int(int value);
-static void usart_print_hex(uint16_t value);
-static void usart_print_string(char *ch);
 static void gpio_setup(void);
 static void usart_setup(void);
 static void clock_setup(void);
-static void parseCommand(char* line);
+static shell_status_t hello(shell_call_t *call);
+static shell_status_t count(shell_call_t *call);
+static shell_status_t peek(shell_call_t *call);
+void print_register(uint32_t reg);
 
 #define BUFFER_SIZE 128
 #define N_CONV 6
 #define N_SAMPLES 16
 
 /* Globals */
-uint8_t send_buffer[BUFFER_SIZE+3];
-uint8_t receive_buffer[BUFFER_SIZE+3];
-char line[80];
-uint8_t characterPosition;
+uint8_t send_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
+uint8_t receive_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
+
+static const shell_command_t commands[] = {
+    {"hello",   "",         "greeting",                         hello},
+    {"count",   "n",        "count to n, a line at a time",     count},
+    {"peek",    "address",  "read a word, address in hex 0x..", peek},
+};
 
 /*--------------------------------------------------------------------------*/
 
@@ -71,42 +81,73 @@ int main(void)
 	usart_setup();
 	buffer_init(send_buffer,BUFFER_SIZE);
 	buffer_init(receive_buffer,BUFFER_SIZE);
-	usart_enable_tx_interrupt(USART1);
+	serial_tx_init(send_buffer);
+	serial_rx_init(receive_buffer);
+#ifdef ISR_PROFILE
+	isr_profile_init();
+#endif
 
 /* Send a greeting message on USART1. */
-	usart_print_string("CLI Test\r\n");
+	serial_printf("CLI Test\r\n");
+	shell_init(receive_buffer, send_buffer, commands,
+               sizeof(commands)/sizeof(commands[0]), "> ");
 
 	while (1)
 	{
 /* Command interface */
-        if (buffer_input_available(receive_buffer))
-        {
-            char character = buffer_get(receive_buffer);
-            if (character == 0x0D)
-            {
-                line[characterPosition] = 0;
-                characterPosition = 0;
-                parseCommand(line);
-            }
-            else line[characterPosition++] = character;
-        }
+        shell_poll();
 	}
 
 	return 0;
 }
 
 /*--------------------------------------------------------------------------*/
-/** @brief Parse a command line and act
+/** @brief Greeting
+
+*/
+
+static shell_status_t hello(shell_call_t *call)
+{
+    (void) call;
+    serial_printf("Hello\r\n");
+    return SHELL_DONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Count
+
+Sends a line for each number, only while the send buffer has room, to show a
+command running over many calls.
+*/
+
+static shell_status_t count(shell_call_t *call)
+{
+    uint32_t limit = (call->argc > 1) ? shell_number(call->argv[1]) : 10;
+    if (call->cancel) return SHELL_DONE;
+    while (call->state < limit)
+    {
+        if (! shell_output_room(12)) return SHELL_BUSY;
+        serial_printf("%u\r\n", ++call->state);
+    }
+    return SHELL_DONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Read a word of memory or a register
 
 */
 
-void parseCommand(char *line)
+static shell_status_t peek(shell_call_t *call)
 {
-    if (line[0] == 'S')
+    if (call->argc < 2)
     {
-        usart_print_string("Hello");
-        usart_print_string("\r\n");
+        serial_printf("peek address\r\n");
+        return SHELL_DONE;
     }
+    uint32_t address = shell_number(call->argv[1]) & ~3;
+    print_register(*(volatile uint32_t *) address);
+    serial_printf("\r\n");
+    return SHELL_DONE;
 }
 
 /*--------------------------------------------------------------------------*/
@@ -174,103 +215,20 @@ void gpio_setup(void)
 
 void print_register(uint32_t reg)
 {
-	usart_print_hex((reg >> 16) & 0xFFFF);
-	usart_print_hex((reg >> 00) & 0xFFFF);
-	buffer_put(send_buffer, ' ');
-    usart_enable_tx_interrupt(USART1);
-}
-
-/*--------------------------------------------------------------------------*/
-/** @brief Print out a value in ASCII decimal form (ack Thomas Otto)
-
-*/
-
-void usart_print_int(int value)
-{
-	uint8_t i;
-	uint8_t nr_digits = 0;
-	char buffer[25];
-
-	if (value < 0)
-	{
-		buffer_put(send_buffer, '-');
-		value = value * -1;
-	}
-	if (value == 0) buffer[nr_digits++] = '0';
-	else while (value > 0)
-	{
-		buffer[nr_digits++] = "0123456789"[value % 10];
-		value /= 10;
-	}
-	for (i = nr_digits; i > 0; i--)
-	{
-		buffer_put(send_buffer, buffer[i-1]);
-	}
-//	buffer_put(send_buffer, ' ');
-    usart_enable_tx_interrupt(USART1);
-}
-
-/*--------------------------------------------------------------------------*/
-/** @brief Print out a value in ASCII hex form
-
-*/
-
-void usart_print_hex(uint16_t value)
-{
-	uint8_t i;
-	char buffer[25];
-
-	for (i = 0; i < 4; i++)
-	{
-		buffer[i] = "0123456789ABCDEF"[value & 0xF];
-		value >>= 4;
-	}
-	for (i = 4; i > 0; i--)
-	{
-		buffer_put(send_buffer, buffer[i-1]);
-	}
-	buffer_put(send_buffer, ' ');
-    usart_enable_tx_interrupt(USART1);
-}
-
-/*--------------------------------------------------------------------------*/
-/** @brief Print a String
-
-*/
-
-void usart_print_string(char *ch)
-{
-  	while(*ch)
-	{
-     	buffer_put(send_buffer, *ch);
-     	ch++;
-  	}
-    usart_enable_tx_interrupt(USART1);
+	serial_printf("%04X %04X  ", (reg >> 16) & 0xFFFF, reg & 0xFFFF);
 }
 
 /*--------------------------------------------------------------------------*/
 /** @brief USART Interrupt
 
-Find out what interrupted and get or send data as appropriate.
+Pass received data to the buffer at the end of a burst. Transmission and
+reception are otherwise handled by DMA in the serial driver.
 */
 
 void usart1_isr(void)
 {
-	static uint16_t data;
-
-/* Check if we were called because of RXNE. */
-	if (usart_get_flag(USART1,USART_SR_RXNE))
-	{
-/* If buffer full we'll just drop it */
-		buffer_put(receive_buffer, (uint8_t) usart_recv(USART1));
-	}
-/* Check if we were called because of TXE. */
-	if (usart_get_flag(USART1,USART_SR_TXE))
-	{
-/* If buffer empty, disable the tx interrupt */
-		data = buffer_get(send_buffer);
-		if ((data & 0xFF00) > 0) usart_disable_tx_interrupt(USART1);
-		else usart_send(USART1, (data & 0xFF));
-	}
+	ISR_PROFILE_ENTER(ISR_PROFILE_USART1);
+	serial_rx_idle_isr();
+	ISR_PROFILE_EXIT(ISR_PROFILE_USART1);
 }
 
@@ -1,17 +1,30 @@
 /* STM32F1 Test of ADC multiple conversions and dual mode operation
 
 This converts a number of ADC channels using scan mode and dual conversion
-mode. Conversions are triggered by a timer. The results must be put to memory
-using DMA, and are then transmitted by USART to an external terminal in ASCII
-decimal form.
+mode. Each scan is started by the TRGO output of timer 3 at SCAN_RATE scans per
+second, with no CPU involvement and no jitter. The results must be put to memory
+using DMA, and are then transmitted by USART to an external terminal as binary
+telemetry frames, with pairs of 12 bit samples packed into three bytes. These
+are read by common/telemetry_decode.py. Define ASCII_OUTPUT to send ASCII
+decimal text instead. The messages at startup are always text, and the decoder
+will skip them.
+
+Define CONTINUOUS_ACQUISITION to have the ADCs convert without a break at their
+full rate. DMA runs in circular mode into a buffer of two halves, and the half
+transfer and transfer complete interrupts only count the blocks ready. The main
+loop processes each block while the DMA fills the other half, adding the
+samples of each channel, and sends the mean of every REPORT_BLOCKS blocks along
+with a count of blocks overrun, that is lost or overwritten before they were
+processed. Set SCAN_RATE to 0 to have the ADCs convert back to back.
 
 Tests:
-ADC scan mode, dual mode, DMA mode, software trigger mode, EOC interrupt.
+ADC scan mode, dual mode, DMA mode, external trigger mode, EOC interrupt.
 GPIO alternate function settings
 NVIC interrupt enable settings
-Timer Basic using output compare
+Timer Basic using the update event as trigger output
 USART send only asynchronous
 DMA peripheral to memory transfers
+DMA circular mode with half transfer interrupt
 
 The board used is the ET-STM32F103 but the test should work on a variety of
 STM32F103 based hardware with access to ADC channels 0-7. A test bench with
@@ -50,25 +63,62 @@ Copyright K. Sarkies <ksarkies@internode.on.net>
 #include <libopencm3/stm32/timer.h>
 #include <libopencm3/stm32/usart.h>
 #include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
 #include "buffer.h"
+#include "serial.h"
+#include "format.h"
+#include "telemetry.h"
+
+/* Define to send samples as ASCII text rather than binary telemetry */
+//#define ASCII_OUTPUT
+
+/* Define to convert continuously into a ping-pong buffer rather than convert
+one scan on each timer tick */
+#define CONTINUOUS_ACQUISITION
+
+/* Channels converted, half by each ADC */
+#define N_CONV 8
+/* Scans in each block, that is each half of the ping-pong buffer */
+#define BLOCK_SCANS 128
+#define BLOCK_WORDS (BLOCK_SCANS*N_CONV/2)
+/* Blocks averaged for each report */
+#define REPORT_BLOCKS 32
+
+/* Scans per second started by timer 3. Without CONTINUOUS_ACQUISITION each scan
+is sent as it is converted, so the rate is limited by the USART. */
+#ifdef CONTINUOUS_ACQUISITION
+#define SCAN_RATE 10000
+#else
+#define SCAN_RATE 2
+#endif
+/* Timer 3 is clocked at twice the APB1 clock of 36MHz */
+#define TIMER_CLOCK 72000000
 
-void usart_print_int(int value);
-void usart_print_hex(uint16_t value);
-void usart_print_string(char *ch);
 void timer_setup(void);
 void adc_setup(void);
 void dma_setup(void);
 void gpio_setup(void);
 void usart_setup(void);
 void clock_setup(void);
+void process_block(const uint32_t *block);
 
 #define BUFFER_SIZE 128
+/* The ADC dump is bursty and exceeds the byte buffer, so use a large ring */
+#define SEND_RING_SIZE 1024
 
 /* Globals */
+#ifdef CONTINUOUS_ACQUISITION
+uint32_t v[2*BLOCK_WORDS];
+#else
 uint32_t v[128];
-uint8_t n_conv = 8;
-uint8_t send_buffer[BUFFER_SIZE+3];
-uint8_t receive_buffer[BUFFER_SIZE+3];
+#endif
+uint8_t n_conv = N_CONV;
+/* Blocks completed by the DMA, counted by its interrupt */
+volatile uint32_t blocks_ready = 0;
+uint32_t overruns = 0;
+uint8_t send_data[SEND_RING_SIZE] __attribute__((aligned(4)));
+ring_buffer_t send_ring;
+uint8_t receive_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
 
 /*--------------------------------------------------------------------------*/
 
@@ -82,13 +132,18 @@ int main(void)
 	usart_setup();
 	dma_setup();
 	adc_setup();
-	timer_setup();	
-	buffer_init(send_buffer,BUFFER_SIZE);
+	ring_init(&send_ring,send_data,SEND_RING_SIZE);
 	buffer_init(receive_buffer,BUFFER_SIZE);
-	usart_enable_tx_interrupt(USART1);
+	serial_tx_init_ring(&send_ring);
+	telemetry_init_ring(&send_ring);
+	serial_rx_init(receive_buffer);
 
 /* Send a greeting message on USART1. */
-	usart_print_string("Dual ADC 8 channels 0-7 DMA IRQ\r\n");
+#ifdef CONTINUOUS_ACQUISITION
+	serial_printf("Dual ADC 8 channels 0-7 continuous DMA\r\n");
+#else
+	serial_printf("Dual ADC 8 channels 0-7 DMA IRQ\r\n");
+#endif
 
 /* Setup array of selected channels for conversion */
 	for (i = 0; i < n_conv/2; i++)
@@ -106,28 +161,52 @@ int main(void)
 	{
 		v[i] = 0;
 	}
-	usart_print_string("ADC1_SQR3 fields ");
-	usart_print_int(ADC1_SQR3 % 32);
-	usart_print_int((ADC1_SQR3 >> 5) % 32);
-	usart_print_int((ADC1_SQR3 >> 10) % 32);
-	usart_print_int((ADC1_SQR3 >> 15) % 32);
-	usart_print_string("\r\nADC2_SQR3 fields ");
-	usart_print_int(ADC2_SQR3 % 32);
-	usart_print_int((ADC2_SQR3 >> 5) % 32);
-	usart_print_int((ADC2_SQR3 >> 10) % 32);
-	usart_print_int((ADC2_SQR3 >> 15) % 32);
-	usart_print_string("\r\n");
-/* Continously convert and send data array on each timer trigger. */
+	serial_printf("ADC1_SQR3 fields %u %u %u %u \r\n",
+                  ADC1_SQR3 & 0x1F, (ADC1_SQR3 >> 5) & 0x1F,
+                  (ADC1_SQR3 >> 10) & 0x1F, (ADC1_SQR3 >> 15) & 0x1F);
+	serial_printf("ADC2_SQR3 fields %u %u %u %u \r\n",
+                  ADC2_SQR3 & 0x1F, (ADC2_SQR3 >> 5) & 0x1F,
+                  (ADC2_SQR3 >> 10) & 0x1F, (ADC2_SQR3 >> 15) & 0x1F);
+/* The timer is started last, once everything is ready for the first scan */
+#if SCAN_RATE > 0
+	timer_setup();
+#endif
+#ifdef CONTINUOUS_ACQUISITION
+/* Process each block as it is completed. Interrupts are masked around the test
+so that a block completed just before the wfi is not missed. Without a timer
+the conversions are started here and then run without a break. */
+#if SCAN_RATE == 0
+	adc_start_conversion_regular(ADC1);
+#endif
+	uint32_t block = 0;
 	while (1)
 	{
-/* Hang around until the next timer tick */
-		for (i = 0; i < 500; i++)
+		cm_mask_interrupts(true);
+		while (blocks_ready == block)
 		{
-			while (!timer_get_flag(TIM2, TIM_SR_CC1IF));
-			timer_clear_flag(TIM2, TIM_SR_CC1IF);
+			__asm__ __volatile__ ("wfi");
+			cm_mask_interrupts(false);
+			cm_mask_interrupts(true);
 		}
-		adc_start_conversion_regular(ADC1);
+		cm_mask_interrupts(false);
+/* Take the latest block, counting those skipped. Odd blocks are in the first
+half. */
+		uint32_t ready = blocks_ready;
+		overruns += ready - block - 1;
+		block = ready;
+		process_block(&v[((block - 1) & 1)*BLOCK_WORDS]);
+/* If another block was completed meanwhile the DMA has started to overwrite
+this one. */
+		if (blocks_ready != block) overruns++;
 	}
+#else
+/* Each timer trigger converts a scan, and the EOC interrupt sends it. Sleep
+meanwhile. */
+	while (1)
+	{
+		__asm__ __volatile__ ("wfi");
+	}
+#endif
 
 	return 0;
 }
@@ -190,7 +269,9 @@ void gpio_setup(void)
 /* Enable DMA 1 Channel 1 to take conversion data from ADC 1, and also ADC 2 when the
 ADC is used in dual mode. The ADC will dump a burst of data to memory each time, and we
 need to grab it before the next conversions start. This must be called after each transfer
-to reset the memory buffer to the beginning. */
+to reset the memory buffer to the beginning.
+For continuous acquisition the DMA is circular over both halves of the buffer
+and is set up only once, interrupting as each half is filled. */
 void dma_setup(void)
 {
 /* Enable DMA1 Clock */
@@ -206,14 +287,25 @@ void dma_setup(void)
 	dma_set_peripheral_address(DMA1,DMA_CHANNEL1,(uint32_t) &ADC1_DR);
 /* The array v[] receives the converted output */
 	dma_set_memory_address(DMA1,DMA_CHANNEL1,(uint32_t) v);
+#ifdef CONTINUOUS_ACQUISITION
+	dma_set_number_of_data(DMA1,DMA_CHANNEL1,2*BLOCK_WORDS);
+	dma_enable_circular_mode(DMA1,DMA_CHANNEL1);
+	dma_enable_half_transfer_interrupt(DMA1,DMA_CHANNEL1);
+	dma_enable_transfer_complete_interrupt(DMA1,DMA_CHANNEL1);
+	nvic_enable_irq(NVIC_DMA1_CHANNEL1_IRQ);
+#else
 	dma_set_number_of_data(DMA1,DMA_CHANNEL1,64);
+#endif
 	dma_enable_channel(DMA1,DMA_CHANNEL1);
 }
 
 /*--------------------------------------------------------------------------*/
 
 /* ADC1 is setup for scan mode. Single conversion does all selected
-channels once through then stops. DMA enabled to collect data. */
+channels once through then stops, until the next timer 3 trigger. DMA enabled
+to collect data. ADC2 follows the triggers of ADC1 in dual mode.
+For continuous acquisition the EOC interrupt is not used, and with no timer
+both ADCs restart the scan as soon as it ends. */
 void adc_setup(void)
 {
 /* Enable clocks for ADCs */
@@ -221,7 +313,9 @@ void adc_setup(void)
 				    RCC_APB2ENR_AFIOEN | RCC_APB2ENR_ADC1EN);
 	rcc_peripheral_enable_clock(&RCC_APB2ENR, RCC_APB2ENR_IOPAEN |
 				    RCC_APB2ENR_AFIOEN | RCC_APB2ENR_ADC2EN);
+#ifndef CONTINUOUS_ACQUISITION
 	nvic_enable_irq(NVIC_ADC1_2_IRQ);
+#endif
 /* Set port PA bits 0-7 for ADC1 to analogue input. ADC2 uses the same ports. */
 	gpio_set_mode(GPIOA, GPIO_MODE_INPUT,
 		      GPIO_CNF_INPUT_ANALOG, GPIO0 | GPIO1 | GPIO2 | GPIO3 | GPIO4 |
@@ -231,16 +325,27 @@ void adc_setup(void)
 	adc_power_off(ADC2);
 /* Configure ADC1 for multiple conversion. */
 	adc_enable_scan_mode(ADC1);
+#if SCAN_RATE > 0
 	adc_set_single_conversion_mode(ADC1);
+	adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_TIM3_TRGO);
+#else
+	adc_set_continuous_conversion_mode(ADC1);
 	adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_SWSTART);
+#endif
 	adc_set_right_aligned(ADC1);
 	adc_set_sample_time_on_all_channels(ADC1, ADC_SMPR_SMP_28DOT5CYC);
 	adc_enable_dma(ADC1);
+#ifndef CONTINUOUS_ACQUISITION
 	adc_enable_eoc_interrupt(ADC1);
+#endif
 	adc_set_dual_mode(ADC_CR1_DUALMOD_RSM);
 /* Configure ADC2 for multiple conversion. */
 	adc_enable_scan_mode(ADC2);
+#if SCAN_RATE > 0
 	adc_set_single_conversion_mode(ADC2);
+#else
+	adc_set_continuous_conversion_mode(ADC2);
+#endif
 	adc_enable_external_trigger_regular(ADC2, ADC_CR2_EXTSEL_SWSTART);
 	adc_set_right_aligned(ADC2);
 	adc_set_sample_time_on_all_channels(ADC2, ADC_SMPR_SMP_28DOT5CYC);
@@ -264,136 +369,131 @@ void adc_setup(void)
 
 /*--------------------------------------------------------------------------*/
 
-/* Setup timer 2 to run through a period and to set a compare flag when the count
-reaches a preset value based on the output compare channel 1. */
+/* Setup timer 3 to run through a period of one scan and to pulse its trigger
+output TRGO on each update event, which starts the ADC. The prescaler is the
+smallest that fits the period in 16 bits, to keep the rate accurate. */
 void timer_setup(void)
 {
-/* Enable TIM2 clock. */
-	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM2EN);
-	timer_reset(TIM2);
-/* Timer global mode: - Divider 4, Alignment edge, Direction up */
-	timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT_MUL_4,
+	uint32_t ticks = TIMER_CLOCK/SCAN_RATE;
+	uint32_t prescale = ticks/0x10000 + 1;
+/* Enable TIM3 clock. */
+	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM3EN);
+	timer_reset(TIM3);
+/* Timer global mode: - No divider, Alignment edge, Direction up */
+	timer_set_mode(TIM3, TIM_CR1_CKD_CK_INT,
 		       TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
-	timer_continuous_mode(TIM2);
-	timer_set_period(TIM2, 0xFFFF);
-	timer_enable_oc_output(TIM2, TIM_OC1);
-	timer_disable_oc_clear(TIM2, TIM_OC1);
-	timer_disable_oc_preload(TIM2, TIM_OC1);
-	timer_set_oc_slow_mode(TIM2, TIM_OC1);
-	timer_set_oc_mode(TIM2, TIM_OC1, TIM_OCM_TOGGLE);
-	timer_set_oc_value(TIM2, TIM_OC1, 0x8FFF);
-	timer_disable_preload(TIM2);
-	timer_enable_counter(TIM2);
+	timer_continuous_mode(TIM3);
+	timer_set_prescaler(TIM3, prescale - 1);
+	timer_set_period(TIM3, ticks/prescale - 1);
+	timer_set_master_mode(TIM3, TIM_CR2_MMS_UPDATE);
+	timer_enable_counter(TIM3);
 }
 
 /*--------------------------------------------------------------------------*/
 
 void print_register(uint32_t reg)
 {
-	usart_print_hex((reg >> 16) & 0xFFFF);
-	usart_print_hex((reg >> 00) & 0xFFFF);
-	buffer_put(send_buffer, ' ');
+	serial_printf("%04X %04X  ", (reg >> 16) & 0xFFFF, reg & 0xFFFF);
 }
 
 /*--------------------------------------------------------------------------*/
 
-/* Print out a value in ASCII decimal form (ack Thomas Otto). */
-void usart_print_int(int value)
+#ifdef CONTINUOUS_ACQUISITION
+/* Add the samples of a block to the sums of each channel, and after
+REPORT_BLOCKS blocks send the means and start again. ADC1 results are in the
+low half of each word and ADC2 in the high half. */
+void process_block(const uint32_t *block)
 {
+	static uint32_t sums[N_CONV];
+	static uint8_t blocks = 0;
+	uint16_t scan;
 	uint8_t i;
-	uint8_t nr_digits = 0;
-	char buffer[25];
-
-	if (value < 0)
+	for (scan = 0; scan < BLOCK_SCANS; scan++)
 	{
-		buffer_put(send_buffer, '-');
-		value = value * -1;
+		for (i = 0; i < N_CONV/2; i++)
+		{
+			uint32_t word = block[scan*N_CONV/2 + i];
+			sums[2*i] += word & 0xFFFF;
+			sums[2*i+1] += word >> 16;
+		}
 	}
-	if (value == 0) buffer[nr_digits++] = '0';
-	else while (value > 0)
+	if (++blocks < REPORT_BLOCKS) return;
+	blocks = 0;
+	uint16_t samples[N_CONV];
+	for (i = 0; i < N_CONV; i++)
 	{
-		buffer[nr_digits++] = "0123456789"[value % 10];
-		value /= 10;
+		samples[i] = sums[i]/(BLOCK_SCANS*REPORT_BLOCKS);
+		sums[i] = 0;
 	}
-	for (i = nr_digits; i > 0; i--)
+#ifdef ASCII_OUTPUT
+	for (i = 0; i < N_CONV/2; i++)
 	{
-		buffer_put(send_buffer, buffer[i-1]);
+		format_ring(&send_ring, "%u - %u ", samples[2*i], samples[2*i+1]);
 	}
-	buffer_put(send_buffer, ' ');
+	format_ring(&send_ring, "overruns %u\r\n", overruns);
+#else
+	uint8_t packed[3*N_CONV/2];
+	telemetry_send(TELEMETRY_ADC_12BIT, packed,
+                   telemetry_pack_12bit(packed, samples, N_CONV));
+#endif
+	serial_tx_start();
 }
 
 /*--------------------------------------------------------------------------*/
 
-/* Print out a value in ASCII hex form. */
-void usart_print_hex(uint16_t value)
+/* Count the blocks as each half of the buffer is filled. */
+void dma1_channel1_isr(void)
 {
-	uint8_t i;
-	char buffer[25];
-
-	for (i = 0; i < 4; i++)
+	if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_HTIF))
 	{
-		buffer[i] = "0123456789ABCDEF"[value & 0xF];
-		value >>= 4;
+		dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_HTIF);
+		blocks_ready++;
 	}
-	for (i = 4; i > 0; i--)
+	if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_TCIF))
 	{
-		buffer_put(send_buffer, buffer[i-1]);
+		dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_TCIF);
+		blocks_ready++;
 	}
-	buffer_put(send_buffer, ' ');
-}
-
-/*--------------------------------------------------------------------------*/
-
-/* Print a String. */
-void usart_print_string(char *ch)
-{
-  	while(*ch)
-	{
-     	buffer_put(send_buffer, *ch);
-     	ch++;
-  	}
 }
 
-/*--------------------------------------------------------------------------*/
-
+#else
 /* Respond to ADC EOC at end of scan and send data block.
-Print the result in decimal and separate with an ASCII dash.*/
+Print the result in decimal and separate with an ASCII dash. The whole block is
+formatted into the send ring before transmission is started.*/
 void adc1_2_isr(void)
 {
 	static uint8_t i = 0;
+#ifdef ASCII_OUTPUT
+	for (i = 0; i < n_conv/2; i++)
+	{
+		format_ring(&send_ring, "%u - %u ", v[i] & 0xFFFF, v[i] >> 16);
+	}
+	format_ring(&send_ring, "\r\n");
+#else
+/* ADC1 results are in the low half of each word and ADC2 in the high half */
+	uint16_t samples[16];
+	uint8_t packed[24];
 	for (i = 0; i < n_conv/2; i++)
 	{
-		usart_print_int(v[i] & 0xFFFF);
-		usart_print_string("- ");
-		usart_print_int(v[i] >> 16);
+		samples[2*i] = v[i] & 0xFFFF;
+		samples[2*i+1] = v[i] >> 16;
 	}
-	usart_print_string("\r\n");
+	telemetry_send(TELEMETRY_ADC_12BIT, packed,
+                   telemetry_pack_12bit(packed, samples, n_conv));
+#endif
 	/* Clear DMA to restart at beginning of data array */
 	dma_setup();
-	/* Enable USART to send */
-	usart_enable_tx_interrupt(USART1);
+	/* Start the DMA to send */
+	serial_tx_start();
 }
+#endif
 
 /*--------------------------------------------------------------------------*/
 
-/* Find out what interrupted and get or send data as appropriate */
+/* Pass received data to the buffer at the end of a burst. Transmission and
+reception are otherwise handled by DMA in the serial driver. */
 void usart1_isr(void)
 {
-	static uint16_t data;
-
-/* Check if we were called because of RXNE. */
-	if (usart_get_flag(USART1,USART_SR_RXNE))
-	{
-/* If buffer full we'll just drop it */
-		buffer_put(receive_buffer, (uint8_t) usart_recv(USART1));
-	}
-/* Check if we were called because of TXE. */
-	if (usart_get_flag(USART1,USART_SR_TXE))
-	{
-/* If buffer empty, disable the tx interrupt */
-		data = buffer_get(send_buffer);
-		if ((data & 0xFF00) > 0) usart_disable_tx_interrupt(USART1);
-		else usart_send(USART1, (data & 0xFF));
-	}
+	serial_rx_idle_isr();
 }
 
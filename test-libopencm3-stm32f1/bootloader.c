@@ -0,0 +1,105 @@
+/* Bootloader for firmware update by iap.c
+
+Placed in the first 16K of the flash of an STM32F103RET6, ahead of the
+application slot of iap.c at 0x08004000. At reset it installs an image waiting
+in the download slot, and then starts the application if it is valid, before
+any peripheral is set up. Without a valid application, or if the install
+fails, it stays in the bootloader, receives an image over USART1 at 115200 baud from iap_send.py in
+common, as the application of iap-app.c does, and resets to install it. The
+LED on PB9 is lit while the bootloader waits for an image.
+
+The application is linked with stm32-h103RET6-app.ld, and iap_send.py is
+given its binary file.
+
+14 October 2026
+*/
+
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/cm3/scb.h>
+#include <libopencm3/cm3/cortex.h>
+#include "buffer.h"
+#include "serial.h"
+#include "telemetry.h"
+#include "iap.h"
+#include "iap_link.h"
+
+/* The receive ring holds the frames in flight and the data arriving during a
+page erase */
+#define RECEIVE_SIZE 2048
+#define SEND_SIZE 256
+
+uint8_t receive_data[RECEIVE_SIZE] __attribute__((aligned(4)));
+uint8_t send_data[SEND_SIZE] __attribute__((aligned(4)));
+ring_buffer_t receive_ring;
+ring_buffer_t send_ring;
+
+/*--------------------------------------------------------------------------*/
+
+int main(void)
+{
+/* A failed install leaves the application slot part programmed with its
+descriptor erased, so it is not started even if its vectors look valid. The
+download stays pending and the install is tried again at the next reset. */
+	bool installed = true;
+	if (iap_pending()) installed = (iap_install() == IAP_OK);
+	if (installed && iap_application_valid()) iap_start_application();
+
+	rcc_clock_setup_in_hse_8mhz_out_72mhz();
+	rcc_periph_clock_enable(RCC_GPIOB);
+	gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_PUSHPULL, GPIO9);
+	gpio_set(GPIOB, GPIO9);
+
+	serial_port_setup(&serial_usart1, 115200,
+			  SERIAL_TX_DMA | SERIAL_RX_DMA);
+	ring_init(&receive_ring, receive_data, RECEIVE_SIZE);
+	ring_init(&send_ring, send_data, SEND_SIZE);
+	serial_tx_init_ring(&send_ring);
+	telemetry_init_ring(&send_ring);
+	serial_rx_init_ring(&receive_ring);
+	iap_link_init(&receive_ring);
+
+/* Sleep until data is received. Interrupts are masked around the test so
+that an interrupt just before the wfi is not missed. */
+	while (1) {
+		cm_mask_interrupts(true);
+		while (ring_count(&receive_ring) == 0) {
+			__asm__ __volatile__ ("wfi");
+			cm_mask_interrupts(false);
+			cm_mask_interrupts(true);
+		}
+		cm_mask_interrupts(false);
+		bool done = iap_link_poll();
+		serial_tx_start();
+		if (done) {
+			serial_tx_flush();
+			scb_reset_system();
+		}
+	}
+
+	return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Pass received data to the buffer at the end of a burst. */
+
+void usart1_isr(void)
+{
+	serial_rx_idle_isr();
+}
@@ -0,0 +1,130 @@
+/* Input capture by DMA for pulse frequency and duty measurement
+
+The pulses on PA0 (TIM2_CH1) are captured by capture.c in common, with DMA
+moving the captures into a circular buffer and an interrupt only at each half
+of it, so pulse rates of several hundred kHz are measured without loading the
+processor. The main loop sleeps until the DMA interrupts, processes the new
+captures, and every REPORT_PERIODS periods leaves the mean frequency, the duty
+cycle, the spread of the periods and the captures lost in the variables
+below, for the debugger. PB8 toggles at each report.
+
+Timer 3 generates a test signal on PA6 of SIGNAL_HZ and SIGNAL_DUTY percent,
+which is wired to PA0. Set CAPTURE_MODE to CAPTURE_EDGES to capture the edge
+timestamps only, in which case the duty is not measured.
+
+14 October 2026
+*/
+
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/cm3/cortex.h>
+#include "capture.h"
+
+#define CAPTURE_MODE CAPTURE_PWM_INPUT
+/* Timer clocks per capture tick. At 72MHz the periods measured must be less
+than 910us. */
+#define PRESCALE 1
+/* Capture buffer in bytes, interrupting at each half */
+#define CAPTURE_SIZE 2048
+/* Periods averaged in each report */
+#define REPORT_PERIODS 100000
+/* Test signal from timer 3 */
+#define SIGNAL_HZ 100000
+#define SIGNAL_DUTY 25
+
+uint8_t capture_data[CAPTURE_SIZE] __attribute__((aligned(4)));
+capture_stats_t stats;
+/* Results of the last report */
+volatile uint32_t frequency_mhz;
+volatile uint16_t duty_permille;
+volatile uint16_t period_min;
+volatile uint16_t period_max;
+volatile uint32_t lost;
+
+/*--------------------------------------------------------------------------*/
+
+void hardware_setup(void)
+{
+/* Set the clock to 72MHz from the 8MHz external crystal */
+
+	rcc_clock_setup_in_hse_8mhz_out_72mhz();
+
+	rcc_periph_clock_enable(RCC_GPIOA);
+	rcc_periph_clock_enable(RCC_GPIOB);
+	rcc_periph_clock_enable(RCC_AFIO);
+
+/* PA6 (TIM3_CH1) outputs the test signal */
+	gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO6);
+/* PB8 toggles at each report */
+	gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_PUSHPULL, GPIO8);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Timer 3 in PWM mode 1 on channel 1 gives the test signal. */
+
+void signal_setup(void)
+{
+	uint32_t period = 72000000/SIGNAL_HZ;
+	rcc_periph_clock_enable(RCC_TIM3);
+	timer_reset(TIM3);
+	timer_set_mode(TIM3, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+	timer_set_oc_mode(TIM3, TIM_OC1, TIM_OCM_PWM1);
+	timer_enable_preload(TIM3);
+	timer_set_period(TIM3, period - 1);
+	timer_enable_oc_output(TIM3, TIM_OC1);
+	timer_enable_oc_preload(TIM3, TIM_OC1);
+	timer_set_oc_value(TIM3, TIM_OC1, (period*SIGNAL_DUTY)/100);
+	timer_enable_counter(TIM3);
+}
+
+/*--------------------------------------------------------------------------*/
+
+int main(void)
+{
+	hardware_setup();
+	capture_clear_stats(&stats);
+	capture_init(CAPTURE_MODE, capture_data, CAPTURE_SIZE, PRESCALE);
+	signal_setup();
+
+/* Sleep until the DMA interrupt has taken captures. Interrupts are masked
+around the test so that an interrupt just before the wfi is not missed. */
+	while (1) {
+		cm_mask_interrupts(true);
+		while (capture_count() == 0) {
+			__asm__ __volatile__ ("wfi");
+			cm_mask_interrupts(false);
+			cm_mask_interrupts(true);
+		}
+		cm_mask_interrupts(false);
+		capture_process(&stats);
+		if (stats.periods >= REPORT_PERIODS) {
+			frequency_mhz = capture_frequency_mhz(&stats);
+			duty_permille = capture_duty_permille(&stats);
+			period_min = stats.period_min;
+			period_max = stats.period_max;
+			lost = stats.lost;
+			capture_clear_stats(&stats);
+			gpio_toggle(GPIOB, GPIO8);
+		}
+	}
+
+	return 0;
+}
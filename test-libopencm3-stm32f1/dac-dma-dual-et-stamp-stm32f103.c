@@ -15,6 +15,23 @@ has DAC capability; only high density STM32F103 devices have this.
 
 Parabolic-linear waveform output at DAC channel 1 (PA4) and a trigger on PC1.
 
+Define STREAM_PLAYBACK to play the waveforms from a source rather than loop a
+fixed table, so they may be of any length. The DMA buffer is then of two
+halves, and the half transfer and transfer complete interrupts refill the half
+just played from the source while the DMA plays the other. The playback is
+gapless at the rate set by the timer, about 36k samples per second. A source is
+any function of the type sample_source_t, giving 12 bit dual samples as the
+DAC takes them: a generator computing the samples as they are needed, as here,
+or a reader of a file or of a communications link. If the source has no
+samples ready the last is held and the shortfall is counted in underruns.
+
+Define DDS_SOURCE to have the source be the direct digital synthesiser of
+dds.c in common, with a sine on each channel of independent frequency, phase
+and amplitude. Channel 2 (PA5) is a quarter cycle behind channel 1 at half the
+amplitude, and the main loop steps the frequency of both through the octaves
+from 250Hz to 4kHz every second or so. The changes take effect at the next
+sample with the phase carried on, so there is no glitch.
+
 Copyright K. Sarkies <ksarkies@internode.on.net>
 
 16 October 2012
@@ -39,11 +56,44 @@ Copyright K. Sarkies <ksarkies@internode.on.net>
 #include <libopencm3/cm3/nvic.h>
 #include <libopencm3/stm32/dac.h>
 #include <libopencm3/stm32/dma.h>
+#include "dds.h"
+#include "wavetable.h"
 
 #define PERIOD 1152
 
+/* Define to stream the waveforms by refilling each half of the DMA buffer as
+it is played, rather than loop a fixed table */
+#define STREAM_PLAYBACK
+/* Define to stream from the synthesiser rather than from the generator */
+#define DDS_SOURCE
+
+/* Samples in each half of the DMA buffer */
+#define HALF_SAMPLES 128
+/* Rate of the DAC triggers, on every second compare of timer 2 */
+#define SAMPLE_RATE (72000000/(2*1001))
+
+/* A source of samples fills up to count dual samples, channel 1 in bits 0-11
+and channel 2 in bits 16-27, and returns the number given. It is called from
+the DMA interrupt. */
+typedef uint32_t (*sample_source_t)(uint32_t *samples, uint32_t count);
+
+uint32_t generator_source(uint32_t *samples, uint32_t count);
+uint32_t dds_source(uint32_t *samples, uint32_t count);
+void refill(uint32_t *half);
+
 /* Globals */
-uint16_t v[256];
+#ifdef STREAM_PLAYBACK
+uint32_t v[2*HALF_SAMPLES];
+#ifdef DDS_SOURCE
+sample_source_t source = dds_source;
+#else
+sample_source_t source = generator_source;
+#endif
+dds_channel_t dds[2];
+/* Samples the source did not give in time */
+uint32_t underruns = 0;
+uint32_t last_sample = 0x08000800;
+#endif
 
 /*--------------------------------------------------------------------*/
 void clock_setup(void)
@@ -97,17 +147,38 @@ void dma_setup(void)
 	rcc_peripheral_enable_clock(&RCC_AHBENR, RCC_AHBENR_DMA2EN);
 	nvic_enable_irq(NVIC_DMA2_CHANNEL3_IRQ);
 	dma_channel_reset(DMA2,DMA_CHANNEL3);
+#ifdef STREAM_PLAYBACK
+	dma_set_priority(DMA2,DMA_CHANNEL3,DMA_CCR_PL_HIGH);
+#else
 	dma_set_priority(DMA2,DMA_CHANNEL3,DMA_CCR_PL_LOW);
+#endif
+#ifdef STREAM_PLAYBACK
+	dma_set_memory_size(DMA2,DMA_CHANNEL3,DMA_CCR_MSIZE_32BIT);
+	dma_set_peripheral_size(DMA2,DMA_CHANNEL3,DMA_CCR_PSIZE_32BIT);
+#else
 	dma_set_memory_size(DMA2,DMA_CHANNEL3,DMA_CCR_MSIZE_16BIT);
 	dma_set_peripheral_size(DMA2,DMA_CHANNEL3,DMA_CCR_PSIZE_16BIT);
+#endif
 	dma_enable_memory_increment_mode(DMA2,DMA_CHANNEL3);
 	dma_enable_circular_mode(DMA2,DMA_CHANNEL3);
 	dma_set_read_from_memory(DMA2,DMA_CHANNEL3);
+#ifdef STREAM_PLAYBACK
+/* The register to target is the DAC dual 12-bit right justified data register */
+	dma_set_peripheral_address(DMA2,DMA_CHANNEL3,(uint32_t) &DAC_DHR12RD);
+#else
 /* The register to target is the DAC dual 8-bit right justified data register */
 	dma_set_peripheral_address(DMA2,DMA_CHANNEL3,(uint32_t) &DAC_DHR8RD);
-/* The array v[] is filled with the waveform data to be output */
+#endif
+#ifdef STREAM_PLAYBACK
+/* The array v[] is refilled with the waveform data to be output */
 	dma_set_memory_address(DMA2,DMA_CHANNEL3,(uint32_t) v);
-	dma_set_number_of_data(DMA2,DMA_CHANNEL3,256);
+	dma_set_number_of_data(DMA2,DMA_CHANNEL3,2*HALF_SAMPLES);
+	dma_enable_half_transfer_interrupt(DMA2, DMA_CHANNEL3);
+#else
+/* The waveforms are taken straight from their table in flash */
+	dma_set_memory_address(DMA2,DMA_CHANNEL3,(uint32_t) wavetable_dual_8bit);
+	dma_set_number_of_data(DMA2,DMA_CHANNEL3,WAVETABLE_SIZE);
+#endif
 	dma_enable_transfer_complete_interrupt(DMA2, DMA_CHANNEL3);
 	dma_enable_channel(DMA2,DMA_CHANNEL3);
 }
@@ -117,11 +188,11 @@ void dac_setup(void)
 {
 /* Enable the DAC clock on APB1 */
 	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_DACEN);
-/* Set port PA4 for DAC1 output to 'alternate function'. Output driver mode is irrelevant. */
+/* Set ports PA4, PA5 for DAC1, DAC2 output to 'alternate function'. Output driver mode is irrelevant. */
 	gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ,
-		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO4);
+		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO4 | GPIO5);
 /* Setup the DAC channels 1,2, with timer 2 as trigger source.
-Set the DMA to channel 1 where 8-bit dual data is presented.
+Set the DMA to channel 1 where dual data is presented.
 Assume the DAC has woken up by the time the first transfer occurs */
 	dac_trigger_enable(CHANNEL_D);
 	dac_set_trigger_source(DAC_CR_TSEL1_T2 | DAC_CR_TSEL2_T2);
@@ -130,13 +201,58 @@ Assume the DAC has woken up by the time the first transfer occurs */
 }
 
 /*--------------------------------------------------------------------*/
-/* The ISR simply provides a test output for a CRO trigger */
+/* Generator source, playing the waveform table on channel 1 and a ramp on
+channel 2. */
+uint32_t generator_source(uint32_t *samples, uint32_t count)
+{
+	static uint8_t i = 0;
+	uint32_t n;
+	for (n = 0; n < count; n++, i++)
+		samples[n] = wavetable_12bit[i] | ((uint32_t) i << 20);
+	return count;
+}
+
+/*--------------------------------------------------------------------*/
+/* Synthesiser source, a sine on each channel. */
+uint32_t dds_source(uint32_t *samples, uint32_t count)
+{
+	dds_fill_dual(&dds[0], &dds[1], samples, count);
+	return count;
+}
+
+/*--------------------------------------------------------------------*/
+/* Fill half of the buffer from the source, holding the last sample over any
+shortfall. */
+void refill(uint32_t *half)
+{
+	uint32_t n = source(half, HALF_SAMPLES);
+	if (n < HALF_SAMPLES)
+	{
+		underruns += HALF_SAMPLES - n;
+		while (n < HALF_SAMPLES) half[n++] = last_sample;
+	}
+	last_sample = half[HALF_SAMPLES-1];
+}
+
+/*--------------------------------------------------------------------*/
+/* The ISR refills each half of the buffer as it is played, and provides a test
+output for a CRO trigger */
 
 void dma2_channel3_isr(void)
 {
+#ifdef STREAM_PLAYBACK
+	if (dma_get_interrupt_flag(DMA2,DMA_CHANNEL3,DMA_HTIF))
+	{
+		dma_clear_interrupt_flags(DMA2,DMA_CHANNEL3,DMA_HTIF);
+		refill(v);
+	}
+#endif
 	if (dma_get_interrupt_flag(DMA2,DMA_CHANNEL3,DMA_TCIF))
 	{
 		dma_clear_interrupt_flags(DMA2,DMA_CHANNEL3,DMA_TCIF);
+#ifdef STREAM_PLAYBACK
+		refill(&v[HALF_SAMPLES]);
+#endif
 /* Toggle PC1 for a CRO trigger. */
 			gpio_toggle(GPIOC, GPIO1);
 	}
@@ -145,27 +261,38 @@ void dma2_channel3_isr(void)
 /*--------------------------------------------------------------------*/
 int main(void)
 {
-/* Fill the array with funky waveform data */
-/* This is for dual channel 8-bit right aligned */
-	uint32_t i, x;
-	for (i=0; i<256; i++)
-	{
-		if (i<10) x=10;
-		else if (i<121) x=10+((i*i)>>7);
-		else if (i<128) x=128;
-		else if (i<246) x=256-i;	
-		else x=10;
-		v[i] = x | (i << 8);
-	}
+#ifdef STREAM_PLAYBACK
+/* Start with both halves filled from the source */
+	dds_init(&dds[0]);
+	dds_init(&dds[1]);
+	dds_set_phase(&dds[1], 65536 - 16384);
+	dds_set_amplitude(&dds[1], DDS_FULL_SCALE/2);
+	refill(v);
+	refill(&v[HALF_SAMPLES]);
+#endif
 	clock_setup();
 	gpio_setup();
 	timer_setup();
 	dma_setup();
 	dac_setup();
 
+#ifdef DDS_SOURCE
+/* Step through the octaves. Each frequency is a single word taken up by the
+next sample in the interrupt. */
+	uint32_t frequency = 250;
+	while (1) {
+		dds_set_frequency(&dds[0], frequency, SAMPLE_RATE);
+		dds_set_frequency(&dds[1], frequency, SAMPLE_RATE);
+		uint32_t delay;
+		for (delay = 0; delay < 8000000; delay++) __asm__("nop");
+		frequency <<= 1;
+		if (frequency > 4000) frequency = 250;
+	}
+#else
 	while (1) {
 
 	}
+#endif
 
 	return 0;
 }
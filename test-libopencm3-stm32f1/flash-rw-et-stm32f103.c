@@ -21,6 +21,7 @@
 #include <libopencm3/stm32/usart.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/flash.h>
+#include "checksum.h"
 
 #define USART_ECHO_EN 1
 #define SEND_BUFFER_SIZE 256
@@ -242,16 +243,21 @@ static uint32_t flash_program_data(uint32_t start_address, uint8_t *input_data,
     {
         /*programming word data*/
         flash_program_word(current_address+iter, *((uint32_t*)(input_data + iter)));
-        flash_lock();
         flash_status = flash_get_status_flags();
         if(flash_status != FLASH_SR_EOP)
-            return flash_status;
-
-/*verify if correct data is programmed*/
-        if(*((uint32_t*)(current_address+iter)) != *((uint32_t*)(input_data + iter)))
-            return FLASH_WRONG_DATA_WRITTEN;
+            break;
     }
 
+/*lock only once the whole block is programmed*/
+    flash_lock();
+    if(flash_status != FLASH_SR_EOP)
+        return flash_status;
+
+/*verify the whole block in one pass by comparing CRCs from the CRC unit*/
+    if(checksum_crc32((const void*)current_address, num_elements) !=
+       checksum_crc32(input_data, num_elements))
+        return FLASH_WRONG_DATA_WRITTEN;
+
     return 0;
 }
 
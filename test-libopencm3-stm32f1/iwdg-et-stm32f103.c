@@ -1,8 +1,9 @@
 /* STM32F1 Test of GPIO function
 
-The IWDG is set going for 5 seconds, and for 10 cycles it is reset
+The IWDG is set going for 5 seconds, and for 10 cycles of 250ms it is reset
 with the first LED blinking. After that, the second LED is turned on
-and an infinite loop is entered.
+and an infinite loop is entered. The cycles are timed by timebase.c in
+common.
 
 Tests:
 IWDG timeout and reset function
@@ -28,6 +29,7 @@ The board used is the ET-STM32F103 with LEDs on port B pins 8-15
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/iwdg.h>
+#include "timebase.h"
 
 /*--------------------------------------------------------------------*/
 void hardware_setup(void)
@@ -35,6 +37,7 @@ void hardware_setup(void)
 /* Setup the clock to 72MHz from the 8MHz external crystal */
 
 	rcc_clock_setup_in_hse_8mhz_out_72mhz();
+	time_init(true);
 
 	rcc_periph_clock_enable(RCC_GPIOB);
 	gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_2_MHZ,
@@ -55,8 +58,7 @@ int main(void)
 	uint32_t i=0;
 	for (; i<10; i++)
 	{
-		uint32_t d=0;
-		for (; d<2000000; d++) __asm__("nop");
+		delay_ms(250);
 		gpio_toggle(GPIOB, GPIO8);
 		iwdg_reset();
 	}
@@ -68,3 +70,11 @@ int main(void)
 
 	return 0;
 }
+
+/*--------------------------------------------------------------------*/
+/* SysTick keeps the timebase of the delays. */
+
+void sys_tick_handler(void)
+{
+	time_tick();
+}
@@ -0,0 +1,134 @@
+/* Key value store in flash
+
+Tests kvstore.c in common, on the top two 1K pages of a 128K STM32F103. A
+count of the resets is kept under one key and increased at each start up, and
+a line typed on USART1 at 115200 baud is saved under another, the previous
+line being sent back first. Keeping a key pressed through many lines, or
+resetting during a write, shows that the values survive the page changes and
+an interrupted write. kv_service is called while waiting for characters, so
+the used pages are erased in the idle time.
+
+14 October 2026
+*/
+
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/usart.h>
+#include "kvstore.h"
+
+#define KEY_RESETS 1
+#define KEY_LINE 2
+#define LINE_SIZE 64
+
+static void send_string(const char *string);
+static void send_number(uint32_t value);
+
+/*--------------------------------------------------------------------------*/
+
+void hardware_setup(void)
+{
+/* Set the clock to 72MHz from the 8MHz external crystal */
+
+	rcc_clock_setup_in_hse_8mhz_out_72mhz();
+
+	rcc_periph_clock_enable(RCC_GPIOA);
+	rcc_periph_clock_enable(RCC_AFIO);
+	rcc_periph_clock_enable(RCC_USART1);
+
+	gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO_USART1_TX);
+	gpio_set_mode(GPIOA, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT,
+		      GPIO_USART1_RX);
+
+	usart_set_baudrate(USART1, 115200);
+	usart_set_databits(USART1, 8);
+	usart_set_stopbits(USART1, USART_STOPBITS_1);
+	usart_set_parity(USART1, USART_PARITY_NONE);
+	usart_set_mode(USART1, USART_MODE_TX_RX);
+	usart_set_flow_control(USART1, USART_FLOWCONTROL_NONE);
+	usart_enable(USART1);
+}
+
+/*--------------------------------------------------------------------------*/
+
+int main(void)
+{
+	uint32_t resets = 0;
+	uint16_t length;
+	char line[LINE_SIZE + 1];
+	uint16_t count = 0;
+
+	hardware_setup();
+	kv_init();
+
+	kv_read(KEY_RESETS, &resets, sizeof(resets), &length);
+	resets++;
+	kv_write(KEY_RESETS, &resets, sizeof(resets));
+	send_string("\r\nResets ");
+	send_number(resets);
+	send_string(", keys ");
+	send_number(kv_count());
+	send_string("\r\n");
+
+	while (1) {
+		if ((USART_SR(USART1) & USART_SR_RXNE) == 0) {
+			kv_service();
+			continue;
+		}
+		char character = usart_recv(USART1);
+		if ((character != '\r') && (character != '\n')) {
+			if (count < LINE_SIZE) line[count++] = character;
+			continue;
+		}
+		if (count == 0) continue;
+		char previous[LINE_SIZE + 1];
+		if (kv_read(KEY_LINE, previous, LINE_SIZE, &length) == KV_OK) {
+			previous[length] = 0;
+			send_string("Was: ");
+			send_string(previous);
+			send_string("\r\n");
+		}
+		uint8_t result = kv_write(KEY_LINE, line, count);
+		send_string((result == KV_OK) ? "Saved\r\n" : "Failed\r\n");
+		count = 0;
+	}
+
+	return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+
+static void send_string(const char *string)
+{
+	while (*string) usart_send_blocking(USART1, *string++);
+}
+
+/*--------------------------------------------------------------------------*/
+
+static void send_number(uint32_t value)
+{
+	char digits[11];
+	uint8_t i = sizeof(digits) - 1;
+	digits[i] = 0;
+	do {
+		digits[--i] = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+	send_string(&digits[i]);
+}
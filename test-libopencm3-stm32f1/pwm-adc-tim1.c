@@ -0,0 +1,232 @@
+/* PWM synchronous ADC sampling and control loop on timer 1
+
+Timer 1 drives a MOSFET bridge as in pwm-tim1.c, centre aligned with
+complementary outputs and a deadtime, here at 20kHz. Channel 4 of the timer,
+which has no output, is set so that its reference OC4REF rises one count
+before the top of the count, the centre of the high side pulses of PWM mode 2,
+away from the switching edges where the current is noisy. OC4REF is the
+trigger output TRGO of the timer, which starts the injected conversions of
+ADC1: the current on PA0 and the voltage on PA1. So the sampling is locked to
+the PWM with no CPU involvement.
+
+The injected end of conversion (JEOC) interrupt reads the results and calls
+the control hook, which sets CCR1 and CCR2 through their preload registers.
+The new values take effect at the update event at the bottom of the count,
+ready for the next high side pulse, so the loop runs once per PWM period with
+a fixed delay. The hook here is an integral controller holding the voltage at
+SETPOINT, with the two legs of the bridge driven in opposite duty. The ADC
+interrupt is at IRQ_LEVEL_ADC of irq_priority.h, preempted only by DMA
+completions, and PB8 is high while it runs, to measure the latency and load
+with a CRO.
+
+Built with TRACE=1 each period is also recorded as an event of trace.c with
+the voltage, and each time the duty reaches a limit with the duty, drained
+from the main loop to SWO for trace_decode.py with the names in
+pwm-adc-tim1.trace.
+
+PA8, PA9 are the timer 1 channels 1 and 2, PB13, PB14 are the inverted
+outputs.
+
+14 October 2026
+*/
+
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/cm3/nvic.h>
+#include "irq_priority.h"
+#include "trace.h"
+
+/* Half the PWM period in timer counts: 72MHz/(2*1800) = 20kHz */
+#define PERIOD 1800
+/* Deadtime in timer counts, 0.5us */
+#define DEADTIME 36
+/* Limits of the duty cycle in counts, leaving room for the deadtime */
+#define DUTY_MIN (2*DEADTIME)
+#define DUTY_MAX (PERIOD - 2*DEADTIME)
+/* Voltage held by the control hook, in ADC counts */
+#define SETPOINT 2048
+/* Integral gain as a right shift of the error */
+#define GAIN_SHIFT 6
+
+/* Trace events */
+#define TRACE_SAMPLE    (TRACE_USER + 0)
+#define TRACE_LIMIT     (TRACE_USER + 1)
+
+static void control_hook(uint16_t current, uint16_t voltage);
+
+/* Duty in 1/64 counts, kept by the integral controller */
+static int32_t duty = (PERIOD/2) << GAIN_SHIFT;
+/* Latest samples, for the debugger */
+volatile uint16_t last_current;
+volatile uint16_t last_voltage;
+
+/*--------------------------------------------------------------------------*/
+
+void hardware_setup(void)
+{
+/* Set the clock to 72MHz from the 8MHz external crystal */
+
+	rcc_clock_setup_in_hse_8mhz_out_72mhz();
+
+	rcc_periph_clock_enable(RCC_GPIOA);
+	rcc_periph_clock_enable(RCC_GPIOB);
+	rcc_periph_clock_enable(RCC_AFIO);
+
+/* Set ports PA8 (TIM1_CH1), PA9 (TIM1_CH2), PB13 (TIM1_CH1N), PB14 (TIM1_CH2N)
+for PWM, to 'alternate function output push-pull'. */
+	gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO8 | GPIO9);
+	gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO13 | GPIO14);
+/* PB8 marks the interrupt */
+	gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_PUSHPULL, GPIO8);
+/* PA0 current and PA1 voltage to analogue input */
+	gpio_set_mode(GPIOA, GPIO_MODE_INPUT,
+		      GPIO_CNF_INPUT_ANALOG, GPIO0 | GPIO1);
+}
+
+/*--------------------------------------------------------------------------*/
+/* ADC1 converts channels 0 and 1 as an injected sequence on each timer 1
+TRGO. The sample time is short so that the conversions, about 3.3us, end well
+inside the period. */
+
+void adc_setup(void)
+{
+	uint8_t channels[2] = { 0, 1 };
+	uint32_t i;
+	rcc_periph_clock_enable(RCC_ADC1);
+	adc_power_off(ADC1);
+	adc_enable_scan_mode(ADC1);
+	adc_set_single_conversion_mode(ADC1);
+	adc_set_right_aligned(ADC1);
+	adc_set_sample_time_on_all_channels(ADC1, ADC_SMPR_SMP_7DOT5CYC);
+	adc_set_injected_sequence(ADC1, 2, channels);
+	adc_enable_external_trigger_injected(ADC1, ADC_CR2_JEXTSEL_TIM1_TRGO);
+	adc_enable_eoc_interrupt_injected(ADC1);
+	IRQ_PRIORITY_SET(NVIC_ADC1_2_IRQ, IRQ_LEVEL_ADC);
+	nvic_enable_irq(NVIC_ADC1_2_IRQ);
+	adc_power_on(ADC1);
+/* Wait for ADC starting up. */
+	for (i = 0; i < 800000; i++)    /* Wait a bit. */
+		__asm__("nop");
+	adc_reset_calibration(ADC1);
+	adc_calibrate_async(ADC1);
+	while (adc_is_calibrating(ADC1));
+}
+
+/*--------------------------------------------------------------------------*/
+
+void timer_setup(void)
+{
+	rcc_periph_clock_enable(RCC_TIM1);
+	timer_reset(TIM1);
+
+/* Set Timer global mode:
+ * - No division
+ * - Alignment centre mode 1 (up/down counting, interrupt on downcount only)
+ * - Direction up (when centre mode is set it is read only, changes by hardware)
+ */
+	timer_set_mode(TIM1, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_CENTER_1, TIM_CR1_DIR_UP);
+
+/* Channels 1 and 2 in PWM mode 2 (output low when CNT < CCR, high otherwise)
+with complementary outputs and a deadtime */
+	timer_set_oc_mode(TIM1, TIM_OC1, TIM_OCM_PWM2);
+	timer_enable_oc_output(TIM1, TIM_OC1);
+	timer_enable_oc_output(TIM1, TIM_OC1N);
+	timer_set_oc_mode(TIM1, TIM_OC2, TIM_OCM_PWM2);
+	timer_enable_oc_output(TIM1, TIM_OC2);
+	timer_enable_oc_output(TIM1, TIM_OC2N);
+	timer_set_deadtime(TIM1, DEADTIME);
+	timer_enable_break_main_output(TIM1);
+
+/* Channel 4 in PWM mode 2 rises one count before the top. It is not output,
+only used as the trigger. */
+	timer_set_oc_mode(TIM1, TIM_OC4, TIM_OCM_PWM2);
+	timer_set_oc_value(TIM1, TIM_OC4, PERIOD - 1);
+	timer_set_master_mode(TIM1, TIM_CR2_MMS_COMPARE_OC4REF);
+
+	timer_enable_preload(TIM1);
+	timer_set_period(TIM1, PERIOD);
+	timer_enable_oc_preload(TIM1, TIM_OC1);
+	timer_enable_oc_preload(TIM1, TIM_OC2);
+	timer_set_oc_value(TIM1, TIM_OC1, PERIOD/2);
+	timer_set_oc_value(TIM1, TIM_OC2, PERIOD/2);
+
+/* Force an update to load the shadow registers */
+	timer_generate_event(TIM1, TIM_EGR_UG);
+
+/* Start the Counter. */
+	timer_enable_counter(TIM1);
+}
+
+/*--------------------------------------------------------------------------*/
+
+int main(void)
+{
+	hardware_setup();
+	adc_setup();
+	timer_setup();
+#ifdef TRACE
+	trace_init(0);
+#endif
+
+/* Everything happens in the interrupt */
+	while (1) {
+#ifdef TRACE
+		trace_drain();
+#endif
+		__asm__ __volatile__ ("wfi");
+	}
+
+	return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Control hook, called once per PWM period with the new samples. Integrate the
+voltage error into the duty, and drive the two legs of the bridge in opposite
+duty. The compare values are preloaded, so they take effect together at the
+next update event. */
+
+static void control_hook(uint16_t current, uint16_t voltage)
+{
+	last_current = current;
+	TRACE_EVENT(TRACE_SAMPLE, voltage);
+	duty += (int32_t) SETPOINT - voltage;
+	if (duty < (DUTY_MIN << GAIN_SHIFT)) duty = DUTY_MIN << GAIN_SHIFT;
+	if (duty > (DUTY_MAX << GAIN_SHIFT)) duty = DUTY_MAX << GAIN_SHIFT;
+	uint32_t ccr = duty >> GAIN_SHIFT;
+	if ((ccr == DUTY_MIN) || (ccr == DUTY_MAX)) TRACE_EVENT(TRACE_LIMIT, ccr);
+	TIM1_CCR1 = PERIOD - ccr;
+	TIM1_CCR2 = ccr;
+	last_voltage = voltage;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Injected conversions complete. The results are read straight from the data
+registers to keep the latency short. */
+
+void adc1_2_isr(void)
+{
+	gpio_set(GPIOB, GPIO8);
+	ADC_SR(ADC1) &= ~ADC_SR_JEOC;
+	control_hook(ADC_JDR1(ADC1), ADC_JDR2(ADC1));
+	gpio_clear(GPIOB, GPIO8);
+}
@@ -9,6 +9,21 @@ outputs.
 PA8 in STM32F103 seems to be unavailable. Reason and solution unknown.
 
 Set timer 1 to PWM mode, centre aligned, 62.5kHz. Set a deadtime.
+
+Define SPWM for three phase sinusoidal PWM with no CPU work per period. The
+update event of each PWM period requests a DMA burst through the timer DMA
+registers: TIM1_DCR sets the burst of three writes from CCR1, and DMA1 channel
+5 writes three halfwords to TIM1_DMAR, which the timer passes on to CCR1, CCR2
+and CCR3. The compare registers are preloaded, so the new duties take effect
+together at the following update. The DMA runs circular over a buffer of two
+halves, and its half transfer and transfer complete interrupts refill the half
+just used from the synthesiser of dds.c in common, one channel a third of a
+cycle behind the next. So a change of frequency or amplitude takes up within
+HALF_STEPS periods with the phase carried on, and the CPU is only needed about
+once a millisecond. The main loop ramps the output from 5Hz to 50Hz with the
+amplitude in proportion, as for a soft start of an induction motor.
+
+PA10 and PB15 are then the timer 1 channel 3 and its inverted output.
 */
 
 /*
@@ -30,10 +45,34 @@ Set timer 1 to PWM mode, centre aligned, 62.5kHz. Set a deadtime.
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/timer.h>
 #include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/dma.h>
+#include "dds.h"
+
+/* Define for three phase sinusoidal PWM fed by DMA */
+#define SPWM
 
 #define PERIOD 100
 
+/* Half the SPWM period in timer counts: 72MHz/(2*576) = 62.5kHz */
+#define SPWM_PERIOD 576
+#define SPWM_RATE (72000000/(2*SPWM_PERIOD))
+/* Deadtime in timer counts, 0.5us */
+#define DEADTIME 36
+/* PWM periods in each half of the DMA buffer */
+#define HALF_STEPS 64
+/* Offset in words of CCR1 from CR1, the start of the DMA burst */
+#define DCR_DBA_CCR1 13
+/* Burst length of three transfers, less one */
+#define DCR_DBL_3 (2 << 8)
+
+void refill(uint16_t *half);
+
 /* Globals */
+#ifdef SPWM
+/* Compare values of the three channels for each period */
+uint16_t duty[2*HALF_STEPS*3];
+dds_channel_t phase[3];
+#endif
 
 void hardware_setup(void)
 {
@@ -56,6 +95,13 @@ for PWM, to 'alternate function output push-pull'. */
 		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO8 | GPIO9);
 	gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_50_MHZ,
 		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO13 | GPIO14);
+#ifdef SPWM
+/* PA10 (TIM1_CH3) and PB15 (TIM1_CH3N) for the third phase */
+	gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO10);
+	gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_50_MHZ,
+		      GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO15);
+#endif
 
 /* ------------------ Timer 1 PWM */
 /* Enable TIM1 clock. */
@@ -86,6 +132,45 @@ for PWM, to 'alternate function output push-pull'. */
 the low MOSFET through an inverting level shifter */
     timer_set_oc_polarity_high(TIM1, TIM_OC2N);
 
+#ifdef SPWM
+	timer_set_oc_mode(TIM1, TIM_OC3, TIM_OCM_PWM2);
+	timer_enable_oc_output(TIM1, TIM_OC3);
+	timer_enable_oc_output(TIM1, TIM_OC3N);
+	timer_set_oc_polarity_high(TIM1, TIM_OC3N);
+	timer_set_deadtime(TIM1, DEADTIME);
+	timer_enable_preload(TIM1);
+	timer_set_period(TIM1, SPWM_PERIOD);
+	timer_enable_oc_preload(TIM1, TIM_OC1);
+	timer_enable_oc_preload(TIM1, TIM_OC2);
+	timer_enable_oc_preload(TIM1, TIM_OC3);
+	timer_set_oc_value(TIM1, TIM_OC1, SPWM_PERIOD/2);
+	timer_set_oc_value(TIM1, TIM_OC2, SPWM_PERIOD/2);
+	timer_set_oc_value(TIM1, TIM_OC3, SPWM_PERIOD/2);
+/* In centre aligned mode an update comes at both ends of the count. A
+repetition count of one leaves only one in each period. */
+	timer_set_repetition_counter(TIM1, 1);
+
+/* The update DMA request does a burst of three writes from CCR1 through
+TIM1_DMAR. DMA1 channel 5 serves the TIM1 update. */
+	rcc_peripheral_enable_clock(&RCC_AHBENR, RCC_AHBENR_DMA1EN);
+	dma_channel_reset(DMA1, DMA_CHANNEL5);
+	dma_set_priority(DMA1, DMA_CHANNEL5, DMA_CCR_PL_HIGH);
+	dma_set_memory_size(DMA1, DMA_CHANNEL5, DMA_CCR_MSIZE_16BIT);
+	dma_set_peripheral_size(DMA1, DMA_CHANNEL5, DMA_CCR_PSIZE_16BIT);
+	dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL5);
+	dma_enable_circular_mode(DMA1, DMA_CHANNEL5);
+	dma_set_read_from_memory(DMA1, DMA_CHANNEL5);
+	dma_set_peripheral_address(DMA1, DMA_CHANNEL5, (uint32_t) &TIM_DMAR(TIM1));
+	dma_set_memory_address(DMA1, DMA_CHANNEL5, (uint32_t) duty);
+	dma_set_number_of_data(DMA1, DMA_CHANNEL5, 2*HALF_STEPS*3);
+	dma_enable_half_transfer_interrupt(DMA1, DMA_CHANNEL5);
+	dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL5);
+	nvic_enable_irq(NVIC_DMA1_CHANNEL5_IRQ);
+	dma_enable_channel(DMA1, DMA_CHANNEL5);
+	TIM_DCR(TIM1) = DCR_DBL_3 | DCR_DBA_CCR1;
+	TIM_DIER(TIM1) |= TIM_DIER_UDE;
+#else
+
 /* The ARR (auto-preload register) sets the PWM period to 62.5kHz from the
 72 MHz clock.*/
 	timer_enable_preload(TIM1);
@@ -96,6 +181,7 @@ the low MOSFET through an inverting level shifter */
 	timer_set_oc_value(TIM1, TIM_OC1, (PERIOD*20)/100);
 	timer_enable_oc_preload(TIM1, TIM_OC2);
 	timer_set_oc_value(TIM1, TIM_OC2, (PERIOD*50)/100);
+#endif
 
 /* Force an update to load the shadow registers */
 	timer_generate_event(TIM1, TIM_EGR_UG);
@@ -104,13 +190,82 @@ the low MOSFET through an inverting level shifter */
 	timer_enable_counter(TIM1);
 }
 
+/*--------------------------------------------------------------------------*/
+#ifdef SPWM
+/* Fill half of the buffer with the compare values of the three phases for
+each period, from the sine of each about mid scale. */
+
+void refill(uint16_t *half)
+{
+	uint32_t step;
+	uint8_t i;
+	for (step = 0; step < HALF_STEPS; step++)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			*half++ = ((uint32_t) dds_next(&phase[i])*SPWM_PERIOD) >> 12;
+		}
+	}
+}
+#endif
+
+/*--------------------------------------------------------------------------*/
+
 int main(void)
 {
+#ifdef SPWM
+/* Phases a third of a cycle apart, starting at zero amplitude, and both
+halves of the buffer filled before the timer starts */
+	uint8_t i;
+	for (i = 0; i < 3; i++)
+	{
+		dds_init(&phase[i]);
+		dds_set_amplitude(&phase[i], 0);
+	}
+	dds_set_phase(&phase[1], 65536 - 21845);
+	dds_set_phase(&phase[2], 21845);
+	refill(duty);
+	refill(&duty[HALF_STEPS*3]);
+#endif
 	hardware_setup();
 
+#ifdef SPWM
+/* Ramp the frequency with the amplitude in proportion. Each setting is taken
+up by the next refill. */
+	uint32_t frequency;
+	for (frequency = 5; frequency <= 50; frequency++)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			dds_set_frequency(&phase[i], frequency, SPWM_RATE);
+			dds_set_amplitude(&phase[i], (DDS_FULL_SCALE*frequency)/50);
+		}
+		uint32_t delay;
+		for (delay = 0; delay < 500000; delay++) __asm__("nop");
+	}
+#endif
 	while (1) {
 
 	}
 
 	return 0;
 }
+
+/*--------------------------------------------------------------------------*/
+/* Refill each half of the buffer as the DMA moves on to the other. */
+
+#ifdef SPWM
+void dma1_channel5_isr(void)
+{
+	if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL5, DMA_HTIF))
+	{
+		dma_clear_interrupt_flags(DMA1, DMA_CHANNEL5, DMA_HTIF);
+		refill(duty);
+	}
+	if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL5, DMA_TCIF))
+	{
+		dma_clear_interrupt_flags(DMA1, DMA_CHANNEL5, DMA_TCIF);
+		refill(&duty[HALF_STEPS*3]);
+	}
+}
+#endif
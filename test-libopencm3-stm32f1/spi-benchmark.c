@@ -0,0 +1,442 @@
+/* STM32F1 SPI Throughput Benchmark
+
+Transfers a block over SPI2 with MISO looped back to MOSI (PB14 to PB15) at
+each baud rate prescaler, in three modes, polled, interrupt and DMA, and with
+8 and 16 bit frames, and sends a table of the results to USART1 at 115200
+baud.
+
+Polled: each frame is written to the data register when the transmit buffer
+is empty, and read back when the receive buffer is full.
+Interrupt: the receive buffer not empty interrupt reads each frame and writes
+the next, so there is one frame in flight.
+DMA: one full duplex transaction on the spi_dma.c driver in common.
+
+Each transfer is timed by the DWT cycle counter. The throughput is the block
+size divided by the time from the start of the transfer to the last frame
+received. The CPU busy time is the share of that time not spent in the idle
+loop that waits for the transfer to end: the loop counts its passes, and the
+cycles of one pass are found by timing the loop beforehand with no transfer.
+Interrupt entry and exit, and the bus cycles taken by the DMA, fall in the busy
+time. The polled mode has no idle time and so is always 100% busy.
+
+The received data is compared with that sent, to count errors where the
+loopback is missing.
+
+The USART is run by interrupts from a circular buffer, as the DMA channels of
+USART1 are taken by SPI2. The buffer is emptied before each transfer so that
+the USART interrupt does not fall in the timing. Any character received starts
+another run.
+
+The board used is the ET-STM32F103 but the test should work on a variety of
+STM32F103 based hardware.
+
+14 October 2026
+*/
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/usart.h>
+#include <libopencm3/stm32/spi.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/dwt.h>
+#include <string.h>
+#include "buffer.h"
+#include "format.h"
+#include "spi_dma.h"
+#include "irq_priority.h"
+
+/* Clocks after rcc_clock_setup_in_hse_8mhz_out_72mhz. SPI2 is on APB1. */
+#define CPU_CLOCK           72000000
+#define SPI2_CLOCK          36000000
+
+/* Bytes in each transfer */
+#define BLOCK_SIZE          1024
+
+/* Idle loop passes timed to find the cycles of one pass */
+#define IDLE_CALIBRATION    4096
+
+#define BUFFER_SIZE 128
+
+static void clock_setup(void);
+static void usart_setup(void);
+static void spi_setup(void);
+static void run_benchmark(void);
+static void run_test(uint8_t mode, bool frame_16bit, uint8_t prescaler);
+static uint32_t idle_wait(volatile bool *done, uint32_t limit);
+static uint32_t transfer_polled(bool frame_16bit);
+static uint32_t transfer_interrupt(bool frame_16bit, uint32_t *idle);
+static uint32_t transfer_dma(bool frame_16bit, uint32_t *idle);
+static void usart_print_string(char *ch);
+static void usart_flush(void);
+
+uint8_t send_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
+uint8_t receive_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
+
+/* Transfer modes */
+#define MODE_POLLED         0
+#define MODE_INTERRUPT      1
+#define MODE_DMA            2
+
+static const char *mode_name[] = {"polled", "interrupt", "DMA"};
+
+/* Baud rate prescalers, dividing the SPI clock by 2 to 256 */
+static const uint32_t prescaler_setting[] = {
+    SPI_CR1_BAUDRATE_FPCLK_DIV_2,
+    SPI_CR1_BAUDRATE_FPCLK_DIV_4,
+    SPI_CR1_BAUDRATE_FPCLK_DIV_8,
+    SPI_CR1_BAUDRATE_FPCLK_DIV_16,
+    SPI_CR1_BAUDRATE_FPCLK_DIV_32,
+    SPI_CR1_BAUDRATE_FPCLK_DIV_64,
+    SPI_CR1_BAUDRATE_FPCLK_DIV_128,
+    SPI_CR1_BAUDRATE_FPCLK_DIV_256,
+};
+#define PRESCALERS (sizeof(prescaler_setting)/sizeof(prescaler_setting[0]))
+
+/* Block sent and received, halfword aligned for the 16 bit frames */
+static uint16_t tx_block[BLOCK_SIZE/2];
+static uint16_t rx_block[BLOCK_SIZE/2];
+
+/* Cycles taken by IDLE_CALIBRATION passes of the idle loop */
+static uint32_t idle_cycles;
+
+/* Interrupt mode transfer state, shared with the SPI2 ISR */
+static volatile uint16_t frames_sent;
+static volatile uint16_t frames_received;
+static uint16_t frames;
+static bool wide;
+static volatile bool transfer_done;
+
+/*--------------------------------------------------------------------------*/
+
+int main(void)
+{
+    uint16_t i;
+    uint8_t *tx_bytes = (uint8_t *) tx_block;
+    for (i = 0; i < BLOCK_SIZE; i++) {
+        tx_bytes[i] = (uint8_t) (i * 7 + 1);
+    }
+
+    clock_setup();
+    buffer_init(send_buffer, BUFFER_SIZE);
+    buffer_init(receive_buffer, BUFFER_SIZE);
+    usart_setup();
+    spi_setup();
+    dwt_enable_cycle_counter();
+
+/* Time the idle loop with nothing to end it */
+    bool never = false;
+    uint32_t start = DWT_CYCCNT;
+    idle_wait(&never, IDLE_CALIBRATION);
+    idle_cycles = DWT_CYCCNT - start;
+
+    usart_print_string("SPI Benchmark\n\r");
+
+    while (1) {
+        run_benchmark();
+        usart_print_string("Any key to repeat\n\r");
+        while (buffer_get(receive_buffer) == BUFFER_EMPTY);
+    }
+
+    return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Run all Tests and print the Table
+
+*/
+
+static void run_benchmark(void)
+{
+    uint8_t mode;
+    uint8_t prescaler;
+    format_buffer(send_buffer, "\n\r%d byte transfers, idle loop %d cycles/%d\n\r",
+                  BLOCK_SIZE, idle_cycles, IDLE_CALIBRATION);
+    usart_print_string("mode       bits    SCK Hz   bytes/s  CPU %  errors\n\r");
+    for (mode = MODE_POLLED; mode <= MODE_DMA; mode++) {
+        for (prescaler = 0; prescaler < PRESCALERS; prescaler++) {
+            run_test(mode, false, prescaler);
+            run_test(mode, true, prescaler);
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Run one Test and print its Line of the Table
+
+The USART is allowed to finish what it is sending so that its interrupt does
+not steal time from the transfer.
+
+@param[in] mode: MODE_POLLED, MODE_INTERRUPT or MODE_DMA.
+@param[in] frame_16bit: true for halfword frames, false for bytes.
+@param[in] prescaler: index into prescaler_setting.
+*/
+
+static void run_test(uint8_t mode, bool frame_16bit, uint8_t prescaler)
+{
+    uint32_t cycles = 0;
+    uint32_t idle = 0;
+    uint16_t errors = 0;
+    uint16_t i;
+
+    memset(rx_block, 0, sizeof(rx_block));
+    spi_bus_set_baudrate(&spi_bus2, prescaler_setting[prescaler]);
+    usart_flush();
+    switch (mode) {
+        case MODE_POLLED:
+            cycles = transfer_polled(frame_16bit);
+            break;
+        case MODE_INTERRUPT:
+            cycles = transfer_interrupt(frame_16bit, &idle);
+            break;
+        case MODE_DMA:
+            cycles = transfer_dma(frame_16bit, &idle);
+            break;
+        default:
+            ;
+    }
+
+    uint8_t *tx_bytes = (uint8_t *) tx_block;
+    uint8_t *rx_bytes = (uint8_t *) rx_block;
+    for (i = 0; i < BLOCK_SIZE; i++) {
+        if (rx_bytes[i] != tx_bytes[i]) errors++;
+    }
+
+/* Idle time from the passes of the idle loop, limited in case of a slower
+pass during the transfer */
+    uint32_t idle_time = (uint32_t) (((uint64_t) idle * idle_cycles) /
+                                     IDLE_CALIBRATION);
+    if (idle_time > cycles) idle_time = cycles;
+    uint32_t busy = (uint32_t) (((uint64_t) (cycles - idle_time) * 100) /
+                                cycles);
+    uint32_t rate = (uint32_t) (((uint64_t) BLOCK_SIZE * CPU_CLOCK) / cycles);
+
+    format_buffer(send_buffer, "%-10s %4d %9d %9d %6d %7d\n\r",
+                  mode_name[mode], frame_16bit ? 16 : 8,
+                  SPI2_CLOCK >> (prescaler + 1), rate, busy, errors);
+    usart_enable_tx_interrupt(USART1);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Idle Loop
+
+Count passes until the transfer is done or the limit is reached. Kept out of
+line so that the calibration and the transfers time the same code.
+
+@param[in] done: set when the transfer has finished.
+@param[in] limit: most passes to make.
+@returns number of passes made.
+*/
+
+static uint32_t __attribute__((noinline)) idle_wait(volatile bool *done,
+                                                     uint32_t limit)
+{
+    uint32_t count = 0;
+    while (!*done && (count < limit)) count++;
+    return count;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Polled Transfer
+
+@param[in] frame_16bit: true for halfword frames, false for bytes.
+@returns cycles taken.
+*/
+
+static uint32_t transfer_polled(bool frame_16bit)
+{
+    uint16_t i;
+    uint8_t *tx_bytes = (uint8_t *) tx_block;
+    uint8_t *rx_bytes = (uint8_t *) rx_block;
+    spi_bus_set_frame(&spi_bus2, frame_16bit);
+    uint32_t start = DWT_CYCCNT;
+    if (frame_16bit) {
+        for (i = 0; i < BLOCK_SIZE/2; i++) {
+            while ((SPI_SR(SPI2) & SPI_SR_TXE) == 0);
+            SPI_DR(SPI2) = tx_block[i];
+            while ((SPI_SR(SPI2) & SPI_SR_RXNE) == 0);
+            rx_block[i] = SPI_DR(SPI2);
+        }
+    } else {
+        for (i = 0; i < BLOCK_SIZE; i++) {
+            while ((SPI_SR(SPI2) & SPI_SR_TXE) == 0);
+            SPI_DR(SPI2) = tx_bytes[i];
+            while ((SPI_SR(SPI2) & SPI_SR_RXNE) == 0);
+            rx_bytes[i] = SPI_DR(SPI2);
+        }
+    }
+    return DWT_CYCCNT - start;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Interrupt Transfer
+
+The first frame is written here and the rest by the ISR.
+
+@param[in] frame_16bit: true for halfword frames, false for bytes.
+@param[out] idle: passes of the idle loop.
+@returns cycles taken.
+*/
+
+static uint32_t transfer_interrupt(bool frame_16bit, uint32_t *idle)
+{
+    spi_bus_set_frame(&spi_bus2, frame_16bit);
+    wide = frame_16bit;
+    frames = frame_16bit ? BLOCK_SIZE/2 : BLOCK_SIZE;
+    frames_sent = 1;
+    frames_received = 0;
+    transfer_done = false;
+    uint32_t start = DWT_CYCCNT;
+    spi_enable_rx_buffer_not_empty_interrupt(SPI2);
+    SPI_DR(SPI2) = frame_16bit ? tx_block[0] : ((uint8_t *) tx_block)[0];
+    *idle = idle_wait(&transfer_done, 0xFFFFFFFF);
+    return DWT_CYCCNT - start;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief DMA Transfer
+
+@param[in] frame_16bit: true for halfword frames, false for bytes.
+@param[out] idle: passes of the idle loop.
+@returns cycles taken.
+*/
+
+static uint32_t transfer_dma(bool frame_16bit, uint32_t *idle)
+{
+    spi_transaction_t transaction = {
+        .tx = tx_block,
+        .rx = rx_block,
+        .length = frame_16bit ? BLOCK_SIZE/2 : BLOCK_SIZE,
+        .flags = frame_16bit ? SPI_FRAME_16BIT : 0,
+    };
+/* Set the frame size beforehand so that it is not part of the timing */
+    spi_bus_set_frame(&spi_bus2, frame_16bit);
+    uint32_t start = DWT_CYCCNT;
+    spi_bus_submit(&spi_bus2, &transaction);
+    *idle = idle_wait(&transaction.done, 0xFFFFFFFF);
+    return DWT_CYCCNT - start;
+}
+
+/*--------------------------------------------------------------------------*/
+/* SPI2 ISR for the interrupt mode. Each frame received is stored and the next
+sent, until the last is received. */
+
+void spi2_isr(void)
+{
+    if (SPI_SR(SPI2) & SPI_SR_RXNE) {
+        uint16_t frame = SPI_DR(SPI2);
+        if (wide) rx_block[frames_received] = frame;
+        else ((uint8_t *) rx_block)[frames_received] = frame;
+        frames_received++;
+        if (frames_sent < frames) {
+            SPI_DR(SPI2) = wide ? tx_block[frames_sent] :
+                                  ((uint8_t *) tx_block)[frames_sent];
+            frames_sent++;
+        }
+        else {
+            spi_disable_rx_buffer_not_empty_interrupt(SPI2);
+            transfer_done = true;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+static void clock_setup(void)
+{
+    rcc_clock_setup_in_hse_8mhz_out_72mhz();
+}
+
+/*--------------------------------------------------------------------------*/
+static void spi_setup(void)
+{
+/* SPI2 on SCK=PB13, MISO=PB14 and MOSI=PB15 in Master mode, MSB first, with
+the clock idle low and data valid on the first edge. The frame size and baud
+rate are set for each test. */
+    spi_bus_setup(&spi_bus2, SPI_CR1_BAUDRATE_FPCLK_DIV_256,
+            SPI_CR1_CPOL_CLK_TO_0_WHEN_IDLE, SPI_CR1_CPHA_CLK_TRANSITION_1);
+    IRQ_PRIORITY_SET(NVIC_DMA1_CHANNEL4_IRQ, IRQ_LEVEL_DMA);
+    IRQ_PRIORITY_SET(NVIC_SPI2_IRQ, IRQ_LEVEL_DMA);
+    nvic_enable_irq(NVIC_SPI2_IRQ);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief USART Setup
+
+USART 1 is configured for 115200 baud, no flow control, and interrupts.
+*/
+
+static void usart_setup(void)
+{
+/* Enable clocks for GPIO port A (for GPIO_USART1_TX) and USART1. */
+    rcc_peripheral_enable_clock(&RCC_APB2ENR, RCC_APB2ENR_IOPAEN |
+                    RCC_APB2ENR_AFIOEN | RCC_APB2ENR_USART1EN);
+/* The USART interrupt is below the SPI interrupts. */
+    IRQ_PRIORITY_SET(NVIC_USART1_IRQ, IRQ_LEVEL_COMM);
+    nvic_enable_irq(NVIC_USART1_IRQ);
+    gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ,
+              GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO_USART1_TX);
+    gpio_set_mode(GPIOA, GPIO_MODE_INPUT,
+              GPIO_CNF_INPUT_FLOAT, GPIO_USART1_RX);
+    usart_set_baudrate(USART1, 115200);
+    usart_set_databits(USART1, 8);
+    usart_set_stopbits(USART1, USART_STOPBITS_1);
+    usart_set_parity(USART1, USART_PARITY_NONE);
+    usart_set_flow_control(USART1, USART_FLOWCONTROL_NONE);
+    usart_set_mode(USART1, USART_MODE_TX_RX);
+    usart_enable_rx_interrupt(USART1);
+    usart_disable_tx_interrupt(USART1);
+    usart_enable(USART1);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Print a String
+
+*/
+
+static void usart_print_string(char *ch)
+{
+    uint16_t length = strlen(ch);
+/* Wait for space as needed, and keep the transmitter going meanwhile */
+    while (length > 0)
+    {
+        uint16_t n = buffer_put_n(send_buffer, (uint8_t *) ch, length);
+        ch += n;
+        length -= n;
+        usart_enable_tx_interrupt(USART1);
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Wait for the USART to send everything
+
+*/
+
+static void usart_flush(void)
+{
+    usart_enable_tx_interrupt(USART1);
+    while (buffer_count(send_buffer) > 0);
+    while ((USART_SR(USART1) & USART_SR_TC) == 0);
+}
+
+/*-----------------------------------------------------------*/
+/* USART ISR */
+void usart1_isr(void)
+{
+    if (usart_get_flag(USART1,USART_SR_RXNE))
+    {
+/* If buffer full we'll just drop it */
+        buffer_put(receive_buffer, (uint8_t) usart_recv(USART1));
+    }
+    if (usart_get_flag(USART1,USART_SR_TXE))
+    {
+/* If buffer empty, disable the tx interrupt */
+        uint16_t data = buffer_get(send_buffer);
+        if (data == BUFFER_EMPTY)
+        {
+            usart_disable_tx_interrupt(USART1);
+        }
+        else
+        {
+            usart_send(USART1, data);
+        }
+    }
+}
@@ -21,35 +21,26 @@
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/usart.h>
-#include <libopencm3/stm32/dma.h>
 #include <libopencm3/cm3/nvic.h>
 #include <libopencm3/stm32/spi.h>
+#include <string.h>
 #include "buffer.h"
-
-#ifndef USE_16BIT_TRANSFERS
-#define USE_16BIT_TRANSFERS 1
-#endif
+#include "format.h"
+#include "spi_dma.h"
+#include "irq_priority.h"
 
 static void clock_setup(void);
 static void spi_setup(void);
-static void dma_int_enable(void);
-static void dma_setup(void);
 static void usart_setup(void);
 static void gpio_setup(void);
 static void print_register(uint32_t reg);
-static void usart_print_int(int value);
-static void usart_print_hex(uint16_t value);
 static void usart_print_string(char *ch);
-#if USE_16BIT_TRANSFERS
-static int spi_dma_transceive(uint16_t *tx_buf, int tx_len, uint16_t *rx_buf, int rx_len);
-#else
-static int spi_dma_transceive(uint8_t *tx_buf, int tx_len, uint8_t *rx_buf, int rx_len);
-#endif
+static void transfer_done(spi_transaction_t *transaction);
 
 #define BUFFER_SIZE 128
 
-uint8_t send_buffer[BUFFER_SIZE+3];
-uint8_t receive_buffer[BUFFER_SIZE+3];
+uint8_t send_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
+uint8_t receive_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
 
 /* This is for the counter state flag */
 typedef enum {
@@ -58,14 +49,8 @@ typedef enum {
     TX_DOWN_RX_DOWN
 } cnt_state;
 
-/* This is a global spi state flag */
-typedef enum {
-    NONE = 0,
-    ONE,
-    DONE
-} trans_status;
-
-volatile trans_status transceive_status;
+/* Counts the transactions completed, from the callback */
+volatile uint32_t transfers_done;
 
 /*--------------------------------------------------------------------------*/
 
@@ -73,81 +58,101 @@ int main(void)
 {
     int counter_tx = 0;
     int counter_rx = 0;
+    int common = 0;
+    bool wide = false;
 
     cnt_state counter_state = TX_UP_RX_HOLD;
 
     int i = 0;
 
-/* Transmit and Receive packets, set transmit to index and receive to known
-unused value to aid in debugging */
-#if USE_16BIT_TRANSFERS
-    uint16_t tx_packet[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-    uint16_t rx_packet[16] = {0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42,
-                              0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42};
-#else
-    uint8_t tx_packet[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-    uint8_t rx_packet[16] = {0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42,
-                             0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42};
-#endif
-
-    transceive_status = DONE;
+/* Transmit and Receive packets for 8 and 16 bit frames, set transmit to index
+and receive to known unused value to aid in debugging */
+    uint16_t tx_packet16[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    uint16_t rx_packet16[16];
+    uint8_t tx_packet8[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    uint8_t rx_packet8[16];
+
+/* The frames common to the tx and rx lengths go in a full duplex transaction.
+The rest go in a second transmit only or receive only transaction queued
+behind it and started from the DMA interrupt that ends the first. */
+    spi_transaction_t first = { .callback = transfer_done };
+    spi_transaction_t second = { .callback = transfer_done };
+    spi_transaction_t *last;
+
+    for (i = 0; i < 16; i++) {
+        rx_packet16[i] = 0x42;
+        rx_packet8[i] = 0x42;
+    }
 
     clock_setup();
     gpio_setup();
     usart_setup();
     usart_print_string("SPI-DMA Test\n\r");
     spi_setup();
-    dma_setup();
 
-/* Blink the LED (PA8) on the board with every transmitted byte. */
+/* Blink the LED (PA8) on the board with every transmitted packet. */
     while (1) {
 /* LED on/off */
         gpio_toggle(GPIOA, GPIO1);
 
 /* Print what is going to be sent on the SPI bus */
-        usart_print_string("Sending  packet (tx len: ");
-        usart_print_int(counter_tx);
+        usart_print_string(wide ? "Sending  16 bit" : "Sending  8 bit");
+        usart_print_string(" packet (tx len: ");
+        format_buffer(send_buffer, "%d", counter_tx);
         usart_print_string(")\n\r");
         for (i = 0; i < counter_tx; i++)
         {
-            usart_print_int(tx_packet[i]);
+            format_buffer(send_buffer, "%d", tx_packet8[i]);
             usart_print_string(" ");
         }
         usart_print_string("\r\n");
 
-/* Start a transceive */
-        if (spi_dma_transceive(tx_packet, counter_tx, rx_packet, counter_rx)) {
-            usart_print_string("Attempted 0 length tx and rx packets\r\n");
+/* Queue the transactions. In loopback the receive only frames read back the
+dummy frames sent to drive the clock, all ones. */
+        common = (counter_tx < counter_rx) ? counter_tx : counter_rx;
+        first.flags = wide ? SPI_FRAME_16BIT : 0;
+        first.tx = wide ? (void *) tx_packet16 : (void *) tx_packet8;
+        first.rx = wide ? (void *) rx_packet16 : (void *) rx_packet8;
+        first.length = common;
+        second.flags = first.flags;
+        if (counter_tx > counter_rx) {
+            second.tx = wide ? (void *) (tx_packet16 + common) :
+                               (void *) (tx_packet8 + common);
+            second.rx = 0;
+            second.length = counter_tx - common;
+        } else {
+            second.tx = 0;
+            second.rx = wide ? (void *) (rx_packet16 + common) :
+                               (void *) (rx_packet8 + common);
+            second.length = counter_rx - common;
+        }
+        last = &first;
+        spi_bus_submit(&spi_bus2, &first);
+        if (spi_bus_submit(&spi_bus2, &second)) {
+            last = &second;
         }
 
-/* Wait until transceive complete.
- * This checks the state flag as well as follows the
- * procedure on the Reference Manual (RM0008 rev 14
- * Section 25.3.9 page 692, the note.)
- */
-        while (transceive_status != DONE)
-            ;
-        while (!(SPI_SR(SPI2) & SPI_SR_TXE))
-            ;
-        while (SPI_SR(SPI2) & SPI_SR_BSY)
-            ;
+/* Sleep until the last frame has been received. */
+        if (spi_bus_busy(&spi_bus2)) {
+            spi_transaction_wait(last);
+        }
 
 /* Print what was received on the SPI bus */
         usart_print_string("Received Packet (rx len ");
-        usart_print_int(counter_rx);
-        usart_print_string(")\n\r");
+        format_buffer(send_buffer, "%d", counter_rx);
+        usart_print_string(", ");
+        format_buffer(send_buffer, "%d", transfers_done);
+        usart_print_string(" transactions done)\n\r");
         for (i = 0; i < 16; i++) {
-            usart_print_int(rx_packet[i]);
+            format_buffer(send_buffer, "%d", wide ? rx_packet16[i] : rx_packet8[i]);
             usart_print_string(" ");
         }
         usart_print_string("\r\n\r\n");
 
 /* Update counters
- * If we use the loopback method, we can not
- * have a rx length longer than the tx length.
- * Testing rx lengths longer than tx lengths
- * requires an actual slave device that will
- * return data.
+ * Lengths of rx beyond tx are clocked by a dummy transmit, and of tx beyond rx
+ * are received and discarded, so any pair of lengths can be tested in
+ * loopback. The frame size alternates between packets.
  */
         switch (counter_state) {
             case TX_UP_RX_HOLD:
@@ -172,10 +177,12 @@ unused value to aid in debugging */
             default:
                 ;
         }
+        wide = !wide;
 
 /* Reset receive buffer for consistency */
         for (i = 0; i < 16; i++) {
-            rx_packet[i] = 0x42;
+            rx_packet16[i] = 0x42;
+            rx_packet8[i] = 0x42;
         }        
     }
 
@@ -191,13 +198,6 @@ static void clock_setup(void)
     rcc_peripheral_enable_clock(&RCC_APB2ENR,
                     RCC_APB2ENR_IOPAEN | RCC_APB2ENR_IOPBEN |
                     RCC_APB2ENR_IOPCEN);
-
-/* Enable SPI2 Periph */
-    rcc_peripheral_enable_clock(&RCC_APB1ENR,
-                    RCC_APB1ENR_SPI2EN);
-
-/* Enable DMA1 clock */
-    rcc_peripheral_enable_clock(&RCC_AHBENR, RCC_AHBENR_DMA1EN);
 }
 
 /*--------------------------------------------------------------------------*/
@@ -211,169 +211,27 @@ static void gpio_setup(void)
 /*--------------------------------------------------------------------------*/
 static void spi_setup(void) {
 
-/* Configure GPIOs: SS=PB12, SCK=PB13, MISO=PB14 and MOSI=PB15
- * For now ignore the SS pin so we can use it to time the ISRs
- */
-    gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_50_MHZ,
-            GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, /* GPIO4 | */
-                                            GPIO13 |
-                                            GPIO15 );
-
-    gpio_set_mode(GPIOB, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT,
-            GPIO14);
-
-/* Reset SPI, SPI_CR1 register cleared, SPI is disabled */
-    spi_reset(SPI2);
-
-/* Explicitly disable I2S in favour of SPI operation */
-    SPI2_I2SCFGR = 0;
-
-/* Set up SPI in Master mode with:
+/* Set up SPI2 on SCK=PB13, MISO=PB14 and MOSI=PB15 in Master mode with:
  * Clock baud rate: 1/64 of peripheral clock frequency
  * Clock polarity: Idle High
  * Clock phase: Data valid on 2nd clock pulse
- * Data frame format: 8-bit or 16-bit
  * Frame format: MSB First
+ * The data frame format, 8-bit or 16-bit, is set by each transaction.
+ * The SS pin PB12 is not used as a chip select, so it can be used to time the
+ * ISRs.
  */
-#if USE_16BIT_TRANSFERS
-    spi_init_master(SPI2, SPI_CR1_BAUDRATE_FPCLK_DIV_64, SPI_CR1_CPOL_CLK_TO_1_WHEN_IDLE,
-            SPI_CR1_CPHA_CLK_TRANSITION_2, SPI_CR1_DFF_16BIT, SPI_CR1_MSBFIRST);
-#else
-    spi_init_master(SPI2, SPI_CR1_BAUDRATE_FPCLK_DIV_64, SPI_CR1_CPOL_CLK_TO_1_WHEN_IDLE,
-            SPI_CR1_CPHA_CLK_TRANSITION_2, SPI_CR1_DFF_8BIT, SPI_CR1_MSBFIRST);
-#endif
-
-/*
- * Set NSS management to software.
- *
- * Note:
- * Setting nss high is very important, even if we are controlling the GPIO
- * ourselves this bit needs to be at least set to 1, otherwise the spi
- * peripheral will not send any data out.
- */
-    spi_enable_software_slave_management(SPI2);
-    spi_set_nss_high(SPI2);
-
-/* Enable SPI2 periph. */
-    spi_enable(SPI2);
+    spi_bus_setup(&spi_bus2, SPI_CR1_BAUDRATE_FPCLK_DIV_64,
+            SPI_CR1_CPOL_CLK_TO_1_WHEN_IDLE, SPI_CR1_CPHA_CLK_TRANSITION_2);
+    IRQ_PRIORITY_SET(NVIC_DMA1_CHANNEL4_IRQ, IRQ_LEVEL_DMA);
 }
 
 /*--------------------------------------------------------------------------*/
-static void dma_int_enable(void) {
-/* SPI2 RX on DMA1 Channel 2 */
-     nvic_set_priority(NVIC_DMA1_CHANNEL4_IRQ, 0);
-    nvic_enable_irq(NVIC_DMA1_CHANNEL4_IRQ);
-/* SPI2 TX on DMA1 Channel 3 */
-    nvic_set_priority(NVIC_DMA1_CHANNEL5_IRQ, 0);
-    nvic_enable_irq(NVIC_DMA1_CHANNEL5_IRQ);
-}
-
-/*--------------------------------------------------------------------------*/
-
-static void dma_setup(void)
+/* SPI transaction completed, called from the RX DMA interrupt */
+static void transfer_done(spi_transaction_t *transaction)
 {
-    dma_int_enable();    
-}
-
-/*--------------------------------------------------------------------------*/
-#if USE_16BIT_TRANSFERS
-static int spi_dma_transceive(uint16_t *tx_buf, int tx_len, uint16_t *rx_buf, int rx_len)
-#else
-static int spi_dma_transceive(uint8_t *tx_buf, int tx_len, uint8_t *rx_buf, int rx_len)
-#endif
-{
-/* Check for 0 length in both tx and rx */
-    if ((rx_len < 1) && (tx_len < 1)) {
-/* return -1 as error */
-        return -1;
-    }
-
-/* Reset DMA channels*/
-    dma_channel_reset(DMA1, DMA_CHANNEL4);
-    dma_channel_reset(DMA1, DMA_CHANNEL5);
-
-/* Reset SPI data and status registers.
- * Here we assume that the SPI peripheral is NOT
- * busy any longer, i.e. the last activity was verified
- * complete elsewhere in the program.
- */
-    volatile uint8_t temp_data __attribute__ ((unused));
-    while (SPI_SR(SPI2) & (SPI_SR_RXNE | SPI_SR_OVR)) {
-        temp_data = SPI_DR(SPI2);
-    }
-
-/* Reset status flag appropriately (both 0 case caught above) */
-    transceive_status = NONE;
-    if (rx_len < 1) {
-        transceive_status = ONE;
-    }
-    if (tx_len < 1) {
-        transceive_status = ONE;
-    }
-
-/* Set up rx dma, note it has higher priority to avoid overrun */
-    if (rx_len > 0) {
-        dma_set_peripheral_address(DMA1, DMA_CHANNEL4, (uint32_t)&SPI2_DR);
-        dma_set_memory_address(DMA1, DMA_CHANNEL4, (uint32_t)rx_buf);
-        dma_set_number_of_data(DMA1, DMA_CHANNEL4, rx_len);
-        dma_set_read_from_peripheral(DMA1, DMA_CHANNEL4);
-        dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL4);
-#if USE_16BIT_TRANSFERS
-        dma_set_peripheral_size(DMA1, DMA_CHANNEL4, DMA_CCR_PSIZE_16BIT);
-        dma_set_memory_size(DMA1, DMA_CHANNEL4, DMA_CCR_MSIZE_16BIT);
-#else
-        dma_set_peripheral_size(DMA1, DMA_CHANNEL4, DMA_CCR_PSIZE_8BIT);
-        dma_set_memory_size(DMA1, DMA_CHANNEL4, DMA_CCR_MSIZE_8BIT);
-#endif
-        dma_set_priority(DMA1, DMA_CHANNEL4, DMA_CCR_PL_VERY_HIGH);
-    }
-
-/* Set up tx dma */
-    if (tx_len > 0) {
-        dma_set_peripheral_address(DMA1, DMA_CHANNEL5, (uint32_t)&SPI2_DR);
-        dma_set_memory_address(DMA1, DMA_CHANNEL5, (uint32_t)tx_buf);
-        dma_set_number_of_data(DMA1, DMA_CHANNEL5, tx_len);
-        dma_set_read_from_memory(DMA1, DMA_CHANNEL5);
-        dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL5);
-#if USE_16BIT_TRANSFERS
-        dma_set_peripheral_size(DMA1, DMA_CHANNEL5, DMA_CCR_PSIZE_16BIT);
-        dma_set_memory_size(DMA1, DMA_CHANNEL5, DMA_CCR_MSIZE_16BIT);
-#else
-        dma_set_peripheral_size(DMA1, DMA_CHANNEL5, DMA_CCR_PSIZE_8BIT);
-        dma_set_memory_size(DMA1, DMA_CHANNEL5, DMA_CCR_MSIZE_8BIT);
-#endif
-        dma_set_priority(DMA1, DMA_CHANNEL5, DMA_CCR_PL_HIGH);
-    }
-
-/* Enable dma transfer complete interrupts */
-    if (rx_len > 0) {
-        dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL4);
-    }
-    if (tx_len > 0) {
-        dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL5);
-    }
-
-/* Activate dma channels */
-    if (rx_len > 0) {
-        dma_enable_channel(DMA1, DMA_CHANNEL4);
-    }
-    if (tx_len > 0) {
-        dma_enable_channel(DMA1, DMA_CHANNEL5);
-    }
-
-/* Enable the spi transfer via dma
- * This will immediately start the transmission,
- * after which when the receive is complete, the
- * receive dma will activate
- */
-    if (rx_len > 0) {
-        spi_enable_rx_dma(SPI2);
-    }
-    if (tx_len > 0) {
-        spi_enable_tx_dma(SPI2);
-    }
-
-    return 0;
+    (void) transaction;
+    gpio_toggle(GPIOA, GPIO2);
+    transfers_done++;
 }
 
 /*--------------------------------------------------------------------------*/
@@ -416,9 +274,7 @@ void usart_setup(void)
 
 void print_register(uint32_t reg)
 {
-    usart_print_hex((reg >> 16) & 0xFFFF);
-    usart_print_hex((reg >> 00) & 0xFFFF);
-    buffer_put(send_buffer, ' ');
+    format_buffer(send_buffer, "%04X %04X  ", (reg >> 16) & 0xFFFF, reg & 0xFFFF);
     usart_enable_tx_interrupt(USART1);
 }
 
@@ -427,56 +283,12 @@ void print_register(uint32_t reg)
 
 */
 
-void usart_print_int(int value)
-{
-    uint8_t i;
-    uint8_t nr_digits = 0;
-    char buffer[25];
-
-    if (value < 0)
-    {
-        while (!buffer_output_free(send_buffer));
-        buffer_put(send_buffer, '-');
-        value = value * -1;
-    }
-    if (value == 0) buffer[nr_digits++] = '0';
-    else while (value > 0)
-    {
-        buffer[nr_digits++] = "0123456789"[value % 10];
-        value /= 10;
-    }
-    for (i = nr_digits; i > 0; i--)
-    {
-        while (!buffer_output_free(send_buffer));
-        buffer_put(send_buffer, buffer[i-1]);
-    }
-//    buffer_put(send_buffer, ' ');
-    usart_enable_tx_interrupt(USART1);
-}
 
 /*--------------------------------------------------------------------------*/
 /** @brief Print out a value in ASCII hex form
 
 */
 
-void usart_print_hex(uint16_t value)
-{
-    uint8_t i;
-    char buffer[25];
-
-    for (i = 0; i < 4; i++)
-    {
-        buffer[i] = "0123456789ABCDEF"[value & 0xF];
-        value >>= 4;
-    }
-    for (i = 4; i > 0; i--)
-    {
-        while (!buffer_output_free(send_buffer));
-        buffer_put(send_buffer, buffer[i-1]);
-    }
-    buffer_put(send_buffer, ' ');
-    usart_enable_tx_interrupt(USART1);
-}
 
 /*--------------------------------------------------------------------------*/
 /** @brief Print a String
@@ -485,53 +297,15 @@ void usart_print_hex(uint16_t value)
 
 void usart_print_string(char *ch)
 {
-      while(*ch)
+    uint16_t length = strlen(ch);
+/* Wait for space as needed, and keep the transmitter going meanwhile */
+    while (length > 0)
     {
-        while (!buffer_output_free(send_buffer));
-         buffer_put(send_buffer, *ch);
-         ch++;
-      }
-    usart_enable_tx_interrupt(USART1);
-}
-
-/*--------------------------------------------------------------------------*/
-/* SPI receive completed with DMA */
-void dma1_channel4_isr(void)
-{
-    gpio_set(GPIOA,GPIO2);
-    if ((DMA1_ISR &DMA_ISR_TCIF2) != 0) {
-        DMA1_IFCR |= DMA_IFCR_CTCIF2;
-    }
-
-    dma_disable_transfer_complete_interrupt(DMA1, DMA_CHANNEL4);
-
-    spi_disable_rx_dma(SPI2);
-
-    dma_disable_channel(DMA1, DMA_CHANNEL4);
-
-    /* Increment the status to indicate one of the transfers is complete */
-    transceive_status++;
-    gpio_clear(GPIOA,GPIO2);
-}
-
-/*--------------------------------------------------------------------------*/
-/* SPI transmit completed with DMA */
-void dma1_channel5_isr(void)
-{
-    gpio_set(GPIOA,GPIO3);
-    if ((DMA1_ISR &DMA_ISR_TCIF3) != 0) {
-        DMA1_IFCR |= DMA_IFCR_CTCIF3;
+        uint16_t n = buffer_put_n(send_buffer, (uint8_t *) ch, length);
+        ch += n;
+        length -= n;
+        usart_enable_tx_interrupt(USART1);
     }
-
-    dma_disable_transfer_complete_interrupt(DMA1, DMA_CHANNEL5);
-
-    spi_disable_tx_dma(SPI2);
-
-    dma_disable_channel(DMA1, DMA_CHANNEL5);
-
-/* Increment the status to indicate one of the transfers is complete */
-    transceive_status++;
-    gpio_clear(GPIOA,GPIO3);
 }
 
 /*-----------------------------------------------------------*/
@@ -24,7 +24,9 @@
 #include <libopencm3/stm32/dma.h>
 #include <libopencm3/cm3/nvic.h>
 #include <libopencm3/stm32/spi.h>
+#include <string.h>
 #include "buffer.h"
+#include "format.h"
 
 #ifndef USE_16BIT_TRANSFERS
 #define USE_16BIT_TRANSFERS 1
@@ -35,14 +37,12 @@ static void spi_setup(void);
 static void usart_setup(void);
 static void gpio_setup(void);
 static void print_register(uint32_t reg);
-static void usart_print_int(int value);
-static void usart_print_hex(uint16_t value);
 static void usart_print_string(char *ch);
 
 #define BUFFER_SIZE 128
 
-uint8_t send_buffer[BUFFER_SIZE+3];
-uint8_t receive_buffer[BUFFER_SIZE+3];
+uint8_t send_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
+uint8_t receive_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
 
 /*--------------------------------------------------------------------------*/
 
@@ -69,12 +69,12 @@ int main(void)
 #ifdef LOOPBACK
 		/* Print what is going to be sent on the SPI bus */
 		usart_print_string("Sending  packet ");
-        usart_print_int(counter);
+        format_buffer(send_buffer, "%d", counter);
         usart_print_string("\n\r");
 		spi_send(SPI2, (uint8_t) counter);
 		rx_value = spi_read(SPI2);
 		usart_print_string("Received  packet ");
-        usart_print_int(rx_value);
+        format_buffer(send_buffer, "%d", rx_value);
         usart_print_string("\n\r");
         counter++;
 #else
@@ -201,9 +201,7 @@ void usart_setup(void)
 
 void print_register(uint32_t reg)
 {
-	usart_print_hex((reg >> 16) & 0xFFFF);
-	usart_print_hex((reg >> 00) & 0xFFFF);
-	buffer_put(send_buffer, ' ');
+	format_buffer(send_buffer, "%04X %04X  ", (reg >> 16) & 0xFFFF, reg & 0xFFFF);
 	usart_enable_tx_interrupt(USART1);
 }
 
@@ -212,56 +210,12 @@ void print_register(uint32_t reg)
 
 */
 
-void usart_print_int(int value)
-{
-	uint8_t i;
-	uint8_t nr_digits = 0;
-	char buffer[25];
-
-	if (value < 0)
-	{
-        while (!buffer_output_free(send_buffer));
-		buffer_put(send_buffer, '-');
-		value = value * -1;
-	}
-	if (value == 0) buffer[nr_digits++] = '0';
-	else while (value > 0)
-	{
-		buffer[nr_digits++] = "0123456789"[value % 10];
-		value /= 10;
-	}
-	for (i = nr_digits; i > 0; i--)
-	{
-        while (!buffer_output_free(send_buffer));
-		buffer_put(send_buffer, buffer[i-1]);
-	}
-//	buffer_put(send_buffer, ' ');
-	usart_enable_tx_interrupt(USART1);
-}
 
 /*--------------------------------------------------------------------------*/
 /** @brief Print out a value in ASCII hex form
 
 */
 
-void usart_print_hex(uint16_t value)
-{
-	uint8_t i;
-	char buffer[25];
-
-	for (i = 0; i < 4; i++)
-	{
-		buffer[i] = "0123456789ABCDEF"[value & 0xF];
-		value >>= 4;
-	}
-	for (i = 4; i > 0; i--)
-	{
-        while (!buffer_output_free(send_buffer));
-		buffer_put(send_buffer, buffer[i-1]);
-	}
-	buffer_put(send_buffer, ' ');
-	usart_enable_tx_interrupt(USART1);
-}
 
 /*--------------------------------------------------------------------------*/
 /** @brief Print a String
@@ -270,13 +224,15 @@ void usart_print_hex(uint16_t value)
 
 void usart_print_string(char *ch)
 {
-  	while(*ch)
+	uint16_t length = strlen(ch);
+/* Wait for space as needed, and keep the transmitter going meanwhile */
+	while (length > 0)
 	{
-        while (!buffer_output_free(send_buffer));
-     	buffer_put(send_buffer, *ch);
-     	ch++;
-  	}
-	usart_enable_tx_interrupt(USART1);
+		uint16_t n = buffer_put_n(send_buffer, (uint8_t *) ch, length);
+		ch += n;
+		length -= n;
+		usart_enable_tx_interrupt(USART1);
+	}
 }
 
 /*-----------------------------------------------------------*/
@@ -28,12 +28,10 @@ Smaller STM32F103 devices as in the ET dev board do not have DAC.
 #include <libopencm3/cm3/nvic.h>
 #include <libopencm3/stm32/dac.h>
 #include <libopencm3/stm32/dma.h>
+#include "wavetable.h"
 
 #define PERIOD 1152
 
-/* Globals */
-uint8_t v[256];
-
 /*--------------------------------------------------------------------*/
 void clock_setup(void)
 {
@@ -92,9 +90,9 @@ void dma_setup(void)
 	dma_set_read_from_memory(DMA2,DMA_CHANNEL3);
 /* The register to target is the DAC1 8-bit right justified data register */
 	dma_set_peripheral_address(DMA2,DMA_CHANNEL3,(uint32_t) &DAC_DHR8R1);
-/* The array v[] is filled with the waveform data to be output */
-	dma_set_memory_address(DMA2,DMA_CHANNEL3,(uint32_t) v);
-	dma_set_number_of_data(DMA2,DMA_CHANNEL3,256);
+/* The waveform is taken straight from its table in flash */
+	dma_set_memory_address(DMA2,DMA_CHANNEL3,(uint32_t) wavetable_8bit);
+	dma_set_number_of_data(DMA2,DMA_CHANNEL3,WAVETABLE_SIZE);
 	dma_enable_transfer_complete_interrupt(DMA2, DMA_CHANNEL3);
 	dma_enable_channel(DMA2,DMA_CHANNEL3);
 }
@@ -131,18 +129,6 @@ void dma2_channel3_isr(void)
 /*--------------------------------------------------------------------*/
 int main(void)
 {
-/* Fill the array with funky waveform data */
-/* This is for dual channel 8-bit right aligned */
-	uint32_t i, x;
-	for (i=0; i<256; i++)
-	{
-		if (i<10) x=10;
-		else if (i<121) x=10+((i*i)>>7);
-		else if (i<128) x=128;
-		else if (i<246) x=256-i;	
-		else x=10;
-		v[i] = x;
-	}
 	clock_setup();
 	gpio_setup();
 	timer_setup();
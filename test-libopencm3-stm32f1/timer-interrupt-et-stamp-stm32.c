@@ -32,6 +32,7 @@ The board used is the ET-STAMP-STM32
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/timer.h>
 #include <libopencm3/cm3/nvic.h>
+#include "irq_priority.h"
 
 /*--------------------------------------------------------------------------*/
 
@@ -55,7 +56,7 @@ void timer_setup(void)
 {
 	rcc_periph_clock_enable(RCC_TIM2);
 	nvic_enable_irq(NVIC_TIM2_IRQ);
-	nvic_set_priority(NVIC_TIM2_IRQ, 1);
+	IRQ_PRIORITY_SET(NVIC_TIM2_IRQ, IRQ_LEVEL_TIMER);
 	timer_reset(TIM2);
 /* Timer global mode: - No Divider, Alignment edge, Direction up */
 	timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT,
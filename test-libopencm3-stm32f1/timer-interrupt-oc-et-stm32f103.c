@@ -35,7 +35,6 @@ Timer 3 is setup without output compare to provide a timed interrupt.
 
 /* Globals */
 uint32_t cntr;
-uint8_t v[256];
 
 /*--------------------------------------------------------------------------*/
 
@@ -0,0 +1,259 @@
+/* STM32F4 Test of ADC triple interleaved transient capture
+
+ADC1, ADC2 and ADC3 convert the one channel in triple interleaved mode, each
+starting five ADC clocks after the one before, so that between them a sample
+is taken every five ADC clocks. The ADC clock is the 84MHz APB2 clock divided
+by four, 21MHz, as dividing by two would give 42MHz, above the datasheet limit
+of 36MHz. That is 4.2MSPS.
+
+DMA mode 2 of the common ADC packs two 12 bit samples into each word read from
+the common data register, in the order they were converted, and DMA2 stream 0
+writes the words in circular mode to a buffer of CAPTURE_SAMPLES samples. So
+the buffer always holds the latest samples with no CPU involvement.
+
+The trigger is the analog watchdog of ADC1, which interrupts when a sample of
+ADC1 falls outside the thresholds. It is only enabled once the buffer has been
+filled, so that the pre-trigger samples are valid. The interrupt takes the
+DMA position at the trigger, and the main loop then lets the DMA run on for
+the samples after the trigger before stopping the ADCs and DMA. The buffer
+then holds PRE_TRIGGER samples before the trigger and the rest after it,
+except for the few samples taken while stopping, which come out of the
+pre-trigger samples. The trigger is found in the data within the latency of
+the interrupt, about a microsecond.
+
+The oldest sample is at capture_start, with the buffer wrapping around, and
+the trigger is capture_trigger samples after it. The capture can be read with
+the debugger, for example by gdb "dump binary memory". Pressing the user
+button arms the next capture.
+
+STM32F4-Discovery board.
+The signal is placed at PA1 (ADC123 IN1).
+D12 lights while armed, D14 at the trigger and D13 when the capture is
+complete.
+
+14 October 2026
+*/
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+
+/* Samples held, two to each DMA word */
+#define CAPTURE_SAMPLES 32768
+#define CAPTURE_WORDS (CAPTURE_SAMPLES/2)
+/* Samples kept from before the trigger. This must leave room for those taken
+while the main loop stops the capture. */
+#define PRE_TRIGGER 4096
+#define POST_WORDS (CAPTURE_WORDS - PRE_TRIGGER/2)
+
+/* Analog watchdog thresholds, out of 4095 */
+#define THRESHOLD_HIGH 3000
+#define THRESHOLD_LOW 0
+
+/* Clock of the ADC from the 84MHz APB2 clock, 21MHz within the 36MHz limit */
+#define ADC_PRESCALE ADC_CCR_ADCPRE_BY4
+
+uint16_t capture_buffer[CAPTURE_SAMPLES] __attribute__((aligned(4)));
+/* Oldest sample, and the trigger counted in samples from it */
+uint32_t capture_start;
+uint32_t capture_trigger;
+/* Words written by the DMA at the trigger */
+volatile uint32_t trigger_word;
+volatile bool triggered;
+
+/*--------------------------------------------------------------------*/
+void clock_setup(void)
+{
+	rcc_clock_setup_hse_3v3(&hse_8mhz_3v3[CLOCK_3V3_168MHZ]);
+}
+
+/*--------------------------------------------------------------------*/
+void gpio_setup(void)
+{
+/* Clocks on AHB1 for GPIO D (LEDs) and A (button) */
+	rcc_periph_clock_enable(RCC_GPIOD);
+	rcc_periph_clock_enable(RCC_GPIOA);
+/* GPIO LED ports */
+	gpio_mode_setup(GPIOD, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE,
+		      GPIO12 | GPIO13 | GPIO14 | GPIO15);
+	gpio_set_output_options(GPIOD, GPIO_OTYPE_PP, GPIO_OSPEED_2MHZ,
+		      GPIO12 | GPIO13 | GPIO14 | GPIO15);
+/* User button PA0, which has an external pulldown */
+	gpio_mode_setup(GPIOA, GPIO_MODE_INPUT, GPIO_PUPD_NONE, GPIO0);
+}
+
+/*--------------------------------------------------------------------*/
+/* All three ADCs convert channel 1 continuously at the shortest sample time.
+ADC1 is the master and the other two follow its start. The analog watchdog of
+ADC1 watches the channel, with its interrupt enabled later. */
+void adc_setup(void)
+{
+	rcc_periph_clock_enable(RCC_ADC1);
+	rcc_periph_clock_enable(RCC_ADC2);
+	rcc_periph_clock_enable(RCC_ADC3);
+/* Set port PA1 for the ADCs to analogue mode. */
+	gpio_mode_setup(GPIOA, GPIO_MODE_ANALOG, GPIO_PUPD_NONE, GPIO1);
+	nvic_enable_irq(NVIC_ADC_IRQ);
+	uint8_t channel[1] = { ADC_CHANNEL1 };
+	adc_set_clk_prescale(ADC_PRESCALE);
+	adc_set_regular_sequence(ADC1, 1, channel);
+	adc_set_regular_sequence(ADC2, 1, channel);
+	adc_set_regular_sequence(ADC3, 1, channel);
+	adc_disable_scan_mode(ADC1);
+	adc_disable_scan_mode(ADC2);
+	adc_disable_scan_mode(ADC3);
+	adc_set_continuous_conversion_mode(ADC1);
+	adc_set_continuous_conversion_mode(ADC2);
+	adc_set_continuous_conversion_mode(ADC3);
+	adc_set_sample_time(ADC1, ADC_CHANNEL1, ADC_SMPR_SMP_3CYC);
+	adc_set_sample_time(ADC2, ADC_CHANNEL1, ADC_SMPR_SMP_3CYC);
+	adc_set_sample_time(ADC3, ADC_CHANNEL1, ADC_SMPR_SMP_3CYC);
+/* A conversion of 3 sample and 12 conversion clocks, shared between three
+ADCs, needs a delay of 5 clocks between them. DMA mode 2 packs two samples
+into each transfer, and DDS has the requests carry on after each DMA block. */
+	adc_set_multi_mode(ADC_CCR_MULTI_TRIPLE_INTERLEAVED);
+	ADC_CCR = (ADC_CCR & ~(ADC_CCR_DMA_MASK | ADC_CCR_DELAY_MASK)) |
+		  ADC_CCR_DMA_MODE_2 | ADC_CCR_DDS | ADC_CCR_DELAY_5ADCCLK;
+/* Analog watchdog on channel 1 of ADC1 */
+	adc_set_watchdog_high_threshold(ADC1, THRESHOLD_HIGH);
+	adc_set_watchdog_low_threshold(ADC1, THRESHOLD_LOW);
+	adc_enable_analog_watchdog_on_selected_channel(ADC1, ADC_CHANNEL1);
+	adc_enable_analog_watchdog_regular(ADC1);
+}
+
+/*--------------------------------------------------------------------*/
+/* ADC common data to DMA2 stream 0 channel 0, in words, circular over the
+buffer. */
+void dma_setup(void)
+{
+	rcc_periph_clock_enable(RCC_DMA2);
+	nvic_enable_irq(NVIC_DMA2_STREAM0_IRQ);
+	dma_stream_reset(DMA2,DMA_STREAM0);
+	dma_set_priority(DMA2,DMA_STREAM0,DMA_SxCR_PL_VERY_HIGH);
+	dma_set_peripheral_size(DMA2,DMA_STREAM0,DMA_SxCR_PSIZE_32BIT);
+	dma_set_peripheral_address(DMA2,DMA_STREAM0,(uint32_t) &ADC_CDR);
+	dma_set_memory_size(DMA2,DMA_STREAM0,DMA_SxCR_MSIZE_32BIT);
+	dma_set_memory_address(DMA2,DMA_STREAM0,(uint32_t) capture_buffer);
+	dma_set_number_of_data(DMA2,DMA_STREAM0,CAPTURE_WORDS);
+	dma_set_transfer_mode(DMA2,DMA_STREAM0, DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+	dma_enable_memory_increment_mode(DMA2,DMA_STREAM0);
+	dma_enable_circular_mode(DMA2,DMA_STREAM0);
+/* Don't use FIFO */
+	dma_enable_direct_mode(DMA2,DMA_STREAM0);
+	dma_channel_select(DMA2, DMA_STREAM0, DMA_SxCR_CHSEL_0);
+}
+
+/*--------------------------------------------------------------------*/
+/* Words written by the DMA since the start of the buffer */
+static uint32_t dma_position(void)
+{
+	return CAPTURE_WORDS - dma_get_number_of_data(DMA2, DMA_STREAM0);
+}
+
+/*--------------------------------------------------------------------*/
+/* Start the ADCs filling the buffer. The ADCs are powered up here each time
+as capture_stop powers them down to end the conversions. */
+void capture_arm(void)
+{
+	uint32_t i;
+	triggered = false;
+	adc_power_on(ADC1);
+	adc_power_on(ADC2);
+	adc_power_on(ADC3);
+/* Wait for the ADCs to stabilise. */
+	for (i = 0; i < 10000; i++) __asm__("nop");
+/* The transfer complete interrupt marks the buffer filled once. */
+	dma_clear_interrupt_flags(DMA2, DMA_STREAM0, DMA_TCIF | DMA_HTIF |
+				  DMA_TEIF | DMA_DMEIF | DMA_FEIF);
+	dma_enable_transfer_complete_interrupt(DMA2, DMA_STREAM0);
+	dma_enable_stream(DMA2,DMA_STREAM0);
+	gpio_set(GPIOD, GPIO12);
+	gpio_clear(GPIOD, GPIO13 | GPIO14);
+	adc_start_conversion_regular(ADC1);
+}
+
+/*--------------------------------------------------------------------*/
+/* Stop the ADCs and DMA, and note where the samples start in the buffer. The
+DMA position is read once the stream has stopped. */
+void capture_stop(void)
+{
+	adc_power_off(ADC1);
+	adc_power_off(ADC2);
+	adc_power_off(ADC3);
+	dma_disable_stream(DMA2, DMA_STREAM0);
+	while (DMA_SCR(DMA2, DMA_STREAM0) & DMA_SxCR_EN);
+	uint32_t end = dma_position() % CAPTURE_WORDS;
+	capture_start = 2*end;
+	capture_trigger = 2*((trigger_word + CAPTURE_WORDS - end) % CAPTURE_WORDS);
+/* Reload the stream for the next capture */
+	dma_set_memory_address(DMA2,DMA_STREAM0,(uint32_t) capture_buffer);
+	dma_set_number_of_data(DMA2,DMA_STREAM0,CAPTURE_WORDS);
+	gpio_clear(GPIOD, GPIO12);
+	gpio_set(GPIOD, GPIO13);
+}
+
+/*--------------------------------------------------------------------*/
+int main(void)
+{
+	clock_setup();
+	gpio_setup();
+	adc_setup();
+	dma_setup();
+	while (1) {
+		capture_arm();
+/* Sleep until triggered. Interrupts are masked around the test so that a
+trigger just before the wfi is not missed. */
+		cm_mask_interrupts(true);
+		while (! triggered) {
+			__asm__ __volatile__ ("wfi");
+			cm_mask_interrupts(false);
+			cm_mask_interrupts(true);
+		}
+		cm_mask_interrupts(false);
+/* Let the DMA run on for the samples after the trigger. The position wraps
+around the buffer, so the words written since the trigger are counted modulo
+its length. */
+		uint32_t elapsed;
+		do {
+			elapsed = (dma_position() + CAPTURE_WORDS - trigger_word)
+				  % CAPTURE_WORDS;
+		} while (elapsed < POST_WORDS);
+		capture_stop();
+/* Wait for the button to arm the next capture */
+		while (! gpio_get(GPIOA, GPIO0));
+		while (gpio_get(GPIOA, GPIO0));
+	}
+
+	return 0;
+}
+
+/*--------------------------------------------------------------------*/
+/* The buffer has been filled once, so the watchdog can now trigger. */
+void dma2_stream0_isr(void)
+{
+	if (dma_get_interrupt_flag(DMA2, DMA_STREAM0, DMA_TCIF))
+	{
+		dma_clear_interrupt_flags(DMA2, DMA_STREAM0, DMA_TCIF);
+		dma_disable_transfer_complete_interrupt(DMA2, DMA_STREAM0);
+		ADC_SR(ADC1) &= ~ADC_SR_AWD;
+		adc_enable_awd_interrupt(ADC1);
+	}
+}
+
+/*--------------------------------------------------------------------*/
+/* Analog watchdog trigger. Take the DMA position and disable the watchdog
+until the next capture. */
+void adc_isr(void)
+{
+	if (ADC_SR(ADC1) & ADC_SR_AWD)
+	{
+		trigger_word = dma_position() % CAPTURE_WORDS;
+		adc_disable_awd_interrupt(ADC1);
+		ADC_SR(ADC1) &= ~ADC_SR_AWD;
+		triggered = true;
+		gpio_set(GPIOD, GPIO14);
+	}
+}
@@ -2,9 +2,11 @@
 
 Blink LED at a different rate with analogue control.
 
-The ADC is setup for continuous conversion of a single channel. DMA is
+The ADC is setup for conversion of a single channel, started by the TRGO output
+of timer 2 at SAMPLE_RATE samples per second with no CPU involvement. DMA is
 setup in circular mode to fill an array. The first element of the array
-is taken to pace the flashing of the LEDs.
+is taken to pace the flashing of the LEDs. Leave SAMPLE_RATE undefined for
+continuous conversion at the full rate of the ADC.
 
 STM32F4-Discovery board.
 A variable voltage is placed at PA1 to adjust the analogue input.
@@ -34,7 +36,14 @@ Two LEDs D12 and D13 are flashed.
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/adc.h>
 #include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/timer.h>
 #include <libopencm3/cm3/nvic.h>
+#include "timebase.h"
+
+/* Samples per second started by timer 2 */
+#define SAMPLE_RATE 10000
+/* Timer 2 is clocked at twice the APB1 clock of 42MHz */
+#define TIMER_CLOCK 84000000
 
 uint32_t v[128];
 uint16_t cntr;
@@ -74,7 +83,13 @@ void adc_setup(void)
     adc_set_regular_sequence(ADC1, 1, channel);
     adc_set_clk_prescale(ADC_CCR_ADCPRE_BY2);
     adc_enable_scan_mode(ADC1);
+#ifdef SAMPLE_RATE
+    adc_set_single_conversion_mode(ADC1);
+    adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_TIM2_TRGO,
+                                        ADC_CR2_EXTEN_RISING_EDGE);
+#else
     adc_set_continuous_conversion_mode(ADC1);
+#endif
     adc_set_sample_time(ADC1, ADC_CHANNEL1, ADC_SMPR_SMP_3CYC);
 	adc_set_multi_mode(ADC_CCR_MULTI_INDEPENDENT);
 	adc_set_dma_continue(ADC1);
@@ -82,6 +97,24 @@ void adc_setup(void)
 	adc_enable_overrun_interrupt(ADC1);
 }
 
+/*--------------------------------------------------------------------*/
+/* Timer 2 runs through a period of one sample and pulses its trigger output
+TRGO on each update event, which starts the ADC. Timer 2 is 32 bits so no
+prescaler is needed. */
+#ifdef SAMPLE_RATE
+void timer_setup(void)
+{
+	rcc_periph_clock_enable(RCC_TIM2);
+	timer_reset(TIM2);
+	timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT,
+		       TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+	timer_continuous_mode(TIM2);
+	timer_set_period(TIM2, TIMER_CLOCK/SAMPLE_RATE - 1);
+	timer_set_master_mode(TIM2, TIM_CR2_MMS_UPDATE);
+	timer_enable_counter(TIM2);
+}
+#endif
+
 /*--------------------------------------------------------------------*/
 void dma_setup(void)
 {
@@ -111,22 +144,25 @@ void dma_setup(void)
 /*--------------------------------------------------------------------*/
 int main(void)
 {
-	uint32_t i,j;
-
 	cntr=4;
 	clock_setup();
+	time_init(true);
 	gpio_setup();
 	adc_setup();
 	dma_setup();
 /* Start of the ADC. Should continue indefinitely with DMA in circular mode */
+#ifdef SAMPLE_RATE
+	timer_setup();
+#else
     adc_start_conversion_regular(ADC1);
+#endif
 	while (1) {
 /* Blink the LED (PB8, PB9) on the board. */
-		uint32_t count = 500*v[1];
+		uint32_t half_period = 15*v[1];
 		gpio_toggle(GPIOD, GPIO12);
-		for (i = 0; i < count; i++) __asm__("nop");
+		delay_us(half_period);
 		gpio_toggle(GPIOD, GPIO13);
-		for (i = 0; i < count; i++) __asm__("nop");
+		delay_us(half_period);
 	}
 
 	return 0;
@@ -156,3 +192,10 @@ void adc_isr(void)
 	gpio_set(GPIOD, GPIO15);
 }
 
+/*--------------------------------------------------------------------*/
+/* SysTick keeps the timebase of the delays. */
+
+void sys_tick_handler(void)
+{
+	time_tick();
+}
@@ -0,0 +1,336 @@
+/* STM32F4 Test of a decimating filter on a stream of ADC blocks
+
+The ADC converts a single channel on each TRGO of timer 2 at SAMPLE_RATE, and
+DMA in circular mode fills a buffer of two halves, each a block of
+BLOCK_SAMPLES samples. The half transfer and transfer complete interrupts only
+count the blocks ready. The main loop passes each block through the CIC and
+FIR decimating filter of decimate.c in common while the DMA fills the other
+half, and sends the filtered samples of each block as a telemetry frame of
+telemetry.c. The host receives SAMPLE_RATE/(2*DECIMATION) samples per second
+of 16 bits, rather than the raw 12 bit samples, so the bandwidth is cut by the
+decimation while the resolution improves. The frames are read with
+common/telemetry_decode.py.
+
+The frames go out from a ring buffer on USART1 at 115200 baud (PA9), by the
+TXE interrupt. Blocks that were lost or overwritten before they were
+processed are counted in overruns.
+
+Built with USB_CDC=1 the frames go instead to the USB virtual COM port of
+usb_cdc.c in common, on the micro USB connector (CN5), and each raw block is
+also sent as TELEMETRY_ADC_12BIT records, so the host has the unfiltered
+signal as well as the filtered one. The frames are sent only while a terminal
+has the port open.
+
+Built with ISR_PROFILE=1 (and format.c in CFILES) the DMA and USART interrupt
+handlers are timed by isr_profile.c in common, and their summaries are sent
+as telemetry text records once a second.
+
+The filter state is in the core coupled memory and the filter and DMA handler
+run from RAM, by the attributes of mem_regions.h in common and the sections of
+stm32-hf407.ld, so that neither waits on the flash or contends with the DMA
+filling the ADC buffer.
+
+STM32F4-Discovery board.
+The signal is placed at PA1 (ADC123 IN1).
+D12 toggles with each block processed and D14 lights on an overrun.
+
+14 October 2026
+*/
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/usart.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+#include "buffer.h"
+#include "telemetry.h"
+#include "decimate.h"
+#include "isr_profile.h"
+#include "mem_regions.h"
+#ifdef USB_CDC
+#include "usb_cdc.h"
+#endif
+
+/* Samples per second started by timer 2 */
+#define SAMPLE_RATE 64000
+/* Timer 2 is clocked at twice the APB1 clock of 42MHz */
+#define TIMER_CLOCK 84000000
+/* CIC decimation ratio. The FIR halves the rate again. */
+#define DECIMATION 16
+/* Samples in each half of the DMA buffer */
+#define BLOCK_SAMPLES 512
+#define BLOCK_OUTPUTS (BLOCK_SAMPLES/(2*DECIMATION) + 1)
+
+#ifdef USB_CDC
+/* Room for a raw block and its filtered samples */
+#define SEND_RING_SIZE 4096
+/* Raw samples in each record, packed in 12 bits within the largest payload */
+#define RAW_RECORD_SAMPLES 128
+#else
+#define SEND_RING_SIZE 1024
+#endif
+/* Blocks between interrupt profile reports, about a second */
+#define PROFILE_BLOCKS (SAMPLE_RATE/BLOCK_SAMPLES)
+
+uint16_t adc_buffer[2*BLOCK_SAMPLES];
+/* Blocks completed by the DMA, counted by its interrupt */
+volatile uint32_t blocks_ready = 0;
+uint32_t overruns = 0;
+decimate_t filter CCM_DATA;
+uint8_t send_data[SEND_RING_SIZE] __attribute__((aligned(4)));
+ring_buffer_t send_ring;
+
+/*--------------------------------------------------------------------*/
+void clock_setup(void)
+{
+	rcc_clock_setup_hse_3v3(&hse_8mhz_3v3[CLOCK_3V3_168MHZ]);
+}
+
+/*--------------------------------------------------------------------*/
+void gpio_setup(void)
+{
+/* Clocks on AHB1 for GPIO D (LEDs) and A (USART1, ADC) */
+	rcc_periph_clock_enable(RCC_GPIOD);
+	rcc_periph_clock_enable(RCC_GPIOA);
+/* GPIO LED ports */
+	gpio_mode_setup(GPIOD, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE,
+		      GPIO12 | GPIO13 | GPIO14 | GPIO15);
+	gpio_set_output_options(GPIOD, GPIO_OTYPE_PP, GPIO_OSPEED_2MHZ,
+		      GPIO12 | GPIO13 | GPIO14 | GPIO15);
+#ifndef USB_CDC
+/* USART1 transmit on PA9, which senses VBUS when the USB is used */
+	gpio_mode_setup(GPIOA, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO9);
+	gpio_set_af(GPIOA, GPIO_AF7, GPIO9);
+#endif
+}
+
+/*--------------------------------------------------------------------*/
+/* USART1 is configured for 115200 baud, transmit only and interrupt */
+void usart_setup(void)
+{
+	rcc_periph_clock_enable(RCC_USART1);
+	nvic_enable_irq(NVIC_USART1_IRQ);
+	usart_set_baudrate(USART1, 115200);
+	usart_set_databits(USART1, 8);
+	usart_set_stopbits(USART1, USART_STOPBITS_1);
+	usart_set_parity(USART1, USART_PARITY_NONE);
+	usart_set_flow_control(USART1, USART_FLOWCONTROL_NONE);
+	usart_set_mode(USART1, USART_MODE_TX);
+	usart_disable_tx_interrupt(USART1);
+	usart_enable(USART1);
+}
+
+/*--------------------------------------------------------------------*/
+void adc_setup(void)
+{
+	rcc_periph_clock_enable(RCC_ADC1);
+/* Set port PA1 for ADC1 to analogue mode. */
+	gpio_mode_setup(GPIOA, GPIO_MODE_ANALOG, GPIO_PUPD_NONE, GPIO1);
+	adc_power_on(ADC1);
+	uint8_t channel[1] = { ADC_CHANNEL1 };
+	adc_set_regular_sequence(ADC1, 1, channel);
+	adc_set_clk_prescale(ADC_CCR_ADCPRE_BY2);
+	adc_disable_scan_mode(ADC1);
+	adc_set_single_conversion_mode(ADC1);
+	adc_set_sample_time(ADC1, ADC_CHANNEL1, ADC_SMPR_SMP_56CYC);
+	adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_TIM2_TRGO,
+					    ADC_CR2_EXTEN_RISING_EDGE);
+	adc_set_multi_mode(ADC_CCR_MULTI_INDEPENDENT);
+	adc_set_dma_continue(ADC1);
+	adc_enable_dma(ADC1);
+}
+
+/*--------------------------------------------------------------------*/
+/* ADC1 to DMA2 stream 0 channel 0 in halfwords, circular over both halves of
+the buffer, interrupting as each half is filled. */
+void dma_setup(void)
+{
+	rcc_periph_clock_enable(RCC_DMA2);
+	nvic_enable_irq(NVIC_DMA2_STREAM0_IRQ);
+	dma_stream_reset(DMA2,DMA_STREAM0);
+	dma_set_priority(DMA2,DMA_STREAM0,DMA_SxCR_PL_HIGH);
+	dma_set_peripheral_size(DMA2,DMA_STREAM0,DMA_SxCR_PSIZE_16BIT);
+	dma_set_peripheral_address(DMA2,DMA_STREAM0,(uint32_t) &ADC1_DR);
+	dma_set_memory_size(DMA2,DMA_STREAM0,DMA_SxCR_MSIZE_16BIT);
+	dma_set_memory_address(DMA2,DMA_STREAM0,(uint32_t) adc_buffer);
+	dma_set_number_of_data(DMA2,DMA_STREAM0,2*BLOCK_SAMPLES);
+	dma_set_transfer_mode(DMA2,DMA_STREAM0, DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+	dma_enable_memory_increment_mode(DMA2,DMA_STREAM0);
+	dma_enable_circular_mode(DMA2,DMA_STREAM0);
+/* Don't use FIFO */
+	dma_enable_direct_mode(DMA2,DMA_STREAM0);
+	dma_enable_half_transfer_interrupt(DMA2, DMA_STREAM0);
+	dma_enable_transfer_complete_interrupt(DMA2, DMA_STREAM0);
+	dma_channel_select(DMA2, DMA_STREAM0, DMA_SxCR_CHSEL_0);
+	dma_enable_stream(DMA2,DMA_STREAM0);
+}
+
+/*--------------------------------------------------------------------*/
+/* Timer 2 runs through a period of one sample and pulses its trigger output
+TRGO on each update event, which starts the ADC. */
+void timer_setup(void)
+{
+	rcc_periph_clock_enable(RCC_TIM2);
+	timer_reset(TIM2);
+	timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT,
+		       TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+	timer_continuous_mode(TIM2);
+	timer_set_period(TIM2, TIMER_CLOCK/SAMPLE_RATE - 1);
+	timer_set_master_mode(TIM2, TIM_CR2_MMS_UPDATE);
+	timer_enable_counter(TIM2);
+}
+
+/*--------------------------------------------------------------------*/
+/* Start sending what was put to the send ring. */
+void send_kick(void)
+{
+#ifdef USB_CDC
+	usb_cdc_kick();
+#else
+	usart_enable_tx_interrupt(USART1);
+#endif
+}
+
+#ifdef USB_CDC
+/*--------------------------------------------------------------------*/
+/* Send a raw block as packed 12 bit records. Records that do not fit in the
+ring are dropped by telemetry_send. */
+void send_raw_block(const uint16_t *block)
+{
+	uint8_t packed[RAW_RECORD_SAMPLES*3/2];
+	uint32_t i;
+	for (i = 0; i < BLOCK_SAMPLES; i += RAW_RECORD_SAMPLES)
+	{
+		uint8_t length = telemetry_pack_12bit(packed, block + i,
+						      RAW_RECORD_SAMPLES);
+		telemetry_send(TELEMETRY_ADC_12BIT, packed, length);
+	}
+}
+#endif
+
+/*--------------------------------------------------------------------*/
+/* Filter a block and send the output samples, which are little endian as
+the telemetry record expects. */
+void process_block(const uint16_t *block)
+{
+	uint16_t output[BLOCK_OUTPUTS];
+	uint32_t count = decimate_process(&filter, block, BLOCK_SAMPLES, output);
+#ifdef USB_CDC
+	send_raw_block(block);
+#endif
+	if (count > 0)
+	{
+		telemetry_send(TELEMETRY_SAMPLES_16BIT, (const uint8_t *) output,
+			       2*count);
+	}
+	send_kick();
+	gpio_toggle(GPIOD, GPIO12);
+}
+
+#ifdef ISR_PROFILE
+/*--------------------------------------------------------------------*/
+/* Send the interrupt profiles as a text record. */
+void send_profile(void)
+{
+	char text[128];
+	uint32_t n = isr_profile_format(text, sizeof(text), ISR_PROFILE_ADC_DMA);
+	n += isr_profile_format(text + n, sizeof(text) - n, ISR_PROFILE_USART1);
+	if (n > 0)
+	{
+		telemetry_send(TELEMETRY_TEXT, (const uint8_t *) text, n);
+		send_kick();
+	}
+}
+#endif
+
+/*--------------------------------------------------------------------*/
+int main(void)
+{
+	clock_setup();
+	gpio_setup();
+	ring_init(&send_ring, send_data, SEND_RING_SIZE);
+	telemetry_init_ring(&send_ring);
+#ifdef USB_CDC
+	usb_cdc_init(&send_ring, 0);
+#else
+	usart_setup();
+#endif
+#ifdef ISR_PROFILE
+	isr_profile_init();
+#endif
+	decimate_init(&filter, DECIMATION);
+	adc_setup();
+	dma_setup();
+/* The timer is started last, once everything is ready for the first sample */
+	timer_setup();
+/* Process each block as it is completed. Interrupts are masked around the test
+so that a block completed just before the wfi is not missed. */
+	uint32_t block = 0;
+	while (1) {
+		cm_mask_interrupts(true);
+		while (blocks_ready == block) {
+			__asm__ __volatile__ ("wfi");
+			cm_mask_interrupts(false);
+			cm_mask_interrupts(true);
+		}
+		cm_mask_interrupts(false);
+/* Take the latest block, counting those skipped. Odd blocks are in the first
+half. */
+		uint32_t ready = blocks_ready;
+		overruns += ready - block - 1;
+		block = ready;
+		process_block(&adc_buffer[((block - 1) & 1)*BLOCK_SAMPLES]);
+/* If another block was completed meanwhile the DMA has started to overwrite
+this one. */
+		if (blocks_ready != block) overruns++;
+		if (overruns > 0) gpio_set(GPIOD, GPIO14);
+#ifdef ISR_PROFILE
+		if (block % PROFILE_BLOCKS == 0) send_profile();
+#endif
+	}
+
+	return 0;
+}
+
+/*--------------------------------------------------------------------*/
+/* Count the blocks as each half of the buffer is filled. */
+RAMFUNC void dma2_stream0_isr(void)
+{
+	ISR_PROFILE_ENTER(ISR_PROFILE_ADC_DMA);
+	if (dma_get_interrupt_flag(DMA2, DMA_STREAM0, DMA_HTIF))
+	{
+		dma_clear_interrupt_flags(DMA2, DMA_STREAM0, DMA_HTIF);
+		blocks_ready++;
+	}
+	if (dma_get_interrupt_flag(DMA2, DMA_STREAM0, DMA_TCIF))
+	{
+		dma_clear_interrupt_flags(DMA2, DMA_STREAM0, DMA_TCIF);
+		blocks_ready++;
+	}
+	ISR_PROFILE_EXIT(ISR_PROFILE_ADC_DMA);
+}
+
+#ifndef USB_CDC
+/*--------------------------------------------------------------------*/
+/* Send the next byte of the ring, stopping the interrupt when it is empty. */
+void usart1_isr(void)
+{
+	ISR_PROFILE_ENTER(ISR_PROFILE_USART1);
+	if (usart_get_flag(USART1, USART_SR_TXE))
+	{
+		uint16_t data = ring_get(&send_ring);
+		if (data == BUFFER_EMPTY)
+		{
+			usart_disable_tx_interrupt(USART1);
+		}
+		else
+		{
+			usart_send(USART1, data);
+		}
+	}
+	ISR_PROFILE_EXIT(ISR_PROFILE_USART1);
+}
+#endif
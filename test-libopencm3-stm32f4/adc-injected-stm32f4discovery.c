@@ -30,6 +30,7 @@ An analogue signal is inserted into pin PA1 (ADC123 IN1).
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/adc.h>
 #include <libopencm3/cm3/nvic.h>
+#include "timebase.h"
 
 uint16_t value = 500;
 
@@ -77,18 +78,17 @@ void adc_setup(void)
 
 int main(void)
 {
-	uint32_t i;
-
 	clock_setup();
+	time_init(true);
 	gpio_setup();
 	adc_setup();
 /* Read ADC */
 	while (1) {
         adc_start_conversion_injected(ADC1);
-		uint32_t count = 195*value;
-		for (i = 0; i < count; i++) __asm__("nop");
+		uint32_t half_period = 6*value;
+		delay_us(half_period);
 		gpio_toggle(GPIOD, GPIO12);
-		for (i = 0; i < count; i++) __asm__("nop");
+		delay_us(half_period);
 		gpio_toggle(GPIOD, GPIO13);
 	}
 
@@ -106,3 +106,10 @@ void adc_isr(void)
 
 }
 
+/*--------------------------------------------------------------------------*/
+/* SysTick keeps the timebase of the delays. */
+
+void sys_tick_handler(void)
+{
+	time_tick();
+}
@@ -0,0 +1,442 @@
+/* STM32F4 Benchmark of the DAC to ADC analogue path
+
+DAC1 on PA4 is wired to the ADC input PA1 (ADC123 IN1). The update event of
+timer 2 at SAMPLE_RATE, on its trigger output TRGO, both loads the next DAC
+sample by DMA from a stimulus buffer and starts an ADC conversion taken by
+DMA into a capture buffer, so the two run in lock step from the same timer
+tick and any change of the timer, DMA, DAC or ADC setup shows in the figures.
+Each run has two captures.
+
+The step capture plays a step of the stimulus from STEP_LOW to STEP_HIGH once
+and takes CAPTURE_SAMPLES. A trigger moves into the DAC output the sample the
+DMA loaded on the previous trigger, so the step reaches the output on trigger
+STEP_AT + 1. The latency is the number of timer ticks from that trigger to the
+crossing of half way up the step, found between the last ADC sample below it
+and the first above it by linear interpolation, so that it resolves a fraction
+of the PERIOD ticks of a sample. It comes out at up to about one period, as
+the DAC settles for some microseconds while the ADC samples at once. The mean
+levels before and after the step check the gain and offset of the path.
+
+The sine capture plays a sine of exactly SINE_CYCLES cycles in
+ANALYSIS_SAMPLES in circular mode, so that the last ANALYSIS_SAMPLES captured
+hold a whole number of cycles and need no window. The fundamental and its
+harmonics up to HARMONICS are fitted to the block by correlation, and the
+residual after taking out the fit and the mean is the noise. Their powers give
+the SNR and THD. The effective sample rate is measured from the DWT cycle
+counter read in the DMA half and full transfer interrupts, which are half the
+capture apart.
+
+The figures of each run go as a TELEMETRY_LOOPBACK record of telemetry.c on
+USART1 at 115200 baud (PA9), and are shown with the SNR and THD in dB by
+common/telemetry_decode.py.
+
+STM32F4-Discovery board. Connect PA4 to PA1.
+D12 toggles with each run.
+
+15 October 2026
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/dac.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/usart.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+#include "buffer.h"
+#include "telemetry.h"
+#include "irq_priority.h"
+
+#define CPU_CLOCK 168000000
+/* Timer 2 is clocked at twice the APB1 clock of 42MHz */
+#define TIMER_CLOCK 84000000
+#define SAMPLE_RATE 100000
+/* Timer ticks in a sample period */
+#define PERIOD (TIMER_CLOCK/SAMPLE_RATE)
+
+/* Samples analysed, and those taken before them while the path settles */
+#define ANALYSIS_SAMPLES 1024
+#define SETTLE_SAMPLES 64
+#define CAPTURE_SAMPLES (SETTLE_SAMPLES + ANALYSIS_SAMPLES)
+
+/* Step of the stimulus, and the samples averaged for each level */
+#define STEP_AT 512
+#define STEP_LOW 1024
+#define STEP_HIGH 3072
+#define LEVEL_SAMPLES 64
+
+/* Cycles of sine in the analysed block, odd so that the harmonics fall in
+distinct bins, and its peak in codes about mid scale */
+#define SINE_CYCLES 31
+#define SINE_AMPLITUDE 1600
+/* Harmonics fitted, counting the fundamental */
+#define HARMONICS 5
+
+#define SEND_RING_SIZE 256
+
+/* Figures of a run, as sent in the telemetry record */
+typedef struct {
+	uint32_t run;
+	uint32_t sample_rate_mhz;       /* effective sample rate in mHz */
+	uint32_t latency_ticks;         /* step trigger to ADC sample */
+	uint16_t step_low;              /* mean codes before and after the step */
+	uint16_t step_high;
+	float signal;                   /* powers in codes squared */
+	float harmonics;
+	float noise;
+} __attribute__((packed)) loopback_report_t;
+
+uint16_t stimulus[ANALYSIS_SAMPLES];
+uint16_t capture[CAPTURE_SAMPLES];
+volatile bool capture_done;
+/* Cycle counts at the half and full transfer of the capture */
+volatile uint32_t half_time;
+volatile uint32_t full_time;
+uint8_t send_data[SEND_RING_SIZE] __attribute__((aligned(4)));
+ring_buffer_t send_ring;
+loopback_report_t report;
+
+/*--------------------------------------------------------------------*/
+void clock_setup(void)
+{
+	rcc_clock_setup_hse_3v3(&hse_8mhz_3v3[CLOCK_3V3_168MHZ]);
+}
+
+/*--------------------------------------------------------------------*/
+void gpio_setup(void)
+{
+/* Clocks on AHB1 for GPIO D (LEDs) and A (DAC, ADC, USART1) */
+	rcc_periph_clock_enable(RCC_GPIOD);
+	rcc_periph_clock_enable(RCC_GPIOA);
+/* GPIO LED ports */
+	gpio_mode_setup(GPIOD, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE,
+		      GPIO12 | GPIO13 | GPIO14 | GPIO15);
+	gpio_set_output_options(GPIOD, GPIO_OTYPE_PP, GPIO_OSPEED_2MHZ,
+		      GPIO12 | GPIO13 | GPIO14 | GPIO15);
+/* PA4 for the DAC output and PA1 for the ADC input, in analogue mode */
+	gpio_mode_setup(GPIOA, GPIO_MODE_ANALOG, GPIO_PUPD_NONE, GPIO1 | GPIO4);
+/* USART1 transmit on PA9 */
+	gpio_mode_setup(GPIOA, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO9);
+	gpio_set_af(GPIOA, GPIO_AF7, GPIO9);
+}
+
+/*--------------------------------------------------------------------*/
+/* USART1 is configured for 115200 baud, transmit only and interrupt */
+void usart_setup(void)
+{
+	rcc_periph_clock_enable(RCC_USART1);
+	IRQ_PRIORITY_SET(NVIC_USART1_IRQ, IRQ_LEVEL_COMM);
+	nvic_enable_irq(NVIC_USART1_IRQ);
+	usart_set_baudrate(USART1, 115200);
+	usart_set_databits(USART1, 8);
+	usart_set_stopbits(USART1, USART_STOPBITS_1);
+	usart_set_parity(USART1, USART_PARITY_NONE);
+	usart_set_flow_control(USART1, USART_FLOWCONTROL_NONE);
+	usart_set_mode(USART1, USART_MODE_TX);
+	usart_disable_tx_interrupt(USART1);
+	usart_enable(USART1);
+}
+
+/*--------------------------------------------------------------------*/
+/* DAC channel 1 is loaded by DMA on each trigger of timer 2. */
+void dac_setup(void)
+{
+	rcc_periph_clock_enable(RCC_DAC);
+	rcc_periph_clock_enable(RCC_DMA1);
+	dac_trigger_enable(CHANNEL_1);
+	dac_set_trigger_source(DAC_CR_TSEL1_T2);
+	dac_enable(CHANNEL_1);
+}
+
+/*--------------------------------------------------------------------*/
+/* ADC1 converts PA1 on each trigger of timer 2. The ADC clock is 21MHz, so a
+conversion of 56 sampling cycles ends well within a sample period. DMA
+requests end with the last transfer of the capture. */
+void adc_setup(void)
+{
+	rcc_periph_clock_enable(RCC_ADC1);
+	rcc_periph_clock_enable(RCC_DMA2);
+	IRQ_PRIORITY_SET(NVIC_DMA2_STREAM0_IRQ, IRQ_LEVEL_DMA);
+	nvic_enable_irq(NVIC_DMA2_STREAM0_IRQ);
+	adc_power_on(ADC1);
+	uint8_t channel[1] = { ADC_CHANNEL1 };
+	adc_set_regular_sequence(ADC1, 1, channel);
+	adc_set_clk_prescale(ADC_CCR_ADCPRE_BY4);
+	adc_disable_scan_mode(ADC1);
+	adc_set_single_conversion_mode(ADC1);
+	adc_set_sample_time(ADC1, ADC_CHANNEL1, ADC_SMPR_SMP_56CYC);
+	adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_TIM2_TRGO,
+					    ADC_CR2_EXTEN_RISING_EDGE);
+	adc_set_multi_mode(ADC_CCR_MULTI_INDEPENDENT);
+	adc_set_dma_terminate(ADC1);
+}
+
+/*--------------------------------------------------------------------*/
+/* Timer 2 runs through a period of one sample and pulses its trigger output
+TRGO on each update event, for both the DAC and the ADC. It is started for
+each capture. */
+void timer_setup(void)
+{
+	rcc_periph_clock_enable(RCC_TIM2);
+	timer_reset(TIM2);
+	timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT,
+		       TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+	timer_continuous_mode(TIM2);
+	timer_set_period(TIM2, PERIOD - 1);
+	timer_set_master_mode(TIM2, TIM_CR2_MMS_UPDATE);
+}
+
+/*--------------------------------------------------------------------*/
+/* Cosine and sine of index/ANALYSIS_SAMPLES of a turn. The angle of half the
+turn is brought into a quarter turn either side of zero, where the series
+below are good to a few parts in 1e8, and then doubled. */
+void phasor(uint32_t index, float *cosine, float *sine)
+{
+	index %= ANALYSIS_SAMPLES;
+	int32_t turn = (int32_t) index;
+	if (turn > ANALYSIS_SAMPLES/2) turn -= ANALYSIS_SAMPLES;
+	float y = 3.14159265f*turn/ANALYSIS_SAMPLES;
+	float y2 = y*y;
+	float s = y*(1 - y2/6*(1 - y2/20*(1 - y2/42*(1 - y2/72*(1 - y2/110*
+		  (1 - y2/156))))));
+	float c = 1 - y2/2*(1 - y2/12*(1 - y2/30*(1 - y2/56*(1 - y2/90*
+		  (1 - y2/132)))));
+	*cosine = c*c - s*s;
+	*sine = 2*c*s;
+}
+
+/*--------------------------------------------------------------------*/
+/* Fill the stimulus with the step, or with the sine. */
+void make_step(void)
+{
+	uint32_t n;
+	for (n = 0; n < ANALYSIS_SAMPLES; n++)
+		stimulus[n] = (n < STEP_AT) ? STEP_LOW : STEP_HIGH;
+}
+
+void make_sine(void)
+{
+	uint32_t n;
+	float c, s;
+	for (n = 0; n < ANALYSIS_SAMPLES; n++)
+	{
+		phasor(n*SINE_CYCLES, &c, &s);
+		float value = 2048 + SINE_AMPLITUDE*s;
+		stimulus[n] = (uint16_t) (value + 0.5f);
+	}
+}
+
+/*--------------------------------------------------------------------*/
+/* Play the stimulus and take a capture. The stimulus is repeated in circular
+mode, or played once and its last sample held. */
+void run_capture(bool circular)
+{
+/* DAC channel 1 uses DMA1 stream 5 channel 7. An underrun left by the last
+capture is cleared before the DAC takes DMA again. */
+	dac_dma_disable(CHANNEL_1);
+	dma_stream_reset(DMA1, DMA_STREAM5);
+	dma_set_priority(DMA1, DMA_STREAM5, DMA_SxCR_PL_HIGH);
+	dma_set_memory_size(DMA1, DMA_STREAM5, DMA_SxCR_MSIZE_16BIT);
+	dma_set_peripheral_size(DMA1, DMA_STREAM5, DMA_SxCR_PSIZE_16BIT);
+	dma_set_peripheral_address(DMA1, DMA_STREAM5, (uint32_t) &DAC_DHR12R1);
+	dma_set_memory_address(DMA1, DMA_STREAM5, (uint32_t) stimulus);
+	dma_set_number_of_data(DMA1, DMA_STREAM5, ANALYSIS_SAMPLES);
+	dma_enable_memory_increment_mode(DMA1, DMA_STREAM5);
+	if (circular) dma_enable_circular_mode(DMA1, DMA_STREAM5);
+	dma_set_transfer_mode(DMA1, DMA_STREAM5, DMA_SxCR_DIR_MEM_TO_PERIPHERAL);
+	dma_channel_select(DMA1, DMA_STREAM5, DMA_SxCR_CHSEL_7);
+	dma_enable_stream(DMA1, DMA_STREAM5);
+	DAC_SR = DAC_SR_DMAUDR1;
+	dac_dma_enable(CHANNEL_1);
+
+/* ADC1 uses DMA2 stream 0 channel 0, once through the capture. An overrun
+left by the last capture is cleared and the ADC DMA restarted. */
+	adc_disable_dma(ADC1);
+	dma_stream_reset(DMA2, DMA_STREAM0);
+	dma_set_priority(DMA2, DMA_STREAM0, DMA_SxCR_PL_VERY_HIGH);
+	dma_set_peripheral_size(DMA2, DMA_STREAM0, DMA_SxCR_PSIZE_16BIT);
+	dma_set_peripheral_address(DMA2, DMA_STREAM0, (uint32_t) &ADC1_DR);
+	dma_set_memory_size(DMA2, DMA_STREAM0, DMA_SxCR_MSIZE_16BIT);
+	dma_set_memory_address(DMA2, DMA_STREAM0, (uint32_t) capture);
+	dma_set_number_of_data(DMA2, DMA_STREAM0, CAPTURE_SAMPLES);
+	dma_set_transfer_mode(DMA2, DMA_STREAM0, DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+	dma_enable_memory_increment_mode(DMA2, DMA_STREAM0);
+	dma_enable_direct_mode(DMA2, DMA_STREAM0);
+	dma_enable_half_transfer_interrupt(DMA2, DMA_STREAM0);
+	dma_enable_transfer_complete_interrupt(DMA2, DMA_STREAM0);
+	dma_channel_select(DMA2, DMA_STREAM0, DMA_SxCR_CHSEL_0);
+	dma_enable_stream(DMA2, DMA_STREAM0);
+	ADC_SR(ADC1) &= ~ADC_SR_OVR;
+	adc_enable_dma(ADC1);
+
+/* The first trigger comes a period after the timer starts. The DMA interrupt
+stops the timer at the end of the capture. */
+	capture_done = false;
+	timer_set_counter(TIM2, 0);
+	timer_enable_counter(TIM2);
+	cm_mask_interrupts(true);
+	while (! capture_done) {
+		__asm__ __volatile__ ("wfi");
+		cm_mask_interrupts(false);
+		cm_mask_interrupts(true);
+	}
+	cm_mask_interrupts(false);
+}
+
+/*--------------------------------------------------------------------*/
+/* Mean of count captured samples from first. */
+uint16_t mean_level(uint32_t first, uint32_t count)
+{
+	uint32_t sum = 0;
+	uint32_t n;
+	for (n = first; n < first + count; n++) sum += capture[n];
+	return (sum + count/2)/count;
+}
+
+/*--------------------------------------------------------------------*/
+/* Levels and latency of the step capture. ADC sample j is taken on trigger j,
+and the step reaches the DAC output on trigger STEP_AT + 1. The crossing of
+the middle level is placed between samples j - 1 and j in proportion to the
+rise across it, and taken as no earlier than the step. */
+void analyse_step(void)
+{
+	report.step_low = mean_level(STEP_AT - LEVEL_SAMPLES, LEVEL_SAMPLES);
+	report.step_high = mean_level(CAPTURE_SAMPLES - LEVEL_SAMPLES,
+				      LEVEL_SAMPLES);
+	uint16_t middle = (report.step_low + report.step_high)/2;
+	uint32_t j = STEP_AT + 1;
+	while ((j < CAPTURE_SAMPLES) && (capture[j] < middle)) j++;
+	report.latency_ticks = (j - STEP_AT - 1)*PERIOD;
+	if ((j >= CAPTURE_SAMPLES) || (capture[j - 1] >= middle)) return;
+	uint32_t before = (middle - capture[j - 1])*PERIOD/
+			  (capture[j] - capture[j - 1]);
+/* Time of sample j less the part of a period after the crossing */
+	if (report.latency_ticks > PERIOD - before)
+		report.latency_ticks -= PERIOD - before;
+	else report.latency_ticks = 0;
+}
+
+/*--------------------------------------------------------------------*/
+/* Powers of the sine capture. With a whole number of cycles in the block the
+sines and cosines of the harmonics are orthogonal, so each is fitted alone by
+correlation. Aliased harmonics are fitted where they fall. */
+void analyse_sine(void)
+{
+	const uint16_t *x = &capture[SETTLE_SAMPLES];
+	float a[HARMONICS];
+	float b[HARMONICS];
+	float c, s;
+	uint32_t n, h;
+	uint32_t sum = 0;
+	for (n = 0; n < ANALYSIS_SAMPLES; n++) sum += x[n];
+	float mean = (float) sum/ANALYSIS_SAMPLES;
+	report.signal = 0;
+	report.harmonics = 0;
+	for (h = 0; h < HARMONICS; h++)
+	{
+		a[h] = 0;
+		b[h] = 0;
+		for (n = 0; n < ANALYSIS_SAMPLES; n++)
+		{
+			phasor((h + 1)*SINE_CYCLES*n, &c, &s);
+			a[h] += (x[n] - mean)*c;
+			b[h] += (x[n] - mean)*s;
+		}
+		a[h] *= 2.0f/ANALYSIS_SAMPLES;
+		b[h] *= 2.0f/ANALYSIS_SAMPLES;
+		float power = (a[h]*a[h] + b[h]*b[h])/2;
+		if (h == 0) report.signal = power;
+		else report.harmonics += power;
+	}
+/* Noise is what is left with the fit taken out */
+	float noise = 0;
+	for (n = 0; n < ANALYSIS_SAMPLES; n++)
+	{
+		float residual = x[n] - mean;
+		for (h = 0; h < HARMONICS; h++)
+		{
+			phasor((h + 1)*SINE_CYCLES*n, &c, &s);
+			residual -= a[h]*c + b[h]*s;
+		}
+		noise += residual*residual;
+	}
+	report.noise = noise/ANALYSIS_SAMPLES;
+/* The half and full transfers are half the capture apart */
+	uint32_t cycles = full_time - half_time;
+	report.sample_rate_mhz = ((uint64_t) (CAPTURE_SAMPLES/2)*CPU_CLOCK*1000)
+				  / cycles;
+}
+
+/*--------------------------------------------------------------------*/
+int main(void)
+{
+	clock_setup();
+	gpio_setup();
+	dwt_enable_cycle_counter();
+	ring_init(&send_ring, send_data, SEND_RING_SIZE);
+	telemetry_init_ring(&send_ring);
+	usart_setup();
+	dac_setup();
+	adc_setup();
+	timer_setup();
+
+	report.run = 0;
+	while (1) {
+		make_step();
+		run_capture(false);
+		analyse_step();
+		make_sine();
+		run_capture(true);
+		analyse_sine();
+		report.run++;
+		telemetry_send(TELEMETRY_LOOPBACK, (const uint8_t *) &report,
+			       sizeof(report));
+		usart_enable_tx_interrupt(USART1);
+		gpio_toggle(GPIOD, GPIO12);
+	}
+
+	return 0;
+}
+
+/*--------------------------------------------------------------------*/
+/* Time the half and full transfers of the capture, and stop the timer at the
+end. */
+void dma2_stream0_isr(void)
+{
+	uint32_t now = DWT_CYCCNT;
+	if (dma_get_interrupt_flag(DMA2, DMA_STREAM0, DMA_HTIF))
+	{
+		dma_clear_interrupt_flags(DMA2, DMA_STREAM0, DMA_HTIF);
+		half_time = now;
+	}
+	if (dma_get_interrupt_flag(DMA2, DMA_STREAM0, DMA_TCIF))
+	{
+		dma_clear_interrupt_flags(DMA2, DMA_STREAM0, DMA_TCIF);
+		timer_disable_counter(TIM2);
+		full_time = now;
+		capture_done = true;
+	}
+}
+
+/*--------------------------------------------------------------------*/
+/* Send the next byte of the ring, stopping the interrupt when it is empty. */
+void usart1_isr(void)
+{
+	if (usart_get_flag(USART1, USART_SR_TXE))
+	{
+		uint16_t data = ring_get(&send_ring);
+		if (data == BUFFER_EMPTY)
+		{
+			usart_disable_tx_interrupt(USART1);
+		}
+		else
+		{
+			usart_send(USART1, data);
+		}
+	}
+}
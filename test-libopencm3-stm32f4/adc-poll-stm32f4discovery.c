@@ -33,6 +33,7 @@ An analogue signal is inserted into pin PA1 (ADC123 IN1).
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/adc.h>
+#include "timebase.h"
 
 /*--------------------------------------------------------------------------*/
 
@@ -77,9 +78,8 @@ void adc_setup(void)
 
 int main(void)
 {
-	uint32_t i;
-
 	clock_setup();
+	time_init(true);
 	gpio_setup();
 	adc_setup();
 /* Read ADC */
@@ -90,12 +90,20 @@ int main(void)
 //    }
 /* Blink the LED (PD12, PD13) on the board rate proportional to adc output. */
 //	while (1) {
-		uint32_t count = 195*value;
+		uint32_t half_period = 6*value;
 		gpio_toggle(GPIOD, GPIO12);
-		for (i = 0; i < count; i++) __asm__("nop");
+		delay_us(half_period);
 		gpio_toggle(GPIOD, GPIO13);
-		for (i = 0; i < count; i++) __asm__("nop");
+		delay_us(half_period);
 	}
 
 	return 0;
 }
+
+/*--------------------------------------------------------------------------*/
+/* SysTick keeps the timebase of the delays. */
+
+void sys_tick_handler(void)
+{
+	time_tick();
+}
@@ -0,0 +1,149 @@
+/* STM32F4 Test of a gateway between the two CAN controllers
+
+Frames are forwarded between CAN1 and CAN2 at 500kbit/s by can_gateway.c in
+common, entirely from the CAN interrupts. Standard frames 0x000 to 0x3FF from
+CAN1 are passed to CAN2 unchanged, and 0x500 to 0x50F are passed as 0x600 to
+0x60F; other standard frames stay on CAN1. All extended frames from CAN2 are
+passed to CAN1, and its standard frames stay on CAN2.
+
+Every frame received is mirrored as a telemetry record of telemetry.c, sent
+from a ring buffer on USART1 at 115200 baud (PA9) by the TXE interrupt and read
+with common/telemetry_decode.py. The main loop sleeps until an interrupt and
+then sends what the mirror holds. At full bus load the serial line cannot keep
+up, and frames the mirror has no room for are counted in the statistics of
+the gateway without affecting the forwarding.
+
+STM32F4-Discovery board.
+CAN1 is on PD0 (RX) and PD1 (TX), and CAN2 on PB12 (RX) and PB13 (TX), each to
+a transceiver.
+D12 toggles as mirrored frames are sent and D14 lights when a frame is dropped.
+
+15 October 2026
+*/
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/usart.h>
+#include <libopencm3/cm3/nvic.h>
+#include "buffer.h"
+#include "telemetry.h"
+#include "can_gateway.h"
+
+#define SEND_RING_SIZE 1024
+
+/* CAN1 to CAN2 */
+const can_gateway_rule_t can1_rules[] = {
+	{ .id = 0x000, .mask = 0x400, .remap = CAN_GATEWAY_KEEP, .extended = false },
+	{ .id = 0x500, .mask = 0x7F0, .remap = 0x600, .extended = false },
+};
+
+/* CAN2 to CAN1 */
+const can_gateway_rule_t can2_rules[] = {
+	{ .id = 0, .mask = 0, .remap = CAN_GATEWAY_KEEP, .extended = true },
+};
+
+const can_gateway_port_t can1_port = {
+	.bitrate = 500,
+	.rules = can1_rules,
+	.rule_count = sizeof(can1_rules)/sizeof(can1_rules[0]),
+};
+
+const can_gateway_port_t can2_port = {
+	.bitrate = 500,
+	.rules = can2_rules,
+	.rule_count = sizeof(can2_rules)/sizeof(can2_rules[0]),
+};
+
+uint8_t send_data[SEND_RING_SIZE] __attribute__((aligned(4)));
+ring_buffer_t send_ring;
+
+/*--------------------------------------------------------------------*/
+void clock_setup(void)
+{
+	rcc_clock_setup_hse_3v3(&hse_8mhz_3v3[CLOCK_3V3_168MHZ]);
+}
+
+/*--------------------------------------------------------------------*/
+void gpio_setup(void)
+{
+/* Clocks on AHB1 for GPIO D (LEDs) and A (USART1) */
+	rcc_periph_clock_enable(RCC_GPIOD);
+	rcc_periph_clock_enable(RCC_GPIOA);
+/* GPIO LED ports */
+	gpio_mode_setup(GPIOD, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE,
+		      GPIO12 | GPIO13 | GPIO14 | GPIO15);
+	gpio_set_output_options(GPIOD, GPIO_OTYPE_PP, GPIO_OSPEED_2MHZ,
+		      GPIO12 | GPIO13 | GPIO14 | GPIO15);
+/* USART1 transmit on PA9 */
+	gpio_mode_setup(GPIOA, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO9);
+	gpio_set_af(GPIOA, GPIO_AF7, GPIO9);
+}
+
+/*--------------------------------------------------------------------*/
+/* USART1 is configured for 115200 baud, transmit only and interrupt */
+void usart_setup(void)
+{
+	rcc_periph_clock_enable(RCC_USART1);
+	nvic_enable_irq(NVIC_USART1_IRQ);
+	usart_set_baudrate(USART1, 115200);
+	usart_set_databits(USART1, 8);
+	usart_set_stopbits(USART1, USART_STOPBITS_1);
+	usart_set_parity(USART1, USART_PARITY_NONE);
+	usart_set_flow_control(USART1, USART_FLOWCONTROL_NONE);
+	usart_set_mode(USART1, USART_MODE_TX);
+	usart_disable_tx_interrupt(USART1);
+	usart_enable(USART1);
+}
+
+/*--------------------------------------------------------------------*/
+int main(void)
+{
+	clock_setup();
+	gpio_setup();
+	ring_init(&send_ring, send_data, SEND_RING_SIZE);
+	telemetry_init_ring(&send_ring);
+	usart_setup();
+/* D15 lights if a controller did not start */
+	if (! can_gateway_init(&can1_port, &can2_port))
+	{
+		gpio_set(GPIOD, GPIO15);
+		while (1);
+	}
+	can_gateway_mirror(true);
+
+/* Each CAN receive interrupt wakes the loop to send the mirror. Frames left
+when the ring is full are sent as the USART interrupts make room. */
+	while (1) {
+		__asm__ __volatile__ ("wfi");
+		if (can_gateway_mirror_drain() > 0)
+		{
+			usart_enable_tx_interrupt(USART1);
+			gpio_toggle(GPIOD, GPIO12);
+		}
+		can_gateway_stats_t stats[CAN_GATEWAY_DIRECTIONS];
+		can_gateway_read_stats(CAN_GATEWAY_1TO2, &stats[CAN_GATEWAY_1TO2]);
+		can_gateway_read_stats(CAN_GATEWAY_2TO1, &stats[CAN_GATEWAY_2TO1]);
+		if ((stats[CAN_GATEWAY_1TO2].dropped > 0) ||
+		    (stats[CAN_GATEWAY_2TO1].dropped > 0)) gpio_set(GPIOD, GPIO14);
+	}
+
+	return 0;
+}
+
+/*--------------------------------------------------------------------*/
+/* Send the next byte of the ring, stopping the interrupt when it is empty. */
+void usart1_isr(void)
+{
+	if (usart_get_flag(USART1, USART_SR_TXE))
+	{
+		uint16_t data = ring_get(&send_ring);
+		if (data == BUFFER_EMPTY)
+		{
+			usart_disable_tx_interrupt(USART1);
+		}
+		else
+		{
+			usart_send(USART1, data);
+		}
+	}
+}
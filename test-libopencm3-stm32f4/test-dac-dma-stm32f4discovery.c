@@ -7,6 +7,25 @@ DMA ISR on transfer complete is used to toggle a port for CRO trigger.
 PC1 is toggled every timer cycle by the DMA ISR as a reference or trigger.
 PA4 has the analogue output.
 
+Define STREAM_PLAYBACK to play a waveform of any length from a source rather
+than loop the table. The DMA buffer is then of two halves, and the half transfer
+and transfer complete interrupts refill the half just played from the source
+while the DMA plays the other, so the playback is gapless at the rate set by
+the timer, about 42k samples per second. A source is any function of the type
+sample_source_t, such as a generator computing the samples as they are needed,
+or a reader of a file or of a communications link. If the source has no samples
+ready the last is held and the shortfall is counted in underruns.
+
+The generator source plays the waveform of the table. Define USART_SOURCE to
+play 8 bit samples received on USART1 (PA10) at 460800 baud instead. These are
+held in a ring buffer, and the flow from the host is paced with XOFF and XON
+sent on PA9 as the ring fills and empties, so the host must have software flow
+control set.
+
+Built with ISR_PROFILE=1 the DMA and USART handlers are timed by isr_profile.c
+in common, and the profiles are read with the debugger, replacing the PC1
+probe for the time taken by the refill.
+
 */
 
 /*
@@ -30,11 +49,48 @@ PA4 has the analogue output.
 #include <libopencm3/cm3/nvic.h>
 #include <libopencm3/stm32/dac.h>
 #include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/usart.h>
+#include "buffer.h"
+#include "wavetable.h"
+#include "isr_profile.h"
 
 #define PERIOD 1152
 
+/* Define to stream the waveform by refilling each half of the DMA buffer as it
+is played, rather than loop a fixed table */
+#define STREAM_PLAYBACK
+/* Define to stream from USART1 rather than from the generator */
+//#define USART_SOURCE
+
+/* Samples in each half of the DMA buffer */
+#define HALF_SAMPLES 128
+#define RECEIVE_RING_SIZE 1024
+#define XON 0x11
+#define XOFF 0x13
+
+/* A source of samples fills up to count 12 bit samples and returns the number
+given. It is called from the DMA interrupt. */
+typedef uint32_t (*sample_source_t)(uint16_t *samples, uint32_t count);
+
+uint32_t generator_source(uint16_t *samples, uint32_t count);
+uint32_t usart_source(uint16_t *samples, uint32_t count);
+void refill(uint16_t *half);
+
 /* Globals */
-uint8_t v[256];
+#ifdef STREAM_PLAYBACK
+uint16_t v[2*HALF_SAMPLES];
+#ifdef USART_SOURCE
+sample_source_t source = usart_source;
+#else
+sample_source_t source = generator_source;
+#endif
+/* Samples the source did not give in time */
+uint32_t underruns = 0;
+uint16_t last_sample = 2048;
+uint8_t receive_data[RECEIVE_RING_SIZE];
+ring_buffer_t receive_ring;
+bool paused = false;
+#endif
 
 /*--------------------------------------------------------------------*/
 void clock_setup(void)
@@ -87,17 +143,31 @@ void dma_setup(void)
 	rcc_periph_clock_enable(RCC_DMA1);
 	nvic_enable_irq(NVIC_DMA1_STREAM5_IRQ);
 	dma_stream_reset(DMA1,DMA_STREAM5);
+#ifdef STREAM_PLAYBACK
+/* The half transfer interrupt refills the first half while the second plays,
+which must finish before the DMA comes back to it */
+	dma_set_priority(DMA1,DMA_STREAM5,DMA_SxCR_PL_HIGH);
+	dma_set_memory_size(DMA1,DMA_STREAM5,DMA_SxCR_MSIZE_16BIT);
+	dma_set_peripheral_size(DMA1,DMA_STREAM5,DMA_SxCR_PSIZE_16BIT);
+/* The register to target is the DAC1 12-bit right justified data register */
+	dma_set_peripheral_address(DMA1,DMA_STREAM5,(uint32_t) &DAC_DHR12R1);
+/* The array v[] is refilled with the waveform data to be output */
+	dma_set_memory_address(DMA1,DMA_STREAM5,(uint32_t) v);
+	dma_set_number_of_data(DMA1,DMA_STREAM5,2*HALF_SAMPLES);
+	dma_enable_half_transfer_interrupt(DMA1, DMA_STREAM5);
+#else
 	dma_set_priority(DMA1,DMA_STREAM5,DMA_SxCR_PL_LOW);
 	dma_set_memory_size(DMA1,DMA_STREAM5,DMA_SxCR_MSIZE_8BIT);
 	dma_set_peripheral_size(DMA1,DMA_STREAM5,DMA_SxCR_PSIZE_8BIT);
+/* The register to target is the DAC1 8-bit right justified data register */
+	dma_set_peripheral_address(DMA1,DMA_STREAM5,(uint32_t) &DAC_DHR8R1);
+/* The waveform is taken straight from its table in flash */
+	dma_set_memory_address(DMA1,DMA_STREAM5,(uint32_t) wavetable_8bit);
+	dma_set_number_of_data(DMA1,DMA_STREAM5,WAVETABLE_SIZE);
+#endif
 	dma_enable_memory_increment_mode(DMA1,DMA_STREAM5);
 	dma_enable_circular_mode(DMA1,DMA_STREAM5);
 	dma_set_transfer_mode(DMA1,DMA_STREAM5, DMA_SxCR_DIR_MEM_TO_PERIPHERAL);
-/* The register to target is the DAC1 8-bit right justified data register */
-	dma_set_peripheral_address(DMA1,DMA_STREAM5,(uint32_t) &DAC_DHR8R1);
-/* The array v[] is filled with the waveform data to be output */
-	dma_set_memory_address(DMA1,DMA_STREAM5,(uint32_t) v);
-	dma_set_number_of_data(DMA1,DMA_STREAM5,256);
 	dma_channel_select(DMA1, DMA_STREAM5, DMA_SxCR_CHSEL_7);
 	dma_enable_transfer_complete_interrupt(DMA1, DMA_STREAM5);
 	dma_enable_stream(DMA1,DMA_STREAM5);
@@ -117,35 +187,130 @@ woken up by the time the first transfer occurs */
 }
 
 /*--------------------------------------------------------------------*/
-/* The ISR simply provides a test output for a CRO trigger */
+/* USART1 is configured for 460800 baud, receiving by interrupt into the ring.
+The transmitter only sends the flow control characters. */
+void usart_setup(void)
+{
+	rcc_periph_clock_enable(RCC_USART1);
+	nvic_enable_irq(NVIC_USART1_IRQ);
+	gpio_mode_setup(GPIOA, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO9 | GPIO10);
+	gpio_set_af(GPIOA, GPIO_AF7, GPIO9 | GPIO10);
+	usart_set_baudrate(USART1, 460800);
+	usart_set_databits(USART1, 8);
+	usart_set_stopbits(USART1, USART_STOPBITS_1);
+	usart_set_parity(USART1, USART_PARITY_NONE);
+	usart_set_flow_control(USART1, USART_FLOWCONTROL_NONE);
+	usart_set_mode(USART1, USART_MODE_TX_RX);
+	usart_enable_rx_interrupt(USART1);
+	usart_enable(USART1);
+}
+
+/*--------------------------------------------------------------------*/
+/* Generator source, playing the waveform table in 12 bits. */
+uint32_t generator_source(uint16_t *samples, uint32_t count)
+{
+	static uint8_t i = 0;
+	uint32_t n;
+	for (n = 0; n < count; n++) samples[n] = wavetable_12bit[i++];
+	return count;
+}
+
+/*--------------------------------------------------------------------*/
+/* USART source, taking the received 8 bit samples from the ring. The host is
+let go again once the ring has drained to a quarter full. */
+uint32_t usart_source(uint16_t *samples, uint32_t count)
+{
+	uint32_t n = 0;
+	while (n < count)
+	{
+		uint16_t data = ring_get(&receive_ring);
+		if (data == BUFFER_EMPTY) break;
+		samples[n++] = data << 4;
+	}
+	if (paused && (ring_count(&receive_ring) < RECEIVE_RING_SIZE/4))
+	{
+		usart_send(USART1, XON);
+		paused = false;
+	}
+	return n;
+}
+
+/*--------------------------------------------------------------------*/
+/* Fill half of the buffer from the source, holding the last sample over any
+shortfall. */
+void refill(uint16_t *half)
+{
+	uint32_t n = source(half, HALF_SAMPLES);
+	if (n < HALF_SAMPLES)
+	{
+		underruns += HALF_SAMPLES - n;
+		while (n < HALF_SAMPLES) half[n++] = last_sample;
+	}
+	last_sample = half[HALF_SAMPLES-1];
+}
+
+/*--------------------------------------------------------------------*/
+/* The ISR refills each half of the buffer as it is played, and provides a test
+output for a CRO trigger */
 
 void dma1_stream5_isr(void)
 {
+	ISR_PROFILE_ENTER(ISR_PROFILE_DAC_DMA);
+#ifdef STREAM_PLAYBACK
+	if (dma_get_interrupt_flag(DMA1, DMA_STREAM5, DMA_HTIF))
+	{
+		dma_clear_interrupt_flags(DMA1, DMA_STREAM5, DMA_HTIF);
+		refill(v);
+	}
+#endif
 	if (dma_get_interrupt_flag(DMA1, DMA_STREAM5, DMA_TCIF))
 	{
 		dma_clear_interrupt_flags(DMA1, DMA_STREAM5, DMA_TCIF);
+#ifdef STREAM_PLAYBACK
+		refill(&v[HALF_SAMPLES]);
+#endif
 /* Toggle PC1 just to keep aware of activity and frequency. */
 		gpio_toggle(GPIOC, GPIO1);
 	}
+	ISR_PROFILE_EXIT(ISR_PROFILE_DAC_DMA);
 }
 
 /*--------------------------------------------------------------------*/
-int main(void)
+/* Put received samples in the ring, and stop the host when it is three
+quarters full, leaving room for those already on the way. */
+
+void usart1_isr(void)
 {
-/* Fill the array with funky waveform data */
-/* This is for dual channel 8-bit right aligned */
-	uint16_t i, x;
-	for (i=0; i<256; i++)
+	ISR_PROFILE_ENTER(ISR_PROFILE_USART1);
+	if (usart_get_flag(USART1, USART_SR_RXNE))
 	{
-		if (i<10) x=10;
-		else if (i<121) x=10+((i*i)>>7);
-		else if (i<128) x=128;
-		else if (i<246) x=256-i;	
-		else x=10;
-		v[i] = x;
+		ring_put(&receive_ring, usart_recv(USART1));
+		if (!paused && (ring_count(&receive_ring) > 3*RECEIVE_RING_SIZE/4))
+		{
+			usart_send(USART1, XOFF);
+			paused = true;
+		}
 	}
+	ISR_PROFILE_EXIT(ISR_PROFILE_USART1);
+}
+
+/*--------------------------------------------------------------------*/
+int main(void)
+{
 	clock_setup();
 	gpio_setup();
+#ifdef ISR_PROFILE
+	isr_profile_init();
+#endif
+#ifdef STREAM_PLAYBACK
+/* Start with both halves filled from the source */
+	ring_init(&receive_ring, receive_data, RECEIVE_RING_SIZE);
+#ifdef USART_SOURCE
+	usart_setup();
+#endif
+	refill(v);
+	refill(&v[HALF_SAMPLES]);
+#endif
 	timer_setup();
 	dma_setup();
 	dac_setup();
@@ -8,6 +8,11 @@ a short pulse. The inputs should then show a single pulse while the outputs will
 show a pulse followed by a shorter pulse. If a short exists between adjacent
 pins then the input pin will show an apparent extra pulse.
 
+Each pass starts with the automated test of port_test.c in common, which
+takes about a millisecond. Its fault map and the toggle rate benchmark are
+left as text in port_report for reading with the debugger. The pulses are
+timed by timebase.c in common.
+
 This is based on the LQFP64 version of the STM32Fxxx pinout as used on the
 STAMP board.
 
@@ -39,23 +44,44 @@ Copyright K. Sarkies <ksarkies@internode.on.net>
 #include <libopencm3/stm32/gpio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "port_test.h"
+#include "timebase.h"
 
 /* Prototypes */
 
 static void gpio_setup_outputs(void);
 static void clock_setup(void);
-static void delay(uint32_t period);
 
 /* Globals */
 
+/* Pins of the automated test: all but PA10 (serial receive), PA13, PA14 (SWD),
+PC14, PC15 (LSE) and PD0, PD1 (HSE) */
+static const port_test_config_t port_config = {
+    .pins = {0x9BFF, 0xFFFF, 0x3FFF, 0x0004},
+};
+
+/* Fault map and benchmark of the last pass, for reading with the debugger */
+port_test_result_t port_result;
+port_test_rate_t port_rate;
+char port_report[512];
+
 /*--------------------------------------------------------------------------*/
 
 int main(void)
 {
     clock_setup();
+    time_init(true);
 
     while (1)
     {
+/* Automated test of shorts between pins, stuck pins and the toggle rates.
+The report is left in port_report. */
+        uint32_t n;
+        port_test_run(&port_config, &port_result);
+        port_test_benchmark(PORT_TEST_PIN(2, 0), &port_rate);
+        n = port_test_format(port_report, sizeof(port_report), &port_result);
+        port_test_format_rate(port_report + n, sizeof(port_report) - n,
+                              &port_rate);
 /* Start sequence by turning all on then all off.
 PA10 is not exercised as it is connected to the receive output of the serial
 device. It is always set as input and will always show high during the test. */
@@ -71,7 +97,7 @@ device. It is always set as input and will always show high during the test. */
             GPIO8 | GPIO9 | GPIO10 | GPIO11 | GPIO12 | GPIO13);
         gpio_set(GPIOD,
             GPIO2);
-        delay(3200000);
+        delay_ms(600);
         gpio_clear(GPIOA,
             GPIO0 | GPIO1 | GPIO2 | GPIO3 | GPIO4 | GPIO5 | GPIO6 | GPIO7 |
             GPIO8 | GPIO9 | GPIO11 | GPIO12 | GPIO13 | GPIO14 | GPIO15);
@@ -83,24 +109,12 @@ device. It is always set as input and will always show high during the test. */
             GPIO8 | GPIO9 | GPIO10 | GPIO11 | GPIO12 | GPIO13);
         gpio_clear(GPIOD,
             GPIO2);
-        delay(1600000);
+        delay_ms(300);
     }
 
     return 0;
 }
 
-/*--------------------------------------------------------------------------*/
-/** @brief Delay
-
-*/
-
-void delay(uint32_t period)
-{
-    uint32_t i;
-    for (i = 0; i < period; i++)        /* Wait a bit. */
-        __asm__("nop");
-}
-
 /*--------------------------------------------------------------------------*/
 /** @brief Clock Setup
 
@@ -153,4 +167,13 @@ void gpio_setup_outputs(void)
     gpio_clear(GPIOD, GPIO2);
 }
 
+/*--------------------------------------------------------------------------*/
+/** @brief SysTick Handler
 
+Keeps the timebase of the delays.
+*/
+
+void sys_tick_handler(void)
+{
+    time_tick();
+}
@@ -8,6 +8,15 @@ a short pulse. The inputs should then show a single pulse while the outputs will
 show a pulse followed by a shorter pulse. If a short exists between adjacent
 pins then the input pin will show an apparent extra pulse.
 
+Each pass starts with the automated test of port_test.c in common, which
+takes about a millisecond. Its fault map and the toggle rate benchmark are
+left as text in port_report for reading with the debugger.
+
+The clock is run by clock_governor.c in common. The processor idles on the
+MSI at 1MHz in voltage range 3 through the visual test, and the automated test
+is run as a burst at 32MHz in range 1. The pulses are timed by timebase.c in
+common, which a notifier tells of each change of clock.
+
 This is based on the LQFP64 version of the STM32Fxxx pinout as used on the
 STAMP board.
 
@@ -40,90 +49,32 @@ Copyright K. Sarkies <ksarkies@internode.on.net>
 #include <libopencm3/stm32/pwr.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "port_test.h"
+#include "timebase.h"
+#include "clock_governor.h"
 
 /* Prototypes */
 
 static void gpio_setup_inputs(void);
 static void gpio_setup_outputs(void);
 static void clock_setup(void);
-static void delay(uint32_t period);
-
-/* 24MHz PLL from 8MHz HSE */
-const struct rcc_clock_scale clock_config_hse_24 = {
-	.pll_source = RCC_CFGR_PLLSRC_HSE_CLK,
-	.pll_mul = RCC_CFGR_PLLMUL_MUL6,
-	.pll_div = RCC_CFGR_PLLDIV_DIV2,
-	.hpre = RCC_CFGR_HPRE_SYSCLK_NODIV,
-	.ppre1 = RCC_CFGR_PPRE1_HCLK_NODIV,
-	.ppre2 = RCC_CFGR_PPRE2_HCLK_NODIV,
-	.voltage_scale = PWR_SCALE1,
-	.flash_waitstates = 1,
-	.ahb_frequency	= 24000000,
-	.apb1_frequency = 24000000,
-	.apb2_frequency = 24000000,
-};
+static void clock_changed(clock_notifier_t *notifier);
 
-/* 32MHz PLL from 8MHz HSE */
-const struct rcc_clock_scale clock_config_hse_32 = {
-	.pll_source = RCC_CFGR_PLLSRC_HSE_CLK,
-	.pll_mul = RCC_CFGR_PLLMUL_MUL12,
-	.pll_div = RCC_CFGR_PLLDIV_DIV3,
-	.hpre = RCC_CFGR_HPRE_SYSCLK_NODIV,
-	.ppre1 = RCC_CFGR_PPRE1_HCLK_NODIV,
-	.ppre2 = RCC_CFGR_PPRE2_HCLK_NODIV,
-	.voltage_scale = PWR_SCALE1,
-	.flash_waitstates = 1,
-	.ahb_frequency	= 32000000,
-	.apb1_frequency = 32000000,
-	.apb2_frequency = 32000000,
-};
+/* Globals */
 
-/* 64MHz PLL from 8MHz HSE */
-const struct rcc_clock_scale clock_config_hse_64 = {
-	.pll_source = RCC_CFGR_PLLSRC_HSE_CLK,
-	.pll_mul = RCC_CFGR_PLLMUL_MUL16,
-	.pll_div = RCC_CFGR_PLLDIV_DIV2,        /* 64MHz (96MHz max) */
-	.hpre = RCC_CFGR_HPRE_SYSCLK_NODIV,
-	.ppre1 = RCC_CFGR_PPRE1_HCLK_DIV2,      /* 32MHz max */
-	.ppre2 = RCC_CFGR_PPRE2_HCLK_DIV2,      /* 32MHz max */
-	.voltage_scale = PWR_SCALE1,            /* Highest speed */
-	.flash_waitstates = 1,
-	.ahb_frequency	= 64000000,
-	.apb1_frequency = 36000000,
-	.apb2_frequency = 36000000,
+/* Pins of the automated test: all but PA10 (serial receive), PA13, PA14 (SWD),
+PC14, PC15 (LSE) and PD0, PD1 (HSE) */
+static const port_test_config_t port_config = {
+    .pins = {0x9BFF, 0xFFFF, 0x3FFF, 0x0004},
 };
 
-/* 24MHz PLL from 16MHz HSI */
-const struct rcc_clock_scale clock_config_hsi_24 = {
-	.pll_source = RCC_CFGR_PLLSRC_HSI_CLK,
-	.pll_mul = RCC_CFGR_PLLMUL_MUL3,
-	.pll_div = RCC_CFGR_PLLDIV_DIV2,
-	.hpre = RCC_CFGR_HPRE_SYSCLK_NODIV,
-	.ppre1 = RCC_CFGR_PPRE1_HCLK_NODIV,
-	.ppre2 = RCC_CFGR_PPRE2_HCLK_NODIV,
-	.voltage_scale = PWR_SCALE1,
-	.flash_waitstates = 1,
-	.ahb_frequency	= 24000000,
-	.apb1_frequency = 24000000,
-	.apb2_frequency = 24000000,
-};
+/* Fault map and benchmark of the last pass, for reading with the debugger */
+port_test_result_t port_result;
+port_test_rate_t port_rate;
+char port_report[512];
 
-/* 32MHz PLL from 16MHz HSI */
-const struct rcc_clock_scale clock_config_hsi_32 = {
-	.pll_source = RCC_CFGR_PLLSRC_HSI_CLK,
-	.pll_mul = RCC_CFGR_PLLMUL_MUL6,
-	.pll_div = RCC_CFGR_PLLDIV_DIV3,
-	.hpre = RCC_CFGR_HPRE_SYSCLK_NODIV,
-	.ppre1 = RCC_CFGR_PPRE1_HCLK_NODIV,
-	.ppre2 = RCC_CFGR_PPRE2_HCLK_NODIV,
-	.voltage_scale = PWR_SCALE1,
-	.flash_waitstates = 1,
-	.ahb_frequency	= 32000000,
-	.apb1_frequency = 32000000,
-	.apb2_frequency = 32000000,
-};
-
-/* Globals */
+/* Tells the timebase of each change of clock */
+static clock_notifier_t timebase_notifier;
 
 /*--------------------------------------------------------------------------*/
 
@@ -133,6 +84,16 @@ int main(void)
 
     while (1)
     {
+/* Automated test of shorts between pins, stuck pins and the toggle rates,
+run as a burst at 32MHz. The report is left in port_report. */
+        uint32_t n;
+        clock_governor_request(CLOCK_LEVEL_32MHZ);
+        port_test_run(&port_config, &port_result);
+        port_test_benchmark(PORT_TEST_PIN(2, 0), &port_rate);
+        n = port_test_format(port_report, sizeof(port_report), &port_result);
+        port_test_format_rate(port_report + n, sizeof(port_report) - n,
+                              &port_rate);
+        clock_governor_release(CLOCK_LEVEL_32MHZ);
 /* Start sequence by turning all on then all off.
 PA10 is not exercised as it is connected to the receive output of the serial
 device. It is always set as input and will always show high during the test. */
@@ -148,7 +109,7 @@ device. It is always set as input and will always show high during the test. */
             GPIO8 | GPIO9 | GPIO10 | GPIO11 | GPIO12 | GPIO13);
         gpio_set(GPIOD,
             GPIO2);
-        delay(3200000);
+        delay_ms(600);
         gpio_clear(GPIOA,
             GPIO0 | GPIO1 | GPIO2 | GPIO3 | GPIO4 | GPIO5 | GPIO6 | GPIO7 |
             GPIO8 | GPIO9 | GPIO11 | GPIO12 | GPIO13 | GPIO14 | GPIO15);
@@ -160,7 +121,7 @@ device. It is always set as input and will always show high during the test. */
             GPIO8 | GPIO9 | GPIO10 | GPIO11 | GPIO12 | GPIO13);
         gpio_clear(GPIOD,
             GPIO2);
-        delay(1600000);
+        delay_ms(300);
 /* Set some as inputs to check for cross leakage between pins.
 Pulse remaining pins still set as outputs. */
         gpio_setup_inputs();
@@ -173,7 +134,7 @@ Pulse remaining pins still set as outputs. */
         gpio_set(GPIOC,
                 GPIO1 | GPIO3 | GPIO5 | GPIO7 |
                 GPIO9 | GPIO10 | GPIO12);
-        delay(800000);
+        delay_ms(150);
         gpio_clear(GPIOA,
                 GPIO1 | GPIO5 | GPIO7 |
                 GPIO9 | GPIO11 | GPIO13 | GPIO14);
@@ -183,22 +144,22 @@ Pulse remaining pins still set as outputs. */
         gpio_clear(GPIOC,
                 GPIO1 | GPIO3 | GPIO5 | GPIO7 |
                 GPIO9 | GPIO10 | GPIO12);
-        delay(1600000);
+        delay_ms(300);
     }
 
     return 0;
 }
 
 /*--------------------------------------------------------------------------*/
-/** @brief Delay
+/** @brief Clock Change Notifier
 
+Called by the clock governor after each change of clock.
 */
 
-void delay(uint32_t period)
+void clock_changed(clock_notifier_t *notifier)
 {
-    uint32_t i;
-    for (i = 0; i < period; i++)        /* Wait a bit. */
-        __asm__("nop");
+    (void) notifier;
+    time_clock_changed();
 }
 
 /*--------------------------------------------------------------------------*/
@@ -210,8 +171,10 @@ clocks are turned on.
 
 void clock_setup(void)
 {
-//    rcc_clock_setup_pll(&rcc_clock_config[RCC_CLOCK_VRANGE1_HSI_PLL_24MHZ]);
-    rcc_clock_setup_pll(&clock_config_hse_24);
+/* Idle on the MSI at 1MHz in voltage range 3, raised for bursts of work. */
+    clock_governor_init(CLOCK_LEVEL_1MHZ);
+    time_init(true);
+    clock_governor_notify(&timebase_notifier, clock_changed, 0);
 
 /* Enable all GPIO clocks. */
     rcc_periph_clock_enable(RCC_GPIOA);
@@ -279,3 +242,13 @@ void gpio_setup_inputs(void)
             GPIO2);
 }
 
+/*--------------------------------------------------------------------------*/
+/** @brief SysTick Handler
+
+Keeps the timebase of the delays.
+*/
+
+void sys_tick_handler(void)
+{
+    time_tick();
+}
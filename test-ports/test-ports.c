@@ -8,6 +8,11 @@ a short pulse. The inputs should then show a single pulse while the outputs will
 show a pulse followed by a shorter pulse. If a short exists between adjacent
 pins then the input pin will show an apparent extra pulse.
 
+Before the visual test the automated test of port_test.c in common is run once
+on all the pins other than the USART1 and SWD pins, and its fault map and the
+toggle rate benchmark are sent on USART1 TX (PA9) at 115200 baud. The pulses
+are timed by timebase.c in common.
+
 This is based on the LQFP64 version of the STM32Fxxx pinout as used on the
 STAMP board.
 
@@ -37,23 +42,47 @@ Copyright K. Sarkies <ksarkies@internode.on.net>
 
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/usart.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "port_test.h"
+#include "timebase.h"
 
 /* Prototypes */
 
 static void gpio_setup_outputs(void);
 static void gpio_setup_inputs(void);
 static void clock_setup(void);
-static void delay(uint32_t period);
+static void usart1_setup(void);
+static void usart1_print(const char *text);
 
 /* Globals */
 
+/* Pins of the automated test: all but PA9, PA10 (USART1), PA13, PA14 (SWD),
+PC14, PC15 (LSE) and PD0, PD1 (HSE) */
+static const port_test_config_t port_config = {
+    .pins = {0x99FF, 0xFFFF, 0x3FFF, 0x0004},
+};
+static port_test_result_t port_result;
+static port_test_rate_t port_rate;
+static char port_report[512];
+
 /*--------------------------------------------------------------------------*/
 
 int main(void)
 {
     clock_setup();
+    time_init(true);
+
+/* Release PA15, PB3 and PB4 from JTAG, keeping SWD for the automated test */
+    gpio_primary_remap(AFIO_MAPR_SWJ_CFG_JTAG_OFF_SW_ON, 0);
+    port_test_run(&port_config, &port_result);
+    port_test_benchmark(PORT_TEST_PIN(2, 0), &port_rate);
+    usart1_setup();
+    port_test_format(port_report, sizeof(port_report), &port_result);
+    usart1_print(port_report);
+    port_test_format_rate(port_report, sizeof(port_report), &port_rate);
+    usart1_print(port_report);
 
     while (1)
     {
@@ -72,7 +101,7 @@ device. It is always set as input and will always show high during the test. */
             GPIO8 | GPIO9 | GPIO10 | GPIO11 | GPIO12 | GPIO13);
         gpio_set(GPIOD,
             GPIO2);
-        delay(3200000);
+        delay_ms(600);
         gpio_clear(GPIOA,
             GPIO0 | GPIO1 | GPIO2 | GPIO3 | GPIO4 | GPIO5 | GPIO6 | GPIO7 |
             GPIO8 | GPIO9 | GPIO11 | GPIO12 | GPIO13 | GPIO14 | GPIO15);
@@ -84,7 +113,7 @@ device. It is always set as input and will always show high during the test. */
             GPIO8 | GPIO9 | GPIO10 | GPIO11 | GPIO12 | GPIO13);
         gpio_clear(GPIOD,
             GPIO2);
-        delay(1600000);
+        delay_ms(300);
 /* Set some as inputs to check for cross leakage between pins.
 Pulse remaining pins still set as outputs. */
         gpio_setup_inputs();
@@ -97,7 +126,7 @@ Pulse remaining pins still set as outputs. */
         gpio_set(GPIOC,
                 GPIO1 | GPIO3 | GPIO5 | GPIO7 |
                 GPIO9 | GPIO10 | GPIO12);
-        delay(800000);
+        delay_ms(150);
         gpio_clear(GPIOA,
                 GPIO1 | GPIO5 | GPIO7 |
                 GPIO9 | GPIO11 | GPIO13 | GPIO14);
@@ -107,22 +136,43 @@ Pulse remaining pins still set as outputs. */
         gpio_clear(GPIOC,
                 GPIO1 | GPIO3 | GPIO5 | GPIO7 |
                 GPIO9 | GPIO10 | GPIO12);
-        delay(1600000);
+        delay_ms(300);
     }
 
     return 0;
 }
 
 /*--------------------------------------------------------------------------*/
-/** @brief Delay
+/** @brief USART1 Setup
 
+Transmit only at 115200 baud for the test report. PA9 is taken back by the
+visual test afterwards.
 */
 
-void delay(uint32_t period)
+void usart1_setup(void)
 {
-    uint32_t i;
-    for (i = 0; i < period; i++)        /* Wait a bit. */
-        __asm__("nop");
+    rcc_periph_clock_enable(RCC_USART1);
+    gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ,
+                  GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO_USART1_TX);
+    usart_set_baudrate(USART1, 115200);
+    usart_set_databits(USART1, 8);
+    usart_set_stopbits(USART1, USART_STOPBITS_1);
+    usart_set_parity(USART1, USART_PARITY_NONE);
+    usart_set_flow_control(USART1, USART_FLOWCONTROL_NONE);
+    usart_set_mode(USART1, USART_MODE_TX);
+    usart_enable(USART1);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send a String on USART1
+
+Returns once the last character has left the USART.
+*/
+
+void usart1_print(const char *text)
+{
+    while (*text != 0) usart_send_blocking(USART1, *text++);
+    while ((USART_SR(USART1) & USART_SR_TC) == 0);
 }
 
 /*--------------------------------------------------------------------------*/
@@ -209,3 +259,13 @@ void gpio_setup_inputs(void)
             GPIO2);
 }
 
+/*--------------------------------------------------------------------------*/
+/** @brief SysTick Handler
+
+Keeps the timebase of the delays.
+*/
+
+void sys_tick_handler(void)
+{
+    time_tick();
+}
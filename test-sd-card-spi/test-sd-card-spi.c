@@ -1,12 +1,39 @@
 /* STM32F1 CLI for tests - SD card using SPI
 
-Terminal with baud rate 115200.
+Terminal with baud rate 115200. The commands are run by shell.c, with the
+argument after a space, and help lists them.
 
 Initially tested with the ET-STM32F103 (STM32F103RBT6).
 
 G will return a "hello" message
 L will toggle GPIO8, first LED on the board.
 S will return some status values for the inserted card.
+I will initialise the card and return its type.
+R n will read block n and return it in hex.
+W n will write a test pattern to blocks n to n+3, read them back and compare.
+M will mount the FAT volume on the card.
+F n will append n kB to the file LOG.TXT in whole clusters where possible, and
+return the number of bytes written and the file size.
+A n will log the dual ADC to the file ADC.BIN for n seconds, and return the
+records written, those dropped and the most held in the queue.
+
+R and F run a line or a buffer at a time from the main loop, and A writes the
+records queued on each poll. Ctrl-C stops them.
+
+The ADC log converts eight channels, four on each ADC in dual regular
+simultaneous mode, in a scan started by the TRGO of timer 3 at LOG_SCAN_RATE.
+DMA fills a ping-pong buffer whose halves are each one record of samples. The
+DMA interrupt puts a header with the sequence number, a DWT cycle count
+timestamp and the count of records dropped before the samples, and copies the
+record into the next free slot of a queue of LOG_QUEUE records. Records are
+one card sector, so the main loop writes each contiguous run of queued records
+straight from the queue as a multiple block DMA transfer, into a file given
+contiguous clusters for the whole log. When the card is busy for longer than
+the queue can hold, records are dropped and counted rather than overwriting
+those waiting, so the records in the file are always whole and in order, and
+any gap shows in the sequence numbers. Built with DMA_MEM the samples are
+copied by memory to memory DMA, and a record is written only once its copy is
+done.
 
 Copyright K. Sarkies <ksarkies@internode.on.net>
 
@@ -36,33 +63,114 @@ Copyright K. Sarkies <ksarkies@internode.on.net>
 #include <libopencm3/stm32/dma.h>
 #include <libopencm3/stm32/timer.h>
 #include <libopencm3/stm32/usart.h>
+#include <libopencm3/stm32/spi.h>
 #include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include "buffer.h"
+#include "serial.h"
+#include "shell.h"
+#include "isr_profile.h"
+#include "spi_dma.h"
+#include "sd_spi.h"
+#include "fat.h"
+#ifdef DMA_MEM
+#include "dma_mem.h"
+#endif
 
 /* Prototypes */
 
-static void usart_print_int(int value);
-static void usart_print_hex(uint16_t value);
-static void usart_print_string(char *ch);
 static void gpio_setup(void);
 static void spi_setup(void);
 static void usart_setup(void);
 static void clock_setup(void);
-static void parseCommand(char* line);
+static shell_status_t hello(shell_call_t *call);
+static shell_status_t led(shell_call_t *call);
+static shell_status_t status(shell_call_t *call);
+static shell_status_t initCard(shell_call_t *call);
+static shell_status_t readBlock(shell_call_t *call);
+static shell_status_t writeBlocks(shell_call_t *call);
+static shell_status_t mount(shell_call_t *call);
+static shell_status_t appendFile(shell_call_t *call);
+static shell_status_t logCommand(shell_call_t *call);
 static uint8_t socketWriteProtected(void);
 static uint8_t socketCardInserted(void);
+static uint32_t argument(shell_call_t *call);
+static void adc_setup(void);
+static uint8_t logStart(uint32_t seconds);
+static uint8_t logWrite(void);
+static void logStop(void);
+static void queueBlock(const uint32_t *block);
+#ifdef DMA_MEM
+static void recordCopied(void *context, bool error);
+#endif
 
 #define BUFFER_SIZE 128
-#define N_CONV 6
-#define N_SAMPLES 16
+/* Channels converted for the log, half by each ADC */
+#define N_CONV 8
+/* Scans per second started by timer 3, and its clock of twice APB1 */
+#define LOG_SCAN_RATE 10000
+#define TIMER_CLOCK 72000000
+/* Records held waiting for the card, a power of two */
+#define LOG_QUEUE 16
+/* Scans in a record, filling a sector with the header */
+#define RECORD_SCANS 31
+#define RECORD_WORDS (RECORD_SCANS*N_CONV/2)
+/* Longest log, about 7.2 hours, whose records fit in the 4GB size of a file */
+#define LOG_MAX_SECONDS \
+    ((0xFFFFFFFF/sizeof(log_record_t))*RECORD_SCANS/LOG_SCAN_RATE)
+/* "ADCL" to find the records in the file */
+#define LOG_MAGIC 0x4C434441
+
+/* A log record of one card sector. The samples are as the dual ADC gives them,
+ADC1 in the low half of each word and ADC2 in the high half. */
+typedef struct {
+	uint32_t magic;
+	uint32_t sequence;              /* ADC blocks since the log started */
+	uint32_t timestamp;             /* DWT cycles as the block ended */
+	uint16_t dropped;               /* records dropped so far */
+	uint8_t scans;
+	uint8_t channels;
+	uint32_t samples[RECORD_WORDS];
+} log_record_t;
 
 /* Globals */
-uint8_t send_buffer[BUFFER_SIZE+3];
-uint8_t receive_buffer[BUFFER_SIZE+3];
-char line[80];
-uint8_t characterPosition;
+uint8_t send_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
+uint8_t receive_buffer[BUFFER_SIZE+BUFFER_OVERHEAD];
+static const shell_command_t commands[] = {
+    {"G",   "",     "hello",                                hello},
+    {"L",   "",     "toggle the LED",                       led},
+    {"S",   "",     "socket status",                        status},
+    {"I",   "",     "initialise the card",                  initCard},
+    {"R",   "n",    "read block n in hex",                  readBlock},
+    {"W",   "n",    "write and check blocks n to n+3",      writeBlocks},
+    {"M",   "",     "mount the FAT volume",                 mount},
+    {"F",   "n",    "append n kB to LOG.TXT",               appendFile},
+    {"A",   "n",    "log the ADC to ADC.BIN for n seconds", logCommand},
+};
+/* Result and bytes left of the append in progress */
+uint8_t append_result;
+uint32_t append_remaining;
+/* Card blocks, word aligned for the DMA */
+uint32_t block_data[4*SD_BLOCK_SIZE/4];
+uint32_t check_data[4*SD_BLOCK_SIZE/4];
+fat_file_t log_file;
+/* ADC log ping-pong buffer and queue. The next, head and tail count the
+records taken, filled and written, and the queue is full when next and tail
+are LOG_QUEUE apart. Head lags next while the samples are copied by DMA. */
+uint32_t adc_buffer[2*RECORD_WORDS];
+log_record_t log_queue[LOG_QUEUE];
+volatile uint32_t log_next;
+volatile uint32_t log_head;
+volatile uint32_t log_tail;
+volatile uint32_t log_blocks;
+volatile uint32_t log_dropped;
+volatile uint32_t log_high_water;
+uint32_t log_records;
+uint8_t log_result;
 
 /*--------------------------------------------------------------------------*/
 
@@ -72,58 +180,406 @@ int main(void)
 	gpio_setup();
 	usart_setup();
 	spi_setup();
+	adc_setup();
+	dwt_enable_cycle_counter();
 	buffer_init(send_buffer,BUFFER_SIZE);
 	buffer_init(receive_buffer,BUFFER_SIZE);
-	usart_enable_tx_interrupt(USART1);
+	serial_tx_init(send_buffer);
+	serial_rx_init(receive_buffer);
+#ifdef ISR_PROFILE
+	isr_profile_init();
+#endif
+#ifdef DMA_MEM
+	dma_mem_init();
+#endif
 
 /* Send a greeting message on USART1. */
-	usart_print_string("SD Card SPI Mode Test\r\n");
+	serial_printf("SD Card SPI Mode Test\r\n");
+	shell_init(receive_buffer, send_buffer, commands,
+               sizeof(commands)/sizeof(commands[0]), "> ");
 
 	while (1)
 	{
 /* Command interface */
-        if (buffer_input_available(receive_buffer))
-        {
-            char character = buffer_get(receive_buffer);
-            if (character == 0x0D)
-            {
-                line[characterPosition] = 0;
-                characterPosition = 0;
-                parseCommand(line);
-            }
-            else line[characterPosition++] = character;
-        }
+        shell_poll();
 	}
 
 	return 0;
 }
 
 /*--------------------------------------------------------------------------*/
-/** @brief Parse a command line and act
+/** @brief Greeting
+
+*/
+
+static shell_status_t hello(shell_call_t *call)
+{
+    (void) call;
+    serial_printf("Hello\r\n");
+    return SHELL_DONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Toggle the first LED
+
+*/
+
+static shell_status_t led(shell_call_t *call)
+{
+    (void) call;
+    gpio_toggle(GPIOB,GPIO8);
+    return SHELL_DONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Socket Status
+
+*/
+
+static shell_status_t status(shell_call_t *call)
+{
+    (void) call;
+    if (socketWriteProtected())
+        serial_printf("Write Protected\r\n");
+    else
+        serial_printf("Writeable\r\n");
+    if (socketCardInserted())
+        serial_printf("Card Present\r\n");
+    else
+        serial_printf("No Card\r\n");
+    return SHELL_DONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise the Card
 
 */
 
-void parseCommand(char *line)
+static shell_status_t initCard(shell_call_t *call)
 {
-    if (line[0] == 'G')
+    (void) call;
+    uint8_t result = sd_init(&spi_bus1, GPIOA, GPIO4);
+    serial_printf("Init %d Type %d\r\n", result, sd_type());
+    return SHELL_DONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Read a Block and Print it in Hex
+
+The block is read on the first call, then a line of 16 bytes is sent each
+time the send buffer has room, as it is smaller than the block. The state
+counts the bytes printed.
+*/
+
+static shell_status_t readBlock(shell_call_t *call)
+{
+    uint8_t *data = (uint8_t *) block_data;
+    uint16_t j;
+    if (call->cancel) return SHELL_DONE;
+    if (call->step == 0)
+    {
+        uint8_t result = sd_read(argument(call), data, 1);
+        serial_printf("Read %d\r\n", result);
+        if (result != SD_OK) return SHELL_DONE;
+    }
+    while (call->state < SD_BLOCK_SIZE)
     {
-        usart_print_string("Hello\r\n");
+        if (! shell_output_room(4+16*3+2)) return SHELL_BUSY;
+        serial_printf("%03X ", call->state);
+        for (j = 0; j < 16; j++) serial_printf(" %02X", data[call->state++]);
+        serial_printf("\r\n");
     }
-    else if (line[0] == 'L')
+    return SHELL_DONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write a Test Pattern and Read it Back
+
+*/
+
+static shell_status_t writeBlocks(shell_call_t *call)
+{
+    uint32_t block = argument(call);
+    uint32_t i;
+    for (i = 0; i < sizeof(block_data)/4; i++) block_data[i] = block*128 + i;
+/* Four blocks make a multiple block write and read */
+    uint8_t result = sd_write(block, (uint8_t *) block_data, 4);
+    serial_printf("Write %d\r\n", result);
+    if (result == SD_OK)
+    {
+        result = sd_read(block, (uint8_t *) check_data, 4);
+        for (i = 0; i < sizeof(block_data)/4; i++)
+            if (check_data[i] != block_data[i]) break;
+        serial_printf("Read %d %s\r\n", result,
+            (i < sizeof(block_data)/4) ? "Mismatch" : "Match");
+    }
+    return SHELL_DONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Mount the FAT Volume
+
+*/
+
+static shell_status_t mount(shell_call_t *call)
+{
+    (void) call;
+    serial_printf("Mount %d Cluster %d\r\n", fat_mount(), fat_cluster_size());
+    return SHELL_DONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Append to LOG.TXT
+
+The file is opened on the first call, then the 2kB buffer is written once on
+each call, covering whole clusters of up to 2kB, so that the main loop runs
+between the writes. The state counts the bytes written. The file is closed when
+all are written, on an error or when cancelled.
+*/
+
+static shell_status_t appendFile(shell_call_t *call)
+{
+    uint32_t done;
+    uint32_t i;
+    if (call->step == 0)
+    {
+        append_remaining = argument(call)*1024;
+        append_result = fat_open(&log_file, "LOG.TXT",
+                                 FAT_WRITE | FAT_CREATE | FAT_APPEND);
+/* A new log is given 1MB of contiguous clusters */
+        if ((append_result == FAT_OK) && (log_file.size == 0))
+            append_result = fat_expand(&log_file, 1024*1024);
+        for (i = 0; i < sizeof(block_data)/4; i++) block_data[i] = i;
+    }
+    if ((append_result == FAT_OK) && (append_remaining > 0) && ! call->cancel)
+    {
+        uint32_t length = sizeof(block_data);
+        if (length > append_remaining) length = append_remaining;
+        append_result = fat_write(&log_file, block_data, length, &done);
+        call->state += done;
+        append_remaining -= done;
+        if ((append_result == FAT_OK) && (append_remaining > 0))
+            return SHELL_BUSY;
+    }
+    if (append_result == FAT_OK) append_result = fat_close(&log_file);
+    serial_printf("File %d Written %d Size %d\r\n", append_result,
+                  call->state, log_file.size);
+    return SHELL_DONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Log the ADC
+
+The log is started on the first call, then one contiguous run of the records
+queued is written on each call, so that the main loop runs between the writes.
+It ends when the records for the time given have been converted and all those
+queued are written, on an error or when cancelled, which stops the conversions
+and closes the file with the records written so far. The time is limited to
+LOG_MAX_SECONDS, beyond which the file size overflows.
+*/
+
+static shell_status_t logCommand(shell_call_t *call)
+{
+    if (call->step == 0)
+    {
+        uint32_t seconds = argument(call);
+        if (seconds > LOG_MAX_SECONDS)
+        {
+            seconds = LOG_MAX_SECONDS;
+            serial_printf("Log limited to %d s\r\n", seconds);
+        }
+        log_result = logStart(seconds);
+        if (log_result != FAT_OK)
+        {
+            serial_printf("Log %d\r\n", log_result);
+            return SHELL_DONE;
+        }
+    }
+    if ((log_result == FAT_OK) && ! call->cancel)
+    {
+        log_result = logWrite();
+        if ((log_result == FAT_OK) &&
+            ((log_blocks < log_records) || (log_tail != log_next)))
+            return SHELL_BUSY;
+    }
+    logStop();
+    return SHELL_DONE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the ADC Log
+
+The file is opened and given contiguous clusters for all of the records, and
+the timer and DMA are started. The DMA interrupt then queues the records.
+
+@param[in] seconds: length of the log.
+@returns FAT_OK or the error of the file.
+*/
+
+static uint8_t logStart(uint32_t seconds)
+{
+    uint32_t ticks = TIMER_CLOCK/LOG_SCAN_RATE;
+    uint32_t prescale = ticks/0x10000 + 1;
+    log_records = seconds*LOG_SCAN_RATE/RECORD_SCANS;
+    log_next = 0;
+    log_head = 0;
+    log_tail = 0;
+    log_blocks = 0;
+    log_dropped = 0;
+    log_high_water = 0;
+    uint8_t result = fat_open(&log_file, "ADC.BIN",
+                              FAT_WRITE | FAT_CREATE | FAT_APPEND);
+/* A new log is given contiguous clusters for all of its records */
+    if ((result == FAT_OK) && (log_file.size == 0))
+        result = fat_expand(&log_file, log_records*sizeof(log_record_t));
+    if (result != FAT_OK) return result;
+/* DMA1 channel 1 circular over both halves of the buffer, interrupting as
+each half is filled */
+    dma_channel_reset(DMA1, DMA_CHANNEL1);
+    dma_set_priority(DMA1, DMA_CHANNEL1, DMA_CCR_PL_MEDIUM);
+    dma_set_memory_size(DMA1, DMA_CHANNEL1, DMA_CCR_MSIZE_32BIT);
+    dma_set_peripheral_size(DMA1, DMA_CHANNEL1, DMA_CCR_PSIZE_32BIT);
+    dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL1);
+    dma_set_read_from_peripheral(DMA1, DMA_CHANNEL1);
+    dma_set_peripheral_address(DMA1, DMA_CHANNEL1, (uint32_t) &ADC1_DR);
+    dma_set_memory_address(DMA1, DMA_CHANNEL1, (uint32_t) adc_buffer);
+    dma_set_number_of_data(DMA1, DMA_CHANNEL1, 2*RECORD_WORDS);
+    dma_enable_circular_mode(DMA1, DMA_CHANNEL1);
+    dma_enable_half_transfer_interrupt(DMA1, DMA_CHANNEL1);
+    dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL1);
+    nvic_enable_irq(NVIC_DMA1_CHANNEL1_IRQ);
+    dma_enable_channel(DMA1, DMA_CHANNEL1);
+/* Timer 3 starts each scan on its update event, with the smallest prescaler
+that fits the period in 16 bits */
+    rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM3EN);
+    timer_reset(TIM3);
+    timer_set_mode(TIM3, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+    timer_continuous_mode(TIM3);
+    timer_set_prescaler(TIM3, prescale - 1);
+    timer_set_period(TIM3, ticks/prescale - 1);
+    timer_set_master_mode(TIM3, TIM_CR2_MMS_UPDATE);
+    timer_enable_counter(TIM3);
+    return FAT_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write the Queued ADC Records
+
+Each contiguous run of records in the queue is written while the next are
+converted. The queue slots are freed only once the write is done. A run stops
+at the end of the queue, and the rest is written on the next call.
+
+@returns FAT_OK or the error of the file.
+*/
+
+static uint8_t logWrite(void)
+{
+    uint32_t done;
+    uint32_t head = log_head;
+    if (head == log_tail) return FAT_OK;
+    uint32_t first = log_tail % LOG_QUEUE;
+    uint32_t count = head - log_tail;
+    if (count > LOG_QUEUE - first) count = LOG_QUEUE - first;
+    uint8_t result = fat_write(&log_file, &log_queue[first],
+                               count*sizeof(log_record_t), &done);
+    log_tail += done/sizeof(log_record_t);
+    return result;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Stop the ADC Log
+
+The timer and DMA are stopped, the file closed and the counts reported.
+Records still in the queue are discarded.
+*/
+
+static void logStop(void)
+{
+    timer_disable_counter(TIM3);
+    dma_disable_channel(DMA1, DMA_CHANNEL1);
+    nvic_disable_irq(NVIC_DMA1_CHANNEL1_IRQ);
+    if (log_result == FAT_OK) log_result = fat_close(&log_file);
+    serial_printf("Log %d Records %d Dropped %d Queue %d Size %d\r\n",
+                  log_result, log_tail, log_dropped, log_high_water,
+                  log_file.size);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Queue an ADC Block
+
+Called by the DMA interrupt as each half of the buffer is filled. The block is
+dropped if the queue is full.
+
+@param[in] block: RECORD_WORDS words of samples.
+*/
+
+static void queueBlock(const uint32_t *block)
+{
+    if (log_blocks >= log_records) return;
+    uint32_t queued = log_next - log_tail;
+    if (queued >= LOG_QUEUE) log_dropped++;
+    else
     {
-        gpio_toggle(GPIOB,GPIO8);
+        log_record_t *record = &log_queue[log_next % LOG_QUEUE];
+        record->magic = LOG_MAGIC;
+        record->sequence = log_blocks;
+        record->timestamp = DWT_CYCCNT;
+        record->dropped = log_dropped;
+        record->scans = RECORD_SCANS;
+        record->channels = N_CONV;
+#ifdef DMA_MEM
+/* The copy is done long before the DMA comes back to this half */
+        if (! dma_memcpy(record->samples, block, sizeof(record->samples),
+                         recordCopied, (void *) block))
+        {
+            log_dropped++;
+            log_blocks++;
+            return;
+        }
+        log_next++;
+#else
+        memcpy(record->samples, block, sizeof(record->samples));
+        log_next++;
+        log_head++;
+#endif
+        if (queued + 1 > log_high_water) log_high_water = queued + 1;
     }
-    else if (line[0] == 'S')
+    log_blocks++;
+}
+
+#ifdef DMA_MEM
+/*--------------------------------------------------------------------------*/
+/** @brief Record Copied
+
+Called by dma_mem.c when the samples of the oldest record being copied are
+in, the copies being done in order. A copy ended by a DMA error is done again
+by the processor from its block, which the ADC DMA is not yet refilling.
+
+@param[in] context: the block of samples copied.
+@param[in] error: set if the copy did not complete.
+*/
+
+static void recordCopied(void *context, bool error)
+{
+    if (error)
     {
-        if (socketWriteProtected())
-            usart_print_string("Write Protected\r\n");
-        else
-            usart_print_string("Writeable\r\n");
-        if (socketCardInserted())
-            usart_print_string("Card Present\r\n");
-        else
-            usart_print_string("No Card\r\n");
+        log_record_t *record = &log_queue[log_head % LOG_QUEUE];
+        memcpy(record->samples, context, sizeof(record->samples));
     }
+    log_head++;
+}
+#endif
+
+/*--------------------------------------------------------------------------*/
+/** @brief Number Argument of a Command
+
+@returns the first argument, or 0 if none was given.
+*/
+
+static uint32_t argument(shell_call_t *call)
+{
+    if (call->argc < 2) return 0;
+    return shell_number(call->argv[1]);
 }
 
 /*--------------------------------------------------------------------------*/
@@ -161,7 +617,9 @@ void clock_setup(void)
 /*--------------------------------------------------------------------------*/
 /** @brief SPI Setup
 
-This is for the SPI1 on the ET-STM32F103 card.
+This is for the SPI1 on the ET-STM32F103 card: SCK PA5, MISO PA6 and MOSI PA7
+on the SPI alternate functions by DMA, with the card select on PA4 set up by
+sd_init. The card is driven in SPI mode 0.
 We are unable to use PA8 with the USART1.
 */
 
@@ -170,12 +628,12 @@ void spi_setup(void)
 /* Enable GPIO clocks. */
     rcc_peripheral_enable_clock(&RCC_APB2ENR,
                 RCC_APB2ENR_IOPAEN | RCC_APB2ENR_IOPCEN);
-/* PA6,8 inputs digital for SPI */
+/* SPI1 starts at the slowest clock and sd_init sets the rates it needs */
+    spi_bus_setup(&spi_bus1, SPI_CR1_BAUDRATE_FPCLK_DIV_256,
+                SPI_CR1_CPOL_CLK_TO_0_WHEN_IDLE, SPI_CR1_CPHA_CLK_TRANSITION_1);
+/* PA8 input digital for card detect */
     gpio_set_mode(GPIOA, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT,
-			    GPIO6 | GPIO8);
-/* PA4,5,7 outputs digital for SPI */
-    gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_PUSHPULL,
-			    GPIO4 | GPIO5 | GPIO7);
+			    GPIO8);
 /* PC6 input digital for write protect status */
     gpio_set_mode(GPIOC, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT,
 			    GPIO6);
@@ -231,109 +689,98 @@ void usart_setup(void)
 }
 
 /*--------------------------------------------------------------------------*/
-/** @brief Print out the contents of a register (debug)
+/** @brief ADC Setup
 
+ADC1 converts channels 10-13 (PC0-PC3) and ADC2 channels 14, 15, 8, 9 (PC4,
+PC5, PB0, PB1) in dual regular simultaneous mode, as PA4-PA7 are used by the
+card. Each scan is started by the timer 3 TRGO and the results of both ADCs go
+to DMA from the ADC1 data register.
 */
 
-void print_register(uint32_t reg)
+static void adc_setup(void)
 {
-	usart_print_hex((reg >> 16) & 0xFFFF);
-	usart_print_hex((reg >> 00) & 0xFFFF);
-	buffer_put(send_buffer, ' ');
-    usart_enable_tx_interrupt(USART1);
+    uint8_t adc1_channels[N_CONV/2] = { 10, 11, 12, 13 };
+    uint8_t adc2_channels[N_CONV/2] = { 14, 15, 8, 9 };
+    uint32_t i;
+    rcc_peripheral_enable_clock(&RCC_APB2ENR, RCC_APB2ENR_IOPBEN |
+                RCC_APB2ENR_IOPCEN | RCC_APB2ENR_ADC1EN | RCC_APB2ENR_ADC2EN);
+    rcc_peripheral_enable_clock(&RCC_AHBENR, RCC_AHBENR_DMA1EN);
+    gpio_set_mode(GPIOC, GPIO_MODE_INPUT, GPIO_CNF_INPUT_ANALOG,
+                GPIO0 | GPIO1 | GPIO2 | GPIO3 | GPIO4 | GPIO5);
+    gpio_set_mode(GPIOB, GPIO_MODE_INPUT, GPIO_CNF_INPUT_ANALOG,
+                GPIO0 | GPIO1);
+    adc_power_off(ADC1);
+    adc_power_off(ADC2);
+    adc_enable_scan_mode(ADC1);
+    adc_set_single_conversion_mode(ADC1);
+    adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_TIM3_TRGO);
+    adc_set_right_aligned(ADC1);
+    adc_set_sample_time_on_all_channels(ADC1, ADC_SMPR_SMP_28DOT5CYC);
+    adc_enable_dma(ADC1);
+    adc_set_dual_mode(ADC_CR1_DUALMOD_RSM);
+    adc_enable_scan_mode(ADC2);
+    adc_set_single_conversion_mode(ADC2);
+    adc_enable_external_trigger_regular(ADC2, ADC_CR2_EXTSEL_SWSTART);
+    adc_set_right_aligned(ADC2);
+    adc_set_sample_time_on_all_channels(ADC2, ADC_SMPR_SMP_28DOT5CYC);
+    adc_set_regular_sequence(ADC1, N_CONV/2, adc1_channels);
+    adc_set_regular_sequence(ADC2, N_CONV/2, adc2_channels);
+/* Power on and calibrate, waiting for each ADC to start up */
+    adc_power_on(ADC1);
+    for (i = 0; i < 800000; i++) __asm__("nop");
+    adc_reset_calibration(ADC1);
+    adc_calibrate_async(ADC1);
+    while (adc_is_calibrating(ADC1));
+    adc_power_on(ADC2);
+    for (i = 0; i < 800000; i++) __asm__("nop");
+    adc_reset_calibration(ADC2);
+    adc_calibrate_async(ADC2);
+    while (adc_is_calibrating(ADC2));
 }
 
 /*--------------------------------------------------------------------------*/
-/** @brief Print out a value in ASCII decimal form (ack Thomas Otto)
+/** @brief Print out the contents of a register (debug)
 
 */
 
-void usart_print_int(int value)
+void print_register(uint32_t reg)
 {
-	uint8_t i;
-	uint8_t nr_digits = 0;
-	char buffer[25];
-
-	if (value < 0)
-	{
-		buffer_put(send_buffer, '-');
-		value = value * -1;
-	}
-	if (value == 0) buffer[nr_digits++] = '0';
-	else while (value > 0)
-	{
-		buffer[nr_digits++] = "0123456789"[value % 10];
-		value /= 10;
-	}
-	for (i = nr_digits; i > 0; i--)
-	{
-		buffer_put(send_buffer, buffer[i-1]);
-	}
-//	buffer_put(send_buffer, ' ');
-    usart_enable_tx_interrupt(USART1);
+	serial_printf("%04X %04X  ", (reg >> 16) & 0xFFFF, reg & 0xFFFF);
 }
 
 /*--------------------------------------------------------------------------*/
-/** @brief Print out a value in ASCII hex form
+/** @brief USART Interrupt
 
+Pass received data to the buffer at the end of a burst. Transmission and
+reception are otherwise handled by DMA in the serial driver.
 */
 
-void usart_print_hex(uint16_t value)
+void usart1_isr(void)
 {
-	uint8_t i;
-	char buffer[25];
-
-	for (i = 0; i < 4; i++)
-	{
-		buffer[i] = "0123456789ABCDEF"[value & 0xF];
-		value >>= 4;
-	}
-	for (i = 4; i > 0; i--)
-	{
-		buffer_put(send_buffer, buffer[i-1]);
-	}
-	buffer_put(send_buffer, ' ');
-    usart_enable_tx_interrupt(USART1);
+	ISR_PROFILE_ENTER(ISR_PROFILE_USART1);
+	serial_rx_idle_isr();
+	ISR_PROFILE_EXIT(ISR_PROFILE_USART1);
 }
 
-/*--------------------------------------------------------------------------*/
-/** @brief Print a String
-
-*/
-
-void usart_print_string(char *ch)
-{
-  	while(*ch)
-	{
-     	buffer_put(send_buffer, *ch);
-     	ch++;
-  	}
-    usart_enable_tx_interrupt(USART1);
-}
 
 /*--------------------------------------------------------------------------*/
-/** @brief USART Interrupt
+/** @brief DMA Interrupt for the ADC Log
 
-Find out what interrupted and get or send data as appropriate.
+Each half of the buffer filled is queued as a record.
 */
 
-void usart1_isr(void)
+void dma1_channel1_isr(void)
 {
-	static uint16_t data;
-
-/* Check if we were called because of RXNE. */
-	if (usart_get_flag(USART1,USART_SR_RXNE))
+	ISR_PROFILE_ENTER(ISR_PROFILE_ADC_DMA);
+	if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_HTIF))
 	{
-/* If buffer full we'll just drop it */
-		buffer_put(receive_buffer, (uint8_t) usart_recv(USART1));
+		dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_HTIF);
+		queueBlock(adc_buffer);
 	}
-/* Check if we were called because of TXE. */
-	if (usart_get_flag(USART1,USART_SR_TXE))
+	if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_TCIF))
 	{
-/* If buffer empty, disable the tx interrupt */
-		data = buffer_get(send_buffer);
-		if ((data & 0xFF00) > 0) usart_disable_tx_interrupt(USART1);
-		else usart_send(USART1, (data & 0xFF));
+		dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_TCIF);
+		queueBlock(&adc_buffer[RECORD_WORDS]);
 	}
+	ISR_PROFILE_EXIT(ISR_PROFILE_ADC_DMA);
 }
-